@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 #include "math.h"
 #include "matrix.h"
 
@@ -102,6 +104,51 @@ namespace
    constexpr uint32_t CBPerViewGlobal_buffer_size = 1024; // This is how much CryEngine allocates for buffers that hold this (it doesn't use "sizeof(CBPerViewGlobal)")
    static_assert(CBPerViewGlobal_buffer_size > sizeof(CBPerViewGlobal));
 
+   // Description of a cbuffer member, to be able to tell which ones changed between two versions of the same buffer
+   struct CBufferField
+   {
+      const char* name;
+      size_t offset;
+      size_t size;
+   };
+#define CBUFFER_FIELD(cbuffer, field) CBufferField{ #field, offsetof(cbuffer, field), sizeof(cbuffer::field) }
+   constexpr CBufferField CBPerViewGlobal_fields[] =
+   {
+      CBUFFER_FIELD(CBPerViewGlobal, CV_ViewProjZeroMatr),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_AnimGenParams),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_ViewProjMatr),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_ViewProjNearestMatr),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_InvViewProj),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_PrevViewProjMatr),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_PrevViewProjNearestMatr),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_ScreenToWorldBasis),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_TessInfo),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_CameraRightVector),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_CameraFrontVector),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_CameraUpVector),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_ScreenSize),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_HPosScale),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_HPosClamp),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_ProjRatio),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_NearestScaled),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_NearFarClipDist),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_SunLightDir),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_SunColor),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_SkyColor),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_FogColor),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_TerrainInfo),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_DecalZFightingRemedy),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_FrustumPlaneEquation),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_WindGridOffset),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_ViewMatr),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_InvViewMatr),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_LookingGlass_SunSelector),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_LookingGlass_DepthScalar),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_PADDING0),
+      CBUFFER_FIELD(CBPerViewGlobal, CV_PADDING1),
+   };
+#undef CBUFFER_FIELD
+
    struct LumaFrameDevSettings
    {
       static constexpr size_t SettingsNum = 10;
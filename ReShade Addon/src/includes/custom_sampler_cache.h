@@ -0,0 +1,223 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <source/com_ptr.hpp>
+
+#include "rcu_snapshot.h"
+
+// Cache of the custom (upgraded) versions of the game samplers, one for each texture mip LOD bias we used them with (the LOD bias depends on the rendering resolution, e.g. with DLSS).
+// LOD biases are quantized to a fixed step, so that continuous dynamic resolution scaling doesn't keep creating new samplers every frame,
+// and only the most recently used few biases are kept around, the samplers of older ones are released (once no lock free reader could still be using them).
+// Replacement lookups (which happen on every sampler bind) read a flat (sorted) snapshot of the samplers for the active LOD bias, without taking any lock.
+// The snapshot is re-published immediately by any change (they are rare, they only happen on samplers creation/destruction and LOD bias changes), so it's always up to date.
+// Thread safe.
+class custom_sampler_cache
+{
+public:
+   // Step the LOD biases are quantized to (in mips), differences smaller than this aren't visible
+   static constexpr float lod_bias_step = 1.f / 16.f;
+   // How many LOD biases we keep the custom samplers for, so toggling between a couple of resolutions (or AA modes) doesn't need to re-create them
+   static constexpr size_t max_lod_biases = 4;
+
+   // Creates the custom version of an original sampler for a LOD bias, can return null if the sampler doesn't need to be replaced
+   using create_function = com_ptr<ID3D11SamplerState>(*)(ID3D11SamplerState* original_sampler, float lod_bias);
+
+   custom_sampler_cache(rcu_domain& domain) : domain(domain)
+   {
+      lod_biases.push_back(active_lod_bias_key);
+   }
+   custom_sampler_cache(const custom_sampler_cache&) = delete;
+   custom_sampler_cache& operator=(const custom_sampler_cache&) = delete;
+
+   static float quantize_lod_bias(float lod_bias)
+   {
+      return float(get_lod_bias_key(lod_bias)) * lod_bias_step;
+   }
+
+   // Returns true if the sampler is one of the tracked original ones, in which case "custom_sampler" is set to its replacement for the active LOD bias (which can be 0, if it doesn't need to be replaced).
+   // Lock free. The caller needs to be within a "rcu_domain::read_scope" until it's done binding the custom sampler.
+   bool find(uint64_t original_sampler, uint64_t& custom_sampler) const
+   {
+      const snapshot* samplers = active_samplers.read();
+      if (samplers == nullptr) return false;
+      const auto it = std::lower_bound(samplers->begin(), samplers->end(), original_sampler, [](const auto& entry, uint64_t handle) { return entry.first < handle; });
+      if (it == samplers->end() || it->first != original_sampler) return false;
+      custom_sampler = it->second;
+      return true;
+   }
+
+   // Starts tracking a new original sampler, creating its custom version for the active LOD bias
+   void add(uint64_t original_sampler, create_function create)
+   {
+      const std::lock_guard lock(mutex);
+      samplers_by_original_sampler[original_sampler][active_lod_bias_key] = create(reinterpret_cast<ID3D11SamplerState*>(original_sampler), quantize_lod_bias(active_lod_bias));
+      publish();
+   }
+
+   void remove(uint64_t original_sampler)
+   {
+      const std::lock_guard lock(mutex);
+      const auto it = samplers_by_original_sampler.find(original_sampler);
+      if (it == samplers_by_original_sampler.end()) return;
+      for (auto& custom_sampler : it->second)
+      {
+         retire(custom_sampler.second);
+      }
+      samplers_by_original_sampler.erase(it);
+      publish();
+   }
+
+   // Returns true if the sampler is one of our custom ones (e.g. in case its creation was captured as if it was a game sampler)
+   bool is_custom_sampler(uint64_t sampler)
+   {
+      const std::lock_guard lock(mutex);
+      for (const auto& original_sampler : samplers_by_original_sampler)
+      {
+         for (const auto& custom_sampler : original_sampler.second)
+         {
+            if (reinterpret_cast<uint64_t>(custom_sampler.second.get()) == sampler) return true;
+         }
+      }
+      return false;
+   }
+
+   // Switches to a new LOD bias, creating all the custom samplers for it (if they weren't already), and releasing the ones of the least recently used LOD biases.
+   // Returns true if the (quantized) LOD bias changed.
+   bool set_lod_bias(float lod_bias, create_function create)
+   {
+      const int32_t lod_bias_key = get_lod_bias_key(lod_bias);
+      const std::lock_guard lock(mutex);
+      active_lod_bias = lod_bias;
+      if (lod_bias_key == active_lod_bias_key) return false;
+      active_lod_bias_key = lod_bias_key;
+
+      // Move it to the back, as the most recently used one
+      std::erase(lod_biases, lod_bias_key);
+      lod_biases.push_back(lod_bias_key);
+      while (lod_biases.size() > max_lod_biases)
+      {
+         const int32_t evicted_lod_bias_key = lod_biases.front();
+         lod_biases.erase(lod_biases.begin());
+         for (auto& original_sampler : samplers_by_original_sampler)
+         {
+            if (const auto it = original_sampler.second.find(evicted_lod_bias_key); it != original_sampler.second.end())
+            {
+               retire(it->second);
+               original_sampler.second.erase(it);
+            }
+         }
+      }
+
+      for (auto& original_sampler : samplers_by_original_sampler)
+      {
+         if (original_sampler.second.contains(lod_bias_key)) continue; // Skip the samplers that were already created for this LOD bias
+         original_sampler.second[lod_bias_key] = create(reinterpret_cast<ID3D11SamplerState*>(original_sampler.first), quantize_lod_bias(lod_bias));
+      }
+      publish();
+      return true;
+   }
+
+   // Re-creates the custom samplers for the given LOD bias (and releases all the others), e.g. if the settings they were created with changed.
+   // This also switches to the LOD bias, so there's no need to call "set_lod_bias()" too.
+   void recreate(float lod_bias, create_function create)
+   {
+      const std::lock_guard lock(mutex);
+      active_lod_bias = lod_bias;
+      active_lod_bias_key = get_lod_bias_key(lod_bias);
+      for (auto& original_sampler : samplers_by_original_sampler)
+      {
+         for (auto& custom_sampler : original_sampler.second)
+         {
+            retire(custom_sampler.second);
+         }
+         original_sampler.second.clear();
+         original_sampler.second[active_lod_bias_key] = create(reinterpret_cast<ID3D11SamplerState*>(original_sampler.first), quantize_lod_bias(active_lod_bias));
+      }
+      lod_biases.clear();
+      lod_biases.push_back(active_lod_bias_key);
+      publish();
+   }
+
+   // Stops tracking all the original samplers
+   void clear()
+   {
+      const std::lock_guard lock(mutex);
+      for (auto& original_sampler : samplers_by_original_sampler)
+      {
+         for (auto& custom_sampler : original_sampler.second)
+         {
+            retire(custom_sampler.second);
+         }
+      }
+      samplers_by_original_sampler.clear();
+      publish();
+   }
+
+   bool empty()
+   {
+      const std::lock_guard lock(mutex);
+      return samplers_by_original_sampler.empty();
+   }
+
+   // Number of custom samplers alive (excluding the retired ones), it's bound by the number of original samplers times "max_lod_biases"
+   size_t get_custom_samplers_count()
+   {
+      const std::lock_guard lock(mutex);
+      size_t count = 0;
+      for (const auto& original_sampler : samplers_by_original_sampler)
+      {
+         // Samplers that don't need to be replaced have a null custom sampler
+         count += std::count_if(original_sampler.second.begin(), original_sampler.second.end(), [](const auto& custom_sampler) { return custom_sampler.second.get() != nullptr; });
+      }
+      return count;
+   }
+
+private:
+   // Original sampler and custom sampler handles, sorted by the original one
+   using snapshot = std::vector<std::pair<uint64_t, uint64_t>>;
+
+   static int32_t get_lod_bias_key(float lod_bias)
+   {
+      return int32_t(std::lround(lod_bias / lod_bias_step));
+   }
+
+   // Expects "mutex" to already be locked
+   void publish()
+   {
+      snapshot* samplers = new snapshot();
+      samplers->reserve(samplers_by_original_sampler.size());
+      for (const auto& original_sampler : samplers_by_original_sampler)
+      {
+         const auto it = original_sampler.second.find(active_lod_bias_key);
+         samplers->emplace_back(original_sampler.first, it != original_sampler.second.end() ? reinterpret_cast<uint64_t>(it->second.get()) : 0);
+      }
+      std::sort(samplers->begin(), samplers->end());
+      active_samplers.publish(samplers, domain);
+   }
+
+   // Samplers can still be in use by lock free readers (that are about to bind them), so they can't be released immediately
+   void retire(com_ptr<ID3D11SamplerState>& sampler)
+   {
+      if (sampler.get() == nullptr) return;
+      domain.retire(new com_ptr<ID3D11SamplerState>(std::move(sampler)));
+   }
+
+   rcu_domain& domain;
+   std::mutex mutex;
+   // By original sampler handle and by LOD bias key
+   std::unordered_map<uint64_t, std::unordered_map<int32_t, com_ptr<ID3D11SamplerState>>> samplers_by_original_sampler;
+   // The keys of the LOD biases that have custom samplers, from the least to the most recently used
+   std::vector<int32_t> lod_biases;
+   int32_t active_lod_bias_key = 0;
+   float active_lod_bias = 0.f;
+   rcu_snapshot<snapshot> active_samplers;
+};
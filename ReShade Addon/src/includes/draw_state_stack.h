@@ -0,0 +1,277 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include <source/com_ptr.hpp>
+
+// Caches all the states we might need to modify to draw a simple pixel shader (e.g. our custom passes on present), and restores them afterwards.
+// States are only retrieved from the device context the first time they are needed (when they are set through the "set_*()" functions, or explicitly through "cache()"),
+// the "set_*()" functions skip setting the states that already had the same value, and only the states that have actually been changed are restored.
+// D3D11 has no cheaper way of knowing the current states: shadowing them from the ReShade bind events would add a callback to every single bind of the game (on every command list),
+// for passes that only run once or twice per frame, and it'd miss the states that were set before the addon was loaded, or reset by "ClearState()".
+// States changed directly on the device context need to be cached first and then flagged with "mark_dirty()".
+// Call "restore()" once done (or let it go out of scope, which doesn't restore anything).
+// Not thread safe (like the device context it's used with).
+class draw_state_stack
+{
+public:
+   enum state : uint32_t
+   {
+      state_none = 0,
+      state_blend = 1 << 0,
+      state_primitive_topology = 1 << 1,
+      state_scissor_rects = 1 << 2,
+      state_viewports = 1 << 3,
+      state_shader_resources = 1 << 4, // Only the first pixel shader slot
+      state_constant_buffers = 1 << 5, // Only the two pixel shader slots given on construction
+      state_render_targets = 1 << 6,
+      state_vertex_shader = 1 << 7,
+      state_pixel_shader = 1 << 8,
+      state_all = (1 << 9) - 1,
+   };
+
+   // "constant_buffer_1_index" and "constant_buffer_2_index" are the pixel shader cbuffer slots we might change (e.g. the ones of our custom cbuffers)
+   draw_state_stack(UINT in_constant_buffer_1_index, UINT in_constant_buffer_2_index) : constant_buffer_1_index(in_constant_buffer_1_index), constant_buffer_2_index(in_constant_buffer_2_index) {}
+   draw_state_stack(const draw_state_stack&) = delete;
+   draw_state_stack& operator=(const draw_state_stack&) = delete;
+   ~draw_state_stack() { release_render_targets(); }
+
+   // Caches aside the current states (the ones that weren't already), this is only needed for states that will be read or changed directly
+   void cache(ID3D11DeviceContext* device_context, uint32_t states)
+   {
+      states &= ~cached_states;
+      cached_states |= states;
+      if (states & state_blend)
+      {
+         device_context->OMGetBlendState(&blend_state, blend_factor, &blend_sample_mask);
+      }
+      if (states & state_primitive_topology)
+      {
+         device_context->IAGetPrimitiveTopology(&primitive_topology);
+      }
+      if (states & state_scissor_rects)
+      {
+         scissor_rects_num = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+         device_context->RSGetScissorRects(&scissor_rects_num, nullptr); // This will get the number of scissor rects used
+         if (scissor_rects_num > 0)
+         {
+            device_context->RSGetScissorRects(&scissor_rects_num, &scissor_rects[0]);
+         }
+      }
+      if (states & state_viewports)
+      {
+         viewports_num = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+         device_context->RSGetViewports(&viewports_num, nullptr); // This will get the number of viewports used
+         if (viewports_num > 0)
+         {
+            device_context->RSGetViewports(&viewports_num, &viewports[0]);
+         }
+      }
+      if (states & state_shader_resources)
+      {
+         device_context->PSGetShaderResources(0, 1, &shader_resource_view);
+      }
+      if (states & state_constant_buffers)
+      {
+         device_context->PSGetConstantBuffers(constant_buffer_1_index, 1, &constant_buffer_1);
+         device_context->PSGetConstantBuffers(constant_buffer_2_index, 1, &constant_buffer_2);
+      }
+      if (states & state_render_targets)
+      {
+         device_context->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, &render_target_views[0], &depth_stencil_view);
+      }
+      // Shader class instances are not used by Prey's CryEngine, so they are ignored
+      if (states & state_vertex_shader)
+      {
+         device_context->VSGetShader(&vs, nullptr, nullptr);
+      }
+      if (states & state_pixel_shader)
+      {
+         device_context->PSGetShader(&ps, nullptr, nullptr);
+      }
+   }
+
+   // The render target view that was bound in the given slot (if any)
+   ID3D11RenderTargetView* get_render_target_view(ID3D11DeviceContext* device_context, UINT index)
+   {
+      cache(device_context, state_render_targets);
+      return render_target_views[index];
+   }
+
+   void mark_dirty(uint32_t states)
+   {
+      assert((states & ~cached_states) == 0); // They wouldn't be restored
+      dirty_states |= states & cached_states;
+   }
+
+   // Set the new resources/states, only if they are different from the cached ones (or from the ones previously set through these):
+
+   void set_blend_state(ID3D11DeviceContext* device_context, ID3D11BlendState* new_blend_state, const FLOAT new_blend_factor[4], UINT new_blend_sample_mask)
+   {
+      cache(device_context, state_blend);
+      if ((dirty_states & state_blend) == 0 && blend_state.get() == new_blend_state && std::memcmp(blend_factor, new_blend_factor, sizeof(blend_factor)) == 0 && blend_sample_mask == new_blend_sample_mask) return;
+      device_context->OMSetBlendState(new_blend_state, new_blend_factor, new_blend_sample_mask);
+      dirty_states |= state_blend;
+   }
+
+   void set_primitive_topology(ID3D11DeviceContext* device_context, D3D11_PRIMITIVE_TOPOLOGY new_primitive_topology)
+   {
+      cache(device_context, state_primitive_topology);
+      if ((dirty_states & state_primitive_topology) == 0 && primitive_topology == new_primitive_topology) return;
+      device_context->IASetPrimitiveTopology(new_primitive_topology);
+      dirty_states |= state_primitive_topology;
+   }
+
+   // Only supports clearing them
+   void clear_scissor_rects(ID3D11DeviceContext* device_context)
+   {
+      cache(device_context, state_scissor_rects);
+      if ((dirty_states & state_scissor_rects) == 0 && scissor_rects_num == 0) return;
+      device_context->RSSetScissorRects(0, nullptr);
+      dirty_states |= state_scissor_rects;
+   }
+
+   void set_viewport(ID3D11DeviceContext* device_context, const D3D11_VIEWPORT& new_viewport)
+   {
+      cache(device_context, state_viewports);
+      if ((dirty_states & state_viewports) == 0 && viewports_num == 1 && std::memcmp(&viewports[0], &new_viewport, sizeof(new_viewport)) == 0) return;
+      device_context->RSSetViewports(1, &new_viewport);
+      dirty_states |= state_viewports;
+   }
+
+   void set_ps_shader_resource(ID3D11DeviceContext* device_context, ID3D11ShaderResourceView* new_shader_resource_view)
+   {
+      cache(device_context, state_shader_resources);
+      if ((dirty_states & state_shader_resources) == 0 && shader_resource_view.get() == new_shader_resource_view) return;
+      device_context->PSSetShaderResources(0, 1, &new_shader_resource_view);
+      dirty_states |= state_shader_resources;
+   }
+
+   // Sets a single render target (without depth)
+   void set_render_target(ID3D11DeviceContext* device_context, ID3D11RenderTargetView* new_render_target_view)
+   {
+      cache(device_context, state_render_targets);
+      bool same_render_targets = (dirty_states & state_render_targets) == 0 && render_target_views[0] == new_render_target_view && depth_stencil_view.get() == nullptr;
+      for (UINT i = 1; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT && same_render_targets; i++)
+      {
+         same_render_targets = render_target_views[i] == nullptr;
+      }
+      if (same_render_targets) return;
+      device_context->OMSetRenderTargets(1, &new_render_target_view, nullptr);
+      dirty_states |= state_render_targets;
+   }
+
+   void set_shaders(ID3D11DeviceContext* device_context, ID3D11VertexShader* new_vs, ID3D11PixelShader* new_ps)
+   {
+      cache(device_context, state_vertex_shader | state_pixel_shader);
+      if ((dirty_states & state_vertex_shader) != 0 || vs.get() != new_vs)
+      {
+         device_context->VSSetShader(new_vs, nullptr, 0);
+         dirty_states |= state_vertex_shader;
+      }
+      if ((dirty_states & state_pixel_shader) != 0 || ps.get() != new_ps)
+      {
+         device_context->PSSetShader(new_ps, nullptr, 0);
+         dirty_states |= state_pixel_shader;
+      }
+   }
+
+   // Restore the previous resources/states (only the ones that changed), the stack can then be used again
+   void restore(ID3D11DeviceContext* device_context)
+   {
+      if (dirty_states & state_blend)
+      {
+         device_context->OMSetBlendState(blend_state.get(), blend_factor, blend_sample_mask);
+      }
+      if (dirty_states & state_primitive_topology)
+      {
+         device_context->IASetPrimitiveTopology(primitive_topology);
+      }
+      if (dirty_states & state_scissor_rects)
+      {
+         device_context->RSSetScissorRects(scissor_rects_num, &scissor_rects[0]);
+      }
+      if (dirty_states & state_viewports)
+      {
+         device_context->RSSetViewports(viewports_num, &viewports[0]);
+      }
+      if (dirty_states & state_shader_resources)
+      {
+         ID3D11ShaderResourceView* const shader_resource_view_const = shader_resource_view.get();
+         device_context->PSSetShaderResources(0, 1, &shader_resource_view_const);
+      }
+      if (dirty_states & state_constant_buffers)
+      {
+         ID3D11Buffer* constant_buffer_const = constant_buffer_1.get();
+         device_context->PSSetConstantBuffers(constant_buffer_1_index, 1, &constant_buffer_const);
+         constant_buffer_const = constant_buffer_2.get();
+         device_context->PSSetConstantBuffers(constant_buffer_2_index, 1, &constant_buffer_const);
+      }
+      if (dirty_states & state_render_targets)
+      {
+         device_context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, &render_target_views[0], depth_stencil_view.get());
+      }
+      if (dirty_states & state_vertex_shader)
+      {
+         device_context->VSSetShader(vs.get(), nullptr, 0);
+      }
+      if (dirty_states & state_pixel_shader)
+      {
+         device_context->PSSetShader(ps.get(), nullptr, 0);
+      }
+
+      // Don't keep the game resources alive
+      dirty_states = state_none;
+      cached_states = state_none;
+      blend_state = nullptr;
+      vs = nullptr;
+      ps = nullptr;
+      depth_stencil_view = nullptr;
+      shader_resource_view = nullptr;
+      constant_buffer_1 = nullptr;
+      constant_buffer_2 = nullptr;
+      release_render_targets();
+   }
+
+   uint32_t get_cached_states() const { return cached_states; }
+   uint32_t get_dirty_states() const { return dirty_states; }
+
+private:
+   void release_render_targets()
+   {
+      for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+      {
+         if (render_target_views[i] != nullptr)
+         {
+            render_target_views[i]->Release();
+            render_target_views[i] = nullptr;
+         }
+      }
+   }
+
+   const UINT constant_buffer_1_index;
+   const UINT constant_buffer_2_index;
+
+   com_ptr<ID3D11BlendState> blend_state;
+   FLOAT blend_factor[4] = { 1.f, 1.f, 1.f, 1.f };
+   UINT blend_sample_mask = 0xFFFFFFFF;
+   com_ptr<ID3D11VertexShader> vs;
+   com_ptr<ID3D11PixelShader> ps;
+   D3D11_PRIMITIVE_TOPOLOGY primitive_topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+   ID3D11RenderTargetView* render_target_views[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+   com_ptr<ID3D11DepthStencilView> depth_stencil_view;
+   com_ptr<ID3D11ShaderResourceView> shader_resource_view;
+   com_ptr<ID3D11Buffer> constant_buffer_1;
+   com_ptr<ID3D11Buffer> constant_buffer_2;
+   D3D11_RECT scissor_rects[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+   UINT scissor_rects_num = 0;
+   D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+   UINT viewports_num = 0;
+
+   uint32_t cached_states = state_none;
+   uint32_t dirty_states = state_none;
+};
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+// Binary capture of the (ReShade) events the addon receives within a frame, so the hooks logic can be replayed (and profiled) offline, without the game (nor a GPU).
+// The file is a "FrameCaptureFileHeader" followed by a sequence of events, each made of a "FrameCaptureEventHeader" and its payload,
+// which is one of the fixed size "FrameCapture*" structs below (matching the event type), optionally followed by some variable size data (e.g. shader hashes or cbuffer data).
+// Handles (pipelines, resources, command lists) are captured as they were in the game, they are only meant to be used as unique identifiers.
+// All the values are little endian, and the structs have no implicit padding, so they can be written and read back directly.
+
+enum class FrameCaptureEvent : uint8_t
+{
+   // Pipelines created before the capture started are also written (at its beginning), so all the pipelines used in the frame are known
+   InitPipeline,
+   BindPipeline,
+   Draw,
+   DrawIndexed,
+   Dispatch,
+   // The original data the game wrote in the global per view cbuffer (cb13)
+   UnmapGlobalCBuffer,
+   CopyResource,
+   // Last event of every capture
+   Present,
+
+   Count
+};
+
+struct FrameCaptureFileHeader
+{
+   static constexpr char expected_magic[8] = { 'L', 'U', 'M', 'A', 'C', 'A', 'P', '\0' };
+   static constexpr uint32_t expected_version = 2;
+
+   char magic[8];
+   uint32_t version;
+   uint32_t events_count;
+};
+
+struct FrameCaptureEventHeader
+{
+   FrameCaptureEvent type;
+   uint8_t padding[3];
+   uint32_t size; // Of the payload (including the variable size data)
+};
+
+// Followed by "shader_hashes_count" uint32_t hashes
+struct FrameCaptureInitPipeline
+{
+   uint64_t pipeline;
+   uint32_t subobject_types_mask; // Bit per "reshade::api::pipeline_subobject_type"
+   uint32_t shader_hashes_count;
+};
+
+struct FrameCaptureBindPipeline
+{
+   uint64_t command_list;
+   uint64_t pipeline;
+   uint32_t stages; // "reshade::api::pipeline_stage"
+   uint32_t padding;
+};
+
+// Used by both "Draw" and "DrawIndexed" (which use the index fields, and "vertex_offset")
+struct FrameCaptureDraw
+{
+   uint64_t command_list;
+   uint32_t vertex_or_index_count;
+   uint32_t instance_count;
+   uint32_t first_vertex_or_index;
+   int32_t vertex_offset;
+   uint32_t first_instance;
+   uint32_t padding;
+};
+
+struct FrameCaptureDispatch
+{
+   uint64_t command_list;
+   uint32_t group_count_x;
+   uint32_t group_count_y;
+   uint32_t group_count_z;
+   uint32_t padding;
+};
+
+// Followed by "size" bytes of cbuffer data
+struct FrameCaptureUnmapGlobalCBuffer
+{
+   uint64_t buffer;
+   uint32_t size;
+   uint32_t is_main_view; // Whether the addon accepted it as the main view cbuffer when it was captured
+};
+
+struct FrameCaptureCopyResource
+{
+   uint64_t command_list;
+   uint64_t source;
+   uint64_t dest;
+};
+
+struct FrameCapturePresent
+{
+   uint64_t frame_index;
+   uint32_t drawn_passes; // The passes that the addon detected in the captured frame (bit per "FramePass")
+   uint32_t padding;
+};
+
+static_assert(sizeof(FrameCaptureFileHeader) == 16 && sizeof(FrameCaptureEventHeader) == 8);
+static_assert(sizeof(FrameCaptureInitPipeline) == 16 && sizeof(FrameCaptureBindPipeline) == 24 && sizeof(FrameCaptureDraw) == 32 && sizeof(FrameCaptureDispatch) == 24);
+static_assert(sizeof(FrameCaptureUnmapGlobalCBuffer) == 16 && sizeof(FrameCaptureCopyResource) == 24 && sizeof(FrameCapturePresent) == 16);
+
+// Records the events of a capture in memory, and writes them to a file once it ends.
+// Thread safe (events can come from any thread, they are serialized in the order they are written).
+class frame_capture_writer
+{
+public:
+   void begin()
+   {
+      const std::lock_guard lock(mutex);
+      data.clear();
+      events_count = 0;
+      capturing.store(true, std::memory_order_release);
+   }
+
+   // Cheap check to do before building any event
+   bool is_capturing() const
+   {
+      return capturing.load(std::memory_order_relaxed);
+   }
+
+   template<typename T>
+   void write(FrameCaptureEvent type, const T& payload, const void* extra_data = nullptr, uint32_t extra_data_size = 0)
+   {
+      static_assert(std::is_trivially_copyable_v<T>);
+      const FrameCaptureEventHeader header = { type, {}, uint32_t(sizeof(T)) + extra_data_size };
+      const std::lock_guard lock(mutex);
+      if (!capturing.load(std::memory_order_relaxed)) return;
+      append(&header, sizeof(header));
+      append(&payload, sizeof(T));
+      if (extra_data_size != 0) append(extra_data, extra_data_size);
+      events_count++;
+   }
+
+   // Stops capturing and writes the file. Returns false if it failed (or if no capture was running).
+   bool end(const std::filesystem::path& path)
+   {
+      const std::lock_guard lock(mutex);
+      if (!capturing.exchange(false, std::memory_order_acq_rel)) return false;
+      FrameCaptureFileHeader header = {};
+      std::memcpy(header.magic, FrameCaptureFileHeader::expected_magic, sizeof(header.magic));
+      header.version = FrameCaptureFileHeader::expected_version;
+      header.events_count = events_count;
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      if (!file) return false;
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+      data = {}; // Release the memory, captures can be big
+      return bool(file);
+   }
+
+private:
+   // Expects "mutex" to be locked
+   void append(const void* source, size_t size)
+   {
+      const size_t offset = data.size();
+      data.resize(offset + size);
+      std::memcpy(data.data() + offset, source, size);
+   }
+
+   std::mutex mutex;
+   std::vector<uint8_t> data;
+   uint32_t events_count = 0;
+   std::atomic<bool> capturing = false;
+};
+
+// Reads back a capture file, and replays its events, in order, into a handler, which needs to implement these functions:
+// "on_init_pipeline(const FrameCaptureInitPipeline&, const uint32_t* shader_hashes)", "on_bind_pipeline(const FrameCaptureBindPipeline&)", "on_draw(const FrameCaptureDraw&, bool indexed)",
+// "on_dispatch(const FrameCaptureDispatch&)", "on_unmap_global_cbuffer(const FrameCaptureUnmapGlobalCBuffer&, const void* data)", "on_copy_resource(const FrameCaptureCopyResource&)", "on_present(const FrameCapturePresent&)".
+// The capture is fully validated before any event is replayed, so handlers never receive partial or out of bounds data.
+class frame_capture_reader
+{
+public:
+   bool open(const std::filesystem::path& path)
+   {
+      data.clear();
+      std::ifstream file(path, std::ios::binary | std::ios::ate);
+      if (!file) return false;
+      const std::streamsize file_size = file.tellg();
+      if (file_size < std::streamsize(sizeof(FrameCaptureFileHeader))) return false;
+      data.resize(size_t(file_size));
+      file.seekg(0, std::ios::beg).read(reinterpret_cast<char*>(data.data()), file_size);
+      if (!file || !validate())
+      {
+         data.clear();
+         return false;
+      }
+      return true;
+   }
+
+   uint32_t get_events_count() const
+   {
+      if (data.empty()) return 0;
+      FrameCaptureFileHeader header;
+      std::memcpy(&header, data.data(), sizeof(header));
+      return header.events_count;
+   }
+
+   template<typename Handler>
+   void replay(Handler& handler) const
+   {
+      if (data.empty()) return;
+      for (size_t offset = sizeof(FrameCaptureFileHeader); offset < data.size();)
+      {
+         FrameCaptureEventHeader header;
+         std::memcpy(&header, data.data() + offset, sizeof(header));
+         const uint8_t* payload = data.data() + offset + sizeof(header);
+         offset += sizeof(header) + header.size;
+         switch (header.type)
+         {
+         case FrameCaptureEvent::InitPipeline:
+         {
+            const auto event = read<FrameCaptureInitPipeline>(payload);
+            // Copy the hashes out as the payload isn't necessarily aligned
+            std::vector<uint32_t> shader_hashes(event.shader_hashes_count);
+            if (!shader_hashes.empty()) std::memcpy(shader_hashes.data(), payload + sizeof(event), shader_hashes.size() * sizeof(uint32_t));
+            handler.on_init_pipeline(event, shader_hashes.data());
+            break;
+         }
+         case FrameCaptureEvent::BindPipeline: handler.on_bind_pipeline(read<FrameCaptureBindPipeline>(payload)); break;
+         case FrameCaptureEvent::Draw: handler.on_draw(read<FrameCaptureDraw>(payload), false); break;
+         case FrameCaptureEvent::DrawIndexed: handler.on_draw(read<FrameCaptureDraw>(payload), true); break;
+         case FrameCaptureEvent::Dispatch: handler.on_dispatch(read<FrameCaptureDispatch>(payload)); break;
+         case FrameCaptureEvent::UnmapGlobalCBuffer:
+         {
+            const auto event = read<FrameCaptureUnmapGlobalCBuffer>(payload);
+            handler.on_unmap_global_cbuffer(event, payload + sizeof(event));
+            break;
+         }
+         case FrameCaptureEvent::CopyResource: handler.on_copy_resource(read<FrameCaptureCopyResource>(payload)); break;
+         case FrameCaptureEvent::Present: handler.on_present(read<FrameCapturePresent>(payload)); break;
+         default: break; // Unreachable, the capture was validated
+         }
+      }
+   }
+
+private:
+   template<typename T>
+   static T read(const uint8_t* source)
+   {
+      T value;
+      std::memcpy(&value, source, sizeof(T));
+      return value;
+   }
+
+   static uint32_t get_payload_size(FrameCaptureEvent type)
+   {
+      switch (type)
+      {
+      case FrameCaptureEvent::InitPipeline: return sizeof(FrameCaptureInitPipeline);
+      case FrameCaptureEvent::BindPipeline: return sizeof(FrameCaptureBindPipeline);
+      case FrameCaptureEvent::Draw: case FrameCaptureEvent::DrawIndexed: return sizeof(FrameCaptureDraw);
+      case FrameCaptureEvent::Dispatch: return sizeof(FrameCaptureDispatch);
+      case FrameCaptureEvent::UnmapGlobalCBuffer: return sizeof(FrameCaptureUnmapGlobalCBuffer);
+      case FrameCaptureEvent::CopyResource: return sizeof(FrameCaptureCopyResource);
+      case FrameCaptureEvent::Present: return sizeof(FrameCapturePresent);
+      default: return 0;
+      }
+   }
+
+   bool validate() const
+   {
+      FrameCaptureFileHeader file_header;
+      std::memcpy(&file_header, data.data(), sizeof(file_header));
+      if (std::memcmp(file_header.magic, FrameCaptureFileHeader::expected_magic, sizeof(file_header.magic)) != 0 || file_header.version != FrameCaptureFileHeader::expected_version) return false;
+
+      uint32_t events_count = 0;
+      for (size_t offset = sizeof(FrameCaptureFileHeader); offset < data.size(); events_count++)
+      {
+         if (data.size() - offset < sizeof(FrameCaptureEventHeader)) return false;
+         FrameCaptureEventHeader header;
+         std::memcpy(&header, data.data() + offset, sizeof(header));
+         offset += sizeof(header);
+         const uint32_t payload_size = get_payload_size(header.type);
+         if (payload_size == 0 || header.size < payload_size || data.size() - offset < header.size) return false;
+
+         // Check that the variable size data matches what the payload says
+         uint64_t expected_size = payload_size;
+         if (header.type == FrameCaptureEvent::InitPipeline) expected_size += uint64_t(read<FrameCaptureInitPipeline>(data.data() + offset).shader_hashes_count) * sizeof(uint32_t);
+         else if (header.type == FrameCaptureEvent::UnmapGlobalCBuffer) expected_size += read<FrameCaptureUnmapGlobalCBuffer>(data.data() + offset).size;
+         if (header.size != expected_size) return false;
+         offset += header.size;
+      }
+      return events_count == file_header.events_count;
+   }
+
+   std::vector<uint8_t> data;
+};
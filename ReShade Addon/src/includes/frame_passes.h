@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <string>
+
+// The game (and custom) passes we detect within a frame, that we need to know the progress of (e.g. to know whether we are before or after tonemapping)
+enum class FramePass : uint8_t
+{
+   SSAO,
+   SSAODenoise,
+   SSR,
+   SSRBlend,
+   ComposedGBuffers,
+   Tonemapping,
+   MotionBlur,
+   DLSS_SR,
+   MainPostProcessing,
+   Upscaling,
+
+   Count
+};
+
+constexpr uint32_t FramePassBit(FramePass pass)
+{
+   return 1u << uint32_t(pass);
+}
+
+struct FramePassDesc
+{
+   const char* name;
+   // Passes that are expected to have already been drawn in the frame when this pass draws
+   uint32_t required_passes;
+   // Passes that are expected to draw after this pass (they shouldn't have drawn yet)
+   uint32_t following_passes;
+};
+
+// The known order of passes in Prey (CryEngine), by "FramePass".
+// Some passes can be skipped (e.g. motion blur is a user setting, upscaling only happens with dynamic resolution scaling, and DLSS replaces TAA), so only their relative order is described.
+constexpr FramePassDesc frame_passes_descs[] = {
+   { "SSAO", 0, FramePassBit(FramePass::ComposedGBuffers) },
+   { "SSAO Denoise", FramePassBit(FramePass::SSAO), FramePassBit(FramePass::ComposedGBuffers) },
+   { "SSR", 0, FramePassBit(FramePass::ComposedGBuffers) },
+   { "SSR Blend", FramePassBit(FramePass::SSR), FramePassBit(FramePass::Tonemapping) },
+   { "Composed GBuffers", 0, FramePassBit(FramePass::Tonemapping) | FramePassBit(FramePass::MainPostProcessing) },
+   { "Tonemapping", FramePassBit(FramePass::ComposedGBuffers), FramePassBit(FramePass::DLSS_SR) | FramePassBit(FramePass::MainPostProcessing) },
+   { "Motion Blur", FramePassBit(FramePass::ComposedGBuffers), FramePassBit(FramePass::MainPostProcessing) },
+   { "DLSS SR", FramePassBit(FramePass::ComposedGBuffers) | FramePassBit(FramePass::Tonemapping), FramePassBit(FramePass::MainPostProcessing) },
+   { "Main Post Processing", FramePassBit(FramePass::ComposedGBuffers), FramePassBit(FramePass::Upscaling) },
+   { "Upscaling", FramePassBit(FramePass::MainPostProcessing), 0 },
+};
+static_assert(std::size(frame_passes_descs) == size_t(FramePass::Count));
+
+// Tracks which passes have been drawn in the current (and previous) frame, validating them against the known passes order ("frame_passes_descs").
+// Passes that draw out of order, or more than once in the same frame, are counted as anomalies (they'd usually mean that some of our passes detection failed, or that we are wasting GPU time).
+// The sequence of passes drawn in the last frame is also recorded, for debugging.
+// Thread safe (passes can be marked from any thread), though "end_frame()" is expected to be called from a single thread.
+class frame_pass_tracker
+{
+public:
+   // Passes beyond this number within a single frame aren't recorded in the sequence
+   static constexpr uint32_t max_sequence_passes = 32;
+
+   bool has_drawn(FramePass pass) const
+   {
+      return (drawn_passes.load(std::memory_order_acquire) & FramePassBit(pass)) != 0;
+   }
+
+   bool has_drawn_previous(FramePass pass) const
+   {
+      return (previous_drawn_passes.load(std::memory_order_acquire) & FramePassBit(pass)) != 0;
+   }
+
+   // Bit per "FramePass"
+   uint32_t get_previous_drawn_passes() const
+   {
+      return previous_drawn_passes.load(std::memory_order_acquire);
+   }
+
+   // Callers are expected to check "has_drawn()" beforehand, passes drawn twice in the same frame count as anomalies
+   void mark_drawn(FramePass pass)
+   {
+      const uint32_t prev_drawn_passes = drawn_passes.fetch_or(FramePassBit(pass), std::memory_order_acq_rel);
+      const FramePassDesc& desc = frame_passes_descs[size_t(pass)];
+      const bool already_drawn = (prev_drawn_passes & FramePassBit(pass)) != 0;
+      if (already_drawn || (prev_drawn_passes & desc.required_passes) != desc.required_passes || (prev_drawn_passes & desc.following_passes) != 0)
+      {
+         anomalies++;
+         anomalous_passes.fetch_or(FramePassBit(pass), std::memory_order_relaxed);
+      }
+      const uint32_t sequence_index = sequence_size.fetch_add(1, std::memory_order_relaxed);
+      if (sequence_index < max_sequence_passes)
+      {
+         sequence[sequence_index].store(pass, std::memory_order_relaxed);
+      }
+   }
+
+   // Call this once per frame (e.g. on present)
+   void end_frame()
+   {
+      previous_drawn_passes.store(drawn_passes.exchange(0, std::memory_order_acq_rel), std::memory_order_release);
+      previous_anomalous_passes.store(anomalous_passes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+
+      // Only copy the passes here, the (debug) string is built on demand
+      previous_sequence_size = sequence_size.exchange(0, std::memory_order_relaxed);
+      for (uint32_t i = 0; i < previous_sequence_size && i < max_sequence_passes; i++)
+      {
+         previous_sequence[i] = sequence[i].load(std::memory_order_relaxed);
+      }
+   }
+
+   // Only call from the same thread that calls "end_frame()"
+   std::string get_previous_sequence() const
+   {
+      std::string sequence_string;
+      for (uint32_t i = 0; i < previous_sequence_size && i < max_sequence_passes; i++)
+      {
+         if (i != 0) sequence_string += " > ";
+         sequence_string += frame_passes_descs[size_t(previous_sequence[i])].name;
+      }
+      if (previous_sequence_size > max_sequence_passes) sequence_string += " > ...";
+      return sequence_string;
+   }
+
+   // Passes that drew out of order (or more than once) in the previous frame
+   uint32_t get_previous_anomalous_passes() const
+   {
+      return previous_anomalous_passes.load(std::memory_order_relaxed);
+   }
+
+   uint64_t get_anomalies_count() const
+   {
+      return anomalies.load(std::memory_order_relaxed);
+   }
+
+private:
+   std::atomic<uint32_t> drawn_passes = 0;
+   std::atomic<uint32_t> previous_drawn_passes = 0;
+   std::atomic<uint32_t> anomalous_passes = 0;
+   std::atomic<uint32_t> previous_anomalous_passes = 0;
+   std::atomic<uint64_t> anomalies = 0;
+   std::atomic<FramePass> sequence[max_sequence_passes] = {};
+   std::atomic<uint32_t> sequence_size = 0;
+   FramePass previous_sequence[max_sequence_passes] = {};
+   uint32_t previous_sequence_size = 0;
+};
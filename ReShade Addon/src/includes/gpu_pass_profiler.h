@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+
+#include <include/reshade.hpp>
+
+#include "gpu_pass_timings.h"
+
+// GPU timestamps profiler of the frame passes, to compare the cost of our custom passes with the vanilla ones.
+// The frame is split in sections by "mark()" calls (e.g. on every detected pass), each section lasts until the next mark (or until the end of the frame).
+// Timestamps are written in a ReShade query heap, with a slice of it per frame in flight, and read back with a few frames of latency (without ever stalling), into "gpu_pass_timings".
+// ReShade only exposes the timestamps frequency (not whether it changed within a frame), so frames during which the GPU clock changed can't be detected (they only skew a single sample).
+// Only the immediate command list can be profiled (commands of deferred ones would be profiled when they are executed).
+// Not thread safe (it's meant to be used by the thread that owns the immediate command list).
+class gpu_pass_profiler
+{
+public:
+   static constexpr size_t frames_latency = 4;
+   static constexpr size_t max_marks = 32;
+   static constexpr uint32_t timestamps_per_frame = max_marks + 1;
+
+   // Starts a new section (the name needs to be a static string)
+   void mark(reshade::api::command_list* cmd_list, const char* name)
+   {
+      frame& frame = frames[next_frame];
+      if (!frame.running && !begin_frame(cmd_list->get_device(), frame)) return;
+      if (frame.marks_count >= max_marks) return;
+      cmd_list->end_query(query_heap, reshade::api::query_type::timestamp, query_index(next_frame, frame.marks_count));
+      frame.names[frame.marks_count] = name;
+      frame.marks_count++;
+   }
+
+   // Call this once per frame (e.g. on present, after everything has been drawn), it also starts the next frame
+   void end_frame(reshade::api::command_queue* queue, const char* next_frame_first_section_name)
+   {
+      reshade::api::command_list* const cmd_list = queue->get_immediate_command_list();
+      frame& frame = frames[next_frame];
+      if (frame.running)
+      {
+         cmd_list->end_query(query_heap, reshade::api::query_type::timestamp, query_index(next_frame, frame.marks_count));
+         frame.running = false;
+         frame.pending = true;
+         next_frame = (next_frame + 1) % frames_latency;
+      }
+      resolve(queue->get_device(), queue->get_timestamp_frequency());
+
+      // If the GPU is still behind by "frames_latency" frames, we drop the oldest one
+      if (frames[next_frame].pending)
+      {
+         frames[next_frame].pending = false;
+         dropped_frames++;
+      }
+      mark(cmd_list, next_frame_first_section_name);
+   }
+
+   // Destroys the query heap and clears all the results (frames still in flight are discarded). Needs to be called before the device is destroyed.
+   void reset(reshade::api::device* device)
+   {
+      if (query_heap.handle != 0)
+      {
+         device->destroy_query_heap(query_heap);
+         query_heap = {};
+      }
+      for (auto& frame : frames)
+      {
+         frame = {};
+      }
+      next_frame = 0;
+      dropped_frames = 0;
+      timings.clear();
+   }
+
+   const gpu_pass_timings& get_timings() const
+   {
+      return timings;
+   }
+
+   uint64_t get_dropped_frames() const
+   {
+      return dropped_frames;
+   }
+
+private:
+   struct frame
+   {
+      const char* names[max_marks] = {};
+      size_t marks_count = 0;
+      bool running = false;
+      bool pending = false;
+      uint64_t frame_index = 0;
+   };
+
+   static uint32_t query_index(size_t frame_slot, size_t mark_index)
+   {
+      return uint32_t(frame_slot * timestamps_per_frame + mark_index);
+   }
+
+   bool begin_frame(reshade::api::device* device, frame& frame)
+   {
+      if (query_heap.handle == 0 && !device->create_query_heap(reshade::api::query_type::timestamp, uint32_t(frames_latency * timestamps_per_frame), &query_heap))
+      {
+         query_heap = {};
+         return false;
+      }
+      frame.marks_count = 0;
+      frame.running = true;
+      frame.pending = false;
+      frame.frame_index = frames_count++;
+      return true;
+   }
+
+   // Reads back the completed frames, from the oldest to the newest, without waiting for any of them
+   void resolve(reshade::api::device* device, uint64_t frequency)
+   {
+      for (size_t i = 0; i < frames_latency; i++)
+      {
+         const size_t frame_slot = (next_frame + i) % frames_latency;
+         frame& frame = frames[frame_slot];
+         if (!frame.pending) continue;
+
+         uint64_t timestamps[timestamps_per_frame];
+         if (!device->get_query_heap_results(query_heap, query_index(frame_slot, 0), uint32_t(frame.marks_count + 1), timestamps, sizeof(uint64_t))) return; // Newer frames can't be ready either
+         frame.pending = false;
+         timings.add_frame(frame.frame_index, frame.names, timestamps, frame.marks_count, frequency);
+      }
+   }
+
+   reshade::api::query_heap query_heap = {};
+   frame frames[frames_latency];
+   size_t next_frame = 0;
+   uint64_t frames_count = 0;
+   uint64_t dropped_frames = 0;
+   gpu_pass_timings timings;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The GPU timings of the frame passes (see "gpu_pass_profiler"), independently from the graphics API that measured them.
+// Each frame is split in sections, each lasting from its timestamp until the next one, so all the GPU time of the frame is accounted for.
+// The sections are both aggregated in rolling statistics (by name), and kept for the last few frames, to export them as a "chrome://tracing" JSON.
+// Not thread safe.
+class gpu_pass_timings
+{
+public:
+   static constexpr size_t stats_samples = 128;
+   static constexpr size_t exported_frames = 120;
+
+   struct section_statistics
+   {
+      std::string name;
+      float last_ms = 0.f;
+      float average_ms = 0.f;
+      float max_ms = 0.f;
+   };
+
+   // Adds the sections of a frame: "timestamps" has one more value than "names" (the end of the last section), in ticks of "frequency" per second (names need to be static strings).
+   // Frames with unusable timestamps (e.g. not increasing, if the GPU was reset in the middle of the frame) are discarded, returns whether the frame was added.
+   bool add_frame(uint64_t frame_index, const char* const* names, const uint64_t* timestamps, size_t sections_count, uint64_t frequency)
+   {
+      if (frequency == 0) return false;
+      for (size_t i = 0; i < sections_count; i++)
+      {
+         if (timestamps[i + 1] < timestamps[i]) return false;
+      }
+      if (base_timestamp == 0 || timestamps[0] < base_timestamp) base_timestamp = timestamps[0];
+
+      const double us_per_tick = 1000000.0 / double(frequency);
+      frame_sections& sections = history.emplace_back();
+      sections.frame_index = frame_index;
+      for (size_t i = 0; i < sections_count; i++)
+      {
+         const double duration_us = double(timestamps[i + 1] - timestamps[i]) * us_per_tick;
+         sections.sections.push_back({ names[i], double(timestamps[i] - base_timestamp) * us_per_tick, duration_us });
+         add_sample(names[i], float(duration_us / 1000.0));
+      }
+      while (history.size() > exported_frames)
+      {
+         history.pop_front();
+      }
+      return true;
+   }
+
+   // Clears all the statistics (and their samples) and history
+   void clear()
+   {
+      statistics.clear();
+      samples.clear();
+      history.clear();
+      base_timestamp = 0;
+   }
+
+   const std::vector<section_statistics>& get_statistics() const
+   {
+      return statistics;
+   }
+
+   size_t get_history_size() const
+   {
+      return history.size();
+   }
+
+   // Writes the sections of the last frames in the "Trace Event Format" (it can be opened with "chrome://tracing" or "ui.perfetto.dev")
+   bool write_chrome_trace(std::ostream& stream) const
+   {
+      stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+      bool first = true;
+      for (const auto& frame_sections : history)
+      {
+         for (const auto& section : frame_sections.sections)
+         {
+            stream << (first ? "" : ",") << "\n{\"name\":\"" << section.name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << section.start_us << ",\"dur\":" << section.duration_us
+               << ",\"args\":{\"frame\":" << frame_sections.frame_index << "}}";
+            first = false;
+         }
+      }
+      stream << "\n]}\n";
+      return bool(stream);
+   }
+
+   bool export_chrome_trace(const std::filesystem::path& path) const
+   {
+      std::ofstream file(path, std::ios::trunc);
+      return file && write_chrome_trace(file);
+   }
+
+private:
+   struct section
+   {
+      const char* name;
+      double start_us;
+      double duration_us;
+   };
+
+   struct frame_sections
+   {
+      uint64_t frame_index;
+      std::vector<section> sections;
+   };
+
+   struct section_samples
+   {
+      float values[stats_samples] = {};
+      size_t next = 0;
+   };
+
+   void add_sample(const char* name, float ms)
+   {
+      size_t index = 0;
+      while (index < statistics.size() && statistics[index].name != name) index++;
+      if (index == statistics.size())
+      {
+         statistics.emplace_back().name = name;
+         samples.emplace_back();
+      }
+      auto& section_samples = samples[index];
+      section_samples.values[section_samples.next % stats_samples] = ms;
+      section_samples.next++;
+
+      // Sections can appear more than once per frame (e.g. if a pass is marked twice), in that case they are counted as separate samples
+      auto& stats = statistics[index];
+      const size_t count = section_samples.next < stats_samples ? section_samples.next : stats_samples;
+      float total = 0.f;
+      stats.max_ms = 0.f;
+      for (size_t i = 0; i < count; i++)
+      {
+         total += section_samples.values[i];
+         stats.max_ms = section_samples.values[i] > stats.max_ms ? section_samples.values[i] : stats.max_ms;
+      }
+      stats.last_ms = ms;
+      stats.average_ms = total / float(count);
+   }
+
+   uint64_t base_timestamp = 0;
+   std::vector<section_statistics> statistics; // In order of first appearance
+   std::vector<section_samples> samples; // Same order as "statistics"
+   std::deque<frame_sections> history;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include <source/com_ptr.hpp>
+
+// Ring of staging (CPU readable) copies of a small GPU resource, to read back GPU results on the CPU without ever stalling for them.
+// Every frame a new copy is queued in the next slot, and the most recent copy that the GPU has already completed is read (which might be a few frames old, depending on how far behind the GPU is running).
+// Older completed copies are skipped, as they'd be more outdated. If the GPU is more than "slots_num" frames behind, the oldest pending copy gets overwritten.
+// Not thread safe (it's meant to be used by the immediate device context).
+template<size_t slots_num = 4>
+class gpu_readback_ring
+{
+   static_assert(slots_num >= 2);
+
+public:
+   // "desc" is the description of the staging buffers (they need to have CPU read access), "initial_data" is optional
+   bool create(ID3D11Device* device, const D3D11_BUFFER_DESC& desc, const D3D11_SUBRESOURCE_DATA* initial_data = nullptr)
+   {
+      reset();
+      for (auto& slot : slots)
+      {
+         if (FAILED(device->CreateBuffer(&desc, initial_data, &slot.buffer)))
+         {
+            reset();
+            return false;
+         }
+      }
+      return true;
+   }
+
+   void reset()
+   {
+      for (auto& slot : slots)
+      {
+         slot = {};
+      }
+      next_slot = 0;
+   }
+
+   bool is_created() const
+   {
+      return slots[0].buffer.get() != nullptr;
+   }
+
+   // Queues the copy of "source" (that needs to match the staging buffers description) in the next slot, remembering the frame it was from
+   void push(ID3D11DeviceContext* device_context, ID3D11Resource* source, uint32_t frame_index)
+   {
+      auto& slot = slots[next_slot];
+      next_slot = (next_slot + 1) % slots_num;
+      device_context->CopyResource(slot.buffer.get(), source);
+      slot.pending = true;
+      slot.frame_index = frame_index;
+   }
+
+   // Copies the data from the most recent queued copy that the GPU already completed, if any, without waiting.
+   // Call this before "push()" in a frame, to not attempt to read back the copy that was just queued (it'd never have completed yet).
+   // "latency_frames" is set to how many frames old the returned data is.
+   bool read(ID3D11DeviceContext* device_context, void* data, size_t size, uint32_t frame_index, uint32_t& latency_frames)
+   {
+      // Go from the newest to the oldest
+      for (size_t i = 1; i <= slots_num; i++)
+      {
+         const size_t slot_index = (next_slot + slots_num - i) % slots_num;
+         auto& slot = slots[slot_index];
+         if (!slot.pending) continue;
+
+         D3D11_MAPPED_SUBRESOURCE mapped_data;
+         // Fails with "DXGI_ERROR_WAS_STILL_DRAWING" if the GPU hasn't finished with it yet
+         const HRESULT hr = device_context->Map(slot.buffer.get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped_data);
+         if (FAILED(hr)) continue;
+         std::memcpy(data, mapped_data.pData, size);
+         device_context->Unmap(slot.buffer.get(), 0);
+         latency_frames = frame_index - slot.frame_index;
+
+         // This and all the older copies are now outdated
+         for (size_t j = i; j <= slots_num; j++)
+         {
+            slots[(next_slot + slots_num - j) % slots_num].pending = false;
+         }
+         return true;
+      }
+      return false;
+   }
+
+private:
+   struct slot
+   {
+      com_ptr<ID3D11Buffer> buffer;
+      uint32_t frame_index = 0;
+      bool pending = false;
+   };
+
+   slot slots[slots_num];
+   size_t next_slot = 0;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// Fixed capacity set of (non zero) handles, based on an open addressing (linear probing) hash table, meant for lookups that happen at a very high frequency (e.g. on every buffer map),
+// while insertions and removals are rare (e.g. on resources creation and destruction, of only the resources that we are interested in).
+// Lookups are lock free, and can run concurrently from any thread, insertions and removals are serialized by a mutex.
+// Keep the capacity a lot larger than the expected number of handles, so that lookups of handles that aren't in the set almost always stop at the first (empty) slot.
+// Removed handles leave a "tombstone" behind (so they don't break the probing chains of other handles), once they pile up, the table is rebuilt without them,
+// otherwise, with enough handles churn, all the empty slots would eventually become tombstones, and lookups that miss would go through the whole table.
+// The rebuild happens in a second table, which is then published, lookups that overlapped with it simply retry.
+// If the set ever gets full, it stops being reliable, "contains()" will then return "maybe" for all handles that aren't in it, and the caller is expected to fall back to a slower check.
+template<size_t capacity_pow2 = 1024>
+class handle_set
+{
+   static_assert((capacity_pow2 & (capacity_pow2 - 1)) == 0, "The capacity needs to be a power of 2");
+
+public:
+   // How many tombstones trigger a rebuild of the table, this keeps the table at least 3/4 empty (as long as the number of handles in it is small)
+   static constexpr size_t max_removed_slots = capacity_pow2 / 4;
+
+   enum class lookup_result : uint8_t
+   {
+      no,
+      yes,
+      maybe,
+   };
+
+   handle_set() = default;
+   handle_set(const handle_set&) = delete;
+   handle_set& operator=(const handle_set&) = delete;
+
+   // Handles are expected to be unique (e.g. the address of a live object), adding a handle that is already in the set does nothing (e.g. if two threads found the same handle at once)
+   void insert(uint64_t handle)
+   {
+      const std::lock_guard lock(mutex);
+      auto& table = get_active_table();
+      size_t free_slot = capacity_pow2;
+      for (size_t i = 0, slot = get_first_slot(handle); i < capacity_pow2; i++, slot = (slot + 1) & (capacity_pow2 - 1))
+      {
+         const uint64_t slot_handle = table.slots[slot].load(std::memory_order_relaxed);
+         if (slot_handle == handle) return;
+         // Re-use removed slots, anything after them in the probing chain can still be found, as removed slots don't stop lookups (though we need to go through the chain to know the handle isn't already there)
+         if (slot_handle == removed_handle && free_slot == capacity_pow2)
+         {
+            free_slot = slot;
+         }
+         else if (slot_handle == empty_handle)
+         {
+            if (free_slot == capacity_pow2) free_slot = slot;
+            break;
+         }
+      }
+      if (free_slot == capacity_pow2)
+      {
+         full = true;
+         return;
+      }
+      table.removed_slots -= table.slots[free_slot].load(std::memory_order_relaxed) == removed_handle ? 1 : 0;
+      table.slots[free_slot].store(handle, std::memory_order_release);
+   }
+
+   void erase(uint64_t handle)
+   {
+      const std::lock_guard lock(mutex);
+      auto& table = get_active_table();
+      for (size_t i = 0, slot = get_first_slot(handle); i < capacity_pow2; i++, slot = (slot + 1) & (capacity_pow2 - 1))
+      {
+         const uint64_t slot_handle = table.slots[slot].load(std::memory_order_relaxed);
+         if (slot_handle == empty_handle) return;
+         if (slot_handle == handle)
+         {
+            // Don't set the slot as empty, or we'd break the probing chain of any handle that collided with this one
+            table.slots[slot].store(removed_handle, std::memory_order_relaxed);
+            if (++table.removed_slots >= max_removed_slots)
+            {
+               rebuild();
+            }
+            return;
+         }
+      }
+   }
+
+   lookup_result contains(uint64_t handle) const
+   {
+      while (true)
+      {
+         const uint32_t generation = rebuild_generation.load(std::memory_order_acquire);
+         const auto& table = tables[active_table.load(std::memory_order_acquire)];
+         lookup_result result = full.load(std::memory_order_relaxed) ? lookup_result::maybe : lookup_result::no;
+         for (size_t i = 0, slot = get_first_slot(handle); i < capacity_pow2; i++, slot = (slot + 1) & (capacity_pow2 - 1))
+         {
+            const uint64_t slot_handle = table.slots[slot].load(std::memory_order_acquire);
+            if (slot_handle == handle)
+            {
+               result = lookup_result::yes;
+               break;
+            }
+            if (slot_handle == empty_handle) break;
+         }
+         // If a rebuild started in the meantime, the table we read might have been cleared under our feet, try again (rebuilds are rare)
+         std::atomic_thread_fence(std::memory_order_acquire);
+         if (rebuild_generation.load(std::memory_order_relaxed) == generation) return result;
+      }
+   }
+
+   // How many slots a lookup of the handle goes through (for diagnostics)
+   size_t get_probe_length(uint64_t handle) const
+   {
+      const std::lock_guard lock(mutex);
+      const auto& table = tables[active_table.load(std::memory_order_relaxed)];
+      size_t length = 0;
+      for (size_t slot = get_first_slot(handle); length < capacity_pow2; slot = (slot + 1) & (capacity_pow2 - 1))
+      {
+         length++;
+         const uint64_t slot_handle = table.slots[slot].load(std::memory_order_relaxed);
+         if (slot_handle == handle || slot_handle == empty_handle) break;
+      }
+      return length;
+   }
+
+   // Not thread safe
+   void clear()
+   {
+      for (auto& table : tables)
+      {
+         for (auto& slot : table.slots)
+         {
+            slot.store(empty_handle, std::memory_order_relaxed);
+         }
+         table.removed_slots = 0;
+      }
+      full = false;
+   }
+
+private:
+   static constexpr uint64_t empty_handle = 0;
+   static constexpr uint64_t removed_handle = ~uint64_t(0);
+
+   struct slots_table
+   {
+      std::atomic<uint64_t> slots[capacity_pow2] = {};
+      size_t removed_slots = 0; // Tombstones ("mutex")
+   };
+
+   static size_t get_first_slot(uint64_t handle)
+   {
+      // Handles are usually pointers, so their lowest bits are always zero, and the highest ones are almost always the same, mix them all up (Fibonacci hashing)
+      return size_t((handle * 0x9E3779B97F4A7C15ull) >> 32) & (capacity_pow2 - 1);
+   }
+
+   // Expects "mutex" to be locked
+   slots_table& get_active_table()
+   {
+      return tables[active_table.load(std::memory_order_relaxed)];
+   }
+
+   // Expects "mutex" to be locked.
+   // Re-inserts all the handles in the inactive table (which lookups could still be reading from, if they started before the last rebuild), and makes it the active one.
+   void rebuild()
+   {
+      const slots_table& old_table = get_active_table();
+      const uint32_t new_table_index = active_table.load(std::memory_order_relaxed) ^ 1;
+      slots_table& new_table = tables[new_table_index];
+
+      // Seqlock like: any lookup that reads a slot written after this will see the generation changed and retry
+      rebuild_generation.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      for (auto& slot : new_table.slots)
+      {
+         slot.store(empty_handle, std::memory_order_relaxed);
+      }
+      new_table.removed_slots = 0;
+      for (const auto& old_slot : old_table.slots)
+      {
+         const uint64_t handle = old_slot.load(std::memory_order_relaxed);
+         if (handle == empty_handle || handle == removed_handle) continue;
+         for (size_t slot = get_first_slot(handle);; slot = (slot + 1) & (capacity_pow2 - 1))
+         {
+            if (new_table.slots[slot].load(std::memory_order_relaxed) == empty_handle)
+            {
+               new_table.slots[slot].store(handle, std::memory_order_relaxed);
+               break;
+            }
+         }
+      }
+      active_table.store(new_table_index, std::memory_order_release);
+   }
+
+   slots_table tables[2];
+   std::atomic<uint32_t> active_table = 0;
+   std::atomic<uint32_t> rebuild_generation = 0;
+   std::atomic<bool> full = false;
+   mutable std::mutex mutex;
+};
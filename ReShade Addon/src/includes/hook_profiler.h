@@ -0,0 +1,219 @@
+#pragma once
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Low overhead CPU profiler of our hooks (e.g. the draw calls callbacks), to measure how much time the addon adds to the game threads.
+// Samples are measured with the CPU timestamp counter (TSC), and accumulated in log-linear histograms owned by each thread (so there's no contention between threads),
+// which are merged (and reset) once per frame to compute the percentiles of each counter. The TSC frequency is calibrated against the steady clock over time.
+// The statistics of the last few hundred frames are kept around, to dump them to a CSV.
+// Thread safe, though "end_frame()" (and the statistics getters) are expected to be called from a single thread (e.g. on present).
+// There's meant to be a single (global) instance of it per counters number, threads that alternate between profilers would re-register every time.
+template<size_t counters_num>
+class hook_profiler
+{
+public:
+   // 4 buckets per power of 2, so values are approximated with an error of less than 25%, covering the whole 64 bit range
+   static constexpr size_t sub_buckets_bits = 2;
+   static constexpr size_t sub_buckets_num = size_t(1) << sub_buckets_bits;
+   static constexpr size_t buckets_num = (64 - sub_buckets_bits + 1) * sub_buckets_num;
+   static constexpr size_t history_frames = 600;
+
+   struct statistics
+   {
+      uint64_t count = 0;
+      double total_us = 0.0;
+      double p50_us = 0.0;
+      double p99_us = 0.0;
+      double max_us = 0.0;
+   };
+   using frame_statistics = std::array<statistics, counters_num>;
+
+   // Times its own lifetime
+   class scope
+   {
+   public:
+      scope(hook_profiler& profiler, size_t counter) : profiler(profiler), counter(counter), start_ticks(__rdtsc()) {}
+      ~scope()
+      {
+         profiler.add_sample(counter, __rdtsc() - start_ticks);
+      }
+      scope(const scope&) = delete;
+      scope& operator=(const scope&) = delete;
+
+   private:
+      hook_profiler& profiler;
+      const size_t counter;
+      const uint64_t start_ticks;
+   };
+
+   hook_profiler() : start_ticks(__rdtsc()), start_time(std::chrono::steady_clock::now()) {}
+   hook_profiler(const hook_profiler&) = delete;
+   hook_profiler& operator=(const hook_profiler&) = delete;
+
+   static size_t get_bucket_index(uint64_t value)
+   {
+      if (value < sub_buckets_num) return size_t(value);
+      const size_t shift = size_t(std::bit_width(value)) - 1 - sub_buckets_bits;
+      return (shift + 1) * sub_buckets_num + size_t((value >> shift) & (sub_buckets_num - 1));
+   }
+
+   // The (inclusive) range of values that fall in a bucket
+   static std::pair<uint64_t, uint64_t> get_bucket_range(size_t index)
+   {
+      if (index < sub_buckets_num) return { uint64_t(index), uint64_t(index) };
+      const size_t shift = index / sub_buckets_num - 1;
+      const uint64_t lower = uint64_t(sub_buckets_num + index % sub_buckets_num) << shift;
+      return { lower, lower + ((uint64_t(1) << shift) - 1) };
+   }
+
+   // Returns the approximate value (the middle of its bucket) below which "percentile" (0-1) of the samples are, clamped to the actual max value
+   static uint64_t get_percentile(const uint64_t (&buckets)[buckets_num], uint64_t count, double percentile, uint64_t max_value)
+   {
+      if (count == 0) return 0;
+      uint64_t target = uint64_t(percentile * double(count) + 0.5);
+      target = target < 1 ? 1 : (target > count ? count : target);
+      uint64_t accumulated = 0;
+      for (size_t i = 0; i < buckets_num; i++)
+      {
+         accumulated += buckets[i];
+         if (accumulated >= target)
+         {
+            const auto range = get_bucket_range(i);
+            const uint64_t value = range.first + (range.second - range.first) / 2;
+            return value < max_value ? value : max_value;
+         }
+      }
+      return max_value;
+   }
+
+   void add_sample(size_t counter, uint64_t ticks)
+   {
+      thread_counters& counters = get_thread_counters();
+      counters.buckets[counter][get_bucket_index(ticks)].fetch_add(1, std::memory_order_relaxed);
+      counters.total_ticks[counter].fetch_add(ticks, std::memory_order_relaxed);
+      uint64_t max_ticks = counters.max_ticks[counter].load(std::memory_order_relaxed);
+      while (ticks > max_ticks && !counters.max_ticks[counter].compare_exchange_weak(max_ticks, ticks, std::memory_order_relaxed)) {}
+   }
+
+   // Call this once per frame, it merges the samples of all threads into the statistics of the frame
+   void end_frame(uint64_t frame_index)
+   {
+      // Calibrate the TSC frequency over the whole time the profiler has been running, so it gets more accurate over time
+      const uint64_t ticks = __rdtsc();
+      const double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_time).count();
+      if (elapsed_us > 0.0 && ticks > start_ticks)
+      {
+         ticks_per_us = double(ticks - start_ticks) / elapsed_us;
+      }
+
+      frame_statistics frame_stats;
+      const std::lock_guard lock(threads_mutex);
+      for (size_t i = 0; i < counters_num; i++)
+      {
+         uint64_t merged_buckets[buckets_num] = {};
+         uint64_t count = 0;
+         uint64_t total_ticks = 0;
+         uint64_t max_ticks = 0;
+         for (const auto& counters : threads_counters)
+         {
+            for (size_t j = 0; j < buckets_num; j++)
+            {
+               // Most buckets are empty, skip the (more expensive) exchange for them
+               if (counters->buckets[i][j].load(std::memory_order_relaxed) == 0) continue;
+               const uint64_t bucket_count = counters->buckets[i][j].exchange(0, std::memory_order_relaxed);
+               merged_buckets[j] += bucket_count;
+               count += bucket_count;
+            }
+            total_ticks += counters->total_ticks[i].exchange(0, std::memory_order_relaxed);
+            const uint64_t thread_max_ticks = counters->max_ticks[i].exchange(0, std::memory_order_relaxed);
+            max_ticks = thread_max_ticks > max_ticks ? thread_max_ticks : max_ticks;
+         }
+
+         statistics& stats = frame_stats[i];
+         stats.count = count;
+         stats.total_us = double(total_ticks) / ticks_per_us;
+         stats.p50_us = double(get_percentile(merged_buckets, count, 0.5, max_ticks)) / ticks_per_us;
+         stats.p99_us = double(get_percentile(merged_buckets, count, 0.99, max_ticks)) / ticks_per_us;
+         stats.max_us = double(max_ticks) / ticks_per_us;
+      }
+
+      history.emplace_back(frame_index, frame_stats);
+      while (history.size() > history_frames)
+      {
+         history.pop_front();
+      }
+   }
+
+   // The statistics of the last ended frame
+   const frame_statistics& get_last_frame_statistics() const
+   {
+      static const frame_statistics empty_statistics = {};
+      return history.empty() ? empty_statistics : history.back().second;
+   }
+
+   // Writes the statistics of all the frames in the history, one line per frame and counter
+   bool export_csv(const std::filesystem::path& path, const char* const (&counters_names)[counters_num]) const
+   {
+      std::ofstream file(path, std::ios::trunc);
+      if (!file) return false;
+      file << "Frame,Hook,Count,Total (us),P50 (us),P99 (us),Max (us)\n";
+      for (const auto& frame_stats : history)
+      {
+         for (size_t i = 0; i < counters_num; i++)
+         {
+            const statistics& stats = frame_stats.second[i];
+            file << frame_stats.first << ',' << counters_names[i] << ',' << stats.count << ',' << stats.total_us << ',' << stats.p50_us << ',' << stats.p99_us << ',' << stats.max_us << '\n';
+         }
+      }
+      return bool(file);
+   }
+
+private:
+   // Only written by their own thread (and reset by "end_frame()"), atomics are only needed to not lose samples while resetting them
+   struct thread_counters
+   {
+      std::atomic<uint64_t> buckets[counters_num][buckets_num] = {};
+      std::atomic<uint64_t> total_ticks[counters_num] = {};
+      std::atomic<uint64_t> max_ticks[counters_num] = {};
+   };
+
+   // The counters of threads that exit are kept around (they are never freed until the profiler is destroyed), there's only a few of them anyway
+   thread_counters& get_thread_counters()
+   {
+      thread_local const hook_profiler* owner = nullptr;
+      thread_local thread_counters* counters = nullptr;
+      if (owner != this)
+      {
+         auto new_counters = std::make_unique<thread_counters>();
+         counters = new_counters.get();
+         owner = this;
+         const std::lock_guard lock(threads_mutex);
+         threads_counters.push_back(std::move(new_counters));
+      }
+      return *counters;
+   }
+
+   const uint64_t start_ticks;
+   const std::chrono::steady_clock::time_point start_time;
+   double ticks_per_us = 1000.0; // Until calibrated
+   std::mutex threads_mutex;
+   std::vector<std::unique_ptr<thread_counters>> threads_counters;
+   std::deque<std::pair<uint64_t, frame_statistics>> history;
+};
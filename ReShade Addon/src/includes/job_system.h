@@ -0,0 +1,367 @@
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The classes of background work we do, from the most to the least important.
+enum class JobPriority : uint8_t
+{
+   // Work the game rendering is waiting on (e.g. loading the custom shaders that are about to replace the game ones)
+   RenderCritical,
+   // Compilation work that is only speculative (e.g. pre-compiling the shaders of settings the user might switch to), it runs at idle thread priority
+   BackgroundCompile,
+   // Disk reads/writes that nothing is waiting for (e.g. dumping shaders)
+   IO,
+
+   Count
+};
+
+// Small pool of worker threads that runs all our background work (shaders compilation, loading, dumping...), instead of launching a new thread for each of them.
+// Jobs are picked by priority class, though lower priority jobs are never starved: after "max_skips" higher priority jobs were picked over them, they go first.
+// Jobs can't be preempted, so one worker is reserved for render critical jobs (lower priority jobs can't occupy all of them), otherwise they could wait behind long compilations.
+// Workers run each job with the OS thread priority of its class (so they don't compete with the game threads for the cores), and optionally with a cores affinity mask (both are only hints, and only applied on Windows).
+// Cancellation is cooperative: jobs are always run (even if they were cancelled before they started), and they are expected to check their cancellation flag and return early,
+// this way jobs can always clean up their state (e.g. reset their "running" flags).
+// Jobs can be tagged with a group (e.g. the device they belong to), so all of them can be drained at once (e.g. when the device is destroyed).
+// After a shutdown, the workers are started again with the next submitted job (e.g. if the addon is initialized again).
+// Thread safe.
+class job_system
+{
+public:
+   using job_function = std::function<void(const std::atomic<bool>& cancelled)>;
+
+   // How many higher priority jobs can be picked before a pending lower priority one
+   static constexpr uint32_t max_skips = 4;
+
+private:
+   struct job_state
+   {
+      job_function function;
+      JobPriority priority;
+      const void* group;
+      uint64_t affinity_mask;
+      std::atomic<bool> cancelled = false;
+      std::atomic<bool> done = false;
+   };
+
+public:
+   class job_handle
+   {
+   public:
+      job_handle() = default;
+
+      bool valid() const
+      {
+         return state != nullptr;
+      }
+
+      // Returns true if the job is still pending or running
+      bool running() const
+      {
+         return state != nullptr && !state->done.load(std::memory_order_acquire);
+      }
+
+      void cancel() const
+      {
+         if (state != nullptr) state->cancelled.store(true, std::memory_order_release);
+      }
+
+      // Waits for the job to finish (it doesn't cancel it)
+      void wait() const
+      {
+         if (state == nullptr) return;
+         std::unique_lock lock(system->mutex);
+         system->done_condition.wait(lock, [this] { return state->done.load(std::memory_order_acquire); });
+      }
+
+   private:
+      friend class job_system;
+      job_handle(job_system* system, std::shared_ptr<job_state> state) : system(system), state(std::move(state)) {}
+
+      job_system* system = nullptr;
+      std::shared_ptr<job_state> state;
+   };
+
+   job_system(size_t workers_num = 3) : workers_num(workers_num > 0 ? workers_num : 1) {}
+   job_system(const job_system&) = delete;
+   job_system& operator=(const job_system&) = delete;
+   ~job_system()
+   {
+      // Threads can't be joined while a dll is being unloaded, "shutdown()" (or "shutdown_detached()") is expected to have been called already
+      for (auto& worker : workers)
+      {
+         if (worker.joinable()) worker.detach();
+      }
+   }
+
+   // Workers are only started with the first job. Jobs submitted during a shutdown are not run (an invalid handle is returned).
+   // An "affinity_mask" of 0 means the job can run on any core.
+   job_handle submit(JobPriority priority, job_function function, const void* group = nullptr, uint64_t affinity_mask = 0)
+   {
+      auto state = std::make_shared<job_state>();
+      state->function = std::move(function);
+      state->priority = priority;
+      state->group = group;
+      state->affinity_mask = affinity_mask;
+      {
+         const std::unique_lock lock(mutex);
+         if (stopping) return {};
+         if (workers.empty())
+         {
+            for (size_t i = 0; i < workers_num; i++)
+            {
+               workers.emplace_back(&job_system::run_worker, this);
+            }
+         }
+         queues[size_t(priority)].push_back(state);
+         active_jobs++;
+      }
+      work_condition.notify_one();
+      return job_handle(this, std::move(state));
+   }
+
+   // Waits for all the pending and running jobs of a group (or of all groups, if null) to finish, optionally cancelling them first
+   void drain(const void* group = nullptr, bool cancel = true)
+   {
+      std::unique_lock lock(mutex);
+      const auto is_group_job = [group](const std::shared_ptr<job_state>& job) { return group == nullptr || job->group == group; };
+      if (cancel)
+      {
+         for (const auto& queue : queues)
+         {
+            for (const auto& job : queue)
+            {
+               if (is_group_job(job)) job->cancelled = true;
+            }
+         }
+         for (const auto& job : running_jobs)
+         {
+            if (is_group_job(job)) job->cancelled = true;
+         }
+      }
+      done_condition.wait(lock, [&]()
+         {
+            for (const auto& queue : queues)
+            {
+               for (const auto& job : queue)
+               {
+                  if (is_group_job(job)) return false;
+               }
+            }
+            for (const auto& job : running_jobs)
+            {
+               if (is_group_job(job)) return false;
+            }
+            return true;
+         });
+   }
+
+   // Cancels all the jobs, waits for them to finish and stops the workers. New jobs can be submitted again after this returns (it starts new workers).
+   void shutdown()
+   {
+      stop();
+      for (auto& worker : workers)
+      {
+         if (worker.joinable()) worker.join();
+      }
+      const std::unique_lock lock(mutex);
+      workers.clear();
+      std::fill(std::begin(skips), std::end(skips), 0);
+      stopping = false;
+   }
+
+   // Version of "shutdown()" that can be called while the dll is being unloaded, when threads can't be joined, nor waited on (the loader lock is held).
+   // It cancels all the jobs and returns immediately, the workers exit on their own as soon as their current job returns (so the job system needs to outlive them).
+   // If the process is terminating, all the other threads have already been killed, so there's nothing to cancel.
+   // No jobs can be submitted anymore after this.
+   void shutdown_detached(bool process_terminating)
+   {
+      if (!process_terminating)
+      {
+         stop();
+      }
+      for (auto& worker : workers)
+      {
+         if (worker.joinable()) worker.detach();
+      }
+   }
+
+   // Number of pending and running jobs
+   size_t get_active_jobs() const
+   {
+      return active_jobs.load(std::memory_order_relaxed);
+   }
+
+private:
+#ifdef _WIN32
+   static int get_thread_priority(JobPriority priority)
+   {
+      switch (priority)
+      {
+      case JobPriority::RenderCritical: return THREAD_PRIORITY_NORMAL;
+      case JobPriority::BackgroundCompile: return THREAD_PRIORITY_IDLE;
+      default: return THREAD_PRIORITY_BELOW_NORMAL;
+      }
+   }
+#endif
+
+   // The cores the process can run on (0 if unknown)
+   static uint64_t get_process_affinity_mask()
+   {
+#ifdef _WIN32
+      DWORD_PTR process_affinity_mask = 0;
+      DWORD_PTR system_affinity_mask = 0;
+      GetProcessAffinityMask(GetCurrentProcess(), &process_affinity_mask, &system_affinity_mask);
+      return uint64_t(process_affinity_mask);
+#else
+      return 0;
+#endif
+   }
+
+   // Runs a job on the calling worker with the thread priority of its class, and its affinity mask
+   static void run_job(job_state& job, [[maybe_unused]] uint64_t process_affinity_mask)
+   {
+#ifdef _WIN32
+      const HANDLE thread = GetCurrentThread();
+      SetThreadPriority(thread, get_thread_priority(job.priority));
+      // Threads can only run on a subset of the cores the process can run on, ignore the hint if there's no overlap
+      const DWORD_PTR affinity_mask = DWORD_PTR(job.affinity_mask & process_affinity_mask);
+      if (affinity_mask != 0) SetThreadAffinityMask(thread, affinity_mask);
+      job.function(job.cancelled);
+      if (affinity_mask != 0) SetThreadAffinityMask(thread, DWORD_PTR(process_affinity_mask));
+      SetThreadPriority(thread, THREAD_PRIORITY_NORMAL);
+#else
+      job.function(job.cancelled);
+#endif
+   }
+
+   void stop()
+   {
+      {
+         const std::unique_lock lock(mutex);
+         stopping = true;
+         for (const auto& queue : queues)
+         {
+            for (const auto& job : queue)
+            {
+               job->cancelled = true;
+            }
+         }
+         for (const auto& job : running_jobs)
+         {
+            job->cancelled = true;
+         }
+      }
+      work_condition.notify_all();
+   }
+
+   // Expects "mutex" to be locked and at least one job to be runnable (see "has_runnable_jobs()")
+   std::shared_ptr<job_state> pop_next_job()
+   {
+      size_t queue_index = size_t(JobPriority::Count);
+      // Lower priority jobs that have been skipped too many times go first (if there's a worker left for them)
+      if (can_run_background_job())
+      {
+         for (size_t i = 0; i < size_t(JobPriority::Count); i++)
+         {
+            if (!queues[i].empty() && skips[i] >= max_skips)
+            {
+               queue_index = i;
+               break;
+            }
+         }
+      }
+      if (queue_index == size_t(JobPriority::Count))
+      {
+         for (queue_index = 0; queues[queue_index].empty(); queue_index++) {}
+      }
+      for (size_t i = queue_index + 1; i < size_t(JobPriority::Count); i++)
+      {
+         if (!queues[i].empty()) skips[i]++;
+      }
+      skips[queue_index] = 0;
+      auto job = std::move(queues[queue_index].front());
+      queues[queue_index].pop_front();
+      return job;
+   }
+
+   bool has_pending_jobs() const
+   {
+      for (const auto& queue : queues)
+      {
+         if (!queue.empty()) return true;
+      }
+      return false;
+   }
+
+   // Expects "mutex" to be locked. Whether a worker can pick a lower priority job, without leaving no free worker for render critical ones.
+   bool can_run_background_job() const
+   {
+      return running_background_jobs < (workers_num > 1 ? workers_num - 1 : 1);
+   }
+
+   // Expects "mutex" to be locked
+   bool has_runnable_jobs() const
+   {
+      if (!queues[size_t(JobPriority::RenderCritical)].empty()) return true;
+      return can_run_background_job() && has_pending_jobs();
+   }
+
+   void run_worker()
+   {
+      const uint64_t process_affinity_mask = get_process_affinity_mask();
+      while (true)
+      {
+         std::shared_ptr<job_state> job;
+         {
+            std::unique_lock lock(mutex);
+            // Pending jobs are still run after stopping (as cancelled), so their state is always cleaned up
+            work_condition.wait(lock, [this] { return has_runnable_jobs() || (stopping && !has_pending_jobs()); });
+            if (!has_runnable_jobs()) break;
+            job = pop_next_job();
+            running_jobs.push_back(job);
+            if (job->priority != JobPriority::RenderCritical) running_background_jobs++;
+         }
+
+         run_job(*job, process_affinity_mask);
+
+         bool notify_workers;
+         {
+            const std::unique_lock lock(mutex);
+            std::erase(running_jobs, job);
+            job->done.store(true, std::memory_order_release);
+            active_jobs--;
+            // Lower priority jobs might have been waiting for this worker, and stopped workers might have been waiting for the last jobs to be picked
+            notify_workers = job->priority != JobPriority::RenderCritical || stopping;
+            if (job->priority != JobPriority::RenderCritical) running_background_jobs--;
+         }
+         done_condition.notify_all();
+         if (notify_workers) work_condition.notify_all();
+      }
+   }
+
+   const size_t workers_num;
+   std::vector<std::thread> workers;
+   std::atomic<size_t> active_jobs = 0;
+
+   std::mutex mutex;
+   std::condition_variable work_condition;
+   std::condition_variable done_condition;
+   std::deque<std::shared_ptr<job_state>> queues[size_t(JobPriority::Count)];
+   uint32_t skips[size_t(JobPriority::Count)] = {};
+   std::vector<std::shared_ptr<job_state>> running_jobs;
+   size_t running_background_jobs = 0; // Running jobs that aren't render critical
+   bool stopping = false;
+};
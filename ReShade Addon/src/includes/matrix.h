@@ -2,13 +2,19 @@
 
 #include "math.h"
 
+#ifdef _MSC_VER
 #define CRY_FORCE_INLINE __forceinline
+#else
+#define CRY_FORCE_INLINE inline __attribute__((always_inline))
+#endif
 #if !defined(DEBUG)
 #define ILINE CRY_FORCE_INLINE
 #else
 #define ILINE inline
 #endif
+#ifdef _MSC_VER
 #define CRY_ALIGN(bytes) __declspec(align(bytes))
+#endif
 
 template<typename F> struct Matrix44_tpl
 {
@@ -430,7 +436,11 @@ template<typename F> struct Matrix44_tpl
 #endif
 };
 
+#ifdef _MSC_VER
 typedef CRY_ALIGN(16) Matrix44_tpl<float> Matrix44A;
+#else
+typedef Matrix44_tpl<float> Matrix44A __attribute__((aligned(16)));
+#endif
 typedef Matrix44_tpl<float>  Matrix44;   //!< Always 32 bit.
 
 template<class T_out, class T_in>
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <include/reshade.hpp>
+
+#include "frame_capture.h"
+
+// In memory stand-in of the rendering backend (device, command lists and swapchain) the addon receives its events from, reduced to the state the addon actually looks at:
+// the created pipelines (with their shader hashes), the pipelines bound to each command list, the global per view cbuffer data, and how many times each event happened.
+// It's fed by replaying frame captures ("frame_capture.h") into it, so the draw path logic can be run and benchmarked without the game (nor a GPU),
+// by attaching it to the "pipeline_init_callback" (e.g. to compute the shaders roles), "draw_callback" (e.g. to detect the frame passes) and "global_cbuffer_callback" (e.g. to validate the cbuffer).
+// The captured handles are exposed as ReShade API objects, though command lists are only identified by their (native) handle, as "reshade::api::command_list" is an interface.
+// Not thread safe.
+class mock_render_backend
+{
+public:
+   struct pipeline
+   {
+      reshade::api::pipeline handle = { 0 };
+      std::vector<reshade::api::pipeline_subobject_type> subobject_types;
+      std::vector<uint32_t> shader_hashes;
+      uint32_t user_data = 0; // Whatever "pipeline_init_callback" returned for it
+   };
+
+   // The pipelines bound to a command list (zero if none, or if they weren't created in the capture, as the addon ignores the pipelines it has no interest in)
+   struct command_list_state
+   {
+      const pipeline* vertex_shader = nullptr;
+      const pipeline* pixel_shader = nullptr;
+      const pipeline* compute_shader = nullptr;
+   };
+
+   struct statistics
+   {
+      std::array<uint64_t, size_t(FrameCaptureEvent::Count)> events = {};
+      uint64_t unknown_pipeline_binds = 0;
+      uint64_t command_lists = 0;
+      uint64_t pipelines = 0;
+   };
+
+   struct benchmark_results
+   {
+      uint32_t iterations = 0;
+      uint64_t events = 0; // Per iteration
+      double total_ms = 0.0;
+      double ns_per_event = 0.0;
+   };
+
+   std::function<uint32_t(const pipeline&)> pipeline_init_callback;
+   std::function<void(const command_list_state&, bool is_dispatch)> draw_callback;
+   // Receives the original data the game wrote in the buffer, and whether the addon accepted it as the main view cbuffer when it was captured
+   std::function<void(reshade::api::resource buffer, const void* data, uint32_t size, bool captured_is_main_view)> global_cbuffer_callback;
+   // Receives the passes the addon detected in the captured frame (bit per "FramePass")
+   std::function<void(uint64_t frame_index, uint32_t captured_drawn_passes)> present_callback;
+
+   // Clears all the state (the callbacks are kept)
+   void reset()
+   {
+      pipelines.clear();
+      command_lists.clear();
+      global_cbuffer_data.clear();
+      stats = {};
+   }
+
+   const statistics& get_statistics() const
+   {
+      return stats;
+   }
+
+   // The last data written to the global per view cbuffer
+   const std::vector<uint8_t>& get_global_cbuffer_data() const
+   {
+      return global_cbuffer_data;
+   }
+
+   // Replays a capture "iterations" times, each from a clean state, and times it (including the callbacks)
+   benchmark_results benchmark(const frame_capture_reader& reader, uint32_t iterations)
+   {
+      benchmark_results results;
+      results.iterations = iterations;
+      results.events = reader.get_events_count();
+      const auto start_time = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < iterations; i++)
+      {
+         reset();
+         reader.replay(*this);
+      }
+      results.total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+      if (results.events != 0 && iterations != 0)
+      {
+         results.ns_per_event = results.total_ms * 1000000.0 / (double(results.events) * double(iterations));
+      }
+      return results;
+   }
+
+   // "frame_capture_reader" handler:
+
+   void on_init_pipeline(const FrameCaptureInitPipeline& event, const uint32_t* shader_hashes)
+   {
+      stats.events[size_t(FrameCaptureEvent::InitPipeline)]++;
+      // Pipelines captured when the capture started might be re-created with the same handle later, in that case they are simply replaced
+      pipeline& new_pipeline = pipelines[event.pipeline];
+      new_pipeline.handle = { event.pipeline };
+      new_pipeline.subobject_types.clear();
+      for (uint32_t type = 0; type < 32; type++)
+      {
+         if ((event.subobject_types_mask & (1u << type)) != 0) new_pipeline.subobject_types.push_back(reshade::api::pipeline_subobject_type(type));
+      }
+      new_pipeline.shader_hashes.assign(shader_hashes, shader_hashes + event.shader_hashes_count);
+      new_pipeline.user_data = pipeline_init_callback ? pipeline_init_callback(new_pipeline) : 0;
+      stats.pipelines = pipelines.size();
+   }
+
+   void on_bind_pipeline(const FrameCaptureBindPipeline& event)
+   {
+      stats.events[size_t(FrameCaptureEvent::BindPipeline)]++;
+      const pipeline* bound_pipeline = nullptr;
+      if (event.pipeline != 0)
+      {
+         const auto pipeline_pair = pipelines.find(event.pipeline);
+         if (pipeline_pair != pipelines.end()) bound_pipeline = &pipeline_pair->second;
+         else stats.unknown_pipeline_binds++;
+      }
+      command_list_state& state = get_command_list(event.command_list);
+      const auto stages = reshade::api::pipeline_stage(event.stages);
+      if ((stages & reshade::api::pipeline_stage::vertex_shader) != 0) state.vertex_shader = bound_pipeline;
+      if ((stages & reshade::api::pipeline_stage::pixel_shader) != 0) state.pixel_shader = bound_pipeline;
+      if ((stages & reshade::api::pipeline_stage::compute_shader) != 0) state.compute_shader = bound_pipeline;
+   }
+
+   void on_draw(const FrameCaptureDraw& event, bool indexed)
+   {
+      stats.events[size_t(indexed ? FrameCaptureEvent::DrawIndexed : FrameCaptureEvent::Draw)]++;
+      if (draw_callback) draw_callback(get_command_list(event.command_list), false);
+   }
+
+   void on_dispatch(const FrameCaptureDispatch& event)
+   {
+      stats.events[size_t(FrameCaptureEvent::Dispatch)]++;
+      if (draw_callback) draw_callback(get_command_list(event.command_list), true);
+   }
+
+   void on_unmap_global_cbuffer(const FrameCaptureUnmapGlobalCBuffer& event, const void* data)
+   {
+      stats.events[size_t(FrameCaptureEvent::UnmapGlobalCBuffer)]++;
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+      global_cbuffer_data.assign(bytes, bytes + event.size);
+      // Pass our copy, as the capture data isn't necessarily aligned
+      if (global_cbuffer_callback) global_cbuffer_callback(reshade::api::resource{ event.buffer }, global_cbuffer_data.data(), event.size, event.is_main_view != 0);
+   }
+
+   void on_copy_resource(const FrameCaptureCopyResource& event)
+   {
+      stats.events[size_t(FrameCaptureEvent::CopyResource)]++;
+   }
+
+   void on_present(const FrameCapturePresent& event)
+   {
+      stats.events[size_t(FrameCaptureEvent::Present)]++;
+      if (present_callback) present_callback(event.frame_index, event.drawn_passes);
+   }
+
+private:
+   command_list_state& get_command_list(uint64_t command_list)
+   {
+      const auto emplace_result = command_lists.try_emplace(command_list);
+      if (emplace_result.second) stats.command_lists++;
+      return emplace_result.first->second;
+   }
+
+   // "unordered_map" never moves its values, so the bound state can point to them
+   std::unordered_map<uint64_t, pipeline> pipelines;
+   std::unordered_map<uint64_t, command_list_state> command_lists;
+   std::vector<uint8_t> global_cbuffer_data;
+   statistics stats;
+};
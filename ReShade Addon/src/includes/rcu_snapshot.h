@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Minimal epoch based Read-Copy-Update (RCU) helpers.
+// Readers access the latest published snapshot with a single atomic load, without taking any lock.
+// Writers (which need to be synchronized between each other externally) publish new immutable snapshots, while the old ones
+// (and any other object that lock free readers might still be referencing) are "retired" and only released once no reader can be using them anymore.
+// Readers register themselves with a "read_scope" for the duration of their access (e.g. a draw call), and must never hold on to the pointers they got beyond it.
+// Objects are released, on "advance_epoch()", once they were retired in an epoch older than the one all the active read scopes started in.
+class rcu_domain
+{
+public:
+   // Maximum number of concurrent read scopes (they are usually one per thread that issues draw calls)
+   static constexpr size_t max_readers = 64;
+
+   class read_scope
+   {
+   public:
+      explicit read_scope(rcu_domain& domain) : slot(domain.enter_read()) {}
+      read_scope(const read_scope&) = delete;
+      read_scope& operator=(const read_scope&) = delete;
+      ~read_scope()
+      {
+         slot->store(idle_epoch, std::memory_order_release);
+      }
+
+   private:
+      std::atomic<uint64_t>* slot;
+   };
+
+   rcu_domain() = default;
+   rcu_domain(const rcu_domain&) = delete;
+   rcu_domain& operator=(const rcu_domain&) = delete;
+   // Only safe if there's no more readers
+   ~rcu_domain()
+   {
+      for (auto& retired_object : retired_objects)
+      {
+         retired_object.second();
+      }
+   }
+
+   template<typename T>
+   void retire(const T* object)
+   {
+      retire([object]() { delete object; });
+   }
+
+   // The object needs to have already been unlinked from anything new readers could find it from (e.g. a published snapshot)
+   void retire(std::function<void()> release)
+   {
+      // Make sure the unlinking is visible to all the readers that will start after we read the epoch (see "enter_read()")
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const std::lock_guard lock(mutex);
+      retired_objects.emplace_back(epoch.load(std::memory_order_relaxed), std::move(release));
+   }
+
+   // Call this once per epoch (e.g. on present), it releases all the retired objects that no active reader could still be using.
+   // Objects are released outside of the lock, so they are free to retire other objects.
+   void advance_epoch()
+   {
+      std::vector<std::function<void()>> expired_objects;
+      {
+         const std::lock_guard lock(mutex);
+         const uint64_t new_epoch = epoch.load(std::memory_order_relaxed) + 1;
+         epoch.store(new_epoch, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         uint64_t oldest_reader_epoch = new_epoch;
+         for (const auto& reader_slot : reader_slots)
+         {
+            oldest_reader_epoch = std::min(oldest_reader_epoch, reader_slot.epoch.load(std::memory_order_acquire));
+         }
+         std::erase_if(retired_objects, [&](auto& retired_object)
+            {
+               if (retired_object.first >= oldest_reader_epoch) return false;
+               expired_objects.push_back(std::move(retired_object.second));
+               return true;
+            });
+      }
+      for (auto& expired_object : expired_objects)
+      {
+         expired_object();
+      }
+   }
+
+private:
+   static constexpr uint64_t idle_epoch = UINT64_MAX;
+
+   // Each on its own cache line, as they are written by different threads
+   struct alignas(64) reader_slot
+   {
+      std::atomic<uint64_t> epoch = idle_epoch;
+   };
+
+   std::atomic<uint64_t>* enter_read()
+   {
+      // Every thread starts looking from a different slot, so they rarely contend for the same ones
+      static std::atomic<size_t> threads_count = 0;
+      static thread_local const size_t first_slot = threads_count.fetch_add(1, std::memory_order_relaxed);
+      for (size_t i = first_slot;; i++)
+      {
+         auto& slot = reader_slots[i % max_readers].epoch;
+         uint64_t expected = idle_epoch;
+         if (slot.load(std::memory_order_relaxed) == idle_epoch && slot.compare_exchange_strong(expected, epoch.load(std::memory_order_relaxed), std::memory_order_acq_rel))
+         {
+            // Pairs with the fence in "retire()": either the writer sees this reader, or this reader won't see the retired object.
+            // The epoch we registered with might already be outdated, which only delays the release of objects.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return &slot;
+         }
+      }
+   }
+
+   std::mutex mutex;
+   std::atomic<uint64_t> epoch = 0;
+   std::vector<std::pair<uint64_t, std::function<void()>>> retired_objects;
+   reader_slot reader_slots[max_readers];
+};
+
+template<typename T>
+class rcu_snapshot
+{
+public:
+   rcu_snapshot() = default;
+   rcu_snapshot(const rcu_snapshot&) = delete;
+   rcu_snapshot& operator=(const rcu_snapshot&) = delete;
+   ~rcu_snapshot()
+   {
+      delete current.load();
+   }
+
+   // Can return null if nothing has ever been published
+   const T* read() const
+   {
+      return current.load(std::memory_order_acquire);
+   }
+
+   // Takes ownership of the new snapshot, the previous one is retired in the domain
+   void publish(const T* new_snapshot, rcu_domain& domain)
+   {
+      const T* old_snapshot = current.exchange(new_snapshot, std::memory_order_acq_rel);
+      if (old_snapshot != nullptr)
+      {
+         domain.retire(old_snapshot);
+      }
+   }
+
+private:
+   std::atomic<const T*> current = nullptr;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <source/com_ptr.hpp>
+
+// Cache of the shader resource and render target views we create on the fly (e.g. to draw custom passes on game resources),
+// so that steady state frames, which keep using the same resources, don't need to create (and destroy) any view.
+// Views are keyed by their resource and their description (which needs to be zero initialized before being filled, as it's compared by memory).
+// Note that views hold a reference to their resource, so as long as a view is cached, its resource can't be destroyed (nor its address be re-used by a new resource),
+// hence views that haven't been used in a few frames are released by "trim()", to let the game free their resources.
+// Resources reported as destroyed (by the game or the runtime, e.g. through ReShade's "destroy_resource" event) need to be passed to "evict()", so a new resource created at the same address never gets their views.
+// Anything that needs its resources to be fully released by anything else (e.g. resizing the swapchain buffers) needs to call "clear()" first.
+// Thread safe.
+class resource_view_cache
+{
+public:
+   // How many frames a view can go unused before it's released
+   static constexpr uint32_t max_unused_frames = 8;
+
+   resource_view_cache() = default;
+   resource_view_cache(const resource_view_cache&) = delete;
+   resource_view_cache& operator=(const resource_view_cache&) = delete;
+
+   com_ptr<ID3D11ShaderResourceView> get_srv(ID3D11Device* device, ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC& desc)
+   {
+      return get_view(resource, desc, &resource_views::srvs, [&](ID3D11ShaderResourceView** view) { return device->CreateShaderResourceView(resource, &desc, view); });
+   }
+
+   com_ptr<ID3D11RenderTargetView> get_rtv(ID3D11Device* device, ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC& desc)
+   {
+      return get_view(resource, desc, &resource_views::rtvs, [&](ID3D11RenderTargetView** view) { return device->CreateRenderTargetView(resource, &desc, view); });
+   }
+
+   // Call this once per frame (e.g. on present)
+   void trim()
+   {
+      const std::lock_guard lock(mutex);
+      frame++;
+      const auto is_unused = [this](const auto& view) { return frame - view.last_used_frame > max_unused_frames; };
+      for (auto it = views_by_resource.begin(); it != views_by_resource.end();)
+      {
+         std::erase_if(it->second.srvs, is_unused);
+         std::erase_if(it->second.rtvs, is_unused);
+         it = (it->second.srvs.empty() && it->second.rtvs.empty()) ? views_by_resource.erase(it) : std::next(it);
+      }
+   }
+
+   // Releases all the views of a resource
+   void evict(ID3D11Resource* resource)
+   {
+      const std::lock_guard lock(mutex);
+      views_by_resource.erase(reinterpret_cast<uint64_t>(resource));
+   }
+
+   void clear()
+   {
+      const std::lock_guard lock(mutex);
+      views_by_resource.clear();
+   }
+
+   // Number of views created since the cache was constructed, it should stop increasing in steady state frames
+   uint64_t get_created_views_count() const
+   {
+      return created_views_count;
+   }
+
+private:
+   template<typename T, typename D>
+   struct cached_view
+   {
+      D desc;
+      com_ptr<T> view;
+      uint32_t last_used_frame = 0;
+   };
+
+   struct resource_views
+   {
+      std::vector<cached_view<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC>> srvs;
+      std::vector<cached_view<ID3D11RenderTargetView, D3D11_RENDER_TARGET_VIEW_DESC>> rtvs;
+   };
+
+   template<typename T, typename D, typename F>
+   com_ptr<T> get_view(ID3D11Resource* resource, const D& desc, std::vector<cached_view<T, D>> resource_views::* member, F&& create_view)
+   {
+      if (resource == nullptr) return nullptr;
+
+      const std::lock_guard lock(mutex);
+      auto& views = views_by_resource[reinterpret_cast<uint64_t>(resource)].*member;
+      for (auto& view : views)
+      {
+         if (std::memcmp(&view.desc, &desc, sizeof(D)) == 0)
+         {
+            view.last_used_frame = frame;
+            return view.view;
+         }
+      }
+
+      // Failed creations aren't cached, they will be attempted again the next time
+      com_ptr<T> new_view;
+      if (FAILED(create_view(&new_view)) || new_view.get() == nullptr) return nullptr;
+      created_views_count++;
+      auto& view = views.emplace_back();
+      view.desc = desc;
+      view.view = new_view;
+      view.last_used_frame = frame;
+      return new_view;
+   }
+
+   std::mutex mutex;
+   std::unordered_map<uint64_t, resource_views> views_by_resource; // By "ID3D11Resource" address
+   uint32_t frame = 0;
+   std::atomic<uint64_t> created_views_count = 0;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <algorithm>
+
+#include <source/com_ptr.hpp>
+
+// Creation of the custom (upgraded) versions of the game samplers (see "custom_sampler_cache"), with more anisotropic filtering and a texture mip LOD bias that depends on the rendering resolution.
+// Depends on "DEVELOPMENT" and "ASSERT_ONCE()" (see "main.cpp").
+namespace
+{
+#if DEVELOPMENT
+   int samplers_upgrade_mode = 5;
+   int samplers_upgrade_mode_2 = 0;
+#endif
+
+   // TODO: use the native ReShade sampler desc instead? It's not really necessary
+   com_ptr<ID3D11SamplerState> CreateCustomSampler(ID3D11Device* device, D3D11_SAMPLER_DESC desc, float texture_mip_lod_bias_offset)
+   {
+#if !DEVELOPMENT
+      if (desc.Filter == D3D11_FILTER_ANISOTROPIC || desc.Filter == D3D11_FILTER_COMPARISON_ANISOTROPIC)
+      {
+         desc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
+#if 1 // Without bruteforcing the offset, many textures (e.g. decals) stay blurry. Based on "samplers_upgrade_mode" 5.
+         desc.MipLODBias = std::clamp(texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX); // Setting this out of range (~ +/- 16) will make DX11 crash
+#else
+         desc.MipLODBias = std::clamp(desc.MipLODBias + texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX); // Setting this out of range (~ +/- 16) will make DX11 crash
+#endif
+      }
+      else
+      {
+         return nullptr;
+      }
+#else
+      if (samplers_upgrade_mode <= 0)
+         return nullptr;
+
+      // Prey's CryEngine only uses:
+      // D3D11_FILTER_ANISOTROPIC
+      // D3D11_FILTER_COMPARISON_ANISOTROPIC
+      // D3D11_FILTER_MIN_MAG_MIP_POINT
+      // D3D11_FILTER_COMPARISON_MIN_MAG_MIP_POINT
+      // D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT
+      // D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT
+      // D3D11_FILTER_MIN_MAG_MIP_LINEAR
+      // D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR
+
+      // This could theoretically make some textures that have moire patters, or were purposely blurry, "worse", but the positives of upgrading still outweight the negatives.
+      // Note that this might not fix all cases because there's still "ID3D11DeviceContext::SetResourceMinLOD()" and textures that are blurry for other reasons
+      // because they use other types of samplers (unfortunately it seems like some decals use "D3D11_FILTER_MIN_MAG_MIP_LINEAR").
+      // Note that the AF on different textures in the game seems is possibly linked with other graphics settings than just AF (maybe textures or objects quality).
+      if (desc.Filter == D3D11_FILTER_ANISOTROPIC || desc.Filter == D3D11_FILTER_COMPARISON_ANISOTROPIC)
+      {
+         // Note: this doesn't seem to affect much
+         if (samplers_upgrade_mode == 1)
+         {
+            desc.MaxAnisotropy = (std::min)(desc.MaxAnisotropy * 2, UINT(D3D11_REQ_MAXANISOTROPY));
+         }
+         else if (samplers_upgrade_mode == 2)
+         {
+            desc.MaxAnisotropy = (std::min)(desc.MaxAnisotropy * 4, UINT(D3D11_REQ_MAXANISOTROPY));
+         }
+         else if (samplers_upgrade_mode >= 3)
+         {
+            desc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
+         }
+         // Note: this is the main ingredient in making textures less blurry
+         if (samplers_upgrade_mode == 4 && desc.MipLODBias <= 0.f)
+         {
+            desc.MipLODBias = std::clamp(desc.MipLODBias + texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX);
+         }
+         else if (samplers_upgrade_mode >= 5)
+         {
+            desc.MipLODBias = std::clamp(texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX);
+         }
+         // Note: this never seems to affect anything in Prey
+         if (samplers_upgrade_mode >= 6)
+         {
+            desc.MinLOD = (std::min)(desc.MinLOD, 0.f);
+         }
+      }
+      else if ((desc.Filter == D3D11_FILTER_MIN_MAG_MIP_LINEAR && samplers_upgrade_mode_2 >= 1) // This is the most common (main/only) format being used other than AF
+         || (desc.Filter == D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR && samplers_upgrade_mode_2 >= 2)
+         || (desc.Filter == D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT && samplers_upgrade_mode_2 >= 3)
+         || (desc.Filter == D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT && samplers_upgrade_mode_2 >= 4)
+         || (desc.Filter == D3D11_FILTER_MIN_MAG_MIP_POINT && samplers_upgrade_mode_2 >= 5)
+         || (desc.Filter == D3D11_FILTER_COMPARISON_MIN_MAG_MIP_POINT && samplers_upgrade_mode_2 >= 6))
+      {
+         //TODOFT: research. Force this on to see how it behaves. Doesn't work, it doesn't really help any further with (e.g.) blurry decal textures
+         // Note: this doesn't seem to do anything really, it doesn't help with the occasional blurry texture (probably because all samplers that needed anisotropic already had it set)
+         if (samplers_upgrade_mode >= 7)
+         {
+            desc.Filter = (desc.ComparisonFunc != D3D11_COMPARISON_NEVER && samplers_upgrade_mode == 7) ? D3D11_FILTER_COMPARISON_ANISOTROPIC : D3D11_FILTER_ANISOTROPIC;
+            desc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
+         }
+         // Note: changing the lod bias of non anisotropic filters makes reflections (cubemap samples?) a lot more specular (shiny) in Prey, so it's best avoided (it can look better is some screenshots, but it's likely not intended).
+         // Even if we only fix up textures that didn't have a positive bias, we run into the same problem.
+         if (samplers_upgrade_mode == 4 && desc.MipLODBias <= 0.f)
+         {
+            desc.MipLODBias = std::clamp(desc.MipLODBias + texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX);
+         }
+         else if (samplers_upgrade_mode >= 5)
+         {
+            desc.MipLODBias = std::clamp(texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX);
+         }
+         if (samplers_upgrade_mode >= 6)
+         {
+            desc.MinLOD = (std::min)(desc.MinLOD, 0.f);
+         }
+      }
+#endif // !DEVELOPMENT
+
+      com_ptr<ID3D11SamplerState> sampler;
+      device->CreateSamplerState(&desc, &sampler);
+      ASSERT_ONCE(sampler != nullptr);
+      return sampler;
+   }
+
+   com_ptr<ID3D11SamplerState> CreateCustomSamplerFromOriginal(ID3D11SamplerState* original_sampler, float texture_mip_lod_bias_offset)
+   {
+      com_ptr<ID3D11Device> device;
+      original_sampler->GetDevice(&device);
+      D3D11_SAMPLER_DESC desc;
+      original_sampler->GetDesc(&desc);
+      return CreateCustomSampler(device.get(), desc, texture_mip_lod_bias_offset);
+   }
+}
@@ -158,6 +158,36 @@ public:
       return compiled_data.value[0] - '0';
    }
 
+   // Returns the range of values this define can have, as listed in its tooltip (e.g. "0 - Vanilla\n1 - High"), or 0-1 if it's a toggle without a list of values.
+   // Returns false if we can't know.
+   bool GetValueRange(char& min_value, char& max_value) const
+   {
+      min_value = '9';
+      max_value = '0';
+      const char* line = tooltip;
+      while (line != nullptr && line[0] != '\0')
+      {
+         if (line[0] >= '0' && line[0] <= '9' && strncmp(line + 1, " - ", 3) == 0)
+         {
+            if (line[0] < min_value) min_value = line[0];
+            if (line[0] > max_value) max_value = line[0];
+         }
+         line = strchr(line, '\n');
+         if (line != nullptr) line++;
+      }
+      if (min_value <= max_value)
+      {
+         return true;
+      }
+      if (default_data.value[0] == '0' || default_data.value[0] == '1')
+      {
+         min_value = '0';
+         max_value = '1';
+         return true;
+      }
+      return false;
+   }
+
    bool HasTooltip() const { return tooltip != nullptr && tooltip[0] != '\0'; }
    const char* GetTooltip() const { return tooltip; }
 
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+// All the (cached) pipelines ("T") that use a shader, by shader hash. Multiple pipelines can use the same shader, and a pipeline can have multiple shaders.
+// Pipelines are expected to keep the list of the shader hashes they were added with ("T::shader_hashes"), which is used as a reverse index on removal,
+// so removing a pipeline only touches its own buckets, instead of all of them (there can be thousands, and levels streaming can destroy hundreds of pipelines at once).
+// Buckets that become empty are removed, so the map doesn't keep growing as the game streams shaders in and out.
+// Not thread safe.
+template<typename T>
+class shader_hash_buckets
+{
+public:
+   using bucket = std::unordered_set<T*>;
+
+   void insert(uint32_t shader_hash, T* item)
+   {
+      buckets[shader_hash].emplace(item);
+   }
+
+   // Removes the item from the buckets of all of its "shader_hashes"
+   void erase(T* item)
+   {
+      for (const uint32_t shader_hash : item->shader_hashes)
+      {
+         if (auto bucket_pair = buckets.find(shader_hash); bucket_pair != buckets.end())
+         {
+            bucket_pair->second.erase(item);
+            if (bucket_pair->second.empty())
+            {
+               buckets.erase(bucket_pair);
+            }
+         }
+      }
+   }
+
+   // Returns null if no item uses the shader
+   const bucket* find(uint32_t shader_hash) const
+   {
+      const auto bucket_pair = buckets.find(shader_hash);
+      return bucket_pair != buckets.end() ? &bucket_pair->second : nullptr;
+   }
+
+   size_t size() const { return buckets.size(); }
+
+private:
+   std::unordered_map<uint32_t, bucket> buckets;
+};
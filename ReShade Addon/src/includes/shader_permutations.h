@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Decides which shader defines permutations to precompile in the background (the ones the user is the most likely to switch to next), in what order,
+// and keeps track of how often switching defines actually found them precompiled.
+// Defines are in (name, value) pairs, in the same order as "shader_defines_data".
+// The compilation itself is done by the caller ("compile_shader"), so this has no dependencies on the shader compiler (nor on ReShade or Windows).
+// Not thread safe (the addon guards it with "s_mutex_loading"), except for "precompile()", which doesn't access any of its state.
+class shader_permutations
+{
+public:
+   // What we know about each define, to find the values it could switch to
+   struct define_range
+   {
+      std::string name;
+      bool editable = false; // Only values the user can edit from the settings are ever changed
+      char min_value = '0';
+      char max_value = '0';
+   };
+
+   enum class compilation_result : uint8_t
+   {
+      compiled, // The compiler ran
+      cached, // It was already in the shaders cache
+      failed,
+   };
+
+   struct precompilation_results
+   {
+      size_t compiled_shaders = 0;
+      size_t cached_shaders = 0;
+      size_t failed_shaders = 0;
+      // The permutations that had all their shaders processed (in the order they were processed)
+      std::vector<std::vector<std::string>> precompiled_permutations;
+      bool cancelled = false;
+   };
+
+   struct statistics
+   {
+      size_t hits = 0; // Switched to defines that had been precompiled
+      size_t misses = 0; // Switched to defines that had not been precompiled
+   };
+
+   shader_permutations(size_t in_max_recent_defines = 4, size_t in_max_precompiled_permutations = 8) : max_recent_defines(in_max_recent_defines), max_precompiled_permutations(in_max_precompiled_permutations) {}
+
+   // To be called after every full shaders compilation, with the defines it used (the new current ones)
+   void on_compiled(const std::vector<std::string>& defines)
+   {
+      // Re-compiling with the same defines (e.g. because the shader files changed) isn't a switch
+      if (!recent_defines.empty() && recent_defines[0] != defines)
+      {
+         if (std::find(precompiled_permutations.begin(), precompiled_permutations.end(), defines) != precompiled_permutations.end())
+         {
+            stats.hits++;
+         }
+         else
+         {
+            stats.misses++;
+         }
+      }
+      std::erase(recent_defines, defines);
+      recent_defines.insert(recent_defines.begin(), defines);
+      if (recent_defines.size() > max_recent_defines)
+      {
+         recent_defines.resize(max_recent_defines);
+      }
+   }
+
+   // Returns the sets of defines the user is the most likely to switch to next (from the current ones), the most likely first:
+   // the ones that have recently been used, and then the ones that only have a single (editable) define value one step away from the current one (e.g. a quality level up or down).
+   // "ranges" are the current defines (by index), if they don't match the current defines anymore (they changed in the meantime), only the recent ones are returned.
+   std::vector<std::vector<std::string>> get_likely_permutations(const std::vector<define_range>& ranges) const
+   {
+      std::vector<std::vector<std::string>> permutations;
+      if (recent_defines.empty()) return permutations;
+      const auto& current_defines = recent_defines[0];
+      const auto add_permutation = [&](const std::vector<std::string>& permutation)
+         {
+            if (permutations.size() < max_precompiled_permutations && std::find(permutations.begin(), permutations.end(), permutation) == permutations.end())
+            {
+               permutations.push_back(permutation);
+            }
+         };
+      for (size_t i = 1; i < recent_defines.size(); i++)
+      {
+         add_permutation(recent_defines[i]);
+      }
+
+      if (current_defines.size() != ranges.size() * 2) return permutations;
+      for (size_t i = 0; i < ranges.size(); i++)
+      {
+         const auto& range = ranges[i];
+         const auto& value = current_defines[(i * 2) + 1];
+         if (!range.editable || current_defines[i * 2] != range.name || value.size() != 1) continue;
+         for (const char adjacent_value : { char(value[0] - 1), char(value[0] + 1) })
+         {
+            if (adjacent_value < range.min_value || adjacent_value > range.max_value) continue;
+            auto permutation = current_defines;
+            permutation[(i * 2) + 1] = adjacent_value;
+            add_permutation(permutation);
+         }
+      }
+      return permutations;
+   }
+
+   // Runs "compile_shader" for all the shaders (by index), for each permutation, one permutation after the other (so that the most likely ones are fully ready as soon as possible).
+   // Once "should_stop" returns true, it stops at the next shader, the permutation it was on doesn't count as precompiled.
+   static precompilation_results precompile(const std::vector<std::vector<std::string>>& permutations, size_t shaders_num,
+      const std::function<compilation_result(const std::vector<std::string>& permutation, size_t shader_index)>& compile_shader, const std::function<bool()>& should_stop)
+   {
+      precompilation_results results;
+      for (const auto& permutation : permutations)
+      {
+         for (size_t shader_index = 0; shader_index < shaders_num; shader_index++)
+         {
+            if (should_stop())
+            {
+               results.cancelled = true;
+               return results;
+            }
+            switch (compile_shader(permutation, shader_index))
+            {
+            case compilation_result::compiled: results.compiled_shaders++; break;
+            case compilation_result::cached: results.cached_shaders++; break;
+            case compilation_result::failed: results.failed_shaders++; break;
+            }
+         }
+         results.precompiled_permutations.push_back(permutation);
+      }
+      return results;
+   }
+
+   // To be called with the results of "precompile()" (even if it was cancelled, the permutations it finished are in the shaders cache anyway).
+   // Shaders that failed to compile with a permutation will fail again (and quickly) if the user switches to it, so the permutation still counts as precompiled.
+   // Only the latest ones are remembered (older ones are likely to have been pushed out of the cache by now).
+   void on_precompiled(const precompilation_results& results)
+   {
+      for (auto it = results.precompiled_permutations.rbegin(); it != results.precompiled_permutations.rend(); ++it)
+      {
+         std::erase(precompiled_permutations, *it);
+         precompiled_permutations.insert(precompiled_permutations.begin(), *it);
+      }
+      if (precompiled_permutations.size() > max_precompiled_permutations * 2)
+      {
+         precompiled_permutations.resize(max_precompiled_permutations * 2);
+      }
+   }
+
+   bool has_current_defines() const { return !recent_defines.empty(); }
+   const std::vector<std::string>& get_current_defines() const { return recent_defines.at(0); }
+   const statistics& get_statistics() const { return stats; }
+
+private:
+   const size_t max_recent_defines;
+   const size_t max_precompiled_permutations;
+   // The last sets of defines shaders have been (fully) compiled with, the most recent (current) first
+   std::vector<std::vector<std::string>> recent_defines;
+   std::vector<std::vector<std::string>> precompiled_permutations;
+   statistics stats;
+};
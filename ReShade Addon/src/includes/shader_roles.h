@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// The role(s) a game shader has within the rendering pipeline (one per known shader hash, or list of hashes)
+enum class ShaderRoleMask : uint32_t
+{
+   None = 0,
+   TiledShadingTiledDeferredShading = 1 << 0,
+   DeferredShadingSSRRaytrace = 1 << 1,
+   SSRBlur = 1 << 2, // "PostEffectsGaussBlurBilinear" or "PostEffectsTextureToTextureResampled"
+   DeferredShadingSSReflectionComp = 1 << 3,
+   HDRPostProcessHDRFinalScene = 1 << 4,
+   HDRPostProcessHDRFinalScene_Sunshafts = 1 << 5,
+   MotionBlur = 1 << 6,
+   DirOccPass = 1 << 7,
+   SSDO_Blur = 1 << 8,
+   PostAAComposites = 1 << 9,
+   SMAA_EdgeDetection = 1 << 10,
+   PostAAUpscaleImage = 1 << 11,
+   PostAA = 1 << 12,
+   PostAA_TAA = 1 << 13,
+};
+
+// Flat table of the roles of all the known game shaders, by shader stage and hash.
+// It's filled once (before any pipeline is created) and then only read, so lookups don't need any lock.
+// Pipelines look up their shaders roles once, on creation, so draw calls only need to OR together the roles of the currently bound pipelines.
+// The stage is an opaque value (e.g. a "reshade::api::shader_stage"), a shader only matches the roles that were added for the same stage.
+class shader_roles_table
+{
+public:
+   // Not thread safe. The same hash can be added with multiple roles.
+   void add(uint32_t stage, uint32_t shader_hash, ShaderRoleMask role)
+   {
+      entries.push_back({ make_key(stage, shader_hash), uint32_t(role) });
+      sorted = false;
+   }
+   template<typename T>
+   void add_all(uint32_t stage, const T& shader_hashes, ShaderRoleMask role)
+   {
+      for (const uint32_t shader_hash : shader_hashes)
+      {
+         add(stage, shader_hash, role);
+      }
+   }
+
+   // Not thread safe, call this after adding all the roles, and before any lookup
+   void build()
+   {
+      std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.key < b.key; });
+      // Merge the roles of duplicate keys
+      size_t unique_entries = 0;
+      for (size_t i = 0; i < entries.size(); i++)
+      {
+         if (unique_entries != 0 && entries[unique_entries - 1].key == entries[i].key)
+         {
+            entries[unique_entries - 1].roles |= entries[i].roles;
+            continue;
+         }
+         entries[unique_entries++] = entries[i];
+      }
+      entries.resize(unique_entries);
+      sorted = true;
+   }
+
+   // Returns a mask of "ShaderRoleMask" flags
+   uint32_t get(uint32_t stage, uint32_t shader_hash) const
+   {
+      const uint64_t key = make_key(stage, shader_hash);
+      const auto it = std::lower_bound(entries.begin(), entries.end(), key, [](const entry& a, uint64_t key) { return a.key < key; });
+      return (it != entries.end() && it->key == key) ? it->roles : uint32_t(ShaderRoleMask::None);
+   }
+
+   bool is_built() const { return sorted; }
+   size_t size() const { return entries.size(); }
+
+private:
+   struct entry
+   {
+      uint64_t key;
+      uint32_t roles;
+   };
+
+   static uint64_t make_key(uint32_t stage, uint32_t shader_hash)
+   {
+      return (uint64_t(stage) << 32) | shader_hash;
+   }
+
+   std::vector<entry> entries;
+   bool sorted = true;
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Concurrent map of (non zero) handles to values (e.g. resource views to their resource), meant for registries that are written to by many threads at the same time
+// (e.g. CryEngine streaming threads that constantly create and destroy textures and views), without them all serializing on a single lock.
+// The map is split in shards (by handle hash), each with its own lock and its own open addressing (linear probing) table, so threads only contend if they touch the same shard.
+// Each shard also counts its insertions, erasures and lock contentions, to verify the handles are spread evenly and that the shards number is high enough.
+// Thread safe.
+template<size_t shards_num_pow2 = 16>
+class sharded_handle_map
+{
+   static_assert((shards_num_pow2 & (shards_num_pow2 - 1)) == 0, "The shards number needs to be a power of 2");
+
+public:
+   struct statistics
+   {
+      size_t size = 0;
+      size_t capacity = 0;
+      size_t max_shard_size = 0;
+      uint64_t insertions = 0;
+      uint64_t erasures = 0;
+      uint64_t contentions = 0; // How many times a thread found its shard already locked
+   };
+
+   sharded_handle_map() = default;
+   sharded_handle_map(const sharded_handle_map&) = delete;
+   sharded_handle_map& operator=(const sharded_handle_map&) = delete;
+
+   void insert_or_assign(uint64_t handle, uint64_t value = 0)
+   {
+      const uint64_t hash = get_hash(handle);
+      shard& shard = get_shard(hash);
+      const std::unique_lock lock = lock_shard(shard);
+      if (entry* existing_entry = shard.find(handle, hash))
+      {
+         existing_entry->value = value;
+         return;
+      }
+      // Keep the load factor (including the removed entries) below 50%, so probing chains stay short
+      if ((shard.size + shard.removed + 1) * 2 > shard.entries.size())
+      {
+         shard.rehash();
+      }
+      for (size_t slot = get_first_slot(shard, hash);; slot = (slot + 1) & (shard.entries.size() - 1))
+      {
+         entry& entry = shard.entries[slot];
+         if (entry.handle == empty_handle || entry.handle == removed_handle)
+         {
+            shard.removed -= entry.handle == removed_handle ? 1 : 0;
+            entry = { handle, value };
+            break;
+         }
+      }
+      shard.size++;
+      shard.insertions++;
+   }
+
+   // Returns false if the handle wasn't in the map
+   bool erase(uint64_t handle)
+   {
+      const uint64_t hash = get_hash(handle);
+      shard& shard = get_shard(hash);
+      const std::unique_lock lock = lock_shard(shard);
+      entry* existing_entry = shard.find(handle, hash);
+      if (existing_entry == nullptr) return false;
+      // Don't set the entry as empty, or we'd break the probing chain of any handle that collided with this one
+      existing_entry->handle = removed_handle;
+      shard.size--;
+      shard.removed++;
+      shard.erasures++;
+      return true;
+   }
+
+   bool find(uint64_t handle, uint64_t& value)
+   {
+      const uint64_t hash = get_hash(handle);
+      shard& shard = get_shard(hash);
+      const std::unique_lock lock = lock_shard(shard);
+      const entry* existing_entry = shard.find(handle, hash);
+      if (existing_entry == nullptr) return false;
+      value = existing_entry->value;
+      return true;
+   }
+
+   bool contains(uint64_t handle)
+   {
+      uint64_t value;
+      return find(handle, value);
+   }
+
+   void clear()
+   {
+      for (shard& shard : shards)
+      {
+         const std::unique_lock lock = lock_shard(shard);
+         shard.entries.clear();
+         shard.size = 0;
+         shard.removed = 0;
+      }
+   }
+
+   // Not an atomic snapshot across all the shards
+   statistics get_statistics()
+   {
+      statistics stats;
+      for (shard& shard : shards)
+      {
+         const std::unique_lock lock(shard.mutex);
+         stats.size += shard.size;
+         stats.capacity += shard.entries.size();
+         stats.max_shard_size = shard.size > stats.max_shard_size ? shard.size : stats.max_shard_size;
+         stats.insertions += shard.insertions;
+         stats.erasures += shard.erasures;
+         stats.contentions += shard.contentions;
+      }
+      return stats;
+   }
+
+private:
+   static constexpr uint64_t empty_handle = 0;
+   static constexpr uint64_t removed_handle = ~uint64_t(0);
+   static constexpr size_t shard_bits = std::bit_width(shards_num_pow2) - 1;
+   static constexpr size_t initial_shard_capacity = 64;
+
+   struct entry
+   {
+      uint64_t handle = empty_handle;
+      uint64_t value = 0;
+   };
+
+   // Aligned to avoid false sharing between the locks of different shards
+   struct alignas(64) shard
+   {
+      std::mutex mutex;
+      std::vector<entry> entries; // The size is always a power of 2 (or zero)
+      size_t size = 0;
+      size_t removed = 0;
+      uint64_t insertions = 0;
+      uint64_t erasures = 0;
+      uint64_t contentions = 0;
+
+      entry* find(uint64_t handle, uint64_t hash)
+      {
+         if (entries.empty()) return nullptr;
+         for (size_t i = 0, slot = get_first_slot(*this, hash); i < entries.size(); i++, slot = (slot + 1) & (entries.size() - 1))
+         {
+            if (entries[slot].handle == handle) return &entries[slot];
+            if (entries[slot].handle == empty_handle) break;
+         }
+         return nullptr;
+      }
+
+      // Grows the table if it's getting full, otherwise it simply gets rid of the removed entries
+      void rehash()
+      {
+         size_t new_capacity = entries.empty() ? initial_shard_capacity : entries.size();
+         while ((size + 1) * 4 > new_capacity)
+         {
+            new_capacity *= 2;
+         }
+         std::vector<entry> old_entries(new_capacity);
+         old_entries.swap(entries);
+         removed = 0;
+         for (const entry& old_entry : old_entries)
+         {
+            if (old_entry.handle == empty_handle || old_entry.handle == removed_handle) continue;
+            size_t slot = get_first_slot(*this, get_hash(old_entry.handle));
+            while (entries[slot].handle != empty_handle)
+            {
+               slot = (slot + 1) & (entries.size() - 1);
+            }
+            entries[slot] = old_entry;
+         }
+      }
+   };
+
+   // Handles are usually pointers, so their lowest bits are always zero, and the highest ones are almost always the same, mix them all up ("splitmix64" finalizer)
+   static uint64_t get_hash(uint64_t handle)
+   {
+      handle ^= handle >> 30;
+      handle *= 0xBF58476D1CE4E5B9ull;
+      handle ^= handle >> 27;
+      handle *= 0x94D049BB133111EBull;
+      handle ^= handle >> 31;
+      return handle;
+   }
+
+   shard& get_shard(uint64_t hash)
+   {
+      return shards[hash & (shards_num_pow2 - 1)];
+   }
+
+   // The lowest bits of the hash have already been used to pick the shard
+   static size_t get_first_slot(const shard& shard, uint64_t hash)
+   {
+      return size_t(hash >> shard_bits) & (shard.entries.size() - 1);
+   }
+
+   static std::unique_lock<std::mutex> lock_shard(shard& shard)
+   {
+      std::unique_lock lock(shard.mutex, std::try_to_lock);
+      if (!lock.owns_lock())
+      {
+         lock.lock();
+         shard.contentions++;
+      }
+      return lock;
+   }
+
+   shard shards[shards_num_pow2];
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <vector>
+
+// Fixed capacity single producer single consumer ring buffer of (trivially copyable) trace records.
+// It's meant to be owned by a command list, with the thread recording the command list being the only producer (there's only one at a time),
+// and the thread that submits it (e.g. on execution, or on present) being the only consumer, which merges its records into the final trace, in submission order.
+// Pushing is wait free and never locks, so tracing doesn't (much) distort the timings or the threads interleaving of the frame being traced.
+// The records memory is only allocated the first time anything is pushed, given that most command lists will never be traced.
+// Records that don't fit are dropped (and counted), the producer can check the result of "push()" to drain the ring itself if it's also the consumer.
+template<typename T, size_t capacity_pow2 = 16384>
+class trace_ring
+{
+   static_assert((capacity_pow2 & (capacity_pow2 - 1)) == 0, "The capacity needs to be a power of 2");
+   static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+   trace_ring() = default;
+   trace_ring(const trace_ring&) = delete;
+   trace_ring& operator=(const trace_ring&) = delete;
+
+   // Producer only
+   bool push(const T& record)
+   {
+      const uint64_t head = write_index.load(std::memory_order_relaxed);
+      if (head - read_index.load(std::memory_order_acquire) >= capacity_pow2)
+      {
+         dropped_records.fetch_add(1, std::memory_order_relaxed);
+         return false;
+      }
+      if (records == nullptr)
+      {
+         records = std::make_unique<T[]>(capacity_pow2);
+      }
+      records[head & (capacity_pow2 - 1)] = record;
+      write_index.store(head + 1, std::memory_order_release); // Publish the record (and the records allocation)
+      return true;
+   }
+
+   // Consumer only. Calls "function" on all the records that were pushed until now, in order, and removes them. Returns the number of records drained.
+   template<typename F>
+   size_t drain(F&& function)
+   {
+      const uint64_t tail = read_index.load(std::memory_order_relaxed);
+      const uint64_t head = write_index.load(std::memory_order_acquire);
+      for (uint64_t i = tail; i != head; i++)
+      {
+         function(records[i & (capacity_pow2 - 1)]);
+      }
+      read_index.store(head, std::memory_order_release); // Free up the slots for the producer
+      return size_t(head - tail);
+   }
+
+   bool empty() const
+   {
+      return write_index.load(std::memory_order_acquire) == read_index.load(std::memory_order_relaxed);
+   }
+
+   uint64_t get_dropped_count() const
+   {
+      return dropped_records.load(std::memory_order_relaxed);
+   }
+
+private:
+   std::unique_ptr<T[]> records;
+   std::atomic<uint64_t> write_index = 0;
+   std::atomic<uint64_t> read_index = 0;
+   std::atomic<uint64_t> dropped_records = 0;
+};
+
+// The trace of a command list: the records it traced itself (in its ring), and the final (unpacked) trace they get merged into, in submission order.
+// The final trace of a command list also includes the ones of the command lists that were executed on it, so records survive being merged more than once,
+// e.g. the ones of a deferred context are merged into its command list object when it's finished, and then, from there, into the immediate context when that is executed.
+// Records ("R") are expected to have a "trace_index" member, the ones of other traces (e.g. of command lists that were never executed within their trace) are discarded.
+template<typename R, typename D, size_t capacity_pow2 = 16384>
+class command_list_trace
+{
+public:
+   // The only producer is the thread recording the command list
+   trace_ring<R, capacity_pow2> records;
+   // For "data"
+   std::shared_mutex mutex;
+   std::vector<D> data;
+
+   // Moves the records of "source" (this same trace, to only merge its own ring) at the end of the final trace, unpacking them through "unpack".
+   // Expects to be called from the thread that submits "source" (the consumer of its ring).
+   template<typename F>
+   void merge(command_list_trace& source, uint32_t trace_index, F&& unpack)
+   {
+      if (&source == this && records.empty()) return;
+      const std::unique_lock lock(mutex);
+      if (data_trace_index != trace_index)
+      {
+         data.clear();
+         data_trace_index = trace_index;
+      }
+      if (&source != this)
+      {
+         // These were merged before the ones still in the ring (e.g. when the command list was finished)
+         const std::unique_lock source_lock(source.mutex);
+         if (source.data_trace_index == trace_index)
+         {
+            data.insert(data.end(), std::make_move_iterator(source.data.begin()), std::make_move_iterator(source.data.end()));
+         }
+         source.data.clear();
+      }
+      source.records.drain([&](const R& record)
+         {
+            if (record.trace_index == trace_index)
+            {
+               data.push_back(unpack(record));
+            }
+         });
+   }
+
+private:
+   // The trace "data" belongs to ("mutex")
+   uint32_t data_trace_index = 0;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <include/reshade.hpp>
+#include <source/com_ptr.hpp>
+
+// Pool of the (2D) textures we create for our custom passes, that need to be re-created every time the resolution or format they depend on changes (e.g. on window resizing).
+// Textures are acquired by description, and released back into the pool when they aren't needed anymore, instead of being destroyed,
+// so any other pass (or the same pass, later) that needs a texture with the same description can re-use it (alias it), without any further allocation.
+// Textures that haven't been re-used for a few frames are actually freed (deferred), to avoid re-creating them in case the resolution is just quickly toggling (e.g. when resizing a window, or toggling DLSS),
+// and to avoid having both the old and the new textures of all passes alive at the same time for long (VRAM spikes).
+// Free textures are bucketed by their size class (their description), so lookups never need to go through textures that aren't compatible.
+// Thread safe.
+class transient_texture_pool
+{
+public:
+   // How many frames a free texture is kept around for, before being destroyed
+   static constexpr uint32_t max_free_frames = 4;
+
+   transient_texture_pool() = default;
+   transient_texture_pool(const transient_texture_pool&) = delete;
+   transient_texture_pool& operator=(const transient_texture_pool&) = delete;
+
+   // Returns a texture with exactly the given description (either re-used or newly created), or nullptr if the creation failed
+   com_ptr<ID3D11Texture2D> acquire(ID3D11Device* device, const D3D11_TEXTURE2D_DESC& desc)
+   {
+      const std::lock_guard lock(mutex);
+      auto& bucket = free_textures[get_bucket_key(desc)];
+      for (auto it = bucket.begin(); it != bucket.end(); ++it)
+      {
+         // Buckets can contain more than one size class if their keys collided
+         if (std::memcmp(&it->desc, &desc, sizeof(desc)) == 0)
+         {
+            com_ptr<ID3D11Texture2D> texture = std::move(it->texture);
+            bucket.erase(it);
+            stats.reused_textures++;
+            return texture;
+         }
+      }
+
+      com_ptr<ID3D11Texture2D> texture;
+      HRESULT hr = device->CreateTexture2D(&desc, nullptr, &texture);
+      if (FAILED(hr)) return nullptr;
+      stats.created_textures++;
+      stats.allocated_bytes += get_texture_size(desc);
+      if (stats.allocated_bytes > stats.peak_allocated_bytes)
+      {
+         stats.peak_allocated_bytes = stats.allocated_bytes;
+      }
+      return texture;
+   }
+
+   // Gives back the texture to the pool (and clears the pointer), it can be re-used from now on, so it shouldn't be used by the GPU anymore after this,
+   // though given that DX11 serializes all the commands, that only matters for the commands that haven't been recorded yet.
+   // Any views of the texture should be released by the caller.
+   void release(com_ptr<ID3D11Texture2D>& texture)
+   {
+      if (texture.get() == nullptr) return;
+      D3D11_TEXTURE2D_DESC desc;
+      texture->GetDesc(&desc);
+      const std::lock_guard lock(mutex);
+      auto& free_texture = free_textures[get_bucket_key(desc)].emplace_back();
+      free_texture.desc = desc;
+      free_texture.texture = std::move(texture);
+      free_texture.release_frame = frame;
+      texture = nullptr;
+   }
+
+   // Call this once per frame (e.g. on present), it destroys the textures that haven't been re-used for long enough
+   void end_frame()
+   {
+      const std::lock_guard lock(mutex);
+      frame++;
+      for (auto it = free_textures.begin(); it != free_textures.end();)
+      {
+         std::erase_if(it->second, [this](const free_texture& free_texture)
+            {
+               if (frame - free_texture.release_frame <= max_free_frames) return false;
+               stats.allocated_bytes -= get_texture_size(free_texture.desc);
+               stats.destroyed_textures++;
+               return true;
+            });
+         it = it->second.empty() ? free_textures.erase(it) : std::next(it);
+      }
+   }
+
+   // Destroys all the free textures immediately
+   void clear()
+   {
+      const std::lock_guard lock(mutex);
+      for (const auto& bucket : free_textures)
+      {
+         for (const auto& free_texture : bucket.second)
+         {
+            stats.allocated_bytes -= get_texture_size(free_texture.desc);
+            stats.destroyed_textures++;
+         }
+      }
+      free_textures.clear();
+   }
+
+   struct statistics
+   {
+      uint64_t created_textures = 0;
+      uint64_t reused_textures = 0;
+      uint64_t destroyed_textures = 0;
+      // Approximate, it doesn't account for any padding and alignment
+      uint64_t allocated_bytes = 0;
+      uint64_t peak_allocated_bytes = 0;
+   };
+
+   statistics get_statistics()
+   {
+      const std::lock_guard lock(mutex);
+      return stats;
+   }
+
+private:
+   struct free_texture
+   {
+      D3D11_TEXTURE2D_DESC desc;
+      com_ptr<ID3D11Texture2D> texture;
+      uint32_t release_frame = 0;
+   };
+
+   static uint64_t get_bucket_key(const D3D11_TEXTURE2D_DESC& desc)
+   {
+      return (uint64_t(desc.Width) << 40) ^ (uint64_t(desc.Height) << 16) ^ (uint64_t(desc.Format) << 8) ^ uint64_t(desc.BindFlags) ^ (uint64_t(desc.MipLevels) << 56) ^ (uint64_t(desc.ArraySize) << 60);
+   }
+
+   static uint64_t get_texture_size(const D3D11_TEXTURE2D_DESC& desc)
+   {
+      // ReShade formats match DXGI ones
+      const uint64_t mip_size = uint64_t(reshade::api::format_row_pitch(static_cast<reshade::api::format>(desc.Format), desc.Width)) * desc.Height;
+      // Mips are roughly a third of the first one in total
+      return mip_size * desc.ArraySize * (desc.MipLevels != 1 ? 4 : 3) / 3 * (desc.SampleDesc.Count > 0 ? desc.SampleDesc.Count : 1);
+   }
+
+   std::mutex mutex;
+   std::unordered_map<uint64_t, std::vector<free_texture>> free_textures; // By "get_bucket_key()"
+   uint32_t frame = 0;
+   statistics stats;
+};
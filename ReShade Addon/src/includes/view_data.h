@@ -0,0 +1,579 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include <include/reshade.hpp>
+#include <source/com_ptr.hpp>
+
+#include "cbuffers.h"
+#include "math.h"
+#include "matrix.h"
+#include "rcu_snapshot.h"
+#include "custom_sampler_cache.h"
+#include "frame_passes.h"
+#include "sampler_upgrade.h"
+#include "../utils/cbuffer.hpp"
+
+// The scene view data we read from the game global (per view) cbuffer (rendering and output resolutions, DRS, TAA jitters, projection matrices...),
+// and our own cbuffers that pass it on to our shaders, through "UpdateGlobalCBuffer()" (on every map of the global cbuffer) and "SetLumaConstantBuffers()" (before our draws).
+// Depends on "DEVELOPMENT" and "ASSERT_ONCE()" (see "main.cpp").
+namespace
+{
+   // Mutex to deal with data shader with ReShade, like ini/config saving and loading (including "cb_luma_frame_settings" and "cb_luma_frame_settings_dirty")
+   std::shared_mutex s_mutex_reshade;
+   // For "texture_mip_lod_bias_offset"
+   std::shared_mutex s_mutex_samplers;
+
+#if DEVELOPMENT
+   bool custom_texture_mip_lod_bias_offset = false; // Live edit
+   bool disable_taa_jitters = false;
+#endif
+
+   // Game specific constants:
+   constexpr uint32_t luma_settings_cbuffer_index = 2; // 2 is unused by Prey
+   constexpr uint32_t luma_data_cbuffer_index = 8; // 8 is unused by Prey
+   constexpr uint32_t luma_ui_cbuffer_index = 7; // 7 is almost 100% unused by Prey
+
+   // Global data (not device dependent really):
+
+   // Directly from cbuffer (so these are transposed)
+   Matrix44A projection_matrix;
+   Matrix44A nearest_projection_matrix; // For first person weapons (view model)
+   Matrix44A previous_projection_matrix;
+   Matrix44A previous_nearest_projection_matrix;
+   Matrix44A reprojection_matrix;
+   float2 previous_projection_jitters = { 0, 0 };
+   float2 projection_jitters = { 0, 0 };
+   uint32_t frame_index = 0; // No need for this to be by device
+   CBPerViewGlobal cb_per_view_global = { };
+   CBPerViewGlobal cb_per_view_global_previous = { };
+   // The last (raw) global cbuffer that was accepted as the main view one, and the registers that changed in it compared to the one accepted before it
+   CBPerViewGlobal cb_per_view_global_last_accepted = { };
+   uint64_t cb_per_view_global_changed_registers = 0;
+   static_assert(sizeof(CBPerViewGlobal) <= utils::cbuffer::max_compared_size);
+   LumaFrameSettings cb_luma_frame_settings = { }; // Not in device data as this stores some users settings too // Set "cb_luma_frame_settings_dirty" when changing within a frame (so it's uploaded again)
+
+   // The part of the device data ("DeviceData") about the scene view and our cbuffers
+   struct DeviceViewData
+   {
+      // Lock free readers (e.g. of "custom_samplers") might still be using the objects retired in here
+      rcu_domain rcu;
+
+      // Custom samplers mapped to original ones by (quantized) texture LOD bias
+      custom_sampler_cache custom_samplers{ rcu };
+
+      bool dlss_sr = true; // If true DLSS is enabled by the user and supported+initialized correctly on this device
+
+      // CBuffers
+      com_ptr<ID3D11Buffer> luma_frame_settings;
+      com_ptr<ID3D11Buffer> luma_frame_data;
+      com_ptr<ID3D11Buffer> luma_ui_data;
+      LumaFrameData cb_luma_frame_data = {};
+      LumaUIData cb_luma_ui_data = {};
+      bool cb_luma_frame_settings_dirty = true;
+
+      // Whether the last global cbuffers we validated were of the main view, as the same (identical) ones are often uploaded multiple times
+      utils::cbuffer::VerdictCache<sizeof(CBPerViewGlobal)> cb_per_view_global_verdicts;
+
+      // The passes drawn in this frame and in the previous one.
+      // The previous frame ones are useful to know if rendering was skipped (e.g. in case we were in a UI view).
+      frame_pass_tracker frame_passes;
+
+      std::atomic<bool> found_per_view_globals = false;
+      // Whether the rendering resolution was scaled in this frame (different from the ouput resolution)
+      std::atomic<bool> prey_drs_active = false;
+      std::atomic<bool> prey_drs_detected = false;
+      std::atomic<bool> prey_taa_active = false;
+      std::atomic<bool> prey_taa_detected = false;
+      std::atomic<bool> force_reset_dlss_sr = false;
+      std::atomic<float> dlss_render_resolution_scale = 1.f;
+      std::atomic<bool> dlss_sr_suppressed = false;
+      // Index 0 is one frame ago, index 1 is two frames ago
+      bool previous_prey_taa_active[2] = { false, false };
+
+      float2 render_resolution = { 1, 1 };
+      float2 previous_render_resolution = { 1, 1 };
+      float2 output_resolution = { 1, 1 };
+
+      // Live settings (set by the code, not directly by users):
+      float texture_mip_lod_bias_offset = 0.f;
+
+      uint32_t cloned_pipeline_count = 0; // How many pipelines (shaders/passes) we replaced with custom ones (if zero, we can assume the mod isn't doing much)
+   };
+
+   enum class LumaConstantBufferType
+   {
+      LumaSettings,
+      LumaData,
+      LumaUIData
+   };
+
+   void SetLumaConstantBuffers(ID3D11DeviceContext* native_device_context, DeviceViewData& device_data, reshade::api::shader_stage stages, LumaConstantBufferType type, uint32_t custom_data = 0)
+   {
+      // CryEngine doesn't ever use these buffers, so it's fine to update them once per frame if they didn't change
+      switch (type)
+      {
+      case LumaConstantBufferType::LumaSettings:
+      {
+         {
+            const std::shared_lock lock_reshade(s_mutex_reshade);
+            if (device_data.cb_luma_frame_settings_dirty)
+            {
+               device_data.cb_luma_frame_settings_dirty = false;
+               // My understanding is that "Map" doesn't immediately copy the memory to the GPU, but simply stores it on the side (in the command list),
+               // and then copies it to the GPU when the command list is executed, so the resource is updated with deterministic order.
+               // From our point of view, we don't really know what command list is currently running and what it is doing,
+               // so we could still end up first updating the resource in a command list that will be executed with a delay,
+               // and then updating the resource again in a command list that executes first, leaving the GPU buffer with whatever latest data it got (which might not be based on our latest version).
+               // Fortunately we don't use our cbuffers in any of the non main CryEngine command lists, so we can consider it all single threaded and deterministic.
+               if (D3D11_MAPPED_SUBRESOURCE mapped_buffer;
+                  SUCCEEDED(native_device_context->Map(device_data.luma_frame_settings.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_buffer)))
+               {
+                  std::memcpy(mapped_buffer.pData, &cb_luma_frame_settings, sizeof(cb_luma_frame_settings));
+                  native_device_context->Unmap(device_data.luma_frame_settings.get(), 0);
+               }
+            }
+         }
+
+         ID3D11Buffer* const buffer = device_data.luma_frame_settings.get();
+         if ((stages & reshade::api::shader_stage::vertex) == reshade::api::shader_stage::vertex)
+            native_device_context->VSSetConstantBuffers(luma_settings_cbuffer_index, 1, &buffer);
+         if ((stages & reshade::api::shader_stage::geometry) == reshade::api::shader_stage::geometry)
+            native_device_context->GSSetConstantBuffers(luma_settings_cbuffer_index, 1, &buffer);
+         if ((stages & reshade::api::shader_stage::pixel) == reshade::api::shader_stage::pixel)
+            native_device_context->PSSetConstantBuffers(luma_settings_cbuffer_index, 1, &buffer);
+         if ((stages & reshade::api::shader_stage::compute) == reshade::api::shader_stage::compute)
+            native_device_context->CSSetConstantBuffers(luma_settings_cbuffer_index, 1, &buffer);
+         break;
+      }
+      case LumaConstantBufferType::LumaData:
+      {
+         LumaFrameData cb_luma_frame_data;
+         cb_luma_frame_data.PostEarlyUpscaling = device_data.frame_passes.has_drawn(FramePass::DLSS_SR) && !device_data.frame_passes.has_drawn(FramePass::Upscaling); // TODO: delete? it's unused and kinda useless as we update the resolution scale anyway
+         cb_luma_frame_data.CustomData = custom_data;
+         cb_luma_frame_data.Padding = 0;
+         cb_luma_frame_data.FrameIndex = frame_index;
+         cb_luma_frame_data.CameraJitters = projection_jitters; // TODO: pre-multiply these by float2(0.5, -0.5) (NDC to UV space) given that they are always used in UV space by shaders. It doesn't really matter as they end up as "mad" single instructions
+         cb_luma_frame_data.PreviousCameraJitters = previous_projection_jitters;
+         cb_luma_frame_data.RenderResolutionScale.x = device_data.render_resolution.x / device_data.output_resolution.x;
+         cb_luma_frame_data.RenderResolutionScale.y = device_data.render_resolution.y / device_data.output_resolution.y;
+         // Always do this relative to the current output resolution
+         cb_luma_frame_data.PreviousRenderResolutionScale.x = device_data.previous_render_resolution.x / device_data.output_resolution.x;
+         cb_luma_frame_data.PreviousRenderResolutionScale.y = device_data.previous_render_resolution.y / device_data.output_resolution.y;
+#if 0
+         cb_luma_frame_data.ViewProjectionMatrix = cb_per_view_global.CV_ViewProjMatr; // Note that this is not 100% thread safe as "CV_ViewProjMatr" is written from another thread
+         cb_luma_frame_data.PreviousViewProjectionMatrix = cb_per_view_global_previous.CV_ViewProjMatr;
+#endif
+         cb_luma_frame_data.ReprojectionMatrix = reprojection_matrix;
+
+         if (memcmp(&device_data.cb_luma_frame_data, &cb_luma_frame_data, sizeof(cb_luma_frame_data)) != 0)
+         {
+            device_data.cb_luma_frame_data = cb_luma_frame_data;
+            if (D3D11_MAPPED_SUBRESOURCE mapped_buffer;
+               SUCCEEDED(native_device_context->Map(device_data.luma_frame_data.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_buffer)))
+            {
+               std::memcpy(mapped_buffer.pData, &device_data.cb_luma_frame_data, sizeof(device_data.cb_luma_frame_data));
+               native_device_context->Unmap(device_data.luma_frame_data.get(), 0);
+            }
+         }
+
+         ID3D11Buffer* const buffer = device_data.luma_frame_data.get();
+         if ((stages & reshade::api::shader_stage::vertex) == reshade::api::shader_stage::vertex)
+            native_device_context->VSSetConstantBuffers(luma_data_cbuffer_index, 1, &buffer);
+         if ((stages & reshade::api::shader_stage::geometry) == reshade::api::shader_stage::geometry)
+            native_device_context->GSSetConstantBuffers(luma_data_cbuffer_index, 1, &buffer);
+         if ((stages & reshade::api::shader_stage::pixel) == reshade::api::shader_stage::pixel)
+            native_device_context->PSSetConstantBuffers(luma_data_cbuffer_index, 1, &buffer);
+         if ((stages & reshade::api::shader_stage::compute) == reshade::api::shader_stage::compute)
+            native_device_context->CSSetConstantBuffers(luma_data_cbuffer_index, 1, &buffer);
+         break;
+      }
+      case LumaConstantBufferType::LumaUIData:
+      {
+         ASSERT_ONCE(false); // Not implemented (yet?)
+         break;
+      }
+      }
+   }
+
+
+#if DEVELOPMENT
+   std::thread::id global_cbuffer_thread_id;
+#endif // DEVELOPMENT
+
+   // Returns whether the global cbuffer (index 13) data is the one of the main view (the scene camera), as opposed to the one of shadow maps, cubemaps, UI etc.
+   // This only depends on the data itself.
+   bool IsMainViewGlobalCBuffer(const CBPerViewGlobal& global_buffer_data)
+   {
+      // Is this the cbuffer we are looking for?
+      // Note that even if it was, in the menu a lot of these parameters are uninitialized (usually zeroed around, with matrices being identity).
+      // This check overall is a bit crazy, but there's ~0% chance that it will fail and accidentally use a buffer that isn't the global one (cb13)
+      bool is_valid_cbuffer = true
+         && utils::cbuffer::AllGreater(&global_buffer_data.CV_AnimGenParams.x, 0.f, true) // These are either all 4 0 or all 4 > 0
+         && global_buffer_data.CV_CameraRightVector.w == 0.f
+         && global_buffer_data.CV_CameraFrontVector.w == 0.f
+         && global_buffer_data.CV_CameraUpVector.w == 0.f
+         && utils::cbuffer::AllGreater(&global_buffer_data.CV_ScreenSize.x, 0.f)
+         && AlmostEqual(global_buffer_data.CV_ScreenSize.x, global_buffer_data.CV_HPosScale.x * (0.5f / global_buffer_data.CV_ScreenSize.z), 0.5f) && AlmostEqual(global_buffer_data.CV_ScreenSize.y, global_buffer_data.CV_HPosScale.y * (0.5f / global_buffer_data.CV_ScreenSize.w), 0.5f)
+         && utils::cbuffer::AllInRange(&global_buffer_data.CV_HPosScale.x, 0.f, 1.f)
+         && utils::cbuffer::AllInRange(&global_buffer_data.CV_HPosClamp.x, 0.f, 1.f)
+         //&& mathMatrixAlmostEqual(global_buffer_data.CV_InvViewProj.GetTransposed(), global_buffer_data.CV_ViewProjMatr.GetTransposed().GetInverted(), 0.001f) // These checks fail, they need more investigation
+         //&& mathMatrixAlmostEqual(global_buffer_data.CV_InvViewMatr.GetTransposed(), global_buffer_data.CV_ViewMatr.GetTransposed().GetInverted(), 0.001f)
+         && (mathMatrixIsProjection(global_buffer_data.CV_PrevViewProjMatr.GetTransposed()) || mathMatrixIsIdentity(global_buffer_data.CV_PrevViewProjMatr)) // For shadow projection "CV_PrevViewProjMatr" is actually what its names says it is, instead of being the current projection matrix as in other passes
+         && (mathMatrixIsProjection(global_buffer_data.CV_PrevViewProjNearestMatr.GetTransposed()) || mathMatrixIsIdentity(global_buffer_data.CV_PrevViewProjNearestMatr))
+         && global_buffer_data.CV_SunLightDir.w == 1.f
+         //&& global_buffer_data.CV_SunColor.w == 1.f // This is only approximately 1 (maybe not guaranteed, sometimes it's 0)
+         && global_buffer_data.CV_SkyColor.w == 1.f
+         && global_buffer_data.CV_DecalZFightingRemedy.w == 0.f
+         && global_buffer_data.CV_PADDING0 == 0.f && global_buffer_data.CV_PADDING1 == 0.f
+         ;
+
+      if (!is_valid_cbuffer)
+      {
+         return false;
+      }
+
+#if 0 // This happens, but it's not a problem
+      char* global_buffer_data_ptr_cast = (char*)&global_buffer_data;
+      // Make sure that all extra memory is zero, as an extra check. This could easily be uninitialized memory though.
+      ASSERT_ONCE(IsMemoryAllZero(&global_buffer_data_ptr_cast[sizeof(CBPerViewGlobal) - 1], CBPerViewGlobal_buffer_size - sizeof(CBPerViewGlobal)));
+#endif
+
+      ASSERT_ONCE((global_buffer_data.CV_DecalZFightingRemedy.x >= 0.9f && global_buffer_data.CV_DecalZFightingRemedy.x <= 1.f) || global_buffer_data.CV_DecalZFightingRemedy.x == 0.f);
+
+      // Shadow maps and other things temporarily change the values in the global cbuffer,
+      // like not use inverse depth (which affects the projection matrix, and thus many other matrices?),
+      // use different render and output resolutions, etc etc.
+      // We could also base our check on "CV_ProjRatio" (x and y) and "CV_FrustumPlaneEquation" and "CV_DecalZFightingRemedy" as these are also different for alternative views.
+      // "CV_PrevViewProjMatr" is not a raw projection matrix when rendering shadow maps, so we can easily detect that.
+      // Note: we can check if the matrix is identity to detect whether we are currently in a menu (the main menu?)
+      bool is_custom_draw_version = !mathMatrixIsProjection(global_buffer_data.CV_PrevViewProjMatr.GetTransposed());
+      return !is_custom_draw_version;
+   }
+
+   // Call this after reading the global cbuffer (index 13) memory (from CPU or GPU memory). This seemengly only happens in one thread.
+   // This will update the "cb_per_view_global" values if the ptr is found to be the right type of buffer (and return true in that case),
+   // correct some of its values, and cache information for other usage.
+   // 
+   // An alternative way of approaching this would be to cache all the address of buffers that are ever filled up through ::Map() calls,
+   // then store a copy of each of their instances, and when one of these buffers is set to a shader stage, re-set the same cbuffer with our
+   // modified and fixed up data. That is a bit slower but it would be more safe, as it would guarantee us 100% that the buffer we are changing is cbuffer 13.
+   // If we were looking for the value of only one buffer in particular, we can simply store the buffer pointers from the DX state in a specific draw call, and then check for following map calls to it.
+   // "force_motion_vectors_jittered" replaces the previous projection matrices even if DLSS isn't running (see the "FORCE_MOTION_VECTORS_JITTERED" shader define).
+   bool UpdateGlobalCBuffer(const void* global_buffer_data_ptr, DeviceViewData& device_data, bool force_motion_vectors_jittered)
+   {
+      const CBPerViewGlobal& global_buffer_data = *((const CBPerViewGlobal*)global_buffer_data_ptr);
+
+      // The same buffers (e.g. the shadow maps ones, or the main one when the camera doesn't move) are uploaded many times per frame, so we skip validating the ones we already validated recently
+      const uint64_t global_buffer_data_fingerprint = utils::cbuffer::ComputeFingerprint(&global_buffer_data, sizeof(CBPerViewGlobal));
+      bool is_main_view_cbuffer = false;
+      if (!device_data.cb_per_view_global_verdicts.Find(&global_buffer_data, global_buffer_data_fingerprint, is_main_view_cbuffer))
+      {
+         is_main_view_cbuffer = IsMainViewGlobalCBuffer(global_buffer_data);
+         device_data.cb_per_view_global_verdicts.Add(&global_buffer_data, global_buffer_data_fingerprint, is_main_view_cbuffer);
+      }
+
+#if DEVELOPMENT && 0
+      cb_per_view_globals.emplace_back(global_buffer_data);
+      cb_per_view_globals_last_drawn_shader.emplace_back(last_drawn_shader); // The shader hash could we unspecified if we didn't replace the shader
+#endif // DEVELOPMENT
+
+      if (!is_main_view_cbuffer)
+      {
+         return false;
+      }
+
+      float cb_output_resolution_x = std::round(0.5f / global_buffer_data.CV_ScreenSize.z); // Round here already as it would always meant to be integer
+      float cb_output_resolution_y = std::round(0.5f / global_buffer_data.CV_ScreenSize.w);
+
+      bool output_resolution_matches = AlmostEqual(device_data.output_resolution.x, cb_output_resolution_x, 0.5f) && AlmostEqual(device_data.output_resolution.y, cb_output_resolution_y, 0.5f);
+
+#if DEVELOPMENT
+      std::thread::id new_global_cbuffer_thread_id = std::this_thread::get_id();
+      // Make sure this cbuffer is always updated in the same thread (forever)
+      if (global_cbuffer_thread_id != std::thread::id())
+      {
+         ASSERT_ONCE(global_cbuffer_thread_id == new_global_cbuffer_thread_id);
+      }
+      global_cbuffer_thread_id = new_global_cbuffer_thread_id;
+#endif
+
+      cb_per_view_global_changed_registers = utils::cbuffer::CompareRegisters(&cb_per_view_global_last_accepted, &global_buffer_data, sizeof(CBPerViewGlobal));
+      cb_per_view_global_last_accepted = global_buffer_data;
+
+      // Copy the temporary buffer ptr into our persistent data
+      cb_per_view_global = global_buffer_data;
+
+      // Re-use the current cbuffer as the previous one if we didn't draw the scene in the frame before
+      const CBPerViewGlobal& cb_per_view_global_actual_previous = device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing) ? cb_per_view_global_previous : cb_per_view_global;
+
+      auto current_projection_matrix = cb_per_view_global.CV_PrevViewProjMatr;
+      auto current_nearest_projection_matrix = cb_per_view_global.CV_PrevViewProjNearestMatr;
+
+      // Note that "prey_taa_detected" would be one frame late here, but to avoid unexpectedly replacing proj matrices, we check it anyway  (the game always starts with a fade to black, so it's fine)
+      bool replace_prev_projection_matrix = device_data.cloned_pipeline_count != 0 && ((device_data.dlss_sr && !device_data.dlss_sr_suppressed && device_data.prey_taa_detected) || force_motion_vectors_jittered);
+
+
+      if (!device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing))
+      {
+         previous_projection_matrix = current_projection_matrix;
+         previous_nearest_projection_matrix = current_nearest_projection_matrix;
+      }
+
+      // Fix up the "previous view projection matrices" as they had wrong data in Prey,
+      // first of all, their name was "wrong", because it was meant to have the value of the previous projection matrix,
+      // not the camera/view projection matrix, and second, it was actually always based on the current one,
+      // so it would miss any changes in FOV and jitters (drastically lowering the quality of motion vectors).
+      // After tonemapping, ignore fixing up these, because they'd be jitterless and we don't have a jitterless copy (they aren't used anyway!).
+      // If in the previous frame we didn't render, we don't replace the matrix with the one from the last frame that was rendered,
+      // because there's no guaranteed that it would match.
+      // If AA is disabled, or if the current form of AA doesn't use jittered rendering, this doesn't really make a difference (but it's still better because it creates motion vectors based on the previous view matrix).
+      // We've also tried to completely remove the jitters from here and the DLSS reprojection matrix below, and disabling "NVSDK_NGX_DLSS_Feature_Flags_MVJittered" in DLSS, but it doesn't seem to help.
+      // Apparently we can also modulate the values in "CV_ViewProjMatr" etc to move the camera in game, but that would require a lot more to polish for (e.g.) a photo mode.
+      if (replace_prev_projection_matrix && !device_data.frame_passes.has_drawn(FramePass::Tonemapping) && device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing))
+      {
+         cb_per_view_global.CV_PrevViewProjMatr = previous_projection_matrix;
+         cb_per_view_global.CV_PrevViewProjNearestMatr = previous_nearest_projection_matrix;
+      }
+#if DEVELOPMENT
+      // Just for test.
+      if (disable_taa_jitters)
+      {
+         current_projection_matrix.m02 = 0;
+         current_projection_matrix.m12 = 0;
+         current_nearest_projection_matrix.m02 = 0;
+         current_nearest_projection_matrix.m12 = 0;
+         cb_per_view_global.CV_PrevViewProjMatr.m02 = 0;
+         cb_per_view_global.CV_PrevViewProjMatr.m12 = 0;
+         cb_per_view_global.CV_PrevViewProjNearestMatr.m02 = 0;
+         cb_per_view_global.CV_PrevViewProjNearestMatr.m12 = 0;
+      }
+#endif // DEVELOPMENT
+
+      // Fix up the rendering scale for all passes after DLSS SR, as we upscaled before the game expected,
+      // there's only post processing passes after it anyway (and lens optics shaders don't really read cbuffer 13 (we made sure of that), but still, some of their passes use custom resolutions).
+      if (device_data.frame_passes.has_drawn(FramePass::DLSS_SR) && device_data.prey_drs_active && !device_data.frame_passes.has_drawn(FramePass::Upscaling))
+      {
+         cb_per_view_global.CV_ScreenSize.x = cb_output_resolution_x;
+         cb_per_view_global.CV_ScreenSize.y = cb_output_resolution_y;
+
+         cb_per_view_global.CV_HPosScale.x = 1.f;
+         cb_per_view_global.CV_HPosScale.y = 1.f;
+         // Upgrade the ones from the previous frame too, because at this rendering phase they'd also have been full resolution, and these aren't used anyway
+         cb_per_view_global.CV_HPosScale.z = cb_per_view_global.CV_HPosScale.x;
+         cb_per_view_global.CV_HPosScale.w = cb_per_view_global.CV_HPosScale.y;
+
+         // Clamp at the last texel center (half pixel offset) at the bottom right of the rendering (which is now equal to output) resolution area.
+         // We could probably set these to 1 as well, and skip the last half texel, but that would make the behaviour different from when DRS is running.
+         // Note that usually these would be set relative to the render target viewport resolution, not source texture resolution.
+         cb_per_view_global.CV_HPosClamp.x = 1.f - cb_per_view_global.CV_ScreenSize.z;
+         cb_per_view_global.CV_HPosClamp.y = 1.f - cb_per_view_global.CV_ScreenSize.w;
+         cb_per_view_global.CV_HPosClamp.z = cb_per_view_global.CV_HPosClamp.x;
+         cb_per_view_global.CV_HPosClamp.w = cb_per_view_global.CV_HPosClamp.y;
+      }
+
+      bool render_resolution_matches = AlmostEqual(device_data.render_resolution.x, cb_per_view_global.CV_ScreenSize.x, 0.5f) && AlmostEqual(device_data.render_resolution.y, cb_per_view_global.CV_ScreenSize.y, 0.5f);
+      bool is_in_post_processing = device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers) || device_data.frame_passes.has_drawn(FramePass::Tonemapping) || device_data.frame_passes.has_drawn(FramePass::MainPostProcessing);
+
+      // Update our cached data with information from the cbuffer.
+      // After vanilla tonemapping (as soon as AA starts),
+      // camera jitters are removed from the cbuffer projection matrices, and the render resolution is also set to 100% (after the upscaling pass),
+      // so we want to ignore these cases. We stop at the gbuffer compositions draw, because that's the last know cbuffer 13 to have the perfect values we are looking for (that shader is always run, so it's reliable)!
+      // A lot of passes are drawn on scaled down render targets and the cbuffer values would have been updated to reflect that (e.g. "CV_ScreenSize"), so ignore these cases.
+      if (output_resolution_matches && (!device_data.found_per_view_globals ? true : (!render_resolution_matches && !is_in_post_processing)))
+      {
+#if DEVELOPMENT
+         static float2 local_previous_render_resolution;
+         if (!device_data.found_per_view_globals)
+         {
+            local_previous_render_resolution.x = cb_per_view_global.CV_ScreenSize.x;
+            local_previous_render_resolution.y = cb_per_view_global.CV_ScreenSize.y;
+         }
+#endif // DEVELOPMENT
+
+         //TODOFT: these have read/writes that are possibly not thread safe but they should never cause issues in actual usages of Prey
+         device_data.render_resolution.x = cb_per_view_global.CV_ScreenSize.x;
+         device_data.render_resolution.y = cb_per_view_global.CV_ScreenSize.y;
+#if 0 // They should already match and the one we have would be more accurate anyway
+         device_data.output_resolution.x = cb_output_resolution_x; // Round here already as it would always meant to be integer
+         device_data.output_resolution.y = cb_output_resolution_y;
+#endif
+
+         auto previous_prey_drs_active = device_data.prey_drs_active.load();
+         device_data.prey_drs_active = std::abs(device_data.render_resolution.x - device_data.output_resolution.x) >= 0.5f || std::abs(device_data.render_resolution.y - device_data.output_resolution.y) >= 0.5f;
+         // Make sure this doesn't change within a frame (once we found DRS in a frame, we should never "lose" it again for that frame.
+         // Ignore this when we have no shaders loaded as it would always break due to the "FramePass::Tonemapping" check failing.
+         ASSERT_ONCE(device_data.cloned_pipeline_count == 0 || !device_data.found_per_view_globals || !previous_prey_drs_active || (previous_prey_drs_active == device_data.prey_drs_active));
+
+#if DEVELOPMENT
+         // Make sure that our rendering resolution doesn't change randomly within the pipeline (it probably will, it seems to trigger during quick save loads, maybe for the very first draw call to clear buffers)
+         const float2 previous_render_resolution = local_previous_render_resolution;
+         ASSERT_ONCE(!device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing) || !device_data.found_per_view_globals || !device_data.prey_drs_detected || (AlmostEqual(device_data.render_resolution.x, previous_render_resolution.x, 0.25f) && AlmostEqual(device_data.render_resolution.y, previous_render_resolution.y, 0.25f)));
+#endif // DEVELOPMENT
+
+         // Once we detect the user enabled DRS, we can't ever know it's been disabled because the game only occasionally drops to lower rendering resolutions, so we couldn't know if it was ever disabled
+         if (device_data.prey_drs_active)
+         {
+            device_data.prey_drs_detected = true;
+
+            float resolution_scale = device_data.render_resolution.y / device_data.output_resolution.y;
+            // Lower the DLSS quality mode (which might introduce a stutter, or a slight blurring of the image as it resets the history),
+            // but this will make DLSS not use DLAA and instead fall back on a quality mode that allows for a dynamic range of resolutions.
+            // This isn't the exact rend resolution DLSS will be forced to use, but the center of a range it's gonna expect.
+            // Unfortunately DLSS has a limited range of accepted resolutions per quality mode, and if you go beyond it, it fails to render (until in range again),
+            // thus, we need to make sure the automatic DRS range of Prey is within the same range!
+            // We couldn't change this resolution scale every frame as it's make DLSS stutter massively.
+            // See CryEngine "osm_fbMinScale" cvar (config), that drives the min rend res scale, the DLSS rend scale should ideally be set to the same value, but it's fine if it's above it, given it's the target "average" dynamic resolution.
+            // If CryEngine ever went below 50% render scale, we force DLSS into ultra performance mode (33%), as the range allowed by quality mode (67%) can't go below 50%. There will be a stutter (and history reset?) every time we swap back and forth, but at least it works...
+            if (resolution_scale < 0.5f - FLT_EPSILON)
+            {
+#if 1 // Unfortunately no quality mode with a res scale below 0.5 supports dynamic resolution scaling, so we are forced to change the quality mode every frame or so (or at least, every time Prey changes DRS value, which might further slow down the DRS detection mechanism...)
+               device_data.dlss_render_resolution_scale = resolution_scale;
+#else // If we do this, DLSS would fail if any resolution that didn't exactly match 33% render scale was used by the game
+               device_data.dlss_render_resolution_scale = 1.f / 3.f;
+#endif
+            }
+            else
+            {
+               // This should pick quality or balanced mode, with a range from 100% to 50% resolution scale
+               device_data.dlss_render_resolution_scale = 1.f / 1.5f;
+            }
+         }
+         // Reset to DLAA and try again (once), given that we can't go from a 1/3 to a 1 rend scale (e.g. in case DRS was disabled in the menu)
+         else if (device_data.dlss_sr_suppressed && device_data.dlss_render_resolution_scale != 1.f)
+         {
+            device_data.dlss_render_resolution_scale = 1.f;
+            device_data.dlss_sr_suppressed = false;
+         }
+
+         // NOTE: we could just save the first one we found, it should always be jittered and "correct".
+         projection_matrix = current_projection_matrix;
+         nearest_projection_matrix = current_nearest_projection_matrix;
+
+#if DEVELOPMENT
+         const auto projection_jitters_copy = projection_jitters;
+#endif
+
+         // These are called "m_vProjMatrixSubPixoffset" in CryEngine.
+         // The matrix is transposed so we flip the matrix x and y indices.
+         projection_jitters.x = current_projection_matrix(0, 2);
+         projection_jitters.y = current_projection_matrix(1, 2);
+
+#if DEVELOPMENT
+         ASSERT_ONCE(disable_taa_jitters || (projection_jitters_copy.x == 0 && projection_jitters_copy.y == 0) || (projection_jitters.x != 0 || projection_jitters.y != 0)); // Once we found jitters, we should never cache matrices that don't have jitters anymore
+#endif
+
+         bool prey_taa_active_copy = device_data.prey_taa_active;
+         // This is a reliable check to tell whether TAA is enabled. Jitters are "never" zero if they are enabled:
+         // they can be if we use the "srand" method, but it would happen one in a billion years;
+         // they could also be zero with Halton if the frame index was reset to zero (it is every x frames), but that happens very rarely, and for one frame only (we have two frames as tolerance).
+         device_data.prey_taa_active = (std::abs(projection_jitters.x * device_data.render_resolution.x) >= 0.00075) || (std::abs(projection_jitters.y * device_data.render_resolution.y) >= 0.00075); //TODOFT: make calculations more accurate (the threshold), especially with higher Halton phases!
+#if DEVELOPMENT
+         device_data.prey_taa_active = device_data.prey_taa_active || disable_taa_jitters;
+#endif // DEVELOPMENT
+         // Make sure that once we detect that TAA was active within a frame, then it should never be detected as off in the same frame (it would mean we are reading a bad cbuffer 13 that we should have discarded).
+         // Ignore this when we have no shaders loaded as it would always break due to the "FramePass::Tonemapping" check failing.
+         ASSERT_ONCE(device_data.cloned_pipeline_count == 0 || !device_data.found_per_view_globals || !prey_taa_active_copy || (prey_taa_active_copy == device_data.prey_taa_active));
+         if (prey_taa_active_copy != device_data.prey_taa_active && device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing)) // TAA changed
+         {
+            // Detect if TAA was ever detected as on/off/on or off/on/off over 3 frames, because if that was so, our jitter "length" detection method isn't solid enough and we should do more (or add more tolernace to it),
+            // this might even happen every x hours once the randomization triggers specific enough values, though all TAA modes have a pretty short cycle with fixed jitters,
+            // so it should either happen quickly or never.
+            bool middle_value_different = (device_data.prey_taa_active == device_data.previous_prey_taa_active[0]) != (device_data.prey_taa_active == device_data.previous_prey_taa_active[1]);
+            ASSERT_ONCE(!middle_value_different);
+         }
+         bool drew_dlss = cb_luma_frame_settings.DLSS; // If this was true, DLSS would have been enabled and probably drew
+         device_data.prey_taa_detected = device_data.prey_taa_active || device_data.previous_prey_taa_active[0]; // This one has a two frames tolerance. We let it persist even if the game stopped drawing the 3D scene.
+         cb_luma_frame_settings.DLSS = (device_data.dlss_sr && !device_data.dlss_sr_suppressed && device_data.prey_taa_detected) ? 1 : 0; // No need for "s_mutex_reshade" here, given that they are generally only also changed by the user manually changing the settings in ImGUI, which runs at the very end of the frame
+         device_data.cb_luma_frame_settings_dirty |= (bool)cb_luma_frame_settings.DLSS != drew_dlss;
+         if (cb_luma_frame_settings.DLSS && !drew_dlss)
+         {
+            // Reset DLSS history when we toggle DLSS on and off manually, or when the user in the game changes the AA mode,
+            // otherwise the history from the last time DLSS was active will be kept (DLSS doesn't know time passes since it was last used).
+            // We could also clear DLSS resources here when we know it's unused for a while, but it would possibly lead to stutters.
+            device_data.force_reset_dlss_sr = true;
+         }
+
+#if DEVELOPMENT
+         if (!custom_texture_mip_lod_bias_offset)
+#endif
+         {
+            const std::unique_lock lock_samplers(s_mutex_samplers);
+
+            if (device_data.dlss_sr && !device_data.dlss_sr_suppressed && device_data.prey_taa_detected && device_data.cloned_pipeline_count != 0)
+            {
+               // Quantize it, so that dynamic resolution scaling doesn't change it (and create new samplers) every frame
+               device_data.texture_mip_lod_bias_offset = custom_sampler_cache::quantize_lod_bias(std::log2(device_data.render_resolution.y / device_data.output_resolution.y) - 1.f); // This results in -1 at output res
+            }
+            else
+            {
+               // Reset to best fallback value.
+               // This bias offset replaces the value from the game (see "samplers_upgrade_mode" 5), which was based on the "r_AntialiasingTSAAMipBias" cvar for most textures (it doesn't apply to all the ones that would benefit from it, and still applies to ones that exhibit moire patterns),
+               // but only if TAA was engaged (not SMAA or SMAA+TAA) (it might persist on SMAA after once using TAA, due to a bug).
+               // Prey defaults that to 0 but Luma's configs set it to -1.
+               device_data.texture_mip_lod_bias_offset = device_data.prey_taa_detected ? -1.f : 0.f;
+            }
+
+            // Re-create all samplers immediately here (if the bias changed) instead of doing it at the end of the frame.
+            // This allows us to avoid possible (but very unlikely) hitches that could happen if we re-created a new sampler for a new resolution later on when samplers descriptors are set.
+            // It also allows us to use the right samplers for this frame's resolution.
+            // Samplers of biases that haven't been used in a while are released.
+            device_data.custom_samplers.set_lod_bias(device_data.texture_mip_lod_bias_offset, &CreateCustomSamplerFromOriginal);
+         }
+
+         if (!device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing))
+         {
+            device_data.previous_render_resolution = device_data.render_resolution;
+            previous_projection_jitters = projection_jitters;
+
+            // Set it to the latest value (ignoring the actual history)
+            device_data.previous_prey_taa_active[0] = device_data.prey_taa_active;
+            device_data.previous_prey_taa_active[1] = device_data.prey_taa_active;
+         }
+
+         // This only needs to be calculated once, before or after G-buffers are composed, but before late post processing (TM) starts, as it's for TAA (at the end of PP)
+         {
+            // NDC to UV space (y is flipped)
+            const Matrix44_tpl<double> mScaleBias1 = Matrix44_tpl<double>(
+               0.5, 0, 0, 0,
+               0, -0.5, 0, 0,
+               0, 0, 1, 0,
+               0.5, 0.5, 0, 1);
+            // UV to NDC space (y is flipped)
+            const Matrix44_tpl<double> mScaleBias2 = Matrix44_tpl<double>(
+               2.0, 0, 0, 0,
+               0, -2.0, 0, 0,
+               0, 0, 1, 0,
+               -1.0, 1.0, 0, 1);
+
+#if 0 // Not needed anymore, but here in case
+            const Matrix44A mViewProjPrev = Matrix44_tpl<double>(cb_per_view_global_actual_previous.CV_ViewMatr.GetTransposed()) * projection_matrix_native * Matrix44_tpl<double>(mScaleBias1);
+#endif
+            // We calculate all in double for extra precision (this stuff is delicate)
+            Matrix44_tpl<double> projection_matrix_native = current_projection_matrix.GetTransposed();
+            Matrix44_tpl<double> previous_projection_matrix_native = Matrix44_tpl<double>(previous_projection_matrix.GetTransposed());
+            Matrix44_tpl<double> mViewInv;
+            mathMatrixLookAtInverse(mViewInv, Matrix44_tpl<double>(cb_per_view_global.CV_ViewMatr.GetTransposed()));
+            Matrix44_tpl<double> mProjInv;
+            mathMatrixPerspectiveFovInverse(mProjInv, projection_matrix_native);
+            Matrix44_tpl<double> mReprojection64 = mProjInv * mViewInv * Matrix44_tpl<double>(cb_per_view_global_actual_previous.CV_ViewMatr.GetTransposed()) * previous_projection_matrix_native;
+            // These work (NDC adjustments) (anything else doesn't work, I've tried).
+            mReprojection64 = mScaleBias2 * mReprojection64 * mScaleBias1;
+            reprojection_matrix = mReprojection64.GetTransposed(); // Transpose it here so it's easier to read on the GPU (and consistent with the other matrices)
+         }
+
+         device_data.found_per_view_globals = true;
+      }
+
+      return true;
+   }
+}
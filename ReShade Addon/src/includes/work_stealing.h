@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Runs a batch of independent jobs (identified by their index) on the calling thread and up to "helpers_num" helpers, with work stealing.
+// Each worker gets its own deque, filled with a contiguous range of the jobs, it pops jobs from the front of its own one, and when that's empty, it steals from the back of the others,
+// so the workers that got quick jobs (e.g. shaders that didn't change) end up taking over the ones left behind workers stuck on long compilations.
+// Helpers are started through "spawn_helper" (e.g. as jobs of a "job_system"), the calling thread doesn't wait for them to start, only for the jobs they claimed to finish,
+// so this can be called from within a job of the same pool the helpers go to, even if it has no free workers (the calling thread will run all the jobs).
+// Helpers that start after all the jobs were claimed return immediately, without touching the jobs.
+// Jobs are run in no specific order, they are expected to only write to their own data, so that results don't depend on it.
+// Once "should_stop" returns true, the remaining jobs are skipped (but still count as claimed).
+class work_stealing_jobs
+{
+public:
+   struct results
+   {
+      size_t run_jobs = 0;
+      size_t stolen_jobs = 0; // Jobs that were run by another worker than the one they were assigned to
+   };
+
+   // "spawn_helper" receives a "std::function<void()>" that the helper needs to call (once), from any thread
+   template<typename SpawnHelper>
+   static results run(size_t jobs_num, size_t helpers_num, std::function<void(size_t job_index)> run_job, std::function<bool()> should_stop, SpawnHelper&& spawn_helper)
+   {
+      if (jobs_num == 0) return {};
+      if (helpers_num > jobs_num - 1) helpers_num = jobs_num - 1;
+
+      const auto shared_state = std::make_shared<state>(helpers_num + 1, jobs_num);
+      shared_state->run_job = std::move(run_job);
+      shared_state->should_stop = std::move(should_stop);
+      const size_t workers_num = helpers_num + 1;
+      for (size_t worker_index = 0; worker_index < workers_num; worker_index++)
+      {
+         const size_t first_job_index = jobs_num * worker_index / workers_num;
+         const size_t last_job_index = jobs_num * (worker_index + 1) / workers_num;
+         for (size_t job_index = first_job_index; job_index < last_job_index; job_index++)
+         {
+            shared_state->queues[worker_index].jobs.push_back(job_index);
+         }
+      }
+
+      for (size_t i = 0; i < helpers_num; i++)
+      {
+         spawn_helper(std::function<void()>([shared_state]()
+            {
+               shared_state->work(shared_state->next_helper_index.fetch_add(1, std::memory_order_relaxed));
+            }));
+      }
+      shared_state->work(0);
+
+      std::unique_lock lock(shared_state->done_mutex);
+      shared_state->done_condition.wait(lock, [&]() { return shared_state->remaining_jobs.load(std::memory_order_acquire) == 0; });
+      return { shared_state->run_jobs.load(), shared_state->stolen_jobs.load() };
+   }
+
+private:
+   struct alignas(64) queue
+   {
+      std::mutex mutex;
+      std::deque<size_t> jobs;
+   };
+
+   struct state
+   {
+      state(size_t workers_num, size_t jobs_num) : queues(workers_num), remaining_jobs(jobs_num) {}
+
+      // The functions are only called after claiming a job, which can't happen anymore once "run()" returned, so they can reference its caller data
+      std::function<void(size_t)> run_job;
+      std::function<bool()> should_stop;
+      std::vector<queue> queues;
+      std::atomic<size_t> next_helper_index = 1; // The calling thread is worker 0
+      std::atomic<size_t> remaining_jobs;
+      std::atomic<size_t> run_jobs = 0;
+      std::atomic<size_t> stolen_jobs = 0;
+      std::mutex done_mutex;
+      std::condition_variable done_condition;
+
+      bool pop(size_t worker_index, size_t& job_index)
+      {
+         auto& own_queue = queues[worker_index];
+         const std::lock_guard lock(own_queue.mutex);
+         if (own_queue.jobs.empty()) return false;
+         job_index = own_queue.jobs.front();
+         own_queue.jobs.pop_front();
+         return true;
+      }
+
+      // Takes the last job of the next worker that still has any (the last ones are the furthest away from what its owner is working on)
+      bool steal(size_t worker_index, size_t& job_index)
+      {
+         for (size_t i = 1; i < queues.size(); i++)
+         {
+            auto& victim_queue = queues[(worker_index + i) % queues.size()];
+            const std::lock_guard lock(victim_queue.mutex);
+            if (victim_queue.jobs.empty()) continue;
+            job_index = victim_queue.jobs.back();
+            victim_queue.jobs.pop_back();
+            return true;
+         }
+         return false;
+      }
+
+      void work(size_t worker_index)
+      {
+         worker_index %= queues.size();
+         size_t job_index;
+         while (true)
+         {
+            bool stolen = false;
+            if (!pop(worker_index, job_index))
+            {
+               if (!steal(worker_index, job_index)) break;
+               stolen = true;
+            }
+            if (!should_stop())
+            {
+               run_job(job_index);
+               run_jobs.fetch_add(1, std::memory_order_relaxed);
+               if (stolen) stolen_jobs.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (remaining_jobs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+               // Lock to make sure the caller is either not checking the condition yet, or already waiting
+               const std::lock_guard lock(done_mutex);
+               done_condition.notify_all();
+            }
+         }
+      }
+   };
+};
@@ -41,6 +41,7 @@
 #include <set>
 #include <vector>
 #include <semaphore>
+#include <thread>
 #include <utility>
 
 // ReShade dependencies
@@ -57,11 +58,35 @@
 #include "includes/math.h"
 #include "includes/matrix.h"
 #include "includes/recursive_shared_mutex.h"
+#include "includes/rcu_snapshot.h"
+#include "includes/custom_sampler_cache.h"
+#include "includes/frame_passes.h"
+#include "includes/shader_roles.h"
+#include "includes/shader_hash_buckets.h"
+#include "includes/resource_view_cache.h"
+#include "includes/draw_state_stack.h"
+#include "includes/handle_set.h"
+#include "includes/sharded_handle_map.h"
+#include "includes/job_system.h"
+#include "includes/work_stealing.h"
+#include "includes/shader_permutations.h"
+#include "includes/transient_texture_pool.h"
+#include "includes/gpu_readback_ring.h"
+#include "includes/trace_ring.h"
+#include "includes/gpu_pass_profiler.h"
+#include "includes/hook_profiler.h"
+#include "includes/frame_capture.h"
+#include "includes/mock_render_backend.h"
 
 #include "utils/format.hpp"
 #include "utils/pipeline.hpp"
 #include "utils/shader_compiler.hpp"
 #include "utils/display.hpp"
+#include "utils/hash.hpp"
+#include "utils/cbuffer.hpp"
+#include "utils/shader_cache.hpp"
+#include "utils/shader_dependencies.hpp"
+#include "utils/directory_watcher.hpp"
 
 #include "native plugin/NativePlugin.h"
 
@@ -89,6 +114,8 @@
 
 // This might not disable all shaders dumping related code, but it disables enough to remove any performance cost
 #define ALLOW_SHADERS_DUMPING (DEVELOPMENT || TEST)
+// Measures the CPU time spent in our most frequent hooks (e.g. draw calls), to find our overhead on the game threads. It has a small performance cost on its own.
+#define ENABLE_HOOKS_PROFILING (DEVELOPMENT || TEST)
 
 // NOLINTBEGIN(readability-identifier-naming)
 
@@ -114,6 +141,10 @@ if (!asserted_once && !(x)) { assert(x); asserted_once = true; } }
 #define ASSERT_ONCE(x)
 #endif
 
+// These depend on "ASSERT_ONCE()"
+#include "includes/sampler_upgrade.h"
+#include "includes/view_data.h"
+
 // Make sure we can use com_ptr as c arrays of pointers
 static_assert(sizeof(com_ptr<ID3D11Resource>) == sizeof(void*));
 
@@ -190,13 +221,16 @@ namespace
       // Cloned subojects from the orignal pipeline
       reshade::api::pipeline_subobject* subobjects_cache;
       uint32_t subobject_count;
-      bool cloned = false;
-      reshade::api::pipeline pipeline_clone;
+      // These two are read by lock free readers (see "FindCachedPipeline()"), while shaders (re)loading can change them (under "s_mutex_generic"). The clone is published through "cloned".
+      std::atomic<bool> cloned = false;
+      std::atomic<reshade::api::pipeline> pipeline_clone = reshade::api::pipeline{ 0 };
       // Original shaders hash (there should only be one)
       std::vector<uint32_t> shader_hashes;
+      // Mask of "ShaderRoleMask" flags, computed once on creation from the original shader hashes, so draw calls can find what pass they are in without doing any hash lookup
+      uint32_t roles = 0;
 #if DEVELOPMENT
-      // If true, this pipeline is currently being "tested"
-      bool test = false;
+      // If true, this pipeline is currently being "tested" (read by lock free readers too)
+      std::atomic<bool> test = false;
 #endif
 
       bool HasGeometryShader() const
@@ -431,7 +465,7 @@ namespace
    }
 
    // Mutexes:
-   // For "pipeline_cache_by_pipeline_handle", "pipeline_cache_by_pipeline_clone_handle", "pipeline_caches_by_shader_hash", "pipelines_to_destroy", "cloned_pipeline_count"
+   // For "pipeline_cache_by_pipeline_handle", "pipeline_cache_by_pipeline_clone_handle", "pipeline_caches_by_shader_hash", "cloned_pipeline_count"
    recursive_shared_mutex s_mutex_generic;
    // For "shaders_to_dump", "dumped_shaders", "shader_cache". In general for dumping shaders to disk
    std::recursive_mutex s_mutex_dumping;
@@ -441,15 +475,14 @@ namespace
    std::shared_mutex s_mutex_shader_objects;
    // Mutex for shader defines ("shader_defines_data", "code_shaders_defines", "shader_defines_data_index")
    std::shared_mutex s_mutex_shader_defines;
-   // Mutex to deal with data shader with ReShade, like ini/config saving and loading (including "cb_luma_frame_settings" and "cb_luma_frame_settings_dirty")
-   std::shared_mutex s_mutex_reshade;
-   // For "custom_sampler_by_original_sampler" and "texture_mip_lod_bias_offset"
-   std::shared_mutex s_mutex_samplers;
+   // "s_mutex_reshade" and "s_mutex_samplers" are in "includes/view_data.h"
    // For "global_native_devices", "global_device_datas", "game_window"
    recursive_shared_mutex s_mutex_device;
 #if DEVELOPMENT
-   // for "trace_count" and "trace_scheduled" and "trace_running"
+   // for "trace_count" and "trace_scheduled" (and for changing "trace_running")
    std::shared_mutex s_mutex_trace;
+   // For the "capture_replay_*" results (written by the capture replay job, read by ImGUI)
+   std::mutex s_mutex_capture_replay;
 #endif
 
    // Dev or User settings:
@@ -470,15 +503,13 @@ namespace
    bool hdr_supported_display = false;
    constexpr bool prevent_shader_cache_loading = false;
    bool prevent_shader_cache_saving = false;
+   // Version of the "d3dcompiler_47.dll" shaders are compiled with (see "utils::shader::compiler::GetLibraryFileVersion()"), it's part of the compiled shaders pack keys
+   uint64_t shader_compiler_version = 0;
    constexpr bool force_motion_vectors_jittered = true;
 #if DEVELOPMENT
    //TODOFT3: clean up the following vars
-   int samplers_upgrade_mode = 5;
-   int samplers_upgrade_mode_2 = 0;
-   bool custom_texture_mip_lod_bias_offset = false; // Live edit
    float dlss_custom_exposure = 0.f; // Ignored at 0
    float dlss_custom_pre_exposure = 0.f; // Ignored at 0
-   bool disable_taa_jitters = false;
    int force_taa_jitter_phases = 0; // Ignored if 0 (automatic mode), set to 1 to basically disable jitters
    int frame_sleep_ms = 0;
    int frame_sleep_interval = 1;
@@ -489,9 +520,6 @@ namespace
    RE::ETEX_Format HDR_textures_upgrade_requested_format = RE::ETEX_Format::eTF_R16G16B16A16F;
 
    // Game specific constants:
-   constexpr uint32_t luma_settings_cbuffer_index = 2; // 2 is unused by Prey
-   constexpr uint32_t luma_data_cbuffer_index = 8; // 8 is unused by Prey
-   constexpr uint32_t luma_ui_cbuffer_index = 7; // 7 is almost 100% unused by Prey
    ShaderHashesList shader_hashes_TiledShadingTiledDeferredShading;
    uint32_t shader_hash_DeferredShadingSSRRaytrace;
    uint32_t shader_hash_DeferredShadingSSReflectionComp;
@@ -514,6 +542,77 @@ namespace
    const uint32_t shader_hash_draw_exposure = std::stoul("FFFFFFF3", nullptr, 16);
    const uint32_t shader_hash_lens_distortion_pixel = std::stoul("FFFFFFF5", nullptr, 16);
 
+   // The roles of all the game shaders hashes above (and lists of), built on init (see "BuildShaderRolesTable()")
+   shader_roles_table shader_roles_by_hash;
+
+   // Expects the shader roles table to have been built already (it is, before any pipeline is ever created)
+   uint32_t GetShaderRoles(uint32_t shader_hash, reshade::api::pipeline_subobject_type shader_type)
+   {
+      reshade::api::shader_stage shader_stage;
+      switch (shader_type)
+      {
+      case reshade::api::pipeline_subobject_type::vertex_shader: shader_stage = reshade::api::shader_stage::vertex; break;
+#if GEOMETRY_SHADER_SUPPORT
+      case reshade::api::pipeline_subobject_type::geometry_shader: shader_stage = reshade::api::shader_stage::geometry; break;
+#endif // GEOMETRY_SHADER_SUPPORT
+      case reshade::api::pipeline_subobject_type::pixel_shader: shader_stage = reshade::api::shader_stage::pixel; break;
+      case reshade::api::pipeline_subobject_type::compute_shader: shader_stage = reshade::api::shader_stage::compute; break;
+      default: return (uint32_t)ShaderRoleMask::None;
+      }
+      ASSERT_ONCE(shader_roles_by_hash.is_built());
+      return shader_roles_by_hash.get((uint32_t)shader_stage, shader_hash);
+   }
+
+   void AddShaderRoles(const ShaderHashesList& shader_hashes, ShaderRoleMask role)
+   {
+      shader_roles_by_hash.add_all((uint32_t)reshade::api::shader_stage::pixel, shader_hashes.pixel_shaders, role);
+      shader_roles_by_hash.add_all((uint32_t)reshade::api::shader_stage::vertex, shader_hashes.vertex_shaders, role);
+#if GEOMETRY_SHADER_SUPPORT
+      shader_roles_by_hash.add_all((uint32_t)reshade::api::shader_stage::geometry, shader_hashes.geometry_shaders, role);
+#endif // GEOMETRY_SHADER_SUPPORT
+      shader_roles_by_hash.add_all((uint32_t)reshade::api::shader_stage::compute, shader_hashes.compute_shaders, role);
+   }
+
+   // Expects the shader hashes (and lists of) to have been initialized already
+   void BuildShaderRolesTable()
+   {
+      shader_roles_by_hash = {};
+      AddShaderRoles(shader_hashes_TiledShadingTiledDeferredShading, ShaderRoleMask::TiledShadingTiledDeferredShading);
+      shader_roles_by_hash.add((uint32_t)reshade::api::shader_stage::pixel, shader_hash_DeferredShadingSSRRaytrace, ShaderRoleMask::DeferredShadingSSRRaytrace);
+      shader_roles_by_hash.add((uint32_t)reshade::api::shader_stage::pixel, shader_hash_PostEffectsGaussBlurBilinear, ShaderRoleMask::SSRBlur);
+      shader_roles_by_hash.add((uint32_t)reshade::api::shader_stage::pixel, shader_hash_PostEffectsTextureToTextureResampled, ShaderRoleMask::SSRBlur);
+      shader_roles_by_hash.add((uint32_t)reshade::api::shader_stage::pixel, shader_hash_DeferredShadingSSReflectionComp, ShaderRoleMask::DeferredShadingSSReflectionComp);
+      shader_roles_by_hash.add((uint32_t)reshade::api::shader_stage::pixel, shader_hash_PostAAUpscaleImage, ShaderRoleMask::PostAAUpscaleImage);
+      AddShaderRoles(shader_hashes_HDRPostProcessHDRFinalScene, ShaderRoleMask::HDRPostProcessHDRFinalScene);
+      AddShaderRoles(shader_hashes_HDRPostProcessHDRFinalScene_Sunshafts, ShaderRoleMask::HDRPostProcessHDRFinalScene_Sunshafts);
+      AddShaderRoles(shader_hashes_MotionBlur, ShaderRoleMask::MotionBlur);
+      AddShaderRoles(shader_hashes_DirOccPass, ShaderRoleMask::DirOccPass);
+      AddShaderRoles(shader_hashes_SSDO_Blur, ShaderRoleMask::SSDO_Blur);
+      AddShaderRoles(shader_hashes_PostAAComposites, ShaderRoleMask::PostAAComposites);
+      AddShaderRoles(shader_hashes_SMAA_EdgeDetection, ShaderRoleMask::SMAA_EdgeDetection);
+      AddShaderRoles(shader_hashes_PostAA, ShaderRoleMask::PostAA);
+      AddShaderRoles(shader_hashes_PostAA_TAA, ShaderRoleMask::PostAA_TAA);
+      shader_roles_by_hash.build();
+   }
+
+   // Returns the game pass that a draw (or dispatch) with the given shaders roles belongs to, given the passes that have already drawn in the frame ("FramePass::Count" if none).
+   // Only depends on the shaders and the frame progress (not on any device state), so it can also be run on frame capture replays. Our own passes (e.g. DLSS SR) aren't detected here.
+   FramePass GetDrawnFramePass(uint32_t shader_roles, const frame_pass_tracker& frame_passes)
+   {
+      const auto HasRole = [shader_roles](ShaderRoleMask role) { return (shader_roles & (uint32_t)role) != 0; };
+      if (!frame_passes.has_drawn(FramePass::ComposedGBuffers) && HasRole(ShaderRoleMask::TiledShadingTiledDeferredShading)) return FramePass::ComposedGBuffers;
+      if (!frame_passes.has_drawn(FramePass::ComposedGBuffers) && !frame_passes.has_drawn(FramePass::SSR) && HasRole(ShaderRoleMask::DeferredShadingSSRRaytrace)) return FramePass::SSR;
+      if (frame_passes.has_drawn(FramePass::SSR) && !frame_passes.has_drawn(FramePass::SSRBlend) && HasRole(ShaderRoleMask::DeferredShadingSSReflectionComp)) return FramePass::SSRBlend;
+      if (frame_passes.has_drawn(FramePass::ComposedGBuffers) && !frame_passes.has_drawn(FramePass::Tonemapping) && HasRole(ShaderRoleMask::HDRPostProcessHDRFinalScene)) return FramePass::Tonemapping;
+      // Note: this doesn't always run, it's based on a user setting!
+      if (frame_passes.has_drawn(FramePass::ComposedGBuffers) && !frame_passes.has_drawn(FramePass::MotionBlur) && HasRole(ShaderRoleMask::MotionBlur)) return FramePass::MotionBlur;
+      if (!frame_passes.has_drawn(FramePass::ComposedGBuffers) && !frame_passes.has_drawn(FramePass::SSAO) && HasRole(ShaderRoleMask::DirOccPass)) return FramePass::SSAO;
+      if (frame_passes.has_drawn(FramePass::SSAO) && !frame_passes.has_drawn(FramePass::SSAODenoise) && HasRole(ShaderRoleMask::SSDO_Blur)) return FramePass::SSAODenoise;
+      if (frame_passes.has_drawn(FramePass::ComposedGBuffers) && !frame_passes.has_drawn(FramePass::MainPostProcessing) && HasRole(ShaderRoleMask::PostAAComposites)) return FramePass::MainPostProcessing;
+      if (frame_passes.has_drawn(FramePass::ComposedGBuffers) && !frame_passes.has_drawn(FramePass::Upscaling) && HasRole(ShaderRoleMask::PostAAUpscaleImage)) return FramePass::Upscaling;
+      return FramePass::Count;
+   }
+
    struct TraceDrawCallData
    {
 #if 1 // For now add a new "TraceDrawCallData" per shader (e.g. one for vertex and one for pixel, instead of doing it per draw call), this is due to legacy code that would require too much refactor
@@ -523,7 +622,8 @@ namespace
       ShaderHashesList shader_hashes;
 #endif
 
-      com_ptr<ID3D11DeviceContext> command_list;
+      ID3D11DeviceContext* command_list = nullptr; // Not referenced, it might not be alive anymore
+      bool is_deferred = false;
       std::thread::id thread_id;
 
       // Render Target
@@ -538,19 +638,101 @@ namespace
       DXGI_FORMAT uav_format[D3D11_1_UAV_SLOT_COUNT] = {}; // TODO: add support for pixel shader RT UAVs
    };
 
-   struct __declspec(uuid("cfebf6d4-d184-4e1a-ac14-09d088e560ca")) DeviceData
+   // Compact binary version of "TraceDrawCallData", that is written in the command lists trace rings while a frame is being traced, and only expanded when merged in the final trace.
+   // Formats are stored in 8 bits (all the DXGI formats that can be used by views fit), and the blend description in 32 bits per render target.
+   struct TraceDrawCallRecord
+   {
+      uint64_t pipeline_handle;
+      ID3D11DeviceContext* command_list;
+      std::thread::id thread_id;
+      uint32_t trace_index; // Records from previous traces (e.g. from deferred command lists that were never executed within their trace) are discarded
+      uint8_t flags; // See "TraceDrawCallRecordFlags"
+      uint8_t rt_is_swapchain_mask;
+      uint32_t blend_render_targets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+      uint8_t rtv_format[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+      uint8_t rt_format[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+      uint16_t rt_size[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT][2];
+      uint8_t srv_format[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+      uint8_t uav_format[D3D11_1_UAV_SLOT_COUNT];
+   };
+
+   enum TraceDrawCallRecordFlags : uint8_t
+   {
+      TraceDrawCallRecord_Deferred = 1 << 0,
+      TraceDrawCallRecord_AlphaToCoverageEnable = 1 << 1,
+      TraceDrawCallRecord_IndependentBlendEnable = 1 << 2,
+   };
+
+   // Packs a render target blend description in 31 bits
+   uint32_t PackRenderTargetBlendDesc(const D3D11_RENDER_TARGET_BLEND_DESC& desc)
+   {
+      return uint32_t(desc.BlendEnable ? 1 : 0)
+         | (uint32_t(desc.SrcBlend) << 1) // 5 bits
+         | (uint32_t(desc.DestBlend) << 6) // 5 bits
+         | (uint32_t(desc.BlendOp) << 11) // 3 bits
+         | (uint32_t(desc.SrcBlendAlpha) << 14) // 5 bits
+         | (uint32_t(desc.DestBlendAlpha) << 19) // 5 bits
+         | (uint32_t(desc.BlendOpAlpha) << 24) // 3 bits
+         | (uint32_t(desc.RenderTargetWriteMask & 0xF) << 27); // 4 bits
+   }
+
+   D3D11_RENDER_TARGET_BLEND_DESC UnpackRenderTargetBlendDesc(uint32_t packed_desc)
+   {
+      D3D11_RENDER_TARGET_BLEND_DESC desc;
+      desc.BlendEnable = (packed_desc & 1) != 0;
+      desc.SrcBlend = D3D11_BLEND((packed_desc >> 1) & 0x1F);
+      desc.DestBlend = D3D11_BLEND((packed_desc >> 6) & 0x1F);
+      desc.BlendOp = D3D11_BLEND_OP((packed_desc >> 11) & 0x7);
+      desc.SrcBlendAlpha = D3D11_BLEND((packed_desc >> 14) & 0x1F);
+      desc.DestBlendAlpha = D3D11_BLEND((packed_desc >> 19) & 0x1F);
+      desc.BlendOpAlpha = D3D11_BLEND_OP((packed_desc >> 24) & 0x7);
+      desc.RenderTargetWriteMask = UINT8((packed_desc >> 27) & 0xF);
+      return desc;
+   }
+
+   TraceDrawCallData UnpackTraceDrawCallRecord(const TraceDrawCallRecord& record)
+   {
+      TraceDrawCallData trace_draw_call_data;
+      trace_draw_call_data.pipeline_handle = record.pipeline_handle;
+      trace_draw_call_data.command_list = record.command_list;
+      trace_draw_call_data.is_deferred = (record.flags & TraceDrawCallRecord_Deferred) != 0;
+      trace_draw_call_data.thread_id = record.thread_id;
+      trace_draw_call_data.blend_desc.AlphaToCoverageEnable = (record.flags & TraceDrawCallRecord_AlphaToCoverageEnable) != 0;
+      trace_draw_call_data.blend_desc.IndependentBlendEnable = (record.flags & TraceDrawCallRecord_IndependentBlendEnable) != 0;
+      for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+      {
+         trace_draw_call_data.blend_desc.RenderTarget[i] = UnpackRenderTargetBlendDesc(record.blend_render_targets[i]);
+         trace_draw_call_data.rtv_format[i] = DXGI_FORMAT(record.rtv_format[i]);
+         trace_draw_call_data.rt_format[i] = DXGI_FORMAT(record.rt_format[i]);
+         trace_draw_call_data.rt_size[i] = uint2{ record.rt_size[i][0], record.rt_size[i][1] };
+         trace_draw_call_data.rt_is_swapchain[i] = (record.rt_is_swapchain_mask & (1 << i)) != 0;
+      }
+      for (UINT i = 0; i < D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT; i++)
+      {
+         trace_draw_call_data.srv_format[i] = DXGI_FORMAT(record.srv_format[i]);
+      }
+      for (UINT i = 0; i < D3D11_1_UAV_SLOT_COUNT; i++)
+      {
+         trace_draw_call_data.uav_format[i] = DXGI_FORMAT(record.uav_format[i]);
+      }
+      return trace_draw_call_data;
+   }
+
+   // The view data (resolutions, TAA, DRS, our cbuffers...) and the custom samplers are in "DeviceViewData"
+   struct __declspec(uuid("cfebf6d4-d184-4e1a-ac14-09d088e560ca")) DeviceData : DeviceViewData
    {
       // Only for "swapchains", "back_buffers"
       std::shared_mutex mutex;
 
-      std::thread thread_auto_loading;
+      job_system::job_handle auto_loading_job;
       std::atomic<bool> thread_auto_loading_running = false;
 
 #if DEVELOPMENT
       // TODO: clean up this unused stuff?
-      std::unordered_map<uint64_t, uint64_t> resource_views; // <resource.handle, resource_view.handle>
+      // These are written to by the game streaming threads all the time, so they have their own (sharded) locks, instead of using "mutex"
+      sharded_handle_map<> resource_views; // <resource_view.handle, resource.handle>
       std::unordered_map<uint64_t, std::string> resource_names;
-      std::unordered_set<uint64_t> resources;
+      sharded_handle_map<> resources; // Values are unused
 #endif
 
       std::unordered_set<reshade::api::swapchain*> swapchains;
@@ -575,23 +757,30 @@ namespace
       // Same as "pipeline_cache_by_pipeline_handle" but for cloned (custom) pipelines.
       std::unordered_map<uint64_t, CachedPipeline*> pipeline_cache_by_pipeline_clone_handle;
       // All the pipelines linked to a shader. By shader hash.
-      std::unordered_map<uint32_t, std::unordered_set<CachedPipeline*>> pipeline_caches_by_shader_hash;
+      shader_hash_buckets<CachedPipeline> pipeline_caches_by_shader_hash;
+      // Read only copy of "pipeline_cache_by_pipeline_handle" that can be accessed without locking "s_mutex_generic" (see "FindCachedPipeline()").
+      // It's re-published at most once per frame, and only while "pipeline_cache_snapshot_dirty" is false it's guaranteed to be up to date.
+      // Destroyed "CachedPipeline", cloned pipelines and old snapshots are retired in "rcu" (see "DeviceViewData"), as lock free readers might still be using them.
+      rcu_snapshot<std::unordered_map<uint64_t, CachedPipeline*>> pipeline_cache_by_pipeline_handle_snapshot;
+      std::atomic<bool> pipeline_cache_snapshot_dirty = true;
 
-      std::unordered_set<uint64_t> pipelines_to_reload;
-      static_assert(sizeof(reshade::api::pipeline::handle) == sizeof(uint64_t));
-      // Map of "reshade::api::pipeline::handle"
-      std::unordered_map<uint64_t, reshade::api::device*> pipelines_to_destroy;
+      // Views of game resources (and of the back buffers) we draw custom passes with, they are re-used across frames
+      resource_view_cache custom_views_cache;
 
-      // Custom samplers mapped to original ones by texture LOD bias
-      std::unordered_map<uint64_t, std::unordered_map<float, com_ptr<ID3D11SamplerState>>> custom_sampler_by_original_sampler;
+      std::unordered_set<uint64_t> pipelines_to_reload;
+      // Shaders (by hash) whose files changed on disk, "AutoLoadShaders()" recompiles them (custom device shaders included) and reloads all the pipelines that use them
+      std::unordered_set<uint32_t> shaders_to_recompile;
 
-      bool dlss_sr = true; // If true DLSS is enabled by the user and supported+initialized correctly on this device
 #if ENABLE_NGX
       NGX::DLSSInstanceData* dlss_sr_handle = nullptr;
 #endif // ENABLE_NGX
 
       // Resources:
 
+      // Textures of our custom passes that depend on the rendering resolution (and thus might need to be re-created at any time) go through this,
+      // to re-use them when possible and to defer their destruction.
+      transient_texture_pool transient_textures;
+
 #if ENABLE_NGX
       // DLSS SR
       com_ptr<ID3D11Texture2D> dlss_output_color;
@@ -614,9 +803,9 @@ namespace
 
       // Exposure
       com_ptr<ID3D11Buffer> exposure_buffer_gpu; // DLSS (doesn't need "ENABLE_NGX)
-      com_ptr<ID3D11Buffer> exposure_buffers_cpu[2]; // DLSS (doesn't need "ENABLE_NGX)
+      gpu_readback_ring<4> exposure_buffers_cpu; // DLSS (doesn't need "ENABLE_NGX)
       com_ptr<ID3D11RenderTargetView> exposure_buffer_rtv; // DLSS (doesn't need "ENABLE_NGX)
-      size_t exposure_buffers_cpu_index = 0;
+      uint32_t exposure_readback_latency = 0; // In frames, how old the last exposure we read back from the GPU was
 
       // GTAO
       com_ptr<ID3D11Texture2D> gtao_edges_texture;
@@ -627,7 +816,7 @@ namespace
 
       void CleanGTAOResource()
       {
-         gtao_edges_texture = nullptr;
+         transient_textures.release(gtao_edges_texture);
          gtao_edges_texture_width = 0;
          gtao_edges_texture_height = 0;
          gtao_edges_rtv = nullptr;
@@ -647,7 +836,7 @@ namespace
       {
          ssr_texture = nullptr;
          ssr_srv = nullptr;
-         ssr_diffuse_texture = nullptr;
+         transient_textures.release(ssr_diffuse_texture);
          ssr_diffuse_texture_width = 0;
          ssr_diffuse_texture_height = 0;
          ssr_diffuse_rtv = nullptr;
@@ -670,7 +859,7 @@ namespace
       void CleanLensDistortionResource()
       {
          // "lens_distortion_sampler_state" is peristent (not much point in clearing it)
-         lens_distortion_texture = nullptr;
+         transient_textures.release(lens_distortion_texture);
          lens_distortion_srv = nullptr;
          lens_distortion_rtvs_resources[0] = nullptr;
          lens_distortion_rtvs_resources[1] = nullptr;
@@ -685,19 +874,16 @@ namespace
          lens_distortion_texture_format = DXGI_FORMAT_UNKNOWN;
       }
 
-      // CBuffers
-      com_ptr<ID3D11Buffer> luma_frame_settings;
-      com_ptr<ID3D11Buffer> luma_frame_data;
-      com_ptr<ID3D11Buffer> luma_ui_data;
-      LumaFrameData cb_luma_frame_data = {};
-      LumaUIData cb_luma_ui_data = {};
-      bool cb_luma_frame_settings_dirty = true;
-
       // Misc
       com_ptr<ID3D11BlendState> default_blend_state;
 
       // Pointer to the current DX buffer for the "global per view" cbuffer.
       com_ptr<ID3D11Buffer> cb_per_view_global_buffer;
+      // All the live buffers that could be the "global per view" cbuffer (by size), so we can skip all the other ones on map without querying their description
+      handle_set<> cb_per_view_global_buffer_candidates;
+      // Buffers created before the addon was registered (e.g. if it was loaded late) never went through "OnInitResource()", so until the global cbuffer has been found for this many frames,
+      // buffers that aren't in the candidates set are checked by description too (and added to it if they match).
+      std::atomic<uint32_t> cb_per_view_global_buffer_candidates_seeding_frames = 120;
 #if DEVELOPMENT
       std::set<ID3D11Buffer*> cb_per_view_global_buffers;
 #endif
@@ -707,48 +893,19 @@ namespace
       DXGI_FORMAT debug_draw_texture_format = DXGI_FORMAT_UNKNOWN; // The view format, not the Texture2D format
 #endif
 
-      std::atomic<bool> has_drawn_composed_gbuffers = false;
-      std::atomic<bool> has_drawn_main_post_processing = false;
-      // Useful to know if rendering was skipped in the previous frame (e.g. in case we were in a UI view)
-      bool has_drawn_main_post_processing_previous = false;
-      std::atomic<bool> has_drawn_upscaling = false;
-      std::atomic<bool> has_drawn_dlss_sr = false;
-      std::atomic<bool> has_drawn_motion_blur = false;
-      bool has_drawn_motion_blur_previous = false;
-      std::atomic<bool> has_drawn_tonemapping = false;
-      std::atomic<bool> has_drawn_ssr = false;
+#if DEVELOPMENT
+      // GPU timings of the frame passes (only the immediate device context ones)
+      gpu_pass_profiler gpu_profiler;
+#endif
       std::atomic<ID3D11DeviceContext*> ssr_command_list = nullptr;
-      std::atomic<bool> has_drawn_ssr_blend = false;
-      std::atomic<bool> has_drawn_ssao = false;
-      std::atomic<bool> has_drawn_ssao_denoise = false;
-
-      std::atomic<bool> found_per_view_globals = false;
-      // Whether the rendering resolution was scaled in this frame (different from the ouput resolution)
-      std::atomic<bool> prey_drs_active = false;
-      std::atomic<bool> prey_drs_detected = false;
-      std::atomic<bool> prey_taa_active = false;
-      std::atomic<bool> prey_taa_detected = false;
-      std::atomic<bool> force_reset_dlss_sr = false;
-      std::atomic<float> dlss_render_resolution_scale = 1.f;
-      std::atomic<bool> dlss_sr_suppressed = false;
-      // Index 0 is one frame ago, index 1 is two frames ago
-      bool previous_prey_taa_active[2] = { false, false };
-
-      float2 render_resolution = { 1, 1 };
-      float2 previous_render_resolution = { 1, 1 };
-      float2 output_resolution = { 1, 1 };
 
       // Live settings (set by the code, not directly by users):
       float default_user_peak_white = default_peak_white;
       bool dlss_sr_supported = false;
-      float texture_mip_lod_bias_offset = 0.f;
       float dlss_scene_exposure = 1.f;
       float dlss_scene_pre_exposure = 1.f;
 
       std::atomic<bool> cloned_pipelines_changed = false; // Atomic so it doesn't rely on "s_mutex_generic"
-      uint32_t cloned_pipeline_count = 0; // How many pipelines (shaders/passes) we replaced with custom ones (if zero, we can assume the mod isn't doing much)
-
-      bool has_drawn_dlss_sr_imgui = false;
    };
 
    struct __declspec(uuid("c5805458-2c02-4ebf-b139-38b85118d971")) SwapchainData
@@ -766,8 +923,8 @@ namespace
       reshade::api::pipeline pipeline_state_original_pixel_shader = reshade::api::pipeline(0);
 
 #if DEVELOPMENT
-      std::shared_mutex mutex_trace;
-      std::vector<TraceDrawCallData> trace_draw_calls_data;
+      // The draw calls traced on this command list, and the ones of the command lists executed on it. The final trace ends up in the immediate command list.
+      command_list_trace<TraceDrawCallRecord, TraceDrawCallData> trace_draw_calls;
 #endif
    };
 
@@ -784,6 +941,24 @@ namespace
    std::unordered_set<uint32_t> dumped_shaders;
 
    std::string shaders_compilation_errors; // errors and warning log
+   // Increased every time all shaders are (re)compiled, any compilation that was started before that is cancelled, as its results would be replaced anyway
+   std::atomic<uint32_t> shaders_compilation_generation = 0;
+   // Max amount of threads to compile shaders on (including the one that requested the compilation)
+   constexpr uint32_t max_shaders_compilation_threads = 8;
+   // Persistent cache of all the shaders we compiled, by their preprocessed code and defines (so switching between defines permutations doesn't need to recompile them either)
+   utils::shader::cache::BytecodePack shaders_bytecode_pack;
+   const std::string shaders_bytecode_pack_file_name = "ShadersCache.pack";
+   constexpr size_t shaders_bytecode_pack_size_budget = 64 * 1024 * 1024; // Compacted when going beyond this
+   // Whether to precompile (in the background) the shaders with the defines the user is the most likely to switch to next, so that changing them is near instant
+   bool precompile_shader_permutations = true;
+   // The last sets of defines shaders have been (fully) compiled with, and the ones we precompiled ("s_mutex_loading")
+   shader_permutations shader_defines_permutations(4, 8);
+   std::atomic<bool> needs_precompile_shader_permutations = false;
+   // The files each custom shader depends on, to know which ones need to be pre-processed again after some files changed
+   utils::shader::dependencies::DependencyGraph shaders_dependency_graph;
+   const std::string shaders_dependency_graph_file_name = "ShadersDependencies.txt";
+   // Queues the custom shaders that changed on disk to be reloaded ("auto_load")
+   utils::files::DirectoryWatcher shaders_directory_watcher;
 
    // List of define values read by our settings shaders
    std::unordered_map<std::string, uint8_t> code_shaders_defines;
@@ -843,27 +1018,17 @@ namespace
    // uint8_t is enough for MAX_SHADER_DEFINES
    std::unordered_map<uint32_t, uint8_t> shader_defines_data_index;
 
-   // Global data (not device dependent really):
-
-   // Directly from cbuffer (so these are transposed)
-   Matrix44A projection_matrix;
-   Matrix44A nearest_projection_matrix; // For first person weapons (view model)
-   Matrix44A previous_projection_matrix;
-   Matrix44A previous_nearest_projection_matrix;
-   Matrix44A reprojection_matrix;
-   float2 previous_projection_jitters = { 0, 0 };
-   float2 projection_jitters = { 0, 0 };
-   uint32_t frame_index = 0; // No need for this to be by device
-   CBPerViewGlobal cb_per_view_global = { };
-   CBPerViewGlobal cb_per_view_global_previous = cb_per_view_global;
-   LumaFrameSettings cb_luma_frame_settings = { }; // Not in device data as this stores some users settings too // Set "cb_luma_frame_settings_dirty" when changing within a frame (so it's uploaded again)
-
    bool has_init = false;
    bool asi_loaded = true; // Whether we've been loaded from an ASI loader or ReShade Addons system
-   std::thread thread_auto_dumping;
+   // Runs all our background work (shaders compilation, loading and dumping), the "running" flags below are set before submitting their jobs, and cleared by the jobs themselves.
+   // Shaders compilations spread on up to "max_shaders_compilation_threads" of its workers, plus one for "shaders_directory_watcher" (it occupies a worker as long as it runs).
+   job_system background_jobs(max_shaders_compilation_threads + 1);
+   job_system::job_handle auto_dumping_job;
    std::atomic<bool> thread_auto_dumping_running = false;
-   std::thread thread_auto_compiling;
+   job_system::job_handle auto_compiling_job;
    std::atomic<bool> thread_auto_compiling_running = false;
+   job_system::job_handle precompiling_job;
+   std::atomic<bool> thread_precompiling_running = false;
    bool last_pressed_unload = false;
    bool needs_unload_shaders = false;
    bool needs_load_shaders = false; // Load/compile or reload/recompile shaders, no need to default it to true, we have "auto_load" for that
@@ -877,8 +1042,22 @@ namespace
 
 #if DEVELOPMENT
    bool trace_scheduled = false; // For next frame
-   bool trace_running = false; // For this frame
+   std::atomic<bool> trace_running = false; // For this frame. Atomic so that draw calls can check it without locking "s_mutex_trace"
+   std::atomic<uint32_t> trace_index = 0; // Increased every time a new trace starts
    uint32_t trace_count = 0; // Not exactly necessary but... it might help
+   std::atomic<bool> gpu_profiler_enabled = false; // Atomic so that draw calls can check it without locking
+   bool capture_scheduled = false; // For next frame
+   frame_capture_writer frame_capture; // Captures the events of a whole frame, from present to present
+   std::filesystem::path last_capture_path;
+   job_system::job_handle capture_replay_job;
+   std::atomic<bool> capture_replay_running = false;
+   mock_render_backend::benchmark_results capture_replay_results;
+   mock_render_backend::statistics capture_replay_statistics;
+   uint64_t capture_replay_role_draws = 0; // Draws (and dispatches) with at least one shader with a known role, per replay
+   uint64_t capture_replay_main_view_cbuffers = 0; // Per replay
+   uint64_t capture_replay_cbuffer_mismatches = 0; // Global cbuffers whose detection didn't match the captured one, per replay
+   bool capture_replay_frame_passes_mismatch = false; // Whether the detected frame passes didn't match the captured ones
+   std::string capture_replay_frame_passes;
 
    uint32_t shader_cache_count = 0; // For dumping
 
@@ -922,144 +1101,39 @@ namespace
    std::array<std::string, LumaFrameDevSettings::SettingsNum> cb_luma_frame_dev_settings_names;
 #endif
 
-   static_assert(sizeof(Matrix44A) == sizeof(float4) * 4);
-
-   // Caches all the states we might need to modify to draw a simple pixel shader.
-   // First call "Cache()" (once) and then call "Restore()" (once).
-   struct DrawStateStack
+#if ENABLE_HOOKS_PROFILING
+   enum class ProfiledHook : size_t
    {
-      // This is the max according to PSSetShader() documentation
-      static constexpr UINT max_shader_class_instances = 256;
-
-      // Not used by Prey's CryEngine
-#define ENABLE_SHADER_CLASS_INSTANCES 0
-
-      DrawStateStack()
-      {
-#if ENABLE_SHADER_CLASS_INSTANCES
-         std::memset(&vs_instances, 0, sizeof(void*) * max_shader_class_instances);
-         std::memset(&ps_instances, 0, sizeof(void*) * max_shader_class_instances);
-#endif
-      }
-
-      // Cache aside the previous resources/states:
-      void Cache(ID3D11DeviceContext* device_context)
-      {
-         device_context->OMGetBlendState(&blend_state, blend_factor, &blend_sample_mask);
-         device_context->IAGetPrimitiveTopology(&primitive_topology);
-         device_context->RSGetScissorRects(&scissor_rects_num, nullptr); // This will get the number of scissor rects used
-         device_context->RSGetScissorRects(&scissor_rects_num, &scissor_rects[0]);
-         device_context->RSGetViewports(&viewports_num, nullptr); // This will get the number of viewports used
-         device_context->RSGetViewports(&viewports_num, &viewports[0]);
-         device_context->PSGetShaderResources(0, 1, &shader_resource_view); // Only cache the first one
-         device_context->PSGetConstantBuffers(luma_settings_cbuffer_index, 1, &constant_buffer_1); // Hardcoded to our "luma_settings_cbuffer_index" given that we generally use that one
-         device_context->PSGetConstantBuffers(luma_data_cbuffer_index, 1, &constant_buffer_2); // Hardcoded to our "luma_data_cbuffers_index" given that we generally use that one too ("luma_ui_cbuffer_index" isn't needed)
-         device_context->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, &render_target_views[0], &depth_stencil_view);
-#if ENABLE_SHADER_CLASS_INSTANCES
-         device_context->VSGetShader(&vs, vs_instances, &vs_instances_count);
-         device_context->PSGetShader(&ps, ps_instances, &ps_instances_count);
-         ASSERT_ONCE(vs_instances_count == 0 && ps_instances_count == 0);
-#else
-         device_context->VSGetShader(&vs, nullptr, 0);
-         device_context->PSGetShader(&ps, nullptr, 0);
-#endif
-
-#if 0 // These are not needed until proven otherwise, we don't change, nor rely on these states
-         ID3D11RasterizerState* RS;
-         UINT StencilRef;
-         ID3D11DepthStencilState* DepthStencilState;
-         ID3D11SamplerState* PSSampler;
-         ID3D11Buffer* IndexBuffer;
-         ID3D11Buffer* VSConstantBuffer;
-         ID3D11Buffer* VertexBuffer;
-         UINT IndexBufferOffset, VertexBufferStride, VertexBufferOffset;
-         DXGI_FORMAT IndexBufferFormat;
-         ID3D11InputLayout* InputLayout;
-
-         device_context->RSGetState(&RS);
-         device_context->OMGetDepthStencilState(&DepthStencilState, &StencilRef);
-         device_context->PSGetSamplers(0, 1, &PSSampler);
-         device_context->VSGetConstantBuffers(0, 1, &VSConstantBuffer);
-         device_context->IAGetIndexBuffer(&IndexBuffer, &IndexBufferFormat, &IndexBufferOffset);
-         device_context->IAGetVertexBuffers(0, 1, &VertexBuffer, &VertexBufferStride, &VertexBufferOffset);
-         device_context->IAGetInputLayout(&InputLayout);
-#endif
-      }
-
-      // Restore the previous resources/states:
-      void Restore(ID3D11DeviceContext* device_context)
-      {
-         device_context->OMSetBlendState(blend_state.get(), blend_factor, blend_sample_mask);
-         device_context->IASetPrimitiveTopology(primitive_topology);
-         device_context->RSSetScissorRects(scissor_rects_num, &scissor_rects[0]);
-         device_context->RSSetViewports(viewports_num, &viewports[0]);
-         ID3D11ShaderResourceView* const shader_resource_view_const = shader_resource_view.get();
-         device_context->PSSetShaderResources(0, 1, &shader_resource_view_const);
-         ID3D11Buffer* constant_buffer_const = constant_buffer_1.get();
-         device_context->PSSetConstantBuffers(luma_settings_cbuffer_index, 1, &constant_buffer_const);
-         constant_buffer_const = constant_buffer_2.get();
-         device_context->PSSetConstantBuffers(luma_data_cbuffer_index, 1, &constant_buffer_const);
-         device_context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, &render_target_views[0], depth_stencil_view.get());
-         for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
-         {
-            if (render_target_views[i] != nullptr)
-            {
-               render_target_views[i]->Release();
-               render_target_views[i] = nullptr;
-            }
-         }
-#if ENABLE_SHADER_CLASS_INSTANCES
-         device_context->VSSetShader(vs.get(), vs_instances, vs_instances_count);
-         device_context->PSSetShader(ps.get(), ps_instances, ps_instances_count);
-         for (UINT i = 0; i < max_shader_class_instances; i++)
-         {
-            if (vs_instances[i] != nullptr)
-            {
-               vs_instances[i]->Release();
-               vs_instances[i] = nullptr;
-            }
-            if (ps_instances[i] != nullptr)
-            {
-               ps_instances[i]->Release();
-               ps_instances[i] = nullptr;
-            }
-         }
+      BindPipeline,
+      Draw,
+      DrawIndexed,
+      Dispatch,
+      DrawOrDispatchIndirect,
+      PushDescriptors,
+      MapBufferRegion,
+      UnmapBufferRegion,
+      CopyResource,
+      Present,
+
+      Count
+   };
+   const char* const profiled_hooks_names[] = { "Bind Pipeline", "Draw", "Draw Indexed", "Dispatch", "Draw or Dispatch Indirect", "Push Descriptors", "Map Buffer Region", "Unmap Buffer Region", "Copy Resource", "Present" };
+   static_assert(std::size(profiled_hooks_names) == size_t(ProfiledHook::Count));
+   hook_profiler<size_t(ProfiledHook::Count)> hooks_profiler;
+   // Put this at the beginning of a hook to time it until it returns
+#define PROFILE_HOOK(hook) const hook_profiler<size_t(ProfiledHook::Count)>::scope hook_profiler_scope(hooks_profiler, size_t(hook))
 #else
-         device_context->VSSetShader(vs.get(), nullptr, 0);
-         device_context->PSSetShader(ps.get(), nullptr, 0);
-#endif
-      }
-
-      com_ptr<ID3D11BlendState> blend_state;
-      FLOAT blend_factor[4] = { 1.f, 1.f, 1.f, 1.f };
-      UINT blend_sample_mask;
-      com_ptr<ID3D11VertexShader> vs;
-      com_ptr<ID3D11PixelShader> ps;
-#if ENABLE_SHADER_CLASS_INSTANCES
-      UINT vs_instances_count = max_shader_class_instances;
-      UINT ps_instances_count = max_shader_class_instances;
-      ID3D11ClassInstance* vs_instances[max_shader_class_instances];
-      ID3D11ClassInstance* ps_instances[max_shader_class_instances];
+#define PROFILE_HOOK(hook)
 #endif
-      D3D11_PRIMITIVE_TOPOLOGY primitive_topology;
-      ID3D11RenderTargetView* render_target_views[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
-
-      com_ptr<ID3D11DepthStencilView> depth_stencil_view;
-      com_ptr<ID3D11ShaderResourceView> shader_resource_view;
-      com_ptr<ID3D11Buffer> constant_buffer_1;
-      com_ptr<ID3D11Buffer> constant_buffer_2;
-      D3D11_RECT scissor_rects[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
-      UINT scissor_rects_num = 1;
-      D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
-      UINT viewports_num = 1;
 
-#undef ENABLE_SHADER_CLASS_INSTANCES
-   };
+   static_assert(sizeof(Matrix44A) == sizeof(float4) * 4);
 
    // Forward declares:
    void DumpShader(uint32_t shader_hash, bool auto_detect_type);
-   void AutoDumpShaders();
-   void AutoLoadShaders(DeviceData* device_data);
+   void AutoDumpShaders(const std::atomic<bool>& cancelled);
+   void AutoLoadShaders(DeviceData* device_data, const std::atomic<bool>& cancelled);
+   void OnShaderFilesChanged(const std::vector<std::filesystem::path>& changed_files);
+   CachedPipeline* FindCachedPipeline(DeviceData& device_data, uint64_t pipeline_handle);
 
    // Quick and unsafe. Passing in the hash instead of the string is the only way make sure strings hashes are calculate them at compile time.
    __forceinline ShaderDefineData& GetShaderDefineData(uint32_t hash)
@@ -1112,9 +1186,9 @@ namespace
 
    uint64_t GetResourceByViewHandle(DeviceData& data, uint64_t handle)
    {
-      if (auto pair = data.resource_views.find(handle); pair != data.resource_views.end())
-         return pair->second;
-      return 0;
+      uint64_t resource_handle = 0;
+      data.resource_views.find(handle, resource_handle);
+      return resource_handle;
    }
 
    std::string GetResourceNameByViewHandle(DeviceData& data, uint64_t handle)
@@ -1196,7 +1270,21 @@ namespace
       }
    }
 
-   void UnloadCustomShaders(DeviceData& device_data, const std::unordered_set<uint64_t>& pipelines_filter = std::unordered_set<uint64_t>(), bool immediate = false, bool clean_custom_shader = true)
+   // Expects "s_mutex_generic" to be locked for writing.
+   // The clone is unlinked from the cached pipeline first, and only destroyed once all the lock free readers that could have seen it ("OnBindPipeline()") are done.
+   void DestroyPipelineClone(DeviceData& device_data, CachedPipeline* cached_pipeline)
+   {
+      const reshade::api::pipeline pipeline_clone = cached_pipeline->pipeline_clone.load(std::memory_order_relaxed);
+      cached_pipeline->cloned.store(false, std::memory_order_relaxed); // This stops the cloned pipeline from being bound again
+      cached_pipeline->pipeline_clone.store({ 0 }, std::memory_order_relaxed);
+      device_data.pipeline_cache_by_pipeline_clone_handle.erase(pipeline_clone.handle);
+      device_data.cloned_pipeline_count--;
+      device_data.cloned_pipelines_changed = true;
+      reshade::api::device* device = cached_pipeline->device;
+      device_data.rcu.retire([device, pipeline_clone]() { device->destroy_pipeline(pipeline_clone); });
+   }
+
+   void UnloadCustomShaders(DeviceData& device_data, const std::unordered_set<uint64_t>& pipelines_filter = std::unordered_set<uint64_t>(), bool clean_custom_shader = true)
    {
       const std::unique_lock lock(s_mutex_generic);
       for (auto& pair : device_data.pipeline_cache_by_pipeline_handle)
@@ -1222,20 +1310,7 @@ namespace
          }
 
          if (!cached_pipeline->cloned) continue;
-         cached_pipeline->cloned = false; // This stops the cloned pipeline from being used in the next frame, allowing us to destroy it
-         device_data.cloned_pipeline_count--;
-         device_data.cloned_pipelines_changed = true;
-
-         if (immediate)
-         {
-            cached_pipeline->device->destroy_pipeline(reshade::api::pipeline{ cached_pipeline->pipeline_clone.handle });
-         }
-         else
-         {
-            device_data.pipelines_to_destroy[cached_pipeline->pipeline_clone.handle] = cached_pipeline->device;
-         }
-         cached_pipeline->pipeline_clone = { 0 };
-         device_data.pipeline_cache_by_pipeline_clone_handle.erase(cached_pipeline->pipeline_clone.handle);
+         DestroyPipelineClone(device_data, cached_pipeline);
       }
    }
 
@@ -1285,6 +1360,19 @@ namespace
 
          std::filesystem::remove(entry_path);
       }
+
+      if (shaders_bytecode_pack.IsOpen())
+      {
+         shaders_bytecode_pack.Clear();
+      }
+      else
+      {
+         std::error_code error_code;
+         std::filesystem::remove(directory / shaders_bytecode_pack_file_name, error_code);
+      }
+      shaders_dependency_graph.Clear();
+      std::error_code error_code;
+      std::filesystem::remove(directory / shaders_dependency_graph_file_name, error_code);
    }
 
    // Expects "s_mutex_loading"
@@ -1348,9 +1436,352 @@ namespace
       if (lock) s_mutex_shader_objects.unlock();
    }
 
+   // A single custom shader (hash) to compile, it holds a copy of all the data it needs, so it can be compiled on any thread without locking any shared data
+   struct CustomShaderCompilationJob
+   {
+      std::filesystem::path entry_path;
+      std::string filename_no_extension_string;
+      std::string shader_target;
+      uint32_t shader_hash = 0;
+      bool is_hlsl = false;
+      bool is_cso = false;
+      std::vector<std::string> shader_defines;
+      std::wstring original_file_path_cso; // Only valid for hlsl files
+      std::wstring trimmed_file_path_cso; // Only valid for hlsl files
+      bool load_compiled_shader = false; // Whether we should attempt to load the compiled cso from disk (we had the matching preprocessed hash in the config)
+      std::size_t compiled_shader_preprocessed_hash = 0;
+      bool had_code = false;
+      bool precompile = false; // Only compile the shader into "shaders_bytecode_pack", without writing anything else on disk (the results are discarded)
+
+      // The new state of the custom shader, it replaces the cached one once the job is done (its code is only valid if "replaced_code" is true)
+      CachedCustomShader shader;
+      bool replaced_code = false;
+      bool changed = false;
+      bool save_preprocessed_hash = false;
+      bool compiled = false; // Whether the compiler actually ran (and succeeded)
+      std::string compilation_errors_log; // To be appended to "shaders_compilation_errors"
+   };
+
+   // The custom shaders found by the last full compilation, with only the data needed to compile them again with other defines ("s_mutex_loading")
+   std::vector<CustomShaderCompilationJob> precompilation_jobs;
+
+   // Shaders loaded from the compiled shaders pack show the warnings they were compiled with again, as if they had just been compiled (warnings are ignored in public builds)
+   void AppendCachedShaderWarnings(CustomShaderCompilationJob& job)
+   {
+#if DEVELOPMENT || TEST
+      if (!job.shader.compilation_errors.empty())
+      {
+         job.compilation_errors_log.append(job.filename_no_extension_string);
+         job.compilation_errors_log.append(": ");
+         job.compilation_errors_log.append(job.shader.compilation_errors);
+      }
+#endif
+   }
+
+   void RunCustomShaderCompilationJob(CustomShaderCompilationJob& job)
+   {
+      auto& custom_shader = job.shader;
+
+      if (job.load_compiled_shader)
+      {
+         // This will load the matching cso
+         if (utils::shader::compiler::LoadCompiledShaderFromFile(custom_shader.code, job.trimmed_file_path_cso.c_str()))
+         {
+            // If both reading the pre-processor hash from config and the compiled shader from disk succeeded, then we are free to continue as if this shader was working
+            custom_shader.file_path = job.entry_path;
+            custom_shader.is_hlsl = job.is_hlsl;
+            custom_shader.preprocessed_hash = job.compiled_shader_preprocessed_hash;
+            job.replaced_code = true;
+            job.had_code = !custom_shader.code.empty();
+            job.changed = true;
+            // Theoretically at this point, the shader pre-processor below should skip re-compiling this shader unless the hash changed
+         }
+      }
+
+      CComPtr<ID3DBlob> uncompiled_code_blob;
+
+      const uint64_t defines_hash = utils::shader::dependencies::HashDefines(job.shader_defines);
+
+      if (job.is_hlsl && !prevent_shader_cache_loading)
+      {
+         // If none of the files this shader was built from changed since it was last pre-processed (with the same defines), we can skip the pre-processor,
+         // and either keep the shader we already have, or find it in the compiled shaders pack
+         std::size_t preprocessed_hash = 0;
+         if (shaders_dependency_graph.IsUpToDate(job.shader_hash, job.entry_path, job.shader_target, defines_hash, preprocessed_hash))
+         {
+            if (custom_shader.preprocessed_hash == preprocessed_hash)
+            {
+               // Same as when the pre-processor found the shader didn't change (see below)
+               if (!job.had_code && !custom_shader.compilation_errors.empty())
+               {
+                  job.compilation_errors_log.append(job.filename_no_extension_string);
+                  job.compilation_errors_log.append(": ");
+                  job.compilation_errors_log.append(custom_shader.compilation_errors);
+               }
+               return;
+            }
+            std::vector<uint8_t> code;
+            std::string compilation_warnings;
+            if (shaders_bytecode_pack.Find(utils::shader::cache::ComputeKey(shader_compiler_version, preprocessed_hash, job.shader_target, job.shader_defines), code, compilation_warnings))
+            {
+               custom_shader.code = std::move(code);
+               custom_shader.file_path = job.entry_path;
+               custom_shader.is_hlsl = job.is_hlsl;
+               custom_shader.preprocessed_hash = preprocessed_hash;
+               custom_shader.compilation_errors = std::move(compilation_warnings);
+#if DEVELOPMENT || TEST
+               custom_shader.compilation_error = false;
+#endif
+               job.replaced_code = true;
+               job.changed = true;
+               AppendCachedShaderWarnings(job);
+               return;
+            }
+         }
+      }
+
+      if (job.is_hlsl)
+      {
+         // Note that we always include headers relative to the file root folder, changing the current path to the shaders directory isn't an option anymore,
+         // as it's shared by the whole process, and shaders are compiled on multiple threads.
+         std::string compilation_errors;
+
+         // Skip compiling the shader if it didn't change
+         // Note that this won't replace "custom_shader.compilation_error" unless there was any new error/warning, and that's kind of what we want
+         // Note that this will not try to build the shader again if the last compilation failed and its files haven't changed
+         bool error = false;
+         std::vector<utils::shader::dependencies::FileStamp> file_stamps;
+         const bool needs_compilation = utils::shader::compiler::PreprocessShaderFromFile(job.entry_path.c_str(), job.entry_path.c_str(), job.shader_target.c_str(), custom_shader.preprocessed_hash, uncompiled_code_blob, job.shader_defines, error, &compilation_errors, &file_stamps);
+         if (!error)
+         {
+            shaders_dependency_graph.Set(job.shader_hash, job.shader_target, defines_hash, custom_shader.preprocessed_hash, std::move(file_stamps));
+         }
+         else
+         {
+            shaders_dependency_graph.Remove(job.shader_hash, defines_hash);
+         }
+
+         // Only overwrite the previous compilation error if we have any preprocessor errors
+         if (!compilation_errors.empty() || error)
+         {
+            custom_shader.compilation_errors = compilation_errors;
+#if DEVELOPMENT || TEST
+            custom_shader.compilation_error = error;
+#endif
+#if !DEVELOPMENT && !TEST // Ignore warnings for public builds
+            if (error)
+#endif
+            {
+               job.compilation_errors_log.append(job.filename_no_extension_string);
+               job.compilation_errors_log.append(": ");
+               job.compilation_errors_log.append(compilation_errors);
+            }
+         }
+         // Print out the same (last) compilation errors again if the shader still needs to be compiled but hasn't changed.
+         // We might want to ignore this case for public builds (we can't know whether this was an error or a warning atm),
+         // but it seems like this can only trigger after a shader had previous failed to build, so these should be guaranteed to be errors,
+         // and thus we should be able to print them to all users (we don't want warnings in public builds).
+         else if (!needs_compilation && !job.had_code && !custom_shader.compilation_errors.empty())
+         {
+            job.compilation_errors_log.append(job.filename_no_extension_string);
+            job.compilation_errors_log.append(": ");
+            job.compilation_errors_log.append(custom_shader.compilation_errors);
+         }
+
+         if (!needs_compilation)
+         {
+            return;
+         }
+      }
+
+      // If we reached this place, we can consider this shader as "changed" even if it will fail compiling
+      job.changed = true;
+
+      // For extra safety, just clear everything that will be re-assigned below (as "ClearCustomShader()" would have), but keep the preprocessed hash we just filled up
+      custom_shader.file_path = job.entry_path;
+      custom_shader.is_hlsl = job.is_hlsl;
+      // Clear these in case the compiler didn't overwrite them
+      custom_shader.code.clear();
+      custom_shader.compilation_errors.clear();
+#if DEVELOPMENT || TEST
+      custom_shader.compilation_error = false;
+#endif
+      job.replaced_code = true;
+
+      if (job.is_hlsl)
+      {
+#if _DEBUG && LOG_VERBOSE
+         {
+            std::stringstream s;
+            s << "LoadCustomShaders(Compiling file: ";
+            s << job.entry_path.string();
+            s << ", hash: " << PRINT_CRC32(job.shader_hash);
+            s << ", target: " << job.shader_target;
+            s << ")";
+            reshade::log::message(reshade::log::level::debug, s.str().c_str());
+         }
+#endif
+
+         // Look for the shader in the compiled shaders pack first, we don't need to compile it again if it ever was with the same code and defines.
+         // Note that we don't update the pre-processor hash in the config in this case, as it needs to match the cso on disk, which was not replaced.
+         const uint64_t bytecode_pack_key = utils::shader::cache::ComputeKey(shader_compiler_version, custom_shader.preprocessed_hash, job.shader_target, job.shader_defines);
+         if (!prevent_shader_cache_loading && shaders_bytecode_pack.Find(bytecode_pack_key, custom_shader.code, custom_shader.compilation_errors))
+         {
+#if _DEBUG && LOG_VERBOSE
+            std::stringstream s;
+            s << "LoadCustomShaders(Shader loaded from pack with size: " << custom_shader.code.size() << ")";
+            reshade::log::message(reshade::log::level::debug, s.str().c_str());
+#endif
+            AppendCachedShaderWarnings(job);
+            return;
+         }
+
+         bool error = false;
+         // TODO: specify the name of the function to compile (e.g. "main" or HDRTonemapPS) so we could unify more shaders into a single file with multiple techniques?
+         utils::shader::compiler::CompileShaderFromFile(
+            custom_shader.code,
+            uncompiled_code_blob,
+            job.entry_path.c_str(),
+            job.shader_target.c_str(),
+            job.shader_defines,
+            !prevent_shader_cache_saving && !job.precompile,
+            error,
+            &custom_shader.compilation_errors,
+            job.trimmed_file_path_cso.c_str());
+         ASSERT_ONCE(!job.trimmed_file_path_cso.empty()); // If we got here, this string should always be valid, as it means the shader read from disk was an hlsl
+
+         // Ugly workaround to avoid providing the shader compiler a custom name for CSO files, given we trim their name from multiple hashes that the HLSL original path might have
+         if (!prevent_shader_cache_saving && !job.precompile && !job.original_file_path_cso.empty() && job.original_file_path_cso != job.trimmed_file_path_cso)
+         {
+            if (std::filesystem::is_regular_file(job.original_file_path_cso))
+            {
+               ASSERT_ONCE(false); // This shouldn't happen anymore unless the shader was manually created or named
+               std::filesystem::remove(job.trimmed_file_path_cso);
+               std::filesystem::rename(job.original_file_path_cso, job.trimmed_file_path_cso);
+            }
+         }
+
+         if (!custom_shader.compilation_errors.empty())
+         {
+#if DEVELOPMENT || TEST
+            custom_shader.compilation_error = error;
+#endif
+#if !DEVELOPMENT && !TEST // Ignore warnings for public builds
+            if (error)
+#endif
+            {
+               job.compilation_errors_log.append(job.filename_no_extension_string);
+               job.compilation_errors_log.append(": ");
+               job.compilation_errors_log.append(custom_shader.compilation_errors);
+            }
+         }
+
+         if (custom_shader.code.empty())
+         {
+            std::stringstream s;
+            s << "LoadCustomShaders(Compilation failed: ";
+            s << job.entry_path.string();
+            s << ")";
+            reshade::log::message(reshade::log::level::warning, s.str().c_str());
+
+            return;
+         }
+         job.compiled = true;
+         // Save the matching the pre-compiled shader hash in the config, so we can skip re-compilation on the next boot
+         if (!prevent_shader_cache_saving)
+         {
+            job.save_preprocessed_hash = !job.precompile;
+            shaders_bytecode_pack.Append(bytecode_pack_key, custom_shader.code, custom_shader.compilation_errors); // Only warnings, given the compilation succeeded
+         }
+
+#if _DEBUG && LOG_VERBOSE
+         {
+            std::stringstream s;
+            s << "LoadCustomShaders(Shader built with size: " << custom_shader.code.size() << ")";
+            reshade::log::message(reshade::log::level::debug, s.str().c_str());
+         }
+#endif
+      }
+      else if (job.is_cso)
+      {
+         try
+         {
+            std::ifstream file;
+            file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+            file.open(job.entry_path, std::ios::binary);
+            file.seekg(0, std::ios::end);
+            custom_shader.code.resize(file.tellg());
+#if _DEBUG && LOG_VERBOSE
+            {
+               std::stringstream s;
+               s << "LoadCustomShaders(Reading " << custom_shader.code.size() << " from " << job.filename_no_extension_string << ")";
+               reshade::log::message(reshade::log::level::debug, s.str().c_str());
+            }
+#endif
+            if (!custom_shader.code.empty())
+            {
+               file.seekg(0, std::ios::beg);
+               file.read(reinterpret_cast<char*>(custom_shader.code.data()), custom_shader.code.size());
+            }
+         }
+         catch (const std::exception& e)
+         {
+         }
+      }
+   }
+
+   // Runs all the jobs on a bounded amount of threads (the calling one included, the others are render critical jobs of "background_jobs"), with work stealing (see "work_stealing_jobs"),
+   // so threads that got quick jobs (e.g. shaders that didn't change) end up taking over the work left behind by the ones that got stuck on long compilations.
+   // Each job only writes to its own data, so the results are always the same independently of the order in which they finished.
+   // The remaining jobs are skipped if a newer compilation started in the meantime (the results would be discarded anyway).
+   void RunCustomShaderCompilationJobs(std::vector<CustomShaderCompilationJob>& jobs, uint32_t compilation_generation)
+   {
+      // Leave one core free for the game (the calling thread also compiles)
+      size_t threads_num = std::thread::hardware_concurrency() > 1 ? (std::thread::hardware_concurrency() - 1) : 1;
+      if (threads_num > max_shaders_compilation_threads) threads_num = max_shaders_compilation_threads;
+      work_stealing_jobs::run(jobs.size(), threads_num - 1,
+         [&jobs](size_t job_index) { RunCustomShaderCompilationJob(jobs[job_index]); },
+         [compilation_generation]() { return compilation_generation != shaders_compilation_generation; },
+         [](std::function<void()> helper)
+         {
+            // If the job system is shutting down, the calling thread will run all the jobs
+            background_jobs.submit(JobPriority::RenderCritical, [helper = std::move(helper)](const std::atomic<bool>& /*cancelled*/) { helper(); });
+         });
+   }
+
+   // Name of the config entry that stores the preprocessed hash of the last compiled (and saved to disk) version of a custom shader
+   std::string GetShaderConfigName(uint32_t shader_hash)
+   {
+      char config_name[std::string_view("Shader#").size() + HASH_CHARACTERS_LENGTH + 1] = "";
+      sprintf(&config_name[0], "Shader#%08X", shader_hash);
+      return config_name;
+   }
+
+   // Reads the preprocessed hash saved for a custom shader (expects "s_mutex_loading" to be locked).
+   // Entries used to be named after the hash as it was written in the shader file name ("hash_string"), which could differ from the current name (e.g. if it was lower case),
+   // these are moved to the new name, otherwise all the shaders would be compiled again on the first boot after the update.
+   bool GetShaderConfigPreprocessedHash(uint32_t shader_hash, const std::string& hash_string, std::size_t& preprocessed_hash)
+   {
+      const std::string config_name = GetShaderConfigName(shader_hash);
+      if (reshade::get_config_value(nullptr, NAME_ADVANCED_SETTINGS.c_str(), config_name.c_str(), preprocessed_hash))
+      {
+         return true;
+      }
+      const std::string legacy_config_name = "Shader#" + hash_string;
+      if (legacy_config_name == config_name || !reshade::get_config_value(nullptr, NAME_ADVANCED_SETTINGS.c_str(), legacy_config_name.c_str(), preprocessed_hash))
+      {
+         return false;
+      }
+      reshade::set_config_value(nullptr, NAME_ADVANCED_SETTINGS.c_str(), config_name.c_str(), preprocessed_hash);
+      reshade::set_config_value(nullptr, NAME_ADVANCED_SETTINGS.c_str(), legacy_config_name.c_str(), static_cast<const char*>(nullptr)); // Removes the key
+      return true;
+   }
+
    // Compiles all the "custom" shaders we have in our shaders folder
-   void CompileCustomShaders(DeviceData* optional_device_data = nullptr, bool warn_about_duplicates = false, const std::unordered_set<uint64_t>& pipelines_filter = std::unordered_set<uint64_t>())
+   // Shaders can be filtered by the pipelines that use them ("pipelines_filter") and/or by their hash ("shaders_filter", e.g. for the custom device shaders, that aren't used by any pipeline).
+   void CompileCustomShaders(DeviceData* optional_device_data = nullptr, bool warn_about_duplicates = false, const std::unordered_set<uint64_t>& pipelines_filter = std::unordered_set<uint64_t>(), const std::unordered_set<uint32_t>& shaders_filter = std::unordered_set<uint32_t>())
    {
+      const bool filtered = !pipelines_filter.empty() || !shaders_filter.empty();
       std::vector<std::string> shader_defines;
       // Cache them for consistency and to avoid threads from halting
       {
@@ -1386,7 +1817,7 @@ namespace
          return;
       }
 
-      if (pipelines_filter.empty())
+      // This is parsed even when compiling a subset of the shaders, as the settings might be what changed (e.g. after hot reloading it)
       {
          const std::unique_lock lock_shader_defines(s_mutex_shader_defines);
 
@@ -1522,7 +1953,13 @@ namespace
          }
       }
 
+      // Unfiltered compilations supersede any other compilation that was still in progress
+      const uint32_t compilation_generation = !filtered ? ++shaders_compilation_generation : shaders_compilation_generation.load();
+
       std::unordered_set<uint32_t> changed_shaders_hashes;
+      // The list of shaders to (possibly) compile, in the order we found them
+      std::vector<CustomShaderCompilationJob> jobs;
+      std::unordered_map<uint32_t, size_t> jobs_index_by_shader_hash;
 
 #if DEVELOPMENT && ALLOW_LOADING_DEV_SHADERS
       auto dev_directory = directory;
@@ -1617,8 +2054,8 @@ namespace
             }
 
             // Early out before compiling
-            ASSERT_ONCE(pipelines_filter.empty() || optional_device_data); // We can't apply a filter if we didn't pass in the "DeviceData"
-            if (!pipelines_filter.empty() && optional_device_data)
+            ASSERT_ONCE(!filtered || optional_device_data); // We can't apply a filter if we didn't pass in the "DeviceData"
+            if (filtered && optional_device_data && !shaders_filter.contains(shader_hash))
             {
                const std::shared_lock lock(s_mutex_generic);
                bool pipeline_found = false;
@@ -1642,14 +2079,14 @@ namespace
             local_shader_defines.push_back("_" + hash_string);
             local_shader_defines.push_back("1");
 
-            char config_name[std::string_view("Shader#").size() + HASH_CHARACTERS_LENGTH + 1] = "";
-            sprintf(&config_name[0], "Shader#%s", hash_string.c_str());
-
-            const std::unique_lock lock(s_mutex_loading); // Don't lock until now as we didn't access any shared data
-            auto& custom_shader = custom_shaders_cache[shader_hash]; // Add default initialized shader
-            const bool has_custom_shader = (custom_shaders_cache.find(shader_hash) != custom_shaders_cache.end()) && (custom_shader != nullptr); // Weird code...
-            std::wstring original_file_path_cso; // Only valid for hlsl files
-            std::wstring trimmed_file_path_cso; // Only valid for hlsl files
+            CustomShaderCompilationJob job;
+            job.entry_path = entry_path;
+            job.filename_no_extension_string = filename_no_extension_string;
+            job.shader_target = shader_target;
+            job.shader_hash = shader_hash;
+            job.is_hlsl = is_hlsl;
+            job.is_cso = is_cso;
+            job.shader_defines = std::move(local_shader_defines);
 
             if (is_hlsl)
             {
@@ -1664,7 +2101,7 @@ namespace
                {
                   file_path_cso += L".cso";
                }
-               original_file_path_cso = file_path_cso;
+               job.original_file_path_cso = file_path_cso;
 
                size_t first_hash_pos = file_path_cso.find(L"0x");
                if (first_hash_pos != std::string::npos)
@@ -1680,32 +2117,25 @@ namespace
                   }
                   file_path_cso.replace(first_hash_pos + 2 /*0x*/, HASH_CHARACTERS_LENGTH, hash_wstring.c_str());
                }
-               trimmed_file_path_cso = file_path_cso;
+               job.trimmed_file_path_cso = file_path_cso;
             }
 
+            const std::unique_lock lock(s_mutex_loading); // Don't lock until now as we didn't access any shared data
+            auto& custom_shader = custom_shaders_cache[shader_hash]; // Add default initialized shader
+            const bool has_custom_shader = custom_shader != nullptr;
+
             if (!has_custom_shader)
             {
                custom_shader = new CachedCustomShader();
 
-               std::size_t preprocessed_hash = custom_shader->preprocessed_hash;
                // Note that if anybody manually changed the config hash, the data here could mismatch and end up recompiling when not needed or skipping recompilation even if needed (near impossible chance)
                const bool should_load_compiled_shader = is_hlsl && !prevent_shader_cache_loading; // If this shader doesn't have an hlsl, we should never read it or save it on disk, there's no need (we can still fall back on the original .cso if needed)
-               if (should_load_compiled_shader && reshade::get_config_value(nullptr, NAME_ADVANCED_SETTINGS.c_str(), &config_name[0], preprocessed_hash))
-               {
-                  // This will load the matching cso
-                  // TODO: move these to a sub folder called "cache"? It'd make everything cleaner (and the "CompileCustomShaders()" could simply nuke a directory then, and we could remove the restriction where hlsl files need to have a name in front of the hash),
-                  // but it would make it harder to manually remove a single specific shader cso we wanted to nuke for test reasons (especially if we exclusively put the hash in their cso name).
-                  // Also it would be a problem due to the custom "native" shaders we have (e.g. "copy") that don't have a target hash they are replacing.
-                  if (utils::shader::compiler::LoadCompiledShaderFromFile(custom_shader->code, trimmed_file_path_cso.c_str()))
-                  {
-                     // If both reading the pre-processor hash from config and the compiled shader from disk succeeded, then we are free to continue as if this shader was working
-                     custom_shader->file_path = entry_path;
-                     custom_shader->is_hlsl = is_hlsl;
-                     custom_shader->preprocessed_hash = preprocessed_hash;
-                     changed_shaders_hashes.emplace(shader_hash);
-                     // Theoretically at this point, the shader pre-processor below should skip re-compiling this shader unless the hash changed
-                  }
-               }
+               // The matching cso will be loaded by the job
+               // TODO: move these to a sub folder called "cache"? It'd make everything cleaner (and the "CompileCustomShaders()" could simply nuke a directory then, and we could remove the restriction where hlsl files need to have a name in front of the hash),
+               // but it would make it harder to manually remove a single specific shader cso we wanted to nuke for test reasons (especially if we exclusively put the hash in their cso name).
+               // Also it would be a problem due to the custom "native" shaders we have (e.g. "copy") that don't have a target hash they are replacing.
+               // If we have the compiled shaders pack, we don't need to read the config and the cso, the shader will be found in the pack after pre-processing it.
+               job.load_compiled_shader = should_load_compiled_shader && !shaders_bytecode_pack.IsOpen() && GetShaderConfigPreprocessedHash(shader_hash, hash_string, job.compiled_shader_preprocessed_hash);
             }
             else if (warn_about_duplicates)
             {
@@ -1716,197 +2146,103 @@ namespace
 #endif
             }
 
-            CComPtr<ID3DBlob> uncompiled_code_blob;
-
-            if (is_hlsl)
-            {
-               constexpr bool compile_from_current_path = false; // Set this to true to include headers from the current directory instead of the file root folder
-
-               const auto previous_path = std::filesystem::current_path();
-               if (compile_from_current_path)
-               {
-                  // Set the current path to the shaders directory, it can be needed by the DX compilers (specifically by the preprocess functions)
-                  std::filesystem::current_path(directory);
-               }
-
-               std::string compilation_errors;
-
-               // Skip compiling the shader if it didn't change
-               // Note that this won't replace "custom_shader->compilation_error" unless there was any new error/warning, and that's kind of what we want
-               // Note that this will not try to build the shader again if the last compilation failed and its files haven't changed
-               bool error = false;
-               const bool needs_compilation = utils::shader::compiler::PreprocessShaderFromFile(entry_path.c_str(), compile_from_current_path ? entry_path.filename().c_str() : entry_path.c_str(), shader_target.c_str(), custom_shader->preprocessed_hash, uncompiled_code_blob, local_shader_defines, error, &compilation_errors);
-
-               // Only overwrite the previous compilation error if we have any preprocessor errors
-               if (!compilation_errors.empty() || error)
-               {
-                  custom_shader->compilation_errors = compilation_errors;
+            // Take a copy of the current state of the shader (excluding its code, which we'd only ever replace), the job will work on it without needing any lock
+            job.shader.is_hlsl = custom_shader->is_hlsl;
+            job.shader.file_path = custom_shader->file_path;
+            job.shader.preprocessed_hash = custom_shader->preprocessed_hash;
+            job.shader.compilation_errors = custom_shader->compilation_errors;
 #if DEVELOPMENT || TEST
-                  custom_shader->compilation_error = error;
-#endif
-#if !DEVELOPMENT && !TEST // Ignore warnings for public builds
-                  if (error)
+            job.shader.compilation_error = custom_shader->compilation_error;
 #endif
-                  {
-                     shaders_compilation_errors.append(filename_no_extension_string);
-                     shaders_compilation_errors.append(": ");
-                     shaders_compilation_errors.append(compilation_errors);
-                  }
-               }
-               // Print out the same (last) compilation errors again if the shader still needs to be compiled but hasn't changed.
-               // We might want to ignore this case for public builds (we can't know whether this was an error or a warning atm),
-               // but it seems like this can only trigger after a shader had previous failed to build, so these should be guaranteed to be errors,
-               // and thus we should be able to print them to all users (we don't want warnings in public builds).
-               else if (!needs_compilation && custom_shader->code.size() == 0 && !custom_shader->compilation_errors.empty())
-               {
-                  shaders_compilation_errors.append(filename_no_extension_string);
-                  shaders_compilation_errors.append(": ");
-                  shaders_compilation_errors.append(custom_shader->compilation_errors);
-               }
+            job.had_code = !custom_shader->code.empty();
 
-               if (compile_from_current_path)
-               {
-                  // Restore it to avoid unknown consequences
-                  std::filesystem::current_path(previous_path);
-               }
-
-               if (!needs_compilation)
-               {
-                  continue;
-               }
+            // If two files target the same shader hash, whichever is iterated last wins (as if they were compiled in order)
+            if (const auto job_index = jobs_index_by_shader_hash.find(shader_hash); job_index != jobs_index_by_shader_hash.end())
+            {
+               jobs[job_index->second] = std::move(job);
+            }
+            else
+            {
+               jobs_index_by_shader_hash[shader_hash] = jobs.size();
+               jobs.push_back(std::move(job));
             }
+         }
+      }
 
-            // If we reached this place, we can consider this shader as "changed" even if it will fail compiling.
-            // We don't care to avoid adding duplicate elements to this list.
-            changed_shaders_hashes.emplace(shader_hash);
+      RunCustomShaderCompilationJobs(jobs, compilation_generation);
 
-            // For extra safety, just clear everything that will be re-assigned below if this custom shader already existed
-            if (has_custom_shader)
+      // Commit the results in the same order the shaders were found, so the errors log is deterministic
+      {
+         const std::unique_lock lock(s_mutex_loading);
+         // Don't apply anything if a newer compilation started in the meantime, it will apply its own results
+         if (compilation_generation != shaders_compilation_generation)
+         {
+            return;
+         }
+         for (auto& job : jobs)
+         {
+            shaders_compilation_errors.append(job.compilation_errors_log);
+            if (job.changed)
             {
-               auto preprocessed_hash = custom_shader->preprocessed_hash;
-               ClearCustomShader(shader_hash);
-               // Keep the data we just filled up
-               custom_shader->preprocessed_hash = preprocessed_hash;
+               changed_shaders_hashes.emplace(job.shader_hash);
             }
-            custom_shader->file_path = entry_path;
-            custom_shader->is_hlsl = is_hlsl;
-            // Clear these in case the compiler didn't overwrite them
-            custom_shader->code.clear();
-            custom_shader->compilation_errors.clear();
-#if DEVELOPMENT || TEST
-            custom_shader->compilation_error = false;
-#endif
-
-            if (is_hlsl)
+            if (job.save_preprocessed_hash)
             {
-#if _DEBUG && LOG_VERBOSE
-               {
-                  std::stringstream s;
-                  s << "LoadCustomShaders(Compiling file: ";
-                  s << entry_path.string();
-                  s << ", hash: " << PRINT_CRC32(shader_hash);
-                  s << ", target: " << shader_target;
-                  s << ")";
-                  reshade::log::message(reshade::log::level::debug, s.str().c_str());
-               }
-#endif
-
-               bool error = false;
-               // TODO: specify the name of the function to compile (e.g. "main" or HDRTonemapPS) so we could unify more shaders into a single file with multiple techniques?
-               utils::shader::compiler::CompileShaderFromFile(
-                  custom_shader->code,
-                  uncompiled_code_blob,
-                  entry_path.c_str(),
-                  shader_target.c_str(),
-                  local_shader_defines,
-                  !prevent_shader_cache_saving,
-                  error,
-                  &custom_shader->compilation_errors,
-                  trimmed_file_path_cso.c_str());
-               ASSERT_ONCE(!trimmed_file_path_cso.empty()); // If we got here, this string should always be valid, as it means the shader read from disk was an hlsl
-
-               // Ugly workaround to avoid providing the shader compiler a custom name for CSO files, given we trim their name from multiple hashes that the HLSL original path might have
-               if (!prevent_shader_cache_saving && !original_file_path_cso.empty() && original_file_path_cso != trimmed_file_path_cso)
-               {
-                  if (std::filesystem::is_regular_file(original_file_path_cso))
-                  {
-                     ASSERT_ONCE(false); // This shouldn't happen anymore unless the shader was manually created or named
-                     std::filesystem::remove(trimmed_file_path_cso);
-                     std::filesystem::rename(original_file_path_cso, trimmed_file_path_cso);
-                  }
-               }
-
-               if (!custom_shader->compilation_errors.empty())
-               {
-#if DEVELOPMENT || TEST
-                  custom_shader->compilation_error = error;
-#endif
-#if !DEVELOPMENT && !TEST // Ignore warnings for public builds
-                  if (error)
-#endif
-                  {
-                     shaders_compilation_errors.append(filename_no_extension_string);
-                     shaders_compilation_errors.append(": ");
-                     shaders_compilation_errors.append(custom_shader->compilation_errors);
-                  }
-               }
-
-               if (custom_shader->code.empty())
-               {
-                  std::stringstream s;
-                  s << "LoadCustomShaders(Compilation failed: ";
-                  s << entry_path.string();
-                  s << ")";
-                  reshade::log::message(reshade::log::level::warning, s.str().c_str());
+               reshade::set_config_value(nullptr, NAME_ADVANCED_SETTINGS.c_str(), GetShaderConfigName(job.shader_hash).c_str(), job.shader.preprocessed_hash);
+            }
 
-                  continue;
-               }
-               // Save the matching the pre-compiled shader hash in the config, so we can skip re-compilation on the next boot
-               else if (!prevent_shader_cache_saving)
-               {
-                  reshade::set_config_value(nullptr, NAME_ADVANCED_SETTINGS.c_str(), &config_name[0], custom_shader->preprocessed_hash);
-               }
+            auto& custom_shader = custom_shaders_cache[job.shader_hash];
+            if (custom_shader == nullptr) // The cache might have been cleared in the meantime
+            {
+               custom_shader = new CachedCustomShader();
+            }
+            if (!job.replaced_code)
+            {
+               job.shader.code = std::move(custom_shader->code);
+            }
+            *custom_shader = std::move(job.shader);
+         }
 
-#if _DEBUG && LOG_VERBOSE
-               {
-                  std::stringstream s;
-                  s << "LoadCustomShaders(Shader built with size: " << custom_shader->code.size() << ")";
-                  reshade::log::message(reshade::log::level::debug, s.str().c_str());
-               }
-#endif
+         // Remember what we compiled, so we can precompile the defines permutations the user might switch to next
+         if (!filtered)
+         {
+            precompilation_jobs.clear();
+            std::unordered_set<uint32_t> hlsl_shader_hashes;
+            for (const auto& job : jobs)
+            {
+               if (!job.is_hlsl) continue;
+               hlsl_shader_hashes.emplace(job.shader_hash);
+               auto& precompilation_job = precompilation_jobs.emplace_back();
+               precompilation_job.entry_path = job.entry_path;
+               precompilation_job.filename_no_extension_string = job.filename_no_extension_string;
+               precompilation_job.shader_target = job.shader_target;
+               precompilation_job.shader_hash = job.shader_hash;
+               precompilation_job.is_hlsl = job.is_hlsl;
+               precompilation_job.trimmed_file_path_cso = job.trimmed_file_path_cso; // Needed by the compiler, even if precompiled shaders are never saved as cso
+               // Only keep the per shader "target" hash define (the last one), the others will be replaced with the permutation ones
+               ASSERT_ONCE(job.shader_defines.size() >= 2);
+               precompilation_job.shader_defines.assign(job.shader_defines.end() - 2, job.shader_defines.end());
+               precompilation_job.precompile = true;
             }
-            else if (is_cso)
+            // Forget about the dependencies of the shaders that aren't there anymore
+            shaders_dependency_graph.RemoveOtherShaders(hlsl_shader_hashes);
+            const auto permutations_statistics = shader_defines_permutations.get_statistics();
+            shader_defines_permutations.on_compiled(shader_defines);
+            if (shader_defines_permutations.get_statistics().hits != permutations_statistics.hits)
             {
-               try
-               {
-                  std::ifstream file;
-                  file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-                  file.open(entry_path, std::ios::binary);
-                  file.seekg(0, std::ios::end);
-                  custom_shader->code.resize(file.tellg());
-#if _DEBUG && LOG_VERBOSE
-                  {
-                     std::stringstream s;
-                     s << "LoadCustomShaders(Reading " << custom_shader->code.size() << " from " << filename_no_extension_string << ")";
-                     reshade::log::message(reshade::log::level::debug, s.str().c_str());
-                  }
-#endif
-                  if (!custom_shader->code.empty())
-                  {
-                     file.seekg(0, std::ios::beg);
-                     file.read(reinterpret_cast<char*>(custom_shader->code.data()), custom_shader->code.size());
-                  }
-               }
-               catch (const std::exception& e)
-               {
-               }
+               reshade::log::message(reshade::log::level::info, "CompileCustomShaders(the new defines had been precompiled)");
             }
+            needs_precompile_shader_permutations = precompile_shader_permutations && shaders_bytecode_pack.IsOpen() && !prevent_shader_cache_saving;
          }
       }
 
       // TODO: theoretically if "prevent_shader_cache_saving" is true, we should clean all the shader hashes and defines from the config, though hopefully it's fine without
-      if (pipelines_filter.empty() && !prevent_shader_cache_saving)
+      if (!filtered && !prevent_shader_cache_saving)
       {
+         // Only keep the shaders we used since boot if the pack grew too much
+         shaders_bytecode_pack.Compact(shaders_bytecode_pack_size_budget);
+         shaders_dependency_graph.Save(directory / shaders_dependency_graph_file_name);
+
          const std::shared_lock lock(s_mutex_shader_defines);
          // Only save after compiling, to make sure the config data aligns with the serialized compiled shaders data (blobs)
          ShaderDefineData::Save(shader_defines_data);
@@ -1919,8 +2255,70 @@ namespace
       }
    }
 
+   // Compiles all the custom shaders with the defines permutations the user is likely to switch to next (see "shader_permutations"), storing them in "shaders_bytecode_pack" (and "shaders_dependency_graph"),
+   // so that when they do, their shaders are simply loaded from there.
+   // This runs as a single "background compile" job (at idle thread priority), to not steal any performance from the game, and it stops as soon as any other full shaders compilation starts (or if it's cancelled).
+   void PrecompileShaderPermutations(const std::atomic<bool>& cancelled)
+   {
+      const uint32_t compilation_generation = shaders_compilation_generation;
+
+      std::vector<shader_permutations::define_range> defines_ranges;
+      {
+         const std::shared_lock lock(s_mutex_shader_defines);
+         defines_ranges.resize(shader_defines_data.size());
+         for (uint32_t i = 0; i < shader_defines_data.size(); i++)
+         {
+            const auto& shader_define_data = shader_defines_data[i];
+            defines_ranges[i].name = shader_define_data.compiled_data.GetName();
+            defines_ranges[i].editable = !shader_define_data.IsCustom() && shader_define_data.IsValueEditable() && shader_define_data.GetValueRange(defines_ranges[i].min_value, defines_ranges[i].max_value);
+         }
+      }
+      std::vector<CustomShaderCompilationJob> jobs;
+      std::vector<std::vector<std::string>> permutations;
+      {
+         const std::shared_lock lock(s_mutex_loading);
+         jobs = precompilation_jobs;
+         permutations = shader_defines_permutations.get_likely_permutations(defines_ranges);
+      }
+
+      const auto results = shader_permutations::precompile(permutations, jobs.size(),
+         [&](const std::vector<std::string>& permutation, size_t job_index)
+         {
+            CustomShaderCompilationJob job = jobs[job_index];
+            job.shader_defines = permutation;
+            job.shader_defines.insert(job.shader_defines.end(), jobs[job_index].shader_defines.begin(), jobs[job_index].shader_defines.end());
+            RunCustomShaderCompilationJob(job);
+            if (job.compiled) return shader_permutations::compilation_result::compiled;
+            if (job.replaced_code) return shader_permutations::compilation_result::cached;
+            return shader_permutations::compilation_result::failed;
+         },
+         [&]() { return cancelled || compilation_generation != shaders_compilation_generation; });
+      shader_permutations::statistics statistics;
+      {
+         const std::unique_lock lock(s_mutex_loading);
+         shader_defines_permutations.on_precompiled(results);
+         statistics = shader_defines_permutations.get_statistics();
+      }
+      if (!results.cancelled)
+      {
+         shaders_dependency_graph.Save(GetShaderPath() / shaders_dependency_graph_file_name);
+      }
+
+      {
+         std::stringstream s;
+         s << "PrecompileShaderPermutations(permutations: " << results.precompiled_permutations.size() << "/" << permutations.size();
+         s << ", compiled: " << results.compiled_shaders;
+         s << ", already cached: " << results.cached_shaders;
+         s << ", failed: " << results.failed_shaders;
+         s << ", switches found precompiled: " << statistics.hits << "/" << (statistics.hits + statistics.misses);
+         s << ")";
+         reshade::log::message(reshade::log::level::info, s.str().c_str());
+      }
+      thread_precompiling_running = false;
+   }
+
    // Optionally compiles all the shaders we have in our data folder and links them with the game rendering pipelines
-   void LoadCustomShaders(DeviceData& device_data, const std::unordered_set<uint64_t>& pipelines_filter = std::unordered_set<uint64_t>(), bool recompile_shaders = true, bool immediate_unload = false)
+   void LoadCustomShaders(DeviceData& device_data, const std::unordered_set<uint64_t>& pipelines_filter = std::unordered_set<uint64_t>(), bool recompile_shaders = true)
    {
 #if _DEBUG && LOG_VERBOSE
       reshade::log::message(reshade::log::level::info, "LoadCustomShaders()");
@@ -1935,7 +2333,7 @@ namespace
       const std::unique_lock lock(s_mutex_generic);
 
       // Clear all previously loaded custom shaders
-      UnloadCustomShaders(device_data, pipelines_filter, immediate_unload, false);
+      UnloadCustomShaders(device_data, pipelines_filter, false);
 
       std::unordered_set<uint64_t> cloned_pipelines;
 
@@ -1948,8 +2346,8 @@ namespace
          // Skip shaders that don't have code binaries at the moment
          if (custom_shader == nullptr || custom_shader->code.empty()) continue;
 
-         auto pipelines_pair = device_data.pipeline_caches_by_shader_hash.find(shader_hash);
-         if (pipelines_pair == device_data.pipeline_caches_by_shader_hash.end())
+         const auto* cached_pipelines = device_data.pipeline_caches_by_shader_hash.find(shader_hash);
+         if (cached_pipelines == nullptr)
          {
             std::stringstream s;
             s << "LoadCustomShaders(Unknown hash: ";
@@ -1960,14 +2358,14 @@ namespace
          }
 
          // Re-clone all the pipelines that used this shader hash (except the ones that are filtered out)
-         for (CachedPipeline* cached_pipeline : pipelines_pair->second)
+         for (CachedPipeline* cached_pipeline : *cached_pipelines)
          {
             if (cached_pipeline == nullptr) continue;
             if (!pipelines_filter.empty() && !pipelines_filter.contains(cached_pipeline->pipeline.handle)) continue;
             if (cloned_pipelines.contains(cached_pipeline->pipeline.handle)) { assert(false); continue; }
             cloned_pipelines.emplace(cached_pipeline->pipeline.handle);
             // Force destroy this pipeline in case it was already cloned
-            UnloadCustomShaders(device_data, { cached_pipeline->pipeline.handle }, immediate_unload, false);
+            UnloadCustomShaders(device_data, { cached_pipeline->pipeline.handle }, false);
 
 #if _DEBUG && LOG_VERBOSE
             {
@@ -2022,7 +2420,7 @@ namespace
                new_desc->code = malloc(custom_shader->code.size());
                std::memcpy(const_cast<void*>(new_desc->code), custom_shader->code.data(), custom_shader->code.size());
 
-               const auto new_hash = compute_crc32(static_cast<const uint8_t*>(new_desc->code), new_desc->code_size);
+               const auto new_hash = utils::hash::ComputeCRC32(static_cast<const uint8_t*>(new_desc->code), new_desc->code_size);
 
 #if _DEBUG && LOG_VERBOSE
                {
@@ -2071,9 +2469,9 @@ namespace
 
             if (built_pipeline_ok)
             {
-               assert(!cached_pipeline->cloned && cached_pipeline->pipeline_clone.handle == 0);
-               cached_pipeline->pipeline_clone = pipeline_clone;
-               cached_pipeline->cloned = true;
+               assert(!cached_pipeline->cloned && cached_pipeline->pipeline_clone.load().handle == 0);
+               cached_pipeline->pipeline_clone.store(pipeline_clone, std::memory_order_relaxed);
+               cached_pipeline->cloned.store(true, std::memory_order_release); // Publish the clone to lock free readers
                device_data.pipeline_cache_by_pipeline_clone_handle[pipeline_clone.handle] = cached_pipeline;
                device_data.cloned_pipeline_count++;
                device_data.cloned_pipelines_changed = true;
@@ -2105,27 +2503,33 @@ namespace
       return result;
    }
 
-   // Expects mutexes to already be locked
-   void AddTraceDrawCallData(std::vector<TraceDrawCallData>& trace_draw_calls_data, const DeviceData& device_data, ID3D11DeviceContext* native_device_context, uint64_t pipeline_handle)
+#if DEVELOPMENT
+   // Moves the trace of a command list into the trace of the command list it's executed on (unpacking its records), in the order they were recorded.
+   // Expects to be called from the thread that submits the command list (e.g. on command lists execution, or on present), which is the only consumer of its trace ring.
+   void MergeTraceDrawCalls(CommandListData& target_cmd_list_data, CommandListData& cmd_list_data)
    {
-      TraceDrawCallData trace_draw_call_data;
+      target_cmd_list_data.trace_draw_calls.merge(cmd_list_data.trace_draw_calls, trace_index, &UnpackTraceDrawCallRecord);
+   }
 
-#if 1
-      trace_draw_call_data.pipeline_handle = pipeline_handle;
-#else
-      trace_draw_call_data.shader_hashes = shader_hash;
-      trace_draw_call_data.pipeline_handles.push_back(pipeline_handle);
-#endif
+   // Doesn't need any lock, the trace record is pushed in the command list own trace ring
+   void AddTraceDrawCallData(CommandListData& cmd_list_data, DeviceData& device_data, ID3D11DeviceContext* native_device_context, uint64_t pipeline_handle)
+   {
+      TraceDrawCallRecord trace_draw_call_data = {};
 
+      trace_draw_call_data.pipeline_handle = pipeline_handle;
       trace_draw_call_data.command_list = native_device_context;
       trace_draw_call_data.thread_id = std::this_thread::get_id();
+      trace_draw_call_data.trace_index = trace_index;
+      const bool is_deferred = native_device_context->GetType() != D3D11_DEVICE_CONTEXT_IMMEDIATE;
+      if (is_deferred)
+      {
+         trace_draw_call_data.flags |= TraceDrawCallRecord_Deferred;
+      }
 
       // Note that the pipelines can be run more than once so this will return the first one matching (there's only one actually, we don't have separate settings for their running instance, as that's runtime stuff)
-      const auto pipeline_pair = device_data.pipeline_cache_by_pipeline_handle.find(pipeline_handle);
-      const bool is_valid = pipeline_pair != device_data.pipeline_cache_by_pipeline_handle.end() && pipeline_pair->second != nullptr;
-      if (is_valid)
+      const auto* pipeline = FindCachedPipeline(device_data, pipeline_handle);
+      if (pipeline != nullptr)
       {
-         const auto pipeline = pipeline_pair->second;
          if (pipeline->HasPixelShader())
          {
             com_ptr<ID3D11BlendState> blend_state;
@@ -2135,7 +2539,12 @@ namespace
                D3D11_BLEND_DESC blend_desc;
                blend_state->GetDesc(&blend_desc);
                // We always cache the last one used by the pipeline, hopefully it didn't change between draw calls
-               trace_draw_call_data.blend_desc = blend_desc;
+               trace_draw_call_data.flags |= blend_desc.AlphaToCoverageEnable ? TraceDrawCallRecord_AlphaToCoverageEnable : 0;
+               trace_draw_call_data.flags |= blend_desc.IndependentBlendEnable ? TraceDrawCallRecord_IndependentBlendEnable : 0;
+               for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+               {
+                  trace_draw_call_data.blend_render_targets[i] = PackRenderTargetBlendDesc(blend_desc.RenderTarget[i]);
+               }
                // We don't care for the alpha blend operation (source alpha * dest alpha) as alpha is never read back from destination
             }
 
@@ -2147,12 +2556,12 @@ namespace
                {
                   D3D11_RENDER_TARGET_VIEW_DESC rtv_desc;
                   rtvs[i]->GetDesc(&rtv_desc);
-                  trace_draw_call_data.rtv_format[i] = rtv_desc.Format;
+                  trace_draw_call_data.rtv_format[i] = uint8_t(rtv_desc.Format);
                   com_ptr<ID3D11Resource> rt_resource;
                   rtvs[i]->GetResource(&rt_resource);
                   if (rt_resource)
                   {
-                     trace_draw_call_data.rt_is_swapchain[i] = device_data.back_buffers.contains((uint64_t)rt_resource.get());
+                     trace_draw_call_data.rt_is_swapchain_mask |= device_data.back_buffers.contains((uint64_t)rt_resource.get()) ? (1 << i) : 0;
                      
                      com_ptr<ID3D11Texture2D> rt_texture_2d;
                      HRESULT hr = rt_resource->QueryInterface(&rt_texture_2d);
@@ -2160,8 +2569,9 @@ namespace
                      {
                         D3D11_TEXTURE2D_DESC rt_texture_2d_desc;
                         rt_texture_2d->GetDesc(&rt_texture_2d_desc);
-                        trace_draw_call_data.rt_format[i] = rt_texture_2d_desc.Format;
-                        trace_draw_call_data.rt_size[i] = uint2{ rt_texture_2d_desc.Width, rt_texture_2d_desc.Height };
+                        trace_draw_call_data.rt_format[i] = uint8_t(rt_texture_2d_desc.Format);
+                        trace_draw_call_data.rt_size[i][0] = uint16_t(rt_texture_2d_desc.Width);
+                        trace_draw_call_data.rt_size[i][1] = uint16_t(rt_texture_2d_desc.Height);
                      }
                   }
                }
@@ -2175,7 +2585,7 @@ namespace
                {
                   D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc;
                   srvs[i]->GetDesc(&srv_desc);
-                  trace_draw_call_data.srv_format[i] = srv_desc.Format;
+                  trace_draw_call_data.srv_format[i] = uint8_t(srv_desc.Format);
                }
             }
          }
@@ -2189,7 +2599,7 @@ namespace
                {
                   D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc;
                   srvs[i]->GetDesc(&srv_desc);
-                  trace_draw_call_data.srv_format[i] = srv_desc.Format;
+                  trace_draw_call_data.srv_format[i] = uint8_t(srv_desc.Format);
                }
             }
          }
@@ -2203,7 +2613,7 @@ namespace
                {
                   D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc;
                   srvs[i]->GetDesc(&srv_desc);
-                  trace_draw_call_data.srv_format[i] = srv_desc.Format;
+                  trace_draw_call_data.srv_format[i] = uint8_t(srv_desc.Format);
                }
             }
 
@@ -2215,15 +2625,154 @@ namespace
                {
                   D3D11_UNORDERED_ACCESS_VIEW_DESC uav_desc;
                   uavs[i]->GetDesc(&uav_desc);
-                  trace_draw_call_data.uav_format[i] = uav_desc.Format;
+                  trace_draw_call_data.uav_format[i] = uint8_t(uav_desc.Format);
                }
             }
          }
       }
 
-      trace_draw_calls_data.push_back(trace_draw_call_data);
+      // If the ring is full, the immediate command list can simply flush it into the final trace, as it's also its consumer (deferred command lists drop the record)
+      if (!cmd_list_data.trace_draw_calls.records.push(trace_draw_call_data) && !is_deferred)
+      {
+         MergeTraceDrawCalls(cmd_list_data, cmd_list_data);
+         cmd_list_data.trace_draw_calls.records.push(trace_draw_call_data);
+      }
+      ASSERT_ONCE(cmd_list_data.trace_draw_calls.records.get_dropped_count() == 0 || !is_deferred); // A deferred command list traced more draw calls than its ring can hold
+   }
+#endif // DEVELOPMENT
+
+   // Starts a new GPU profiler section, which lasts until the next one (or until the end of the frame).
+   // Deferred device contexts are ignored, as their commands would only be executed (and thus timed) later.
+   void MarkGPUProfilerPass(DeviceData& device_data, reshade::api::command_list* cmd_list, const char* name)
+   {
+#if DEVELOPMENT
+      if (gpu_profiler_enabled && ((ID3D11DeviceContext*)(cmd_list->get_native()))->GetType() == D3D11_DEVICE_CONTEXT_IMMEDIATE)
+      {
+         device_data.gpu_profiler.mark(cmd_list, name);
+      }
+#endif
+   }
+   void MarkGPUProfilerPass(DeviceData& device_data, reshade::api::command_list* cmd_list, FramePass pass)
+   {
+      MarkGPUProfilerPass(device_data, cmd_list, frame_passes_descs[size_t(pass)].name);
+   }
+
+#if DEVELOPMENT
+   // Expects "s_mutex_generic" to be locked
+   void CaptureInitPipeline(const CachedPipeline& cached_pipeline)
+   {
+      FrameCaptureInitPipeline event = {};
+      event.pipeline = cached_pipeline.pipeline.handle;
+      for (uint32_t i = 0; i < cached_pipeline.subobject_count; i++)
+      {
+         event.subobject_types_mask |= 1u << uint32_t(cached_pipeline.subobjects_cache[i].type);
+      }
+      event.shader_hashes_count = uint32_t(cached_pipeline.shader_hashes.size());
+      frame_capture.write(FrameCaptureEvent::InitPipeline, event, cached_pipeline.shader_hashes.data(), event.shader_hashes_count * uint32_t(sizeof(uint32_t)));
    }
 
+   // Replays a frame capture on a mock backend (without touching the device), running the shaders roles, frame passes and global cbuffer detections on it,
+   // to benchmark them, and to verify that they still match what the addon detected when the frame was captured.
+   // This runs as a "background_jobs" job, as it takes a while, and publishes its results (see "s_mutex_capture_replay") once done.
+   void ReplayCapture(const std::filesystem::path& capture_path, const std::atomic<bool>& cancelled)
+   {
+      frame_capture_reader reader;
+      if (!reader.open(capture_path))
+      {
+         ASSERT_ONCE(false);
+         capture_replay_running = false;
+         return;
+      }
+      // Our own passes aren't drawn by the game, and upscaling is also marked as drawn when DRS isn't active (which isn't captured), so these can't be verified
+      constexpr uint32_t replayable_frame_passes = ~(FramePassBit(FramePass::DLSS_SR) | FramePassBit(FramePass::Upscaling));
+      uint64_t role_draws = 0;
+      uint64_t main_view_cbuffers = 0;
+      uint64_t cbuffer_mismatches = 0;
+      uint64_t frame_passes_mismatches = 0;
+      frame_pass_tracker frame_passes;
+      std::string frame_passes_sequence;
+      mock_render_backend backend;
+      backend.pipeline_init_callback = [](const mock_render_backend::pipeline& pipeline)
+         {
+            uint32_t roles = (uint32_t)ShaderRoleMask::None;
+            for (const auto subobject_type : pipeline.subobject_types)
+            {
+               for (const uint32_t shader_hash : pipeline.shader_hashes)
+               {
+                  roles |= GetShaderRoles(shader_hash, subobject_type);
+               }
+            }
+            return roles;
+         };
+      backend.draw_callback = [&](const mock_render_backend::command_list_state& state, bool is_dispatch)
+         {
+            uint32_t roles = (uint32_t)ShaderRoleMask::None;
+            if (is_dispatch)
+            {
+               roles |= state.compute_shader ? state.compute_shader->user_data : 0;
+            }
+            else
+            {
+               roles |= state.vertex_shader ? state.vertex_shader->user_data : 0;
+               roles |= state.pixel_shader ? state.pixel_shader->user_data : 0;
+            }
+            if (roles == (uint32_t)ShaderRoleMask::None) return;
+            role_draws++;
+            const FramePass drawn_frame_pass = GetDrawnFramePass(roles, frame_passes);
+            if (drawn_frame_pass != FramePass::Count)
+            {
+               frame_passes.mark_drawn(drawn_frame_pass);
+            }
+         };
+      backend.global_cbuffer_callback = [&](reshade::api::resource buffer, const void* data, uint32_t size, bool captured_is_main_view)
+         {
+            const bool is_main_view = size >= sizeof(CBPerViewGlobal) && IsMainViewGlobalCBuffer(*static_cast<const CBPerViewGlobal*>(data));
+            main_view_cbuffers += is_main_view ? 1 : 0;
+            cbuffer_mismatches += is_main_view != captured_is_main_view ? 1 : 0;
+         };
+      backend.present_callback = [&](uint64_t frame_index, uint32_t captured_drawn_passes)
+         {
+            frame_passes.end_frame();
+            frame_passes_mismatches += ((frame_passes.get_previous_drawn_passes() ^ captured_drawn_passes) & replayable_frame_passes) != 0 ? 1 : 0;
+            frame_passes_sequence = frame_passes.get_previous_sequence();
+         };
+      // Benchmark in batches, so we can stop in between if we got cancelled (e.g. the addon is unloading)
+      constexpr uint32_t iterations = 100;
+      constexpr uint32_t iterations_per_batch = 10;
+      mock_render_backend::benchmark_results results;
+      for (uint32_t i = 0; i < iterations; i += iterations_per_batch)
+      {
+         if (cancelled)
+         {
+            capture_replay_running = false;
+            return;
+         }
+         const auto batch_results = backend.benchmark(reader, iterations_per_batch);
+         results.iterations += batch_results.iterations;
+         results.events = batch_results.events;
+         results.total_ms += batch_results.total_ms;
+      }
+      if (results.events != 0)
+      {
+         results.ns_per_event = results.total_ms * 1000000.0 / (double(results.events) * double(results.iterations));
+      }
+      ASSERT_ONCE(cbuffer_mismatches == 0); // The global cbuffer detection changed since the capture was taken (or it depends on more than the cbuffer data)
+      ASSERT_ONCE(frame_passes_mismatches == 0); // The frame passes detection changed since the capture was taken (or it depends on more than the shaders and the frame progress)
+
+      {
+         const std::lock_guard lock_capture_replay(s_mutex_capture_replay);
+         capture_replay_results = results;
+         capture_replay_statistics = backend.get_statistics();
+         capture_replay_role_draws = role_draws / iterations;
+         capture_replay_main_view_cbuffers = main_view_cbuffers / iterations;
+         capture_replay_cbuffer_mismatches = cbuffer_mismatches / iterations;
+         capture_replay_frame_passes_mismatch = frame_passes_mismatches != 0;
+         capture_replay_frame_passes = frame_passes_sequence;
+      }
+      capture_replay_running = false;
+   }
+#endif
+
    void OnDisplayModeChanged()
    {
       // s_mutex_reshade should already be locked here, it's not necessary anyway
@@ -2368,18 +2917,15 @@ namespace
 
       ASSERT_ONCE(device_data.swapchains.empty()); // Hopefully this is forcefully garbage collected when the device is destroyed (it is!)
 
-      if (device_data.thread_auto_loading.joinable())
-      {
-         device_data.thread_auto_loading.join();
-         device_data.thread_auto_loading_running = false;
-      }
+      // Cancel and wait for all the background jobs of this device
+      background_jobs.drain(&device_data);
+      device_data.thread_auto_loading_running = false;
 
       assert(device_data.cb_per_view_global_buffer_map_data == nullptr); // It's fine (but not great) if we map wasn't unmapped before destruction (not our fault anyway)
 
       {
-         const std::unique_lock lock_samplers(s_mutex_samplers);
-         ASSERT_ONCE(device_data.custom_sampler_by_original_sampler.empty()); // These should be guaranteed to have been cleared already ("OnDestroySampler()")
-         device_data.custom_sampler_by_original_sampler.clear();
+         ASSERT_ONCE(device_data.custom_samplers.empty()); // These should be guaranteed to have been cleared already ("OnDestroySampler()")
+         device_data.custom_samplers.clear();
       }
 
 #if DEVELOPMENT
@@ -2388,6 +2934,7 @@ namespace
          const std::unique_lock lock_trace(s_mutex_trace);
          trace_count = 0;
       }
+      device_data.gpu_profiler.reset(device); // Its queries aren't released automatically
 #endif
 
 #if ENABLE_NGX
@@ -2549,6 +3096,8 @@ namespace
       auto& device_data = device->get_private_data<DeviceData>();
       ASSERT_ONCE(&device_data != nullptr); // Hacky nullptr check (should ever be able to happen)
       auto& swapchain_data = swapchain->get_private_data<SwapchainData>();
+      // Our cached views hold references to the back buffers, which all need to be released before the swapchain can be resized or destroyed
+      device_data.custom_views_cache.clear();
       {
          const std::unique_lock lock(device_data.mutex);
          device_data.swapchains.erase(swapchain);
@@ -2684,7 +3233,11 @@ namespace
                ASSERT_ONCE(new_desc->code_size > 0);
                if (new_desc->code_size == 0) break;
                found_replaceable_shader = true;
-               auto shader_hash = compute_crc32(static_cast<const uint8_t*>(new_desc->code), new_desc->code_size);
+               auto shader_hash = utils::hash::ComputeCRC32(static_cast<const uint8_t*>(new_desc->code), new_desc->code_size);
+#if _DEBUG
+               // Make sure our faster implementation still matches the original one (all shader file names and hardcoded hashes depend on it)
+               assert(shader_hash == compute_crc32(static_cast<const uint8_t*>(new_desc->code), new_desc->code_size));
+#endif
 
 #if ALLOW_SHADERS_DUMPING
                {
@@ -2721,17 +3274,9 @@ namespace
                assert(std::find(cached_pipeline->shader_hashes.begin(), cached_pipeline->shader_hashes.end(), shader_hash) == cached_pipeline->shader_hashes.end());
                cached_pipeline->shader_hashes.emplace_back(shader_hash);
                ASSERT_ONCE(cached_pipeline->shader_hashes.size() == 1); // Just to make sure if this actually happens
+               cached_pipeline->roles |= GetShaderRoles(shader_hash, subobject.type);
 
-               // Make sure we didn't already have a valid pipeline in there (this should never happen)
-               auto pipelines_pair = device_data.pipeline_caches_by_shader_hash.find(shader_hash);
-               if (pipelines_pair != device_data.pipeline_caches_by_shader_hash.end())
-               {
-                  pipelines_pair->second.emplace(cached_pipeline);
-               }
-               else
-               {
-                  device_data.pipeline_caches_by_shader_hash[shader_hash] = { cached_pipeline };
-               }
+               device_data.pipeline_caches_by_shader_hash.insert(shader_hash, cached_pipeline);
                {
                   const std::shared_lock lock(s_mutex_loading);
                   found_custom_shader_file |= custom_shaders_cache.contains(shader_hash);
@@ -2763,6 +3308,13 @@ namespace
          return;
       }
       device_data.pipeline_cache_by_pipeline_handle[pipeline.handle] = cached_pipeline;
+      device_data.pipeline_cache_snapshot_dirty = true;
+#if DEVELOPMENT
+      if (frame_capture.is_capturing())
+      {
+         CaptureInitPipeline(*cached_pipeline);
+      }
+#endif
 
       // Automatically load any custom shaders that might have been bound to this pipeline.
       // To avoid this slowing down everything, we only do it if we detect the user already had a matching shader in its custom shaders folder.
@@ -2797,12 +3349,8 @@ namespace
 
          if (cached_pipeline != nullptr)
          {
-            // Clean other references to the pipeline
-            for (auto& pipelines_cache_pair : device_data.pipeline_caches_by_shader_hash)
-            {
-               auto& cached_pipelines = pipelines_cache_pair.second;
-               cached_pipelines.erase(cached_pipeline);
-            }
+            // Clean other references to the pipeline (only in the buckets of its own shader hashes)
+            device_data.pipeline_caches_by_shader_hash.erase(cached_pipeline);
 
             // Destroy our cloned subojects
             DestroyPipelineSubojects(cached_pipeline->subobjects_cache, cached_pipeline->subobject_count);
@@ -2811,25 +3359,47 @@ namespace
             // Destroy our cloned version of the pipeline (and leave the original intact)
             if (cached_pipeline->cloned)
             {
-               cached_pipeline->cloned = false;
-               cached_pipeline->device->destroy_pipeline(cached_pipeline->pipeline_clone);
-               device_data.pipeline_cache_by_pipeline_clone_handle.erase(cached_pipeline->pipeline_clone.handle);
-               device_data.cloned_pipeline_count--;
-               device_data.cloned_pipelines_changed = true;
+               DestroyPipelineClone(device_data, cached_pipeline);
             }
-            free(cached_pipeline);
+            // Lock free readers might still be using it in the current frame
+            device_data.rcu.retire(cached_pipeline);
             cached_pipeline = nullptr;
          }
 
+         device_data.pipeline_cache_snapshot_dirty = true;
          device_data.pipeline_cache_by_pipeline_handle.erase(pipeline.handle);
       }
    }
 
+   // Returns the cached pipeline for the given original pipeline handle, if any.
+   // This doesn't lock "s_mutex_generic" unless the pipelines changed within the current frame, so it's fast enough for the hot paths (binding pipelines and drawing).
+   // The caller needs to be within a "rcu_domain::read_scope" of the device "rcu", the returned pointer (and its clone) is only guaranteed to be valid until the scope ends,
+   // and its data can be changed by other threads (it's only safe to read the "simple" members).
+   CachedPipeline* FindCachedPipeline(DeviceData& device_data, uint64_t pipeline_handle)
+   {
+      if (!device_data.pipeline_cache_snapshot_dirty.load(std::memory_order_acquire))
+      {
+         const auto* snapshot = device_data.pipeline_cache_by_pipeline_handle_snapshot.read();
+         const auto pipeline_pair = snapshot->find(pipeline_handle);
+         return pipeline_pair != snapshot->end() ? pipeline_pair->second : nullptr;
+      }
+      const std::shared_lock lock(s_mutex_generic);
+      const auto pipeline_pair = device_data.pipeline_cache_by_pipeline_handle.find(pipeline_handle);
+      return pipeline_pair != device_data.pipeline_cache_by_pipeline_handle.end() ? pipeline_pair->second : nullptr;
+   }
+
    void OnBindPipeline(
       reshade::api::command_list* cmd_list,
       reshade::api::pipeline_stage stages,
       reshade::api::pipeline pipeline)
    {
+      PROFILE_HOOK(ProfiledHook::BindPipeline);
+#if DEVELOPMENT
+      if (frame_capture.is_capturing())
+      {
+         frame_capture.write(FrameCaptureEvent::BindPipeline, FrameCaptureBindPipeline{ cmd_list->get_native(), pipeline.handle, uint32_t(stages), 0 });
+      }
+#endif
       auto& cmd_list_data = cmd_list->get_private_data<CommandListData>();
       auto& device_data = cmd_list->get_device()->get_private_data<DeviceData>();
 
@@ -2849,14 +3419,12 @@ namespace
          cmd_list_data.pipeline_state_original_pixel_shader = pipeline;
       }
 
-      const std::shared_lock lock(s_mutex_generic);
-      auto pair = device_data.pipeline_cache_by_pipeline_handle.find(pipeline.handle);
-      if (pair == device_data.pipeline_cache_by_pipeline_handle.end() || pair->second == nullptr) return;
-
-      auto* cached_pipeline = pair->second;
+      const rcu_domain::read_scope read_scope(device_data.rcu);
+      const auto* cached_pipeline = FindCachedPipeline(device_data, pipeline.handle);
+      if (cached_pipeline == nullptr) return;
 
 #if DEVELOPMENT
-      if (cached_pipeline->test)
+      if (cached_pipeline->test.load(std::memory_order_relaxed))
       {
          // This will make the shader output black, or skip drawing, so we can easily detect it. This might not be very safe but seems to work in DX11.
          // TODO: replace the pipeline with a shader that outputs all "SV_Target" as purple for more visiblity,
@@ -2865,117 +3433,28 @@ namespace
       }
       else
 #endif
-      if (cached_pipeline->cloned)
-      {
-         cmd_list->bind_pipeline(stages, cached_pipeline->pipeline_clone);
-      }
-   }
-
-   enum class LumaConstantBufferType
-   {
-      LumaSettings,
-      LumaData,
-      LumaUIData
-   };
-
-   void SetLumaConstantBuffers(ID3D11DeviceContext* native_device_context, DeviceData& device_data, reshade::api::shader_stage stages, LumaConstantBufferType type, uint32_t custom_data = 0)
-   {
-      // CryEngine doesn't ever use these buffers, so it's fine to update them once per frame if they didn't change
-      switch (type)
-      {
-      case LumaConstantBufferType::LumaSettings:
+      if (cached_pipeline->cloned.load(std::memory_order_acquire))
       {
+         // We aren't under "s_mutex_generic" so the clone might be getting unloaded in the meantime (in that case, it will only be destroyed after our read scope ended)
+         const reshade::api::pipeline pipeline_clone = cached_pipeline->pipeline_clone.load(std::memory_order_relaxed);
+         if (pipeline_clone.handle != 0)
          {
-            const std::shared_lock lock_reshade(s_mutex_reshade);
-            if (device_data.cb_luma_frame_settings_dirty)
-            {
-               device_data.cb_luma_frame_settings_dirty = false;
-               // My understanding is that "Map" doesn't immediately copy the memory to the GPU, but simply stores it on the side (in the command list),
-               // and then copies it to the GPU when the command list is executed, so the resource is updated with deterministic order.
-               // From our point of view, we don't really know what command list is currently running and what it is doing,
-               // so we could still end up first updating the resource in a command list that will be executed with a delay,
-               // and then updating the resource again in a command list that executes first, leaving the GPU buffer with whatever latest data it got (which might not be based on our latest version).
-               // Fortunately we don't use our cbuffers in any of the non main CryEngine command lists, so we can consider it all single threaded and deterministic.
-               if (D3D11_MAPPED_SUBRESOURCE mapped_buffer;
-                  SUCCEEDED(native_device_context->Map(device_data.luma_frame_settings.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_buffer)))
-               {
-                  std::memcpy(mapped_buffer.pData, &cb_luma_frame_settings, sizeof(cb_luma_frame_settings));
-                  native_device_context->Unmap(device_data.luma_frame_settings.get(), 0);
-               }
-            }
+            cmd_list->bind_pipeline(stages, pipeline_clone);
          }
-
-         ID3D11Buffer* const buffer = device_data.luma_frame_settings.get();
-         if ((stages & reshade::api::shader_stage::vertex) == reshade::api::shader_stage::vertex)
-            native_device_context->VSSetConstantBuffers(luma_settings_cbuffer_index, 1, &buffer);
-         if ((stages & reshade::api::shader_stage::geometry) == reshade::api::shader_stage::geometry)
-            native_device_context->GSSetConstantBuffers(luma_settings_cbuffer_index, 1, &buffer);
-         if ((stages & reshade::api::shader_stage::pixel) == reshade::api::shader_stage::pixel)
-            native_device_context->PSSetConstantBuffers(luma_settings_cbuffer_index, 1, &buffer);
-         if ((stages & reshade::api::shader_stage::compute) == reshade::api::shader_stage::compute)
-            native_device_context->CSSetConstantBuffers(luma_settings_cbuffer_index, 1, &buffer);
-         break;
-      }
-      case LumaConstantBufferType::LumaData:
-      {
-         LumaFrameData cb_luma_frame_data;
-         cb_luma_frame_data.PostEarlyUpscaling = device_data.has_drawn_dlss_sr && !device_data.has_drawn_upscaling; // TODO: delete? it's unused and kinda useless as we update the resolution scale anyway
-         cb_luma_frame_data.CustomData = custom_data;
-         cb_luma_frame_data.Padding = 0;
-         cb_luma_frame_data.FrameIndex = frame_index;
-         cb_luma_frame_data.CameraJitters = projection_jitters; // TODO: pre-multiply these by float2(0.5, -0.5) (NDC to UV space) given that they are always used in UV space by shaders. It doesn't really matter as they end up as "mad" single instructions
-         cb_luma_frame_data.PreviousCameraJitters = previous_projection_jitters;
-         cb_luma_frame_data.RenderResolutionScale.x = device_data.render_resolution.x / device_data.output_resolution.x;
-         cb_luma_frame_data.RenderResolutionScale.y = device_data.render_resolution.y / device_data.output_resolution.y;
-         // Always do this relative to the current output resolution
-         cb_luma_frame_data.PreviousRenderResolutionScale.x = device_data.previous_render_resolution.x / device_data.output_resolution.x;
-         cb_luma_frame_data.PreviousRenderResolutionScale.y = device_data.previous_render_resolution.y / device_data.output_resolution.y;
-#if 0
-         cb_luma_frame_data.ViewProjectionMatrix = cb_per_view_global.CV_ViewProjMatr; // Note that this is not 100% thread safe as "CV_ViewProjMatr" is written from another thread
-         cb_luma_frame_data.PreviousViewProjectionMatrix = cb_per_view_global_previous.CV_ViewProjMatr;
-#endif
-         cb_luma_frame_data.ReprojectionMatrix = reprojection_matrix;
-
-         if (memcmp(&device_data.cb_luma_frame_data, &cb_luma_frame_data, sizeof(cb_luma_frame_data)) != 0)
-         {
-            device_data.cb_luma_frame_data = cb_luma_frame_data;
-            if (D3D11_MAPPED_SUBRESOURCE mapped_buffer;
-               SUCCEEDED(native_device_context->Map(device_data.luma_frame_data.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_buffer)))
-            {
-               std::memcpy(mapped_buffer.pData, &device_data.cb_luma_frame_data, sizeof(device_data.cb_luma_frame_data));
-               native_device_context->Unmap(device_data.luma_frame_data.get(), 0);
-            }
-         }
-
-         ID3D11Buffer* const buffer = device_data.luma_frame_data.get();
-         if ((stages & reshade::api::shader_stage::vertex) == reshade::api::shader_stage::vertex)
-            native_device_context->VSSetConstantBuffers(luma_data_cbuffer_index, 1, &buffer);
-         if ((stages & reshade::api::shader_stage::geometry) == reshade::api::shader_stage::geometry)
-            native_device_context->GSSetConstantBuffers(luma_data_cbuffer_index, 1, &buffer);
-         if ((stages & reshade::api::shader_stage::pixel) == reshade::api::shader_stage::pixel)
-            native_device_context->PSSetConstantBuffers(luma_data_cbuffer_index, 1, &buffer);
-         if ((stages & reshade::api::shader_stage::compute) == reshade::api::shader_stage::compute)
-            native_device_context->CSSetConstantBuffers(luma_data_cbuffer_index, 1, &buffer);
-         break;
-      }
-      case LumaConstantBufferType::LumaUIData:
-      {
-         ASSERT_ONCE(false); // Not implemented (yet?)
-         break;
-      }
       }
    }
 
-   void DrawCustomPixelShader(ID3D11DeviceContext* device_context, ID3D11BlendState* blend_state, ID3D11VertexShader* vs, ID3D11PixelShader* ps, ID3D11ShaderResourceView* source_resource_texture_view, ID3D11RenderTargetView* target_resource_texture_view, UINT width, UINT height, bool alpha = true)
+   // The states are set through "state_stack", so that the ones that already matched don't need to be set, nor restored later
+   void DrawCustomPixelShader(ID3D11DeviceContext* device_context, draw_state_stack& state_stack, ID3D11BlendState* blend_state, ID3D11VertexShader* vs, ID3D11PixelShader* ps, ID3D11ShaderResourceView* source_resource_texture_view, ID3D11RenderTargetView* target_resource_texture_view, UINT width, UINT height, bool alpha = true)
    {
       // Set the new resources/states:
       constexpr FLOAT blend_factor_alpha[4] = { 1.f, 1.f, 1.f, 1.f };
       constexpr FLOAT blend_factor[4] = { 1.f, 1.f, 1.f, 0.f };
-      device_context->OMSetBlendState(blend_state, alpha ? blend_factor_alpha : blend_factor, 0xFFFFFFFF);
+      state_stack.set_blend_state(device_context, blend_state, alpha ? blend_factor_alpha : blend_factor, 0xFFFFFFFF);
       // Note: we don't seem to need to call (and cache+restore) IASetVertexBuffers().
       // That's either because Prey always has vertices buffers set in there already, or because DX is tolerant enough (we are not seeing any etc errors in the DX log).
-      device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-      device_context->RSSetScissorRects(0, nullptr); // Scissors are not needed
+      state_stack.set_primitive_topology(device_context, D3D11_PRIMITIVE_TOPOLOGY::D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+      state_stack.clear_scissor_rects(device_context); // Scissors are not needed
       D3D11_VIEWPORT viewport;
       viewport.TopLeftX = 0;
       viewport.TopLeftY = 0;
@@ -2983,11 +3462,10 @@ namespace
       viewport.Height = height;
       viewport.MinDepth = 0;
       viewport.MaxDepth = 1;
-      device_context->RSSetViewports(1, &viewport); // Viewport is always needed
-      device_context->PSSetShaderResources(0, 1, &source_resource_texture_view);
-      device_context->OMSetRenderTargets(1, &target_resource_texture_view, nullptr);
-      device_context->VSSetShader(vs, nullptr, 0);
-      device_context->PSSetShader(ps, nullptr, 0);
+      state_stack.set_viewport(device_context, viewport); // Viewport is always needed
+      state_stack.set_ps_shader_resource(device_context, source_resource_texture_view);
+      state_stack.set_render_target(device_context, target_resource_texture_view);
+      state_stack.set_shaders(device_context, vs, ps);
 
       // Finally draw:
       device_context->Draw(4, 0);
@@ -3057,18 +3535,16 @@ namespace
    }
 
 #if DEVELOPMENT
+   // This is called twice for deferred contexts: when they are finished ("cmd_list" is the new command list object, "secondary_cmd_list" the deferred context),
+   // and when that command list is executed ("cmd_list" is the immediate context), so the records get merged into the command list object first, and then into the immediate context.
    void OnExecuteSecondaryCommandList(reshade::api::command_list* cmd_list, reshade::api::command_list* secondary_cmd_list)
    {
-      const std::shared_lock lock_trace(s_mutex_trace);
-      if (trace_running)
-      {
-         auto& cmd_list_data = cmd_list->get_private_data<CommandListData>();
-         auto& secondary_cmd_list_data = secondary_cmd_list->get_private_data<CommandListData>();
-         const std::unique_lock lock_trace_2(cmd_list_data.mutex_trace);
-         const std::unique_lock lock_trace_3(secondary_cmd_list_data.mutex_trace);
-         cmd_list_data.trace_draw_calls_data.append_range(secondary_cmd_list_data.trace_draw_calls_data);
-         secondary_cmd_list_data.trace_draw_calls_data.clear();
-      }
+      // Always merge the secondary command list trace (even if the trace isn't running anymore), otherwise stale records could fill up its ring.
+      // First merge what the command list traced until now, to preserve the submission order.
+      auto& cmd_list_data = cmd_list->get_private_data<CommandListData>();
+      auto& secondary_cmd_list_data = secondary_cmd_list->get_private_data<CommandListData>();
+      MergeTraceDrawCalls(cmd_list_data, cmd_list_data);
+      MergeTraceDrawCalls(cmd_list_data, secondary_cmd_list_data);
    }
 #endif
 
@@ -3080,6 +3556,8 @@ namespace
       uint32_t dirty_rect_count,
       const reshade::api::rect* dirty_rects)
    {
+      // Note that this is only recorded after the frame statistics have been collected below, so it ends up in the next frame ones
+      PROFILE_HOOK(ProfiledHook::Present);
       ID3D11Device* native_device = (ID3D11Device*)(queue->get_device()->get_native());
       ID3D11DeviceContext* native_device_context = (ID3D11DeviceContext*)(queue->get_immediate_command_list()->get_native());
       auto& device_data = queue->get_device()->get_private_data<DeviceData>();
@@ -3179,31 +3657,31 @@ namespace
             }
 
             // We need to copy the texture to read back from it, even if we only exclusively write to the same pixel we read and thus there couldn't be any race condition. Unfortunately DX works like that.
+            MarkGPUProfilerPass(device_data, queue->get_immediate_command_list(), "Display Transfer Function");
             native_device_context->CopyResource(device_data.transfer_function_copy_texture.get(), back_buffer.get());
 
-            DrawStateStack draw_state_stack;
-            draw_state_stack.Cache(native_device_context);
+            draw_state_stack state_stack(luma_settings_cbuffer_index, luma_data_cbuffer_index);
 
             com_ptr<ID3D11RenderTargetView> target_resource_texture_view;
             // If we already had a render target, we can assume it was already set to the swapchain,
             // but it's good to make sure of it nonetheless.
-            if (draw_state_stack.render_target_views[0] != nullptr)
+            if (ID3D11RenderTargetView* const render_target_view = state_stack.get_render_target_view(native_device_context, 0))
             {
 #if DEVELOPMENT || TEST
                com_ptr<ID3D11Resource> render_target_resource;
-               draw_state_stack.render_target_views[0]->GetResource(&render_target_resource);
+               render_target_view->GetResource(&render_target_resource);
                assert(render_target_resource.get() == back_buffer.get());
 #endif
-               target_resource_texture_view = draw_state_stack.render_target_views[0];
+               target_resource_texture_view = render_target_view;
             }
-            else // This case doesn't seem to happen (ever?) so we don't bother caching the "ID3D11RenderTargetView"
+            else // This case doesn't seem to happen (ever?), but the view is cached anyway, it's cleared when the swapchain is destroyed or resized
             {
-               D3D11_RENDER_TARGET_VIEW_DESC target_rtv_desc;
+               D3D11_RENDER_TARGET_VIEW_DESC target_rtv_desc = {};
                target_rtv_desc.Format = target_desc.Format;
                target_rtv_desc.ViewDimension = D3D11_RTV_DIMENSION::D3D11_RTV_DIMENSION_TEXTURE2D;
                target_rtv_desc.Texture2D.MipSlice = 0;
-               HRESULT hr = native_device->CreateRenderTargetView(back_buffer.get(), &target_rtv_desc, &target_resource_texture_view);
-               assert(SUCCEEDED(hr));
+               target_resource_texture_view = device_data.custom_views_cache.get_rtv(native_device, back_buffer.get(), target_rtv_desc);
+               assert(target_resource_texture_view.get() != nullptr);
             }
 
             // Push our settings cbuffer in case where no other custom shader run this frame
@@ -3211,6 +3689,7 @@ namespace
                auto& device_data = queue->get_device()->get_private_data<DeviceData>();
                const std::shared_lock lock(device_data.mutex);
                const auto cb_luma_frame_settings_copy = cb_luma_frame_settings;
+               state_stack.cache(native_device_context, draw_state_stack::state_constant_buffers);
                // Force a custom display mode in case we have no game custom shaders loaded, so the custom linearization shader can linearize anyway, independently of "POST_PROCESS_SPACE_TYPE"
                bool force_linearize = device_data.cloned_pipeline_count == 0; // We ignore "s_mutex_generic", it doesn't matter
                if (force_linearize)
@@ -3225,12 +3704,13 @@ namespace
                   cb_luma_frame_settings.DisplayMode = cb_luma_frame_settings_copy.DisplayMode;
                   SetLumaConstantBuffers(native_device_context, device_data, reshade::api::shader_stage::pixel, LumaConstantBufferType::LumaData, custom_const_buffer_data);
                }
+               state_stack.mark_dirty(draw_state_stack::state_constant_buffers);
             }
 
             // Note: we don't need to re-apply our custom cbuffers as in Prey, they are on indexes that are never used by the game's code
-            DrawCustomPixelShader(native_device_context, device_data.default_blend_state.get(), device_data.copy_vertex_shader.get(), device_data.transfer_function_copy_pixel_shader.get(), device_data.transfer_function_copy_shader_resource_view.get(), target_resource_texture_view.get(), target_desc.Width, target_desc.Height, false);
+            DrawCustomPixelShader(native_device_context, state_stack, device_data.default_blend_state.get(), device_data.copy_vertex_shader.get(), device_data.transfer_function_copy_pixel_shader.get(), device_data.transfer_function_copy_shader_resource_view.get(), target_resource_texture_view.get(), target_desc.Width, target_desc.Height, false);
 
-            draw_state_stack.Restore(native_device_context);
+            state_stack.restore(native_device_context);
          }
          else
          {
@@ -3254,18 +3734,18 @@ namespace
       // Clean resources that are probably not needed anymore (e.g. if users disabled SSR and SSAO, we wouldn't get another chance to clean these up ever).
       // If users unloaded all shaders, these would automatically be cleared ir their rendering pass.
       // If users changed the output resolution, they would be automatically re-created in their rendering pass.
-      if (device_data.has_drawn_composed_gbuffers)
+      if (device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers))
       {
          // Check if some of them are valid just to avoid constant memory writes (not sure if it's a valid optimization)
-         if (!device_data.has_drawn_ssr && (device_data.ssr_texture.get() || device_data.ssr_diffuse_texture.get()))
+         if (!device_data.frame_passes.has_drawn(FramePass::SSR) && (device_data.ssr_texture.get() || device_data.ssr_diffuse_texture.get()))
          {
             device_data.CleanSSRResource();
          }
-         if (!device_data.has_drawn_ssao && device_data.gtao_edges_texture.get())
+         if (!device_data.frame_passes.has_drawn(FramePass::SSAO) && device_data.gtao_edges_texture.get())
          {
             device_data.CleanGTAOResource();
          }
-         if (!device_data.has_drawn_main_post_processing && (device_data.lens_distortion_texture.get() || device_data.lens_distortion_rtvs[0].get() || device_data.lens_distortion_rtvs[1].get())) // This seemengly can't happen
+         if (!device_data.frame_passes.has_drawn(FramePass::MainPostProcessing) && (device_data.lens_distortion_texture.get() || device_data.lens_distortion_rtvs[0].get() || device_data.lens_distortion_rtvs[1].get())) // This seemengly can't happen
          {
             device_data.CleanLensDistortionResource();
          }
@@ -3276,9 +3756,9 @@ namespace
       }
 
       // Update all variables as this is on the only thing guaranteed to run once per frame:
-      ASSERT_ONCE(!device_data.has_drawn_composed_gbuffers || device_data.found_per_view_globals); // We failed to find and assign global cbuffer 13 this frame (could it be that the scene is empty if this triggers?)
-      ASSERT_ONCE(device_data.has_drawn_composed_gbuffers == device_data.has_drawn_main_post_processing); // Why is g-buffer composition drawing but post processing isn't? We don't expect this to ever happen as PP should always be on
-      if (device_data.has_drawn_main_post_processing)
+      ASSERT_ONCE(!device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers) || device_data.found_per_view_globals); // We failed to find and assign global cbuffer 13 this frame (could it be that the scene is empty if this triggers?)
+      ASSERT_ONCE(device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers) == device_data.frame_passes.has_drawn(FramePass::MainPostProcessing)); // Why is g-buffer composition drawing but post processing isn't? We don't expect this to ever happen as PP should always be on
+      if (device_data.frame_passes.has_drawn(FramePass::MainPostProcessing))
       {
          device_data.previous_prey_taa_active[1] = device_data.previous_prey_taa_active[0];
          device_data.previous_prey_taa_active[0] = device_data.prey_taa_active;
@@ -3306,22 +3786,23 @@ namespace
          device_data.dlss_scene_exposure = 1.f;
          device_data.dlss_scene_pre_exposure = 1.f;
       }
-      device_data.has_drawn_ssao = false;
-      device_data.has_drawn_ssao_denoise = false;
-      device_data.has_drawn_ssr = false;
-      device_data.has_drawn_ssr_blend = false;
-      device_data.has_drawn_composed_gbuffers = false;
-      device_data.has_drawn_motion_blur_previous = device_data.has_drawn_motion_blur;
-      device_data.has_drawn_motion_blur = false;
-      device_data.has_drawn_tonemapping = false;
-      device_data.has_drawn_main_post_processing_previous = device_data.has_drawn_main_post_processing;
-      device_data.has_drawn_main_post_processing = false;
-      device_data.has_drawn_upscaling = false;
-      device_data.has_drawn_dlss_sr_imgui = device_data.has_drawn_dlss_sr;
-      device_data.has_drawn_dlss_sr = false;
+      device_data.frame_passes.end_frame();
+#if DEVELOPMENT
+      if (gpu_profiler_enabled)
+      {
+         // The first section of the next frame covers everything before the first detected pass (e.g. shadow maps and GBuffers)
+         device_data.gpu_profiler.end_frame(queue, "Frame Start");
+      }
+#endif
+      ASSERT_ONCE(device_data.frame_passes.get_previous_anomalous_passes() == 0 || device_data.cloned_pipeline_count == 0); // Some passes were drawn twice, or out of the expected order, in this frame (see "frame_passes_descs")
 #if 1 // Not much need to reset this, but let's do it anyway (e.g. in case the game scene isn't currently rendering)
       device_data.prey_drs_active = false;
 #endif
+      // Once the global cbuffer has been found for enough frames, all the buffers it could be in have been mapped at least once (and thus added to the candidates)
+      if (device_data.found_per_view_globals && device_data.cb_per_view_global_buffer_candidates_seeding_frames.load(std::memory_order_relaxed) != 0)
+      {
+         device_data.cb_per_view_global_buffer_candidates_seeding_frames.fetch_sub(1, std::memory_order_relaxed);
+      }
       device_data.found_per_view_globals = false;
       device_data.previous_render_resolution = device_data.render_resolution;
       previous_projection_matrix = projection_matrix;
@@ -3372,15 +3853,13 @@ namespace
          {
             device_data.dlss_output_color = nullptr;
             device_data.dlss_exposure = nullptr;
-            device_data.dlss_motion_vectors = nullptr;
             device_data.dlss_motion_vectors_rtv = nullptr;
+            device_data.transient_textures.release(device_data.dlss_motion_vectors);
             device_data.dlss_render_resolution_scale = 1.f; // Reset this to 0 when DLSS is toggled, even if "prey_drs_detected" is still true, we'll set it back to a low value if DRS is used again.
             device_data.dlss_scene_exposure = 1.f;
             device_data.dlss_scene_pre_exposure = 1.f;
             device_data.exposure_buffer_gpu = nullptr;
-            device_data.exposure_buffers_cpu[0] = nullptr;
-            device_data.exposure_buffers_cpu[1] = nullptr;
-            device_data.exposure_buffers_cpu_index = 0;
+            device_data.exposure_buffers_cpu.reset();
             device_data.exposure_buffer_rtv = nullptr;
 #if 0 // This would actually unload the DLSS DLL and all, making the game hitch, so it's better to just keep it in memory
             NGX::DLSS::Deinit(device_data.dlss_sr_handle);
@@ -3418,6 +3897,25 @@ namespace
       device_data.cb_luma_frame_settings_dirty = true; // Force re-upload the frame settings buffer at least once per frame, just to make sure to catch any user (or dev) settings changes, it should be fast enough
 #endif
 
+      // Publish the latest version of the pipelines cache for lock free readers, if it changed during this frame,
+      // and release the pipelines (cached ones, clones, and old snapshots) that were retired before all the current readers started.
+      if (device_data.pipeline_cache_snapshot_dirty)
+      {
+         const std::shared_lock lock(s_mutex_generic); // Enough to stop writers from changing the pipelines in the meantime
+         device_data.pipeline_cache_by_pipeline_handle_snapshot.publish(new std::unordered_map<uint64_t, CachedPipeline*>(device_data.pipeline_cache_by_pipeline_handle), device_data.rcu);
+         device_data.pipeline_cache_snapshot_dirty = false;
+      }
+      device_data.rcu.advance_epoch();
+
+      // Release the views of resources we haven't drawn on in a while, so the game is free to destroy them
+      device_data.custom_views_cache.trim();
+      // Destroy our own textures that haven't been re-used in a while
+      device_data.transient_textures.end_frame();
+
+#if ENABLE_HOOKS_PROFILING
+      hooks_profiler.end_frame(frame_index);
+#endif
+
       frame_index++;
    }
 
@@ -3439,6 +3937,8 @@ namespace
       ID3D11Device* native_device = (ID3D11Device*)(device->get_native());
       ID3D11DeviceContext* native_device_context = (ID3D11DeviceContext*)(cmd_list->get_native());
       auto& device_data = device->get_private_data<DeviceData>();
+      // The cached pipelines we look up (and their clones) need to stay alive until we are done drawing
+      const rcu_domain::read_scope read_scope(device_data.rcu);
 
       reshade::api::shader_stage stages = reshade::api::shader_stage::all_graphics | reshade::api::shader_stage::all_compute;
 
@@ -3452,11 +3952,12 @@ namespace
 
       bool is_custom_pass = false;
       bool updated_cbuffers = false;
+      uint32_t original_shader_roles = (uint32_t)ShaderRoleMask::None; // Roles of all the currently bound pipelines
 
       auto& cmd_list_data = cmd_list->get_private_data<CommandListData>();
 
-      const bool had_drawn_main_post_processing = device_data.has_drawn_main_post_processing;
-      const bool had_drawn_upscaling = device_data.has_drawn_upscaling;
+      const bool had_drawn_main_post_processing = device_data.frame_passes.has_drawn(FramePass::MainPostProcessing);
+      const bool had_drawn_upscaling = device_data.frame_passes.has_drawn(FramePass::Upscaling);
 
 #if DEVELOPMENT
       last_drawn_shader = "";
@@ -3467,15 +3968,15 @@ namespace
       {
          if (cmd_list_data.pipeline_state_original_compute_shader.handle != 0)
          {
-            const std::shared_lock lock(s_mutex_generic);
-            const auto pipeline_pair = device_data.pipeline_cache_by_pipeline_handle.find(cmd_list_data.pipeline_state_original_compute_shader.handle);
-            if (pipeline_pair != device_data.pipeline_cache_by_pipeline_handle.end() && pipeline_pair->second != nullptr)
+            const auto* cached_pipeline = FindCachedPipeline(device_data, cmd_list_data.pipeline_state_original_compute_shader.handle);
+            if (cached_pipeline != nullptr)
             {
-               original_shader_hashes.compute_shaders = std::unordered_set<uint32_t>(pipeline_pair->second->shader_hashes.begin(), pipeline_pair->second->shader_hashes.end());
+               original_shader_hashes.compute_shaders = std::unordered_set<uint32_t>(cached_pipeline->shader_hashes.begin(), cached_pipeline->shader_hashes.end());
 #if DEVELOPMENT
                last_drawn_shader = original_shader_hashes.compute_shaders.empty() ? "" : std::format("{:x}", *original_shader_hashes.compute_shaders.begin()); // String hash to int
 #endif //DEVELOPMENT
-               is_custom_pass = pipeline_pair->second->cloned;
+               is_custom_pass = cached_pipeline->cloned.load(std::memory_order_relaxed);
+               original_shader_roles |= cached_pipeline->roles;
                stages = reshade::api::shader_stage::compute;
             }
          }
@@ -3484,50 +3985,45 @@ namespace
       {
          if (cmd_list_data.pipeline_state_original_vertex_shader.handle != 0)
          {
-            const std::shared_lock lock(s_mutex_generic);
-            const auto pipeline_pair = device_data.pipeline_cache_by_pipeline_handle.find(cmd_list_data.pipeline_state_original_vertex_shader.handle);
-            if (pipeline_pair != device_data.pipeline_cache_by_pipeline_handle.end() && pipeline_pair->second != nullptr)
+            const auto* cached_pipeline = FindCachedPipeline(device_data, cmd_list_data.pipeline_state_original_vertex_shader.handle);
+            if (cached_pipeline != nullptr)
             {
-               original_shader_hashes.vertex_shaders = std::unordered_set<uint32_t>(pipeline_pair->second->shader_hashes.begin(), pipeline_pair->second->shader_hashes.end());
-               is_custom_pass = pipeline_pair->second->cloned;
+               original_shader_hashes.vertex_shaders = std::unordered_set<uint32_t>(cached_pipeline->shader_hashes.begin(), cached_pipeline->shader_hashes.end());
+               is_custom_pass = cached_pipeline->cloned.load(std::memory_order_relaxed);
+               original_shader_roles |= cached_pipeline->roles;
                stages = reshade::api::shader_stage::vertex;
             }
          }
 
          if (cmd_list_data.pipeline_state_original_pixel_shader.handle != 0)
          {
-            const std::shared_lock lock(s_mutex_generic);
-            const auto pipeline_pair = device_data.pipeline_cache_by_pipeline_handle.find(cmd_list_data.pipeline_state_original_pixel_shader.handle);
-            if (pipeline_pair != device_data.pipeline_cache_by_pipeline_handle.end() && pipeline_pair->second != nullptr)
+            const auto* cached_pipeline = FindCachedPipeline(device_data, cmd_list_data.pipeline_state_original_pixel_shader.handle);
+            if (cached_pipeline != nullptr)
             {
-               original_shader_hashes.pixel_shaders = std::unordered_set<uint32_t>(pipeline_pair->second->shader_hashes.begin(), pipeline_pair->second->shader_hashes.end());
+               original_shader_hashes.pixel_shaders = std::unordered_set<uint32_t>(cached_pipeline->shader_hashes.begin(), cached_pipeline->shader_hashes.end());
 #if DEVELOPMENT
                last_drawn_shader = original_shader_hashes.pixel_shaders.empty() ? "" : std::format("{:x}", *original_shader_hashes.pixel_shaders.begin()); // String hash to int
 #endif //DEVELOPMENT
-               is_custom_pass |= pipeline_pair->second->cloned;
+               is_custom_pass |= cached_pipeline->cloned.load(std::memory_order_relaxed);
+               original_shader_roles |= cached_pipeline->roles;
                stages |= reshade::api::shader_stage::pixel;
             }
          }
       }
 
 #if DEVELOPMENT
+      if (trace_running.load(std::memory_order_relaxed))
       {
-         const std::shared_lock lock_trace(s_mutex_trace);
-         if (trace_running)
+         if (is_dispatch)
          {
-            const std::shared_lock lock_generic(s_mutex_generic);
-            const std::unique_lock lock_trace_2(cmd_list_data.mutex_trace);
-            if (is_dispatch)
-            {
-               AddTraceDrawCallData(cmd_list_data.trace_draw_calls_data, device_data, native_device_context, cmd_list_data.pipeline_state_original_compute_shader.handle);
-            }
-            else
+            AddTraceDrawCallData(cmd_list_data, device_data, native_device_context, cmd_list_data.pipeline_state_original_compute_shader.handle);
+         }
+         else
+         {
+            AddTraceDrawCallData(cmd_list_data, device_data, native_device_context, cmd_list_data.pipeline_state_original_vertex_shader.handle);
+            if (cmd_list_data.pipeline_state_original_pixel_shader.handle != 0) // Somehow this can happen
             {
-               AddTraceDrawCallData(cmd_list_data.trace_draw_calls_data, device_data, native_device_context, cmd_list_data.pipeline_state_original_vertex_shader.handle);
-               if (cmd_list_data.pipeline_state_original_pixel_shader.handle != 0) // Somehow this can happen
-               {
-                  AddTraceDrawCallData(cmd_list_data.trace_draw_calls_data, device_data, native_device_context, cmd_list_data.pipeline_state_original_pixel_shader.handle);
-               }
+               AddTraceDrawCallData(cmd_list_data, device_data, native_device_context, cmd_list_data.pipeline_state_original_pixel_shader.handle);
             }
          }
       }
@@ -3535,18 +4031,23 @@ namespace
 
       if (!original_shader_hashes.Empty())
       {
-         //TODOFT3: optimize these shader searches by simply marking "CachedPipeline" with a tag on what they are (and whether they have a particular role) (also we can restrict the search to pixel shaders) upfront. And move these into their own functions. Update: we optimized this enough.
+         // The shaders roles have been determined upfront when their pipelines were created, so these are all simple bitmask tests. TODO: move these into their own functions.
+         const auto HasRole = [original_shader_roles](ShaderRoleMask role) { return (original_shader_roles & (uint32_t)role) != 0; };
+         // Shaders only have the roles of a single pass, so a draw can only ever mark one
+         const FramePass drawn_frame_pass = GetDrawnFramePass(original_shader_roles, device_data.frame_passes);
          
          // GBuffers composition
-         if (!device_data.has_drawn_composed_gbuffers && original_shader_hashes.Contains(shader_hashes_TiledShadingTiledDeferredShading))
+         if (drawn_frame_pass == FramePass::ComposedGBuffers)
          {
-            device_data.has_drawn_composed_gbuffers = true;
+            device_data.frame_passes.mark_drawn(FramePass::ComposedGBuffers);
+            MarkGPUProfilerPass(device_data, cmd_list, FramePass::ComposedGBuffers);
          }
 
          // SSR
-         if (!device_data.has_drawn_composed_gbuffers && !device_data.has_drawn_ssr && original_shader_hashes.Contains(shader_hash_DeferredShadingSSRRaytrace, reshade::api::shader_stage::pixel))
+         if (drawn_frame_pass == FramePass::SSR)
          {
-            device_data.has_drawn_ssr = true;
+            device_data.frame_passes.mark_drawn(FramePass::SSR);
+            MarkGPUProfilerPass(device_data, cmd_list, FramePass::SSR);
             // There's no need to ever skip this added render target, the performance cost is tiny
             if (is_custom_pass)
             {
@@ -3598,9 +4099,10 @@ namespace
                   texture_desc.CPUAccessFlags = 0;
                   texture_desc.MiscFlags = 0;
 
-                  device_data.ssr_diffuse_texture = nullptr;
-                  HRESULT hr = native_device->CreateTexture2D(&texture_desc, nullptr, &device_data.ssr_diffuse_texture);
-                  assert(SUCCEEDED(hr));
+                  device_data.transient_textures.release(device_data.ssr_diffuse_texture);
+                  device_data.ssr_diffuse_texture = device_data.transient_textures.acquire(native_device, texture_desc);
+                  assert(device_data.ssr_diffuse_texture.get() != nullptr);
+                  HRESULT hr;
 
                   D3D11_RENDER_TARGET_VIEW_DESC rtv_desc;
                   rtv_desc.Format = texture_desc.Format;
@@ -3659,15 +4161,16 @@ namespace
                device_data.CleanSSRResource();
             }
          }
-         if (device_data.has_drawn_ssr && !device_data.has_drawn_ssr_blend && native_device_context == device_data.ssr_command_list && is_custom_pass && (original_shader_hashes.Contains(shader_hash_PostEffectsGaussBlurBilinear, reshade::api::shader_stage::pixel) || original_shader_hashes.Contains(shader_hash_PostEffectsTextureToTextureResampled, reshade::api::shader_stage::pixel)))
+         if (device_data.frame_passes.has_drawn(FramePass::SSR) && !device_data.frame_passes.has_drawn(FramePass::SSRBlend) && native_device_context == device_data.ssr_command_list && is_custom_pass && HasRole(ShaderRoleMask::SSRBlur))
          {
             uint32_t custom_data = 1; // This value will make the SSR mip map generation and blurring shaders take choices specifically designed for SSR
             SetLumaConstantBuffers(native_device_context, device_data, stages, LumaConstantBufferType::LumaData, custom_data);
             return false;
          }
-         if (device_data.has_drawn_ssr && !device_data.has_drawn_ssr_blend && original_shader_hashes.Contains(shader_hash_DeferredShadingSSReflectionComp, reshade::api::shader_stage::pixel))
+         if (drawn_frame_pass == FramePass::SSRBlend)
          {
-            device_data.has_drawn_ssr_blend = true;
+            device_data.frame_passes.mark_drawn(FramePass::SSRBlend);
+            MarkGPUProfilerPass(device_data, cmd_list, FramePass::SSRBlend);
             device_data.ssr_command_list = nullptr;
             if (device_data.ssr_srv.get() || device_data.ssr_diffuse_srv.get())
             {
@@ -3678,9 +4181,10 @@ namespace
          }
          
          // Pre AA primary post process (HDR to SDR/HDR tonemapping, color grading, sun shafts etc)
-         if (device_data.has_drawn_composed_gbuffers && !device_data.has_drawn_tonemapping && original_shader_hashes.Contains(shader_hashes_HDRPostProcessHDRFinalScene))
+         if (drawn_frame_pass == FramePass::Tonemapping)
          {
-            device_data.has_drawn_tonemapping = true;
+            device_data.frame_passes.mark_drawn(FramePass::Tonemapping);
+            MarkGPUProfilerPass(device_data, cmd_list, FramePass::Tonemapping);
 
             // Update the DLSS pre-exposure to take the opposite value of our exposure (basically our brightness) to avoid DLSS causing additional lag when the exposure changes.
             // This way, DLSS will divide the linear buffer by this value, which would have previously been multiplied in given that TAA runs after the scene exposure is factored in (even in HDR, and it shouldn't! But moving it is too hard).
@@ -3717,11 +4221,8 @@ namespace
                   exposure_buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
                   // Create a "ring" buffer so we avoid avoid butchering the frame rate to map this texture immediately after a copy resource from the dynamic resource (shader memory writes will directly go into our mapped data, with a delay)
-                  device_data.exposure_buffers_cpu[0] = nullptr;
-                  hr = native_device->CreateBuffer(&exposure_buffer_desc, &exposure_buffer_data, &device_data.exposure_buffers_cpu[0]);
-                  ASSERT_ONCE(SUCCEEDED(hr));
-                  device_data.exposure_buffers_cpu[1] = nullptr;
-                  hr = native_device->CreateBuffer(&exposure_buffer_desc, &exposure_buffer_data, &device_data.exposure_buffers_cpu[1]);
+                  bool created = device_data.exposure_buffers_cpu.create(native_device, exposure_buffer_desc, &exposure_buffer_data);
+                  ASSERT_ONCE(created);
 
                   D3D11_RENDER_TARGET_VIEW_DESC exposure_buffer_rtv_desc;
                   exposure_buffer_rtv_desc.Format = DXGI_FORMAT::DXGI_FORMAT_R32_FLOAT; // NOTE: this would probably be fine as FP16 too
@@ -3762,7 +4263,7 @@ namespace
                com_ptr<ID3D11PixelShader> ps;
                native_device_context->PSGetShader(&ps, nullptr, 0);
 
-               bool has_sunshafts = original_shader_hashes.Contains(shader_hashes_HDRPostProcessHDRFinalScene_Sunshafts); // These shaders use a different cbuffer layout
+               bool has_sunshafts = HasRole(ShaderRoleMask::HDRPostProcessHDRFinalScene_Sunshafts); // These shaders use a different cbuffer layout
                SetLumaConstantBuffers(native_device_context, device_data, stages, LumaConstantBufferType::LumaData, has_sunshafts);
 
                // Draw the exposure
@@ -3771,33 +4272,29 @@ namespace
                native_device_context->OMSetRenderTargets(1, &render_target_view_const, nullptr);
                native_device_context->Draw(3, 0);
 
-               // Copy it back as CPU buffer and read+store it
-               native_device_context->CopyResource(device_data.exposure_buffers_cpu[device_data.exposure_buffers_cpu_index].get(), device_data.exposure_buffer_gpu.get());
-
-               device_data.exposure_buffers_cpu_index = (device_data.exposure_buffers_cpu_index + 1) % 2; // Ping Point between 0 and 1
-
                float scene_exposure = device_data.dlss_scene_pre_exposure; // 1 by default
-               // Read back from the previous frame "ring buffer" (it's fine!). In the first frame this would have a value of 1.
-               // Note: this is possibly some frames behind, but has no performance hit and it's fine as it is for the use we make of it
-               D3D11_MAPPED_SUBRESOURCE mapped_exposure;
-               // We use the "D3D11_MAP_FLAG_DO_NOT_WAIT" flag just for extra safety, the exposure being wrong if preferable to a frame rate dip. It'd throw an error anyway
-               HRESULT hr = texture_recreated ? -1 : native_device_context->Map(device_data.exposure_buffers_cpu[device_data.exposure_buffers_cpu_index].get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped_exposure);
-               // TODO: in case this assert failed often enough, make ~4 buffers and read the more recent one that isn't write locked
-               ASSERT_ONCE(texture_recreated || SUCCEEDED(hr)); // It seems like this rarely happens with a ring buffer as we always wait one whole frame, though if necessary, we could increase the ring buffer and read the oldest texture that is available
-               if (SUCCEEDED(hr))
-               {
+               // Read back the most recent exposure the GPU already finished writing from the "ring buffer" (it's fine!), before queueing this frame's one, which couldn't have been completed yet.
+               // In the first frame(s) there'd be none, and we'd keep the value of 1.
+               // Note: this is possibly some frames behind, but has no performance hit and it's fine as it is for the use we make of it.
+               // Mapping never waits, the exposure being a bit outdated is preferable to a frame rate dip.
+               float read_back_exposure;
+               uint32_t exposure_readback_latency;
+               if (!texture_recreated && device_data.exposure_buffers_cpu.read(native_device_context, &read_back_exposure, sizeof(read_back_exposure), frame_index, exposure_readback_latency))
+               {
+                  device_data.exposure_readback_latency = exposure_readback_latency;
                   // Depending on "DLSS_RELATIVE_PRE_EXPOSURE" this is either the relative exposure (compared to the average expected exposure value) or raw final exposure
-                  scene_exposure = *((float*)mapped_exposure.pData);
+                  scene_exposure = read_back_exposure;
                   if (std::isinf(scene_exposure) || std::isnan(scene_exposure) || scene_exposure <= 0.f)
                   {
                      scene_exposure = 1.f;
                   }
-                  native_device_context->Unmap(device_data.exposure_buffers_cpu[device_data.exposure_buffers_cpu_index].get(), 0);
-                  mapped_exposure = {}; // Null just for clarity
                }
 
+               // Copy it back as CPU buffer (it will be read in one of the next frames)
+               device_data.exposure_buffers_cpu.push(native_device_context, device_data.exposure_buffer_gpu.get(), frame_index);
+
                // Force an exposure of 1 if we are resetting DLSS, as the value from the previous frame might not be correct anymore
-               bool reset_dlss = device_data.force_reset_dlss_sr || !device_data.has_drawn_main_post_processing_previous || (device_data.has_drawn_motion_blur_previous && !device_data.has_drawn_motion_blur);
+               bool reset_dlss = device_data.force_reset_dlss_sr || !device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing) || (device_data.frame_passes.has_drawn_previous(FramePass::MotionBlur) && !device_data.frame_passes.has_drawn(FramePass::MotionBlur));
                if (reset_dlss)
                {
                   scene_exposure = 1.f;
@@ -3835,15 +4332,17 @@ namespace
          
          // Motion Blur
          // Note: this doesn't always run, it's based on a user setting!
-         if (device_data.has_drawn_composed_gbuffers && !device_data.has_drawn_motion_blur && original_shader_hashes.Contains(shader_hashes_MotionBlur))
+         if (drawn_frame_pass == FramePass::MotionBlur)
          {
-            device_data.has_drawn_motion_blur = true;
+            device_data.frame_passes.mark_drawn(FramePass::MotionBlur);
+            MarkGPUProfilerPass(device_data, cmd_list, FramePass::MotionBlur);
          }
          
          // SSAO
-         if (!device_data.has_drawn_composed_gbuffers && !device_data.has_drawn_ssao && original_shader_hashes.Contains(shader_hashes_DirOccPass))
+         if (drawn_frame_pass == FramePass::SSAO)
          {
-            device_data.has_drawn_ssao = true;
+            device_data.frame_passes.mark_drawn(FramePass::SSAO);
+            MarkGPUProfilerPass(device_data, cmd_list, FramePass::SSAO);
             if (is_custom_pass && GetShaderDefineCompiledNumericalValue(SSAO_TYPE_HASH) >= 1) // If using GTAO
             {
                uint2 gtao_edges_target_resolution = { (UINT)device_data.output_resolution.x, (UINT)device_data.output_resolution.y }; // Note that the swapchain resolution can end up being changed with a delay? Or are we somehow missing resize events?
@@ -3895,9 +4394,10 @@ namespace
                   texture_desc.CPUAccessFlags = 0;
                   texture_desc.MiscFlags = 0;
 
-                  device_data.gtao_edges_texture = nullptr;
-                  HRESULT hr = native_device->CreateTexture2D(&texture_desc, nullptr, &device_data.gtao_edges_texture);
-                  assert(SUCCEEDED(hr));
+                  device_data.transient_textures.release(device_data.gtao_edges_texture);
+                  device_data.gtao_edges_texture = device_data.transient_textures.acquire(native_device, texture_desc);
+                  assert(device_data.gtao_edges_texture.get() != nullptr);
+                  HRESULT hr;
 
                   D3D11_RENDER_TARGET_VIEW_DESC rtv_desc;
                   rtv_desc.Format = texture_desc.Format;
@@ -3941,9 +4441,10 @@ namespace
                device_data.CleanGTAOResource();
             }
          }
-         if (device_data.has_drawn_ssao && !device_data.has_drawn_ssao_denoise && original_shader_hashes.Contains(shader_hashes_SSDO_Blur))
+         if (drawn_frame_pass == FramePass::SSAODenoise)
          {
-            device_data.has_drawn_ssao_denoise = true;
+            device_data.frame_passes.mark_drawn(FramePass::SSAODenoise);
+            MarkGPUProfilerPass(device_data, cmd_list, FramePass::SSAODenoise);
             if (device_data.gtao_edges_srv.get())
             {
                ID3D11ShaderResourceView* const shader_resource_view_const = device_data.gtao_edges_srv.get();
@@ -3952,8 +4453,9 @@ namespace
          }
          
          // Post AA secondary post process (film grain, vignette, lens optics etc)
-         if (device_data.has_drawn_composed_gbuffers && !device_data.has_drawn_main_post_processing && original_shader_hashes.Contains(shader_hashes_PostAAComposites))
+         if (drawn_frame_pass == FramePass::MainPostProcessing)
          {
+            MarkGPUProfilerPass(device_data, cmd_list, FramePass::MainPostProcessing);
             uint32_t custom_data = 0;
 
             // Do lens distortion just before the post AA composition, which draws film grain and other screen space effects
@@ -4053,9 +4555,10 @@ namespace
                      texture_desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
                   }
 
-                  device_data.lens_distortion_texture = nullptr;
-                  HRESULT hr = native_device->CreateTexture2D(&texture_desc, nullptr, &device_data.lens_distortion_texture);
-                  assert(SUCCEEDED(hr));
+                  device_data.transient_textures.release(device_data.lens_distortion_texture);
+                  device_data.lens_distortion_texture = device_data.transient_textures.acquire(native_device, texture_desc);
+                  assert(device_data.lens_distortion_texture.get() != nullptr);
+                  HRESULT hr;
 
                   D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc;
                   srv_desc.Format = texture_desc.Format;
@@ -4176,7 +4679,7 @@ namespace
                updated_cbuffers = true;
 
                // In case DLSS upscaled earlier (it does)
-               if (device_data.has_drawn_dlss_sr && device_data.prey_drs_active)
+               if (device_data.frame_passes.has_drawn(FramePass::DLSS_SR) && device_data.prey_drs_active)
                {
                   SetViewportFullscreen(native_device_context, lens_distortion_resolution);
                }
@@ -4206,12 +4709,12 @@ namespace
             }
 
             // This is the last known pass that is guaranteed to run before UI draws in
-            device_data.has_drawn_main_post_processing = true;
+            device_data.frame_passes.mark_drawn(FramePass::MainPostProcessing);
             // If DRS is not currently running, upscaling won't happen, pretend it did (it'd already be true if DLSS had run).
             // We might not want to set this flag before as we assume it to be turned to true around the time the original upscaling would have run.
             if (!device_data.prey_drs_active)
             {
-               device_data.has_drawn_upscaling = true;
+               device_data.frame_passes.mark_drawn(FramePass::Upscaling);
             }
          }
          
@@ -4219,23 +4722,24 @@ namespace
          // If DLSS is guaranteed to be running instead of SMAA 2TX, we can skip the edge detection passes of SMAA 2TX (these also run other SMAA modes but then DLSS wouldn't run with these).
          // This check might engage one frame late after DLSS engages but it doesn't matter.
          // This is particularly useful because on every boot the game rejects the TAA user config setting (seemengly due to "r_AntialiasingMode" being clamped to 3 (SMAA 2TX)), so we'd waste performance if we didn't skip the passes (we still do).
-         if (device_data.has_drawn_composed_gbuffers && !device_data.has_drawn_main_post_processing && original_shader_hashes.Contains(shader_hashes_SMAA_EdgeDetection) && device_data.dlss_sr && !device_data.dlss_sr_suppressed && device_data.prey_taa_detected && device_data.cloned_pipeline_count != 0)
+         if (device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers) && !device_data.frame_passes.has_drawn(FramePass::MainPostProcessing) && HasRole(ShaderRoleMask::SMAA_EdgeDetection) && device_data.dlss_sr && !device_data.dlss_sr_suppressed && device_data.prey_taa_detected && device_data.cloned_pipeline_count != 0)
          {
             return true;
          }
          
          // Vanilla upscaling
-         if (device_data.has_drawn_composed_gbuffers && !had_drawn_upscaling)
+         if (device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers) && !had_drawn_upscaling)
          {
             // Viewport is already fullscreen for this pass
-            if (original_shader_hashes.Contains(shader_hash_PostAAUpscaleImage, reshade::api::shader_stage::pixel))
+            if (drawn_frame_pass == FramePass::Upscaling)
             {
-               device_data.has_drawn_upscaling = true;
-               assert(device_data.has_drawn_main_post_processing && device_data.prey_drs_active);
+               device_data.frame_passes.mark_drawn(FramePass::Upscaling);
+               MarkGPUProfilerPass(device_data, cmd_list, FramePass::Upscaling);
+               assert(device_data.frame_passes.has_drawn(FramePass::MainPostProcessing) && device_data.prey_drs_active);
             }
             // Between DLSS SR and upscaling, force the viewport to the full render target resolution at all times, because we upscaled early.
             // Usually this matches the swapchain output resolution, but some lens optics passes actually draw on textures with a different resolution (independently of the game render/output res).
-            else if (device_data.has_drawn_dlss_sr && device_data.prey_drs_active)
+            else if (device_data.frame_passes.has_drawn(FramePass::DLSS_SR) && device_data.prey_drs_active)
             {
                SetViewportFullscreen(native_device_context);
             }
@@ -4243,7 +4747,7 @@ namespace
 
          // Native TAA
          // This pass always runs before our lens distortion, so mark the lens distortion RTV as found here to avoid having to find it again later
-         if (device_data.has_drawn_composed_gbuffers && cb_luma_frame_settings.LensDistortion && original_shader_hashes.Contains(shader_hashes_PostAA) && device_data.cloned_pipeline_count != 0 && device_data.lens_distortion_pixel_shader.get())
+         if (device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers) && cb_luma_frame_settings.LensDistortion && HasRole(ShaderRoleMask::PostAA) && device_data.cloned_pipeline_count != 0 && device_data.lens_distortion_pixel_shader.get())
          {
             com_ptr<ID3D11RenderTargetView> rtv;
             native_device_context->OMGetRenderTargets(1, &rtv, nullptr);
@@ -4308,7 +4812,7 @@ namespace
          // after there's a "composition" pass (film grain, sharpening, ...) and then an optional upscale pass, both of these are too late for DLSS to run.
          // 
          // Don't even try to run DLSS if we have no custom shaders loaded, we need them for DLSS to work properly (it might somewhat work even without them, but it's untested and unneeded)
-         if (device_data.has_drawn_composed_gbuffers && is_custom_pass && device_data.dlss_sr && !device_data.dlss_sr_suppressed && original_shader_hashes.Contains(shader_hashes_PostAA_TAA))
+         if (device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers) && is_custom_pass && device_data.dlss_sr && !device_data.dlss_sr_suppressed && HasRole(ShaderRoleMask::PostAA_TAA))
          {
             // TODO: add DLSS transparency mask (e.g. glass, decals, emissive) by caching the g-buffers before and after transparent stuff draws near the end?
             // TODO: add DLSS bias mask (to ignore animated textures) by marking up some shaders(materials)/textures hashes with it? DLSS is smart enough to not really need that
@@ -4512,9 +5016,9 @@ namespace
                      // We assume the conditions of this texture (and its render target view) changing are the same as "dlss_output_changed"
                      if (!device_data.dlss_motion_vectors.get() || dlss_motion_vectors_changed)
                      {
-                        device_data.dlss_motion_vectors = nullptr; // Make sure we discard the previous one
-                        hr = native_device->CreateTexture2D(&object_velocity_texture_desc, nullptr, &device_data.dlss_motion_vectors);
-                        ASSERT_ONCE(SUCCEEDED(hr));
+                        device_data.transient_textures.release(device_data.dlss_motion_vectors); // Make sure we discard the previous one
+                        device_data.dlss_motion_vectors = device_data.transient_textures.acquire(native_device, object_velocity_texture_desc);
+                        ASSERT_ONCE(device_data.dlss_motion_vectors.get() != nullptr);
 
                         D3D11_RENDER_TARGET_VIEW_DESC object_velocity_render_target_view_desc;
                         render_target_views[0]->GetDesc(&object_velocity_render_target_view_desc);
@@ -4542,7 +5046,7 @@ namespace
                   // Reset DLSS history if we did not draw motion blur (and we previously did). Based on CryEngine source code, mb is skipped on the first frame after scene cuts, so we want to re-use that information (this works even if MB was disabled).
                   // Reset DLSS history if for one frame we had stopped tonemapping. This might include some scene cuts, but also triggers when entering full screen UI menus or videos and then leaving them (it shouldn't be a problem).
                   // Reset DLSS history if the output resolution or format changed (just an extra safety mechanism, it might not actually be needed).
-                  bool reset_dlss = device_data.force_reset_dlss_sr || dlss_output_changed || !device_data.has_drawn_main_post_processing_previous || (device_data.has_drawn_motion_blur_previous && !device_data.has_drawn_motion_blur);
+                  bool reset_dlss = device_data.force_reset_dlss_sr || dlss_output_changed || !device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing) || (device_data.frame_passes.has_drawn_previous(FramePass::MotionBlur) && !device_data.frame_passes.has_drawn(FramePass::MotionBlur));
                   device_data.force_reset_dlss_sr = false;
 
                   uint32_t render_width_dlss = std::lrintf(device_data.render_resolution.x);
@@ -4569,9 +5073,10 @@ namespace
 
                   // There doesn't seem to be a need to restore the DX state to whatever we had before (e.g. render targets, cbuffers, samplers, UAVs, texture shader resources, viewport, scissor rect, ...), CryEngine always sets everything it needs again for every pass.
                   // DLSS internally keeps its own frames history, we don't need to do that ourselves (by feeding in an output buffer that was the previous frame's output, though we do have that if needed, it should be in ps_shader_resources[1]).
+                  MarkGPUProfilerPass(device_data, cmd_list, FramePass::DLSS_SR);
                   if (NGX::DLSS::Draw(device_data.dlss_sr_handle, native_device_context, device_data.dlss_output_color.get(), source_color.get(), device_data.dlss_motion_vectors.get(), depth_buffer.get(), device_data.dlss_exposure.get(), dlss_pre_exposure, projection_jitters.x, projection_jitters.y, reset_dlss, render_width_dlss, render_height_dlss))
                   {
-                     device_data.has_drawn_dlss_sr = true;
+                     device_data.frame_passes.mark_drawn(FramePass::DLSS_SR);
                   }
 
                   // Fully reset the state of the RTs given that CryEngine is very delicate with it and uses some push and pop technique (simply resetting caching and resetting the first RT seemed fine for DLSS in case optimization is needed).
@@ -4579,7 +5084,7 @@ namespace
                   ID3D11RenderTargetView* const* rtvs_const = (ID3D11RenderTargetView**)std::addressof(render_target_views[0]);
                   native_device_context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, rtvs_const, depth_stencil_view.get());
 
-                  if (device_data.has_drawn_dlss_sr)
+                  if (device_data.frame_passes.has_drawn(FramePass::DLSS_SR))
                   {
                      if (!dlss_output_supports_uav)
                      {
@@ -4623,7 +5128,7 @@ namespace
 #if !DEVELOPMENT //TODOFT: re-enable once we are sure we replaced all the post tonemap shaders and we are done debugging the blend states (and remove "is_custom_pass" check from below)
       if (!is_custom_pass) return false;
 #else // We can't do any further checks in this case because some UI draws at the beginning of the frame (in world computers), and also sometimes the scene doesn't even draw!
-      //if (!has_drawn_composed_gbuffers) return false;
+      //if (!device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers)) return false;
 #endif // !DEVELOPMENT
 
       LumaUIData ui_data = {};
@@ -4650,7 +5155,7 @@ namespace
                paused = false;
 #endif
                // Highlight that the game is paused or that we are in a menu with no scene rendering (e.g. allows us to fully skip lens distortion on the UI, as sometimes it'd apply in loading screen menus).
-               if (paused || !device_data.has_drawn_composed_gbuffers)
+               if (paused || !device_data.frame_passes.has_drawn(FramePass::ComposedGBuffers))
                {
                   ui_data.drawing_on_swapchain = 2; //TODOFT: rename this variable, it's not appropriate anymore
                }
@@ -4661,7 +5166,7 @@ namespace
       }
 
       // No need to lock "s_mutex_reshade" for "cb_luma_frame_settings" here, it's not relevant
-      // We could use "has_drawn_composed_gbuffers" here instead of "has_drawn_main_post_processing", but then again, they should always match (pp should always be run)
+      // We could use "FramePass::ComposedGBuffers" here instead of "FramePass::MainPostProcessing", but then again, they should always match (pp should always be run)
       ui_data.background_tonemapping_amount = (cb_luma_frame_settings.DisplayMode == 1 && tonemap_ui_background && had_drawn_main_post_processing && ui_data.drawing_on_swapchain) ? tonemap_ui_background_amount : 0.0;
 
       //TODOFT: check all the scaleform hashes for new unknown blend types, we need to set the cbuffers even for UI passes that render at the beginning of the frame, because they will draw in world UI (e.g. computers)
@@ -4867,6 +5372,13 @@ namespace
       uint32_t first_vertex,
       uint32_t first_instance)
    {
+      PROFILE_HOOK(ProfiledHook::Draw);
+#if DEVELOPMENT
+      if (frame_capture.is_capturing())
+      {
+         frame_capture.write(FrameCaptureEvent::Draw, FrameCaptureDraw{ cmd_list->get_native(), vertex_count, instance_count, first_vertex, 0, first_instance, 0 });
+      }
+#endif
       ShaderHashesList original_shader_hashes;
       bool cancelled_or_replaced = OnDraw_Custom(cmd_list, false, original_shader_hashes);
 #if DEVELOPMENT
@@ -4910,6 +5422,13 @@ namespace
       int32_t vertex_offset,
       uint32_t first_instance)
    {
+      PROFILE_HOOK(ProfiledHook::DrawIndexed);
+#if DEVELOPMENT
+      if (frame_capture.is_capturing())
+      {
+         frame_capture.write(FrameCaptureEvent::DrawIndexed, FrameCaptureDraw{ cmd_list->get_native(), index_count, instance_count, first_index, vertex_offset, first_instance, 0 });
+      }
+#endif
       ShaderHashesList original_shader_hashes;
       bool cancelled_or_replaced = OnDraw_Custom(cmd_list, false, original_shader_hashes);
 #if DEVELOPMENT
@@ -4945,6 +5464,13 @@ namespace
 
    bool OnDispatch(reshade::api::command_list* cmd_list, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
    {
+      PROFILE_HOOK(ProfiledHook::Dispatch);
+#if DEVELOPMENT
+      if (frame_capture.is_capturing())
+      {
+         frame_capture.write(FrameCaptureEvent::Dispatch, FrameCaptureDispatch{ cmd_list->get_native(), group_count_x, group_count_y, group_count_z, 0 });
+      }
+#endif
       ShaderHashesList original_shader_hashes;
       bool cancelled_or_replaced = OnDraw_Custom(cmd_list, true, original_shader_hashes);
 #if DEVELOPMENT
@@ -4978,6 +5504,7 @@ namespace
       uint32_t draw_count,
       uint32_t stride)
    {
+      PROFILE_HOOK(ProfiledHook::DrawOrDispatchIndirect);
       ASSERT_ONCE(false); // Not used by Prey (DrawIndexedInstancedIndirect() and DrawInstancedIndirect() weren't used in CryEngine)
       // NOTE: according to ShortFuse, this can be "reshade::api::indirect_command::unknown" too, so we'd need to fall back on checking what shader is bound to know if this is a compute shader draw
       bool is_dispatch = type == reshade::api::indirect_command::dispatch || type == reshade::api::indirect_command::dispatch_mesh || type == reshade::api::indirect_command::dispatch_rays;
@@ -4985,109 +5512,6 @@ namespace
       return OnDraw_Custom(cmd_list, is_dispatch, original_shader_hashes);
    }
 
-   // TODO: use the native ReShade sampler desc instead? It's not really necessary
-   // Expects "s_mutex_samplers" to already be locked
-   com_ptr<ID3D11SamplerState> CreateCustomSampler(const DeviceData& device_data, ID3D11Device* device, D3D11_SAMPLER_DESC desc)
-   {
-#if !DEVELOPMENT
-      if (desc.Filter == D3D11_FILTER_ANISOTROPIC || desc.Filter == D3D11_FILTER_COMPARISON_ANISOTROPIC)
-      {
-         desc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
-#if 1 // Without bruteforcing the offset, many textures (e.g. decals) stay blurry. Based on "samplers_upgrade_mode" 5.
-         desc.MipLODBias = std::clamp(device_data.texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX); // Setting this out of range (~ +/- 16) will make DX11 crash
-#else
-         desc.MipLODBias = std::clamp(desc.MipLODBias + device_data.texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX); // Setting this out of range (~ +/- 16) will make DX11 crash
-#endif
-      }
-      else
-      {
-         return nullptr;
-      }
-#else
-      if (samplers_upgrade_mode <= 0)
-         return nullptr;
-
-      // Prey's CryEngine only uses:
-      // D3D11_FILTER_ANISOTROPIC
-      // D3D11_FILTER_COMPARISON_ANISOTROPIC
-      // D3D11_FILTER_MIN_MAG_MIP_POINT
-      // D3D11_FILTER_COMPARISON_MIN_MAG_MIP_POINT
-      // D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT
-      // D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT
-      // D3D11_FILTER_MIN_MAG_MIP_LINEAR
-      // D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR
-
-      // This could theoretically make some textures that have moire patters, or were purposely blurry, "worse", but the positives of upgrading still outweight the negatives.
-      // Note that this might not fix all cases because there's still "ID3D11DeviceContext::SetResourceMinLOD()" and textures that are blurry for other reasons
-      // because they use other types of samplers (unfortunately it seems like some decals use "D3D11_FILTER_MIN_MAG_MIP_LINEAR").
-      // Note that the AF on different textures in the game seems is possibly linked with other graphics settings than just AF (maybe textures or objects quality).
-      if (desc.Filter == D3D11_FILTER_ANISOTROPIC || desc.Filter == D3D11_FILTER_COMPARISON_ANISOTROPIC)
-      {
-         // Note: this doesn't seem to affect much
-         if (samplers_upgrade_mode == 1)
-         {
-            desc.MaxAnisotropy = min(desc.MaxAnisotropy * 2, D3D11_REQ_MAXANISOTROPY);
-         }
-         else if (samplers_upgrade_mode == 2)
-         {
-            desc.MaxAnisotropy = min(desc.MaxAnisotropy * 4, D3D11_REQ_MAXANISOTROPY);
-         }
-         else if (samplers_upgrade_mode >= 3)
-         {
-            desc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
-         }
-         // Note: this is the main ingredient in making textures less blurry
-         if (samplers_upgrade_mode == 4 && desc.MipLODBias <= 0.f)
-         {
-            desc.MipLODBias = std::clamp(desc.MipLODBias + device_data.texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX);
-         }
-         else if (samplers_upgrade_mode >= 5)
-         {
-            desc.MipLODBias = std::clamp(device_data.texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX);
-         }
-         // Note: this never seems to affect anything in Prey
-         if (samplers_upgrade_mode >= 6)
-         {
-            desc.MinLOD = min(desc.MinLOD, 0.f);
-         }
-      }
-      else if ((desc.Filter == D3D11_FILTER_MIN_MAG_MIP_LINEAR && samplers_upgrade_mode_2 >= 1) // This is the most common (main/only) format being used other than AF
-         || (desc.Filter == D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR && samplers_upgrade_mode_2 >= 2)
-         || (desc.Filter == D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT && samplers_upgrade_mode_2 >= 3)
-         || (desc.Filter == D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT && samplers_upgrade_mode_2 >= 4)
-         || (desc.Filter == D3D11_FILTER_MIN_MAG_MIP_POINT && samplers_upgrade_mode_2 >= 5)
-         || (desc.Filter == D3D11_FILTER_COMPARISON_MIN_MAG_MIP_POINT && samplers_upgrade_mode_2 >= 6))
-      {
-         //TODOFT: research. Force this on to see how it behaves. Doesn't work, it doesn't really help any further with (e.g.) blurry decal textures
-         // Note: this doesn't seem to do anything really, it doesn't help with the occasional blurry texture (probably because all samplers that needed anisotropic already had it set)
-         if (samplers_upgrade_mode >= 7)
-         {
-            desc.Filter == (desc.ComparisonFunc != D3D11_COMPARISON_NEVER && samplers_upgrade_mode == 7) ? D3D11_FILTER_COMPARISON_ANISOTROPIC : D3D11_FILTER_ANISOTROPIC;
-            desc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
-         }
-         // Note: changing the lod bias of non anisotropic filters makes reflections (cubemap samples?) a lot more specular (shiny) in Prey, so it's best avoided (it can look better is some screenshots, but it's likely not intended).
-         // Even if we only fix up textures that didn't have a positive bias, we run into the same problem.
-         if (samplers_upgrade_mode == 4 && desc.MipLODBias <= 0.f)
-         {
-            desc.MipLODBias = std::clamp(desc.MipLODBias + device_data.texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX);
-         }
-         else if (samplers_upgrade_mode >= 5)
-         {
-            desc.MipLODBias = std::clamp(device_data.texture_mip_lod_bias_offset, D3D11_MIP_LOD_BIAS_MIN, D3D11_MIP_LOD_BIAS_MAX);
-         }
-         if (samplers_upgrade_mode >= 6)
-         {
-            desc.MinLOD = min(desc.MinLOD, 0.f);
-         }
-      }
-#endif // !DEVELOPMENT
-
-      com_ptr<ID3D11SamplerState> sampler;
-      device->CreateSamplerState(&desc, &sampler);
-      ASSERT_ONCE(sampler != nullptr);
-      return sampler;
-   }
-
    void OnInitSampler(reshade::api::device* device, const reshade::api::sampler_desc& desc, reshade::api::sampler sampler)
    {
       if (sampler == 0)
@@ -5116,482 +5540,82 @@ namespace
          || desc.filter == reshade::api::filter_mode::compare_min_mag_linear_mip_point); // Doesn't seem to happen
 #endif // DEVELOPMENT
 
-      ID3D11SamplerState* native_sampler = reinterpret_cast<ID3D11SamplerState*>(sampler.handle);
-
-      std::shared_lock shared_lock_samplers(s_mutex_samplers);
-
       // Custom samplers lifetime should never be tracked by ReShade, otherwise we'd recursively create custom samplers out of custom samplers
       // (it's unclear if CryEngine somehow does anything with these samplers or if ReShade captures our own samplers creation events (it probably does as we create them directly through the DX native funcs))
-      for (const auto& samplers_handle : device_data.custom_sampler_by_original_sampler)
+      if (device_data.custom_samplers.is_custom_sampler(sampler.handle))
       {
-         for (const auto& custom_sampler_handle : samplers_handle.second)
-         {
-            ID3D11SamplerState* native_sampler = reinterpret_cast<ID3D11SamplerState*>(sampler.handle);
-            if (custom_sampler_handle.second.get() == native_sampler)
-            {
-               return;
-            }
-         }
+         return;
       }
 
-      D3D11_SAMPLER_DESC native_desc;
-      native_sampler->GetDesc(&native_desc);
-      shared_lock_samplers.unlock(); // This is fine!
-      std::unique_lock unique_lock_samplers(s_mutex_samplers);
-      device_data.custom_sampler_by_original_sampler[sampler.handle][device_data.texture_mip_lod_bias_offset] = CreateCustomSampler(device_data, (ID3D11Device*)device->get_native(), native_desc);
+      device_data.custom_samplers.add(sampler.handle, &CreateCustomSamplerFromOriginal);
    }
 
    void OnDestroySampler(reshade::api::device* device, reshade::api::sampler sampler)
    {
       auto& device_data = device->get_private_data<DeviceData>();
       // This only seems to happen when the game shuts down in Prey (as any destroy callback, it can be called from an arbitrary thread, but that's fine)
-      const std::unique_lock lock_samplers(s_mutex_samplers);
 
 #if DEVELOPMENT //TODOFT: delete, already in "OnInitSampler()", so this shouldn't be able to ever happen
-      ID3D11SamplerState* native_sampler = reinterpret_cast<ID3D11SamplerState*>(sampler.handle);
-      // Custom samplers lifetime should never be tracked by ReShade (is this innoucuous? remove it from the list in case it happened)
-      for (const auto& samplers_handle : device_data.custom_sampler_by_original_sampler)
-      {
-         for (const auto& custom_sampler_handle : samplers_handle.second)
-         {
-            ASSERT_ONCE(custom_sampler_handle.second.get() != native_sampler);
-         }
-      }
-#endif
-
-      device_data.custom_sampler_by_original_sampler.erase(sampler.handle);
-   }
-
-#if DEVELOPMENT
-   void OnInitResource(
-      reshade::api::device* device,
-      const reshade::api::resource_desc& desc,
-      const reshade::api::subresource_data* initial_data,
-      reshade::api::resource_usage initial_state,
-      reshade::api::resource resource)
-   {
-      auto& device_data = device->get_private_data<DeviceData>();
-      const std::unique_lock lock(device_data.mutex);
-      device_data.resources.emplace(resource.handle);
-   }
-
-   void OnDestroyResource(reshade::api::device* device, reshade::api::resource resource)
-   {
-      auto& device_data = device->get_private_data<DeviceData>();
-      const std::unique_lock lock(device_data.mutex);
-      device_data.resources.erase(resource.handle);
-   }
-
-   void OnInitResourceView(
-      reshade::api::device* device,
-      reshade::api::resource resource,
-      reshade::api::resource_usage usage_type,
-      const reshade::api::resource_view_desc& desc,
-      reshade::api::resource_view view)
-   {
-      auto& device_data = device->get_private_data<DeviceData>();
-      const std::unique_lock lock(device_data.mutex);
-      if (device_data.resource_views.contains(view.handle))
-      {
-         if (resource.handle == 0)
-         {
-            device_data.resource_views.erase(view.handle);
-            return;
-         }
-      }
-      if (resource.handle != 0)
-      {
-         device_data.resource_views.emplace(view.handle, resource.handle);
-      }
-   }
-
-   void OnDestroyResourceView(reshade::api::device* device, reshade::api::resource_view view)
-   {
-      auto& device_data = device->get_private_data<DeviceData>();
-      const std::unique_lock lock(device_data.mutex);
-      device_data.resource_views.erase(view.handle);
-   }
-
-   std::thread::id global_cbuffer_thread_id; //TODOFT: move
-#endif // DEVELOPMENT
-
-   // Call this after reading the global cbuffer (index 13) memory (from CPU or GPU memory). This seemengly only happens in one thread.
-   // This will update the "cb_per_view_global" values if the ptr is found to be the right type of buffer (and return true in that case),
-   // correct some of its values, and cache information for other usage.
-   // 
-   // An alternative way of approaching this would be to cache all the address of buffers that are ever filled up through ::Map() calls,
-   // then store a copy of each of their instances, and when one of these buffers is set to a shader stage, re-set the same cbuffer with our
-   // modified and fixed up data. That is a bit slower but it would be more safe, as it would guarantee us 100% that the buffer we are changing is cbuffer 13.
-   // If we were looking for the value of only one buffer in particular, we can simply store the buffer pointers from the DX state in a specific draw call, and then check for following map calls to it.
-   bool UpdateGlobalCBuffer(const void* global_buffer_data_ptr, reshade::api::device* device)
-   {
-      const CBPerViewGlobal& global_buffer_data = *((const CBPerViewGlobal*)global_buffer_data_ptr);
-
-      //TODOFT: optimize and verify?
-      // Is this the cbuffer we are looking for?
-      // Note that even if it was, in the menu a lot of these parameters are uninitialized (usually zeroed around, with matrices being identity).
-      // This check overall is a bit crazy, but there's ~0% chance that it will fail and accidentally use a buffer that isn't the global one (cb13)
-      bool is_valid_cbuffer = true
-         && global_buffer_data.CV_AnimGenParams.x >= 0.f && global_buffer_data.CV_AnimGenParams.y >= 0.f && global_buffer_data.CV_AnimGenParams.z >= 0.f && global_buffer_data.CV_AnimGenParams.w >= 0.f // These are either all 4 0 or all 4 > 0
-         && global_buffer_data.CV_CameraRightVector.w == 0.f
-         && global_buffer_data.CV_CameraFrontVector.w == 0.f
-         && global_buffer_data.CV_CameraUpVector.w == 0.f
-         && global_buffer_data.CV_ScreenSize.x > 0.f && global_buffer_data.CV_ScreenSize.y > 0.f && global_buffer_data.CV_ScreenSize.z > 0.f && global_buffer_data.CV_ScreenSize.w > 0.f
-         && AlmostEqual(global_buffer_data.CV_ScreenSize.x, global_buffer_data.CV_HPosScale.x * (0.5f / global_buffer_data.CV_ScreenSize.z), 0.5f) && AlmostEqual(global_buffer_data.CV_ScreenSize.y, global_buffer_data.CV_HPosScale.y * (0.5f / global_buffer_data.CV_ScreenSize.w), 0.5f)
-         && global_buffer_data.CV_HPosScale.x > 0.f && global_buffer_data.CV_HPosScale.y > 0.f && global_buffer_data.CV_HPosScale.z > 0.f && global_buffer_data.CV_HPosScale.w > 0.f
-         && global_buffer_data.CV_HPosScale.x <= 1.f && global_buffer_data.CV_HPosScale.y <= 1.f && global_buffer_data.CV_HPosScale.z <= 1.f && global_buffer_data.CV_HPosScale.w <= 1.f
-         && global_buffer_data.CV_HPosClamp.x > 0.f && global_buffer_data.CV_HPosClamp.y > 0.f && global_buffer_data.CV_HPosClamp.z > 0.f && global_buffer_data.CV_HPosClamp.w > 0.f
-         && global_buffer_data.CV_HPosClamp.x <= 1.f && global_buffer_data.CV_HPosClamp.y <= 1.f && global_buffer_data.CV_HPosClamp.z <= 1.f && global_buffer_data.CV_HPosClamp.w <= 1.f
-         //&& mathMatrixAlmostEqual(global_buffer_data.CV_InvViewProj.GetTransposed(), global_buffer_data.CV_ViewProjMatr.GetTransposed().GetInverted(), 0.001f) // These checks fail, they need more investigation
-         //&& mathMatrixAlmostEqual(global_buffer_data.CV_InvViewMatr.GetTransposed(), global_buffer_data.CV_ViewMatr.GetTransposed().GetInverted(), 0.001f)
-         && (mathMatrixIsProjection(global_buffer_data.CV_PrevViewProjMatr.GetTransposed()) || mathMatrixIsIdentity(global_buffer_data.CV_PrevViewProjMatr)) // For shadow projection "CV_PrevViewProjMatr" is actually what its names says it is, instead of being the current projection matrix as in other passes
-         && (mathMatrixIsProjection(global_buffer_data.CV_PrevViewProjNearestMatr.GetTransposed()) || mathMatrixIsIdentity(global_buffer_data.CV_PrevViewProjNearestMatr))
-         && global_buffer_data.CV_SunLightDir.w == 1.f
-         //&& global_buffer_data.CV_SunColor.w == 1.f // This is only approximately 1 (maybe not guaranteed, sometimes it's 0)
-         && global_buffer_data.CV_SkyColor.w == 1.f
-         && global_buffer_data.CV_DecalZFightingRemedy.w == 0.f
-         && global_buffer_data.CV_PADDING0 == 0.f && global_buffer_data.CV_PADDING1 == 0.f
-         ;
-
-#if DEVELOPMENT && 0
-      cb_per_view_globals.emplace_back(global_buffer_data);
-      cb_per_view_globals_last_drawn_shader.emplace_back(last_drawn_shader); // The shader hash could we unspecified if we didn't replace the shader
-#endif // DEVELOPMENT
-
-      if (!is_valid_cbuffer)
-      {
-         return false;
-      }
-
-      //if (is_valid_cbuffer)
-      {
-#if 0 // This happens, but it's not a problem
-         char* global_buffer_data_ptr_cast = (char*)global_buffer_data_ptr;
-         // Make sure that all extra memory is zero, as an extra check. This could easily be uninitialized memory though.
-         ASSERT_ONCE(IsMemoryAllZero(&global_buffer_data_ptr_cast[sizeof(CBPerViewGlobal) - 1], CBPerViewGlobal_buffer_size - sizeof(CBPerViewGlobal)));
-#endif
-
-         ASSERT_ONCE((global_buffer_data.CV_DecalZFightingRemedy.x >= 0.9f && global_buffer_data.CV_DecalZFightingRemedy.x <= 1.f) || global_buffer_data.CV_DecalZFightingRemedy.x == 0.f);
-      }
-
-      float cb_output_resolution_x = std::round(0.5f / global_buffer_data.CV_ScreenSize.z); // Round here already as it would always meant to be integer
-      float cb_output_resolution_y = std::round(0.5f / global_buffer_data.CV_ScreenSize.w);
-
-      // Shadow maps and other things temporarily change the values in the global cbuffer,
-      // like not use inverse depth (which affects the projection matrix, and thus many other matrices?),
-      // use different render and output resolutions, etc etc.
-      // We could also base our check on "CV_ProjRatio" (x and y) and "CV_FrustumPlaneEquation" and "CV_DecalZFightingRemedy" as these are also different for alternative views.
-      // "CV_PrevViewProjMatr" is not a raw projection matrix when rendering shadow maps, so we can easily detect that.
-      // Note: we can check if the matrix is identity to detect whether we are currently in a menu (the main menu?)
-      bool is_custom_draw_version = !mathMatrixIsProjection(global_buffer_data.CV_PrevViewProjMatr.GetTransposed());
-
-      if (is_custom_draw_version)
-      {
-         return false;
-      }
-
-      auto& device_data = device->get_private_data<DeviceData>();
-
-      bool output_resolution_matches = AlmostEqual(device_data.output_resolution.x, cb_output_resolution_x, 0.5f) && AlmostEqual(device_data.output_resolution.y, cb_output_resolution_y, 0.5f);
-
-#if DEVELOPMENT
-      std::thread::id new_global_cbuffer_thread_id = std::this_thread::get_id();
-      // Make sure this cbuffer is always updated in the same thread (forever)
-      if (global_cbuffer_thread_id != std::thread::id())
-      {
-         ASSERT_ONCE(global_cbuffer_thread_id == new_global_cbuffer_thread_id);
-      }
-      global_cbuffer_thread_id = new_global_cbuffer_thread_id;
-#endif
-
-      // Copy the temporary buffer ptr into our persistent data
-      cb_per_view_global = global_buffer_data;
-
-      // Re-use the current cbuffer as the previous one if we didn't draw the scene in the frame before
-      const CBPerViewGlobal& cb_per_view_global_actual_previous = device_data.has_drawn_main_post_processing_previous ? cb_per_view_global_previous : cb_per_view_global;
-
-      auto current_projection_matrix = cb_per_view_global.CV_PrevViewProjMatr;
-      auto current_nearest_projection_matrix = cb_per_view_global.CV_PrevViewProjNearestMatr;
-
-      // Note that "prey_taa_detected" would be one frame late here, but to avoid unexpectedly replacing proj matrices, we check it anyway  (the game always starts with a fade to black, so it's fine)
-      bool replace_prev_projection_matrix = device_data.cloned_pipeline_count != 0 && ((device_data.dlss_sr && !device_data.dlss_sr_suppressed && device_data.prey_taa_detected)
-#if DEVELOPMENT || TEST
-         || GetShaderDefineCompiledNumericalValue(FORCE_MOTION_VECTORS_JITTERED_HASH) >= 1
-#else
-         || force_motion_vectors_jittered
-#endif
-         );
-
-
-      if (!device_data.has_drawn_main_post_processing_previous)
-      {
-         previous_projection_matrix = current_projection_matrix;
-         previous_nearest_projection_matrix = current_nearest_projection_matrix;
-      }
-
-      // Fix up the "previous view projection matrices" as they had wrong data in Prey,
-      // first of all, their name was "wrong", because it was meant to have the value of the previous projection matrix,
-      // not the camera/view projection matrix, and second, it was actually always based on the current one,
-      // so it would miss any changes in FOV and jitters (drastically lowering the quality of motion vectors).
-      // After tonemapping, ignore fixing up these, because they'd be jitterless and we don't have a jitterless copy (they aren't used anyway!).
-      // If in the previous frame we didn't render, we don't replace the matrix with the one from the last frame that was rendered,
-      // because there's no guaranteed that it would match.
-      // If AA is disabled, or if the current form of AA doesn't use jittered rendering, this doesn't really make a difference (but it's still better because it creates motion vectors based on the previous view matrix).
-      // We've also tried to completely remove the jitters from here and the DLSS reprojection matrix below, and disabling "NVSDK_NGX_DLSS_Feature_Flags_MVJittered" in DLSS, but it doesn't seem to help.
-      // Apparently we can also modulate the values in "CV_ViewProjMatr" etc to move the camera in game, but that would require a lot more to polish for (e.g.) a photo mode.
-      if (replace_prev_projection_matrix && !device_data.has_drawn_tonemapping && device_data.has_drawn_main_post_processing_previous)
-      {
-         cb_per_view_global.CV_PrevViewProjMatr = previous_projection_matrix;
-         cb_per_view_global.CV_PrevViewProjNearestMatr = previous_nearest_projection_matrix;
-      }
-#if DEVELOPMENT
-      // Just for test.
-      if (disable_taa_jitters)
-      {
-         current_projection_matrix.m02 = 0;
-         current_projection_matrix.m12 = 0;
-         current_nearest_projection_matrix.m02 = 0;
-         current_nearest_projection_matrix.m12 = 0;
-         cb_per_view_global.CV_PrevViewProjMatr.m02 = 0;
-         cb_per_view_global.CV_PrevViewProjMatr.m12 = 0;
-         cb_per_view_global.CV_PrevViewProjNearestMatr.m02 = 0;
-         cb_per_view_global.CV_PrevViewProjNearestMatr.m12 = 0;
-      }
-#endif // DEVELOPMENT
-
-      // Fix up the rendering scale for all passes after DLSS SR, as we upscaled before the game expected,
-      // there's only post processing passes after it anyway (and lens optics shaders don't really read cbuffer 13 (we made sure of that), but still, some of their passes use custom resolutions).
-      if (device_data.has_drawn_dlss_sr && device_data.prey_drs_active && !device_data.has_drawn_upscaling)
-      {
-         cb_per_view_global.CV_ScreenSize.x = cb_output_resolution_x;
-         cb_per_view_global.CV_ScreenSize.y = cb_output_resolution_y;
-
-         cb_per_view_global.CV_HPosScale.x = 1.f;
-         cb_per_view_global.CV_HPosScale.y = 1.f;
-         // Upgrade the ones from the previous frame too, because at this rendering phase they'd also have been full resolution, and these aren't used anyway
-         cb_per_view_global.CV_HPosScale.z = cb_per_view_global.CV_HPosScale.x;
-         cb_per_view_global.CV_HPosScale.w = cb_per_view_global.CV_HPosScale.y;
-
-         // Clamp at the last texel center (half pixel offset) at the bottom right of the rendering (which is now equal to output) resolution area.
-         // We could probably set these to 1 as well, and skip the last half texel, but that would make the behaviour different from when DRS is running.
-         // Note that usually these would be set relative to the render target viewport resolution, not source texture resolution.
-         cb_per_view_global.CV_HPosClamp.x = 1.f - cb_per_view_global.CV_ScreenSize.z;
-         cb_per_view_global.CV_HPosClamp.y = 1.f - cb_per_view_global.CV_ScreenSize.w;
-         cb_per_view_global.CV_HPosClamp.z = cb_per_view_global.CV_HPosClamp.x;
-         cb_per_view_global.CV_HPosClamp.w = cb_per_view_global.CV_HPosClamp.y;
-      }
-
-      bool render_resolution_matches = AlmostEqual(device_data.render_resolution.x, cb_per_view_global.CV_ScreenSize.x, 0.5f) && AlmostEqual(device_data.render_resolution.y, cb_per_view_global.CV_ScreenSize.y, 0.5f);
-      bool is_in_post_processing = device_data.has_drawn_composed_gbuffers || device_data.has_drawn_tonemapping || device_data.has_drawn_main_post_processing;
-
-      // Update our cached data with information from the cbuffer.
-      // After vanilla tonemapping (as soon as AA starts),
-      // camera jitters are removed from the cbuffer projection matrices, and the render resolution is also set to 100% (after the upscaling pass),
-      // so we want to ignore these cases. We stop at the gbuffer compositions draw, because that's the last know cbuffer 13 to have the perfect values we are looking for (that shader is always run, so it's reliable)!
-      // A lot of passes are drawn on scaled down render targets and the cbuffer values would have been updated to reflect that (e.g. "CV_ScreenSize"), so ignore these cases.
-      if (output_resolution_matches && (!device_data.found_per_view_globals ? true : (!render_resolution_matches && !is_in_post_processing)))
-      {
-#if DEVELOPMENT
-         static float2 local_previous_render_resolution;
-         if (!device_data.found_per_view_globals)
-         {
-            local_previous_render_resolution.x = cb_per_view_global.CV_ScreenSize.x;
-            local_previous_render_resolution.y = cb_per_view_global.CV_ScreenSize.y;
-         }
-#endif // DEVELOPMENT
-
-         //TODOFT: these have read/writes that are possibly not thread safe but they should never cause issues in actual usages of Prey
-         device_data.render_resolution.x = cb_per_view_global.CV_ScreenSize.x;
-         device_data.render_resolution.y = cb_per_view_global.CV_ScreenSize.y;
-#if 0 // They should already match and the one we have would be more accurate anyway
-         device_data.output_resolution.x = cb_output_resolution_x; // Round here already as it would always meant to be integer
-         device_data.output_resolution.y = cb_output_resolution_y;
-#endif
-
-         auto previous_prey_drs_active = device_data.prey_drs_active.load();
-         device_data.prey_drs_active = std::abs(device_data.render_resolution.x - device_data.output_resolution.x) >= 0.5f || std::abs(device_data.render_resolution.y - device_data.output_resolution.y) >= 0.5f;
-         // Make sure this doesn't change within a frame (once we found DRS in a frame, we should never "lose" it again for that frame.
-         // Ignore this when we have no shaders loaded as it would always break due to the "has_drawn_tonemapping" check failing.
-         ASSERT_ONCE(device_data.cloned_pipeline_count == 0 || !device_data.found_per_view_globals || !previous_prey_drs_active || (previous_prey_drs_active == device_data.prey_drs_active));
-
-#if DEVELOPMENT
-         // Make sure that our rendering resolution doesn't change randomly within the pipeline (it probably will, it seems to trigger during quick save loads, maybe for the very first draw call to clear buffers)
-         const float2 previous_render_resolution = local_previous_render_resolution;
-         ASSERT_ONCE(!device_data.has_drawn_main_post_processing_previous || !device_data.found_per_view_globals || !device_data.prey_drs_detected || (AlmostEqual(device_data.render_resolution.x, previous_render_resolution.x, 0.25f) && AlmostEqual(device_data.render_resolution.y, previous_render_resolution.y, 0.25f)));
-#endif // DEVELOPMENT
-
-         // Once we detect the user enabled DRS, we can't ever know it's been disabled because the game only occasionally drops to lower rendering resolutions, so we couldn't know if it was ever disabled
-         if (device_data.prey_drs_active)
-         {
-            device_data.prey_drs_detected = true;
-
-            float resolution_scale = device_data.render_resolution.y / device_data.output_resolution.y;
-            // Lower the DLSS quality mode (which might introduce a stutter, or a slight blurring of the image as it resets the history),
-            // but this will make DLSS not use DLAA and instead fall back on a quality mode that allows for a dynamic range of resolutions.
-            // This isn't the exact rend resolution DLSS will be forced to use, but the center of a range it's gonna expect.
-            // Unfortunately DLSS has a limited range of accepted resolutions per quality mode, and if you go beyond it, it fails to render (until in range again),
-            // thus, we need to make sure the automatic DRS range of Prey is within the same range!
-            // We couldn't change this resolution scale every frame as it's make DLSS stutter massively.
-            // See CryEngine "osm_fbMinScale" cvar (config), that drives the min rend res scale, the DLSS rend scale should ideally be set to the same value, but it's fine if it's above it, given it's the target "average" dynamic resolution.
-            // If CryEngine ever went below 50% render scale, we force DLSS into ultra performance mode (33%), as the range allowed by quality mode (67%) can't go below 50%. There will be a stutter (and history reset?) every time we swap back and forth, but at least it works...
-            if (resolution_scale < 0.5f - FLT_EPSILON)
-            {
-#if 1 // Unfortunately no quality mode with a res scale below 0.5 supports dynamic resolution scaling, so we are forced to change the quality mode every frame or so (or at least, every time Prey changes DRS value, which might further slow down the DRS detection mechanism...)
-               device_data.dlss_render_resolution_scale = resolution_scale;
-#else // If we do this, DLSS would fail if any resolution that didn't exactly match 33% render scale was used by the game
-               device_data.dlss_render_resolution_scale = 1.f / 3.f;
-#endif
-            }
-            else
-            {
-               // This should pick quality or balanced mode, with a range from 100% to 50% resolution scale
-               device_data.dlss_render_resolution_scale = 1.f / 1.5f;
-            }
-         }
-         // Reset to DLAA and try again (once), given that we can't go from a 1/3 to a 1 rend scale (e.g. in case DRS was disabled in the menu)
-         else if (device_data.dlss_sr_suppressed && device_data.dlss_render_resolution_scale != 1.f)
-         {
-            device_data.dlss_render_resolution_scale = 1.f;
-            device_data.dlss_sr_suppressed = false;
-         }
-
-         // NOTE: we could just save the first one we found, it should always be jittered and "correct".
-         projection_matrix = current_projection_matrix;
-         nearest_projection_matrix = current_nearest_projection_matrix;
-
-         const auto projection_jitters_copy = projection_jitters;
-
-         // These are called "m_vProjMatrixSubPixoffset" in CryEngine.
-         // The matrix is transposed so we flip the matrix x and y indices.
-         projection_jitters.x = current_projection_matrix(0, 2);
-         projection_jitters.y = current_projection_matrix(1, 2);
-
-#if DEVELOPMENT
-         ASSERT_ONCE(disable_taa_jitters || (projection_jitters_copy.x == 0 && projection_jitters_copy.y == 0) || (projection_jitters.x != 0 || projection_jitters.y != 0)); // Once we found jitters, we should never cache matrices that don't have jitters anymore
-#endif
-
-         bool prey_taa_active_copy = device_data.prey_taa_active;
-         // This is a reliable check to tell whether TAA is enabled. Jitters are "never" zero if they are enabled:
-         // they can be if we use the "srand" method, but it would happen one in a billion years;
-         // they could also be zero with Halton if the frame index was reset to zero (it is every x frames), but that happens very rarely, and for one frame only (we have two frames as tolerance).
-         device_data.prey_taa_active = (std::abs(projection_jitters.x * device_data.render_resolution.x) >= 0.00075) || (std::abs(projection_jitters.y * device_data.render_resolution.y) >= 0.00075); //TODOFT: make calculations more accurate (the threshold), especially with higher Halton phases!
-#if DEVELOPMENT
-         device_data.prey_taa_active = device_data.prey_taa_active || disable_taa_jitters;
-#endif // DEVELOPMENT
-         // Make sure that once we detect that TAA was active within a frame, then it should never be detected as off in the same frame (it would mean we are reading a bad cbuffer 13 that we should have discarded).
-         // Ignore this when we have no shaders loaded as it would always break due to the "has_drawn_tonemapping" check failing.
-         ASSERT_ONCE(device_data.cloned_pipeline_count == 0 || !device_data.found_per_view_globals || !prey_taa_active_copy || (prey_taa_active_copy == device_data.prey_taa_active));
-         if (prey_taa_active_copy != device_data.prey_taa_active && device_data.has_drawn_main_post_processing_previous) // TAA changed
-         {
-            // Detect if TAA was ever detected as on/off/on or off/on/off over 3 frames, because if that was so, our jitter "length" detection method isn't solid enough and we should do more (or add more tolernace to it),
-            // this might even happen every x hours once the randomization triggers specific enough values, though all TAA modes have a pretty short cycle with fixed jitters,
-            // so it should either happen quickly or never.
-            bool middle_value_different = (device_data.prey_taa_active == device_data.previous_prey_taa_active[0]) != (device_data.prey_taa_active == device_data.previous_prey_taa_active[1]);
-            ASSERT_ONCE(!middle_value_different);
-         }
-         bool drew_dlss = cb_luma_frame_settings.DLSS; // If this was true, DLSS would have been enabled and probably drew
-         device_data.prey_taa_detected = device_data.prey_taa_active || device_data.previous_prey_taa_active[0]; // This one has a two frames tolerance. We let it persist even if the game stopped drawing the 3D scene.
-         cb_luma_frame_settings.DLSS = (device_data.dlss_sr && !device_data.dlss_sr_suppressed && device_data.prey_taa_detected) ? 1 : 0; // No need for "s_mutex_reshade" here, given that they are generally only also changed by the user manually changing the settings in ImGUI, which runs at the very end of the frame
-         device_data.cb_luma_frame_settings_dirty |= (bool)cb_luma_frame_settings.DLSS != drew_dlss;
-         if (cb_luma_frame_settings.DLSS && !drew_dlss)
-         {
-            // Reset DLSS history when we toggle DLSS on and off manually, or when the user in the game changes the AA mode,
-            // otherwise the history from the last time DLSS was active will be kept (DLSS doesn't know time passes since it was last used).
-            // We could also clear DLSS resources here when we know it's unused for a while, but it would possibly lead to stutters.
-            device_data.force_reset_dlss_sr = true;
-         }
-
-#if DEVELOPMENT
-         if (!custom_texture_mip_lod_bias_offset)
-#endif
-         {
-            std::shared_lock shared_lock_samplers(s_mutex_samplers);
-
-            const auto prev_texture_mip_lod_bias_offset = device_data.texture_mip_lod_bias_offset;
-            if (device_data.dlss_sr && !device_data.dlss_sr_suppressed && device_data.prey_taa_detected && device_data.cloned_pipeline_count != 0)
-            {
-               device_data.texture_mip_lod_bias_offset = std::log2(device_data.render_resolution.y / device_data.output_resolution.y) - 1.f; // This results in -1 at output res
-            }
-            else
-            {
-               // Reset to best fallback value.
-               // This bias offset replaces the value from the game (see "samplers_upgrade_mode" 5), which was based on the "r_AntialiasingTSAAMipBias" cvar for most textures (it doesn't apply to all the ones that would benefit from it, and still applies to ones that exhibit moire patterns),
-               // but only if TAA was engaged (not SMAA or SMAA+TAA) (it might persist on SMAA after once using TAA, due to a bug).
-               // Prey defaults that to 0 but Luma's configs set it to -1.
-               device_data.texture_mip_lod_bias_offset = device_data.prey_taa_detected ? -1.f : 0.f;
-            }
-            const auto new_texture_mip_lod_bias_offset = device_data.texture_mip_lod_bias_offset;
-
-            bool texture_mip_lod_bias_offset_changed = prev_texture_mip_lod_bias_offset != new_texture_mip_lod_bias_offset;
-            // Re-create all samplers immediately here instead of doing it at the end of the frame.
-            // This allows us to avoid possible (but very unlikely) hitches that could happen if we re-created a new sampler for a new resolution later on when samplers descriptors are set.
-            // It also allows us to use the right samplers for this frame's resolution.
-            if (texture_mip_lod_bias_offset_changed)
-            {
-               ID3D11Device* native_device = (ID3D11Device*)(device->get_native());
-               for (auto& samplers_handle : device_data.custom_sampler_by_original_sampler)
-               {
-                  if (samplers_handle.second.contains(new_texture_mip_lod_bias_offset)) continue; // Skip "resolutions" that already got their custom samplers created
-                  ID3D11SamplerState* native_sampler = reinterpret_cast<ID3D11SamplerState*>(samplers_handle.first);
-                  D3D11_SAMPLER_DESC native_desc;
-                  native_sampler->GetDesc(&native_desc);
-                  shared_lock_samplers.unlock(); // This is fine!
-                  {
-                     std::unique_lock unique_lock_samplers(s_mutex_samplers);
-                     samplers_handle.second[new_texture_mip_lod_bias_offset] = CreateCustomSampler(device_data, native_device, native_desc);
-                  }
-                  shared_lock_samplers.lock();
-               }
-            }
-         }
+      // Custom samplers lifetime should never be tracked by ReShade (is this innoucuous? remove it from the list in case it happened)
+      ASSERT_ONCE(!device_data.custom_samplers.is_custom_sampler(sampler.handle));
+#endif
 
-         if (!device_data.has_drawn_main_post_processing_previous)
-         {
-            device_data.previous_render_resolution = device_data.render_resolution;
-            previous_projection_jitters = projection_jitters;
+      device_data.custom_samplers.remove(sampler.handle);
+   }
 
-            // Set it to the latest value (ignoring the actual history)
-            device_data.previous_prey_taa_active[0] = device_data.prey_taa_active;
-            device_data.previous_prey_taa_active[1] = device_data.prey_taa_active;
-         }
+   void OnInitResource(
+      reshade::api::device* device,
+      const reshade::api::resource_desc& desc,
+      const reshade::api::subresource_data* initial_data,
+      reshade::api::resource_usage initial_state,
+      reshade::api::resource resource)
+   {
+      auto& device_data = device->get_private_data<DeviceData>();
+      if (desc.type == reshade::api::resource_type::buffer && desc.buffer.size == CBPerViewGlobal_buffer_size)
+      {
+         device_data.cb_per_view_global_buffer_candidates.insert(resource.handle);
+      }
+#if DEVELOPMENT
+      device_data.resources.insert_or_assign(resource.handle);
+#endif // DEVELOPMENT
+   }
 
-         // This only needs to be calculated once, before or after G-buffers are composed, but before late post processing (TM) starts, as it's for TAA (at the end of PP)
-         {
-            // NDC to UV space (y is flipped)
-            const Matrix44_tpl<double> mScaleBias1 = Matrix44_tpl<double>(
-               0.5, 0, 0, 0,
-               0, -0.5, 0, 0,
-               0, 0, 1, 0,
-               0.5, 0.5, 0, 1);
-            // UV to NDC space (y is flipped)
-            const Matrix44_tpl<double> mScaleBias2 = Matrix44_tpl<double>(
-               2.0, 0, 0, 0,
-               0, -2.0, 0, 0,
-               0, 0, 1, 0,
-               -1.0, 1.0, 0, 1);
+   void OnDestroyResource(reshade::api::device* device, reshade::api::resource resource)
+   {
+      auto& device_data = device->get_private_data<DeviceData>();
+      device_data.cb_per_view_global_buffer_candidates.erase(resource.handle);
+      device_data.custom_views_cache.evict(reinterpret_cast<ID3D11Resource*>(resource.handle));
+#if DEVELOPMENT
+      device_data.resources.erase(resource.handle);
+#endif // DEVELOPMENT
+   }
 
-#if 0 // Not needed anymore, but here in case
-            const Matrix44A mViewProjPrev = Matrix44_tpl<double>(cb_per_view_global_actual_previous.CV_ViewMatr.GetTransposed()) * projection_matrix_native * Matrix44_tpl<double>(mScaleBias1);
-#endif
-            // We calculate all in double for extra precision (this stuff is delicate)
-            Matrix44_tpl<double> projection_matrix_native = current_projection_matrix.GetTransposed();
-            Matrix44_tpl<double> previous_projection_matrix_native = Matrix44_tpl<double>(previous_projection_matrix.GetTransposed());
-            Matrix44_tpl<double> mViewInv;
-            mathMatrixLookAtInverse(mViewInv, Matrix44_tpl<double>(cb_per_view_global.CV_ViewMatr.GetTransposed()));
-            Matrix44_tpl<double> mProjInv;
-            mathMatrixPerspectiveFovInverse(mProjInv, projection_matrix_native);
-            Matrix44_tpl<double> mReprojection64 = mProjInv * mViewInv * Matrix44_tpl<double>(cb_per_view_global_actual_previous.CV_ViewMatr.GetTransposed()) * previous_projection_matrix_native;
-            // These work (NDC adjustments) (anything else doesn't work, I've tried).
-            mReprojection64 = mScaleBias2 * mReprojection64 * mScaleBias1;
-            reprojection_matrix = mReprojection64.GetTransposed(); // Transpose it here so it's easier to read on the GPU (and consistent with the other matrices)
-         }
+#if DEVELOPMENT
 
-         device_data.found_per_view_globals = true;
+   void OnInitResourceView(
+      reshade::api::device* device,
+      reshade::api::resource resource,
+      reshade::api::resource_usage usage_type,
+      const reshade::api::resource_view_desc& desc,
+      reshade::api::resource_view view)
+   {
+      auto& device_data = device->get_private_data<DeviceData>();
+      if (resource.handle == 0)
+      {
+         device_data.resource_views.erase(view.handle);
+         return;
       }
+      device_data.resource_views.insert_or_assign(view.handle, resource.handle);
+   }
 
-      return true;
+   void OnDestroyResourceView(reshade::api::device* device, reshade::api::resource_view view)
+   {
+      auto& device_data = device->get_private_data<DeviceData>();
+      device_data.resource_views.erase(view.handle);
    }
 
+#endif // DEVELOPMENT
+
    void OnPushDescriptors(
       reshade::api::command_list* cmd_list,
       reshade::api::shader_stage stages,
@@ -5599,6 +5623,7 @@ namespace
       uint32_t param_index,
       const reshade::api::descriptor_table_update& update)
    {
+      PROFILE_HOOK(ProfiledHook::PushDescriptors);
       auto* device = cmd_list->get_device();
       ID3D11Device* native_device = (ID3D11Device*)(device->get_native());
       ID3D11DeviceContext* native_device_context = (ID3D11DeviceContext*)(cmd_list->get_native());
@@ -5610,30 +5635,17 @@ namespace
       break;
       case reshade::api::descriptor_type::sampler:
       {
+         const rcu_domain::read_scope read_scope(device_data.rcu); // Until the custom samplers are bound
          reshade::api::descriptor_table_update custom_update = update;
          bool any_modified = false;
-         std::shared_lock shared_lock_samplers(s_mutex_samplers);
          for (uint32_t i = 0; i < update.count; i++)
          {
             const reshade::api::sampler& sampler = static_cast<const reshade::api::sampler*>(update.descriptors)[i];
-            if (device_data.custom_sampler_by_original_sampler.contains(sampler.handle))
+            // The version of this sampler matching the current mip lod bias is always already created (lock free lookup)
+            uint64_t custom_sampler_handle = 0;
+            if (device_data.custom_samplers.find(sampler.handle, custom_sampler_handle))
             {
-               ID3D11SamplerState* native_sampler = reinterpret_cast<ID3D11SamplerState*>(sampler.handle);
-               // Create the version of this sampler to match the current mip lod bias
-               if (!device_data.custom_sampler_by_original_sampler[sampler.handle].contains(device_data.texture_mip_lod_bias_offset))
-               {
-                  D3D11_SAMPLER_DESC native_desc;
-                  native_sampler->GetDesc(&native_desc);
-                  const auto last_texture_mip_lod_bias_offset = device_data.texture_mip_lod_bias_offset;
-                  shared_lock_samplers.unlock();
-                  {
-                     std::unique_lock unique_lock_samplers(s_mutex_samplers); // Only lock for reading if necessary. It doesn't matter if we released the shared lock above for a tiny amount of time, it's safe anyway
-                     device_data.custom_sampler_by_original_sampler[sampler.handle][last_texture_mip_lod_bias_offset] = CreateCustomSampler(device_data, (ID3D11Device*)device->get_native(), native_desc);
-                  }
-                  shared_lock_samplers.lock();
-               }
                // Update the customized descriptor data
-               uint64_t custom_sampler_handle = (uint64_t)(device_data.custom_sampler_by_original_sampler[sampler.handle][device_data.texture_mip_lod_bias_offset].get());
                if (custom_sampler_handle != 0)
                {
                   reshade::api::sampler& custom_sampler = ((reshade::api::sampler*)(custom_update.descriptors))[i];
@@ -5646,15 +5658,7 @@ namespace
 #if DEVELOPMENT
                // If recursive (already cloned) sampler ptrs are set, it's because the game somehow got the pointers and is re-using them (?),
                // this seems to happen when we change the ImGui settings for samplers a lot and quickly.
-               bool recursive_or_null = sampler.handle == 0;
-               ID3D11SamplerState* native_sampler = reinterpret_cast<ID3D11SamplerState*>(sampler.handle);
-               for (const auto& samplers_handle : device_data.custom_sampler_by_original_sampler)
-               {
-                  for (const auto& custom_sampler_handle : samplers_handle.second)
-                  {
-                     recursive_or_null |= custom_sampler_handle.second.get() == native_sampler;
-                  }
-               }
+               const bool recursive_or_null = sampler.handle == 0 || device_data.custom_samplers.is_custom_sampler(sampler.handle);
                ASSERT_ONCE(recursive_or_null); // Shouldn't happen! (if we know the sampler set is "recursive", then we are good and don't need to replace this sampler again)
 #if 0 // TODO: delete or restore in case the "recursive_or_null" assert above ever triggered (seems like it won't)
                if (sampler.handle != 0)
@@ -5662,7 +5666,7 @@ namespace
                   ID3D11SamplerState* native_sampler = reinterpret_cast<ID3D11SamplerState*>(sampler.handle);
                   D3D11_SAMPLER_DESC native_desc;
                   native_sampler->GetDesc(&native_desc);
-                  custom_sampler_by_original_sampler[sampler.handle] = CreateCustomSampler(device_data, (ID3D11Device*)device->get_native(), native_desc);
+                  custom_sampler_by_original_sampler[sampler.handle] = CreateCustomSampler((ID3D11Device*)device->get_native(), native_desc, device_data.texture_mip_lod_bias_offset);
                }
 #endif
 #endif // DEVELOPMENT
@@ -5704,22 +5708,40 @@ namespace
 
    void OnMapBufferRegion(reshade::api::device* device, reshade::api::resource resource, uint64_t offset, uint64_t size, reshade::api::map_access access, void** data)
    {
+      PROFILE_HOOK(ProfiledHook::MapBufferRegion);
       ID3D11Device* native_device = (ID3D11Device*)(device->get_native());
       ID3D11Buffer* buffer = reinterpret_cast<ID3D11Buffer*>(resource.handle);
       // No need to convert to native DX11 flags
       if (access == reshade::api::map_access::write_only || access == reshade::api::map_access::write_discard)
       {
-         D3D11_BUFFER_DESC buffer_desc;
-         buffer->GetDesc(&buffer_desc);
          auto& device_data = device->get_private_data<DeviceData>();
 
+         // The game maps buffers tens of thousands of times per frame, so we check the (tiny) list of buffers of the right size that we built on creation first,
+         // and only fall back to asking DX for the buffer description if the list was ever too full to be reliable, or if it might not have been complete yet.
+         const auto is_candidate = device_data.cb_per_view_global_buffer_candidates.contains(resource.handle);
+         const bool seeding_candidates = device_data.cb_per_view_global_buffer_candidates_seeding_frames.load(std::memory_order_relaxed) != 0;
+         if (is_candidate == handle_set<>::lookup_result::no && !seeding_candidates) return;
+         bool is_cb_per_view_global_buffer_size = is_candidate == handle_set<>::lookup_result::yes;
+         if (!is_cb_per_view_global_buffer_size)
+         {
+            D3D11_BUFFER_DESC buffer_desc;
+            buffer->GetDesc(&buffer_desc);
+            is_cb_per_view_global_buffer_size = buffer_desc.ByteWidth == CBPerViewGlobal_buffer_size;
+            if (is_cb_per_view_global_buffer_size && is_candidate == handle_set<>::lookup_result::no)
+            {
+               device_data.cb_per_view_global_buffer_candidates.insert(resource.handle);
+            }
+         }
+
          // There seems to only ever be one buffer type of this size, but it's not guaranteed (we might have found more, but it doesn't matter, they are discarded later)...
          // They seemengly all happen on the same thread.
          // Some how these are not marked as "D3D11_BIND_CONSTANT_BUFFER", probably because it copies them over to some other buffer later?
-         if (buffer_desc.ByteWidth == CBPerViewGlobal_buffer_size)
+         if (is_cb_per_view_global_buffer_size)
          {
             device_data.cb_per_view_global_buffer = buffer;
 #if DEVELOPMENT && 0
+            D3D11_BUFFER_DESC buffer_desc;
+            buffer->GetDesc(&buffer_desc);
             if (std::find(cb_per_view_global_buffer_pending_verification.begin(), cb_per_view_global_buffer_pending_verification.end(), buffer) == cb_per_view_global_buffer_pending_verification.end())
             {
                cb_per_view_global_buffer_pending_verification.push_back(buffer);
@@ -5735,6 +5757,7 @@ namespace
 
    void OnUnmapBufferRegion(reshade::api::device* device, reshade::api::resource resource)
    {
+      PROFILE_HOOK(ProfiledHook::UnmapBufferRegion);
       ID3D11Device* native_device = (ID3D11Device*)(device->get_native());
       ID3D11Buffer* buffer = reinterpret_cast<ID3D11Buffer*>(resource.handle);
       auto& device_data = device->get_private_data<DeviceData>();
@@ -5747,7 +5770,20 @@ namespace
          // they are never read by shaders on the GPU anyway.
          char global_buffer_data[CBPerViewGlobal_buffer_size];
          std::memcpy(&global_buffer_data[0], device_data.cb_per_view_global_buffer_map_data, CBPerViewGlobal_buffer_size);
-         if (UpdateGlobalCBuffer(&global_buffer_data[0], device))
+#if DEVELOPMENT || TEST
+         const bool force_motion_vectors_jittered_define = GetShaderDefineCompiledNumericalValue(FORCE_MOTION_VECTORS_JITTERED_HASH) >= 1;
+#else
+         const bool force_motion_vectors_jittered_define = force_motion_vectors_jittered;
+#endif
+         const bool is_main_view_cbuffer = UpdateGlobalCBuffer(&global_buffer_data[0], device_data, force_motion_vectors_jittered_define);
+#if DEVELOPMENT
+         // Capture the original data (we only modify the mapped memory), and whether we accepted it, so replays can verify the detection
+         if (frame_capture.is_capturing())
+         {
+            frame_capture.write(FrameCaptureEvent::UnmapGlobalCBuffer, FrameCaptureUnmapGlobalCBuffer{ resource.handle, uint32_t(CBPerViewGlobal_buffer_size), is_main_view_cbuffer ? 1u : 0u }, &global_buffer_data[0], uint32_t(CBPerViewGlobal_buffer_size));
+         }
+#endif
+         if (is_main_view_cbuffer)
          {
             // Write back the cbuffer data after we have fixed it up (we always do!)
             std::memcpy(device_data.cb_per_view_global_buffer_map_data, &cb_per_view_global, sizeof(CBPerViewGlobal));
@@ -5767,7 +5803,7 @@ namespace
       ID3D11Buffer* buffer = reinterpret_cast<ID3D11Buffer*>(resource.handle);
       auto& device_data = device->get_private_data<DeviceData>();
       // Verify that we didn't miss any changes to the global g-buffer
-      ASSERT_ONCE(!device_data.has_drawn_main_post_processing_previous || !device_data.cb_per_view_global_buffers.contains(buffer));
+      ASSERT_ONCE(!device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing) || !device_data.cb_per_view_global_buffers.contains(buffer));
       return false;
    }
 
@@ -5793,6 +5829,13 @@ namespace
 
    bool OnCopyResource(reshade::api::command_list* cmd_list, reshade::api::resource source, reshade::api::resource dest)
    {
+      PROFILE_HOOK(ProfiledHook::CopyResource);
+#if DEVELOPMENT
+      if (frame_capture.is_capturing())
+      {
+         frame_capture.write(FrameCaptureEvent::CopyResource, FrameCaptureCopyResource{ cmd_list->get_native(), source.handle, dest.handle });
+      }
+#endif
       ID3D11Resource* source_resource = reinterpret_cast<ID3D11Resource*>(source.handle);
       com_ptr<ID3D11Texture2D> source_resource_texture;
       HRESULT hr = source_resource->QueryInterface(&source_resource_texture);
@@ -5873,8 +5916,7 @@ namespace
                // Prepare resources:
                //
                ASSERT_ONCE((source_desc.BindFlags & D3D11_BIND_SHADER_RESOURCE) != 0);
-               com_ptr<ID3D11ShaderResourceView> source_resource_texture_view;
-               D3D11_SHADER_RESOURCE_VIEW_DESC source_srv_desc;
+               D3D11_SHADER_RESOURCE_VIEW_DESC source_srv_desc = {}; // Zero initialized as it's part of the views cache key
                source_srv_desc.Format = source_desc.Format;
                // Redirect typeless and sRGB formats to classic UNORM, the "copy resource" functions wouldn't distinguish between these, as they copy by byte.
                switch (source_srv_desc.Format)
@@ -5898,8 +5940,8 @@ namespace
                source_srv_desc.ViewDimension = D3D11_SRV_DIMENSION::D3D11_SRV_DIMENSION_TEXTURE2D;
                source_srv_desc.Texture2D.MipLevels = 1;
                source_srv_desc.Texture2D.MostDetailedMip = 0;
-               hr = native_device->CreateShaderResourceView(source_resource_texture.get(), &source_srv_desc, &source_resource_texture_view);
-               ASSERT_ONCE(SUCCEEDED(hr));
+               com_ptr<ID3D11ShaderResourceView> source_resource_texture_view = device_data.custom_views_cache.get_srv(native_device, source_resource_texture.get(), source_srv_desc);
+               ASSERT_ONCE(source_resource_texture_view.get() != nullptr);
 
                com_ptr<ID3D11Texture2D> proxy_target_resource_texture;
                // We need to make a double copy if the target texture isn't a render target, unfortunately (we could intercept its creation and add the flag, or replace any further usage in this frame by redirecting all pointers
@@ -5935,8 +5977,7 @@ namespace
                   proxy_target_resource_texture = target_resource_texture;
                }
 
-               com_ptr<ID3D11RenderTargetView> target_resource_texture_view;
-               D3D11_RENDER_TARGET_VIEW_DESC target_rtv_desc;
+               D3D11_RENDER_TARGET_VIEW_DESC target_rtv_desc = {};
                target_rtv_desc.Format = target_desc.Format;
                switch (target_rtv_desc.Format)
                {
@@ -5958,13 +5999,11 @@ namespace
                }
                target_rtv_desc.ViewDimension = D3D11_RTV_DIMENSION::D3D11_RTV_DIMENSION_TEXTURE2D;
                target_rtv_desc.Texture2D.MipSlice = 0;
-               hr = native_device->CreateRenderTargetView(proxy_target_resource_texture.get(), &target_rtv_desc, &target_resource_texture_view);
-               ASSERT_ONCE(SUCCEEDED(hr));
+               com_ptr<ID3D11RenderTargetView> target_resource_texture_view = device_data.custom_views_cache.get_rtv(native_device, proxy_target_resource_texture.get(), target_rtv_desc);
+               ASSERT_ONCE(target_resource_texture_view.get() != nullptr);
 
-               DrawStateStack draw_state_stack;
-               draw_state_stack.Cache(native_device_context);
-
-               DrawCustomPixelShader(native_device_context, device_data.default_blend_state.get(), device_data.copy_vertex_shader.get(), device_data.copy_pixel_shader.get(), source_resource_texture_view.get(), target_resource_texture_view.get(), target_desc.Width, target_desc.Height, true);
+               draw_state_stack state_stack(luma_settings_cbuffer_index, luma_data_cbuffer_index);
+               DrawCustomPixelShader(native_device_context, state_stack, device_data.default_blend_state.get(), device_data.copy_vertex_shader.get(), device_data.copy_pixel_shader.get(), source_resource_texture_view.get(), target_resource_texture_view.get(), target_desc.Width, target_desc.Height, true);
 
                //
                // Copy our render target target resource into the non render target target resource if necessary:
@@ -5974,7 +6013,7 @@ namespace
                   native_device_context->CopyResource(target_resource_texture.get(), proxy_target_resource_texture.get());
                }
 
-               draw_state_stack.Restore(native_device_context);
+               state_stack.restore(native_device_context);
                return true;
             }
          }
@@ -6014,8 +6053,9 @@ namespace
 #endif
             trace_running = false;
             auto& cmd_list_data = runtime->get_command_queue()->get_immediate_command_list()->get_private_data<CommandListData>();
-            const std::shared_lock lock_trace_2(cmd_list_data.mutex_trace);
-            trace_count = cmd_list_data.trace_draw_calls_data.size();
+            MergeTraceDrawCalls(cmd_list_data, cmd_list_data);
+            const std::shared_lock lock_trace_2(cmd_list_data.trace_draw_calls.mutex);
+            trace_count = cmd_list_data.trace_draw_calls.data.size();
          }
          else if (trace_scheduled)
          {
@@ -6026,63 +6066,75 @@ namespace
             trace_scheduled = false;
             {
                auto& cmd_list_data = runtime->get_command_queue()->get_immediate_command_list()->get_private_data<CommandListData>();
-               const std::unique_lock lock_trace_2(cmd_list_data.mutex_trace);
-               cmd_list_data.trace_draw_calls_data.clear();
+               cmd_list_data.trace_draw_calls.records.drain([](const TraceDrawCallRecord& record) {}); // Discard any stale record
+               const std::unique_lock lock_trace_2(cmd_list_data.trace_draw_calls.mutex);
+               cmd_list_data.trace_draw_calls.data.clear();
             }
             trace_count = 0;
+            trace_index++;
             trace_running = true;
          }
       }
+
+      // Like traces, captures last from one present to the next one
+      if (frame_capture.is_capturing())
+      {
+         // The frame passes were already ended by the "present" event (before this one), so these are the ones of the captured frame
+         frame_capture.write(FrameCaptureEvent::Present, FrameCapturePresent{ frame_index, device_data.frame_passes.get_previous_drawn_passes(), 0 });
+         auto capture_path = GetShaderPath() / "dump";
+         std::error_code error_code;
+         std::filesystem::create_directories(capture_path, error_code);
+         capture_path /= "frame_capture_" + std::to_string(frame_index) + ".lumacap";
+         const bool saved = frame_capture.end(capture_path);
+         ASSERT_ONCE(saved);
+         if (saved)
+         {
+            last_capture_path = capture_path;
+         }
+      }
+      else if (capture_scheduled)
+      {
+         capture_scheduled = false;
+         frame_capture.begin();
+         // Write all the pipelines that already exist, the ones created from now on are written as they come (if any was created in between, it'd be written twice, which is harmless)
+         const std::shared_lock lock(s_mutex_generic);
+         for (const auto& pipeline_pair : device_data.pipeline_cache_by_pipeline_handle)
+         {
+            CaptureInitPipeline(*pipeline_pair.second);
+         }
+      }
 #endif // DEVELOPMENT
 
       // Dump new shaders (checking the "shaders_to_dump" count is theoretically not thread safe but it should work nonetheless as this is run every frame)
       if (auto_dump && !thread_auto_dumping_running && !shaders_to_dump.empty())
       {
-         if (thread_auto_dumping.joinable())
-         {
-            thread_auto_dumping.join();
-         }
          thread_auto_dumping_running = true;
-         thread_auto_dumping = std::thread(AutoDumpShaders);
+         auto_dumping_job = background_jobs.submit(JobPriority::IO, AutoDumpShaders);
+      }
+
+      // Precompile the shader defines permutations the user might switch to next, once all the other shaders loading is done
+      if (needs_precompile_shader_permutations && !thread_auto_compiling_running && !device_data.thread_auto_loading_running && !thread_precompiling_running)
+      {
+         needs_precompile_shader_permutations = false;
+         thread_precompiling_running = true;
+         precompiling_job = background_jobs.submit(JobPriority::BackgroundCompile, PrecompileShaderPermutations);
       }
 
       s_mutex_loading.lock_shared();
       // Load new shaders
-      // We avoid running this if "thread_auto_compiling" is still running from boot.
-      // Note that this thread doesn't really need to be by "device", but we did so to make it simpler, to automatically handle the "CreateCustomDeviceShaders()" shaders.
-      if (auto_load && !last_pressed_unload && !thread_auto_compiling_running && !device_data.thread_auto_loading_running && !device_data.pipelines_to_reload.empty())
+      // We avoid running this if "auto_compiling_job" is still running from boot.
+      // Note that this job doesn't really need to be by "device", but we did so to make it simpler, to automatically handle the "CreateCustomDeviceShaders()" shaders.
+      if (auto_load && !last_pressed_unload && !thread_auto_compiling_running && !device_data.thread_auto_loading_running && (!device_data.pipelines_to_reload.empty() || !device_data.shaders_to_recompile.empty()))
       {
          s_mutex_loading.unlock_shared();
-         if (device_data.thread_auto_loading.joinable())
-         {
-            device_data.thread_auto_loading.join();
-         }
          device_data.thread_auto_loading_running = true;
-         device_data.thread_auto_loading = std::thread(AutoLoadShaders, &device_data);
+         device_data.auto_loading_job = background_jobs.submit(JobPriority::RenderCritical, [&device_data](const std::atomic<bool>& cancelled) { AutoLoadShaders(&device_data, cancelled); }, &device_data);
       }
       else
       {
          s_mutex_loading.unlock_shared();
       }
 
-      // Destroy the cloned pipelines in the following frame to avoid crashes
-      bool has_pipelines_to_destroy = false;
-      {
-         // This is fine because we can afford delaying it even further in case they were changed in between the read and write locks here
-         const std::shared_lock lock(s_mutex_generic);
-         has_pipelines_to_destroy = !device_data.pipelines_to_destroy.empty();
-
-      }
-      if (has_pipelines_to_destroy)
-      {
-         const std::unique_lock lock(s_mutex_generic);
-         for (auto pair : device_data.pipelines_to_destroy)
-         {
-            pair.second->destroy_pipeline(reshade::api::pipeline{ pair.first });
-         }
-         device_data.pipelines_to_destroy.clear();
-      }
-
       if (needs_unload_shaders)
       {
          {
@@ -6145,6 +6197,7 @@ namespace
       needs_load_shaders = enabled; // This also re-compile shaders possibly
       const std::unique_lock lock(s_mutex_loading);
       device_data.pipelines_to_reload.clear();
+      device_data.shaders_to_recompile.clear();
       return false; // You can return true to deny the change
    }
 
@@ -6271,7 +6324,7 @@ namespace
       }
    }
 
-   void AutoDumpShaders()
+   void AutoDumpShaders(const std::atomic<bool>& cancelled)
    {
       // Copy the "shaders_to_dump" so we don't have to lock "s_mutex_dumping" all the times
       std::unordered_set<uint32_t> shaders_to_dump_copy;
@@ -6287,6 +6340,7 @@ namespace
       }
       for (auto shader_to_dump : shaders_to_dump_copy)
       {
+         if (cancelled) break; // The remaining shaders will be dumped on the next boot
          const std::lock_guard<std::recursive_mutex> lock_dumping(s_mutex_dumping);
          // Set this to true in case your old dumped shaders have bad naming (e.g. missing the "ps_5_0" appendix) and you want to replace them (on the next boot, the duplicate shaders with the shorter name will be deleted)
          constexpr bool force_redump_shaders = false;
@@ -6298,27 +6352,103 @@ namespace
       thread_auto_dumping_running = false;
    }
 
-   void AutoLoadShaders(DeviceData* device_data)
+   void AutoLoadShaders(DeviceData* device_data, const std::atomic<bool>& cancelled)
    {
-      // Copy the "pipelines_to_reload_copy" so we don't have to lock "s_mutex_loading" all the times
+      // Copy the "pipelines_to_reload" and "shaders_to_recompile" so we don't have to lock "s_mutex_loading" all the times
       std::unordered_set<uint64_t> pipelines_to_reload_copy;
+      std::unordered_set<uint32_t> shaders_to_recompile_copy;
       {
          const std::unique_lock lock_loading(s_mutex_loading);
-         if (device_data->pipelines_to_reload.empty())
+         if (cancelled || (device_data->pipelines_to_reload.empty() && device_data->shaders_to_recompile.empty()))
          {
             device_data->thread_auto_loading_running = false;
             return;
          }
          pipelines_to_reload_copy = device_data->pipelines_to_reload;
          device_data->pipelines_to_reload.clear();
+         shaders_to_recompile_copy = device_data->shaders_to_recompile;
+         device_data->shaders_to_recompile.clear();
+      }
+      // Shaders that changed on disk need to be compiled again (this also re-creates the custom device shaders among them),
+      // then all the pipelines that use them are reloaded (together with the newly created pipelines that were waiting to be loaded, which don't need any compilation)
+      if (!shaders_to_recompile_copy.empty())
+      {
+         CompileCustomShaders(device_data, false, std::unordered_set<uint64_t>(), shaders_to_recompile_copy);
+         const std::shared_lock lock(s_mutex_generic);
+         for (const uint32_t shader_hash : shaders_to_recompile_copy)
+         {
+            if (const auto* cached_pipelines = device_data->pipeline_caches_by_shader_hash.find(shader_hash); cached_pipelines != nullptr)
+            {
+               for (const auto cached_pipeline : *cached_pipelines)
+               {
+                  pipelines_to_reload_copy.emplace(cached_pipeline->pipeline.handle);
+               }
+            }
+         }
       }
-      if (pipelines_to_reload_copy.size() > 0)
+      if (!cancelled && !pipelines_to_reload_copy.empty())
       {
          LoadCustomShaders(*device_data, pipelines_to_reload_copy, !precompile_custom_shaders);
       }
       device_data->thread_auto_loading_running = false;
    }
 
+   // Called by "shaders_directory_watcher" (from its own thread) after any file changed in the shaders folder.
+   // This queues all the shaders built from these files in "shaders_to_recompile", so that only they (and the pipelines that use them) are recompiled and reloaded by "AutoLoadShaders()".
+   void OnShaderFilesChanged(const std::vector<std::filesystem::path>& changed_files)
+   {
+      if (!auto_load || last_pressed_unload) return;
+
+      const auto directory = GetShaderPath();
+      std::unordered_set<uint32_t> changed_shaders_hashes;
+      for (const auto& changed_file : changed_files)
+      {
+         // We lost track of what changed, reload all the custom shaders we have
+         if (changed_file == directory)
+         {
+            const std::shared_lock lock(s_mutex_loading);
+            for (const auto& custom_shader_pair : custom_shaders_cache)
+            {
+               changed_shaders_hashes.emplace(custom_shader_pair.first);
+            }
+            continue;
+         }
+         // Ignore the files we write ourselves (e.g. "cso" and our caches), it'd never end otherwise
+         if (changed_file.extension().compare(".hlsl") != 0 && changed_file.extension().compare(".h") != 0)
+         {
+            continue;
+         }
+
+         // The shaders that have been built from (or include) this file
+         for (const uint32_t shader_hash : shaders_dependency_graph.GetDependentShaders(changed_file))
+         {
+            changed_shaders_hashes.emplace(shader_hash);
+         }
+         // New shaders (or shaders that never compiled successfully) won't be in the dependency graph, but we can find the shaders they target from their name
+         const auto filename_no_extension_string = changed_file.stem().string();
+         size_t next_hash_pos = filename_no_extension_string.find("0x");
+         while (next_hash_pos != std::string::npos)
+         {
+            try
+            {
+               changed_shaders_hashes.emplace(std::stoul(filename_no_extension_string.substr(next_hash_pos + 2 /*0x*/, HASH_CHARACTERS_LENGTH), nullptr, 16));
+            }
+            catch (const std::exception& e)
+            {
+            }
+            next_hash_pos = filename_no_extension_string.find("0x", next_hash_pos + 1);
+         }
+      }
+      if (changed_shaders_hashes.empty()) return;
+
+      const std::shared_lock lock_device(s_mutex_device);
+      const std::unique_lock lock(s_mutex_loading);
+      for (auto global_device_data : global_devices_data)
+      {
+         global_device_data->shaders_to_recompile.insert(changed_shaders_hashes.begin(), changed_shaders_hashes.end());
+      }
+   }
+
    // @see https://pthom.github.io/imgui_manual_online/manual/imgui_manual.html
    // This runs within the swapchain "Present()" function, and thus it's thread safe
    void OnRegisterOverlay(reshade::api::effect_runtime* runtime)
@@ -6335,6 +6465,53 @@ namespace
       {
          trace_scheduled = true;
       }
+
+      ImGui::SameLine();
+      ImGui::BeginDisabled(capture_scheduled || frame_capture.is_capturing());
+      if (ImGui::Button("Capture Frame"))
+      {
+         capture_scheduled = true;
+      }
+      if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+      {
+         ImGui::SetTooltip("Captures the events of the next frame (pipelines, draws, global cbuffer data, copies...) to a binary file in the \"dump\" folder, to replay them offline.");
+      }
+      ImGui::EndDisabled();
+
+      ImGui::SameLine();
+      ImGui::BeginDisabled(last_capture_path.empty() || capture_replay_running);
+      if (ImGui::Button("Replay Capture"))
+      {
+         capture_replay_running = true;
+         capture_replay_job = background_jobs.submit(JobPriority::IO, [capture_path = last_capture_path](const std::atomic<bool>& cancelled) { ReplayCapture(capture_path, cancelled); });
+      }
+      if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+      {
+         ImGui::SetTooltip("Replays the last frame capture on a mock backend (without any GPU work), to benchmark the shaders detection logic. It runs in the background, the results are shown in the \"Info\" tab once done.");
+      }
+      ImGui::EndDisabled();
+
+      ImGui::SameLine();
+      bool gpu_profiler_enabled_local = gpu_profiler_enabled;
+      if (ImGui::Checkbox("GPU Profiler", &gpu_profiler_enabled_local))
+      {
+         gpu_profiler_enabled = gpu_profiler_enabled_local;
+         // This runs in the thread that owns the immediate device context, so we can safely destroy the queries
+         device_data.gpu_profiler.reset(runtime->get_device());
+      }
+      if (gpu_profiler_enabled_local)
+      {
+         ImGui::SameLine();
+         if (ImGui::Button("Export GPU Profile"))
+         {
+            auto profile_path = GetShaderPath() / "dump";
+            std::error_code error_code;
+            std::filesystem::create_directories(profile_path, error_code);
+            profile_path /= "gpu_profile_" + std::to_string(frame_index) + ".json";
+            const bool exported = device_data.gpu_profiler.get_timings().export_chrome_trace(profile_path);
+            ASSERT_ONCE(exported);
+         }
+      }
 #if 0 // Currently not necessary
       ImGui::SameLine();
       ImGui::Checkbox("List Unique Shaders Only", &trace_list_unique_shaders_only);
@@ -6362,9 +6539,9 @@ namespace
       ImGui::PushID("##AutoDumpCheckBox");
       if (ImGui::Checkbox("Auto Dump", &auto_dump))
       {
-         if (!auto_dump && thread_auto_dumping.joinable())
+         if (!auto_dump)
          {
-            thread_auto_dumping.join();
+            auto_dumping_job.wait();
          }
       }
       ImGui::PopID();
@@ -6380,14 +6557,12 @@ namespace
          if (auto_load)
          {
             auto_load = false;
-            if (device_data.thread_auto_loading.joinable())
-            {
-               device_data.thread_auto_loading.join();
-            }
+            device_data.auto_loading_job.wait();
          }
 #endif
          const std::unique_lock lock(s_mutex_loading);
          device_data.pipelines_to_reload.clear();
+         device_data.shaders_to_recompile.clear();
       }
       if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
       {
@@ -6419,6 +6594,7 @@ namespace
          needs_load_shaders = true;
          const std::unique_lock lock(s_mutex_loading);
          device_data.pipelines_to_reload.clear();
+         device_data.shaders_to_recompile.clear();
       }
       if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
       {
@@ -6466,12 +6642,13 @@ namespace
       ImGui::PushID("##AutoLoadCheckBox");
       if (ImGui::Checkbox("Auto Load", &auto_load))
       {
-         if (!auto_load && device_data.thread_auto_loading.joinable())
+         if (!auto_load)
          {
-            device_data.thread_auto_loading.join();
+            device_data.auto_loading_job.wait();
          }
          const std::unique_lock lock(s_mutex_loading);
          device_data.pipelines_to_reload.clear();
+         device_data.shaders_to_recompile.clear();
       }
       ImGui::PopID();
 #endif // DEVELOPMENT
@@ -6495,11 +6672,11 @@ namespace
                   {
                      const std::shared_lock lock_generic(s_mutex_generic);
                      auto& cmd_list_data = runtime->get_command_queue()->get_immediate_command_list()->get_private_data<CommandListData>();
-                     const std::shared_lock lock_trace_2(cmd_list_data.mutex_trace);
+                     const std::shared_lock lock_trace_2(cmd_list_data.trace_draw_calls.mutex);
                      for (auto index = 0; index < trace_count; index++)
                      {
-                        auto pipeline_handle = cmd_list_data.trace_draw_calls_data.at(index).pipeline_handle;
-                        auto thread_id = cmd_list_data.trace_draw_calls_data.at(index).thread_id._Get_underlying_id(); // Possibly compiler dependent but whatever, cast to int alternatively
+                        auto pipeline_handle = cmd_list_data.trace_draw_calls.data.at(index).pipeline_handle;
+                        auto thread_id = cmd_list_data.trace_draw_calls.data.at(index).thread_id._Get_underlying_id(); // Possibly compiler dependent but whatever, cast to int alternatively
                         const bool is_selected = selected_index == index;
                         // Note that the pipelines can be run more than once so this will return the first one matching (there's only one actually, we don't have separate settings for their running instance, as that's runtime stuff)
                         const auto pipeline_pair = device_data.pipeline_cache_by_pipeline_handle.find(pipeline_handle);
@@ -6514,7 +6691,7 @@ namespace
                            // Index - Thread ID (command list) - Shader Hash(es) - Shader Name
                            name << std::setfill('0') << std::setw(3) << index << std::setw(0); // Fill up 3 slots for the index so the text is aligned
                            // Deferred
-                           if (cmd_list_data.trace_draw_calls_data.at(index).command_list->GetType() != D3D11_DEVICE_CONTEXT_IMMEDIATE)
+                           if (cmd_list_data.trace_draw_calls.data.at(index).is_deferred)
                            {
                               name << " - " << thread_id << "*";
                            }
@@ -6631,10 +6808,10 @@ namespace
                   {
                      static std::string disasm_string;
                      auto& cmd_list_data = runtime->get_command_queue()->get_immediate_command_list()->get_private_data<CommandListData>();
-                     const std::shared_lock lock_trace(cmd_list_data.mutex_trace);
-                     if (selected_index >= 0 && cmd_list_data.trace_draw_calls_data.size() >= selected_index + 1 && (changed_selected || opened_disassembly_tab_item != open_disassembly_tab_item))
+                     const std::shared_lock lock_trace(cmd_list_data.trace_draw_calls.mutex);
+                     if (selected_index >= 0 && cmd_list_data.trace_draw_calls.data.size() >= selected_index + 1 && (changed_selected || opened_disassembly_tab_item != open_disassembly_tab_item))
                      {
-                        const auto pipeline_handle = cmd_list_data.trace_draw_calls_data.at(selected_index).pipeline_handle;
+                        const auto pipeline_handle = cmd_list_data.trace_draw_calls.data.at(selected_index).pipeline_handle;
                         const std::unique_lock lock(s_mutex_generic);
                         if (auto pipeline_pair = device_data.pipeline_cache_by_pipeline_handle.find(pipeline_handle); pipeline_pair != device_data.pipeline_cache_by_pipeline_handle.end() && pipeline_pair->second != nullptr)
                         {
@@ -6680,11 +6857,11 @@ namespace
                      static bool hlsl_error = false;
                      static bool hlsl_warning = false;
                      auto& cmd_list_data = runtime->get_command_queue()->get_immediate_command_list()->get_private_data<CommandListData>();
-                     const std::shared_lock lock_trace(cmd_list_data.mutex_trace);
-                     if (selected_index >= 0 && cmd_list_data.trace_draw_calls_data.size() >= selected_index + 1 && (changed_selected || opened_live_tab_item != open_live_tab_item || refresh_cloned_pipelines))
+                     const std::shared_lock lock_trace(cmd_list_data.trace_draw_calls.mutex);
+                     if (selected_index >= 0 && cmd_list_data.trace_draw_calls.data.size() >= selected_index + 1 && (changed_selected || opened_live_tab_item != open_live_tab_item || refresh_cloned_pipelines))
                      {
                         bool hlsl_set = false;
-                        auto pipeline_handle = cmd_list_data.trace_draw_calls_data.at(selected_index).pipeline_handle;
+                        auto pipeline_handle = cmd_list_data.trace_draw_calls.data.at(selected_index).pipeline_handle;
 
                         const std::shared_lock lock(s_mutex_generic);
                         if (auto pipeline_pair = device_data.pipeline_cache_by_pipeline_handle.find(pipeline_handle);
@@ -6749,10 +6926,10 @@ namespace
                   if (open_settings_tab_item)
                   {
                      auto& cmd_list_data = runtime->get_command_queue()->get_immediate_command_list()->get_private_data<CommandListData>();
-                     const std::shared_lock lock_trace(cmd_list_data.mutex_trace);
-                     if (selected_index >= 0 && cmd_list_data.trace_draw_calls_data.size() >= selected_index + 1)
+                     const std::shared_lock lock_trace(cmd_list_data.trace_draw_calls.mutex);
+                     if (selected_index >= 0 && cmd_list_data.trace_draw_calls.data.size() >= selected_index + 1)
                      {
-                        auto pipeline_handle = cmd_list_data.trace_draw_calls_data.at(selected_index).pipeline_handle;
+                        auto pipeline_handle = cmd_list_data.trace_draw_calls.data.at(selected_index).pipeline_handle;
                         bool reload = false;
                         bool recompile = false;
                         {
@@ -6768,7 +6945,7 @@ namespace
                                  }
                                  if (pipeline_pair->second->cloned && ImGui::Button("Unload"))
                                  {
-                                    UnloadCustomShaders(device_data, { pipeline_handle }, false, false);
+                                    UnloadCustomShaders(device_data, { pipeline_handle }, false);
                                  }
                                  if (ImGui::Button(pipeline_pair->second->cloned ? "Recompile" : "Load"))
                                  {
@@ -6798,17 +6975,17 @@ namespace
                                  }
                                  if (pipeline_pair->second->HasPixelShader())
                                  {
-                                    auto blend_desc = cmd_list_data.trace_draw_calls_data.at(selected_index).blend_desc;
+                                    auto blend_desc = cmd_list_data.trace_draw_calls.data.at(selected_index).blend_desc;
 
                                     for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
                                     {
-                                       auto rtv_format = cmd_list_data.trace_draw_calls_data.at(selected_index).rtv_format[i];
+                                       auto rtv_format = cmd_list_data.trace_draw_calls.data.at(selected_index).rtv_format[i];
                                        if (rtv_format == DXGI_FORMAT_UNKNOWN)
                                        {
                                           continue;
                                        }
-                                       auto rt_format = cmd_list_data.trace_draw_calls_data.at(selected_index).rt_format[i];
-                                       auto rt_size = cmd_list_data.trace_draw_calls_data.at(selected_index).rt_size[i];
+                                       auto rt_format = cmd_list_data.trace_draw_calls.data.at(selected_index).rt_format[i];
+                                       auto rt_size = cmd_list_data.trace_draw_calls.data.at(selected_index).rt_size[i];
 
                                        ImGui::Text("");
                                        ImGui::Text("RT Index: %u", i);
@@ -6834,7 +7011,7 @@ namespace
                                           ImGui::Text("RTV Format: %u", rtv_format);
                                        }
 
-                                       ImGui::Text("RT Swapchain: %s", cmd_list_data.trace_draw_calls_data.at(selected_index).rt_is_swapchain[i] ? "True" : "False");
+                                       ImGui::Text("RT Swapchain: %s", cmd_list_data.trace_draw_calls.data.at(selected_index).rt_is_swapchain[i] ? "True" : "False");
 
                                        // 0 No alpha blend (or other unknown blend types that we can ignore)
                                        // 1 Straight alpha blend: "result = (source.RGB * source.A) + (dest.RGB * (1 - source.A))" or "result = lerp(dest.RGB, source.RGB, source.A)"
@@ -6885,7 +7062,7 @@ namespace
                                  {
                                     for (UINT i = 0; i < D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT; i++)
                                     {
-                                       auto srv_format = cmd_list_data.trace_draw_calls_data.at(selected_index).srv_format[i];
+                                       auto srv_format = cmd_list_data.trace_draw_calls.data.at(selected_index).srv_format[i];
                                        if (srv_format == DXGI_FORMAT_UNKNOWN)
                                        {
                                           continue;
@@ -6904,7 +7081,7 @@ namespace
                                  {
                                     for (UINT i = 0; i < D3D11_1_UAV_SLOT_COUNT; i++)
                                     {
-                                       auto uav_format = cmd_list_data.trace_draw_calls_data.at(selected_index).uav_format[i];
+                                       auto uav_format = cmd_list_data.trace_draw_calls.data.at(selected_index).uav_format[i];
                                        if (uav_format == DXGI_FORMAT_UNKNOWN)
                                        {
                                           continue;
@@ -6974,11 +7151,11 @@ namespace
             {
                // Show that DLSS is engaged. Ignored if the game scene isn't rendering.
                // If DLSS currently can't run due to the user settings/state, or failed, show a warning.
-               if (device_data.has_drawn_main_post_processing_previous && device_data.dlss_sr && device_data.cloned_pipeline_count != 0)
+               if (device_data.frame_passes.has_drawn_previous(FramePass::MainPostProcessing) && device_data.dlss_sr && device_data.cloned_pipeline_count != 0)
                {
                   ImGui::PushID("DLSS Super Resolution Active");
                   ImGui::BeginDisabled();
-                  ImGui::SmallButton((device_data.prey_taa_detected && device_data.has_drawn_dlss_sr_imgui && !device_data.dlss_sr_suppressed) ? ICON_FK_OK : ICON_FK_WARNING);
+                  ImGui::SmallButton((device_data.prey_taa_detected && device_data.frame_passes.has_drawn_previous(FramePass::DLSS_SR) && !device_data.dlss_sr_suppressed) ? ICON_FK_OK : ICON_FK_WARNING);
                   ImGui::EndDisabled();
                   ImGui::PopID();
                }
@@ -7598,30 +7775,30 @@ namespace
             }
 
             ImGui::NewLine();
-            bool samplers_changed = ImGui::SliderInt("Texture Samplers Upgrade Mode", &samplers_upgrade_mode, 0, 7);
-            samplers_changed |= ImGui::SliderInt("Texture Samplers Upgrade Mode - 2", &samplers_upgrade_mode_2, 0, 6);
+            bool samplers_mode_changed = ImGui::SliderInt("Texture Samplers Upgrade Mode", &samplers_upgrade_mode, 0, 7);
+            samplers_mode_changed |= ImGui::SliderInt("Texture Samplers Upgrade Mode - 2", &samplers_upgrade_mode_2, 0, 6);
             ImGui::Checkbox("Custom Texture Samplers Mip LOD Bias", &custom_texture_mip_lod_bias_offset);
+            bool samplers_lod_bias_changed = false;
             if (samplers_upgrade_mode > 0 && custom_texture_mip_lod_bias_offset)
             {
                const std::unique_lock lock_samplers(s_mutex_samplers);
-               samplers_changed |= ImGui::SliderFloat("Texture Samplers Mip LOD Bias", &device_data.texture_mip_lod_bias_offset, -8.f, +8.f);
+               samplers_lod_bias_changed = ImGui::SliderFloat("Texture Samplers Mip LOD Bias", &device_data.texture_mip_lod_bias_offset, -8.f, +8.f);
             }
-            if (samplers_changed)
+            if (samplers_mode_changed || samplers_lod_bias_changed)
             {
                const std::unique_lock lock_samplers(s_mutex_samplers);
                if (samplers_upgrade_mode <= 0)
                {
-                  device_data.custom_sampler_by_original_sampler.clear();
+                  device_data.custom_samplers.clear();
+               }
+               // The samplers of all the LOD biases were created with the previous mode, so they all need to be re-created
+               else if (samplers_mode_changed)
+               {
+                  device_data.custom_samplers.recreate(device_data.texture_mip_lod_bias_offset, &CreateCustomSamplerFromOriginal);
                }
                else
                {
-                  for (auto& samplers_handle : device_data.custom_sampler_by_original_sampler)
-                  {
-                     ID3D11SamplerState* native_sampler = reinterpret_cast<ID3D11SamplerState*>(samplers_handle.first);
-                     D3D11_SAMPLER_DESC native_desc;
-                     native_sampler->GetDesc(&native_desc);
-                     samplers_handle.second[device_data.texture_mip_lod_bias_offset] = CreateCustomSampler(device_data, (ID3D11Device*)runtime->get_device()->get_native(), native_desc);
-                  }
+                  device_data.custom_samplers.set_lod_bias(device_data.texture_mip_lod_bias_offset, &CreateCustomSamplerFromOriginal);
                }
             }
 #endif // DEVELOPMENT
@@ -7878,6 +8055,9 @@ namespace
                   ImGui::Text("DLSS Scene Exposure: ", "");
                text = std::to_string(device_data.dlss_scene_pre_exposure);
                ImGui::Text(text.c_str(), "");
+               // How many frames behind the GPU the read back exposure was
+               text = "Readback Latency: " + std::to_string(device_data.exposure_readback_latency) + " frames";
+               ImGui::Text(text.c_str(), "");
             }
 
             ImGui::NewLine();
@@ -7891,11 +8071,111 @@ namespace
             text = (projection_jitters.x >= 0 ? " " : "") + std::to_string(projection_jitters.x * device_data.render_resolution.x) + " " + (projection_jitters.y >= 0 ? " " : "") + std::to_string(projection_jitters.y * device_data.render_resolution.y);
             ImGui::Text(text.c_str(), "");
 
+            ImGui::NewLine();
+            ImGui::Text("Frame Passes: ", "");
+            ImGui::TextWrapped(device_data.frame_passes.get_previous_sequence().c_str(), "");
+            text = "Anomalies: " + std::to_string(device_data.frame_passes.get_anomalies_count());
+            ImGui::Text(text.c_str(), "");
+#if DEVELOPMENT
+            if (gpu_profiler_enabled)
+            {
+               ImGui::NewLine();
+               ImGui::Text("GPU Passes Timings (Average / Peak): ", "");
+               for (const auto& section_statistics : device_data.gpu_profiler.get_timings().get_statistics())
+               {
+                  text = std::format("{}: {:.3f} ms / {:.3f} ms", section_statistics.name, section_statistics.average_ms, section_statistics.max_ms);
+                  ImGui::Text(text.c_str(), "");
+               }
+               text = "Dropped Frames: " + std::to_string(device_data.gpu_profiler.get_dropped_frames());
+               ImGui::Text(text.c_str(), "");
+            }
+#endif
+
+#if ENABLE_HOOKS_PROFILING
+            ImGui::NewLine();
+            ImGui::Text("Hooks CPU Timings (Last Frame): ", "");
+            if (ImGui::BeginTable("Hooks CPU Timings", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+            {
+               ImGui::TableSetupColumn("Hook");
+               ImGui::TableSetupColumn("Count");
+               ImGui::TableSetupColumn("Total (ms)");
+               ImGui::TableSetupColumn("P50 (us)");
+               ImGui::TableSetupColumn("P99 (us)");
+               ImGui::TableSetupColumn("Max (us)");
+               ImGui::TableHeadersRow();
+               const auto& hooks_statistics = hooks_profiler.get_last_frame_statistics();
+               for (size_t i = 0; i < size_t(ProfiledHook::Count); i++)
+               {
+                  ImGui::TableNextRow();
+                  ImGui::TableNextColumn();
+                  ImGui::TextUnformatted(profiled_hooks_names[i]);
+                  ImGui::TableNextColumn();
+                  ImGui::TextUnformatted(std::to_string(hooks_statistics[i].count).c_str());
+                  ImGui::TableNextColumn();
+                  ImGui::TextUnformatted(std::format("{:.3f}", hooks_statistics[i].total_us / 1000.0).c_str());
+                  ImGui::TableNextColumn();
+                  ImGui::TextUnformatted(std::format("{:.2f}", hooks_statistics[i].p50_us).c_str());
+                  ImGui::TableNextColumn();
+                  ImGui::TextUnformatted(std::format("{:.2f}", hooks_statistics[i].p99_us).c_str());
+                  ImGui::TableNextColumn();
+                  ImGui::TextUnformatted(std::format("{:.2f}", hooks_statistics[i].max_us).c_str());
+               }
+               ImGui::EndTable();
+            }
+            if (ImGui::Button("Dump Hooks Timings"))
+            {
+               auto timings_path = GetShaderPath() / "dump";
+               std::error_code error_code;
+               std::filesystem::create_directories(timings_path, error_code);
+               timings_path /= "hooks_timings_" + std::to_string(frame_index) + ".csv";
+               const bool dumped = hooks_profiler.export_csv(timings_path, profiled_hooks_names);
+               ASSERT_ONCE(dumped);
+            }
+#endif
+
             ImGui::NewLine();
             ImGui::Text("Texture Mip LOD Bias: ", "");
-            text = std::to_string(device_data.texture_mip_lod_bias_offset);
+            text = std::to_string(device_data.texture_mip_lod_bias_offset) + " (Custom Samplers: " + std::to_string(device_data.custom_samplers.get_custom_samplers_count()) + ")";
+            ImGui::Text(text.c_str(), "");
+
+            ImGui::NewLine();
+            ImGui::Text("Custom Textures Memory: ", "");
+            const auto transient_textures_statistics = device_data.transient_textures.get_statistics();
+            text = std::to_string(transient_textures_statistics.allocated_bytes / (1024 * 1024)) + " MB (Peak: " + std::to_string(transient_textures_statistics.peak_allocated_bytes / (1024 * 1024)) + " MB)";
+            ImGui::Text(text.c_str(), "");
+            text = "Created: " + std::to_string(transient_textures_statistics.created_textures) + " Re-used: " + std::to_string(transient_textures_statistics.reused_textures) + " Destroyed: " + std::to_string(transient_textures_statistics.destroyed_textures);
+            ImGui::Text(text.c_str(), "");
+#if DEVELOPMENT
+
+            ImGui::NewLine();
+            ImGui::Text("Resources Registry: ", "");
+            const auto resources_statistics = device_data.resources.get_statistics();
+            const auto resource_views_statistics = device_data.resource_views.get_statistics();
+            text = "Resources: " + std::to_string(resources_statistics.size) + " (Contentions: " + std::to_string(resources_statistics.contentions) + ") Views: " + std::to_string(resource_views_statistics.size) + " (Contentions: " + std::to_string(resource_views_statistics.contentions) + ")";
             ImGui::Text(text.c_str(), "");
 
+            {
+               const std::lock_guard lock_capture_replay(s_mutex_capture_replay);
+               if (capture_replay_results.iterations != 0)
+               {
+                  ImGui::NewLine();
+                  ImGui::Text("Capture Replay: ", "");
+                  text = "Events: " + std::to_string(capture_replay_results.events) + " Pipelines: " + std::to_string(capture_replay_statistics.pipelines) + " Command Lists: " + std::to_string(capture_replay_statistics.command_lists)
+                     + " Unknown Pipeline Binds: " + std::to_string(capture_replay_statistics.unknown_pipeline_binds);
+                  ImGui::Text(text.c_str(), "");
+                  const uint64_t draws = capture_replay_statistics.events[size_t(FrameCaptureEvent::Draw)] + capture_replay_statistics.events[size_t(FrameCaptureEvent::DrawIndexed)] + capture_replay_statistics.events[size_t(FrameCaptureEvent::Dispatch)];
+                  text = "Draws: " + std::to_string(draws) + " (With Known Shader Roles: " + std::to_string(capture_replay_role_draws) + ")";
+                  ImGui::Text(text.c_str(), "");
+                  text = "Main View Global CBuffers: " + std::to_string(capture_replay_main_view_cbuffers) + " (Mismatching The Capture: " + std::to_string(capture_replay_cbuffer_mismatches) + ")";
+                  ImGui::Text(text.c_str(), "");
+                  text = "Frame Passes" + std::string(capture_replay_frame_passes_mismatch ? " (Mismatching The Capture): " : ": ") + capture_replay_frame_passes;
+                  ImGui::TextWrapped(text.c_str(), "");
+                  text = "Iterations: " + std::to_string(capture_replay_results.iterations) + " Total: " + std::to_string(capture_replay_results.total_ms) + "ms Per Event: " + std::to_string(capture_replay_results.ns_per_event) + "ns";
+                  ImGui::Text(text.c_str(), "");
+               }
+            }
+#endif
+
             ImGui::NewLine();
             ImGui::Text("Camera: ", "");
             //TODOFT3: figure out if this is meters or what
@@ -7914,6 +8194,22 @@ namespace
             text = "Weapon: Hor FOV: " + std::to_string(FOVX) + " Vert FOV: " + std::to_string(FOVY);
             ImGui::Text(text.c_str(), "");
 
+            ImGui::NewLine();
+            ImGui::Text("Global CBuffer Changed Fields: ", "");
+            // Compared to the main view one accepted before the last one, fields are compared by register, so the ones that share their register with others that changed are also shown
+            text.clear();
+            for (const auto& field : CBPerViewGlobal_fields)
+            {
+               const size_t first_register = field.offset / utils::cbuffer::register_size;
+               const size_t last_register = (field.offset + field.size - 1) / utils::cbuffer::register_size;
+               const uint64_t field_registers_mask = ((~0ull) >> (63 - last_register)) & ((~0ull) << first_register);
+               if ((cb_per_view_global_changed_registers & field_registers_mask) != 0)
+               {
+                  text += std::string(text.empty() ? "" : " ") + field.name;
+               }
+            }
+            ImGui::TextWrapped(text.empty() ? "None" : text.c_str(), "");
+
             ImGui::EndTabItem(); // Info
          }
 #endif // DEVELOPMENT || TEST
@@ -8118,6 +8414,7 @@ void Init(bool async)
    // ShadowBlur - SSDO Blur
    shader_hashes_SSDO_Blur.pixel_shaders.emplace(std::stoul("1023CD1B", nullptr, 16));
    //TODOFT: once we have collected 100% of the game shaders, update these hashes lists, and make global functions to convert hashes between string and int
+   BuildShaderRolesTable();
 
    cb_luma_frame_settings.DisplayMode = 1; // Default to HDR in case we had no prior config, it will be automatically disabled if the current display doesn't support it (when the swapchain is created, which should be guaranteed to be after)
    cb_luma_frame_settings.ScenePeakWhite = default_peak_white;
@@ -8198,13 +8495,22 @@ void Init(bool async)
       }
    }
 
+   if (!prevent_shader_cache_loading)
+   {
+      shaders_bytecode_pack.Open(GetShaderPath() / shaders_bytecode_pack_file_name);
+      shaders_dependency_graph.Load(GetShaderPath() / shaders_dependency_graph_file_name);
+   }
+   // Automatically reload shaders when they are edited while the game is running (the folder has been created by the shaders cache above if it didn't exist yet)
+   shaders_directory_watcher.Start(background_jobs, GetShaderPath(), true, std::chrono::milliseconds(200), OnShaderFilesChanged);
+
    // Pre-load all shaders to minimize the wait before replacing them after they are found in game ("auto_load"),
    // and to fill the list of shaders we customized, so we can know which ones we need replace on the spot.
    if (async && precompile_custom_shaders)
    {
       thread_auto_compiling_running = true;
       static std::binary_semaphore async_shader_compilation_semaphore{ 0 };
-      thread_auto_compiling = std::thread([]
+      // The game can't draw with our shaders until this is done, so it's render critical (it stops early if "shaders_compilation_generation" changes, so it ignores the cancellation)
+      auto_compiling_job = background_jobs.submit(JobPriority::RenderCritical, [](const std::atomic<bool>& /*cancelled*/)
          {
             // We need to lock this mutex for the whole async shader loading, so that if the game starts loading shaders (from another thread), we can already see if we have a custom version and live load it ("live_load"), otherwise the "custom_shaders_cache" list would be incomplete
             const std::unique_lock lock_loading(s_mutex_loading);
@@ -8224,31 +8530,25 @@ void Init(bool async)
             }
             thread_auto_compiling_running = false;
          });
-      async_shader_compilation_semaphore.acquire();
+      if (auto_compiling_job.valid())
+      {
+         async_shader_compilation_semaphore.acquire();
+      }
+      else
+      {
+         thread_auto_compiling_running = false;
+      }
    }
 }
 
 // This can't be called on "DLL_PROCESS_DETACH" as it needs a multi threaded enviroment
 void Uninit()
 {
-   if (thread_auto_dumping.joinable())
-   {
-      thread_auto_dumping.join();
-   }
-   if (thread_auto_compiling.joinable())
-   {
-      thread_auto_compiling.join();
-   }
-   {
-      const std::shared_lock lock(s_mutex_device);
-      for (auto global_device_data : global_devices_data)
-      {
-         if (global_device_data->thread_auto_loading.joinable())
-         {
-            global_device_data->thread_auto_loading.join();
-         }
-      }
-   }
+   shaders_directory_watcher.Stop();
+   // Make the precompilation stop at the next shader
+   shaders_compilation_generation++;
+   // Cancel and wait for all the background jobs (including the devices ones), and stop their workers (new ones are started if we get initialized again)
+   background_jobs.shutdown();
 
    has_init = false;
 }
@@ -8301,41 +8601,27 @@ BOOL APIENTRY DllMain(HMODULE h_module, DWORD fdw_reason, LPVOID lpv_reserved)
       shader_compiler_path.append("d3dcompiler_47.dll");
       if (std::filesystem::is_regular_file(shader_compiler_path))
       {
-         bool old_version = true;
-         DWORD verHandle = 0;
-         DWORD verSize = GetFileVersionInfoSize(shader_compiler_path.c_str(), &verHandle);
-         if (verSize != NULL)
-         {
-            LPSTR verData = new char[verSize];
-            if (GetFileVersionInfo(shader_compiler_path.c_str(), verHandle, verSize, verData))
-            {
-               LPBYTE lpBuffer = NULL;
-               UINT size = 0;
-               if (VerQueryValue(verData, L"\\", (VOID FAR * FAR*) & lpBuffer, &size))
-               {
-                  if (size)
-                  {
-                     VS_FIXEDFILEINFO* verInfo = (VS_FIXEDFILEINFO*)lpBuffer;
-                     if (verInfo->dwSignature == 0xfeef04bd)
-                     {
-                        // The version would be v1.v2.v3.v4
-                        const auto v1 = (verInfo->dwFileVersionMS >> 16) & 0xffff;
-                        const auto v2 = (verInfo->dwFileVersionMS >> 0) & 0xffff;
-                        const auto v3 = (verInfo->dwFileVersionLS >> 16) & 0xffff;
-                        const auto v4 = (verInfo->dwFileVersionLS >> 0) & 0xffff;
-                        old_version = v1 <= 6 && v2 <= 3 && v3 <= 9600 && v3 <= 16384;
-                     }
-                  }
-               }
-            }
-            delete[] verData;
-         }
+         shader_compiler_version = utils::shader::compiler::GetLibraryFileVersion(shader_compiler_path.c_str());
+         // The version would be v1.v2.v3.v4
+         const auto v1 = (shader_compiler_version >> 48) & 0xffff;
+         const auto v2 = (shader_compiler_version >> 32) & 0xffff;
+         const auto v3 = (shader_compiler_version >> 16) & 0xffff;
+         const bool old_version = shader_compiler_version == 0 || (v1 <= 6 && v2 <= 3 && v3 <= 9600 && v3 <= 16384);
          if (old_version)
          {
             MessageBoxA(game_window, "Please stop the game and remove \"d3dcompiler_47.dll\" from the game executable directory;\nthe game came bundled with an old version that is worse in all aspects.\nIf you are on Proton, manually update it to the latest version.", NAME, MB_SETFOREGROUND);
             prevent_shader_cache_saving = true;
          }
       }
+      else
+      {
+         // Otherwise the one from the system directory is loaded
+         wchar_t system_directory[MAX_PATH] = L"";
+         GetSystemDirectoryW(system_directory, ARRAYSIZE(system_directory));
+         shader_compiler_path = system_directory;
+         shader_compiler_path.append("d3dcompiler_47.dll");
+         shader_compiler_version = utils::shader::compiler::GetLibraryFileVersion(shader_compiler_path.c_str());
+      }
 
 #if DISABLE_RESHADE
       if (!asi_loaded) return FALSE;
@@ -8376,9 +8662,9 @@ BOOL APIENTRY DllMain(HMODULE h_module, DWORD fdw_reason, LPVOID lpv_reserved)
 
       reshade::register_event<reshade::addon_event::bind_pipeline>(OnBindPipeline);
 
-#if DEVELOPMENT
       reshade::register_event<reshade::addon_event::init_resource>(OnInitResource);
       reshade::register_event<reshade::addon_event::destroy_resource>(OnDestroyResource);
+#if DEVELOPMENT
       reshade::register_event<reshade::addon_event::init_resource_view>(OnInitResourceView);
       reshade::register_event<reshade::addon_event::destroy_resource_view>(OnDestroyResourceView);
 #endif // DEVELOPMENT
@@ -8447,9 +8733,9 @@ BOOL APIENTRY DllMain(HMODULE h_module, DWORD fdw_reason, LPVOID lpv_reserved)
 
       reshade::unregister_event<reshade::addon_event::bind_pipeline>(OnBindPipeline);
 
-#if DEVELOPMENT
       reshade::unregister_event<reshade::addon_event::init_resource>(OnInitResource);
       reshade::unregister_event<reshade::addon_event::destroy_resource>(OnDestroyResource);
+#if DEVELOPMENT
       reshade::unregister_event<reshade::addon_event::init_resource_view>(OnInitResourceView);
       reshade::unregister_event<reshade::addon_event::destroy_resource_view>(OnDestroyResourceView);
 #endif // DEVELOPMENT
@@ -8492,33 +8778,14 @@ BOOL APIENTRY DllMain(HMODULE h_module, DWORD fdw_reason, LPVOID lpv_reserved)
 
       reshade::unregister_addon(h_module);
 
-      // In case our threads are still not joined, detach them and safely do a busy loop
-      // until they finished running, so we don't risk them reading/writing to stale memory.
-      // This could cause a bit of wait, especially if we just booted the game and shaders are still compiling,
-      // but there's no nice and clear alternatively really.
-      // This is needed because DLL loading/unloading is completely single threaded and isn't
-      // able to join threads (though "thread.detach()" somehow seems to work).
+      // In case our background jobs workers are still not joined, cancel all their jobs and detach them, they exit on their own as soon as their current job returns.
+      // We can't wait for them here, as DLL loading/unloading is completely single threaded and isn't able to join threads (though "thread.detach()" somehow seems to work),
+      // and busy waiting could stall the unloading for a while (e.g. if we just booted the game and shaders are still compiling).
+      // If the process is terminating, all the other threads have already been killed, so there's nothing to cancel.
       // Note that there's no need to call "Uninit()" here, independently on whether we are asi or ReShade loaded.
-      if (thread_auto_dumping.joinable())
-      {
-         thread_auto_dumping.detach();
-         while (thread_auto_dumping_running) {}
-      }
-      if (thread_auto_compiling.joinable())
-      {
-         thread_auto_compiling.detach();
-         while (thread_auto_compiling_running) {}
-      }
-      // We can't lock "s_mutex_device" here, but we also know that if this ptr is valid, then there's no other thread able to run now and change it.
-      // ReShade is unloaded when the last device is destroyed so we should have already received an event to clear this thread anyway.
-      for (auto global_device_data : global_devices_data)
-      {
-         if (global_device_data->thread_auto_loading.joinable())
-         {
-            global_device_data->thread_auto_loading.detach();
-            while (global_device_data->thread_auto_loading_running) {}
-         }
-      }
+      shaders_compilation_generation++;
+      shaders_directory_watcher.StopDetached();
+      background_jobs.shutdown_detached(lpv_reserved != nullptr);
 
       break;
    }
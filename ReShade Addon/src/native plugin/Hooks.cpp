@@ -2,6 +2,10 @@
 
 #include <dxgi1_4.h>
 
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+
 #include "includes/SharedBegin.h"
 
 #include "DKUtil/Impl/Hook/Shared.hpp"
@@ -12,6 +16,30 @@ namespace Hooks
 	RE::ETEX_Format LDRPostProcessFormat = defaultLDRPostProcessFormat;
 	RE::ETEX_Format HDRPostProcessFormat = defaultHDRPostProcessFormat;
 
+	// On unknown game builds the offsets might be wrong, so we only write over values that are what we expect to find there, otherwise we'd corrupt (or crash on) random memory.
+	// On known builds, the offsets tables have been verified already, so any value is accepted (we only make sure the site is within the game code).
+	template <typename T>
+	bool IsPatchSiteValid(uintptr_t a_address, std::initializer_list<T> a_expectedValues)
+	{
+		if (!Offsets::IsCodeAddress(a_address, sizeof(T))) {
+			return false;
+		}
+		if (Offsets::knownGameVersion) {
+			return true;
+		}
+		T value;
+		std::memcpy(&value, reinterpret_cast<const void*>(a_address), sizeof(T));
+		return std::find(a_expectedValues.begin(), a_expectedValues.end(), value) != a_expectedValues.end();
+	}
+
+	// Texture format immediates are expected to be either the original game formats or any of the ones we might have written
+	void PatchTextureFormat(uintptr_t a_address, RE::ETEX_Format a_format)
+	{
+		if (IsPatchSiteValid<RE::ETEX_Format>(a_address, { RE::ETEX_Format::eTF_R8G8B8A8, RE::ETEX_Format::eTF_R10G10B10A2, RE::ETEX_Format::eTF_R11G11B10F, RE::ETEX_Format::eTF_R16G16B16A16F })) {
+			dku::Hook::WriteImm(a_address, a_format);
+		}
+	}
+
 	void Patches::SetTexturesFormats(RE::ETEX_Format _LDRPostProcessFormat, RE::ETEX_Format _HDRPostProcessFormat)
 	{
 		LDRPostProcessFormat = _LDRPostProcessFormat;
@@ -22,23 +50,23 @@ namespace Hooks
 			// SPostEffectsUtils::Create
 			const auto address = Offsets::GetAddress(Offsets::SPostEffectsUtils_Create);
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_PrevFrameScaled_1), LDRPostProcessFormat);   // $PrevFrameScaled (recreate)
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_PrevFrameScaled_2), LDRPostProcessFormat);   // $PrevFrameScaled (initial)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_PrevFrameScaled_1), LDRPostProcessFormat);   // $PrevFrameScaled (recreate)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_PrevFrameScaled_2), LDRPostProcessFormat);   // $PrevFrameScaled (initial)
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d2_1), LDRPostProcessFormat);   // $BackBufferScaled_d2 (recreate)
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d2_2), LDRPostProcessFormat);   // $BackBufferScaled_d2 (initial)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d2_1), LDRPostProcessFormat);   // $BackBufferScaled_d2 (recreate)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d2_2), LDRPostProcessFormat);   // $BackBufferScaled_d2 (initial)
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaledTemp_d2_1), LDRPostProcessFormat);   // $BackBufferScaledTemp_d2 (recreate)
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaledTemp_d2_2), LDRPostProcessFormat);   // $BackBufferScaledTemp_d2 (initial)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaledTemp_d2_1), LDRPostProcessFormat);   // $BackBufferScaledTemp_d2 (recreate)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaledTemp_d2_2), LDRPostProcessFormat);   // $BackBufferScaledTemp_d2 (initial)
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d4_1), LDRPostProcessFormat);   // $BackBufferScaled_d4 (recreate)
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d4_2), LDRPostProcessFormat);   // $BackBufferScaled_d4 (initial)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d4_1), LDRPostProcessFormat);   // $BackBufferScaled_d4 (recreate)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d4_2), LDRPostProcessFormat);   // $BackBufferScaled_d4 (initial)
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaledTemp_d4_1), LDRPostProcessFormat);   // $BackBufferScaledTemp_d4 (recreate)
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaledTemp_d4_2), LDRPostProcessFormat);   // $BackBufferScaledTemp_d4 (initial)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaledTemp_d4_1), LDRPostProcessFormat);   // $BackBufferScaledTemp_d4 (recreate)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaledTemp_d4_2), LDRPostProcessFormat);   // $BackBufferScaledTemp_d4 (initial)
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d8_1), LDRPostProcessFormat);   // $BackBufferScaled_d8 (recreate)
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d8_2), LDRPostProcessFormat);   // $BackBufferScaled_d8 (initial)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d8_1), LDRPostProcessFormat);   // $BackBufferScaled_d8 (recreate)
+			PatchTextureFormat(address + Offsets::Get(Offsets::SPostEffectsUtils_Create_BackBufferScaled_d8_2), LDRPostProcessFormat);   // $BackBufferScaled_d8 (initial)
 		}
 
 		// Patch internal CryEngine RGBA8 to RGBA16F (or whatever format)
@@ -47,8 +75,8 @@ namespace Hooks
 			// CTexture::GenerateSceneMap
 			const auto address = Offsets::GetAddress(Offsets::CTexture_GenerateSceneMap);
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateSceneMap_BackBuffer_1), LDRPostProcessFormat);   // $BackBuffer
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateSceneMap_BackBuffer_2), LDRPostProcessFormat);   // $BackBuffer
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateSceneMap_BackBuffer_1), LDRPostProcessFormat);   // $BackBuffer
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateSceneMap_BackBuffer_2), LDRPostProcessFormat);   // $BackBuffer
 		}
 
 		// LUT (Color Grading Chart). This can either be RGBA8 (as it was) or RGBA16F. Theoretically it could be R10G10B10A2 as we don't use the alpha channel.
@@ -57,8 +85,8 @@ namespace Hooks
 			// CColorGradingControllerD3D::InitResources
 			const auto address = Offsets::GetAddress(Offsets::CColorGradingControllerD3D_InitResources);
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CColorGradingControllerD3D_InitResources_ColorGradingMergeLayer0), RE::ETEX_Format::eTF_R16G16B16A16F);  // ColorGradingMergeLayer0
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CColorGradingControllerD3D_InitResources_ColorGradingMergeLayer1), RE::ETEX_Format::eTF_R16G16B16A16F);  // ColorGradingMergeLayer1
+			PatchTextureFormat(address + Offsets::Get(Offsets::CColorGradingControllerD3D_InitResources_ColorGradingMergeLayer0), RE::ETEX_Format::eTF_R16G16B16A16F);  // ColorGradingMergeLayer0
+			PatchTextureFormat(address + Offsets::Get(Offsets::CColorGradingControllerD3D_InitResources_ColorGradingMergeLayer1), RE::ETEX_Format::eTF_R16G16B16A16F);  // ColorGradingMergeLayer1
 		}
 
 		// These were R11G11B10F (or possibly already R16G16B16A16F?)
@@ -71,13 +99,13 @@ namespace Hooks
 			// CTexture::GenerateHDRMaps
 			const auto address = Offsets::GetAddress(Offsets::CTexture_GenerateHDRMaps);
 
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_BitsPerPixel), HDRPostProcessFormat);  // used to calculate bits per pixel
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_HDRTargetPrev), HDRPostProcessFormat);  // $HDRTargetPrev: used for screen space reflections (SSR), Water Volumes (? possibly not in Prey), SVO (? probably not in Prey), Motion Blur (if DoF is enabled?)
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_HDRTempBloom0), HDRPostProcessFormat);  // $HDRTempBloom0: Bloom intermediary texture
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_HDRTempBloom1), HDRPostProcessFormat);  // $HDRTempBloom1: Bloom intermediary texture
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_HDRFinalBloom), HDRPostProcessFormat);  // $HDRFinalBloom: Bloom final target
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_SceneTargetR11G11B10F_0), HDRPostProcessFormat);  // $SceneTargetR11G11B10F_0: used by Lens Optics, Motion Blur (if DoF is disabled?), and DoF (?)
-			dku::Hook::WriteImm(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_SceneTargetR11G11B10F_1), HDRPostProcessFormat);  // $SceneTargetR11G11B10F_1: used by Screen Space SubSurfaceScattering (SSSSS), Water Volume Caustics (?), ...
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_BitsPerPixel), HDRPostProcessFormat);  // used to calculate bits per pixel
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_HDRTargetPrev), HDRPostProcessFormat);  // $HDRTargetPrev: used for screen space reflections (SSR), Water Volumes (? possibly not in Prey), SVO (? probably not in Prey), Motion Blur (if DoF is enabled?)
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_HDRTempBloom0), HDRPostProcessFormat);  // $HDRTempBloom0: Bloom intermediary texture
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_HDRTempBloom1), HDRPostProcessFormat);  // $HDRTempBloom1: Bloom intermediary texture
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_HDRFinalBloom), HDRPostProcessFormat);  // $HDRFinalBloom: Bloom final target
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_SceneTargetR11G11B10F_0), HDRPostProcessFormat);  // $SceneTargetR11G11B10F_0: used by Lens Optics, Motion Blur (if DoF is disabled?), and DoF (?)
+			PatchTextureFormat(address + Offsets::Get(Offsets::CTexture_GenerateHDRMaps_SceneTargetR11G11B10F_1), HDRPostProcessFormat);  // $SceneTargetR11G11B10F_1: used by Screen Space SubSurfaceScattering (SSSSS), Water Volume Caustics (?), ...
 		}
 
 #if !ADD_NEW_RENDER_TARGETS && 0 // Force upgrade all the texture we'd replace later too (this leads to issues, like some objects having purple reflections etc) (only compatible with the Steam base game)
@@ -112,8 +140,12 @@ namespace Hooks
 			const auto address = Offsets::GetAddress(Offsets::OnHFOVChanged);
 
 			uint8_t nop8[] = { 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90 };
+			const uint8_t minss[] = { 0xF3, 0x0F, 0x5D };
 
-			dku::Hook::WriteData(address + Offsets::Get(Offsets::OnHFOVChanged_Offset), &nop8, sizeof(nop8));  // minss -> nop
+			const auto patchAddress = address + Offsets::Get(Offsets::OnHFOVChanged_Offset);
+			if (Offsets::IsCodeAddress(patchAddress, sizeof(nop8)) && (Offsets::knownGameVersion || std::memcmp(reinterpret_cast<const void*>(patchAddress), minss, sizeof(minss)) == 0)) {
+				dku::Hook::WriteData(patchAddress, &nop8, sizeof(nop8));  // minss -> nop
+			}
 		}
 
 #if 0 // Old code branches to change the jitters scale depending on the rendering resolution (we tried *2, /2, etc), none of this was seemengly needed (Steam base game only)
@@ -145,10 +177,9 @@ namespace Hooks
 	void Patches::SetHaltonSequencePhases(unsigned int phases)
 	{
 		static unsigned int lastWrittenPhases = 16; // Default game value
+		static unsigned int lastWrittenValue = 16 - 1; // Default game value (see below)
 		if (phases != lastWrittenPhases)
 		{
-			lastWrittenPhases = phases;
-
 			const auto jittersAddress = Offsets::GetAddress(Offsets::CD3D9Renderer_RT_RenderScene) + Offsets::Get(Offsets::CD3D9Renderer_RT_RenderScene_Jitters);
 			constexpr int validValues[] = { 1, 2, 4, 8, 16, 32, 64, 128 }; // 1 works, it disables jitters
 
@@ -167,6 +198,13 @@ namespace Hooks
 			// Our hook takes a value scaled down by 1.
 			closestPhases--;
 
+			// Don't update "lastWrittenPhases" if we can't patch, it's a cheap check to repeat
+			if (!IsPatchSiteValid<unsigned int>(jittersAddress, { lastWrittenValue })) {
+				return;
+			}
+			lastWrittenPhases = phases;
+			lastWrittenValue = closestPhases;
+
 			// Change Halton pattern generation (r_AntialiasingTAAPattern 10, which is Halton 16 phases) to using a phase of x, this works a lot better with DLSS
 			dku::Hook::WriteImm(jittersAddress, closestPhases);
 		}
@@ -126,7 +126,11 @@ public:
 
 
 	static inline uintptr_t baseAddress;
+	// The range of the executable sections of the game module (it's the only memory we ever patch)
+	static inline uintptr_t codeBegin = 0;
+	static inline uintptr_t codeEnd = 0;
 	static inline GameVersion gameVersion;
+	static inline bool knownGameVersion = false;
 	static inline RE::CD3D9Renderer* pCD3D9Renderer = nullptr;
 	static inline uint32_t* cvar_r_AntialiasingMode = nullptr;
 
@@ -138,17 +142,45 @@ public:
 		return baseAddress + a_offsetArray[static_cast<size_t>(gameVersion)];
 	}
 
-	static uint32_t GetModuleTimestamp(HMODULE a_moduleHandle) {
-		// Get the DOS header
+	static bool IsCodeAddress(uintptr_t a_address, size_t a_size = 1) {
+		return a_address >= codeBegin && a_address <= codeEnd && a_size <= codeEnd - a_address;
+	}
+
+	static IMAGE_NT_HEADERS* GetModuleNTHeaders(HMODULE a_moduleHandle) {
 		auto dosHeader = reinterpret_cast<IMAGE_DOS_HEADER*>(a_moduleHandle);
 		if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE) {
-			return 0;
+			return nullptr;
 		}
-
-		// Get the NT headers
-		auto ntHeaders = reinterpret_cast<IMAGE_NT_HEADERS*>(
-			reinterpret_cast<uint8_t*>(a_moduleHandle) + dosHeader->e_lfanew);
+		auto ntHeaders = reinterpret_cast<IMAGE_NT_HEADERS*>(reinterpret_cast<uint8_t*>(a_moduleHandle) + dosHeader->e_lfanew);
 		if (ntHeaders->Signature != IMAGE_NT_SIGNATURE) {
+			return nullptr;
+		}
+		return ntHeaders;
+	}
+
+	// Finds the range that covers all the executable sections of the module
+	static void InitCodeRange(HMODULE a_moduleHandle) {
+		codeBegin = 0;
+		codeEnd = 0;
+		auto ntHeaders = GetModuleNTHeaders(a_moduleHandle);
+		if (!ntHeaders) {
+			return;
+		}
+		const auto* section = IMAGE_FIRST_SECTION(ntHeaders);
+		for (WORD i = 0; i < ntHeaders->FileHeader.NumberOfSections; i++, section++) {
+			if ((section->Characteristics & IMAGE_SCN_MEM_EXECUTE) == 0) {
+				continue;
+			}
+			const uintptr_t sectionBegin = baseAddress + section->VirtualAddress;
+			const uintptr_t sectionEnd = sectionBegin + section->Misc.VirtualSize;
+			codeBegin = (codeBegin == 0 || sectionBegin < codeBegin) ? sectionBegin : codeBegin;
+			codeEnd = sectionEnd > codeEnd ? sectionEnd : codeEnd;
+		}
+	}
+
+	static uint32_t GetModuleTimestamp(HMODULE a_moduleHandle) {
+		auto ntHeaders = GetModuleNTHeaders(a_moduleHandle);
+		if (!ntHeaders) {
 			return 0;
 		}
 
@@ -164,10 +196,12 @@ public:
 			return false;
 		}
 		baseAddress = reinterpret_cast<uintptr_t>(handle);
+		InitCodeRange(handle);
 
 		uint32_t moduleTimestamp = GetModuleTimestamp(handle);
 		const auto search = knownTimestamps.find(moduleTimestamp);
-		if (search != knownTimestamps.end()) {
+		knownGameVersion = search != knownTimestamps.end();
+		if (knownGameVersion) {
 			gameVersion = search->second;
 		} else {
 			// Default to the latest known built version of the base game
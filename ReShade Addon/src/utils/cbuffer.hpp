@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CBUFFER_SSE2 1
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define CBUFFER_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+// Vectorized helpers to quickly identify, validate and diff constant buffers we read back from the game (e.g. on every map),
+// given the same buffers (e.g. the one for shadow maps or cubemap views) are often uploaded with the exact same data multiple times per frame.
+// Constant buffers are handled as arrays of 16 byte registers (like in shaders), their size needs to be a multiple of 16.
+// AVX2 is only used if the project is compiled with it, SSE2 is always available on x64, the scalar versions are only there for other architectures.
+namespace utils::cbuffer
+{
+   constexpr size_t register_size = 16;
+   // Max size supported by "CompareRegisters()", as it returns one bit per register
+   constexpr size_t max_compared_size = register_size * 64;
+
+   // Returns a 64 bit hash of the buffer, it's not meant to be resistant to collisions, only to (very quickly) tell buffers apart,
+   // with the full data being compared after if needed.
+   static uint64_t ComputeFingerprint(const void* data, size_t size)
+   {
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+      uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+#if CBUFFER_SSE2
+      // Accumulate with xors and rotations (different per lane), only mixing it up properly at the end
+      __m128i accumulator = _mm_setzero_si128();
+      size_t i = 0;
+#if CBUFFER_AVX2
+      __m256i accumulator_256 = _mm256_setzero_si256();
+      for (; i + 32 <= size; i += 32)
+      {
+         const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+         accumulator_256 = _mm256_xor_si256(_mm256_or_si256(_mm256_slli_epi64(accumulator_256, 7), _mm256_srli_epi64(accumulator_256, 57)), value);
+      }
+      accumulator = _mm_xor_si128(_mm256_castsi256_si128(accumulator_256), _mm256_extracti128_si256(accumulator_256, 1));
+#endif // CBUFFER_AVX2
+      for (; i + 16 <= size; i += 16)
+      {
+         const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+         accumulator = _mm_xor_si128(_mm_or_si128(_mm_slli_epi64(accumulator, 7), _mm_srli_epi64(accumulator, 57)), value);
+      }
+      alignas(16) uint64_t lanes[2];
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+      hash = (hash ^ lanes[0]) * 0xFF51AFD7ED558CCDull;
+      hash = (hash ^ lanes[1]) * 0xC4CEB9FE1A85EC53ull;
+      bytes += i;
+      size -= i;
+#endif // CBUFFER_SSE2
+      for (size_t j = 0; j < size; j++)
+      {
+         hash = (hash ^ bytes[j]) * 0x100000001B3ull;
+      }
+      return hash ^ (hash >> 33);
+   }
+
+   // Returns a mask with one bit set for each 16 byte register that is different between the two buffers
+   static uint64_t CompareRegisters(const void* a, const void* b, size_t size)
+   {
+      const uint8_t* bytes_a = static_cast<const uint8_t*>(a);
+      const uint8_t* bytes_b = static_cast<const uint8_t*>(b);
+      const size_t registers = size / register_size;
+      uint64_t changed_mask = 0;
+      size_t i = 0;
+#if CBUFFER_AVX2
+      for (; i + 2 <= registers; i += 2)
+      {
+         const __m256i value_a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes_a + i * register_size));
+         const __m256i value_b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes_b + i * register_size));
+         const uint32_t equal_bytes = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(value_a, value_b)));
+         changed_mask |= uint64_t((equal_bytes & 0xFFFF) != 0xFFFF) << i;
+         changed_mask |= uint64_t((equal_bytes >> 16) != 0xFFFF) << (i + 1);
+      }
+#endif // CBUFFER_AVX2
+#if CBUFFER_SSE2
+      for (; i < registers; i++)
+      {
+         const __m128i value_a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes_a + i * register_size));
+         const __m128i value_b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes_b + i * register_size));
+         changed_mask |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(value_a, value_b)) != 0xFFFF) << i;
+      }
+#else
+      for (; i < registers; i++)
+      {
+         changed_mask |= uint64_t(std::memcmp(bytes_a + i * register_size, bytes_b + i * register_size, register_size) != 0) << i;
+      }
+#endif // CBUFFER_SSE2
+      return changed_mask;
+   }
+
+   // Checks that all 4 (float) values are > "min" (or >= if "inclusive")
+   static bool AllGreater(const float* values, float min, bool inclusive = false)
+   {
+#if CBUFFER_SSE2
+      const __m128 value = _mm_loadu_ps(values);
+      const __m128 comparison = inclusive ? _mm_cmpge_ps(value, _mm_set1_ps(min)) : _mm_cmpgt_ps(value, _mm_set1_ps(min));
+      return _mm_movemask_ps(comparison) == 0xF;
+#else
+      return inclusive ? (values[0] >= min && values[1] >= min && values[2] >= min && values[3] >= min) : (values[0] > min && values[1] > min && values[2] > min && values[3] > min);
+#endif // CBUFFER_SSE2
+   }
+
+   // Checks that all 4 (float) values are > "min" and <= "max"
+   static bool AllInRange(const float* values, float min, float max)
+   {
+#if CBUFFER_SSE2
+      const __m128 value = _mm_loadu_ps(values);
+      const __m128 comparison = _mm_and_ps(_mm_cmpgt_ps(value, _mm_set1_ps(min)), _mm_cmple_ps(value, _mm_set1_ps(max)));
+      return _mm_movemask_ps(comparison) == 0xF;
+#else
+      for (size_t i = 0; i < 4; i++)
+      {
+         if (!(values[i] > min && values[i] <= max)) return false;
+      }
+      return true;
+#endif // CBUFFER_SSE2
+   }
+
+   // Remembers the result of the validation of the last few buffers, so that if the same buffer data is validated again, the result can be returned directly.
+   // The data is compared in full, so a fingerprint collision can't ever return the wrong result.
+   // Verdicts are only valid for the validation function they came from, so there should be one cache per validation function and state it depends on (e.g. one per device).
+   // Thread safe: "Find()" and "Add()" lock, which is expected to be uncontended (buffers are usually uploaded from a single thread), two threads validating the same data at once simply add it twice.
+   template<size_t size, size_t entries_num = 8>
+   class VerdictCache
+   {
+      static_assert(size % register_size == 0);
+
+   public:
+      // Returns true (and the previous verdict) if the same data has been validated recently
+      bool Find(const void* data, uint64_t fingerprint, bool& verdict) const
+      {
+         const std::lock_guard lock(mutex);
+         for (const auto& entry : entries)
+         {
+            if (entry.valid && entry.fingerprint == fingerprint && CompareRegisters(entry.data, data, size) == 0)
+            {
+               verdict = entry.verdict;
+               return true;
+            }
+         }
+         return false;
+      }
+
+      // Replaces the oldest entry
+      void Add(const void* data, uint64_t fingerprint, bool verdict)
+      {
+         const std::lock_guard lock(mutex);
+         auto& entry = entries[next_entry];
+         next_entry = (next_entry + 1) % entries_num;
+         entry.valid = true;
+         entry.verdict = verdict;
+         entry.fingerprint = fingerprint;
+         std::memcpy(entry.data, data, size);
+      }
+
+      void Clear()
+      {
+         const std::lock_guard lock(mutex);
+         for (auto& entry : entries)
+         {
+            entry.valid = false;
+         }
+      }
+
+   private:
+      struct Entry
+      {
+         alignas(32) uint8_t data[size] = {};
+         uint64_t fingerprint = 0;
+         bool verdict = false;
+         bool valid = false;
+      };
+
+      std::array<Entry, entries_num> entries;
+      size_t next_entry = 0;
+      mutable std::mutex mutex;
+   };
+}
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdint>
+#include <unordered_map>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "../includes/job_system.h"
+
+// Watches a directory for file changes (through "ReadDirectoryChangesW()", or "inotify" outside of Windows) on a (long running) job of a "job_system", that sleeps until the OS notifies it.
+// The job occupies one of the job system workers until the watcher is stopped, and as cancelling it doesn't wake it up, the watcher needs to be stopped before the job system is drained or shut down.
+// Changes are batched until no new ones arrived for the "debounce" time, as editors often save files through multiple operations (e.g. writing a temporary file and then renaming it),
+// so a single save only ever results in a single callback.
+namespace utils::files
+{
+   class DirectoryWatcher
+   {
+   public:
+      // Called from the watcher job, with the (full) paths of all the files that have been added, modified or renamed.
+      // If the OS couldn't keep track of all the changes, the directory itself is returned, meaning that anything could have changed.
+      using Callback = std::function<void(const std::vector<std::filesystem::path>&)>;
+
+      DirectoryWatcher() = default;
+      DirectoryWatcher(const DirectoryWatcher&) = delete;
+      DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+      ~DirectoryWatcher()
+      {
+         StopDetached();
+      }
+
+      bool Start(job_system& jobs, const std::filesystem::path& in_directory, bool in_recursive, std::chrono::milliseconds in_debounce_time, Callback in_callback)
+      {
+         Stop();
+
+#ifdef _WIN32
+         directory_handle = CreateFileW(in_directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+         if (directory_handle == INVALID_HANDLE_VALUE)
+         {
+            directory_handle = nullptr;
+            return false;
+         }
+         stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+         changes_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+         if (stop_event == nullptr || changes_event == nullptr)
+         {
+            CloseHandles();
+            return false;
+         }
+#else
+         inotify_handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+         stop_handle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+         if (inotify_handle < 0 || stop_handle < 0 || !AddWatch(in_directory, in_recursive))
+         {
+            CloseHandles();
+            return false;
+         }
+#endif
+
+         directory = in_directory;
+         recursive = in_recursive;
+         debounce_time = in_debounce_time;
+         callback = std::move(in_callback);
+         job = jobs.submit(JobPriority::IO, [this](const std::atomic<bool>& cancelled) { Run(cancelled); });
+         // The job system is shutting down
+         if (!job.valid())
+         {
+            CloseHandles();
+            return false;
+         }
+         return true;
+      }
+
+      void Stop()
+      {
+         if (job.valid())
+         {
+            SignalStop();
+            job.wait();
+            job = {};
+         }
+         CloseHandles();
+      }
+
+      // For when the dll is being unloaded (or the process is exiting), we can't wait for other threads under the loader lock, so just tell the job to stop (the OS handles are leaked)
+      void StopDetached()
+      {
+         if (job.valid())
+         {
+            SignalStop();
+            job = {};
+         }
+      }
+
+   private:
+#ifdef _WIN32
+      void SignalStop()
+      {
+         SetEvent(stop_event);
+      }
+
+      void Run(const std::atomic<bool>& cancelled)
+      {
+         std::vector<DWORD> buffer(64 * 1024 / sizeof(DWORD)); // Needs to be DWORD aligned
+         OVERLAPPED overlapped = {};
+         overlapped.hEvent = changes_event;
+         constexpr DWORD notify_filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+
+         std::set<std::filesystem::path> changed_files;
+         bool reading = false;
+         while (true)
+         {
+            if (!reading)
+            {
+               ResetEvent(changes_event);
+               if (!ReadDirectoryChangesW(directory_handle, buffer.data(), DWORD(buffer.size() * sizeof(DWORD)), recursive, notify_filter, nullptr, &overlapped, nullptr))
+               {
+                  break;
+               }
+               reading = true;
+            }
+
+            const HANDLE events[] = { stop_event, changes_event };
+            const DWORD wait_result = WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, changed_files.empty() ? INFINITE : DWORD(debounce_time.count()));
+            if (cancelled.load(std::memory_order_acquire))
+            {
+               break;
+            }
+            if (wait_result == WAIT_OBJECT_0 + 1)
+            {
+               reading = false;
+               DWORD bytes = 0;
+               if (!GetOverlappedResult(directory_handle, &overlapped, &bytes, FALSE))
+               {
+                  break;
+               }
+               // The buffer overflowed, we lost track of what changed
+               if (bytes == 0)
+               {
+                  changed_files.emplace(directory);
+                  continue;
+               }
+               const uint8_t* entry_data = reinterpret_cast<const uint8_t*>(buffer.data());
+               while (true)
+               {
+                  const FILE_NOTIFY_INFORMATION* entry = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(entry_data);
+                  // The previous names of renamed files and removed files can be ignored, they aren't there anymore
+                  if (entry->Action != FILE_ACTION_REMOVED && entry->Action != FILE_ACTION_RENAMED_OLD_NAME)
+                  {
+                     changed_files.emplace(directory / std::wstring(entry->FileName, entry->FileNameLength / sizeof(WCHAR)));
+                  }
+                  if (entry->NextEntryOffset == 0) break;
+                  entry_data += entry->NextEntryOffset;
+               }
+            }
+            else if (wait_result == WAIT_TIMEOUT)
+            {
+               // Nothing else changed for a while, send out all the changes together
+               callback(std::vector<std::filesystem::path>(changed_files.begin(), changed_files.end()));
+               changed_files.clear();
+            }
+            else
+            {
+               break;
+            }
+         }
+
+         if (reading)
+         {
+            CancelIoEx(directory_handle, &overlapped);
+            DWORD bytes = 0;
+            GetOverlappedResult(directory_handle, &overlapped, &bytes, TRUE);
+         }
+      }
+
+      void CloseHandles()
+      {
+         if (directory_handle != nullptr)
+         {
+            CloseHandle(directory_handle);
+            directory_handle = nullptr;
+         }
+         if (stop_event != nullptr)
+         {
+            CloseHandle(stop_event);
+            stop_event = nullptr;
+         }
+         if (changes_event != nullptr)
+         {
+            CloseHandle(changes_event);
+            changes_event = nullptr;
+         }
+      }
+#else
+      void SignalStop()
+      {
+         const uint64_t value = 1;
+         [[maybe_unused]] const auto written = write(stop_handle, &value, sizeof(value));
+      }
+
+      // "inotify" isn't recursive, so each sub directory needs its own watch
+      bool AddWatch(const std::filesystem::path& watched_directory, bool watch_sub_directories)
+      {
+         constexpr uint32_t watch_mask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR;
+         const int watch_descriptor = inotify_add_watch(inotify_handle, watched_directory.c_str(), watch_mask);
+         if (watch_descriptor < 0) return false;
+         watched_directories[watch_descriptor] = watched_directory;
+         if (watch_sub_directories)
+         {
+            std::error_code error_code;
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(watched_directory, error_code))
+            {
+               if (entry.is_directory(error_code))
+               {
+                  const int sub_watch_descriptor = inotify_add_watch(inotify_handle, entry.path().c_str(), watch_mask);
+                  if (sub_watch_descriptor >= 0) watched_directories[sub_watch_descriptor] = entry.path();
+               }
+            }
+         }
+         return true;
+      }
+
+      void Run(const std::atomic<bool>& cancelled)
+      {
+         // Needs to be aligned to the events
+         alignas(inotify_event) char buffer[64 * 1024];
+
+         std::set<std::filesystem::path> changed_files;
+         while (true)
+         {
+            pollfd handles[] = { { stop_handle, POLLIN, 0 }, { inotify_handle, POLLIN, 0 } };
+            const int poll_result = poll(handles, 2, changed_files.empty() ? -1 : int(debounce_time.count()));
+            if (poll_result < 0)
+            {
+               if (errno == EINTR) continue;
+               break;
+            }
+            if (handles[0].revents != 0 || cancelled.load(std::memory_order_acquire))
+            {
+               break;
+            }
+            if (poll_result == 0)
+            {
+               // Nothing else changed for a while, send out all the changes together
+               callback(std::vector<std::filesystem::path>(changed_files.begin(), changed_files.end()));
+               changed_files.clear();
+               continue;
+            }
+
+            while (true)
+            {
+               const ssize_t bytes = read(inotify_handle, buffer, sizeof(buffer));
+               if (bytes <= 0) break;
+               for (const char* entry_data = buffer; entry_data < buffer + bytes; )
+               {
+                  const inotify_event* entry = reinterpret_cast<const inotify_event*>(entry_data);
+                  entry_data += sizeof(inotify_event) + entry->len;
+                  // The queue overflowed, we lost track of what changed
+                  if (entry->mask & IN_Q_OVERFLOW)
+                  {
+                     changed_files.emplace(directory);
+                     continue;
+                  }
+                  const auto watched_directory = watched_directories.find(entry->wd);
+                  if (watched_directory == watched_directories.end()) continue;
+                  // The directory was removed (or moved away)
+                  if (entry->mask & IN_IGNORED)
+                  {
+                     watched_directories.erase(watched_directory);
+                     continue;
+                  }
+                  if (entry->len == 0) continue;
+                  const std::filesystem::path path = watched_directory->second / entry->name;
+                  if (entry->mask & IN_ISDIR)
+                  {
+                     // New directories need to be watched too, and any file that was written into them before the watch was added counts as changed
+                     if (recursive && (entry->mask & (IN_CREATE | IN_MOVED_TO)) && AddWatch(path, true))
+                     {
+                        std::error_code error_code;
+                        for (const auto& sub_entry : std::filesystem::recursive_directory_iterator(path, error_code))
+                        {
+                           if (!sub_entry.is_directory(error_code)) changed_files.emplace(sub_entry.path());
+                        }
+                     }
+                     continue;
+                  }
+                  changed_files.emplace(path);
+               }
+            }
+         }
+      }
+
+      void CloseHandles()
+      {
+         if (inotify_handle >= 0)
+         {
+            close(inotify_handle);
+            inotify_handle = -1;
+         }
+         if (stop_handle >= 0)
+         {
+            close(stop_handle);
+            stop_handle = -1;
+         }
+         watched_directories.clear();
+      }
+#endif
+
+      std::filesystem::path directory;
+      bool recursive = false;
+      std::chrono::milliseconds debounce_time = std::chrono::milliseconds(0);
+      Callback callback;
+
+      job_system::job_handle job;
+#ifdef _WIN32
+      HANDLE directory_handle = nullptr;
+      HANDLE stop_event = nullptr;
+      HANDLE changes_event = nullptr;
+#else
+      int inotify_handle = -1;
+      int stop_handle = -1;
+      std::unordered_map<int, std::filesystem::path> watched_directories; // Only accessed by the watcher job once started
+#endif
+   };
+}
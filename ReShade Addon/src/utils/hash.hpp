@@ -0,0 +1,206 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Faster versions of ReShade's "compute_crc32()" (the one from "crc32_hash.hpp"), used to identify the game shaders by their binary.
+// These return the exact same hashes (standard CRC-32, reflected polynomial 0xEDB88320), which is required given that all the shader file names and hardcoded hashes depend on it.
+// Note that the SSE4.2 "crc32" instruction can't be used as it's based on a different polynomial (CRC-32C).
+namespace utils::hash
+{
+   namespace detail
+   {
+      using CRC32Tables = std::array<std::array<uint32_t, 256>, 16>;
+
+      constexpr CRC32Tables GenerateCRC32Tables()
+      {
+         CRC32Tables tables = {};
+         for (uint32_t i = 0; i < 256; i++)
+         {
+            uint32_t crc = i;
+            for (uint32_t j = 0; j < 8; j++)
+            {
+               crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+            }
+            tables[0][i] = crc;
+         }
+         for (uint32_t i = 0; i < 256; i++)
+         {
+            for (size_t k = 1; k < tables.size(); k++)
+            {
+               tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+            }
+         }
+         return tables;
+      }
+
+      // The first table is the classic byte by byte one, the others allow processing 16 bytes per iteration ("slice-by-16")
+      static constexpr CRC32Tables crc32_tables = GenerateCRC32Tables();
+
+      // Expects and returns the CRC "state", not the final (inverted) value
+      static uint32_t UpdateCRC32SliceBy16(uint32_t crc, const uint8_t* data, size_t size)
+      {
+         const auto& t = crc32_tables;
+         while (size >= 16)
+         {
+            uint32_t one, two, three, four;
+            std::memcpy(&one, data, sizeof(uint32_t)); // x86 is little endian
+            std::memcpy(&two, data + 4, sizeof(uint32_t));
+            std::memcpy(&three, data + 8, sizeof(uint32_t));
+            std::memcpy(&four, data + 12, sizeof(uint32_t));
+            one ^= crc;
+            crc = t[0][(four >> 24) & 0xFF] ^ t[1][(four >> 16) & 0xFF] ^ t[2][(four >> 8) & 0xFF] ^ t[3][four & 0xFF]
+               ^ t[4][(three >> 24) & 0xFF] ^ t[5][(three >> 16) & 0xFF] ^ t[6][(three >> 8) & 0xFF] ^ t[7][three & 0xFF]
+               ^ t[8][(two >> 24) & 0xFF] ^ t[9][(two >> 16) & 0xFF] ^ t[10][(two >> 8) & 0xFF] ^ t[11][two & 0xFF]
+               ^ t[12][(one >> 24) & 0xFF] ^ t[13][(one >> 16) & 0xFF] ^ t[14][(one >> 8) & 0xFF] ^ t[15][one & 0xFF];
+            data += 16;
+            size -= 16;
+         }
+         while (size-- > 0)
+         {
+            crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+         }
+         return crc;
+      }
+
+      // Carry-less multiplication folding, based on Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" paper (bit reflected constants).
+      // Expects and returns the CRC "state". "size" needs to be at least 64 and a multiple of 16.
+#if !defined(_MSC_VER)
+      __attribute__((target("pclmul,sse4.1")))
+#endif
+      static uint32_t UpdateCRC32PCLMUL(uint32_t crc, const uint8_t* data, size_t size)
+      {
+         alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+         alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+         alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+         alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+         __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+         x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+         x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+         x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+         x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+         x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+         x0 = _mm_load_si128((const __m128i*)k1k2);
+         data += 64;
+         size -= 64;
+
+         // Fold 4x128 bits in parallel
+         while (size >= 64)
+         {
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+            x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+            x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+            x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+            x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+            y5 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+            y6 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+            y7 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+            y8 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+            data += 64;
+            size -= 64;
+         }
+
+         // Fold into 128 bits
+         x0 = _mm_load_si128((const __m128i*)k3k4);
+
+         x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+         x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+         x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+         x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+         x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+         x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+         x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+         x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+         x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+         // Fold the remaining 128 bit blocks
+         while (size >= 16)
+         {
+            x2 = _mm_loadu_si128((const __m128i*)data);
+
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+            data += 16;
+            size -= 16;
+         }
+
+         // Fold 128 bits to 64 bits
+         x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+         x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+         x1 = _mm_srli_si128(x1, 8);
+         x1 = _mm_xor_si128(x1, x2);
+
+         x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+         x2 = _mm_srli_si128(x1, 4);
+         x1 = _mm_and_si128(x1, x3);
+         x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+         x1 = _mm_xor_si128(x1, x2);
+
+         // Barrett reduction to 32 bits
+         x0 = _mm_load_si128((const __m128i*)poly);
+
+         x2 = _mm_and_si128(x1, x3);
+         x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+         x2 = _mm_and_si128(x2, x3);
+         x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+         x1 = _mm_xor_si128(x1, x2);
+
+         return (uint32_t)_mm_extract_epi32(x1, 1);
+      }
+
+      static bool IsPCLMULSupported()
+      {
+         int cpu_info[4] = {};
+#ifdef _MSC_VER
+         __cpuid(cpu_info, 1);
+#else
+         __asm__ __volatile__("cpuid" : "=a"(cpu_info[0]), "=b"(cpu_info[1]), "=c"(cpu_info[2]), "=d"(cpu_info[3]) : "a"(1), "c"(0));
+#endif
+         const bool pclmul = (cpu_info[2] & (1 << 1)) != 0;
+         const bool sse41 = (cpu_info[2] & (1 << 19)) != 0;
+         return pclmul && sse41;
+      }
+   }
+
+   // Returns the same value as "compute_crc32()"
+   static uint32_t ComputeCRC32(const uint8_t* data, size_t size)
+   {
+      static const bool pclmul_supported = detail::IsPCLMULSupported();
+
+      uint32_t crc = 0xFFFFFFFF;
+      // The folding has a fixed cost so it's only worth it on large enough buffers (shader binaries are usually a few KBs)
+      if (pclmul_supported && size >= 256)
+      {
+         const size_t folded_size = size & ~size_t(15);
+         crc = detail::UpdateCRC32PCLMUL(crc, data, folded_size);
+         data += folded_size;
+         size -= folded_size;
+      }
+      crc = detail::UpdateCRC32SliceBy16(crc, data, size);
+      return crc ^ 0xFFFFFFFF;
+   }
+}
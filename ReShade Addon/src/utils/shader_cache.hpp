@@ -0,0 +1,491 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "hash.hpp"
+
+// Persistent cache of compiled shaders bytecode, stored in a single append only "pack" file (memory mapped on load).
+// Each entry is addressed by the hash of everything that could affect the compiled shader (its preprocessed code, defines, target and compiler version),
+// so it doesn't need to be invalidated when shaders change, the old entries simply stop being used (and are dropped when the pack gets compacted).
+// The file is a header followed by records (a record header, the bytecode and the compiler warnings), each record has its own checksums, so if the game ever crashed (or was closed)
+// while we were appending to it, the torn record at the end of the file is simply detected and cut away on the next load.
+namespace utils::shader::cache
+{
+   namespace detail
+   {
+      constexpr uint32_t pack_magic = 0x4B43504C; // "LPCK"
+      constexpr uint32_t pack_version = 2; // Packs of any other version are discarded on load
+      constexpr uint32_t record_magic = 0x4443524C; // "LRCD"
+
+      struct PackHeader
+      {
+         uint32_t magic = pack_magic;
+         uint32_t version = pack_version;
+      };
+
+      struct RecordHeader
+      {
+         uint32_t magic = record_magic;
+         uint32_t size = 0; // Size of the bytecode following the header
+         uint64_t key = 0;
+         uint32_t warnings_size = 0; // Size of the compiler warnings text following the bytecode
+         uint32_t data_checksum = 0; // Of both the bytecode and the warnings
+         uint32_t padding = 0;
+         uint32_t header_checksum = 0; // Of all the members above
+      };
+      static_assert(sizeof(RecordHeader) == 32);
+
+      static uint32_t ComputeRecordHeaderChecksum(const RecordHeader& header)
+      {
+         return utils::hash::ComputeCRC32(reinterpret_cast<const uint8_t*>(&header), offsetof(RecordHeader, header_checksum));
+      }
+
+      // FNV-1a
+      static uint64_t HashCombine(uint64_t hash, const void* data, size_t size)
+      {
+         const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+         for (size_t i = 0; i < size; i++)
+         {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+         }
+         return hash;
+      }
+   }
+
+   // "defines" are expected to be in the same (name, value) pairs format the shader compiler takes.
+   // "compiler_version" is the version of the shader compiler dll, any change to it will invalidate all the cached shaders.
+   static uint64_t ComputeKey(uint64_t compiler_version, std::size_t preprocessed_hash, const std::string& shader_target, const std::vector<std::string>& defines)
+   {
+      uint64_t key = 0xCBF29CE484222325ull;
+      key = detail::HashCombine(key, &compiler_version, sizeof(compiler_version));
+      const uint64_t preprocessed_hash_64 = preprocessed_hash;
+      key = detail::HashCombine(key, &preprocessed_hash_64, sizeof(preprocessed_hash_64));
+      key = detail::HashCombine(key, shader_target.c_str(), shader_target.size() + 1); // Include the null terminator as separator
+      for (const auto& define : defines)
+      {
+         key = detail::HashCombine(key, define.c_str(), define.size() + 1);
+      }
+      return key;
+   }
+
+   // Thread safe
+   class BytecodePack
+   {
+   public:
+      BytecodePack() = default;
+      BytecodePack(const BytecodePack&) = delete;
+      BytecodePack& operator=(const BytecodePack&) = delete;
+      ~BytecodePack()
+      {
+         Unmap();
+      }
+
+      // Loads (or creates) the pack file, all the records are validated here, and any data after the first invalid one is discarded
+      void Open(const std::filesystem::path& in_path)
+      {
+         const std::unique_lock lock(mutex);
+         Unmap();
+         appended_records.clear();
+         used_keys.clear();
+         path = in_path;
+         is_open = false;
+
+         std::error_code error_code;
+         if (!std::filesystem::is_regular_file(path, error_code) || std::filesystem::file_size(path, error_code) < sizeof(detail::PackHeader))
+         {
+            is_open = CreateEmpty();
+            return;
+         }
+
+         size_t valid_size = 0;
+         if (Map())
+         {
+            valid_size = Index();
+         }
+         if (valid_size == 0)
+         {
+            // Corrupted or from an older version
+            Unmap();
+            is_open = CreateEmpty();
+            return;
+         }
+         if (valid_size < mapped_size)
+         {
+            // Cut away the torn record(s) at the end, so we can keep appending after the valid ones
+            Unmap();
+            std::filesystem::resize_file(path, valid_size, error_code);
+            if (error_code || !Map() || Index() != mapped_size)
+            {
+               Unmap();
+               is_open = CreateEmpty();
+               return;
+            }
+         }
+         is_open = true;
+      }
+
+      bool IsOpen() const
+      {
+         const std::shared_lock lock(mutex);
+         return is_open;
+      }
+
+      // Returns the size of the pack file
+      size_t GetSize() const
+      {
+         const std::shared_lock lock(mutex);
+         return file_size;
+      }
+
+      // "warnings" are the ones the compiler had output when the shader was added, so they can be shown again
+      bool Find(uint64_t key, std::vector<uint8_t>& code, std::string& warnings)
+      {
+         {
+            const std::shared_lock lock(mutex);
+            if (const auto mapped_record = mapped_records.find(key); mapped_record != mapped_records.end())
+            {
+               ReadMappedRecord(mapped_record->second, code, warnings);
+            }
+            else if (const auto appended_record = appended_records.find(key); appended_record != appended_records.end())
+            {
+               code = appended_record->second.code;
+               warnings = appended_record->second.warnings;
+            }
+            else
+            {
+               return false;
+            }
+         }
+         const std::unique_lock lock(mutex);
+         used_keys.emplace(key);
+         return true;
+      }
+
+      // Appends a new record to the end of the file, does nothing if the key was already there
+      void Append(uint64_t key, const std::vector<uint8_t>& code, const std::string& warnings)
+      {
+         const std::unique_lock lock(mutex);
+         if (!is_open || code.empty()) return;
+         used_keys.emplace(key);
+         if (mapped_records.contains(key) || appended_records.contains(key)) return;
+
+         Record record = { code, warnings };
+         if (WriteRecord(path, key, record, true))
+         {
+            file_size += GetRecordSize(record);
+            appended_records[key] = std::move(record);
+         }
+      }
+
+      // Rewrites the pack file with only the records that have been used since it was opened, if it went beyond the size budget.
+      // The new file is written to a temporary path and then replaces the old one, so the pack is never left in a half written state.
+      void Compact(size_t size_budget)
+      {
+         const std::unique_lock lock(mutex);
+         if (!is_open || file_size <= size_budget) return;
+
+         std::unordered_map<uint64_t, Record> records;
+         for (const uint64_t key : used_keys)
+         {
+            if (const auto mapped_record = mapped_records.find(key); mapped_record != mapped_records.end())
+            {
+               ReadMappedRecord(mapped_record->second, records[key].code, records[key].warnings);
+            }
+            else if (const auto appended_record = appended_records.find(key); appended_record != appended_records.end())
+            {
+               records[key] = std::move(appended_record->second);
+            }
+         }
+         Unmap();
+         appended_records.clear();
+
+         auto temp_path = path;
+         temp_path += ".tmp";
+         bool succeeded = WriteHeader(temp_path);
+         for (const auto& record : records)
+         {
+            if (!succeeded) break;
+            succeeded = WriteRecord(temp_path, record.first, record.second, false);
+         }
+         std::error_code error_code;
+         if (succeeded)
+         {
+            std::filesystem::rename(temp_path, path, error_code);
+         }
+         else
+         {
+            std::filesystem::remove(temp_path, error_code);
+         }
+
+         // Whatever happened, the records we had are still valid
+         if (!Map() || Index() != mapped_size)
+         {
+            Unmap();
+            is_open = CreateEmpty();
+            for (auto& record : records)
+            {
+               if (is_open && WriteRecord(path, record.first, record.second, true))
+               {
+                  file_size += GetRecordSize(record.second);
+                  appended_records[record.first] = std::move(record.second);
+               }
+            }
+         }
+      }
+
+      // Deletes all the cached data
+      void Clear()
+      {
+         const std::unique_lock lock(mutex);
+         Unmap();
+         appended_records.clear();
+         used_keys.clear();
+         if (!path.empty())
+         {
+            is_open = CreateEmpty();
+         }
+      }
+
+   private:
+      struct Record
+      {
+         std::vector<uint8_t> code;
+         std::string warnings;
+      };
+
+      struct MappedRecord
+      {
+         size_t offset; // Of the bytecode in the mapped file, the warnings follow it
+         uint32_t code_size;
+         uint32_t warnings_size;
+      };
+
+      static size_t GetRecordSize(const Record& record)
+      {
+         return sizeof(detail::RecordHeader) + record.code.size() + record.warnings.size();
+      }
+
+      // Expects "mutex" to be locked
+      void ReadMappedRecord(const MappedRecord& mapped_record, std::vector<uint8_t>& code, std::string& warnings) const
+      {
+         const uint8_t* record_code = mapped_data + mapped_record.offset;
+         code.assign(record_code, record_code + mapped_record.code_size);
+         warnings.assign(reinterpret_cast<const char*>(record_code + mapped_record.code_size), mapped_record.warnings_size);
+      }
+
+      bool CreateEmpty()
+      {
+         mapped_records.clear();
+         file_size = 0;
+         std::error_code error_code;
+         std::filesystem::create_directories(path.parent_path(), error_code);
+         if (!WriteHeader(path)) return false;
+         file_size = sizeof(detail::PackHeader);
+         return true;
+      }
+
+      static bool WriteHeader(const std::filesystem::path& file_path)
+      {
+         try
+         {
+            std::ofstream file;
+            file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            file.open(file_path, std::ios::binary | std::ios::trunc);
+            const detail::PackHeader header;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+         }
+         catch (const std::exception& e)
+         {
+            return false;
+         }
+         return true;
+      }
+
+      static bool WriteRecord(const std::filesystem::path& file_path, uint64_t key, const Record& data, bool flush)
+      {
+         // Write the whole record in one go, if we got interrupted the record will fail the validation on load
+         std::vector<char> record(GetRecordSize(data));
+         char* record_data = record.data() + sizeof(detail::RecordHeader);
+         std::memcpy(record_data, data.code.data(), data.code.size());
+         std::memcpy(record_data + data.code.size(), data.warnings.data(), data.warnings.size());
+
+         detail::RecordHeader header;
+         header.size = uint32_t(data.code.size());
+         header.key = key;
+         header.warnings_size = uint32_t(data.warnings.size());
+         header.data_checksum = utils::hash::ComputeCRC32(reinterpret_cast<const uint8_t*>(record_data), data.code.size() + data.warnings.size());
+         header.header_checksum = detail::ComputeRecordHeaderChecksum(header);
+         std::memcpy(record.data(), &header, sizeof(header));
+         try
+         {
+            std::ofstream file;
+            file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            file.open(file_path, std::ios::binary | std::ios::app);
+            file.write(record.data(), record.size());
+            if (flush)
+            {
+               file.flush();
+            }
+         }
+         catch (const std::exception& e)
+         {
+            return false;
+         }
+         return true;
+      }
+
+      bool Map()
+      {
+#ifdef _WIN32
+         file_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+         if (file_handle == INVALID_HANDLE_VALUE)
+         {
+            file_handle = nullptr;
+            return false;
+         }
+         LARGE_INTEGER size = {};
+         if (!GetFileSizeEx(file_handle, &size) || size.QuadPart < LONGLONG(sizeof(detail::PackHeader)))
+         {
+            Unmap();
+            return false;
+         }
+         mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+         if (mapping_handle == nullptr)
+         {
+            Unmap();
+            return false;
+         }
+         mapped_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+         if (mapped_data == nullptr)
+         {
+            Unmap();
+            return false;
+         }
+         mapped_size = size_t(size.QuadPart);
+#else // Only used by the tests
+         file_descriptor = open(path.c_str(), O_RDONLY);
+         if (file_descriptor < 0)
+         {
+            return false;
+         }
+         struct stat file_stat = {};
+         if (fstat(file_descriptor, &file_stat) != 0 || size_t(file_stat.st_size) < sizeof(detail::PackHeader))
+         {
+            Unmap();
+            return false;
+         }
+         void* data = mmap(nullptr, size_t(file_stat.st_size), PROT_READ, MAP_SHARED, file_descriptor, 0);
+         if (data == MAP_FAILED)
+         {
+            Unmap();
+            return false;
+         }
+         mapped_data = reinterpret_cast<const uint8_t*>(data);
+         mapped_size = size_t(file_stat.st_size);
+#endif
+         file_size = mapped_size;
+         return true;
+      }
+
+      void Unmap()
+      {
+#ifdef _WIN32
+         if (mapped_data != nullptr)
+         {
+            UnmapViewOfFile(mapped_data);
+            mapped_data = nullptr;
+         }
+         if (mapping_handle != nullptr)
+         {
+            CloseHandle(mapping_handle);
+            mapping_handle = nullptr;
+         }
+         if (file_handle != nullptr)
+         {
+            CloseHandle(file_handle);
+            file_handle = nullptr;
+         }
+#else
+         if (mapped_data != nullptr)
+         {
+            munmap(const_cast<uint8_t*>(mapped_data), mapped_size);
+            mapped_data = nullptr;
+         }
+         if (file_descriptor >= 0)
+         {
+            close(file_descriptor);
+            file_descriptor = -1;
+         }
+#endif
+         mapped_size = 0;
+         mapped_records.clear();
+      }
+
+      // Validates all the records in the mapped file and builds the index, returns the size of the valid part of the file (0 if the header itself was invalid)
+      size_t Index()
+      {
+         mapped_records.clear();
+         detail::PackHeader header;
+         std::memcpy(&header, mapped_data, sizeof(header));
+         if (header.magic != detail::pack_magic || header.version != detail::pack_version)
+         {
+            return 0;
+         }
+
+         size_t offset = sizeof(detail::PackHeader);
+         while (mapped_size - offset >= sizeof(detail::RecordHeader))
+         {
+            detail::RecordHeader record_header;
+            std::memcpy(&record_header, mapped_data + offset, sizeof(record_header));
+            if (record_header.magic != detail::record_magic || record_header.header_checksum != detail::ComputeRecordHeaderChecksum(record_header))
+            {
+               break;
+            }
+            const size_t data_offset = offset + sizeof(detail::RecordHeader);
+            const size_t data_size = size_t(record_header.size) + size_t(record_header.warnings_size);
+            if (mapped_size - data_offset < data_size || record_header.data_checksum != utils::hash::ComputeCRC32(mapped_data + data_offset, data_size))
+            {
+               break;
+            }
+            mapped_records[record_header.key] = { data_offset, record_header.size, record_header.warnings_size };
+            offset = data_offset + data_size;
+         }
+         return offset;
+      }
+
+      mutable std::shared_mutex mutex;
+      std::filesystem::path path;
+      bool is_open = false;
+      size_t file_size = 0;
+
+#ifdef _WIN32
+      HANDLE file_handle = nullptr;
+      HANDLE mapping_handle = nullptr;
+#else
+      int file_descriptor = -1;
+#endif
+      const uint8_t* mapped_data = nullptr;
+      size_t mapped_size = 0;
+      std::unordered_map<uint64_t, MappedRecord> mapped_records; // By key
+      std::unordered_map<uint64_t, Record> appended_records; // Records added after the file was mapped
+      std::unordered_set<uint64_t> used_keys; // Records that have been used since the pack was opened, the others are dropped on compaction
+   };
+}
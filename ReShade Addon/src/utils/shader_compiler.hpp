@@ -10,13 +10,19 @@
 #include <d3dcompiler.h>
 #include <dxcapi.h>
 
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <include/reshade.hpp>
 
+#include "shader_dependencies.hpp"
+
 namespace utils::shader::compiler
 {
 
@@ -24,12 +30,37 @@ namespace utils::shader::compiler
 
    bool dummy_bool;
 
+   // Returns the version of a library (e.g. of the shader compiler) as v1.v2.v3.v4 (16 bits each, from the most significant ones), or 0 if it couldn't be read
+   uint64_t GetLibraryFileVersion(LPCWSTR file_path)
+   {
+      uint64_t version = 0;
+      DWORD ver_handle = 0;
+      const DWORD ver_size = GetFileVersionInfoSizeW(file_path, &ver_handle);
+      if (ver_size != 0)
+      {
+         std::vector<uint8_t> ver_data(ver_size);
+         LPBYTE buffer = nullptr;
+         UINT size = 0;
+         if (GetFileVersionInfoW(file_path, ver_handle, ver_size, ver_data.data()) && VerQueryValueW(ver_data.data(), L"\\", reinterpret_cast<LPVOID*>(&buffer), &size) && size != 0)
+         {
+            const VS_FIXEDFILEINFO* ver_info = reinterpret_cast<const VS_FIXEDFILEINFO*>(buffer);
+            if (ver_info->dwSignature == 0xfeef04bd)
+            {
+               version = (uint64_t(ver_info->dwFileVersionMS) << 32) | uint64_t(ver_info->dwFileVersionLS);
+            }
+         }
+      }
+      return version;
+   }
+
    std::optional<std::string> DisassembleShaderFXC(void* data, size_t size, LPCWSTR library = L"D3DCompiler_47.dll")
    {
       std::optional<std::string> result;
 
       // TODO: unify this with "CompileShaderFromFileFXC()", as it loads the same dll.
       static std::unordered_map<LPCWSTR, pD3DDisassemble> d3d_disassemble;
+      // Copy the function pointers while we are locked, the maps could be written by other threads while we use them (e.g. with the multithreaded shaders compilation)
+      pD3DDisassemble disassemble = nullptr;
       {
          const std::lock_guard<std::mutex> lock(s_mutex_shader_compiler);
          static std::unordered_map<LPCWSTR, HMODULE> d3d_compiler;
@@ -42,12 +73,13 @@ namespace utils::shader::compiler
             // NOLINTNEXTLINE(google-readability-casting)
             d3d_disassemble[library] = pD3DDisassemble(GetProcAddress(d3d_compiler[library], "D3DDisassemble"));
          }
+         disassemble = d3d_disassemble[library];
       }
 
-      if (d3d_disassemble[library] != nullptr)
+      if (disassemble != nullptr)
       {
          CComPtr<ID3DBlob> out_blob;
-         if (SUCCEEDED(d3d_disassemble[library](
+         if (SUCCEEDED(disassemble(
             data,
             size,
             D3D_DISASM_ENABLE_INSTRUCTION_NUMBERING | D3D_DISASM_ENABLE_INSTRUCTION_OFFSET,
@@ -146,9 +178,84 @@ namespace utils::shader::compiler
 
    static std::unordered_map<LPCWSTR, HMODULE> d3d_compiler;
 
+   // Behaves like "D3D_COMPILE_STANDARD_FILE_INCLUDE" (includes are relative to the file that includes them, or to the root shader file directory),
+   // but it also keeps track of all the files that have been included (recursively), so we can know what files a shader depends on.
+   class RecordingInclude final : public ID3DInclude
+   {
+   public:
+      RecordingInclude(const std::filesystem::path& root_file_path, std::vector<utils::shader::dependencies::FileStamp>& file_stamps) : root_directory(root_file_path.parent_path()), file_stamps(file_stamps) {}
+
+      HRESULT __stdcall Open(D3D_INCLUDE_TYPE include_type, LPCSTR file_name, LPCVOID parent_data, LPCVOID* data, UINT* bytes) override
+      {
+         std::filesystem::path file_path = file_name;
+         if (file_path.is_relative())
+         {
+            const auto parent_directory = opened_files_directories.find(parent_data);
+            file_path = (parent_directory != opened_files_directories.end() ? parent_directory->second : root_directory) / file_name;
+            if (!std::filesystem::is_regular_file(file_path))
+            {
+               file_path = root_directory / file_name;
+            }
+         }
+         file_path = file_path.lexically_normal();
+
+         // Stamp the file before reading it (see "DependencyGraph::Set()")
+         utils::shader::dependencies::FileStamp file_stamp;
+         if (!utils::shader::dependencies::GetFileStamp(file_path, file_stamp))
+         {
+            return E_FAIL;
+         }
+
+         char* file_data = nullptr;
+         size_t file_size = 0;
+         try
+         {
+            std::ifstream file;
+            file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+            file.open(file_path, std::ios::binary);
+            file.seekg(0, std::ios::end);
+            file_size = file.tellg();
+            file_data = new char[file_size > 0 ? file_size : 1];
+            if (file_size > 0)
+            {
+               file.seekg(0, std::ios::beg);
+               file.read(file_data, file_size);
+            }
+         }
+         catch (const std::exception& e)
+         {
+            delete[] file_data;
+            return E_FAIL;
+         }
+
+         opened_files_directories[file_data] = file_path.parent_path();
+         if (std::find_if(file_stamps.begin(), file_stamps.end(), [&](const auto& other_file_stamp) { return other_file_stamp.path == file_path; }) == file_stamps.end())
+         {
+            file_stamps.push_back(std::move(file_stamp));
+         }
+         *data = file_data;
+         *bytes = UINT(file_size);
+         return S_OK;
+      }
+
+      HRESULT __stdcall Close(LPCVOID data) override
+      {
+         opened_files_directories.erase(data);
+         delete[] reinterpret_cast<const char*>(data);
+         return S_OK;
+      }
+
+   private:
+      std::filesystem::path root_directory;
+      std::vector<utils::shader::dependencies::FileStamp>& file_stamps;
+      std::unordered_map<LPCVOID, std::filesystem::path> opened_files_directories;
+   };
+
    // Returns true if the shader changed (or if we can't compare it).
    // Pass in "shader_name_w" as the full path to avoid needing to set the current directory.
-   bool PreprocessShaderFromFile(LPCWSTR file_path, LPCWSTR shader_name_w, LPCSTR shader_target, std::size_t& preprocessed_hash /*= 0*/, CComPtr<ID3DBlob>& uncompiled_code_blob, const std::vector<std::string>& defines = {}, bool& error = dummy_bool, std::string* out_error = nullptr, LPCWSTR fxc_library = L"D3DCompiler_47.dll")
+   // If "out_file_stamps" is passed in, it will be filled with the stamps of the shader file and of all the files it included (recursively), taken before reading each of them,
+   // it's left empty if any of them couldn't be stamped.
+   bool PreprocessShaderFromFile(LPCWSTR file_path, LPCWSTR shader_name_w, LPCSTR shader_target, std::size_t& preprocessed_hash /*= 0*/, CComPtr<ID3DBlob>& uncompiled_code_blob, const std::vector<std::string>& defines = {}, bool& error = dummy_bool, std::string* out_error = nullptr, std::vector<utils::shader::dependencies::FileStamp>* out_file_stamps = nullptr, LPCWSTR fxc_library = L"D3DCompiler_47.dll")
    {
       std::vector<D3D_SHADER_MACRO> local_defines;
       FillDefines(defines, local_defines);
@@ -159,6 +266,9 @@ namespace utils::shader::compiler
          typedef HRESULT(WINAPI* pD3DPreprocess)(LPCVOID, SIZE_T, LPCSTR, CONST D3D_SHADER_MACRO*, ID3DInclude*, ID3DBlob**, ID3DBlob**);
          static std::unordered_map<LPCWSTR, pD3DReadFileToBlob> d3d_readFileToBlob;
          static std::unordered_map<LPCWSTR, pD3DPreprocess> d3d_preprocess;
+         // Copy the function pointers while we are locked, as the maps aren't thread safe
+         pD3DReadFileToBlob readFileToBlob = nullptr;
+         pD3DPreprocess preprocess = nullptr;
          {
             const std::lock_guard<std::mutex> lock(s_mutex_shader_compiler);
             if (d3d_compiler[fxc_library] == nullptr)
@@ -171,11 +281,19 @@ namespace utils::shader::compiler
                d3d_readFileToBlob[fxc_library] = pD3DReadFileToBlob(GetProcAddress(d3d_compiler[fxc_library], "D3DReadFileToBlob"));
                d3d_preprocess[fxc_library] = pD3DPreprocess(GetProcAddress(d3d_compiler[fxc_library], "D3DPreprocess"));
             }
+            readFileToBlob = d3d_readFileToBlob[fxc_library];
+            preprocess = d3d_preprocess[fxc_library];
          }
 
-         if (d3d_readFileToBlob[fxc_library] != nullptr && d3d_preprocess[fxc_library] != nullptr)
+         if (readFileToBlob != nullptr && preprocess != nullptr)
          {
-            if (SUCCEEDED(d3d_readFileToBlob[fxc_library](file_path, &uncompiled_code_blob)))
+            bool file_stamps_valid = true;
+            if (out_file_stamps != nullptr)
+            {
+               out_file_stamps->clear();
+               file_stamps_valid = utils::shader::dependencies::GetFileStamp(file_path, out_file_stamps->emplace_back());
+            }
+            if (SUCCEEDED(readFileToBlob(file_path, &uncompiled_code_blob)))
             {
 #pragma warning(push)
 #pragma warning(disable : 4244)
@@ -186,15 +304,24 @@ namespace utils::shader::compiler
 #pragma warning(pop)
                CComPtr<ID3DBlob> preprocessed_blob;
                CComPtr<ID3DBlob> error_blob;
-               HRESULT result = d3d_preprocess[fxc_library](
+               std::optional<RecordingInclude> recording_include;
+               if (out_file_stamps != nullptr)
+               {
+                  recording_include.emplace(file_path, *out_file_stamps);
+               }
+               HRESULT result = preprocess(
                   uncompiled_code_blob->GetBufferPointer(),
                   uncompiled_code_blob->GetBufferSize(),
                   shader_name,
                   local_defines.data(),
-                  D3D_COMPILE_STANDARD_FILE_INCLUDE,
+                  recording_include.has_value() ? &recording_include.value() : D3D_COMPILE_STANDARD_FILE_INCLUDE,
                   &preprocessed_blob,
                   &error_blob);
                error = FAILED(result);
+               if (out_file_stamps != nullptr && (error || !file_stamps_valid))
+               {
+                  out_file_stamps->clear();
+               }
                if (out_error != nullptr && error_blob != nullptr)
                {
                   out_error->assign(reinterpret_cast<char*>(error_blob->GetBufferPointer()));
@@ -221,6 +348,8 @@ namespace utils::shader::compiler
    {
       typedef HRESULT(WINAPI* pD3DReadFileToBlob)(LPCWSTR, ID3DBlob**);
       static std::unordered_map<LPCWSTR, pD3DReadFileToBlob> d3d_readFileToBlob;
+      // Copy the function pointer while we are locked, as the maps aren't thread safe
+      pD3DReadFileToBlob readFileToBlob = nullptr;
       {
          const std::lock_guard<std::mutex> lock(s_mutex_shader_compiler);
          if (d3d_compiler[library] == nullptr)
@@ -232,11 +361,12 @@ namespace utils::shader::compiler
             // NOLINTNEXTLINE(google-readability-casting)
             d3d_readFileToBlob[library] = pD3DReadFileToBlob(GetProcAddress(d3d_compiler[library], "D3DReadFileToBlob"));
          }
+         readFileToBlob = d3d_readFileToBlob[library];
       }
 
       bool file_loaded = false;
       CComPtr<ID3DBlob> out_blob;
-      if (d3d_readFileToBlob[library] != nullptr)
+      if (readFileToBlob != nullptr)
       {
          std::wstring file_path_cso = file_path;
          if (file_path_cso.ends_with(L".hlsl"))
@@ -250,7 +380,7 @@ namespace utils::shader::compiler
          }
 
          CComPtr<ID3DBlob> out_blob;
-         HRESULT result = d3d_readFileToBlob[library](file_path_cso.c_str(), &out_blob);
+         HRESULT result = readFileToBlob(file_path_cso.c_str(), &out_blob);
          if (SUCCEEDED(result))
          {
             output.assign(
@@ -276,6 +406,10 @@ namespace utils::shader::compiler
       static std::unordered_map<LPCWSTR, pD3DCompileFromFile> d3d_compilefromfile;
       static std::unordered_map<LPCWSTR, pD3DCompile> d3d_compile;
       static std::unordered_map<LPCWSTR, pD3DWriteBlobToFile> d3d_writeBlobToFile;
+      // Copy the function pointers while we are locked, as the maps aren't thread safe (the compilation itself doesn't need to be locked)
+      pD3DCompileFromFile compilefromfile = nullptr;
+      pD3DCompile compile = nullptr;
+      pD3DWriteBlobToFile writeBlobToFile = nullptr;
       {
          const std::lock_guard<std::mutex> lock(s_mutex_shader_compiler);
          if (d3d_compiler[library] == nullptr)
@@ -289,12 +423,15 @@ namespace utils::shader::compiler
             d3d_compile[library] = pD3DCompile(GetProcAddress(d3d_compiler[library], "D3DCompile"));
             d3d_writeBlobToFile[library] = pD3DWriteBlobToFile(GetProcAddress(d3d_compiler[library], "D3DWriteBlobToFile"));
          }
+         compilefromfile = d3d_compilefromfile[library];
+         compile = d3d_compile[library];
+         writeBlobToFile = d3d_writeBlobToFile[library];
       }
 
       CComPtr<ID3DBlob> out_blob;
       CComPtr<ID3DBlob> error_blob;
       HRESULT result = E_FAIL; // Fake default error
-      if (optional_uncompiled_code_input != nullptr && d3d_compile[library] != nullptr)
+      if (optional_uncompiled_code_input != nullptr && compile != nullptr)
       {
 #pragma warning(push)
 #pragma warning(disable : 4244)
@@ -303,7 +440,7 @@ namespace utils::shader::compiler
          std::copy(shader_name_w_s.begin(), shader_name_w_s.end(), shader_name_s.begin());
          LPCSTR shader_name = shader_name_s.c_str();
 #pragma warning(pop)
-         result = d3d_compile[library](
+         result = compile(
             optional_uncompiled_code_input->GetBufferPointer(),
             optional_uncompiled_code_input->GetBufferSize(),
             shader_name,
@@ -316,9 +453,9 @@ namespace utils::shader::compiler
             &out_blob,
             &error_blob);
       }
-      if (FAILED(result) && d3d_compilefromfile[library] != nullptr)
+      if (FAILED(result) && compilefromfile != nullptr)
       {
-         result = d3d_compilefromfile[library](
+         result = compilefromfile(
             file_read_path,
             defines,
             D3D_COMPILE_STANDARD_FILE_INCLUDE,
@@ -336,7 +473,7 @@ namespace utils::shader::compiler
             reinterpret_cast<uint8_t*>(out_blob->GetBufferPointer()),
             reinterpret_cast<uint8_t*>(out_blob->GetBufferPointer()) + out_blob->GetBufferSize());
 
-         if (save_to_disk && d3d_writeBlobToFile[library] != nullptr)
+         if (save_to_disk && writeBlobToFile != nullptr)
          {
             const bool overwrite = true; // Overwrite whatever original or custom shader we previously had there
             std::wstring file_path_cso = (file_write_path && file_write_path[0] != '\0') ? file_write_path : file_read_path;
@@ -349,7 +486,7 @@ namespace utils::shader::compiler
             {
                file_path_cso += L".cso";
             }
-            HRESULT result2 = d3d_writeBlobToFile[library](out_blob, file_path_cso.c_str(), overwrite);
+            HRESULT result2 = writeBlobToFile(out_blob, file_path_cso.c_str(), overwrite);
             assert(SUCCEEDED(result2));
          }
       }
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Keeps track of all the files each custom shader has been built from (its source and all the files it includes, recursively),
+// so that if none of them changed since the last time the shader was pre-processed (with the same defines), we can skip pre-processing it again,
+// which is the most expensive part of re-loading shaders once they have been compiled once.
+// Each defines permutation of a shader is tracked separately, as they could include different files.
+// Permutations are pruned as soon as they can't ever be up to date again (e.g. once another permutation of the same shader was re-built from a newer version of their files),
+// when their shader is gone, and beyond a maximum number per shader, so the graph doesn't keep growing as the user tries out defines.
+// Files are considered unchanged if their last write time and size match.
+namespace utils::shader::dependencies
+{
+   struct FileStamp
+   {
+      std::filesystem::path path;
+      int64_t last_write_time = 0;
+      uint64_t size = 0;
+
+      bool operator==(const FileStamp& other) const = default;
+   };
+
+   static bool GetFileStamp(const std::filesystem::path& path, FileStamp& stamp)
+   {
+      std::error_code error_code;
+      stamp.path = path;
+      stamp.last_write_time = std::filesystem::last_write_time(path, error_code).time_since_epoch().count();
+      if (error_code) return false;
+      stamp.size = std::filesystem::file_size(path, error_code);
+      return !error_code;
+   }
+
+   // "defines" are expected to be in the same (name, value) pairs format the shader compiler takes
+   static uint64_t HashDefines(const std::vector<std::string>& defines)
+   {
+      uint64_t hash = 0xCBF29CE484222325ull; // FNV-1a
+      for (const auto& define : defines)
+      {
+         for (size_t i = 0; i <= define.size(); i++) // Include the null terminator as separator
+         {
+            hash ^= uint8_t(define.c_str()[i]);
+            hash *= 0x100000001B3ull;
+         }
+      }
+      return hash;
+   }
+
+   struct ShaderDependencies
+   {
+      uint32_t shader_hash = 0;
+      std::string shader_target;
+      uint64_t defines_hash = 0;
+      std::size_t preprocessed_hash = 0; // The result of the last pre-processing
+      std::vector<FileStamp> files; // The first one is the shader source file
+      uint64_t set_index = 0; // When it was set, relative to the other permutations (not serialized)
+   };
+
+   // Thread safe
+   class DependencyGraph
+   {
+   public:
+      // Enough for the currently used defines and all the precompiled permutations
+      static constexpr size_t max_permutations_per_shader = 16;
+
+      // Returns true (and the preprocessed hash it had) if the shader was pre-processed before from the same source file, target and defines, and none of the files it depended on changed since
+      bool IsUpToDate(uint32_t shader_hash, const std::filesystem::path& source_path, const std::string& shader_target, uint64_t defines_hash, std::size_t& preprocessed_hash) const
+      {
+         ShaderDependencies dependencies;
+         {
+            const std::shared_lock lock(mutex);
+            const auto shader = shaders.find(GetKey(shader_hash, defines_hash));
+            if (shader == shaders.end()) return false;
+            dependencies = shader->second;
+         }
+         if (dependencies.files.empty() || dependencies.files[0].path != source_path || dependencies.shader_hash != shader_hash || dependencies.shader_target != shader_target || dependencies.defines_hash != defines_hash)
+         {
+            return false;
+         }
+         for (const auto& file : dependencies.files)
+         {
+            FileStamp stamp;
+            if (!GetFileStamp(file.path, stamp) || stamp != file)
+            {
+               return false;
+            }
+         }
+         preprocessed_hash = dependencies.preprocessed_hash;
+         return true;
+      }
+
+      // "file_stamps" are the ones of the source file (first) and of all the files it included, they need to be taken before reading the files (not after pre-processing them),
+      // so that if any of them is modified while the shader is being pre-processed, the stamp is older than what was read, and the shader will be considered outdated the next time.
+      // An empty list means the files couldn't be stamped.
+      void Set(uint32_t shader_hash, const std::string& shader_target, uint64_t defines_hash, std::size_t preprocessed_hash, std::vector<FileStamp> file_stamps)
+      {
+         ShaderDependencies dependencies;
+         dependencies.shader_hash = shader_hash;
+         dependencies.shader_target = shader_target;
+         dependencies.defines_hash = defines_hash;
+         dependencies.preprocessed_hash = preprocessed_hash;
+         dependencies.files = std::move(file_stamps);
+         const bool valid = !dependencies.files.empty();
+
+         const std::unique_lock lock(mutex);
+         const uint64_t key = GetKey(shader_hash, defines_hash);
+         if (!valid)
+         {
+            shaders.erase(key);
+            dirty = true;
+            return;
+         }
+
+         // Drop the other permutations of the shader that were built from older versions of the same files (or from another source file or target),
+         // the shader files changed and they would have to be pre-processed again anyway
+         size_t permutations = 1;
+         std::erase_if(shaders, [&](const auto& shader)
+            {
+               if (shader.first == key || shader.second.shader_hash != shader_hash) return false;
+               if (IsStale(shader.second, dependencies)) return true;
+               permutations++;
+               return false;
+            });
+         // Then drop the oldest ones if there's too many
+         for (; permutations > max_permutations_per_shader; permutations--)
+         {
+            auto oldest_shader = shaders.end();
+            for (auto shader = shaders.begin(); shader != shaders.end(); shader++)
+            {
+               if (shader->first == key || shader->second.shader_hash != shader_hash) continue;
+               if (oldest_shader == shaders.end() || shader->second.set_index < oldest_shader->second.set_index) oldest_shader = shader;
+            }
+            shaders.erase(oldest_shader);
+         }
+
+         dependencies.set_index = ++last_set_index;
+         shaders[key] = std::move(dependencies);
+         dirty = true;
+      }
+
+      // Returns all the shaders that have been built from the file (either as source or include)
+      std::vector<uint32_t> GetDependentShaders(const std::filesystem::path& file_path) const
+      {
+         std::vector<uint32_t> shader_hashes;
+         const auto normalized_file_path = file_path.lexically_normal();
+         const std::shared_lock lock(mutex);
+         for (const auto& shader : shaders)
+         {
+            if (std::find(shader_hashes.begin(), shader_hashes.end(), shader.second.shader_hash) != shader_hashes.end()) continue;
+            for (const auto& file : shader.second.files)
+            {
+               if (file.path.lexically_normal() == normalized_file_path)
+               {
+                  shader_hashes.push_back(shader.second.shader_hash);
+                  break;
+               }
+            }
+         }
+         return shader_hashes;
+      }
+
+      void Remove(uint32_t shader_hash, uint64_t defines_hash)
+      {
+         const std::unique_lock lock(mutex);
+         dirty |= shaders.erase(GetKey(shader_hash, defines_hash)) != 0;
+      }
+
+      // Removes all the permutations of the shaders that aren't in the list (e.g. because their files have been deleted)
+      void RemoveOtherShaders(const std::unordered_set<uint32_t>& shader_hashes)
+      {
+         const std::unique_lock lock(mutex);
+         dirty |= std::erase_if(shaders, [&](const auto& shader) { return !shader_hashes.contains(shader.second.shader_hash); }) != 0;
+      }
+
+      void Clear()
+      {
+         const std::unique_lock lock(mutex);
+         shaders.clear();
+         dirty = true;
+      }
+
+      void Load(const std::filesystem::path& path)
+      {
+         std::unordered_map<uint64_t, ShaderDependencies> loaded_shaders;
+         uint64_t loaded_set_index = 0;
+         try
+         {
+            std::ifstream file;
+            file.exceptions(std::ifstream::badbit);
+            file.open(path);
+            if (!file.is_open()) return;
+
+            std::string line;
+            if (!std::getline(file, line) || line != file_header) return;
+            while (std::getline(file, line))
+            {
+               // Shader line: hash, target, defines hash, preprocessed hash, files count
+               std::istringstream shader_line(line);
+               size_t files_count = 0;
+               ShaderDependencies dependencies;
+               if (!(shader_line >> std::hex >> dependencies.shader_hash >> dependencies.shader_target >> dependencies.defines_hash >> dependencies.preprocessed_hash >> std::dec >> files_count)) return;
+               dependencies.files.resize(files_count);
+               // File lines: last write time, size, path (till the end of the line, as it can contain spaces)
+               for (auto& file_stamp : dependencies.files)
+               {
+                  if (!std::getline(file, line)) return;
+                  std::istringstream file_line(line);
+                  std::string path_string;
+                  if (!(file_line >> file_stamp.last_write_time >> file_stamp.size) || !std::getline(file_line >> std::ws, path_string)) return;
+                  file_stamp.path = std::u8string(path_string.begin(), path_string.end());
+               }
+               dependencies.set_index = ++loaded_set_index;
+               loaded_shaders[GetKey(dependencies.shader_hash, dependencies.defines_hash)] = std::move(dependencies);
+            }
+         }
+         catch (const std::exception& e)
+         {
+            return;
+         }
+
+         const std::unique_lock lock(mutex);
+         shaders = std::move(loaded_shaders);
+         last_set_index = loaded_set_index;
+         dirty = false;
+      }
+
+      // Only writes the file if anything changed since the last load or save
+      void Save(const std::filesystem::path& path)
+      {
+         const std::unique_lock lock(mutex);
+         if (!dirty) return;
+
+         auto temp_path = path;
+         temp_path += ".tmp";
+         try
+         {
+            std::ofstream file;
+            file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            file.open(temp_path, std::ios::trunc);
+            file << file_header << '\n';
+            for (const auto& shader : shaders)
+            {
+               file << std::hex << shader.second.shader_hash << ' ' << shader.second.shader_target << ' ' << shader.second.defines_hash << ' ' << shader.second.preprocessed_hash << ' ' << std::dec << shader.second.files.size() << '\n';
+               for (const auto& file_stamp : shader.second.files)
+               {
+                  const std::u8string path_string = file_stamp.path.u8string();
+                  file << file_stamp.last_write_time << ' ' << file_stamp.size << ' ';
+                  file.write(reinterpret_cast<const char*>(path_string.data()), path_string.size());
+                  file << '\n';
+               }
+            }
+         }
+         catch (const std::exception& e)
+         {
+            return;
+         }
+         // Replace the file in one go, so we never leave a half written one behind
+         std::error_code error_code;
+         std::filesystem::rename(temp_path, path, error_code);
+         dirty = (bool)error_code;
+      }
+
+   private:
+      static uint64_t GetKey(uint32_t shader_hash, uint64_t defines_hash)
+      {
+         return defines_hash ^ (uint64_t(shader_hash) * 0x9E3779B97F4A7C15ull);
+      }
+
+      // Returns true if "dependencies" can't be up to date anymore, given that "newer_dependencies" (of the same shader) have just been built
+      static bool IsStale(const ShaderDependencies& dependencies, const ShaderDependencies& newer_dependencies)
+      {
+         if (dependencies.files.empty() || dependencies.files[0].path != newer_dependencies.files[0].path || dependencies.shader_target != newer_dependencies.shader_target) return true;
+         for (const auto& file : dependencies.files)
+         {
+            for (const auto& newer_file : newer_dependencies.files)
+            {
+               if (file.path == newer_file.path && file != newer_file) return true;
+            }
+         }
+         return false;
+      }
+
+      // v2: entries are per defines permutation (more than one per shader)
+      static constexpr const char* file_header = "Luma Shaders Dependencies v2";
+
+      mutable std::shared_mutex mutex;
+      std::unordered_map<uint64_t, ShaderDependencies> shaders; // By shader hash and defines hash (see "GetKey()")
+      uint64_t last_set_index = 0;
+      bool dirty = false;
+   };
+}
@@ -0,0 +1,299 @@
+// Standalone tests of "utils/cbuffer.hpp", checking the vectorized helpers against plain reference versions of them, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc cbuffer_tests.cpp && cbuffer_tests.exe
+// g++ -std=c++20 -O2 cbuffer_tests.cpp -o cbuffer_tests && ./cbuffer_tests
+// Build with "/arch:AVX2" or "-mavx2" to test the AVX2 versions too.
+
+#include "../src/utils/cbuffer.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   using namespace utils::cbuffer;
+
+   // Deterministic "random" data, so the tests are reproducible
+   std::vector<uint8_t> MakeData(size_t size, uint32_t seed)
+   {
+      std::vector<uint8_t> data(size);
+      uint32_t state = seed * 2654435761u + 1;
+      for (auto& byte : data)
+      {
+         state ^= state << 13;
+         state ^= state >> 17;
+         state ^= state << 5;
+         byte = uint8_t(state);
+      }
+      return data;
+   }
+
+#if CBUFFER_SSE2
+   uint64_t RotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+   uint64_t LoadLane(const uint8_t* bytes)
+   {
+      uint64_t lane;
+      std::memcpy(&lane, bytes, sizeof(lane));
+      return lane;
+   }
+#endif // CBUFFER_SSE2
+
+   // What "ComputeFingerprint()" is meant to do, for whichever instruction set it was compiled with, one (64 bit) lane at a time
+   uint64_t ReferenceFingerprint(const void* data, size_t size)
+   {
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+      uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+#if CBUFFER_SSE2
+      uint64_t lanes[2] = {};
+      size_t i = 0;
+#if CBUFFER_AVX2
+      uint64_t lanes_256[4] = {};
+      for (; i + 32 <= size; i += 32)
+      {
+         for (size_t lane = 0; lane < 4; lane++)
+         {
+            lanes_256[lane] = RotateLeft(lanes_256[lane], 7) ^ LoadLane(bytes + i + lane * 8);
+         }
+      }
+      lanes[0] = lanes_256[0] ^ lanes_256[2];
+      lanes[1] = lanes_256[1] ^ lanes_256[3];
+#endif // CBUFFER_AVX2
+      for (; i + 16 <= size; i += 16)
+      {
+         lanes[0] = RotateLeft(lanes[0], 7) ^ LoadLane(bytes + i);
+         lanes[1] = RotateLeft(lanes[1], 7) ^ LoadLane(bytes + i + 8);
+      }
+      hash = (hash ^ lanes[0]) * 0xFF51AFD7ED558CCDull;
+      hash = (hash ^ lanes[1]) * 0xC4CEB9FE1A85EC53ull;
+      bytes += i;
+      size -= i;
+#endif // CBUFFER_SSE2
+      for (size_t j = 0; j < size; j++)
+      {
+         hash = (hash ^ bytes[j]) * 0x100000001B3ull;
+      }
+      return hash ^ (hash >> 33);
+   }
+
+   uint64_t ReferenceCompareRegisters(const uint8_t* a, const uint8_t* b, size_t size)
+   {
+      uint64_t changed_mask = 0;
+      for (size_t i = 0; i < size / register_size; i++)
+      {
+         for (size_t j = 0; j < register_size; j++)
+         {
+            if (a[i * register_size + j] != b[i * register_size + j])
+            {
+               changed_mask |= 1ull << i;
+            }
+         }
+      }
+      return changed_mask;
+   }
+
+   // All the sizes (including the odd ones, that have a scalar tail), and single byte changes anywhere, match the reference
+   void TestFingerprint()
+   {
+      for (size_t size = 0; size <= 256; size++)
+      {
+         const auto data = MakeData(size, uint32_t(size));
+         CHECK(ComputeFingerprint(data.data(), size) == ReferenceFingerprint(data.data(), size));
+      }
+      const auto data = MakeData(max_compared_size, 7);
+      CHECK(ComputeFingerprint(data.data(), data.size()) == ReferenceFingerprint(data.data(), data.size()));
+
+      // The fingerprint of a few buffers (one register, and the size of "CBPerViewGlobal") with each byte changed are all different
+      for (const size_t size : { size_t(16), size_t(528) })
+      {
+         auto changed_data = MakeData(size, 3);
+         const uint64_t fingerprint = ComputeFingerprint(changed_data.data(), size);
+         CHECK(fingerprint != ComputeFingerprint(changed_data.data(), size - register_size)); // The size counts too
+         for (size_t i = 0; i < size; i++)
+         {
+            changed_data[i] ^= 0x01;
+            CHECK(ComputeFingerprint(changed_data.data(), size) != fingerprint);
+            CHECK(ComputeFingerprint(changed_data.data(), size) == ReferenceFingerprint(changed_data.data(), size));
+            changed_data[i] ^= 0x01;
+         }
+         CHECK(ComputeFingerprint(changed_data.data(), size) == fingerprint);
+      }
+
+      // Golden values, so the fingerprint can't silently change between builds with the same instruction set (the empty buffer has no vectorized part)
+      CHECK(ComputeFingerprint(nullptr, 0) == ReferenceFingerprint(nullptr, 0));
+      const uint64_t empty_hash = 0x9E3779B97F4A7C15ull;
+#if CBUFFER_SSE2
+      const uint64_t empty_expected_hash = (empty_hash * 0xFF51AFD7ED558CCDull) * 0xC4CEB9FE1A85EC53ull;
+#else
+      const uint64_t empty_expected_hash = empty_hash;
+#endif // CBUFFER_SSE2
+      CHECK(ComputeFingerprint(nullptr, 0) == (empty_expected_hash ^ (empty_expected_hash >> 33)));
+   }
+
+   void TestCompareRegisters()
+   {
+      const auto a = MakeData(max_compared_size, 1);
+      auto b = a;
+      for (size_t size = register_size; size <= max_compared_size; size += register_size)
+      {
+         CHECK(CompareRegisters(a.data(), b.data(), size) == 0);
+      }
+
+      // The first and last bytes of each register, then random registers changed at once
+      for (size_t i = 0; i < max_compared_size / register_size; i++)
+      {
+         for (const size_t byte : { i * register_size, i * register_size + register_size - 1 })
+         {
+            b[byte] ^= 0x80;
+            CHECK(CompareRegisters(a.data(), b.data(), max_compared_size) == (1ull << i));
+            b[byte] ^= 0x80;
+         }
+      }
+      for (uint32_t seed = 0; seed < 64; seed++)
+      {
+         const auto other = MakeData(max_compared_size, seed + 100);
+         b = a;
+         for (size_t i = 0; i < max_compared_size / register_size; i++)
+         {
+            if ((other[i] & 3) == 0) b[i * register_size + (other[i] % register_size)] = uint8_t(~a[i * register_size + (other[i] % register_size)]);
+         }
+         for (const size_t size : { register_size, register_size * 3, size_t(528), max_compared_size })
+         {
+            CHECK(CompareRegisters(a.data(), b.data(), size) == ReferenceCompareRegisters(a.data(), b.data(), size));
+         }
+      }
+   }
+
+   void TestComparisons()
+   {
+      const float nan = std::numeric_limits<float>::quiet_NaN();
+      const float infinity = std::numeric_limits<float>::infinity();
+      const float values[] = { 1.f, 2.f, 3.f, 4.f };
+      CHECK(AllGreater(values, 0.f));
+      CHECK(!AllGreater(values, 1.f));
+      CHECK(AllGreater(values, 1.f, true));
+      CHECK(!AllGreater(values, 1.5f, true));
+      CHECK(AllInRange(values, 0.f, 4.f));
+      CHECK(!AllInRange(values, 1.f, 4.f)); // "min" is exclusive
+      CHECK(!AllInRange(values, 0.f, 3.999f));
+
+      // Any NaN fails (like garbage data would), infinity only fails the range check
+      for (size_t i = 0; i < 4; i++)
+      {
+         float invalid_values[] = { 1.f, 2.f, 3.f, 4.f };
+         invalid_values[i] = nan;
+         CHECK(!AllGreater(invalid_values, 0.f));
+         CHECK(!AllGreater(invalid_values, 0.f, true));
+         CHECK(!AllInRange(invalid_values, 0.f, 10.f));
+         invalid_values[i] = infinity;
+         CHECK(AllGreater(invalid_values, 0.f));
+         CHECK(!AllInRange(invalid_values, 0.f, 10.f));
+         invalid_values[i] = -0.f;
+         CHECK(!AllGreater(invalid_values, 0.f));
+         CHECK(AllGreater(invalid_values, 0.f, true));
+      }
+   }
+
+   // Hits only ever return the verdict the same data had, whatever the fingerprint says
+   void TestVerdictCache()
+   {
+      constexpr size_t size = 528;
+      VerdictCache<size, 4> cache;
+      std::vector<std::vector<uint8_t>> buffers;
+      for (uint32_t i = 0; i < 6; i++)
+      {
+         buffers.push_back(MakeData(size, i));
+      }
+      const auto fingerprint = [&](size_t i) { return ComputeFingerprint(buffers[i].data(), size); };
+
+      bool verdict = false;
+      CHECK(!cache.Find(buffers[0].data(), fingerprint(0), verdict));
+      cache.Add(buffers[0].data(), fingerprint(0), true);
+      cache.Add(buffers[1].data(), fingerprint(1), false);
+      CHECK(cache.Find(buffers[0].data(), fingerprint(0), verdict) && verdict);
+      CHECK(cache.Find(buffers[1].data(), fingerprint(1), verdict) && !verdict);
+
+      // A (forced) fingerprint collision with different data is a miss, so is the right data with a wrong fingerprint
+      CHECK(!cache.Find(buffers[2].data(), fingerprint(0), verdict));
+      CHECK(!cache.Find(buffers[0].data(), fingerprint(0) ^ 1, verdict));
+      auto almost_same_data = buffers[0];
+      almost_same_data[size - 1] ^= 0x01;
+      CHECK(!cache.Find(almost_same_data.data(), fingerprint(0), verdict));
+
+      // The oldest entries are replaced first
+      cache.Add(buffers[2].data(), fingerprint(2), true);
+      cache.Add(buffers[3].data(), fingerprint(3), true);
+      cache.Add(buffers[4].data(), fingerprint(4), false);
+      CHECK(!cache.Find(buffers[0].data(), fingerprint(0), verdict));
+      CHECK(cache.Find(buffers[1].data(), fingerprint(1), verdict) && !verdict);
+      CHECK(cache.Find(buffers[4].data(), fingerprint(4), verdict) && !verdict);
+
+      cache.Clear();
+      for (size_t i = 0; i < buffers.size(); i++)
+      {
+         CHECK(!cache.Find(buffers[i].data(), fingerprint(i), verdict));
+      }
+   }
+
+   // Like the cbuffer being validated from multiple threads (e.g. maps on deferred contexts): verdicts never get mixed up between buffers
+   void TestVerdictCacheThreads()
+   {
+      constexpr size_t size = 528;
+      constexpr size_t buffers_num = 16;
+      VerdictCache<size> cache;
+      std::vector<std::vector<uint8_t>> buffers;
+      for (uint32_t i = 0; i < buffers_num; i++)
+      {
+         buffers.push_back(MakeData(size, i + 1000));
+      }
+      // The "validation": odd buffers are valid
+      const auto validate = [](size_t i) { return (i % 2) == 1; };
+
+      std::atomic<size_t> hits = 0;
+      std::vector<std::thread> threads;
+      for (size_t thread_index = 0; thread_index < 4; thread_index++)
+      {
+         threads.emplace_back([&, thread_index]()
+            {
+               for (size_t iteration = 0; iteration < 20000; iteration++)
+               {
+                  // Each thread mostly re-validates a few buffers, like the game does within a frame
+                  const size_t i = ((iteration / 8) + thread_index * 3) % buffers_num;
+                  const uint64_t fingerprint = ComputeFingerprint(buffers[i].data(), size);
+                  bool verdict = false;
+                  if (cache.Find(buffers[i].data(), fingerprint, verdict))
+                  {
+                     CHECK(verdict == validate(i));
+                     hits++;
+                  }
+                  else
+                  {
+                     cache.Add(buffers[i].data(), fingerprint, validate(i));
+                  }
+               }
+            });
+      }
+      for (auto& thread : threads)
+      {
+         thread.join();
+      }
+      CHECK(hits > 0);
+   }
+}
+
+int main()
+{
+   TestFingerprint();
+   TestCompareRegisters();
+   TestComparisons();
+   TestVerdictCache();
+   TestVerdictCacheThreads();
+   std::printf("All cbuffer tests passed\n");
+   return 0;
+}
@@ -0,0 +1,273 @@
+// Standalone tests of "custom_sampler_cache.h", against the headless D3D11 mock ("mock/d3d11.h"), simulating dynamic resolution scaling, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc /Imock custom_sampler_cache_tests.cpp && custom_sampler_cache_tests.exe
+// g++ -std=c++20 -O2 -Imock custom_sampler_cache_tests.cpp -o custom_sampler_cache_tests && ./custom_sampler_cache_tests
+
+#include "../src/includes/custom_sampler_cache.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <thread>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   constexpr uint32_t alive_canary = 0xA11FE;
+   constexpr uint32_t released_canary = 0xDEAD;
+
+   // Custom samplers aren't deleted on their last release, only marked as such (and deleted at the end), so lock free readers can verify they never get one that was released
+   struct MockSampler : ID3D11SamplerState
+   {
+      static inline std::atomic<int64_t> created = 0;
+      static inline std::atomic<int64_t> alive = 0;
+      static inline std::mutex graveyard_mutex;
+      static inline std::vector<MockSampler*> graveyard;
+
+      MockSampler() { created++; alive++; }
+
+      ULONG Release() override
+      {
+         const ULONG new_ref_count = --ref_count;
+         if (new_ref_count == 0)
+         {
+            canary = released_canary;
+            alive--;
+            const std::lock_guard lock(graveyard_mutex);
+            graveyard.push_back(this);
+         }
+         return new_ref_count;
+      }
+
+      static void ClearGraveyard()
+      {
+         for (MockSampler* sampler : graveyard)
+         {
+            delete sampler;
+         }
+         graveyard.clear();
+      }
+
+      std::atomic<uint32_t> canary = alive_canary;
+   };
+
+   // Like "CreateCustomSamplerFromOriginal()": only anisotropic samplers are replaced, with the LOD bias
+   com_ptr<ID3D11SamplerState> CreateCustomSampler(ID3D11SamplerState* original_sampler, float lod_bias)
+   {
+      if (original_sampler->desc.Filter != D3D11_FILTER_ANISOTROPIC) return nullptr;
+      MockSampler* sampler = new MockSampler();
+      sampler->desc = original_sampler->desc;
+      sampler->desc.MipLODBias = lod_bias;
+      sampler->desc.MaxAnisotropy = D3D11_REQ_MAXANISOTROPY;
+      return com_ptr<ID3D11SamplerState>(sampler, true);
+   }
+
+   // The game samplers
+   struct OriginalSamplers
+   {
+      std::vector<com_ptr<ID3D11SamplerState>> samplers;
+
+      explicit OriginalSamplers(size_t samplers_num)
+      {
+         for (size_t i = 0; i < samplers_num; i++)
+         {
+            com_ptr<ID3D11SamplerState> sampler(new ID3D11SamplerState(), true);
+            sampler->desc.Filter = (i % 4) == 3 ? D3D11_FILTER_MIN_MAG_MIP_LINEAR : D3D11_FILTER_ANISOTROPIC;
+            samplers.push_back(sampler);
+         }
+      }
+
+      uint64_t Handle(size_t i) const { return reinterpret_cast<uint64_t>(samplers[i].get()); }
+      size_t ReplacedCount() const { return samplers.size() - samplers.size() / 4; }
+   };
+
+   // Same as the addon's formula: -1 at output resolution, one mip lower for every halving of the rendering resolution
+   float GetLODBias(float render_scale)
+   {
+      return custom_sampler_cache::quantize_lod_bias(std::log2(render_scale) - 1.f);
+   }
+
+   void TestQuantization()
+   {
+      CHECK(custom_sampler_cache::quantize_lod_bias(0.f) == 0.f);
+      CHECK(custom_sampler_cache::quantize_lod_bias(-1.f) == -1.f);
+      CHECK(custom_sampler_cache::quantize_lod_bias(-1.01f) == -1.f);
+      CHECK(custom_sampler_cache::quantize_lod_bias(-1.04f) == -1.f - custom_sampler_cache::lod_bias_step);
+
+      rcu_domain domain;
+      custom_sampler_cache cache(domain);
+      CHECK(!cache.set_lod_bias(0.01f, &CreateCustomSampler)); // Same quantized bias as the initial one
+      CHECK(cache.set_lod_bias(-1.f, &CreateCustomSampler));
+      CHECK(!cache.set_lod_bias(-1.02f, &CreateCustomSampler));
+      CHECK(cache.set_lod_bias(-1.1f, &CreateCustomSampler));
+   }
+
+   // Dynamic resolution scaling continuously changes the rendering resolution, every frame:
+   // samplers are only created for each quantized LOD bias, and only the ones for "max_lod_biases" of them are ever alive (once retired samplers are released).
+   void TestDynamicResolution()
+   {
+      {
+         rcu_domain domain;
+         OriginalSamplers original_samplers(64);
+         custom_sampler_cache cache(domain);
+         cache.set_lod_bias(GetLODBias(1.f), &CreateCustomSampler);
+         for (size_t i = 0; i < original_samplers.samplers.size(); i++)
+         {
+            cache.add(original_samplers.Handle(i), &CreateCustomSampler);
+         }
+         CHECK(cache.get_custom_samplers_count() == original_samplers.ReplacedCount());
+
+         std::set<float> lod_biases;
+         size_t lod_bias_changes = 0;
+         size_t max_alive = 0;
+         const int64_t initially_created = MockSampler::created;
+         for (uint32_t frame = 0; frame < 2000; frame++)
+         {
+            // Oscillates between 50% and 100% of the output resolution, a bit every frame
+            const float render_scale = 0.75f + 0.25f * std::cos(float(frame) * 0.01f);
+            const float lod_bias = GetLODBias(render_scale);
+            lod_biases.insert(lod_bias);
+            lod_bias_changes += cache.set_lod_bias(lod_bias, &CreateCustomSampler) ? 1 : 0;
+
+            // Every bind gets the sampler for the current bias
+            for (size_t i = 0; i < original_samplers.samplers.size(); i += 7)
+            {
+               const rcu_domain::read_scope read_scope(domain);
+               uint64_t custom_sampler = 0;
+               CHECK(cache.find(original_samplers.Handle(i), custom_sampler));
+               if (original_samplers.samplers[i]->desc.Filter != D3D11_FILTER_ANISOTROPIC)
+               {
+                  CHECK(custom_sampler == 0);
+                  continue;
+               }
+               const MockSampler* sampler = reinterpret_cast<const MockSampler*>(custom_sampler);
+               CHECK(sampler->canary == alive_canary && sampler->desc.MipLODBias == lod_bias);
+            }
+
+            domain.advance_epoch(); // On present
+            max_alive = std::max(max_alive, size_t(MockSampler::alive.load()));
+            CHECK(cache.get_custom_samplers_count() <= original_samplers.ReplacedCount() * custom_sampler_cache::max_lod_biases);
+         }
+         // The biases only go from -2 to -1, with some steps skipped at the extremes (the scale changes the slowest there)
+         CHECK(lod_biases.size() <= size_t(1.f / custom_sampler_cache::lod_bias_step) + 1);
+         // Frames only create samplers when the quantized bias changes (not every frame), and not even then if the bias was recently used (e.g. when the oscillation turns back)
+         CHECK(lod_bias_changes < 2000 / 4);
+         CHECK(size_t(MockSampler::created - initially_created) < lod_bias_changes * original_samplers.ReplacedCount());
+         CHECK(max_alive <= original_samplers.ReplacedCount() * (custom_sampler_cache::max_lod_biases + 1)); // The ones of an evicted bias live until the next epoch
+         domain.advance_epoch();
+         CHECK(size_t(MockSampler::alive.load()) <= original_samplers.ReplacedCount() * custom_sampler_cache::max_lod_biases);
+
+         cache.clear();
+         CHECK(cache.empty() && cache.get_custom_samplers_count() == 0);
+      }
+      CHECK(MockSampler::alive == 0);
+      MockSampler::ClearGraveyard();
+   }
+
+   // Toggling between a few resolutions (e.g. DLSS quality modes, or DLSS on and off) never re-creates any sampler
+   void TestToggling()
+   {
+      rcu_domain domain;
+      OriginalSamplers original_samplers(16);
+      custom_sampler_cache cache(domain);
+      for (size_t i = 0; i < original_samplers.samplers.size(); i++)
+      {
+         cache.add(original_samplers.Handle(i), &CreateCustomSampler);
+      }
+      const float render_scales[] = { 1.f, 0.667f, 0.58f, 0.5f };
+      for (const float render_scale : render_scales)
+      {
+         cache.set_lod_bias(GetLODBias(render_scale), &CreateCustomSampler);
+      }
+      const int64_t created = MockSampler::created;
+      for (uint32_t frame = 0; frame < 100; frame++)
+      {
+         cache.set_lod_bias(GetLODBias(render_scales[(frame / 3) % std::size(render_scales)]), &CreateCustomSampler);
+         domain.advance_epoch();
+      }
+      CHECK(MockSampler::created == created);
+
+      // One more resolution evicts the least recently used one
+      cache.set_lod_bias(GetLODBias(0.33f), &CreateCustomSampler);
+      CHECK(MockSampler::created == created + int64_t(original_samplers.ReplacedCount()));
+      CHECK(cache.get_custom_samplers_count() == original_samplers.ReplacedCount() * custom_sampler_cache::max_lod_biases);
+
+      // Re-creating them (e.g. the samplers settings changed) only keeps the active bias
+      cache.recreate(GetLODBias(0.33f), &CreateCustomSampler);
+      CHECK(cache.get_custom_samplers_count() == original_samplers.ReplacedCount());
+      const uint64_t removed_sampler = original_samplers.Handle(0);
+      uint64_t custom_sampler = 0;
+      CHECK(cache.find(removed_sampler, custom_sampler) && cache.is_custom_sampler(custom_sampler));
+      cache.remove(removed_sampler);
+      CHECK(!cache.find(removed_sampler, custom_sampler));
+      CHECK(cache.get_custom_samplers_count() == original_samplers.ReplacedCount() - 1);
+      cache.clear();
+      domain.advance_epoch();
+      CHECK(MockSampler::alive == 0);
+      MockSampler::ClearGraveyard();
+   }
+
+   // Draw threads keep looking up samplers (lock free) while the LOD bias changes every frame: they never get a sampler that was already released
+   void TestConcurrentLookups()
+   {
+      {
+         rcu_domain domain;
+         OriginalSamplers original_samplers(32);
+         custom_sampler_cache cache(domain);
+         cache.set_lod_bias(GetLODBias(1.f), &CreateCustomSampler);
+         for (size_t i = 0; i < original_samplers.samplers.size(); i++)
+         {
+            cache.add(original_samplers.Handle(i), &CreateCustomSampler);
+         }
+
+         std::atomic<bool> stop = false;
+         std::atomic<uint64_t> lookups = 0;
+         std::vector<std::thread> readers;
+         for (size_t reader = 0; reader < 3; reader++)
+         {
+            readers.emplace_back([&, reader]()
+               {
+                  for (size_t i = reader; !stop; i = (i + 1) % original_samplers.samplers.size())
+                  {
+                     const rcu_domain::read_scope read_scope(domain);
+                     uint64_t custom_sampler = 0;
+                     CHECK(cache.find(original_samplers.Handle(i), custom_sampler));
+                     if (custom_sampler != 0)
+                     {
+                        const MockSampler* sampler = reinterpret_cast<const MockSampler*>(custom_sampler);
+                        CHECK(sampler->canary == alive_canary);
+                        CHECK(sampler->desc.MipLODBias <= -1.f && sampler->desc.MipLODBias >= -3.f);
+                     }
+                     lookups++;
+                  }
+               });
+         }
+         for (uint32_t frame = 0; frame < 3000; frame++)
+         {
+            cache.set_lod_bias(GetLODBias(0.25f + 0.75f * float(frame % 97) / 96.f), &CreateCustomSampler);
+            domain.advance_epoch();
+         }
+         stop = true;
+         for (auto& reader : readers)
+         {
+            reader.join();
+         }
+         CHECK(lookups > 0);
+         cache.clear();
+      }
+      CHECK(MockSampler::alive == 0);
+      MockSampler::ClearGraveyard();
+   }
+}
+
+int main()
+{
+   TestQuantization();
+   TestDynamicResolution();
+   TestToggling();
+   TestConcurrentLookups();
+   std::printf("All custom_sampler_cache tests passed\n");
+   return 0;
+}
@@ -0,0 +1,225 @@
+// Standalone tests of "directory_watcher.hpp" (through "ReadDirectoryChangesW()" on Windows and "inotify" on Linux), on a temporary shaders folder, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc directory_watcher_tests.cpp && directory_watcher_tests.exe
+// g++ -std=c++20 -O2 -pthread directory_watcher_tests.cpp -o directory_watcher_tests && ./directory_watcher_tests
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "../src/utils/directory_watcher.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   using utils::files::DirectoryWatcher;
+
+   // Like in the addon, the watchers run as jobs of the background jobs system (one worker is always left free for render critical jobs)
+   job_system jobs(2);
+
+   constexpr auto debounce_time = std::chrono::milliseconds(100);
+   // Much longer than the debounce time, to not fail on slow machines
+   constexpr auto callback_timeout = std::chrono::seconds(5);
+
+   // Collects the callbacks from the watcher thread
+   struct CallbackRecorder
+   {
+      std::mutex mutex;
+      std::condition_variable condition;
+      std::vector<std::vector<std::filesystem::path>> calls;
+
+      DirectoryWatcher::Callback callback()
+      {
+         return [this](const std::vector<std::filesystem::path>& changed_files)
+            {
+               const std::lock_guard lock(mutex);
+               calls.push_back(changed_files);
+               condition.notify_all();
+            };
+      }
+
+      // Waits for the next callback, and then a while longer, to make sure no other callback follows
+      std::vector<std::filesystem::path> WaitForSingleCall()
+      {
+         std::unique_lock lock(mutex);
+         CHECK(condition.wait_for(lock, callback_timeout, [this]() { return !calls.empty(); }));
+         lock.unlock();
+         ExpectNoCall(debounce_time * 4);
+         lock.lock();
+         CHECK(calls.size() == 1);
+         auto changed_files = std::move(calls[0]);
+         calls.clear();
+         return changed_files;
+      }
+
+      void ExpectNoCall(std::chrono::milliseconds time)
+      {
+         std::this_thread::sleep_for(time);
+         const std::lock_guard lock(mutex);
+         CHECK(calls.size() <= 1);
+      }
+
+      bool HasCalls()
+      {
+         const std::lock_guard lock(mutex);
+         return !calls.empty();
+      }
+   };
+
+   std::filesystem::path MakeTempDirectory(const char* name)
+   {
+      const auto directory = std::filesystem::temp_directory_path() / name;
+      std::filesystem::remove_all(directory);
+      std::filesystem::create_directories(directory / "Includes");
+      return directory;
+   }
+
+   void Write(const std::filesystem::path& path, const std::string& text)
+   {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      file << text;
+   }
+
+   bool Contains(const std::vector<std::filesystem::path>& paths, const std::filesystem::path& path)
+   {
+      for (const auto& other_path : paths)
+      {
+         if (other_path.lexically_normal() == path.lexically_normal()) return true;
+      }
+      return false;
+   }
+
+   // Multiple writes (like an editor saving through a temporary file), in the root and in sub directories, result in a single callback with all the files
+   void TestDebouncedChanges()
+   {
+      const auto directory = MakeTempDirectory("luma_directory_watcher_changes");
+      const auto shader = directory / "Final_0x12345678.ps_5_0.hlsl";
+      const auto settings = directory / "Includes" / "Settings.hlsl";
+      Write(shader, "float4 main() : SV_Target { return 0; }\n");
+      Write(settings, "#define ENABLE_LUT 1\n");
+
+      CallbackRecorder recorder;
+      DirectoryWatcher watcher;
+      CHECK(watcher.Start(jobs, directory, true, debounce_time, recorder.callback()));
+      CHECK(!recorder.HasCalls());
+
+      Write(directory / "Settings.hlsl.tmp", "#define ENABLE_LUT 0\n");
+      std::filesystem::rename(directory / "Settings.hlsl.tmp", settings);
+      Write(shader, "float4 main() : SV_Target { return 1; }\n");
+      const auto changed_files = recorder.WaitForSingleCall();
+      CHECK(Contains(changed_files, shader));
+      CHECK(Contains(changed_files, settings));
+
+      // Removed files are ignored
+      std::filesystem::remove(shader);
+      recorder.ExpectNoCall(debounce_time * 4);
+      CHECK(!recorder.HasCalls());
+
+      watcher.Stop();
+      std::filesystem::remove_all(directory);
+   }
+
+   // Sub directories are only watched when recursive
+   void TestNotRecursive()
+   {
+      const auto directory = MakeTempDirectory("luma_directory_watcher_not_recursive");
+      CallbackRecorder recorder;
+      DirectoryWatcher watcher;
+      CHECK(watcher.Start(jobs, directory, false, debounce_time, recorder.callback()));
+      Write(directory / "Includes" / "Settings.hlsl", "#define ENABLE_LUT 1\n");
+      Write(directory / "Final_0x12345678.ps_5_0.hlsl", "");
+      const auto changed_files = recorder.WaitForSingleCall();
+      CHECK(Contains(changed_files, directory / "Final_0x12345678.ps_5_0.hlsl"));
+      CHECK(!Contains(changed_files, directory / "Includes" / "Settings.hlsl"));
+      watcher.Stop();
+      std::filesystem::remove_all(directory);
+   }
+
+   // Directories created (or moved in) after the watcher started are watched too, with any file that was already in them
+   void TestNewDirectories()
+   {
+      const auto directory = MakeTempDirectory("luma_directory_watcher_new_directories");
+      CallbackRecorder recorder;
+      DirectoryWatcher watcher;
+      CHECK(watcher.Start(jobs, directory, true, debounce_time, recorder.callback()));
+
+      std::filesystem::create_directories(directory / "Game" / "Tonemap");
+      Write(directory / "Game" / "Tonemap" / "Tonemap_0x9ABCDEF0.ps_5_0.hlsl", "");
+      const auto changed_files = recorder.WaitForSingleCall();
+      CHECK(Contains(changed_files, directory / "Game" / "Tonemap" / "Tonemap_0x9ABCDEF0.ps_5_0.hlsl"));
+
+      // Now that it's watched, later writes are seen as well
+      Write(directory / "Game" / "Tonemap" / "Tonemap_0x9ABCDEF0.ps_5_0.hlsl", "float4 main() : SV_Target { return 1; }\n");
+      CHECK(Contains(recorder.WaitForSingleCall(), directory / "Game" / "Tonemap" / "Tonemap_0x9ABCDEF0.ps_5_0.hlsl"));
+
+      watcher.Stop();
+      std::filesystem::remove_all(directory);
+   }
+
+   // The watcher can be stopped (without any callback after that) and started again, even on another directory, and it can't start on a folder that doesn't exist
+   void TestRestart()
+   {
+      const auto directory = MakeTempDirectory("luma_directory_watcher_restart");
+      CallbackRecorder recorder;
+      DirectoryWatcher watcher;
+      CHECK(!watcher.Start(jobs, directory / "Missing", true, debounce_time, recorder.callback()));
+      CHECK(watcher.Start(jobs, directory, true, debounce_time, recorder.callback()));
+      watcher.Stop();
+      watcher.Stop();
+      Write(directory / "Final_0x12345678.ps_5_0.hlsl", "");
+      recorder.ExpectNoCall(debounce_time * 4);
+      CHECK(!recorder.HasCalls());
+
+      CHECK(watcher.Start(jobs, directory / "Includes", true, debounce_time, recorder.callback()));
+      Write(directory / "Includes" / "Common.hlsl", "");
+      CHECK(Contains(recorder.WaitForSingleCall(), directory / "Includes" / "Common.hlsl"));
+
+      // Stopping while changes are pending drops them
+      Write(directory / "Includes" / "Common.hlsl", "float3 Linearize(float3 color);\n");
+      watcher.Stop();
+      recorder.ExpectNoCall(debounce_time * 4);
+      CHECK(!recorder.HasCalls());
+      std::filesystem::remove_all(directory);
+   }
+
+   // The watcher only occupies a single worker while it runs, render critical jobs still go through, and it can't start after the job system began shutting down
+   void TestJobs()
+   {
+      const auto directory = MakeTempDirectory("luma_directory_watcher_jobs");
+      CallbackRecorder recorder;
+      DirectoryWatcher watcher;
+      CHECK(watcher.Start(jobs, directory, true, debounce_time, recorder.callback()));
+      CHECK(jobs.get_active_jobs() == 1);
+      std::atomic<bool> ran = false;
+      jobs.submit(JobPriority::RenderCritical, [&ran](const std::atomic<bool>& /*cancelled*/) { ran = true; }).wait();
+      CHECK(ran);
+      Write(directory / "Final_0x12345678.ps_5_0.hlsl", "");
+      CHECK(Contains(recorder.WaitForSingleCall(), directory / "Final_0x12345678.ps_5_0.hlsl"));
+      watcher.Stop();
+      CHECK(jobs.get_active_jobs() == 0);
+
+      jobs.shutdown();
+      job_system stopped_jobs(1);
+      stopped_jobs.shutdown_detached(false);
+      CHECK(!watcher.Start(stopped_jobs, directory, true, debounce_time, recorder.callback()));
+      std::filesystem::remove_all(directory);
+   }
+}
+
+int main()
+{
+   TestDebouncedChanges();
+   TestNotRecursive();
+   TestNewDirectories();
+   TestRestart();
+   TestJobs();
+   std::printf("All directory_watcher tests passed\n");
+   return 0;
+}
@@ -0,0 +1,184 @@
+// Standalone tests of "draw_state_stack.h", against the headless D3D11 mock ("mock/d3d11.h") with a device context that keeps its states and counts the calls ("mock/mock_runtime.h"), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc /Imock draw_state_stack_tests.cpp && draw_state_stack_tests.exe
+// g++ -std=c++20 -O2 -Imock draw_state_stack_tests.cpp -o draw_state_stack_tests && ./draw_state_stack_tests
+
+#include "../src/includes/draw_state_stack.h"
+#include "mock/mock_runtime.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   constexpr UINT settings_cbuffer_index = 2;
+   constexpr UINT data_cbuffer_index = 8;
+
+   // The objects of our custom copy pass (as in "DrawCustomPixelShader()"), and the ones the game had bound
+   struct Objects
+   {
+      com_ptr<ID3D11Texture2D> source_texture = com_ptr<ID3D11Texture2D>(new ID3D11Texture2D(), true);
+      com_ptr<ID3D11Texture2D> target_texture = com_ptr<ID3D11Texture2D>(new ID3D11Texture2D(), true);
+      com_ptr<ID3D11ShaderResourceView> srv = com_ptr<ID3D11ShaderResourceView>(new ID3D11ShaderResourceView(source_texture.get(), {}), true);
+      com_ptr<ID3D11RenderTargetView> rtv = com_ptr<ID3D11RenderTargetView>(new ID3D11RenderTargetView(target_texture.get(), {}), true);
+      com_ptr<ID3D11BlendState> blend_state = com_ptr<ID3D11BlendState>(new ID3D11BlendState(), true);
+      com_ptr<ID3D11VertexShader> vs = com_ptr<ID3D11VertexShader>(new ID3D11VertexShader(), true);
+      com_ptr<ID3D11PixelShader> ps = com_ptr<ID3D11PixelShader>(new ID3D11PixelShader(), true);
+      com_ptr<ID3D11Buffer> cbuffer = com_ptr<ID3D11Buffer>(new ID3D11Buffer(), true);
+
+      com_ptr<ID3D11RenderTargetView> game_rtvs[2] = { com_ptr<ID3D11RenderTargetView>(new ID3D11RenderTargetView(target_texture.get(), {}), true), com_ptr<ID3D11RenderTargetView>(new ID3D11RenderTargetView(source_texture.get(), {}), true) };
+      com_ptr<ID3D11DepthStencilView> game_dsv = com_ptr<ID3D11DepthStencilView>(new ID3D11DepthStencilView(source_texture.get()), true);
+      com_ptr<ID3D11BlendState> game_blend_state = com_ptr<ID3D11BlendState>(new ID3D11BlendState(), true);
+      com_ptr<ID3D11VertexShader> game_vs = com_ptr<ID3D11VertexShader>(new ID3D11VertexShader(), true);
+      com_ptr<ID3D11PixelShader> game_ps = com_ptr<ID3D11PixelShader>(new ID3D11PixelShader(), true);
+      com_ptr<ID3D11Buffer> game_cbuffer = com_ptr<ID3D11Buffer>(new ID3D11Buffer(), true);
+   };
+
+   constexpr FLOAT pass_blend_factor[4] = { 1.f, 1.f, 1.f, 1.f };
+
+   D3D11_VIEWPORT MakeViewport(FLOAT width, FLOAT height)
+   {
+      D3D11_VIEWPORT viewport = {};
+      viewport.Width = width;
+      viewport.Height = height;
+      viewport.MaxDepth = 1;
+      return viewport;
+   }
+
+   // Same as "DrawCustomPixelShader()"
+   void DrawCustomPixelShader(mock_device_context& device_context, draw_state_stack& state_stack, const Objects& objects)
+   {
+      state_stack.set_blend_state(&device_context, objects.blend_state.get(), pass_blend_factor, 0xFFFFFFFF);
+      state_stack.set_primitive_topology(&device_context, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+      state_stack.clear_scissor_rects(&device_context);
+      state_stack.set_viewport(&device_context, MakeViewport(1920, 1080));
+      state_stack.set_ps_shader_resource(&device_context, objects.srv.get());
+      state_stack.set_render_target(&device_context, objects.rtv.get());
+      state_stack.set_shaders(&device_context, objects.vs.get(), objects.ps.get());
+      device_context.Draw(4, 0);
+   }
+
+   // The game left a completely different state bound: everything is set, and then restored exactly, without leaking any reference
+   void TestRestore()
+   {
+      const int64_t live_objects = IUnknown::live_objects;
+      {
+         Objects objects;
+         mock_device_context device_context;
+         auto& game_states = device_context.current;
+         game_states.blend_state = objects.game_blend_state;
+         game_states.blend_factor[3] = 0.5f;
+         game_states.blend_sample_mask = 0xF;
+         game_states.primitive_topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+         game_states.scissor_rects_num = 2;
+         game_states.scissor_rects[0] = { 0, 0, 1280, 720 };
+         game_states.scissor_rects[1] = { 10, 10, 20, 20 };
+         game_states.viewports_num = 1;
+         game_states.viewports[0] = MakeViewport(1280, 720);
+         game_states.shader_resources[0] = objects.srv; // Already the same, but in another slot too
+         game_states.shader_resources[1] = objects.srv;
+         game_states.constant_buffers[settings_cbuffer_index] = objects.game_cbuffer;
+         game_states.render_targets[0] = objects.game_rtvs[0];
+         game_states.render_targets[1] = objects.game_rtvs[1];
+         game_states.depth_stencil_view = objects.game_dsv;
+         game_states.vs = objects.game_vs;
+         game_states.ps = objects.game_ps;
+         mock_device_context::states initial_states = game_states;
+         const ULONG rtv_ref_count = objects.game_rtvs[0].ref_count();
+
+         draw_state_stack state_stack(settings_cbuffer_index, data_cbuffer_index);
+         DrawCustomPixelShader(device_context, state_stack, objects);
+         CHECK(device_context.draws == 1);
+         CHECK(device_context.current.blend_state == objects.blend_state && device_context.current.primitive_topology == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+         CHECK(device_context.current.scissor_rects_num == 0 && device_context.current.viewports_num == 1);
+         CHECK(device_context.current.render_targets[0] == objects.rtv && device_context.current.render_targets[1] == nullptr && device_context.current.depth_stencil_view == nullptr);
+         CHECK(device_context.current.vs == objects.vs && device_context.current.ps == objects.ps);
+         CHECK(device_context.sets == 7); // Everything but the shader resource (already bound)
+         CHECK(state_stack.get_dirty_states() == (draw_state_stack::state_all & ~draw_state_stack::state_shader_resources & ~draw_state_stack::state_constant_buffers));
+
+         device_context.ResetCounters();
+         state_stack.restore(&device_context);
+         CHECK(device_context.gets == 0 && device_context.sets == 7);
+         CHECK(device_context.current == initial_states);
+         CHECK(objects.game_rtvs[0].ref_count() == rtv_ref_count);
+         CHECK(state_stack.get_cached_states() == draw_state_stack::state_none);
+
+         // The same stack can be used again
+         device_context.ResetCounters();
+         DrawCustomPixelShader(device_context, state_stack, objects);
+         state_stack.restore(&device_context);
+         CHECK(device_context.current == initial_states);
+         CHECK(device_context.sets == 14);
+      }
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+
+   // The game already had the same states bound (e.g. the swapchain as render target on present): nothing is set nor restored, and only the states the pass needs are retrieved
+   void TestNoChanges()
+   {
+      Objects objects;
+      mock_device_context device_context;
+      auto& game_states = device_context.current;
+      game_states.blend_state = objects.blend_state;
+      game_states.primitive_topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+      game_states.viewports_num = 1;
+      game_states.viewports[0] = MakeViewport(1920, 1080);
+      game_states.shader_resources[0] = objects.srv;
+      game_states.render_targets[0] = objects.rtv;
+      game_states.vs = objects.vs;
+      game_states.ps = objects.ps;
+
+      draw_state_stack state_stack(settings_cbuffer_index, data_cbuffer_index);
+      DrawCustomPixelShader(device_context, state_stack, objects);
+      state_stack.restore(&device_context);
+      CHECK(device_context.sets == 0);
+      // Blend, topology, the scissor rects count (there are none), the viewports count and data, the shader resource, the render targets and the two shaders.
+      // Caching everything upfront took 12 calls, 2 of which for cbuffers that this pass never changes.
+      CHECK(device_context.gets == 9);
+      CHECK(device_context.constant_buffers_gets == 0);
+   }
+
+   // States changed directly on the device context (our cbuffers on present) need to be cached first, and are then restored too
+   void TestMarkDirty()
+   {
+      const int64_t live_objects = IUnknown::live_objects;
+      {
+         Objects objects;
+         mock_device_context device_context;
+         device_context.current.constant_buffers[settings_cbuffer_index] = objects.game_cbuffer;
+         mock_device_context::states initial_states = device_context.current;
+
+         draw_state_stack state_stack(settings_cbuffer_index, data_cbuffer_index);
+         CHECK(state_stack.get_render_target_view(&device_context, 0) == nullptr);
+         state_stack.cache(&device_context, draw_state_stack::state_constant_buffers);
+         CHECK(device_context.constant_buffers_gets == 2);
+         ID3D11Buffer* const cbuffer = objects.cbuffer.get();
+         device_context.PSSetConstantBuffers(settings_cbuffer_index, 1, &cbuffer);
+         device_context.PSSetConstantBuffers(data_cbuffer_index, 1, &cbuffer);
+         state_stack.mark_dirty(draw_state_stack::state_constant_buffers);
+         DrawCustomPixelShader(device_context, state_stack, objects);
+         CHECK(device_context.constant_buffers_gets == 2); // Not retrieved again
+         state_stack.restore(&device_context);
+         CHECK(device_context.current == initial_states);
+
+         // Without anything set, nothing is restored
+         device_context.ResetCounters();
+         state_stack.cache(&device_context, draw_state_stack::state_all);
+         state_stack.restore(&device_context);
+         CHECK(device_context.sets == 0);
+      }
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+}
+
+int main()
+{
+   TestRestore();
+   TestNoChanges();
+   TestMarkDirty();
+   std::printf("All draw_state_stack tests passed\n");
+   return 0;
+}
@@ -0,0 +1,296 @@
+// Standalone tests of "frame_capture.h" (it has no dependencies on ReShade or Windows), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc frame_capture_tests.cpp && frame_capture_tests.exe
+// g++ -std=c++20 -O2 -pthread frame_capture_tests.cpp -o frame_capture_tests && ./frame_capture_tests
+
+#include "../src/includes/frame_capture.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Replays the events back into a flat list of the same events, so they can be compared with what was written
+   struct RecordingHandler
+   {
+      struct Event
+      {
+         FrameCaptureEvent type;
+         std::vector<uint8_t> payload; // Including the variable size data
+      };
+
+      template<typename T>
+      void Add(FrameCaptureEvent type, const T& payload, const void* extra_data = nullptr, size_t extra_data_size = 0)
+      {
+         Event& event = events.emplace_back();
+         event.type = type;
+         event.payload.resize(sizeof(T) + extra_data_size);
+         std::memcpy(event.payload.data(), &payload, sizeof(T));
+         if (extra_data_size != 0) std::memcpy(event.payload.data() + sizeof(T), extra_data, extra_data_size);
+      }
+
+      void on_init_pipeline(const FrameCaptureInitPipeline& event, const uint32_t* shader_hashes) { Add(FrameCaptureEvent::InitPipeline, event, shader_hashes, event.shader_hashes_count * sizeof(uint32_t)); }
+      void on_bind_pipeline(const FrameCaptureBindPipeline& event) { Add(FrameCaptureEvent::BindPipeline, event); }
+      void on_draw(const FrameCaptureDraw& event, bool indexed) { Add(indexed ? FrameCaptureEvent::DrawIndexed : FrameCaptureEvent::Draw, event); }
+      void on_dispatch(const FrameCaptureDispatch& event) { Add(FrameCaptureEvent::Dispatch, event); }
+      void on_unmap_global_cbuffer(const FrameCaptureUnmapGlobalCBuffer& event, const void* data) { Add(FrameCaptureEvent::UnmapGlobalCBuffer, event, data, event.size); }
+      void on_copy_resource(const FrameCaptureCopyResource& event) { Add(FrameCaptureEvent::CopyResource, event); }
+      void on_present(const FrameCapturePresent& event) { Add(FrameCaptureEvent::Present, event); }
+
+      std::vector<Event> events;
+   };
+
+   std::filesystem::path GetTempPath(const char* name)
+   {
+      return std::filesystem::temp_directory_path() / name;
+   }
+
+   std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+   {
+      std::ifstream file(path, std::ios::binary);
+      return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+   }
+
+   void WriteFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+   {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+   }
+
+   // Writes a frame with all the event types (like the hooks would), in both the writer and the expected list
+   void WriteFrame(frame_capture_writer& writer, RecordingHandler& expected, uint64_t frame_index)
+   {
+      const uint32_t shader_hashes[] = { 0x12345678, 0x9ABCDEF0, 0x0BADF00D };
+      const FrameCaptureInitPipeline init_pipeline = { 0x000001F0000000C0ull + frame_index, 0b101, 3 };
+      writer.write(FrameCaptureEvent::InitPipeline, init_pipeline, shader_hashes, sizeof(shader_hashes));
+      expected.Add(FrameCaptureEvent::InitPipeline, init_pipeline, shader_hashes, sizeof(shader_hashes));
+      // Pipelines without shaders (e.g. blend states)
+      const FrameCaptureInitPipeline empty_pipeline = { 0x000001F000000100ull, 0b10000, 0 };
+      writer.write(FrameCaptureEvent::InitPipeline, empty_pipeline);
+      expected.Add(FrameCaptureEvent::InitPipeline, empty_pipeline);
+
+      const FrameCaptureBindPipeline bind_pipeline = { 0x7FF000001000ull, init_pipeline.pipeline, 0x8, 0 };
+      writer.write(FrameCaptureEvent::BindPipeline, bind_pipeline);
+      expected.Add(FrameCaptureEvent::BindPipeline, bind_pipeline);
+
+      // The cbuffer data has an odd size, so the next events aren't aligned in the file
+      std::vector<uint8_t> cbuffer_data(701);
+      for (size_t i = 0; i < cbuffer_data.size(); i++) cbuffer_data[i] = uint8_t(i * 31 + frame_index);
+      const FrameCaptureUnmapGlobalCBuffer unmap = { 0x000001F000000200ull, uint32_t(cbuffer_data.size()), 1 };
+      writer.write(FrameCaptureEvent::UnmapGlobalCBuffer, unmap, cbuffer_data.data(), uint32_t(cbuffer_data.size()));
+      expected.Add(FrameCaptureEvent::UnmapGlobalCBuffer, unmap, cbuffer_data.data(), cbuffer_data.size());
+
+      const FrameCaptureDraw draw = { 0x7FF000001000ull, 3, 1, 0, 0, 0, 0 };
+      writer.write(FrameCaptureEvent::Draw, draw);
+      expected.Add(FrameCaptureEvent::Draw, draw);
+      const FrameCaptureDraw draw_indexed = { 0x7FF000001000ull, 36, 2, 6, -4, 1, 0 };
+      writer.write(FrameCaptureEvent::DrawIndexed, draw_indexed);
+      expected.Add(FrameCaptureEvent::DrawIndexed, draw_indexed);
+      const FrameCaptureDispatch dispatch = { 0x7FF000001000ull, 120, 68, 1, 0 };
+      writer.write(FrameCaptureEvent::Dispatch, dispatch);
+      expected.Add(FrameCaptureEvent::Dispatch, dispatch);
+      const FrameCaptureCopyResource copy = { 0x7FF000001000ull, 0x000001F000000300ull, UINT64_MAX };
+      writer.write(FrameCaptureEvent::CopyResource, copy);
+      expected.Add(FrameCaptureEvent::CopyResource, copy);
+      const FrameCapturePresent present = { frame_index, 0xFFFFFFFF, 0 };
+      writer.write(FrameCaptureEvent::Present, present);
+      expected.Add(FrameCaptureEvent::Present, present);
+   }
+
+   void CheckSameEvents(const RecordingHandler& replayed, const RecordingHandler& expected)
+   {
+      CHECK(replayed.events.size() == expected.events.size());
+      for (size_t i = 0; i < expected.events.size(); i++)
+      {
+         CHECK(replayed.events[i].type == expected.events[i].type);
+         CHECK(replayed.events[i].payload == expected.events[i].payload);
+      }
+   }
+
+   // All the event types (and their variable size data) are read back exactly as they were written, in order
+   void TestRoundTrip()
+   {
+      const auto path = GetTempPath("frame_capture_tests_round_trip.lumacap");
+      frame_capture_writer writer;
+      RecordingHandler expected;
+      CHECK(!writer.is_capturing());
+      // Events outside of a capture are ignored
+      writer.write(FrameCaptureEvent::Present, FrameCapturePresent{ 7, 0, 0 });
+      CHECK(!writer.end(path));
+
+      writer.begin();
+      CHECK(writer.is_capturing());
+      WriteFrame(writer, expected, 1);
+      CHECK(writer.end(path));
+      CHECK(!writer.is_capturing());
+      writer.write(FrameCaptureEvent::Present, FrameCapturePresent{ 8, 0, 0 });
+
+      frame_capture_reader reader;
+      CHECK(reader.open(path));
+      CHECK(reader.get_events_count() == expected.events.size());
+      RecordingHandler replayed;
+      reader.replay(replayed);
+      CheckSameEvents(replayed, expected);
+
+      // The writer can be reused, previous captures don't leak into the next one
+      expected.events.clear();
+      writer.begin();
+      WriteFrame(writer, expected, 2);
+      WriteFrame(writer, expected, 3);
+      CHECK(writer.end(path));
+      CHECK(reader.open(path));
+      replayed.events.clear();
+      reader.replay(replayed);
+      CheckSameEvents(replayed, expected);
+
+      // An empty capture is valid
+      writer.begin();
+      CHECK(writer.end(path));
+      CHECK(reader.open(path) && reader.get_events_count() == 0);
+      replayed.events.clear();
+      reader.replay(replayed);
+      CHECK(replayed.events.empty());
+      std::filesystem::remove(path);
+   }
+
+   // Events written by many threads at once are all captured, and each of them is intact (they are never interleaved)
+   void TestConcurrentWrites()
+   {
+      const auto path = GetTempPath("frame_capture_tests_concurrent.lumacap");
+      frame_capture_writer writer;
+      writer.begin();
+      constexpr uint64_t threads_num = 4;
+      constexpr uint64_t events_per_thread = 5000;
+      std::vector<std::thread> threads;
+      for (uint64_t thread_index = 0; thread_index < threads_num; thread_index++)
+      {
+         threads.emplace_back([&writer, thread_index]()
+            {
+               for (uint64_t i = 0; i < events_per_thread; i++)
+               {
+                  const uint32_t values[] = { uint32_t(thread_index), uint32_t(i) };
+                  writer.write(FrameCaptureEvent::UnmapGlobalCBuffer, FrameCaptureUnmapGlobalCBuffer{ thread_index, uint32_t(sizeof(values)), 0 }, values, uint32_t(sizeof(values)));
+               }
+            });
+      }
+      for (auto& thread : threads)
+      {
+         thread.join();
+      }
+      CHECK(writer.end(path));
+
+      frame_capture_reader reader;
+      CHECK(reader.open(path));
+      CHECK(reader.get_events_count() == threads_num * events_per_thread);
+      RecordingHandler replayed;
+      reader.replay(replayed);
+      uint32_t next_index[threads_num] = {};
+      for (const auto& event : replayed.events)
+      {
+         FrameCaptureUnmapGlobalCBuffer unmap;
+         uint32_t values[2];
+         std::memcpy(&unmap, event.payload.data(), sizeof(unmap));
+         std::memcpy(values, event.payload.data() + sizeof(unmap), sizeof(values));
+         CHECK(unmap.buffer < threads_num && values[0] == unmap.buffer);
+         // Each thread events are in the order it wrote them
+         CHECK(values[1] == next_index[unmap.buffer]);
+         next_index[unmap.buffer]++;
+      }
+      std::filesystem::remove(path);
+   }
+
+   // Files that aren't (complete) captures of this version are rejected as a whole, without replaying any of their events
+   void TestInvalidFiles()
+   {
+      const auto path = GetTempPath("frame_capture_tests_invalid.lumacap");
+      frame_capture_writer writer;
+      RecordingHandler expected;
+      writer.begin();
+      WriteFrame(writer, expected, 1);
+      CHECK(writer.end(path));
+      const std::vector<uint8_t> valid = ReadFile(path);
+      CHECK(valid.size() > sizeof(FrameCaptureFileHeader));
+
+      frame_capture_reader reader;
+      CHECK(!reader.open(GetTempPath("frame_capture_tests_missing.lumacap")));
+      const auto check_rejected = [&](const std::vector<uint8_t>& data)
+         {
+            WriteFile(path, data);
+            CHECK(!reader.open(path));
+            CHECK(reader.get_events_count() == 0);
+            RecordingHandler replayed;
+            reader.replay(replayed);
+            CHECK(replayed.events.empty());
+         };
+
+      auto data = valid;
+      data[0] = 'X';
+      check_rejected(data); // Magic
+      data = valid;
+      data[offsetof(FrameCaptureFileHeader, version)]++;
+      check_rejected(data); // Older or newer version
+      data = valid;
+      data[offsetof(FrameCaptureFileHeader, events_count)]++;
+      check_rejected(data); // Events count
+      data = valid;
+      data[sizeof(FrameCaptureFileHeader) + offsetof(FrameCaptureEventHeader, type)] = uint8_t(FrameCaptureEvent::Count);
+      check_rejected(data); // Unknown event type
+      data = valid;
+      data[sizeof(FrameCaptureFileHeader) + offsetof(FrameCaptureEventHeader, size)]++;
+      check_rejected(data); // Payload size not matching its shader hashes
+      data = valid;
+      data[sizeof(FrameCaptureFileHeader) + sizeof(FrameCaptureEventHeader) + offsetof(FrameCaptureInitPipeline, shader_hashes_count)] = 0xFF;
+      check_rejected(data); // Shader hashes out of bounds
+      check_rejected(std::vector<uint8_t>(valid.begin(), valid.begin() + sizeof(FrameCaptureFileHeader) - 1)); // Truncated header
+      // Truncated anywhere within the events
+      for (size_t size = sizeof(FrameCaptureFileHeader) + 1; size < valid.size(); size += 7)
+      {
+         check_rejected(std::vector<uint8_t>(valid.begin(), valid.begin() + size));
+      }
+      data = valid;
+      data.push_back(0);
+      check_rejected(data); // Trailing data
+
+      // Random corruptions never make the reader go out of bounds (they are either rejected, or still well formed)
+      std::mt19937 random(11);
+      for (size_t i = 0; i < 2000; i++)
+      {
+         data = valid;
+         for (size_t j = 0; j < 1 + i % 4; j++)
+         {
+            data[random() % data.size()] = uint8_t(random());
+         }
+         WriteFile(path, data);
+         if (reader.open(path))
+         {
+            RecordingHandler replayed;
+            reader.replay(replayed);
+            CHECK(replayed.events.size() == reader.get_events_count());
+         }
+      }
+
+      // A failed open also discards the previously opened capture
+      WriteFile(path, valid);
+      CHECK(reader.open(path));
+      CHECK(!reader.open(GetTempPath("frame_capture_tests_missing.lumacap")));
+      CHECK(reader.get_events_count() == 0);
+      std::filesystem::remove(path);
+   }
+}
+
+int main()
+{
+   TestRoundTrip();
+   TestConcurrentWrites();
+   TestInvalidFiles();
+   std::printf("All frame_capture tests passed\n");
+   return 0;
+}
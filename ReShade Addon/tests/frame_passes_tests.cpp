@@ -0,0 +1,167 @@
+// Standalone tests of "frame_passes.h" (it has no dependencies on ReShade or Windows), replaying sequences of passes recorded from the game, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc frame_passes_tests.cpp && frame_passes_tests.exe
+// g++ -std=c++20 -O2 -pthread frame_passes_tests.cpp -o frame_passes_tests && ./frame_passes_tests
+
+#include "../src/includes/frame_passes.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   using Sequence = std::initializer_list<FramePass>;
+
+   // The sequences of passes the game draws (as shown by the Info tab), with the different settings that affect them
+   constexpr Sequence sequence_taa = { FramePass::SSAO, FramePass::SSAODenoise, FramePass::SSR, FramePass::ComposedGBuffers, FramePass::SSRBlend, FramePass::Tonemapping, FramePass::MainPostProcessing };
+   constexpr Sequence sequence_taa_motion_blur = { FramePass::SSAO, FramePass::SSAODenoise, FramePass::SSR, FramePass::ComposedGBuffers, FramePass::SSRBlend, FramePass::MotionBlur, FramePass::Tonemapping, FramePass::MainPostProcessing };
+   constexpr Sequence sequence_dlss = { FramePass::SSAO, FramePass::SSAODenoise, FramePass::SSR, FramePass::ComposedGBuffers, FramePass::SSRBlend, FramePass::Tonemapping, FramePass::DLSS_SR, FramePass::MainPostProcessing };
+   constexpr Sequence sequence_dynamic_resolution = { FramePass::SSAO, FramePass::SSAODenoise, FramePass::SSR, FramePass::ComposedGBuffers, FramePass::SSRBlend, FramePass::Tonemapping, FramePass::MainPostProcessing, FramePass::Upscaling };
+   constexpr Sequence sequence_no_ssao_no_ssr = { FramePass::ComposedGBuffers, FramePass::Tonemapping, FramePass::MainPostProcessing };
+   constexpr Sequence sequence_menu = {}; // Main menu and loading screens don't draw the scene
+
+   uint32_t PassesBits(Sequence sequence)
+   {
+      uint32_t passes = 0;
+      for (const FramePass pass : sequence)
+      {
+         passes |= FramePassBit(pass);
+      }
+      return passes;
+   }
+
+   std::string SequenceString(Sequence sequence)
+   {
+      std::string sequence_string;
+      for (const FramePass pass : sequence)
+      {
+         if (!sequence_string.empty()) sequence_string += " > ";
+         sequence_string += frame_passes_descs[size_t(pass)].name;
+      }
+      return sequence_string;
+   }
+
+   // Like the addon does: passes are marked as they draw, then the frame ends on present. Returns the anomalous passes of the frame.
+   uint32_t ReplayFrame(frame_pass_tracker& tracker, Sequence sequence)
+   {
+      for (const FramePass pass : sequence)
+      {
+         tracker.mark_drawn(pass);
+         CHECK(tracker.has_drawn(pass));
+      }
+      tracker.end_frame();
+      return tracker.get_previous_anomalous_passes();
+   }
+
+   // All the recorded sequences are valid (in any order across frames, e.g. when toggling settings), and what was drawn is reported for the previous frame
+   void TestRecordedSequences()
+   {
+      frame_pass_tracker tracker;
+      const Sequence sequences[] = { sequence_taa, sequence_taa_motion_blur, sequence_dlss, sequence_dynamic_resolution, sequence_no_ssao_no_ssr, sequence_menu };
+      for (uint32_t frame = 0; frame < 60; frame++)
+      {
+         const Sequence sequence = sequences[(frame * 7) % std::size(sequences)];
+         CHECK(ReplayFrame(tracker, sequence) == 0);
+         CHECK(tracker.get_previous_drawn_passes() == PassesBits(sequence));
+         CHECK(tracker.get_previous_sequence() == SequenceString(sequence));
+         for (const FramePass pass : sequence)
+         {
+            CHECK(tracker.has_drawn_previous(pass) && !tracker.has_drawn(pass));
+         }
+      }
+      CHECK(tracker.get_anomalies_count() == 0);
+   }
+
+   // Sequences with passes out of order, or drawn twice, flag exactly the passes that broke the order
+   void TestAnomalousSequences()
+   {
+      frame_pass_tracker tracker;
+      uint64_t anomalies = 0;
+
+      // Tonemapping before the GBuffers composition (e.g. the composition shader detection failed and it was detected later)
+      CHECK(ReplayFrame(tracker, { FramePass::Tonemapping, FramePass::ComposedGBuffers, FramePass::MainPostProcessing }) == (FramePassBit(FramePass::Tonemapping) | FramePassBit(FramePass::ComposedGBuffers)));
+      anomalies += 2;
+      CHECK(tracker.get_anomalies_count() == anomalies);
+
+      // DLSS drawn twice in the same frame (e.g. DLSS hooked on two shaders)
+      CHECK(ReplayFrame(tracker, { FramePass::ComposedGBuffers, FramePass::Tonemapping, FramePass::DLSS_SR, FramePass::DLSS_SR, FramePass::MainPostProcessing }) == FramePassBit(FramePass::DLSS_SR));
+      anomalies += 1;
+      CHECK(tracker.get_previous_sequence() == "Composed GBuffers > Tonemapping > DLSS SR > DLSS SR > Main Post Processing");
+
+      // DLSS without tonemapping having drawn (it needs the tonemapped output), and SSR blend without SSR
+      CHECK(ReplayFrame(tracker, { FramePass::ComposedGBuffers, FramePass::SSRBlend, FramePass::DLSS_SR, FramePass::Tonemapping, FramePass::MainPostProcessing }) == (FramePassBit(FramePass::SSRBlend) | FramePassBit(FramePass::DLSS_SR) | FramePassBit(FramePass::Tonemapping)));
+      anomalies += 3;
+
+      // Upscaling before post processing
+      CHECK(ReplayFrame(tracker, { FramePass::ComposedGBuffers, FramePass::Tonemapping, FramePass::Upscaling, FramePass::MainPostProcessing }) == (FramePassBit(FramePass::Upscaling) | FramePassBit(FramePass::MainPostProcessing)));
+      anomalies += 2;
+      CHECK(tracker.get_anomalies_count() == anomalies);
+
+      // Anomalies don't carry over to the next frame, only their count does
+      CHECK(ReplayFrame(tracker, sequence_dlss) == 0);
+      CHECK(tracker.get_anomalies_count() == anomalies);
+   }
+
+   // Frames with more passes than can be recorded (e.g. the same pass detected on every draw) still track the anomalies, the sequence is truncated
+   void TestLongSequences()
+   {
+      frame_pass_tracker tracker;
+      tracker.mark_drawn(FramePass::ComposedGBuffers);
+      for (uint32_t i = 1; i < frame_pass_tracker::max_sequence_passes + 10; i++)
+      {
+         tracker.mark_drawn(FramePass::ComposedGBuffers);
+      }
+      tracker.end_frame();
+      CHECK(tracker.get_anomalies_count() == frame_pass_tracker::max_sequence_passes + 9);
+      const std::string sequence = tracker.get_previous_sequence();
+      CHECK(sequence.ends_with("Composed GBuffers > ..."));
+      size_t recorded_passes = 0;
+      for (size_t i = sequence.find("Composed GBuffers"); i != std::string::npos; i = sequence.find("Composed GBuffers", i + 1))
+      {
+         recorded_passes++;
+      }
+      CHECK(recorded_passes == frame_pass_tracker::max_sequence_passes);
+
+      // The next frame starts from scratch
+      CHECK(ReplayFrame(tracker, sequence_taa) == 0);
+      CHECK(tracker.get_previous_sequence() == SequenceString(sequence_taa));
+   }
+
+   // Passes can be marked from multiple threads (e.g. deferred contexts): none are lost, and a pass drawn by two threads is flagged once per extra draw
+   void TestConcurrentMarking()
+   {
+      frame_pass_tracker tracker;
+      for (uint32_t frame = 0; frame < 200; frame++)
+      {
+         std::vector<std::thread> threads;
+         for (const FramePass pass : { FramePass::SSAO, FramePass::SSR, FramePass::SSR })
+         {
+            threads.emplace_back([&tracker, pass]() { tracker.mark_drawn(pass); });
+         }
+         for (auto& thread : threads)
+         {
+            thread.join();
+         }
+         tracker.end_frame();
+         CHECK(tracker.get_previous_drawn_passes() == (FramePassBit(FramePass::SSAO) | FramePassBit(FramePass::SSR)));
+         CHECK(tracker.get_previous_anomalous_passes() == FramePassBit(FramePass::SSR));
+         CHECK(tracker.get_anomalies_count() == frame + 1);
+         const std::string sequence = tracker.get_previous_sequence();
+         CHECK(sequence == "SSAO > SSR > SSR" || sequence == "SSR > SSAO > SSR" || sequence == "SSR > SSR > SSAO");
+      }
+   }
+}
+
+int main()
+{
+   TestRecordedSequences();
+   TestAnomalousSequences();
+   TestLongSequences();
+   TestConcurrentMarking();
+   std::printf("All frame_passes tests passed\n");
+   return 0;
+}
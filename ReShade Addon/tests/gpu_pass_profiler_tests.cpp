@@ -0,0 +1,333 @@
+// Standalone tests of "gpu_pass_profiler.h" and "gpu_pass_timings.h", against the headless ReShade mock ("mock/include/reshade.hpp") with a simulated GPU running some frames behind the CPU, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc /Imock gpu_pass_profiler_tests.cpp && gpu_pass_profiler_tests.exe
+// g++ -std=c++20 -O2 -Imock gpu_pass_profiler_tests.cpp -o gpu_pass_profiler_tests && ./gpu_pass_profiler_tests
+
+#include "../src/includes/gpu_pass_profiler.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   constexpr uint64_t frequency = 1000000; // 1 tick per microsecond
+
+   // Query heaps of timestamps, that are only available once the GPU completed the frame they were written in
+   struct MockDevice : reshade::api::device
+   {
+      struct heap
+      {
+         std::vector<uint64_t> timestamps;
+         std::vector<uint32_t> frames; // The frame each timestamp was written in, 0 if never
+      };
+
+      std::map<uint64_t, heap> heaps;
+      uint64_t next_handle = 1;
+      uint32_t created_heaps = 0;
+      uint32_t failed_reads = 0;
+      uint32_t completed_frame = 0; // The last frame the GPU completed
+      bool fail = false;
+
+      bool create_query_heap(reshade::api::query_type type, uint32_t size, reshade::api::query_heap* out_heap) override
+      {
+         CHECK(type == reshade::api::query_type::timestamp);
+         if (fail) return false;
+         created_heaps++;
+         heap& new_heap = heaps[next_handle];
+         new_heap.timestamps.resize(size);
+         new_heap.frames.resize(size);
+         *out_heap = { next_handle++ };
+         return true;
+      }
+
+      void destroy_query_heap(reshade::api::query_heap query_heap) override
+      {
+         CHECK(heaps.erase(query_heap.handle) == 1);
+      }
+
+      bool get_query_heap_results(reshade::api::query_heap query_heap, uint32_t first, uint32_t count, void* results, uint32_t stride) override
+      {
+         CHECK(stride == sizeof(uint64_t));
+         const heap& found_heap = heaps.at(query_heap.handle);
+         CHECK(first + count <= found_heap.timestamps.size());
+         for (uint32_t i = first; i < first + count; i++)
+         {
+            CHECK(found_heap.frames[i] != 0); // Never read queries that weren't written
+            if (found_heap.frames[i] > completed_frame)
+            {
+               failed_reads++;
+               return false;
+            }
+         }
+         std::memcpy(results, &found_heap.timestamps[first], count * sizeof(uint64_t));
+         return true;
+      }
+   };
+
+   // The GPU clock advances with the work that is submitted, and it completes every frame "latency" frames after it was submitted
+   struct MockCommandList : reshade::api::command_list
+   {
+      MockDevice* device = nullptr;
+      uint64_t clock = 1000;
+      uint32_t frame = 1;
+      uint32_t latency = 1;
+
+      reshade::api::device* get_device() override { return device; }
+
+      void end_query(reshade::api::query_heap query_heap, reshade::api::query_type type, uint32_t index) override
+      {
+         CHECK(type == reshade::api::query_type::timestamp);
+         auto& found_heap = device->heaps.at(query_heap.handle);
+         found_heap.timestamps[index] = clock;
+         found_heap.frames[index] = frame;
+      }
+
+      void Draw(uint64_t duration_us) { clock += duration_us; }
+   };
+
+   struct MockCommandQueue : reshade::api::command_queue
+   {
+      MockCommandList* cmd_list = nullptr;
+
+      reshade::api::device* get_device() override { return cmd_list->device; }
+      reshade::api::command_list* get_immediate_command_list() override { return cmd_list; }
+      uint64_t get_timestamp_frequency() const override { return frequency; }
+   };
+
+   struct MockGPU
+   {
+      MockDevice device;
+      MockCommandList cmd_list;
+      MockCommandQueue queue;
+
+      MockGPU()
+      {
+         cmd_list.device = &device;
+         queue.cmd_list = &cmd_list;
+      }
+
+      // Like the addon frames: some work before the first detected pass, then a few passes, and present
+      void Frame(gpu_pass_profiler& profiler, uint64_t scale = 1)
+      {
+         device.completed_frame = cmd_list.frame > cmd_list.latency ? cmd_list.frame - cmd_list.latency : 0; // Done at the beginning of the frame
+         cmd_list.Draw(1000 * scale);
+         profiler.mark(&cmd_list, "SSAO");
+         cmd_list.Draw(2000 * scale);
+         profiler.mark(&cmd_list, "Tonemapping");
+         cmd_list.Draw(500 * scale);
+         profiler.end_frame(&queue, "Frame Start");
+         cmd_list.frame++;
+      }
+   };
+
+   bool Near(float a, float b)
+   {
+      return std::abs(a - b) < 0.001f;
+   }
+
+   const gpu_pass_timings::section_statistics* FindStatistics(const gpu_pass_profiler& profiler, const char* name)
+   {
+      for (const auto& statistics : profiler.get_timings().get_statistics())
+      {
+         if (statistics.name == name) return &statistics;
+      }
+      return nullptr;
+   }
+
+   // With the GPU a few frames behind (within the number of frames in flight), every frame is resolved without dropping any, and each section gets the GPU time until the next mark
+   void TestSections()
+   {
+      for (uint32_t latency = 1; latency < gpu_pass_profiler::frames_latency; latency++)
+      {
+         MockGPU gpu;
+         gpu.cmd_list.latency = latency;
+         gpu_pass_profiler profiler;
+         for (uint32_t frame = 0; frame < 50; frame++)
+         {
+            gpu.Frame(profiler);
+         }
+         CHECK(profiler.get_dropped_frames() == 0);
+         CHECK(gpu.device.created_heaps == 1);
+         CHECK(profiler.get_timings().get_history_size() == 50 - latency);
+         const auto& statistics = profiler.get_timings().get_statistics();
+         CHECK(statistics.size() == 3);
+         CHECK(statistics[0].name == "SSAO" && statistics[1].name == "Tonemapping" && statistics[2].name == "Frame Start");
+         CHECK(Near(statistics[0].last_ms, 2.f) && Near(statistics[0].average_ms, 2.f) && Near(statistics[0].max_ms, 2.f));
+         // The last section of the frame lasts until present, and the "Frame Start" one from present to the first pass
+         CHECK(Near(statistics[1].average_ms, 0.5f));
+         CHECK(Near(statistics[2].average_ms, 1.f));
+      }
+   }
+
+   // A GPU further behind than the number of frames in flight never has a frame ready in time (they get dropped), but it never stalls, and it recovers as soon as the GPU catches up
+   void TestSlowGPU()
+   {
+      MockGPU gpu;
+      gpu.cmd_list.latency = gpu_pass_profiler::frames_latency + 1;
+      gpu_pass_profiler profiler;
+      for (uint32_t frame = 0; frame < 20; frame++)
+      {
+         gpu.Frame(profiler);
+      }
+      CHECK(profiler.get_timings().get_statistics().empty());
+      CHECK(profiler.get_dropped_frames() > 0);
+      CHECK(gpu.device.failed_reads > 0);
+
+      const uint64_t dropped_frames = profiler.get_dropped_frames();
+      gpu.cmd_list.latency = 1;
+      for (uint32_t frame = 0; frame < 20; frame++)
+      {
+         gpu.Frame(profiler);
+      }
+      CHECK(profiler.get_dropped_frames() == dropped_frames);
+      CHECK(FindStatistics(profiler, "SSAO") != nullptr && Near(FindStatistics(profiler, "SSAO")->last_ms, 2.f));
+   }
+
+   // Resetting destroys the query heap, drops the frames in flight, and clears all the statistics, including their samples (they'd otherwise be averaged with the new ones)
+   void TestReset()
+   {
+      MockGPU gpu;
+      gpu.cmd_list.latency = 2;
+      gpu_pass_profiler profiler;
+      for (uint32_t frame = 0; frame < 20; frame++)
+      {
+         gpu.Frame(profiler, 10);
+      }
+      CHECK(Near(FindStatistics(profiler, "SSAO")->max_ms, 20.f));
+
+      profiler.reset(&gpu.device);
+      CHECK(gpu.device.heaps.empty());
+      CHECK(profiler.get_timings().get_statistics().empty() && profiler.get_timings().get_history_size() == 0);
+
+      for (uint32_t frame = 0; frame < 5; frame++)
+      {
+         gpu.Frame(profiler);
+      }
+      CHECK(gpu.device.created_heaps == 2 && gpu.device.heaps.size() == 1);
+      const auto* statistics = FindStatistics(profiler, "SSAO");
+      CHECK(statistics != nullptr);
+      CHECK(Near(statistics->average_ms, 2.f) && Near(statistics->max_ms, 2.f));
+      profiler.reset(&gpu.device);
+      CHECK(gpu.device.heaps.empty());
+   }
+
+   // Marks beyond the limit are ignored, and failing to create the query heap just doesn't profile anything (until it succeeds)
+   void TestLimits()
+   {
+      static const char* const names[] = { "A", "B", "C", "D", "E", "F", "G", "H" };
+      MockGPU gpu;
+      gpu_pass_profiler profiler;
+      for (uint32_t frame = 0; frame < 4; frame++)
+      {
+         gpu.device.completed_frame = gpu.cmd_list.frame - 1;
+         for (size_t i = 0; i < gpu_pass_profiler::max_marks + 8; i++)
+         {
+            profiler.mark(&gpu.cmd_list, names[i % std::size(names)]);
+            gpu.cmd_list.Draw(100);
+         }
+         profiler.end_frame(&gpu.queue, "Frame Start");
+         gpu.cmd_list.frame++;
+      }
+      CHECK(profiler.get_timings().get_statistics().size() == std::size(names) + 1); // Plus "Frame Start", the first mark of the next frames
+      // The last mark that fit lasts until present
+      CHECK(Near(FindStatistics(profiler, "H")->max_ms, 0.9f));
+      CHECK(Near(FindStatistics(profiler, "A")->max_ms, 0.1f));
+
+      MockGPU failing_gpu;
+      failing_gpu.device.fail = true;
+      gpu_pass_profiler failing_profiler;
+      for (uint32_t frame = 0; frame < 10; frame++)
+      {
+         failing_gpu.Frame(failing_profiler);
+      }
+      CHECK(failing_profiler.get_timings().get_statistics().empty() && failing_profiler.get_dropped_frames() == 0);
+      failing_gpu.device.fail = false;
+      for (uint32_t frame = 0; frame < 10; frame++)
+      {
+         failing_gpu.Frame(failing_profiler);
+      }
+      CHECK(failing_profiler.get_timings().get_statistics().size() == 3);
+   }
+
+   // The timings don't depend on the profiler: unusable frames are discarded, and a section drawn twice in a frame counts as two samples
+   void TestTimings()
+   {
+      gpu_pass_timings timings;
+      const char* const names[] = { "A", "B", "A" };
+      const uint64_t timestamps[] = { 1000, 3000, 4000, 8000 };
+      CHECK(!timings.add_frame(0, names, timestamps, 3, 0));
+      const uint64_t decreasing_timestamps[] = { 1000, 3000, 2000, 8000 };
+      CHECK(!timings.add_frame(0, names, decreasing_timestamps, 3, frequency));
+      CHECK(timings.get_statistics().empty() && timings.get_history_size() == 0);
+
+      CHECK(timings.add_frame(0, names, timestamps, 3, frequency));
+      const auto& statistics = timings.get_statistics();
+      CHECK(statistics.size() == 2);
+      CHECK(Near(statistics[0].last_ms, 4.f) && Near(statistics[0].average_ms, 3.f) && Near(statistics[0].max_ms, 4.f));
+      CHECK(Near(statistics[1].last_ms, 1.f));
+
+      // Only the last samples are averaged
+      for (size_t i = 0; i < gpu_pass_timings::stats_samples; i++)
+      {
+         const uint64_t other_timestamps[] = { 10000 + i * 1000, 10000 + i * 1000 + 500 };
+         CHECK(timings.add_frame(i + 1, names, other_timestamps, 1, frequency));
+      }
+      CHECK(Near(statistics[0].average_ms, 0.5f) && Near(statistics[0].max_ms, 0.5f));
+      CHECK(timings.get_history_size() == gpu_pass_timings::exported_frames);
+   }
+
+   // The export has one complete event per section of the last frames, starting from the first timestamp
+   void TestExport()
+   {
+      MockGPU gpu;
+      gpu_pass_profiler profiler;
+      for (uint32_t frame = 0; frame < 3; frame++)
+      {
+         gpu.Frame(profiler);
+      }
+      std::ostringstream stream;
+      CHECK(profiler.get_timings().write_chrome_trace(stream));
+      std::string trace = stream.str();
+      CHECK(trace.starts_with("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") && trace.ends_with("\n]}\n"));
+      CHECK(trace.find("{\"name\":\"SSAO\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":0,\"dur\":2000,\"args\":{\"frame\":0}}") != std::string::npos);
+      size_t events = 0;
+      for (size_t i = trace.find("\"ph\":\"X\""); i != std::string::npos; i = trace.find("\"ph\":\"X\"", i + 1))
+      {
+         events++;
+      }
+      CHECK(events == 2 + 3); // The first frame had no "Frame Start" section, and the last one hasn't been resolved yet
+
+      for (uint32_t frame = 0; frame < gpu_pass_timings::exported_frames * 2; frame++)
+      {
+         gpu.Frame(profiler);
+      }
+      stream.str({});
+      CHECK(profiler.get_timings().write_chrome_trace(stream));
+      trace = stream.str();
+      events = 0;
+      for (size_t i = trace.find("\"ph\":\"X\""); i != std::string::npos; i = trace.find("\"ph\":\"X\"", i + 1))
+      {
+         events++;
+      }
+      CHECK(events == gpu_pass_timings::exported_frames * 3);
+      profiler.reset(&gpu.device);
+   }
+}
+
+int main()
+{
+   TestSections();
+   TestSlowGPU();
+   TestReset();
+   TestLimits();
+   TestTimings();
+   TestExport();
+   std::printf("All gpu_pass_profiler tests passed\n");
+   return 0;
+}
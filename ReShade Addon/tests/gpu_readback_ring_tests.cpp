@@ -0,0 +1,246 @@
+// Standalone tests of "gpu_readback_ring.h", against the headless D3D11 mock ("mock/d3d11.h") with a simulated GPU running some frames behind the CPU, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc /Imock gpu_readback_ring_tests.cpp && gpu_readback_ring_tests.exe
+// g++ -std=c++20 -O2 -Imock gpu_readback_ring_tests.cpp -o gpu_readback_ring_tests && ./gpu_readback_ring_tests
+
+#include "../src/includes/gpu_readback_ring.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   struct MockBuffer : ID3D11Buffer
+   {
+      std::vector<uint8_t> data;
+      bool mapped = false;
+   };
+
+   struct MockDevice : ID3D11Device
+   {
+      uint32_t created_buffers = 0;
+      uint32_t fail_after_buffers = UINT32_MAX;
+
+      HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initial_data, ID3D11Buffer** buffer) override
+      {
+         if (created_buffers >= fail_after_buffers) return E_OUTOFMEMORY;
+         created_buffers++;
+         MockBuffer* mock_buffer = new MockBuffer();
+         mock_buffer->desc = *desc;
+         mock_buffer->data.resize(desc->ByteWidth);
+         if (initial_data != nullptr) std::memcpy(mock_buffer->data.data(), initial_data->pSysMem, desc->ByteWidth);
+         *buffer = mock_buffer;
+         return S_OK;
+      }
+   };
+
+   // The GPU executes the copies "latency" frames after they were queued (commands are serialized, so the copied data is the one the source had when the copy was queued),
+   // mapping a buffer with copies still in flight either fails ("D3D11_MAP_FLAG_DO_NOT_WAIT") or stalls until they are done
+   struct MockDeviceContext : ID3D11DeviceContext
+   {
+      struct queued_copy
+      {
+         MockBuffer* destination;
+         std::vector<uint8_t> data;
+         uint32_t frame_index;
+      };
+
+      std::deque<queued_copy> queued_copies;
+      uint32_t frame_index = 0;
+      uint32_t maps = 0;
+      uint32_t failed_maps = 0;
+      uint32_t stalls = 0;
+
+      // Starts a new CPU frame, the GPU is now done with all the copies queued "latency" or more frames ago
+      void BeginFrame(uint32_t in_frame_index, uint32_t latency)
+      {
+         frame_index = in_frame_index;
+         while (!queued_copies.empty() && queued_copies.front().frame_index + latency <= frame_index)
+         {
+            Execute();
+         }
+      }
+
+      void Execute()
+      {
+         auto& copy = queued_copies.front();
+         copy.destination->data = copy.data;
+         queued_copies.pop_front();
+      }
+
+      void CopyResource(ID3D11Resource* destination, ID3D11Resource* source) override
+      {
+         MockBuffer* destination_buffer = static_cast<MockBuffer*>(destination);
+         CHECK(!destination_buffer->mapped);
+         queued_copies.push_back({ destination_buffer, static_cast<MockBuffer*>(source)->data, frame_index });
+      }
+
+      HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP map_type, UINT map_flags, D3D11_MAPPED_SUBRESOURCE* mapped_resource) override
+      {
+         MockBuffer* buffer = static_cast<MockBuffer*>(resource);
+         CHECK(subresource == 0 && map_type == D3D11_MAP_READ && !buffer->mapped);
+         CHECK((buffer->desc.CPUAccessFlags & D3D11_CPU_ACCESS_READ) != 0);
+         maps++;
+         for (size_t i = queued_copies.size(); i-- > 0;)
+         {
+            if (queued_copies[i].destination != buffer) continue;
+            if ((map_flags & D3D11_MAP_FLAG_DO_NOT_WAIT) != 0)
+            {
+               failed_maps++;
+               return DXGI_ERROR_WAS_STILL_DRAWING;
+            }
+            stalls++;
+            for (; i-- > 0;)
+            {
+               Execute();
+            }
+            Execute();
+            break;
+         }
+         buffer->mapped = true;
+         mapped_resource->pData = buffer->data.data();
+         mapped_resource->RowPitch = UINT(buffer->data.size());
+         mapped_resource->DepthPitch = UINT(buffer->data.size());
+         return S_OK;
+      }
+
+      void Unmap(ID3D11Resource* resource, UINT subresource) override
+      {
+         MockBuffer* buffer = static_cast<MockBuffer*>(resource);
+         CHECK(subresource == 0 && buffer->mapped);
+         buffer->mapped = false;
+      }
+   };
+
+   D3D11_BUFFER_DESC MakeStagingDesc()
+   {
+      D3D11_BUFFER_DESC desc = {};
+      desc.ByteWidth = sizeof(uint32_t);
+      desc.Usage = D3D11_USAGE_STAGING;
+      desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+      return desc;
+   }
+
+   // Like the exposure readback in the addon: every frame the GPU writes the frame index in a buffer, we read back the latest available value and then queue a new copy.
+   // Calls "on_read(frame_index, value, latency)" for each successful read, returns how many frames had a successful read.
+   template<size_t slots_num, typename T, typename F>
+   uint32_t Simulate(uint32_t frames_num, T&& get_gpu_latency, F&& on_read, MockDeviceContext* out_device_context = nullptr)
+   {
+      MockDevice device;
+      MockDeviceContext local_device_context;
+      MockDeviceContext& device_context = out_device_context != nullptr ? *out_device_context : local_device_context;
+      com_ptr<MockBuffer> source(new MockBuffer(), true);
+      source->data.resize(sizeof(uint32_t));
+      gpu_readback_ring<slots_num> ring;
+      CHECK(ring.create(&device, MakeStagingDesc()));
+      uint32_t reads = 0;
+      for (uint32_t frame_index = 1; frame_index <= frames_num; frame_index++)
+      {
+         device_context.BeginFrame(frame_index, get_gpu_latency(frame_index));
+         uint32_t value = 0;
+         uint32_t latency = 0;
+         if (ring.read(&device_context, &value, sizeof(value), frame_index, latency))
+         {
+            reads++;
+            on_read(frame_index, value, latency);
+         }
+         std::memcpy(source->data.data(), &frame_index, sizeof(frame_index)); // What the GPU wrote this frame
+         ring.push(&device_context, source.get(), frame_index);
+      }
+      return reads;
+   }
+
+   // With a steady GPU latency (within the ring size), every frame reads the value from exactly that many frames ago, and never stalls
+   void TestSteadyLatency()
+   {
+      for (uint32_t gpu_latency = 1; gpu_latency <= 4; gpu_latency++)
+      {
+         MockDeviceContext device_context;
+         const uint32_t reads = Simulate<4>(100, [&](uint32_t) { return gpu_latency; }, [&](uint32_t frame_index, uint32_t value, uint32_t latency)
+            {
+               CHECK(latency == gpu_latency);
+               CHECK(value == frame_index - gpu_latency);
+            }, &device_context);
+         CHECK(reads == 100 - gpu_latency);
+         CHECK(device_context.stalls == 0);
+      }
+   }
+
+   // A GPU further behind than the ring size never has a completed copy left to read (they all get overwritten first), but it still never stalls
+   void TestStarvation()
+   {
+      MockDeviceContext device_context;
+      CHECK(Simulate<4>(100, [](uint32_t) { return 5u; }, [](uint32_t, uint32_t, uint32_t) {}, &device_context) == 0);
+      CHECK(device_context.stalls == 0);
+      // A deeper ring fixes it
+      CHECK(Simulate<8>(100, [](uint32_t) { return 5u; }, [](uint32_t frame_index, uint32_t value, uint32_t latency) { CHECK(latency == 5 && value == frame_index - 5); }) == 95);
+   }
+
+   // With a jittery GPU (e.g. hitches), values only ever go forward in time (older completed copies are skipped once a newer one was read), and the latency is always right
+   void TestJitter()
+   {
+      uint32_t last_value = 0;
+      uint32_t state = 12345;
+      const uint32_t reads = Simulate<4>(1000, [&](uint32_t)
+         {
+            state = state * 1664525u + 1013904223u;
+            return 1 + ((state >> 16) % 4);
+         },
+         [&](uint32_t frame_index, uint32_t value, uint32_t latency)
+         {
+            CHECK(value > last_value);
+            CHECK(latency == frame_index - value && latency >= 1 && latency <= 4);
+            last_value = value;
+         });
+      CHECK(reads > 500);
+   }
+
+   // Only pending copies are mapped (at most one failed map per in flight copy per frame), and every successful map is unmapped
+   void TestMapping()
+   {
+      MockDevice device;
+      MockDeviceContext device_context;
+      gpu_readback_ring<4> ring;
+      com_ptr<MockBuffer> source(new MockBuffer(), true);
+      source->data.resize(sizeof(uint32_t));
+      CHECK(ring.create(&device, MakeStagingDesc()));
+      CHECK(ring.is_created() && device.created_buffers == 4);
+
+      uint32_t value = 0;
+      uint32_t latency = 0;
+      CHECK(!ring.read(&device_context, &value, sizeof(value), 1, latency));
+      CHECK(device_context.maps == 0); // Nothing queued yet
+      ring.push(&device_context, source.get(), 1);
+      ring.push(&device_context, source.get(), 2);
+      device_context.BeginFrame(3, 100);
+      CHECK(!ring.read(&device_context, &value, sizeof(value), 3, latency));
+      CHECK(device_context.maps == 2 && device_context.failed_maps == 2);
+
+      // Once read, the older copies aren't mapped anymore
+      device_context.BeginFrame(3, 0);
+      CHECK(ring.read(&device_context, &value, sizeof(value), 3, latency) && latency == 1);
+      CHECK(!ring.read(&device_context, &value, sizeof(value), 3, latency));
+      CHECK(device_context.maps == 3);
+
+      // Failed creations leave nothing behind
+      MockDevice failing_device;
+      failing_device.fail_after_buffers = 2;
+      const int64_t live_objects = IUnknown::live_objects;
+      CHECK(!ring.create(&failing_device, MakeStagingDesc()));
+      CHECK(!ring.is_created());
+      CHECK(IUnknown::live_objects == live_objects - 4);
+   }
+}
+
+int main()
+{
+   TestSteadyLatency();
+   TestStarvation();
+   TestJitter();
+   TestMapping();
+   std::printf("All gpu_readback_ring tests passed\n");
+   return 0;
+}
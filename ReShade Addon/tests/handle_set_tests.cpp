@@ -0,0 +1,172 @@
+// Standalone tests of "handle_set.h" (it has no dependencies on ReShade or Windows), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc handle_set_tests.cpp && handle_set_tests.exe
+// g++ -std=c++20 -O2 -pthread handle_set_tests.cpp -o handle_set_tests && ./handle_set_tests
+
+#include "../src/includes/handle_set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Resources get created and destroyed all the time (e.g. on resolution changes), with always about the same amount alive at once.
+   // Without the tombstones reclamation, after enough churn all the empty slots would have become tombstones, and lookups that miss would go through the whole table.
+   void TestChurnProbeLength()
+   {
+      constexpr size_t capacity = 1024;
+      constexpr size_t live_handles = 64;
+      constexpr size_t churn_iterations = 1000000;
+      // A rebuild leaves no tombstones, and we can't accumulate more than "max_removed_slots" before another one,
+      // so the table is never more than ("live_handles" + "max_removed_slots") / "capacity" full, lookups that miss are expected to be short
+      constexpr size_t max_expected_probe_length = 32;
+
+      handle_set<capacity> set;
+      std::mt19937_64 random(7);
+      // Pointer like handles
+      auto make_handle = [&]() { return (random() & 0x0000'7FFF'FFFF'FFF0ull) | 0x10ull; };
+
+      std::vector<uint64_t> handles;
+      for (size_t i = 0; i < live_handles; i++)
+      {
+         handles.push_back(make_handle());
+         set.insert(handles.back());
+      }
+
+      size_t max_miss_probe_length = 0;
+      for (size_t i = 0; i < churn_iterations; i++)
+      {
+         const size_t index = random() % handles.size();
+         set.erase(handles[index]);
+         CHECK(set.contains(handles[index]) == handle_set<capacity>::lookup_result::no);
+         handles[index] = make_handle();
+         set.insert(handles[index]);
+         CHECK(set.contains(handles[index]) == handle_set<capacity>::lookup_result::yes);
+
+         if (i % 1000 == 0)
+         {
+            for (const uint64_t handle : handles)
+            {
+               CHECK(set.contains(handle) == handle_set<capacity>::lookup_result::yes);
+            }
+            for (size_t j = 0; j < 64; j++)
+            {
+               max_miss_probe_length = std::max(max_miss_probe_length, set.get_probe_length(make_handle()));
+            }
+         }
+      }
+      std::printf("Churn: max probe length of missed lookups: %zu (of %zu slots)\n", max_miss_probe_length, capacity);
+      CHECK(max_miss_probe_length <= max_expected_probe_length);
+   }
+
+   // Inserting a handle that is already in the set (e.g. found by two threads at once) leaves a single entry, even past tombstones, and a full set answers "maybe" for unknown handles
+   void TestDuplicatesAndFull()
+   {
+      constexpr size_t capacity = 16;
+      using set_type = handle_set<capacity>;
+      set_type set;
+      // Find handles that all start probing from the same slot, so they form a single chain
+      std::vector<uint64_t> colliding_handles;
+      for (uint64_t handle = 0x10; colliding_handles.size() < 4; handle += 0x10)
+      {
+         if (set.get_probe_length(handle) == 1 && (colliding_handles.empty() || ((handle * 0x9E3779B97F4A7C15ull) >> 32) % capacity == ((colliding_handles[0] * 0x9E3779B97F4A7C15ull) >> 32) % capacity))
+         {
+            colliding_handles.push_back(handle);
+         }
+      }
+      for (const uint64_t handle : colliding_handles)
+      {
+         set.insert(handle);
+      }
+      set.erase(colliding_handles[0]); // Leaves a tombstone at the start of the chain
+      set.insert(colliding_handles[2]);
+      set.erase(colliding_handles[2]);
+      CHECK(set.contains(colliding_handles[2]) == set_type::lookup_result::no); // It wasn't inserted again in the tombstone
+      CHECK(set.contains(colliding_handles[1]) == set_type::lookup_result::yes);
+      CHECK(set.contains(colliding_handles[3]) == set_type::lookup_result::yes);
+      set.insert(colliding_handles[0]); // Re-uses the tombstone
+      CHECK(set.get_probe_length(colliding_handles[0]) == 1);
+
+      set.clear();
+      for (uint64_t handle = 1; handle <= capacity; handle++)
+      {
+         set.insert(handle * 0x100);
+      }
+      CHECK(set.contains(0x100) == set_type::lookup_result::yes);
+      CHECK(set.contains(0x100 * (capacity + 1)) == set_type::lookup_result::no);
+      set.insert(0x100 * (capacity + 1));
+      CHECK(set.contains(0x100 * (capacity + 2)) == set_type::lookup_result::maybe);
+      CHECK(set.contains(0x100) == set_type::lookup_result::yes);
+   }
+
+   // Lookups run without locks, while other threads add and remove handles (and thus trigger rebuilds), they should never miss a handle that is in the set
+   void TestConcurrentLookups()
+   {
+      constexpr size_t capacity = 1024;
+      handle_set<capacity> set;
+      constexpr uint64_t persistent_handles[] = { 0x1000, 0x2000, 0x3040, 0x7FFF'0000'1230 };
+      for (const uint64_t handle : persistent_handles)
+      {
+         set.insert(handle);
+      }
+
+      std::atomic<bool> stop = false;
+      std::atomic<size_t> lookups = 0;
+      std::vector<std::thread> readers;
+      for (size_t i = 0; i < 3; i++)
+      {
+         readers.emplace_back([&]()
+            {
+               size_t local_lookups = 0;
+               while (!stop.load(std::memory_order_relaxed))
+               {
+                  for (const uint64_t handle : persistent_handles)
+                  {
+                     CHECK(set.contains(handle) == handle_set<capacity>::lookup_result::yes);
+                     local_lookups++;
+                  }
+               }
+               lookups += local_lookups;
+            });
+      }
+
+      std::mt19937_64 random(11);
+      std::vector<uint64_t> handles;
+      for (size_t i = 0; i < 200000; i++)
+      {
+         if (handles.size() < 64 || (random() & 1))
+         {
+            handles.push_back((random() & 0x0000'7FFF'FFFF'FFF0ull) | 0x8ull); // Never one of the persistent handles
+            set.insert(handles.back());
+         }
+         else
+         {
+            const size_t index = random() % handles.size();
+            set.erase(handles[index]);
+            handles[index] = handles.back();
+            handles.pop_back();
+         }
+      }
+      stop = true;
+      for (auto& reader : readers)
+      {
+         reader.join();
+      }
+      std::printf("Concurrent lookups: %zu\n", lookups.load());
+   }
+}
+
+int main()
+{
+   TestChurnProbeLength();
+   TestDuplicatesAndFull();
+   TestConcurrentLookups();
+   std::printf("All handle_set tests passed\n");
+   return 0;
+}
@@ -0,0 +1,117 @@
+// Standalone tests and benchmark of "hash.hpp" (it has no dependencies on ReShade or Windows, but needs an x86 CPU), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc hash_tests.cpp && hash_tests.exe
+// g++ -std=c++20 -O2 hash_tests.cpp -o hash_tests && ./hash_tests
+
+#include "../src/utils/hash.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Bit by bit reference (same results as ReShade's "compute_crc32()")
+   uint32_t ComputeCRC32Reference(const uint8_t* data, size_t size)
+   {
+      uint32_t crc = 0xFFFFFFFF;
+      for (size_t i = 0; i < size; i++)
+      {
+         crc ^= data[i];
+         for (uint32_t j = 0; j < 8; j++)
+         {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+         }
+      }
+      return crc ^ 0xFFFFFFFF;
+   }
+
+   uint32_t ComputeCRC32(const char* string)
+   {
+      return utils::hash::ComputeCRC32(reinterpret_cast<const uint8_t*>(string), std::strlen(string));
+   }
+
+   // Standard CRC-32 check values
+   void TestGoldenVectors()
+   {
+      CHECK(ComputeCRC32("") == 0x00000000);
+      CHECK(ComputeCRC32("a") == 0xE8B7BE43);
+      CHECK(ComputeCRC32("abc") == 0x352441C2);
+      CHECK(ComputeCRC32("123456789") == 0xCBF43926);
+      CHECK(ComputeCRC32("The quick brown fox jumps over the lazy dog") == 0x414FA339);
+
+      // Large enough to go through the PCLMUL folding (if supported)
+      std::vector<uint8_t> zeros(4096, 0);
+      CHECK(utils::hash::ComputeCRC32(zeros.data(), zeros.size()) == ComputeCRC32Reference(zeros.data(), zeros.size()));
+      std::vector<uint8_t> ones(4096, 0xFF);
+      CHECK(utils::hash::ComputeCRC32(ones.data(), ones.size()) == ComputeCRC32Reference(ones.data(), ones.size()));
+   }
+
+   // Every size around the paths thresholds (256 bytes for the folding, multiples of 16 and 64), from unaligned pointers too
+   void TestAllSizesAndAlignments()
+   {
+      std::mt19937 random(7);
+      std::vector<uint8_t> data(2048 + 16);
+      for (auto& byte : data) byte = uint8_t(random());
+
+      const bool pclmul_supported = utils::hash::detail::IsPCLMULSupported();
+      for (size_t offset = 0; offset < 16; offset++)
+      {
+         for (size_t size = 0; size <= 2048; size++)
+         {
+            const uint8_t* start = data.data() + offset;
+            const uint32_t expected = ComputeCRC32Reference(start, size);
+            CHECK(utils::hash::ComputeCRC32(start, size) == expected);
+            CHECK((utils::hash::detail::UpdateCRC32SliceBy16(0xFFFFFFFF, start, size) ^ 0xFFFFFFFF) == expected);
+            if (pclmul_supported && size >= 64 && size % 16 == 0)
+            {
+               CHECK((utils::hash::detail::UpdateCRC32PCLMUL(0xFFFFFFFF, start, size) ^ 0xFFFFFFFF) == expected);
+            }
+         }
+      }
+      std::printf("PCLMUL path %s\n", pclmul_supported ? "tested" : "not supported on this CPU, only the slice-by-16 one was tested");
+   }
+
+   // Shader binaries (a few KBs each, thousands of them on boot), and the whole shader cache at once
+   void BenchmarkThroughput()
+   {
+      std::mt19937 random(11);
+      std::vector<uint8_t> data(60 * 1024 * 1024);
+      for (auto& byte : data) byte = uint8_t(random());
+
+      using clock = std::chrono::steady_clock;
+      const auto gb_per_s = [](size_t bytes, clock::duration duration) { return double(bytes) / std::chrono::duration<double>(duration).count() / 1e9; };
+      for (const size_t chunk_size : { size_t(4 * 1024), data.size() })
+      {
+         uint32_t checksums[3] = {};
+         clock::duration durations[3] = {};
+         for (size_t method = 0; method < 3; method++)
+         {
+            const auto start = clock::now();
+            for (size_t offset = 0; offset + chunk_size <= data.size(); offset += chunk_size)
+            {
+               const uint8_t* chunk = data.data() + offset;
+               if (method == 0) checksums[method] += ComputeCRC32Reference(chunk, chunk_size);
+               else if (method == 1) checksums[method] += utils::hash::detail::UpdateCRC32SliceBy16(0xFFFFFFFF, chunk, chunk_size) ^ 0xFFFFFFFF;
+               else checksums[method] += utils::hash::ComputeCRC32(chunk, chunk_size);
+            }
+            durations[method] = clock::now() - start;
+         }
+         CHECK(checksums[0] == checksums[1] && checksums[1] == checksums[2]);
+         std::printf("CRC32 of %zu MB in %zu bytes chunks: bitwise %.2f GB/s, slice-by-16 %.2f GB/s, dispatched %.2f GB/s\n",
+            data.size() / (1024 * 1024), chunk_size, gb_per_s(data.size(), durations[0]), gb_per_s(data.size(), durations[1]), gb_per_s(data.size(), durations[2]));
+      }
+   }
+}
+
+int main()
+{
+   TestGoldenVectors();
+   TestAllSizesAndAlignments();
+   BenchmarkThroughput();
+   std::printf("All hash tests passed\n");
+   return 0;
+}
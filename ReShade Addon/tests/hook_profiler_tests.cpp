@@ -0,0 +1,232 @@
+// Standalone tests (and benchmark) of "hook_profiler.h" (it has no dependencies on ReShade or Windows, but it needs an x86 CPU), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc hook_profiler_tests.cpp && hook_profiler_tests.exe
+// g++ -std=c++20 -O2 -pthread hook_profiler_tests.cpp -o hook_profiler_tests && ./hook_profiler_tests
+
+#include "../src/includes/hook_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   using test_profiler = hook_profiler<3>;
+
+   // Values far apart in magnitude: small exact ones, the typical hooks durations in ticks, and the extremes
+   std::vector<uint64_t> MakeTestValues()
+   {
+      std::vector<uint64_t> values;
+      for (uint64_t value = 0; value < 5000; value++) values.push_back(value);
+      std::mt19937_64 random(3);
+      for (size_t i = 0; i < 100000; i++) values.push_back(random() >> (random() % 64));
+      for (uint64_t bit = 0; bit < 64; bit++)
+      {
+         values.push_back(uint64_t(1) << bit);
+         values.push_back((uint64_t(1) << bit) - 1);
+         values.push_back((uint64_t(1) << bit) + 1);
+      }
+      values.push_back(UINT64_MAX);
+      return values;
+   }
+
+   // The buckets cover the whole 64 bit range without gaps or overlaps, each value falls in the bucket whose range contains it, and the middle of a bucket is within the advertised error of all its values
+   void TestBuckets()
+   {
+      CHECK(test_profiler::get_bucket_range(0).first == 0);
+      for (size_t i = 0; i + 1 < test_profiler::buckets_num; i++)
+      {
+         const auto range = test_profiler::get_bucket_range(i);
+         CHECK(range.first <= range.second);
+         CHECK(range.second + 1 == test_profiler::get_bucket_range(i + 1).first);
+      }
+      CHECK(test_profiler::get_bucket_range(test_profiler::buckets_num - 1).second == UINT64_MAX);
+
+      for (const uint64_t value : MakeTestValues())
+      {
+         const size_t index = test_profiler::get_bucket_index(value);
+         CHECK(index < test_profiler::buckets_num);
+         const auto range = test_profiler::get_bucket_range(index);
+         CHECK(value >= range.first && value <= range.second);
+         const uint64_t middle = range.first + (range.second - range.first) / 2;
+         const double error = std::abs(double(middle) - double(value)) / double(value > 0 ? value : 1);
+         CHECK(error < 0.25);
+      }
+   }
+
+   // Exact percentile of sorted values ("target" rank as computed by the profiler)
+   uint64_t GetReferencePercentile(const std::vector<uint64_t>& sorted_values, double percentile)
+   {
+      uint64_t target = uint64_t(percentile * double(sorted_values.size()) + 0.5);
+      target = std::clamp<uint64_t>(target, 1, sorted_values.size());
+      return sorted_values[target - 1];
+   }
+
+   // The approximated percentiles fall in the same bucket as the exact ones (so within the buckets error), and never above the max
+   void TestPercentiles()
+   {
+      uint64_t buckets[test_profiler::buckets_num] = {};
+      CHECK(test_profiler::get_percentile(buckets, 0, 0.5, 0) == 0);
+
+      std::mt19937_64 random(5);
+      std::exponential_distribution<double> long_tail(1.0 / 3000.0); // Most hooks are fast, a few take much longer (e.g. compiling shaders)
+      std::uniform_int_distribution<uint64_t> uniform(100, 200);
+      for (size_t distribution = 0; distribution < 4; distribution++)
+      {
+         for (const size_t count : { size_t(1), size_t(2), size_t(99), size_t(1000), size_t(100000) })
+         {
+            std::vector<uint64_t> values(count);
+            for (auto& value : values)
+            {
+               if (distribution == 0) value = uint64_t(long_tail(random));
+               else if (distribution == 1) value = uniform(random);
+               else if (distribution == 2) value = 777;
+               else value = random() >> (random() % 64);
+            }
+            std::fill(std::begin(buckets), std::end(buckets), 0);
+            for (const uint64_t value : values)
+            {
+               buckets[test_profiler::get_bucket_index(value)]++;
+            }
+            std::sort(values.begin(), values.end());
+            const uint64_t max_value = values.back();
+            for (const double percentile : { 0.0, 0.01, 0.5, 0.9, 0.99, 1.0 })
+            {
+               const uint64_t approximated = test_profiler::get_percentile(buckets, count, percentile, max_value);
+               const uint64_t exact = GetReferencePercentile(values, percentile);
+               CHECK(approximated <= max_value);
+               const auto range = test_profiler::get_bucket_range(test_profiler::get_bucket_index(exact));
+               CHECK(approximated >= range.first && approximated <= range.second);
+            }
+            if (distribution == 2) CHECK(test_profiler::get_percentile(buckets, count, 0.99, max_value) == 777); // Clamped to the max
+         }
+      }
+   }
+
+   // Samples of all threads are merged once per frame: nothing is lost or counted twice, and the next frame starts from scratch
+   void TestFrames()
+   {
+      test_profiler profiler;
+      constexpr size_t threads_num = 4;
+      constexpr uint64_t samples_per_thread = 10000;
+      for (uint64_t frame = 0; frame < 3; frame++)
+      {
+         std::vector<std::thread> threads;
+         for (size_t thread_index = 0; thread_index < threads_num; thread_index++)
+         {
+            threads.emplace_back([&, thread_index]()
+               {
+                  for (uint64_t i = 0; i < samples_per_thread; i++)
+                  {
+                     profiler.add_sample(0, 1000 + (i % 100)); // 1000-1099
+                     if (i % 10 == 0) profiler.add_sample(1, thread_index == 0 ? 50000 : 10);
+                  }
+               });
+         }
+         for (auto& thread : threads)
+         {
+            thread.join();
+         }
+         profiler.end_frame(frame);
+         const auto& stats = profiler.get_last_frame_statistics();
+         CHECK(stats[0].count == threads_num * samples_per_thread);
+         CHECK(stats[1].count == threads_num * samples_per_thread / 10);
+         CHECK(stats[2].count == 0 && stats[2].total_us == 0.0 && stats[2].max_us == 0.0);
+         // The conversion to microseconds is calibrated at runtime, but it's the same for all the values of a frame
+         const double total_ticks = double(threads_num * (samples_per_thread / 100) * (1000 * 100 + 99 * 100 / 2));
+         CHECK(std::abs(stats[0].total_us / stats[0].max_us - total_ticks / 1099.0) < 0.001 * total_ticks / 1099.0);
+         CHECK(stats[0].p50_us <= stats[0].p99_us && stats[0].p99_us <= stats[0].max_us);
+         CHECK(std::abs(stats[0].p50_us / stats[0].max_us - 1050.0 / 1099.0) < 0.15);
+         // A single slow thread still shows up in the max and the p99 (a quarter of the samples), but not in the p50
+         CHECK(stats[1].max_us / stats[1].p50_us > 1000.0);
+         CHECK(stats[1].p99_us == stats[1].max_us);
+      }
+
+      // Frames without samples
+      profiler.end_frame(3);
+      CHECK(profiler.get_last_frame_statistics()[0].count == 0);
+      for (uint64_t frame = 4; frame < test_profiler::history_frames + 10; frame++)
+      {
+         profiler.end_frame(frame);
+      }
+
+      const auto path = std::filesystem::temp_directory_path() / "hook_profiler_tests.csv";
+      const char* const counters_names[] = { "A", "B", "C" };
+      CHECK(profiler.export_csv(path, counters_names));
+      std::ifstream file(path);
+      std::string line;
+      size_t lines = 0;
+      while (std::getline(file, line)) lines++;
+      CHECK(lines == 1 + test_profiler::history_frames * 3);
+      file.close();
+      std::filesystem::remove(path);
+   }
+
+   // The cost of a profiled scope (what every hook pays while profiling), single threaded and with all the threads profiling at once, and the cost of merging them once per frame
+   void BenchmarkOverhead()
+   {
+      using clock = std::chrono::steady_clock;
+      constexpr size_t iterations = 2000000;
+      test_profiler profiler;
+
+      auto start = clock::now();
+      uint64_t sum = 0;
+      for (size_t i = 0; i < iterations; i++)
+      {
+         sum += __rdtsc();
+      }
+      const double rdtsc_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / double(iterations);
+
+      start = clock::now();
+      for (size_t i = 0; i < iterations; i++)
+      {
+         const test_profiler::scope scope(profiler, i % 3);
+      }
+      const double scope_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / double(iterations);
+
+      const size_t threads_num = std::max<size_t>(2, std::thread::hardware_concurrency());
+      std::vector<std::thread> threads;
+      start = clock::now();
+      for (size_t thread_index = 0; thread_index < threads_num; thread_index++)
+      {
+         threads.emplace_back([&]()
+            {
+               for (size_t i = 0; i < iterations / threads_num; i++)
+               {
+                  const test_profiler::scope scope(profiler, i % 3);
+               }
+            });
+      }
+      for (auto& thread : threads)
+      {
+         thread.join();
+      }
+      const double threaded_scope_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / double(iterations / threads_num * threads_num) * double(threads_num);
+
+      start = clock::now();
+      profiler.end_frame(0);
+      const double end_frame_us = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+      CHECK(sum != 0);
+      CHECK(profiler.get_last_frame_statistics()[0].count + profiler.get_last_frame_statistics()[1].count + profiler.get_last_frame_statistics()[2].count == iterations + iterations / threads_num * threads_num);
+
+      std::printf("Profiled scope: %.1f ns (%.1f ns per thread with %zu threads), of which reading the TSC twice: %.1f ns. Merging %zu threads at the end of the frame: %.1f us\n",
+         scope_ns, threaded_scope_ns, threads_num, rdtsc_ns * 2.0, threads_num + 1, end_frame_us);
+   }
+}
+
+int main()
+{
+   TestBuckets();
+   TestPercentiles();
+   TestFrames();
+   BenchmarkOverhead();
+   std::printf("All hook_profiler tests passed\n");
+   return 0;
+}
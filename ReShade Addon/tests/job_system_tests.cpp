@@ -0,0 +1,247 @@
+// Standalone tests of "job_system.h" (the thread priorities and affinity are only applied on Windows, the rest is portable), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc job_system_tests.cpp && job_system_tests.exe
+// g++ -std=c++20 -O2 -pthread job_system_tests.cpp -o job_system_tests && ./job_system_tests
+
+#include "../src/includes/job_system.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // A job that blocks its worker until it's opened (or cancelled)
+   class Gate
+   {
+   public:
+      job_system::job_function job()
+      {
+         return [this](const std::atomic<bool>& cancelled)
+            {
+               started = true;
+               while (!opened && !cancelled)
+               {
+                  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+               }
+            };
+      }
+
+      void WaitForStart() const
+      {
+         while (!started)
+         {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+      }
+
+      std::atomic<bool> started = false;
+      std::atomic<bool> opened = false;
+   };
+
+   // Records the order jobs ran in
+   class OrderRecorder
+   {
+   public:
+      job_system::job_function job(std::string name)
+      {
+         return [this, name = std::move(name)](const std::atomic<bool>& /*cancelled*/)
+            {
+               const std::unique_lock lock(mutex);
+               order.push_back(name);
+            };
+      }
+
+      std::vector<std::string> GetOrder()
+      {
+         const std::unique_lock lock(mutex);
+         return order;
+      }
+
+   private:
+      std::mutex mutex;
+      std::vector<std::string> order;
+   };
+
+   // Jobs cancelled before they started still run (as cancelled), so they can clean up their state
+   void TestCancellation()
+   {
+      job_system jobs(1);
+      Gate gate;
+      const auto gate_job = jobs.submit(JobPriority::RenderCritical, gate.job());
+      gate.WaitForStart();
+
+      std::atomic<int> ran_cancelled = 0;
+      std::atomic<int> ran_not_cancelled = 0;
+      const auto count_job = [&](const std::atomic<bool>& cancelled) { (cancelled ? ran_cancelled : ran_not_cancelled)++; };
+      const auto cancelled_job = jobs.submit(JobPriority::RenderCritical, count_job);
+      const auto other_job = jobs.submit(JobPriority::RenderCritical, count_job);
+      cancelled_job.cancel();
+      CHECK(cancelled_job.running() && jobs.get_active_jobs() == 3);
+
+      gate.opened = true;
+      cancelled_job.wait();
+      other_job.wait();
+      CHECK(!gate_job.running() && !cancelled_job.running() && !other_job.running());
+      CHECK(ran_cancelled == 1 && ran_not_cancelled == 1);
+      CHECK(jobs.get_active_jobs() == 0);
+
+      // Invalid handles can be used safely
+      const job_system::job_handle invalid;
+      CHECK(!invalid.valid() && !invalid.running());
+      invalid.cancel();
+      invalid.wait();
+      jobs.shutdown();
+   }
+
+   // Draining a group only cancels (and waits for) the jobs of that group
+   void TestDrainGroup()
+   {
+      job_system jobs(3);
+      const int device_a = 0;
+      const int device_b = 0;
+      Gate gate_a;
+      Gate gate_b;
+      const auto job_a = jobs.submit(JobPriority::RenderCritical, gate_a.job(), &device_a);
+      const auto job_b = jobs.submit(JobPriority::RenderCritical, gate_b.job(), &device_b);
+      gate_a.WaitForStart();
+      gate_b.WaitForStart();
+
+      jobs.drain(&device_a);
+      CHECK(!job_a.running());
+      CHECK(job_b.running());
+
+      // Draining without cancelling waits for the jobs to finish on their own
+      std::thread opener([&gate_b]()
+         {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            gate_b.opened = true;
+         });
+      jobs.drain(&device_b, false);
+      CHECK(!job_b.running());
+      opener.join();
+      jobs.shutdown();
+   }
+
+   // Shutting down cancels the running and pending jobs (they all still run), jobs can't be submitted while stopping, and the workers start again with the next job
+   void TestShutdown()
+   {
+      job_system jobs(1);
+      Gate gate;
+      jobs.submit(JobPriority::IO, gate.job());
+      gate.WaitForStart();
+      std::atomic<bool> pending_ran_cancelled = false;
+      std::atomic<bool> submitted_while_stopping = true;
+      jobs.submit(JobPriority::RenderCritical, [&](const std::atomic<bool>& cancelled)
+         {
+            pending_ran_cancelled = cancelled.load();
+            // The job system is stopping
+            submitted_while_stopping = jobs.submit(JobPriority::RenderCritical, [](const std::atomic<bool>& /*cancelled*/) {}).valid();
+         });
+
+      jobs.shutdown();
+      CHECK(pending_ran_cancelled);
+      CHECK(!submitted_while_stopping);
+      CHECK(jobs.get_active_jobs() == 0);
+
+      std::atomic<bool> ran = false;
+      const auto job = jobs.submit(JobPriority::BackgroundCompile, [&ran](const std::atomic<bool>& cancelled) { ran = !cancelled; });
+      CHECK(job.valid());
+      job.wait();
+      CHECK(ran);
+      jobs.shutdown();
+   }
+
+   // Detaching (while the dll is unloading) returns immediately, even if a job is still running, which then gets cancelled
+   void TestShutdownDetached()
+   {
+      auto* jobs = new job_system(2); // Leaked on purpose, the detached workers still access it after we return
+      Gate gate;
+      std::atomic<bool> exited = false;
+      jobs->submit(JobPriority::RenderCritical, [&](const std::atomic<bool>& cancelled)
+         {
+            gate.job()(cancelled);
+            exited = true;
+         });
+      gate.WaitForStart();
+
+      jobs->shutdown_detached(false);
+      CHECK(!jobs->submit(JobPriority::RenderCritical, [](const std::atomic<bool>& /*cancelled*/) {}).valid());
+      while (!exited)
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      CHECK(!gate.opened);
+      // The job state is released after it returns
+      while (jobs->get_active_jobs() != 0)
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+   }
+
+   // With a single worker, render critical jobs go first, but every "max_skips" of them a lower priority one gets its turn
+   void TestPriorities()
+   {
+      static_assert(job_system::max_skips == 4);
+      job_system jobs(1);
+      Gate gate;
+      jobs.submit(JobPriority::RenderCritical, gate.job());
+      gate.WaitForStart();
+
+      OrderRecorder recorder;
+      for (int i = 0; i < 2; i++)
+      {
+         jobs.submit(JobPriority::IO, recorder.job("IO" + std::to_string(i)));
+      }
+      for (int i = 0; i < 10; i++)
+      {
+         jobs.submit(JobPriority::RenderCritical, recorder.job("RC" + std::to_string(i)));
+      }
+      gate.opened = true;
+      jobs.drain(nullptr, false);
+      const std::vector<std::string> expected = { "RC0", "RC1", "RC2", "RC3", "IO0", "RC4", "RC5", "RC6", "RC7", "IO1", "RC8", "RC9" };
+      CHECK(recorder.GetOrder() == expected);
+      jobs.shutdown();
+   }
+
+   // Lower priority jobs never occupy all the workers: one is always left free for render critical jobs
+   void TestReservedWorker()
+   {
+      job_system jobs(2);
+      Gate compile_gate;
+      jobs.submit(JobPriority::BackgroundCompile, compile_gate.job());
+      compile_gate.WaitForStart();
+      std::atomic<bool> io_ran = false;
+      const auto io_job = jobs.submit(JobPriority::IO, [&io_ran](const std::atomic<bool>& /*cancelled*/) { io_ran = true; });
+
+      // The render critical job runs on the free worker, and the IO job still waits for the compilation
+      std::atomic<bool> render_critical_ran = false;
+      jobs.submit(JobPriority::RenderCritical, [&render_critical_ran](const std::atomic<bool>& /*cancelled*/) { render_critical_ran = true; }).wait();
+      CHECK(render_critical_ran);
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      CHECK(!io_ran && io_job.running());
+
+      compile_gate.opened = true;
+      io_job.wait();
+      CHECK(io_ran);
+      jobs.shutdown();
+   }
+}
+
+int main()
+{
+   TestCancellation();
+   TestDrainGroup();
+   TestShutdown();
+   TestShutdownDetached();
+   TestPriorities();
+   TestReservedWorker();
+   std::printf("All job_system tests passed\n");
+   return 0;
+}
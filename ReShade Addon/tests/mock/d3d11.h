@@ -0,0 +1,385 @@
+#pragma once
+
+// Headless stand-in for the few parts of the Windows and D3D11 headers that the addon GPU helpers ("includes/*.h") use, so their logic can be tested on any platform.
+// Interfaces are reference counted for real (objects delete themselves on their last "Release()"), and all their methods are virtual, failing by default,
+// so tests only override what they need (e.g. a device that counts the views it created) and can check for leaks through "IUnknown::live_objects".
+// Types and values match the real ones, though only the members the addon uses are declared.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+typedef int32_t HRESULT; // "long" on Windows, which is 32 bit there
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef float FLOAT;
+typedef unsigned long ULONG;
+typedef uint64_t UINT64;
+typedef int32_t LONG;
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_NOTIMPL ((HRESULT)0x80004001)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+#define DXGI_ERROR_WAS_STILL_DRAWING ((HRESULT)0x887A000A)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#define D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT 8
+#define D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE 16
+
+enum DXGI_FORMAT : UINT
+{
+   DXGI_FORMAT_UNKNOWN = 0,
+   DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+   DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+   DXGI_FORMAT_R10G10B10A2_UNORM = 24,
+   DXGI_FORMAT_R8G8B8A8_TYPELESS = 27,
+   DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+   DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+   DXGI_FORMAT_R32_FLOAT = 41,
+   DXGI_FORMAT_R32_UINT = 42,
+};
+
+struct DXGI_SAMPLE_DESC
+{
+   UINT Count;
+   UINT Quality;
+};
+
+enum D3D11_USAGE : UINT
+{
+   D3D11_USAGE_DEFAULT = 0,
+   D3D11_USAGE_IMMUTABLE = 1,
+   D3D11_USAGE_DYNAMIC = 2,
+   D3D11_USAGE_STAGING = 3,
+};
+
+enum D3D11_BIND_FLAG : UINT
+{
+   D3D11_BIND_VERTEX_BUFFER = 0x1L,
+   D3D11_BIND_INDEX_BUFFER = 0x2L,
+   D3D11_BIND_CONSTANT_BUFFER = 0x4L,
+   D3D11_BIND_SHADER_RESOURCE = 0x8L,
+   D3D11_BIND_RENDER_TARGET = 0x20L,
+   D3D11_BIND_DEPTH_STENCIL = 0x40L,
+   D3D11_BIND_UNORDERED_ACCESS = 0x80L,
+};
+
+enum D3D11_CPU_ACCESS_FLAG : UINT
+{
+   D3D11_CPU_ACCESS_WRITE = 0x10000L,
+   D3D11_CPU_ACCESS_READ = 0x20000L,
+};
+
+enum D3D11_SRV_DIMENSION : UINT
+{
+   D3D11_SRV_DIMENSION_UNKNOWN = 0,
+   D3D11_SRV_DIMENSION_BUFFER = 1,
+   D3D11_SRV_DIMENSION_TEXTURE2D = 4,
+};
+
+enum D3D11_RTV_DIMENSION : UINT
+{
+   D3D11_RTV_DIMENSION_UNKNOWN = 0,
+   D3D11_RTV_DIMENSION_BUFFER = 1,
+   D3D11_RTV_DIMENSION_TEXTURE2D = 4,
+};
+
+struct D3D11_TEX2D_SRV
+{
+   UINT MostDetailedMip;
+   UINT MipLevels;
+};
+
+struct D3D11_SHADER_RESOURCE_VIEW_DESC
+{
+   DXGI_FORMAT Format;
+   D3D11_SRV_DIMENSION ViewDimension;
+   union
+   {
+      D3D11_TEX2D_SRV Texture2D;
+   };
+};
+
+struct D3D11_TEX2D_RTV
+{
+   UINT MipSlice;
+};
+
+struct D3D11_RENDER_TARGET_VIEW_DESC
+{
+   DXGI_FORMAT Format;
+   D3D11_RTV_DIMENSION ViewDimension;
+   union
+   {
+      D3D11_TEX2D_RTV Texture2D;
+   };
+};
+
+struct D3D11_TEXTURE2D_DESC
+{
+   UINT Width;
+   UINT Height;
+   UINT MipLevels;
+   UINT ArraySize;
+   DXGI_FORMAT Format;
+   DXGI_SAMPLE_DESC SampleDesc;
+   D3D11_USAGE Usage;
+   UINT BindFlags;
+   UINT CPUAccessFlags;
+   UINT MiscFlags;
+};
+
+struct D3D11_BUFFER_DESC
+{
+   UINT ByteWidth;
+   D3D11_USAGE Usage;
+   UINT BindFlags;
+   UINT CPUAccessFlags;
+   UINT MiscFlags;
+   UINT StructureByteStride;
+};
+
+struct D3D11_SUBRESOURCE_DATA
+{
+   const void* pSysMem;
+   UINT SysMemPitch;
+   UINT SysMemSlicePitch;
+};
+
+struct D3D11_MAPPED_SUBRESOURCE
+{
+   void* pData;
+   UINT RowPitch;
+   UINT DepthPitch;
+};
+
+enum D3D11_MAP : UINT
+{
+   D3D11_MAP_READ = 1,
+   D3D11_MAP_WRITE = 2,
+   D3D11_MAP_READ_WRITE = 3,
+   D3D11_MAP_WRITE_DISCARD = 4,
+   D3D11_MAP_WRITE_NO_OVERWRITE = 5,
+};
+
+enum D3D11_MAP_FLAG : UINT
+{
+   D3D11_MAP_FLAG_DO_NOT_WAIT = 0x100000L,
+};
+
+enum D3D11_PRIMITIVE_TOPOLOGY : UINT
+{
+   D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+   D3D11_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+   D3D11_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+   D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP = 3,
+   D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+   D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5,
+};
+
+struct D3D11_RECT
+{
+   LONG left;
+   LONG top;
+   LONG right;
+   LONG bottom;
+};
+
+struct D3D11_VIEWPORT
+{
+   FLOAT TopLeftX;
+   FLOAT TopLeftY;
+   FLOAT Width;
+   FLOAT Height;
+   FLOAT MinDepth;
+   FLOAT MaxDepth;
+};
+
+enum D3D11_FILTER : UINT
+{
+   D3D11_FILTER_MIN_MAG_MIP_POINT = 0,
+   D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT = 0x14,
+   D3D11_FILTER_MIN_MAG_MIP_LINEAR = 0x15,
+   D3D11_FILTER_ANISOTROPIC = 0x55,
+   D3D11_FILTER_COMPARISON_MIN_MAG_MIP_POINT = 0x80,
+   D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT = 0x94,
+   D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR = 0x95,
+   D3D11_FILTER_COMPARISON_ANISOTROPIC = 0xD5,
+};
+
+enum D3D11_TEXTURE_ADDRESS_MODE : UINT
+{
+   D3D11_TEXTURE_ADDRESS_WRAP = 1,
+   D3D11_TEXTURE_ADDRESS_MIRROR = 2,
+   D3D11_TEXTURE_ADDRESS_CLAMP = 3,
+   D3D11_TEXTURE_ADDRESS_BORDER = 4,
+};
+
+enum D3D11_COMPARISON_FUNC : UINT
+{
+   D3D11_COMPARISON_NEVER = 1,
+   D3D11_COMPARISON_LESS = 2,
+   D3D11_COMPARISON_LESS_EQUAL = 4,
+   D3D11_COMPARISON_ALWAYS = 8,
+};
+
+#define D3D11_REQ_MAXANISOTROPY 16
+#define D3D11_MIP_LOD_BIAS_MIN (-16.0f)
+#define D3D11_MIP_LOD_BIAS_MAX (15.99f)
+
+struct D3D11_SAMPLER_DESC
+{
+   D3D11_FILTER Filter;
+   D3D11_TEXTURE_ADDRESS_MODE AddressU;
+   D3D11_TEXTURE_ADDRESS_MODE AddressV;
+   D3D11_TEXTURE_ADDRESS_MODE AddressW;
+   FLOAT MipLODBias;
+   UINT MaxAnisotropy;
+   D3D11_COMPARISON_FUNC ComparisonFunc;
+   FLOAT BorderColor[4];
+   FLOAT MinLOD;
+   FLOAT MaxLOD;
+};
+
+// Base of all the mock interfaces
+struct IUnknown
+{
+   // All the objects that haven't been destroyed yet, to check for leaks
+   static inline std::atomic<int64_t> live_objects = 0;
+
+   IUnknown() { live_objects++; }
+   IUnknown(const IUnknown&) = delete;
+   IUnknown& operator=(const IUnknown&) = delete;
+   virtual ~IUnknown() { live_objects--; }
+
+   virtual ULONG AddRef() { return ++ref_count; }
+   virtual ULONG Release()
+   {
+      const ULONG new_ref_count = --ref_count;
+      if (new_ref_count == 0) delete this;
+      return new_ref_count;
+   }
+
+   std::atomic<ULONG> ref_count = 1;
+};
+
+struct ID3D11Device;
+
+struct ID3D11DeviceChild : IUnknown
+{
+   virtual void GetDevice(ID3D11Device** out_device);
+
+   // Not a reference (unlike the real ones), the device needs to outlive its children
+   ID3D11Device* device = nullptr;
+};
+
+struct ID3D11Resource : ID3D11DeviceChild {};
+
+struct ID3D11Buffer : ID3D11Resource
+{
+   D3D11_BUFFER_DESC desc = {};
+   virtual void GetDesc(D3D11_BUFFER_DESC* out_desc) { *out_desc = desc; }
+};
+
+struct ID3D11Texture2D : ID3D11Resource
+{
+   D3D11_TEXTURE2D_DESC desc = {};
+   virtual void GetDesc(D3D11_TEXTURE2D_DESC* out_desc) { *out_desc = desc; }
+};
+
+// Views keep a reference to their resource, like the real ones
+struct ID3D11View : ID3D11DeviceChild
+{
+   explicit ID3D11View(ID3D11Resource* in_resource) : resource(in_resource) { if (resource != nullptr) resource->AddRef(); }
+   ~ID3D11View() override { if (resource != nullptr) resource->Release(); }
+   virtual void GetResource(ID3D11Resource** out_resource) { resource->AddRef(); *out_resource = resource; }
+
+   ID3D11Resource* resource;
+};
+
+struct ID3D11ShaderResourceView : ID3D11View
+{
+   ID3D11ShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC& in_desc) : ID3D11View(resource), desc(in_desc) {}
+   D3D11_SHADER_RESOURCE_VIEW_DESC desc;
+};
+
+struct ID3D11RenderTargetView : ID3D11View
+{
+   ID3D11RenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC& in_desc) : ID3D11View(resource), desc(in_desc) {}
+   D3D11_RENDER_TARGET_VIEW_DESC desc;
+};
+
+struct ID3D11DepthStencilView : ID3D11View
+{
+   explicit ID3D11DepthStencilView(ID3D11Resource* resource) : ID3D11View(resource) {}
+};
+
+struct ID3D11BlendState : ID3D11DeviceChild {};
+
+struct ID3D11SamplerState : ID3D11DeviceChild
+{
+   D3D11_SAMPLER_DESC desc = {};
+   virtual void GetDesc(D3D11_SAMPLER_DESC* out_desc) { *out_desc = desc; }
+};
+struct ID3D11VertexShader : ID3D11DeviceChild {};
+struct ID3D11PixelShader : ID3D11DeviceChild {};
+struct ID3D11ClassInstance : ID3D11DeviceChild {};
+
+struct ID3D11Device : IUnknown
+{
+   virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC*, const D3D11_SUBRESOURCE_DATA*, ID3D11Buffer**) { return E_NOTIMPL; }
+   virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC*, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture2D**) { return E_NOTIMPL; }
+   virtual HRESULT CreateShaderResourceView(ID3D11Resource*, const D3D11_SHADER_RESOURCE_VIEW_DESC*, ID3D11ShaderResourceView**) { return E_NOTIMPL; }
+   virtual HRESULT CreateRenderTargetView(ID3D11Resource*, const D3D11_RENDER_TARGET_VIEW_DESC*, ID3D11RenderTargetView**) { return E_NOTIMPL; }
+   virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC*, ID3D11SamplerState**) { return E_NOTIMPL; }
+};
+
+inline void ID3D11DeviceChild::GetDevice(ID3D11Device** out_device)
+{
+   if (device != nullptr) device->AddRef();
+   *out_device = device;
+}
+
+// The state getters return nothing bound by default
+struct ID3D11DeviceContext : ID3D11DeviceChild
+{
+   virtual void CopyResource(ID3D11Resource*, ID3D11Resource*) {}
+   virtual HRESULT Map(ID3D11Resource*, UINT, D3D11_MAP, UINT, D3D11_MAPPED_SUBRESOURCE*) { return E_NOTIMPL; }
+   virtual void Unmap(ID3D11Resource*, UINT) {}
+   virtual void Draw(UINT, UINT) {}
+
+   virtual void OMGetBlendState(ID3D11BlendState** blend_state, FLOAT blend_factor[4], UINT* sample_mask)
+   {
+      *blend_state = nullptr;
+      for (int i = 0; i < 4; i++) blend_factor[i] = 1.f;
+      *sample_mask = 0xFFFFFFFF;
+   }
+   virtual void OMSetBlendState(ID3D11BlendState*, const FLOAT[4], UINT) {}
+   virtual void IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* topology) { *topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED; }
+   virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY) {}
+   virtual void RSGetScissorRects(UINT* rects_num, D3D11_RECT*) { *rects_num = 0; }
+   virtual void RSSetScissorRects(UINT, const D3D11_RECT*) {}
+   virtual void RSGetViewports(UINT* viewports_num, D3D11_VIEWPORT*) { *viewports_num = 0; }
+   virtual void RSSetViewports(UINT, const D3D11_VIEWPORT*) {}
+   virtual void PSGetShaderResources(UINT, UINT views_num, ID3D11ShaderResourceView** views) { for (UINT i = 0; i < views_num; i++) views[i] = nullptr; }
+   virtual void PSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) {}
+   virtual void PSGetConstantBuffers(UINT, UINT buffers_num, ID3D11Buffer** buffers) { for (UINT i = 0; i < buffers_num; i++) buffers[i] = nullptr; }
+   virtual void PSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) {}
+   virtual void VSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) {}
+   virtual void GSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) {}
+   virtual void CSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) {}
+   virtual void OMGetRenderTargets(UINT views_num, ID3D11RenderTargetView** views, ID3D11DepthStencilView** depth_stencil_view)
+   {
+      for (UINT i = 0; i < views_num; i++) views[i] = nullptr;
+      if (depth_stencil_view != nullptr) *depth_stencil_view = nullptr;
+   }
+   virtual void OMSetRenderTargets(UINT, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*) {}
+   virtual void VSGetShader(ID3D11VertexShader** shader, ID3D11ClassInstance**, UINT* instances_num) { *shader = nullptr; if (instances_num != nullptr) *instances_num = 0; }
+   virtual void VSSetShader(ID3D11VertexShader*, ID3D11ClassInstance* const*, UINT) {}
+   virtual void PSGetShader(ID3D11PixelShader** shader, ID3D11ClassInstance**, UINT* instances_num) { *shader = nullptr; if (instances_num != nullptr) *instances_num = 0; }
+   virtual void PSSetShader(ID3D11PixelShader*, ID3D11ClassInstance* const*, UINT) {}
+};
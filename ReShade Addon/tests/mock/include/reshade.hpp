@@ -0,0 +1,167 @@
+#pragma once
+
+// Headless stand-in for the parts of the ReShade API ("include/reshade.hpp", from the ReShade submodule) that the addon helpers use, for the tests that run against "mock/d3d11.h".
+// Types and values match the real ones, though only the members the addon uses are declared.
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace reshade::api
+{
+   // Same values as "DXGI_FORMAT"
+   enum class format : uint32_t
+   {
+      unknown = 0,
+      r32g32b32a32_float = 2,
+      r16g16b16a16_float = 10,
+      r10g10b10a2_unorm = 24,
+      r8g8b8a8_typeless = 27,
+      r8g8b8a8_unorm = 28,
+      r8g8b8a8_unorm_srgb = 29,
+      r32_float = 41,
+      r32_uint = 42,
+   };
+
+   enum class query_type
+   {
+      occlusion = 0,
+      binary_occlusion = 1,
+      timestamp = 2,
+      pipeline_statistics = 3,
+   };
+
+   enum class shader_stage : uint32_t
+   {
+      vertex = 0x1,
+      hull = 0x2,
+      domain = 0x4,
+      geometry = 0x8,
+      pixel = 0x10,
+      compute = 0x20,
+
+      all_graphics = vertex | hull | domain | geometry | pixel,
+   };
+   constexpr shader_stage operator|(shader_stage lhs, shader_stage rhs) { return shader_stage(uint32_t(lhs) | uint32_t(rhs)); }
+   constexpr shader_stage operator&(shader_stage lhs, shader_stage rhs) { return shader_stage(uint32_t(lhs) & uint32_t(rhs)); }
+   constexpr bool operator==(shader_stage lhs, uint32_t rhs) { return uint32_t(lhs) == rhs; }
+   constexpr bool operator!=(shader_stage lhs, uint32_t rhs) { return uint32_t(lhs) != rhs; }
+
+   struct query_heap { uint64_t handle; };
+   struct resource
+   {
+      uint64_t handle;
+
+      friend constexpr bool operator==(resource lhs, resource rhs) { return lhs.handle == rhs.handle; }
+   };
+
+   // The real interfaces are pure virtual, these default to doing nothing (or failing), tests override what they need
+   class api_object
+   {
+   public:
+      virtual ~api_object() = default;
+
+      virtual uint64_t get_native() const { return 0; }
+
+      // The real ones are keyed by "__uuidof(T)", these by an address unique to each type
+      virtual void get_private_data(const uint8_t* key, uint64_t* data) const
+      {
+         const auto data_pair = private_data.find(key);
+         *data = data_pair != private_data.end() ? data_pair->second : 0;
+      }
+      virtual void set_private_data(const uint8_t* key, uint64_t data) { private_data[key] = data; }
+
+      template<typename T>
+      T& get_private_data() const
+      {
+         uint64_t data = 0;
+         get_private_data(private_data_key<T>(), &data);
+         return *reinterpret_cast<T*>(static_cast<uintptr_t>(data));
+      }
+      template<typename T>
+      T& create_private_data()
+      {
+         T* const data = new T();
+         set_private_data(private_data_key<T>(), reinterpret_cast<uintptr_t>(data));
+         return *data;
+      }
+      template<typename T>
+      void destroy_private_data()
+      {
+         delete &get_private_data<T>();
+         set_private_data(private_data_key<T>(), 0);
+      }
+
+   private:
+      template<typename T>
+      static const uint8_t* private_data_key()
+      {
+         static const uint8_t key = 0;
+         return &key;
+      }
+
+      std::unordered_map<const uint8_t*, uint64_t> private_data;
+   };
+
+   class device : public api_object
+   {
+   public:
+      virtual bool create_query_heap(query_type type, uint32_t size, query_heap* out_heap) { (void)type; (void)size; *out_heap = {}; return false; }
+      virtual void destroy_query_heap(query_heap heap) { (void)heap; }
+      virtual bool get_query_heap_results(query_heap heap, uint32_t first, uint32_t count, void* results, uint32_t stride) { (void)heap; (void)first; (void)count; (void)results; (void)stride; return false; }
+   };
+
+   class device_object : public api_object
+   {
+   public:
+      virtual device* get_device() { return nullptr; }
+   };
+
+   class command_list : public device_object
+   {
+   public:
+      virtual void end_query(query_heap heap, query_type type, uint32_t index) { (void)heap; (void)type; (void)index; }
+   };
+
+   class command_queue : public device_object
+   {
+   public:
+      virtual command_list* get_immediate_command_list() { return nullptr; }
+      virtual uint64_t get_timestamp_frequency() const { return 0; }
+   };
+
+   class swapchain : public device_object
+   {
+   public:
+      virtual resource get_back_buffer(uint32_t index) { (void)index; return {}; }
+      virtual uint32_t get_back_buffer_count() const { return 0; }
+      virtual uint32_t get_current_back_buffer_index() const { return 0; }
+      resource get_current_back_buffer() { return get_back_buffer(get_current_back_buffer_index()); }
+   };
+
+   class effect_runtime : public swapchain
+   {
+   public:
+      virtual command_queue* get_command_queue() { return nullptr; }
+   };
+
+   // Returns the number of bytes a row of "width" pixels takes, or 0 for unknown formats
+   inline uint32_t format_row_pitch(format format, uint32_t width)
+   {
+      switch (format)
+      {
+      case format::r32g32b32a32_float:
+         return width * 16;
+      case format::r16g16b16a16_float:
+         return width * 8;
+      case format::r10g10b10a2_unorm:
+      case format::r8g8b8a8_typeless:
+      case format::r8g8b8a8_unorm:
+      case format::r8g8b8a8_unorm_srgb:
+      case format::r32_float:
+      case format::r32_uint:
+         return width * 4;
+      default:
+         return 0;
+      }
+   }
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+// Headless in-memory implementations of the mock D3D11 ("d3d11.h") and ReShade ("include/reshade.hpp") interfaces, that behave like the real ones for what the addon does with them,
+// so the addon code that goes through a device, its immediate device context, or the ReShade objects wrapping them (e.g. the effect runtime on present) can run against them.
+// The device creates buffers (with CPU memory that can be mapped), textures and samplers, the device context keeps all the states bound to it (with a reference, like the real one),
+// and both count the calls the tests check. The ReShade objects only wrap them.
+// Not thread safe (like the device context).
+
+#include <d3d11.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include <include/reshade.hpp>
+#include <source/com_ptr.hpp>
+
+struct mock_buffer : ID3D11Buffer
+{
+   std::vector<uint8_t> data;
+};
+
+struct mock_device : ID3D11Device
+{
+   HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initial_data, ID3D11Buffer** out_buffer) override
+   {
+      mock_buffer* buffer = new mock_buffer();
+      buffer->device = this;
+      buffer->desc = *desc;
+      buffer->data.resize(desc->ByteWidth);
+      if (initial_data != nullptr) std::memcpy(buffer->data.data(), initial_data->pSysMem, desc->ByteWidth);
+      created_buffers++;
+      *out_buffer = buffer;
+      return S_OK;
+   }
+   HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture2D** out_texture) override
+   {
+      ID3D11Texture2D* texture = new ID3D11Texture2D();
+      texture->device = this;
+      texture->desc = *desc;
+      created_textures++;
+      *out_texture = texture;
+      return S_OK;
+   }
+   HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** out_sampler) override
+   {
+      ID3D11SamplerState* sampler = new ID3D11SamplerState();
+      sampler->device = this;
+      sampler->desc = *desc;
+      created_samplers++;
+      *out_sampler = sampler;
+      return S_OK;
+   }
+
+   uint32_t created_buffers = 0;
+   uint32_t created_textures = 0;
+   uint32_t created_samplers = 0;
+};
+
+// Keeps the bound states, and counts how many times they are retrieved and set.
+// Only the pixel shader constant buffers can be retrieved, the other stages ones are only kept to be checked.
+struct mock_device_context : ID3D11DeviceContext
+{
+   static constexpr UINT constant_buffers_num = 14;
+
+   struct states
+   {
+      com_ptr<ID3D11BlendState> blend_state;
+      FLOAT blend_factor[4] = { 1.f, 1.f, 1.f, 1.f };
+      UINT blend_sample_mask = 0xFFFFFFFF;
+      D3D11_PRIMITIVE_TOPOLOGY primitive_topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+      UINT scissor_rects_num = 0;
+      D3D11_RECT scissor_rects[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE] = {};
+      UINT viewports_num = 0;
+      D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE] = {};
+      com_ptr<ID3D11ShaderResourceView> shader_resources[16];
+      com_ptr<ID3D11Buffer> constant_buffers[constant_buffers_num];
+      com_ptr<ID3D11Buffer> vs_constant_buffers[constant_buffers_num];
+      com_ptr<ID3D11Buffer> gs_constant_buffers[constant_buffers_num];
+      com_ptr<ID3D11Buffer> cs_constant_buffers[constant_buffers_num];
+      com_ptr<ID3D11RenderTargetView> render_targets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+      com_ptr<ID3D11DepthStencilView> depth_stencil_view;
+      com_ptr<ID3D11VertexShader> vs;
+      com_ptr<ID3D11PixelShader> ps;
+
+      bool operator==(const states& other) const
+      {
+         bool equal = blend_state == other.blend_state && std::memcmp(blend_factor, other.blend_factor, sizeof(blend_factor)) == 0 && blend_sample_mask == other.blend_sample_mask
+            && primitive_topology == other.primitive_topology
+            && scissor_rects_num == other.scissor_rects_num && std::memcmp(scissor_rects, other.scissor_rects, sizeof(D3D11_RECT) * scissor_rects_num) == 0
+            && viewports_num == other.viewports_num && std::memcmp(viewports, other.viewports, sizeof(D3D11_VIEWPORT) * viewports_num) == 0
+            && depth_stencil_view == other.depth_stencil_view && vs == other.vs && ps == other.ps;
+         for (size_t i = 0; i < std::size(shader_resources); i++) equal &= shader_resources[i] == other.shader_resources[i];
+         for (size_t i = 0; i < constant_buffers_num; i++)
+         {
+            equal &= constant_buffers[i] == other.constant_buffers[i] && vs_constant_buffers[i] == other.vs_constant_buffers[i]
+               && gs_constant_buffers[i] == other.gs_constant_buffers[i] && cs_constant_buffers[i] == other.cs_constant_buffers[i];
+         }
+         for (size_t i = 0; i < std::size(render_targets); i++) equal &= render_targets[i] == other.render_targets[i];
+         return equal;
+      }
+   };
+
+   states current;
+   uint32_t gets = 0;
+   uint32_t sets = 0;
+   uint32_t constant_buffers_gets = 0;
+   uint32_t draws = 0;
+   uint32_t maps = 0;
+
+   // Only buffers created by "mock_device" can be mapped (for writing)
+   HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP map_type, UINT, D3D11_MAPPED_SUBRESOURCE* mapped_resource) override
+   {
+      mock_buffer* buffer = dynamic_cast<mock_buffer*>(resource);
+      if (buffer == nullptr || subresource != 0 || map_type == D3D11_MAP_READ || map_type == D3D11_MAP_READ_WRITE) return E_INVALIDARG;
+      maps++;
+      mapped_resource->pData = buffer->data.data();
+      mapped_resource->RowPitch = UINT(buffer->data.size());
+      mapped_resource->DepthPitch = UINT(buffer->data.size());
+      return S_OK;
+   }
+   void Draw(UINT, UINT) override { draws++; }
+
+   void OMGetBlendState(ID3D11BlendState** blend_state, FLOAT blend_factor[4], UINT* sample_mask) override
+   {
+      gets++;
+      *blend_state = com_ptr<ID3D11BlendState>(current.blend_state).release();
+      std::memcpy(blend_factor, current.blend_factor, sizeof(current.blend_factor));
+      *sample_mask = current.blend_sample_mask;
+   }
+   void OMSetBlendState(ID3D11BlendState* blend_state, const FLOAT blend_factor[4], UINT sample_mask) override
+   {
+      sets++;
+      current.blend_state = blend_state;
+      std::memcpy(current.blend_factor, blend_factor, sizeof(current.blend_factor));
+      current.blend_sample_mask = sample_mask;
+   }
+   void IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* topology) override { gets++; *topology = current.primitive_topology; }
+   void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override { sets++; current.primitive_topology = topology; }
+   void RSGetScissorRects(UINT* rects_num, D3D11_RECT* rects) override
+   {
+      gets++;
+      if (rects != nullptr) std::memcpy(rects, current.scissor_rects, sizeof(D3D11_RECT) * (std::min)(*rects_num, current.scissor_rects_num));
+      *rects_num = current.scissor_rects_num;
+   }
+   void RSSetScissorRects(UINT rects_num, const D3D11_RECT* rects) override
+   {
+      sets++;
+      current.scissor_rects_num = rects_num;
+      if (rects_num > 0) std::memcpy(current.scissor_rects, rects, sizeof(D3D11_RECT) * rects_num);
+   }
+   void RSGetViewports(UINT* viewports_num, D3D11_VIEWPORT* viewports) override
+   {
+      gets++;
+      if (viewports != nullptr) std::memcpy(viewports, current.viewports, sizeof(D3D11_VIEWPORT) * (std::min)(*viewports_num, current.viewports_num));
+      *viewports_num = current.viewports_num;
+   }
+   void RSSetViewports(UINT viewports_num, const D3D11_VIEWPORT* viewports) override
+   {
+      sets++;
+      current.viewports_num = viewports_num;
+      if (viewports_num > 0) std::memcpy(current.viewports, viewports, sizeof(D3D11_VIEWPORT) * viewports_num);
+   }
+   void PSGetShaderResources(UINT start_slot, UINT views_num, ID3D11ShaderResourceView** views) override
+   {
+      gets++;
+      for (UINT i = 0; i < views_num; i++) views[i] = com_ptr<ID3D11ShaderResourceView>(current.shader_resources[start_slot + i]).release();
+   }
+   void PSSetShaderResources(UINT start_slot, UINT views_num, ID3D11ShaderResourceView* const* views) override
+   {
+      sets++;
+      for (UINT i = 0; i < views_num; i++) current.shader_resources[start_slot + i] = views[i];
+   }
+   void PSGetConstantBuffers(UINT start_slot, UINT buffers_num, ID3D11Buffer** buffers) override
+   {
+      gets++;
+      constant_buffers_gets++;
+      for (UINT i = 0; i < buffers_num; i++) buffers[i] = com_ptr<ID3D11Buffer>(current.constant_buffers[start_slot + i]).release();
+   }
+   void PSSetConstantBuffers(UINT start_slot, UINT buffers_num, ID3D11Buffer* const* buffers) override
+   {
+      sets++;
+      for (UINT i = 0; i < buffers_num; i++) current.constant_buffers[start_slot + i] = buffers[i];
+   }
+   void VSSetConstantBuffers(UINT start_slot, UINT buffers_num, ID3D11Buffer* const* buffers) override
+   {
+      sets++;
+      for (UINT i = 0; i < buffers_num; i++) current.vs_constant_buffers[start_slot + i] = buffers[i];
+   }
+   void GSSetConstantBuffers(UINT start_slot, UINT buffers_num, ID3D11Buffer* const* buffers) override
+   {
+      sets++;
+      for (UINT i = 0; i < buffers_num; i++) current.gs_constant_buffers[start_slot + i] = buffers[i];
+   }
+   void CSSetConstantBuffers(UINT start_slot, UINT buffers_num, ID3D11Buffer* const* buffers) override
+   {
+      sets++;
+      for (UINT i = 0; i < buffers_num; i++) current.cs_constant_buffers[start_slot + i] = buffers[i];
+   }
+   void OMGetRenderTargets(UINT views_num, ID3D11RenderTargetView** views, ID3D11DepthStencilView** depth_stencil_view) override
+   {
+      gets++;
+      for (UINT i = 0; i < views_num; i++) views[i] = com_ptr<ID3D11RenderTargetView>(current.render_targets[i]).release();
+      if (depth_stencil_view != nullptr) *depth_stencil_view = com_ptr<ID3D11DepthStencilView>(current.depth_stencil_view).release();
+   }
+   void OMSetRenderTargets(UINT views_num, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depth_stencil_view) override
+   {
+      sets++;
+      for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++) current.render_targets[i] = i < views_num ? views[i] : nullptr; // Unbinds the ones after
+      current.depth_stencil_view = depth_stencil_view;
+   }
+   void VSGetShader(ID3D11VertexShader** shader, ID3D11ClassInstance**, UINT* instances_num) override
+   {
+      gets++;
+      *shader = com_ptr<ID3D11VertexShader>(current.vs).release();
+      if (instances_num != nullptr) *instances_num = 0;
+   }
+   void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const*, UINT) override { sets++; current.vs = shader; }
+   void PSGetShader(ID3D11PixelShader** shader, ID3D11ClassInstance**, UINT* instances_num) override
+   {
+      gets++;
+      *shader = com_ptr<ID3D11PixelShader>(current.ps).release();
+      if (instances_num != nullptr) *instances_num = 0;
+   }
+   void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const*, UINT) override { sets++; current.ps = shader; }
+
+   void ResetCounters()
+   {
+      gets = 0;
+      sets = 0;
+      constant_buffers_gets = 0;
+      draws = 0;
+      maps = 0;
+   }
+};
+
+// The ReShade objects, their native objects are the ones above (like with the D3D11 ReShade runtime)
+
+class mock_reshade_device : public reshade::api::device
+{
+public:
+   uint64_t get_native() const override { return reinterpret_cast<uintptr_t>(&native_device); }
+
+   mock_device native_device;
+};
+
+class mock_reshade_command_list : public reshade::api::command_list
+{
+public:
+   explicit mock_reshade_command_list(mock_reshade_device& in_device) : device(in_device) { native_device_context.device = &device.native_device; }
+
+   uint64_t get_native() const override { return reinterpret_cast<uintptr_t>(&native_device_context); }
+   reshade::api::device* get_device() override { return &device; }
+
+   mock_reshade_device& device;
+   mock_device_context native_device_context;
+};
+
+// Only has the immediate command list
+class mock_reshade_command_queue : public reshade::api::command_queue
+{
+public:
+   explicit mock_reshade_command_queue(mock_reshade_device& in_device) : device(in_device), immediate_command_list(in_device) {}
+
+   uint64_t get_native() const override { return reinterpret_cast<uintptr_t>(&immediate_command_list.native_device_context); }
+   reshade::api::device* get_device() override { return &device; }
+   reshade::api::command_list* get_immediate_command_list() override { return &immediate_command_list; }
+
+   mock_reshade_device& device;
+   mock_reshade_command_list immediate_command_list;
+};
+
+// The effect runtime of a swapchain, "present()" cycles through its back buffers
+class mock_reshade_effect_runtime : public reshade::api::effect_runtime
+{
+public:
+   mock_reshade_effect_runtime(mock_reshade_device& in_device, const D3D11_TEXTURE2D_DESC& back_buffers_desc, uint32_t back_buffers_num) : device(in_device), command_queue(in_device)
+   {
+      for (uint32_t i = 0; i < back_buffers_num; i++)
+      {
+         com_ptr<ID3D11Texture2D> back_buffer;
+         device.native_device.CreateTexture2D(&back_buffers_desc, nullptr, &back_buffer);
+         back_buffers.push_back(back_buffer);
+      }
+   }
+
+   reshade::api::device* get_device() override { return &device; }
+   reshade::api::resource get_back_buffer(uint32_t index) override { return { reinterpret_cast<uintptr_t>(back_buffers[index].get()) }; }
+   uint32_t get_back_buffer_count() const override { return uint32_t(back_buffers.size()); }
+   uint32_t get_current_back_buffer_index() const override { return current_back_buffer_index; }
+   reshade::api::command_queue* get_command_queue() override { return &command_queue; }
+
+   void present()
+   {
+      current_back_buffer_index = (current_back_buffer_index + 1) % uint32_t(back_buffers.size());
+   }
+
+   mock_reshade_device& device;
+   mock_reshade_command_queue command_queue;
+   std::vector<com_ptr<ID3D11Texture2D>> back_buffers;
+   uint32_t current_back_buffer_index = 0;
+};
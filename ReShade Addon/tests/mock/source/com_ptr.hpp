@@ -0,0 +1,93 @@
+#pragma once
+
+// Stand-in for ReShade's "com_ptr.hpp" (from its "source" folder), with the same interface, for the tests that run against "mock/d3d11.h".
+
+#include <cassert>
+#include <memory>
+#include <utility>
+
+template <typename T>
+class com_ptr
+{
+public:
+   com_ptr() = default;
+   com_ptr(std::nullptr_t) {}
+   com_ptr(T* object, bool own = false) : _object(object)
+   {
+      if (!own && _object != nullptr)
+         _object->AddRef();
+   }
+   com_ptr(const com_ptr<T>& ptr) : com_ptr(ptr._object, false) {}
+   com_ptr(com_ptr<T>&& ptr) noexcept { operator=(std::move(ptr)); }
+   ~com_ptr() { reset(); }
+
+   // Returns the stored pointer and releases ownership without decreasing the reference count
+   [[nodiscard]] T* release()
+   {
+      T* const object = _object;
+      _object = nullptr;
+      return object;
+   }
+
+   void reset(T* object = nullptr)
+   {
+      if (_object != nullptr)
+         _object->Release();
+      _object = object;
+      if (_object != nullptr)
+         _object->AddRef();
+   }
+
+   unsigned long ref_count() const
+   {
+      assert(_object != nullptr);
+      _object->AddRef();
+      return _object->Release();
+   }
+
+   T* get() const { return _object; }
+
+   T* operator->() const
+   {
+      assert(_object != nullptr);
+      return _object;
+   }
+   T& operator*() const
+   {
+      assert(_object != nullptr);
+      return *_object;
+   }
+   T** operator&()
+   {
+      assert(_object == nullptr); // Anything assigned through this would leak the previous object
+      return &_object;
+   }
+
+   com_ptr<T>& operator=(T* object)
+   {
+      reset(object);
+      return *this;
+   }
+   com_ptr<T>& operator=(const com_ptr<T>& copy)
+   {
+      reset(copy._object);
+      return *this;
+   }
+   com_ptr<T>& operator=(com_ptr<T>&& move) noexcept
+   {
+      if (this != std::addressof(move))
+      {
+         reset();
+         _object = move.release();
+      }
+      return *this;
+   }
+
+   bool operator==(const T* rhs) const { return _object == rhs; }
+   bool operator==(const com_ptr<T>& rhs) const { return _object == rhs._object; }
+   bool operator!=(const T* rhs) const { return _object != rhs; }
+   bool operator!=(const com_ptr<T>& rhs) const { return _object != rhs._object; }
+
+private:
+   T* _object = nullptr;
+};
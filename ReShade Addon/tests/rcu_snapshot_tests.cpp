@@ -0,0 +1,317 @@
+// Standalone stress tests and benchmark of "rcu_snapshot.h" (it has no dependencies on ReShade or Windows), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc rcu_snapshot_tests.cpp && rcu_snapshot_tests.exe
+// g++ -std=c++20 -O2 -pthread rcu_snapshot_tests.cpp -o rcu_snapshot_tests && ./rcu_snapshot_tests
+
+#include "../src/includes/rcu_snapshot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   constexpr uint32_t alive_canary = 0xA11FE;
+   constexpr uint32_t released_canary = 0xDEAD;
+
+   // Like "CachedPipeline": the clone can be replaced or removed (under the writers lock) while lock free readers look at it
+   struct TestPipeline
+   {
+      uint64_t handle = 0;
+      std::atomic<uint32_t> canary = alive_canary;
+      std::atomic<bool> cloned = false;
+      std::atomic<uint64_t> pipeline_clone = 0;
+   };
+
+   using TestSnapshot = std::unordered_map<uint64_t, TestPipeline*>;
+
+   // Released objects are only marked as such (and actually deleted at the end), so readers can verify they never see one
+   struct Graveyard
+   {
+      std::mutex mutex;
+      std::vector<std::unique_ptr<TestPipeline>> pipelines;
+      std::unique_ptr<std::atomic<uint32_t>[]> clones_canaries;
+      std::atomic<size_t> released_pipelines = 0;
+      std::atomic<size_t> released_clones = 0;
+   };
+
+   // Reader threads (draw calls) go through all the pipelines and their clones through the latest snapshot, while a writer thread (pipelines creation, destruction and shaders reloads)
+   // keeps publishing new snapshots, replacing clones and destroying pipelines, and advances the epoch (present).
+   // Everything is deterministic but the threads interleaving, readers should never see a released object, and all the retired objects should eventually be released.
+   void TestStress()
+   {
+      constexpr size_t readers_num = 4;
+      constexpr size_t writer_iterations = 20000;
+      constexpr size_t max_clones = writer_iterations * 2 + 1024;
+
+      rcu_domain domain;
+      rcu_snapshot<TestSnapshot> snapshot;
+      Graveyard graveyard;
+      graveyard.clones_canaries = std::make_unique<std::atomic<uint32_t>[]>(max_clones);
+      for (size_t i = 0; i < max_clones; i++)
+      {
+         graveyard.clones_canaries[i] = alive_canary;
+      }
+
+      TestSnapshot live_pipelines; // Owned by the writer
+      uint64_t next_pipeline_handle = 1;
+      uint64_t next_clone_handle = 1;
+      for (size_t i = 0; i < 256; i++)
+      {
+         auto* pipeline = new TestPipeline();
+         pipeline->handle = next_pipeline_handle++;
+         live_pipelines[pipeline->handle] = pipeline;
+      }
+      snapshot.publish(new TestSnapshot(live_pipelines), domain);
+
+      std::atomic<bool> stop = false;
+      std::atomic<size_t> total_lookups = 0;
+      std::vector<std::thread> readers;
+      for (size_t r = 0; r < readers_num; r++)
+      {
+         readers.emplace_back([&]()
+            {
+               size_t lookups = 0;
+               while (!stop.load(std::memory_order_relaxed))
+               {
+                  const rcu_domain::read_scope read_scope(domain);
+                  const TestSnapshot* current = snapshot.read();
+                  for (const auto& pipeline_pair : *current)
+                  {
+                     const TestPipeline* pipeline = pipeline_pair.second;
+                     CHECK(pipeline->canary.load(std::memory_order_relaxed) == alive_canary);
+                     if (pipeline->cloned.load(std::memory_order_acquire))
+                     {
+                        const uint64_t pipeline_clone = pipeline->pipeline_clone.load(std::memory_order_relaxed);
+                        if (pipeline_clone != 0)
+                        {
+                           CHECK(graveyard.clones_canaries[pipeline_clone].load(std::memory_order_relaxed) == alive_canary);
+                        }
+                     }
+                     lookups++;
+                  }
+               }
+               total_lookups += lookups;
+            });
+      }
+
+      std::mt19937_64 random(1234);
+      size_t retired_pipelines = 0;
+      size_t retired_clones = 0;
+      const auto retire_clone = [&](TestPipeline* pipeline)
+         {
+            const uint64_t pipeline_clone = pipeline->pipeline_clone.load(std::memory_order_relaxed);
+            pipeline->cloned.store(false, std::memory_order_relaxed);
+            pipeline->pipeline_clone.store(0, std::memory_order_relaxed);
+            domain.retire([&graveyard, pipeline_clone]()
+               {
+                  graveyard.clones_canaries[pipeline_clone].store(released_canary, std::memory_order_relaxed);
+                  graveyard.released_clones++;
+               });
+            retired_clones++;
+         };
+      for (size_t i = 0; i < writer_iterations; i++)
+      {
+         auto it = live_pipelines.begin();
+         std::advance(it, random() % live_pipelines.size());
+         TestPipeline* pipeline = it->second;
+         switch (random() % 4)
+         {
+         // (Re)load the custom shader of a pipeline ("LoadCustomShaders()")
+         case 0:
+         case 1:
+         {
+            if (pipeline->cloned.load(std::memory_order_relaxed))
+            {
+               retire_clone(pipeline);
+            }
+            pipeline->pipeline_clone.store(next_clone_handle++, std::memory_order_relaxed);
+            pipeline->cloned.store(true, std::memory_order_release);
+            break;
+         }
+         // Destroy a pipeline and create a new one ("OnDestroyPipeline()" and "OnInitPipeline()")
+         case 2:
+         {
+            if (pipeline->cloned.load(std::memory_order_relaxed))
+            {
+               retire_clone(pipeline);
+            }
+            live_pipelines.erase(it);
+            auto* new_pipeline = new TestPipeline();
+            new_pipeline->handle = next_pipeline_handle++;
+            live_pipelines[new_pipeline->handle] = new_pipeline;
+            snapshot.publish(new TestSnapshot(live_pipelines), domain);
+            domain.retire([&graveyard, pipeline]()
+               {
+                  pipeline->canary.store(released_canary, std::memory_order_relaxed);
+                  const std::lock_guard lock(graveyard.mutex);
+                  graveyard.pipelines.emplace_back(pipeline);
+                  graveyard.released_pipelines++;
+               });
+            retired_pipelines++;
+            break;
+         }
+         // Present
+         case 3:
+         {
+            domain.advance_epoch();
+            break;
+         }
+         }
+      }
+      stop = true;
+      for (auto& reader : readers)
+      {
+         reader.join();
+      }
+
+      // All the readers are done, everything that was retired can be released now
+      domain.advance_epoch();
+      CHECK(graveyard.released_pipelines == retired_pipelines);
+      CHECK(graveyard.released_clones == retired_clones);
+      std::printf("Stress: %zu lookups, %zu pipelines and %zu clones retired and released\n", total_lookups.load(), retired_pipelines, retired_clones);
+
+      for (auto& pipeline_pair : live_pipelines)
+      {
+         delete pipeline_pair.second;
+      }
+   }
+
+   // An object retired while a reader is still in its read scope is only released after the reader leaves it
+   void TestRetireWhileReading()
+   {
+      rcu_domain domain;
+      bool released = false;
+      {
+         const rcu_domain::read_scope read_scope(domain);
+         domain.retire([&released]() { released = true; });
+         domain.advance_epoch();
+         domain.advance_epoch();
+         CHECK(!released);
+      }
+      domain.advance_epoch();
+      CHECK(released);
+
+      // Without readers, the release happens on the next epoch
+      released = false;
+      domain.retire([&released]() { released = true; });
+      CHECK(!released);
+      domain.advance_epoch();
+      CHECK(released);
+   }
+
+   // Compares the lookups throughput of draw call threads reading through the lock free snapshot, against reading under a shared mutex, while another thread keeps writing
+   void BenchmarkContention()
+   {
+      constexpr size_t readers_num = 4;
+      constexpr auto duration = std::chrono::milliseconds(300);
+      constexpr size_t pipelines_num = 4096;
+
+      std::unordered_map<uint64_t, TestPipeline*> pipelines;
+      std::vector<std::unique_ptr<TestPipeline>> pipelines_storage;
+      for (uint64_t i = 1; i <= pipelines_num; i++)
+      {
+         pipelines_storage.push_back(std::make_unique<TestPipeline>());
+         pipelines[i] = pipelines_storage.back().get();
+      }
+
+      const auto run = [&](auto&& lookup, auto&& write)
+         {
+            std::atomic<bool> stop = false;
+            std::atomic<size_t> total_lookups = 0;
+            std::vector<std::thread> readers;
+            for (size_t r = 0; r < readers_num; r++)
+            {
+               readers.emplace_back([&, r]()
+                  {
+                     std::mt19937_64 random(r);
+                     size_t lookups = 0;
+                     size_t found = 0;
+                     while (!stop.load(std::memory_order_relaxed))
+                     {
+                        // A draw looks up its vertex, pixel and compute shaders pipelines
+                        for (size_t i = 0; i < 64; i++, lookups += 3)
+                        {
+                           const uint64_t handles[3] = { 1 + random() % pipelines_num, 1 + random() % pipelines_num, 1 + random() % pipelines_num };
+                           found += lookup(handles);
+                        }
+                     }
+                     CHECK(found == lookups);
+                     total_lookups += lookups;
+                  });
+            }
+            // Pipelines get created (e.g. streaming) every now and then
+            const auto end = std::chrono::steady_clock::now() + duration;
+            while (std::chrono::steady_clock::now() < end)
+            {
+               write();
+               std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            stop = true;
+            for (auto& reader : readers)
+            {
+               reader.join();
+            }
+            return double(total_lookups.load()) / std::chrono::duration<double>(duration).count() / 1000000.0;
+         };
+
+      std::shared_mutex mutex;
+      const double mutex_rate = run([&](const uint64_t(&handles)[3])
+         {
+            size_t found = 0;
+            for (const uint64_t handle : handles)
+            {
+               const std::shared_lock lock(mutex);
+               found += pipelines.find(handle) != pipelines.end() ? 1 : 0;
+            }
+            return found;
+         },
+         [&]()
+         {
+            const std::unique_lock lock(mutex);
+            pipelines[0] = nullptr; // Touch the map
+         });
+
+      rcu_domain domain;
+      rcu_snapshot<TestSnapshot> snapshot;
+      snapshot.publish(new TestSnapshot(pipelines), domain);
+      const double rcu_rate = run([&](const uint64_t(&handles)[3])
+         {
+            size_t found = 0;
+            const rcu_domain::read_scope read_scope(domain);
+            const TestSnapshot* current = snapshot.read();
+            for (const uint64_t handle : handles)
+            {
+               found += current->find(handle) != current->end() ? 1 : 0;
+            }
+            return found;
+         },
+         [&]()
+         {
+            snapshot.publish(new TestSnapshot(pipelines), domain);
+            domain.advance_epoch();
+         });
+
+      // Contention only shows up with multiple cores
+      std::printf("Contention (%zu readers, 1 writer, %u hardware threads): shared_mutex %.1f M lookups/s, rcu snapshot %.1f M lookups/s\n", readers_num, std::thread::hardware_concurrency(), mutex_rate, rcu_rate);
+   }
+}
+
+int main()
+{
+   TestRetireWhileReading();
+   TestStress();
+   BenchmarkContention();
+   std::printf("All rcu_snapshot tests passed\n");
+   return 0;
+}
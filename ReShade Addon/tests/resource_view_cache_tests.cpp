@@ -0,0 +1,157 @@
+// Standalone tests of "resource_view_cache.h", against the headless D3D11 mock ("mock/d3d11.h"), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc /Imock resource_view_cache_tests.cpp && resource_view_cache_tests.exe
+// g++ -std=c++20 -O2 -Imock resource_view_cache_tests.cpp -o resource_view_cache_tests && ./resource_view_cache_tests
+
+#include "../src/includes/resource_view_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Creates real (mock) views, counting them, and can be made to fail
+   struct MockDevice : ID3D11Device
+   {
+      uint32_t created_srvs = 0;
+      uint32_t created_rtvs = 0;
+      bool fail = false;
+
+      HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view) override
+      {
+         if (fail) return E_OUTOFMEMORY;
+         created_srvs++;
+         *view = new ID3D11ShaderResourceView(resource, *desc);
+         return S_OK;
+      }
+      HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view) override
+      {
+         if (fail) return E_OUTOFMEMORY;
+         created_rtvs++;
+         *view = new ID3D11RenderTargetView(resource, *desc);
+         return S_OK;
+      }
+   };
+
+   D3D11_SHADER_RESOURCE_VIEW_DESC MakeSRVDesc(DXGI_FORMAT format, UINT mip = 0)
+   {
+      D3D11_SHADER_RESOURCE_VIEW_DESC desc = {}; // Needs to be zero initialized, it's compared by memory
+      desc.Format = format;
+      desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+      desc.Texture2D.MostDetailedMip = mip;
+      desc.Texture2D.MipLevels = 1;
+      return desc;
+   }
+
+   D3D11_RENDER_TARGET_VIEW_DESC MakeRTVDesc(DXGI_FORMAT format)
+   {
+      D3D11_RENDER_TARGET_VIEW_DESC desc = {};
+      desc.Format = format;
+      desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+      return desc;
+   }
+
+   // Steady state frames re-use the same views, by resource and description
+   void TestReuse()
+   {
+      const int64_t live_objects = IUnknown::live_objects;
+      {
+         MockDevice device;
+         resource_view_cache cache;
+         com_ptr<ID3D11Texture2D> texture(new ID3D11Texture2D(), true);
+         com_ptr<ID3D11Texture2D> other_texture(new ID3D11Texture2D(), true);
+
+         const auto srv = cache.get_srv(&device, texture.get(), MakeSRVDesc(DXGI_FORMAT_R8G8B8A8_UNORM));
+         CHECK(srv.get() != nullptr && srv->resource == texture.get());
+         for (int frame = 0; frame < 100; frame++)
+         {
+            CHECK(cache.get_srv(&device, texture.get(), MakeSRVDesc(DXGI_FORMAT_R8G8B8A8_UNORM)) == srv);
+            cache.trim();
+         }
+         CHECK(device.created_srvs == 1);
+
+         // Other descriptions, resources and view types
+         CHECK(cache.get_srv(&device, texture.get(), MakeSRVDesc(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)) != srv);
+         CHECK(cache.get_srv(&device, texture.get(), MakeSRVDesc(DXGI_FORMAT_R8G8B8A8_UNORM, 1)) != srv);
+         CHECK(cache.get_srv(&device, other_texture.get(), MakeSRVDesc(DXGI_FORMAT_R8G8B8A8_UNORM)) != srv);
+         const auto rtv = cache.get_rtv(&device, texture.get(), MakeRTVDesc(DXGI_FORMAT_R8G8B8A8_UNORM));
+         CHECK(rtv.get() != nullptr);
+         CHECK(cache.get_rtv(&device, texture.get(), MakeRTVDesc(DXGI_FORMAT_R8G8B8A8_UNORM)) == rtv);
+         CHECK(device.created_srvs == 4 && device.created_rtvs == 1);
+         CHECK(cache.get_created_views_count() == 5);
+
+         // Failed creations aren't cached, and null resources never create anything
+         device.fail = true;
+         CHECK(cache.get_srv(&device, texture.get(), MakeSRVDesc(DXGI_FORMAT_R16G16B16A16_FLOAT)).get() == nullptr);
+         device.fail = false;
+         CHECK(cache.get_srv(&device, texture.get(), MakeSRVDesc(DXGI_FORMAT_R16G16B16A16_FLOAT)).get() != nullptr);
+         CHECK(cache.get_srv(&device, nullptr, MakeSRVDesc(DXGI_FORMAT_R16G16B16A16_FLOAT)).get() == nullptr);
+         CHECK(device.created_srvs == 5);
+      }
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+
+   // Views that aren't used for a few frames are released, and so is their reference to the resource
+   void TestTrim()
+   {
+      MockDevice device;
+      resource_view_cache cache;
+      ID3D11Texture2D* texture = new ID3D11Texture2D();
+      cache.get_srv(&device, texture, MakeSRVDesc(DXGI_FORMAT_R8G8B8A8_UNORM));
+      CHECK(texture->ref_count == 2);
+      for (uint32_t frame = 0; frame < resource_view_cache::max_unused_frames; frame++)
+      {
+         cache.trim();
+      }
+      CHECK(texture->ref_count == 2);
+      cache.trim();
+      CHECK(texture->ref_count == 1);
+      CHECK(texture->Release() == 0);
+   }
+
+   // Destroyed resources have their views evicted immediately, so a new resource at the same address never gets them
+   void TestEviction()
+   {
+      MockDevice device;
+      resource_view_cache cache;
+      const int64_t live_objects = IUnknown::live_objects;
+      ID3D11Texture2D* texture = new ID3D11Texture2D();
+      ID3D11Texture2D* other_texture = new ID3D11Texture2D();
+      const auto srv_desc = MakeSRVDesc(DXGI_FORMAT_R10G10B10A2_UNORM);
+      const auto rtv_desc = MakeRTVDesc(DXGI_FORMAT_R10G10B10A2_UNORM);
+      cache.get_srv(&device, texture, srv_desc);
+      cache.get_rtv(&device, texture, rtv_desc);
+      cache.get_srv(&device, other_texture, srv_desc);
+      CHECK(texture->ref_count == 3);
+
+      // What "OnDestroyResource()" does
+      cache.evict(texture);
+      CHECK(texture->ref_count == 1);
+      CHECK(other_texture->ref_count == 2); // Untouched
+
+      // The same address now is a new resource: new views are created
+      CHECK(cache.get_srv(&device, texture, srv_desc)->resource == texture);
+      CHECK(device.created_srvs == 3 && device.created_rtvs == 1);
+      cache.get_rtv(&device, texture, rtv_desc);
+      CHECK(device.created_rtvs == 2);
+
+      // Unknown resources are ignored
+      cache.evict(nullptr);
+      cache.evict(reinterpret_cast<ID3D11Resource*>(uintptr_t(0x1234)));
+
+      cache.clear();
+      CHECK(texture->Release() == 0);
+      CHECK(other_texture->Release() == 0);
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+}
+
+int main()
+{
+   TestReuse();
+   TestTrim();
+   TestEviction();
+   std::printf("All resource_view_cache tests passed\n");
+   return 0;
+}
@@ -0,0 +1,295 @@
+// Standalone tests and benchmark of "shader_cache.hpp" (the pack is memory mapped with POSIX functions outside of Windows, and the hashing needs an x86 CPU), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc shader_cache_tests.cpp && shader_cache_tests.exe
+// g++ -std=c++20 -O2 shader_cache_tests.cpp -o shader_cache_tests && ./shader_cache_tests
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "../src/utils/shader_cache.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   using utils::shader::cache::BytecodePack;
+
+   struct TestRecord
+   {
+      uint64_t key;
+      std::vector<uint8_t> code;
+      std::string warnings;
+   };
+
+   std::filesystem::path MakeTempDirectory(const char* name)
+   {
+      const auto directory = std::filesystem::temp_directory_path() / name;
+      std::filesystem::remove_all(directory);
+      std::filesystem::create_directories(directory);
+      return directory;
+   }
+
+   std::vector<TestRecord> MakeRecords(size_t records_num, uint32_t seed, size_t max_code_size = 4096)
+   {
+      std::mt19937 random(seed);
+      std::vector<TestRecord> records(records_num);
+      for (size_t i = 0; i < records_num; i++)
+      {
+         records[i].key = (uint64_t(random()) << 32) | random();
+         records[i].code.resize(1 + random() % max_code_size);
+         for (auto& byte : records[i].code) byte = uint8_t(random());
+         if (i % 3 == 0) records[i].warnings = "warning X3206: implicit truncation of vector type " + std::to_string(i);
+      }
+      return records;
+   }
+
+   void CheckFound(BytecodePack& pack, const TestRecord& record)
+   {
+      std::vector<uint8_t> code;
+      std::string warnings;
+      CHECK(pack.Find(record.key, code, warnings));
+      CHECK(code == record.code);
+      CHECK(warnings == record.warnings);
+   }
+
+   void CheckNotFound(BytecodePack& pack, const TestRecord& record)
+   {
+      std::vector<uint8_t> code;
+      std::string warnings;
+      CHECK(!pack.Find(record.key, code, warnings));
+   }
+
+   void TestRoundTrip()
+   {
+      const auto pack_path = MakeTempDirectory("luma_shader_cache_round_trip") / "ShadersCache.pack";
+      const auto records = MakeRecords(300, 1);
+      {
+         BytecodePack pack;
+         pack.Open(pack_path);
+         CHECK(pack.IsOpen());
+         for (const auto& record : records)
+         {
+            CheckNotFound(pack, record);
+            pack.Append(record.key, record.code, record.warnings);
+         }
+         // Found from the appended records
+         for (const auto& record : records)
+         {
+            CheckFound(pack, record);
+         }
+         // Appending the same key again does nothing
+         const size_t size = pack.GetSize();
+         pack.Append(records[0].key, records[1].code, records[1].warnings);
+         CHECK(pack.GetSize() == size);
+         CheckFound(pack, records[0]);
+         CHECK(size == std::filesystem::file_size(pack_path));
+      }
+      // Found from the mapped file
+      BytecodePack pack;
+      pack.Open(pack_path);
+      CHECK(pack.IsOpen());
+      for (const auto& record : records)
+      {
+         CheckFound(pack, record);
+      }
+      // Appending after the mapped records
+      const auto more_records = MakeRecords(10, 2);
+      for (const auto& record : more_records)
+      {
+         pack.Append(record.key, record.code, record.warnings);
+         CheckFound(pack, record);
+      }
+      pack.Open(pack_path);
+      for (const auto& record : more_records)
+      {
+         CheckFound(pack, record);
+      }
+
+      pack.Clear();
+      CheckNotFound(pack, records[0]);
+      pack.Open(pack_path);
+      CheckNotFound(pack, records[0]);
+      CHECK(pack.IsOpen());
+   }
+
+   // Simulates the game crashing at any point while a record was being appended, and random corruption within the last record:
+   // all the previous records survive, the torn one is cut away, and the pack keeps working after that
+   void TestCrashConsistency()
+   {
+      const auto directory = MakeTempDirectory("luma_shader_cache_crash");
+      const auto pack_path = directory / "ShadersCache.pack";
+      const auto records = MakeRecords(8, 3, 256);
+      {
+         BytecodePack pack;
+         pack.Open(pack_path);
+         for (const auto& record : records)
+         {
+            pack.Append(record.key, record.code, record.warnings);
+         }
+      }
+      const size_t full_size = std::filesystem::file_size(pack_path);
+      const size_t last_record_size = sizeof(utils::shader::cache::detail::RecordHeader) + records.back().code.size() + records.back().warnings.size();
+      const size_t last_record_offset = full_size - last_record_size;
+      std::vector<char> full_pack(full_size);
+      {
+         std::ifstream file(pack_path, std::ios::binary);
+         file.read(full_pack.data(), full_pack.size());
+      }
+      const auto write_pack = [&](const std::vector<char>& data, size_t size)
+         {
+            std::ofstream file(pack_path, std::ios::binary | std::ios::trunc);
+            file.write(data.data(), size);
+         };
+      const auto check_recovered = [&]()
+         {
+            BytecodePack pack;
+            pack.Open(pack_path);
+            CHECK(pack.IsOpen());
+            CHECK(std::filesystem::file_size(pack_path) == last_record_offset);
+            for (size_t i = 0; i + 1 < records.size(); i++)
+            {
+               CheckFound(pack, records[i]);
+            }
+            CheckNotFound(pack, records.back());
+            // It can be appended to again
+            pack.Append(records.back().key, records.back().code, records.back().warnings);
+            pack.Open(pack_path);
+            CheckFound(pack, records.back());
+         };
+
+      // Torn writes
+      for (size_t size = last_record_offset + 1; size < full_size; size++)
+      {
+         write_pack(full_pack, size);
+         check_recovered();
+      }
+      // Corrupted bytes (in the header or data)
+      for (size_t offset = last_record_offset; offset < full_size; offset += 7)
+      {
+         auto corrupted_pack = full_pack;
+         corrupted_pack[offset] ^= 0x5A;
+         write_pack(corrupted_pack, corrupted_pack.size());
+         check_recovered();
+      }
+
+      // Packs from other versions are discarded
+      auto old_version_pack = full_pack;
+      old_version_pack[4] = char(utils::shader::cache::detail::pack_version + 1);
+      write_pack(old_version_pack, old_version_pack.size());
+      BytecodePack pack;
+      pack.Open(pack_path);
+      CHECK(pack.IsOpen());
+      CheckNotFound(pack, records[0]);
+      CHECK(pack.GetSize() == sizeof(utils::shader::cache::detail::PackHeader));
+   }
+
+   // Only the records used since the pack was opened survive a compaction, and only if the pack went over budget
+   void TestCompaction()
+   {
+      const auto pack_path = MakeTempDirectory("luma_shader_cache_compaction") / "ShadersCache.pack";
+      const auto records = MakeRecords(100, 4);
+      {
+         BytecodePack pack;
+         pack.Open(pack_path);
+         for (const auto& record : records)
+         {
+            pack.Append(record.key, record.code, record.warnings);
+         }
+      }
+      BytecodePack pack;
+      pack.Open(pack_path);
+      for (size_t i = 0; i < records.size(); i += 2)
+      {
+         CheckFound(pack, records[i]);
+      }
+      const size_t size = pack.GetSize();
+      pack.Compact(size); // Within budget
+      CHECK(pack.GetSize() == size);
+      pack.Compact(0);
+      CHECK(pack.GetSize() < size);
+      CHECK(!std::filesystem::exists(pack_path.string() + ".tmp"));
+      pack.Open(pack_path);
+      for (size_t i = 0; i < records.size(); i++)
+      {
+         if (i % 2 == 0) CheckFound(pack, records[i]);
+         else CheckNotFound(pack, records[i]);
+      }
+   }
+
+   void TestKeys()
+   {
+      using utils::shader::cache::ComputeKey;
+      const uint64_t key = ComputeKey(1, 2, "ps_5_0", { "A", "1", "B", "0" });
+      CHECK(key == ComputeKey(1, 2, "ps_5_0", { "A", "1", "B", "0" }));
+      CHECK(key != ComputeKey(2, 2, "ps_5_0", { "A", "1", "B", "0" })); // Compiler version
+      CHECK(key != ComputeKey(1, 3, "ps_5_0", { "A", "1", "B", "0" })); // Preprocessed code
+      CHECK(key != ComputeKey(1, 2, "vs_5_0", { "A", "1", "B", "0" })); // Target
+      CHECK(key != ComputeKey(1, 2, "ps_5_0", { "A", "1", "B", "1" })); // Define value
+      CHECK(key != ComputeKey(1, 2, "ps_5_0", { "A", "1", "B0", "" })); // Defines are separated
+      CHECK(key != ComputeKey(1, 2, "ps_5_0", { "B", "0", "A", "1" })); // Defines order
+   }
+
+   // Compares looking up the shaders bytecode in the mapped pack, against reading one cso file per shader (what used to happen)
+   void BenchmarkLookup()
+   {
+      const auto directory = MakeTempDirectory("luma_shader_cache_benchmark");
+      const auto records = MakeRecords(1000, 5, 16 * 1024);
+      {
+         BytecodePack pack;
+         pack.Open(directory / "ShadersCache.pack");
+         for (const auto& record : records)
+         {
+            pack.Append(record.key, record.code, record.warnings);
+            std::ofstream file(directory / (std::to_string(record.key) + ".cso"), std::ios::binary);
+            file.write(reinterpret_cast<const char*>(record.code.data()), record.code.size());
+         }
+      }
+
+      using clock = std::chrono::steady_clock;
+      const auto files_start = clock::now();
+      size_t files_bytes = 0;
+      for (const auto& record : records)
+      {
+         std::ifstream file(directory / (std::to_string(record.key) + ".cso"), std::ios::binary);
+         file.seekg(0, std::ios::end);
+         std::vector<uint8_t> code(size_t(file.tellg()));
+         file.seekg(0, std::ios::beg);
+         file.read(reinterpret_cast<char*>(code.data()), code.size());
+         files_bytes += code.size();
+      }
+      const auto pack_start = clock::now();
+      BytecodePack pack;
+      pack.Open(directory / "ShadersCache.pack");
+      size_t pack_bytes = 0;
+      std::vector<uint8_t> code;
+      std::string warnings;
+      for (const auto& record : records)
+      {
+         CHECK(pack.Find(record.key, code, warnings));
+         pack_bytes += code.size();
+      }
+      const auto pack_end = clock::now();
+      CHECK(files_bytes == pack_bytes);
+
+      const auto ms = [](clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+      std::printf("Loading %zu shaders (%.1f MB): cso files %.2f ms, pack (open and validate included) %.2f ms\n",
+         records.size(), double(pack_bytes) / (1024.0 * 1024.0), ms(pack_start - files_start), ms(pack_end - pack_start));
+      std::filesystem::remove_all(directory);
+   }
+}
+
+int main()
+{
+   TestRoundTrip();
+   TestCrashConsistency();
+   TestCompaction();
+   TestKeys();
+   BenchmarkLookup();
+   std::printf("All shader_cache tests passed\n");
+   return 0;
+}
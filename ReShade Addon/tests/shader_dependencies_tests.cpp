@@ -0,0 +1,213 @@
+// Standalone tests of "shader_dependencies.hpp" (it has no dependencies on ReShade or Windows), on a temporary shaders folder, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc shader_dependencies_tests.cpp && shader_dependencies_tests.exe
+// g++ -std=c++20 -O2 shader_dependencies_tests.cpp -o shader_dependencies_tests && ./shader_dependencies_tests
+
+#include "../src/utils/shader_dependencies.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   using namespace utils::shader::dependencies;
+
+   const std::string shader_target = "ps_5_0";
+
+   // A shaders folder with: two shaders, both including "Settings.hlsl" (which includes "Common.hlsl"), and one also including "Tonemap.hlsl"
+   struct TestShaderFolder
+   {
+      std::filesystem::path directory;
+      std::filesystem::path shader_a;
+      std::filesystem::path shader_b;
+      std::filesystem::path settings;
+      std::filesystem::path common;
+      std::filesystem::path tonemap;
+
+      explicit TestShaderFolder(const char* name)
+      {
+         directory = std::filesystem::temp_directory_path() / name;
+         std::filesystem::remove_all(directory);
+         std::filesystem::create_directories(directory / "Includes");
+         shader_a = directory / "Final_0x12345678.ps_5_0.hlsl";
+         shader_b = directory / "Bloom With Spaces_0x9ABCDEF0.ps_5_0.hlsl";
+         settings = directory / "Includes" / "Settings.hlsl";
+         common = directory / "Includes" / "Common.hlsl";
+         tonemap = directory / "Includes" / "Tonemap.hlsl";
+         Write(shader_a, "#include \"Includes/Settings.hlsl\"\n#include \"Includes/Tonemap.hlsl\"\n");
+         Write(shader_b, "#include \"Includes/Settings.hlsl\"\n");
+         Write(settings, "#include \"Common.hlsl\"\n#define ENABLE_LUT 1\n");
+         Write(common, "float3 Linearize(float3 color);\n");
+         Write(tonemap, "float3 Tonemap(float3 color);\n");
+      }
+      ~TestShaderFolder()
+      {
+         std::error_code error_code;
+         std::filesystem::remove_all(directory, error_code);
+      }
+
+      static void Write(const std::filesystem::path& path, const std::string& text)
+      {
+         std::ofstream file(path, std::ios::binary | std::ios::trunc);
+         file << text;
+      }
+
+      // Changes the file contents (and size) and makes sure its write time changes too, even on file systems with a coarse time resolution
+      static void Modify(const std::filesystem::path& path, const std::string& text)
+      {
+         const auto last_write_time = std::filesystem::last_write_time(path);
+         Write(path, text);
+         std::filesystem::last_write_time(path, last_write_time + std::chrono::seconds(2));
+      }
+
+      // What the pre-processor include handler does: stamp, then read, each file
+      static std::vector<FileStamp> Stamp(const std::vector<std::filesystem::path>& files)
+      {
+         std::vector<FileStamp> stamps(files.size());
+         for (size_t i = 0; i < files.size(); i++)
+         {
+            if (!GetFileStamp(files[i], stamps[i])) return {};
+         }
+         return stamps;
+      }
+
+      std::vector<FileStamp> StampA() const { return Stamp({ shader_a, settings, common, tonemap }); }
+      std::vector<FileStamp> StampB() const { return Stamp({ shader_b, settings, common }); }
+   };
+
+   bool IsUpToDate(const DependencyGraph& graph, uint32_t shader_hash, const std::filesystem::path& source_path, uint64_t defines_hash, std::size_t expected_preprocessed_hash)
+   {
+      std::size_t preprocessed_hash = 0;
+      if (!graph.IsUpToDate(shader_hash, source_path, shader_target, defines_hash, preprocessed_hash)) return false;
+      CHECK(preprocessed_hash == expected_preprocessed_hash);
+      return true;
+   }
+
+   // Changing an include (even indirect) only invalidates the shaders that depend on it
+   void TestIncludeGraph()
+   {
+      const TestShaderFolder folder("luma_shader_dependencies_graph");
+      const uint64_t defines_hash = HashDefines({ "DEVELOPMENT", "1" });
+      DependencyGraph graph;
+      CHECK(!IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash, 0));
+      graph.Set(0x12345678, shader_target, defines_hash, 111, folder.StampA());
+      graph.Set(0x9ABCDEF0, shader_target, defines_hash, 222, folder.StampB());
+      CHECK(IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash, 111));
+      CHECK(IsUpToDate(graph, 0x9ABCDEF0, folder.shader_b, defines_hash, 222));
+      // Other defines, source file or target
+      CHECK(!IsUpToDate(graph, 0x12345678, folder.shader_a, HashDefines({ "DEVELOPMENT", "0" }), 0));
+      CHECK(!IsUpToDate(graph, 0x12345678, folder.shader_b, defines_hash, 0));
+      std::size_t preprocessed_hash = 0;
+      CHECK(!graph.IsUpToDate(0x12345678, folder.shader_a, "vs_5_0", defines_hash, preprocessed_hash));
+
+      // Dependent shaders (through "lexically_normal()" paths)
+      auto dependent_shaders = graph.GetDependentShaders(folder.directory / "Includes" / ".." / "Includes" / "Common.hlsl");
+      std::sort(dependent_shaders.begin(), dependent_shaders.end());
+      CHECK((dependent_shaders == std::vector<uint32_t>{ 0x12345678, 0x9ABCDEF0 }));
+      CHECK((graph.GetDependentShaders(folder.tonemap) == std::vector<uint32_t>{ 0x12345678 }));
+      CHECK((graph.GetDependentShaders(folder.shader_b) == std::vector<uint32_t>{ 0x9ABCDEF0 }));
+      CHECK(graph.GetDependentShaders(folder.directory / "Unrelated.hlsl").empty());
+
+      TestShaderFolder::Modify(folder.tonemap, "float3 Tonemap(float3 color, float peak);\n");
+      CHECK(!IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash, 0));
+      CHECK(IsUpToDate(graph, 0x9ABCDEF0, folder.shader_b, defines_hash, 222));
+      TestShaderFolder::Modify(folder.common, "float3 Linearize(float3 color, bool srgb);\n");
+      CHECK(!IsUpToDate(graph, 0x9ABCDEF0, folder.shader_b, defines_hash, 0));
+
+      // Re-building a shader makes it up to date again
+      graph.Set(0x12345678, shader_target, defines_hash, 333, folder.StampA());
+      CHECK(IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash, 333));
+
+      // Deleted includes
+      std::filesystem::remove(folder.tonemap);
+      CHECK(!IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash, 0));
+      // Files that couldn't be stamped remove the entry
+      graph.Set(0x12345678, shader_target, defines_hash, 444, folder.StampA());
+      CHECK(graph.GetDependentShaders(folder.shader_a).empty());
+   }
+
+   // A file modified while the shader was being pre-processed (after it was stamped, but before or after it was read) never leaves the shader marked as up to date
+   void TestModifiedWhilePreprocessing()
+   {
+      const TestShaderFolder folder("luma_shader_dependencies_race");
+      const uint64_t defines_hash = HashDefines({});
+      DependencyGraph graph;
+
+      const auto stamps = folder.StampA(); // The include handler stamps the files before reading them
+      TestShaderFolder::Modify(folder.settings, "#include \"Common.hlsl\"\n#define ENABLE_LUT 0\n"); // The user saves a file in the meantime
+      graph.Set(0x12345678, shader_target, defines_hash, 555, stamps); // Pre-processing finishes with whatever version it read
+      CHECK(!IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash, 0)); // So it will be pre-processed again next time
+   }
+
+   // Permutations built from older versions of the files are dropped when a newer one is set, and there's a maximum per shader
+   void TestPermutationsPruning()
+   {
+      const TestShaderFolder folder("luma_shader_dependencies_pruning");
+      DependencyGraph graph;
+      const uint64_t defines_hash_0 = HashDefines({ "LUT", "0" });
+      const uint64_t defines_hash_1 = HashDefines({ "LUT", "1" });
+      graph.Set(0x12345678, shader_target, defines_hash_0, 1, folder.StampA());
+      graph.Set(0x12345678, shader_target, defines_hash_1, 2, folder.StampA());
+      CHECK(IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash_0, 1));
+      CHECK(IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash_1, 2));
+
+      TestShaderFolder::Modify(folder.settings, "#include \"Common.hlsl\"\n");
+      graph.Set(0x12345678, shader_target, defines_hash_1, 3, folder.StampA());
+      CHECK(IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash_1, 3));
+      // Pruned, not simply outdated (it wouldn't come back even if the file went back to its old version)
+      graph.Remove(0x12345678, defines_hash_1);
+      CHECK(graph.GetDependentShaders(folder.shader_a).empty());
+
+      for (uint64_t i = 0; i < DependencyGraph::max_permutations_per_shader + 5; i++)
+      {
+         graph.Set(0x12345678, shader_target, HashDefines({ "PERMUTATION", std::to_string(i) }), i, folder.StampA());
+      }
+      size_t kept_permutations = 0;
+      for (uint64_t i = 0; i < DependencyGraph::max_permutations_per_shader + 5; i++)
+      {
+         const bool up_to_date = IsUpToDate(graph, 0x12345678, folder.shader_a, HashDefines({ "PERMUTATION", std::to_string(i) }), i);
+         CHECK(up_to_date == (i >= 5)); // The oldest are dropped
+         kept_permutations += up_to_date ? 1 : 0;
+      }
+      CHECK(kept_permutations == DependencyGraph::max_permutations_per_shader);
+
+      graph.RemoveOtherShaders({ 0x9ABCDEF0 });
+      CHECK(graph.GetDependentShaders(folder.shader_a).empty());
+   }
+
+   void TestSaveLoad()
+   {
+      const TestShaderFolder folder("luma_shader_dependencies_save");
+      const auto graph_path = folder.directory / "ShadersDependencies.txt";
+      const uint64_t defines_hash = HashDefines({ "A", "1" });
+      {
+         DependencyGraph graph;
+         graph.Set(0x12345678, shader_target, defines_hash, 111, folder.StampA());
+         graph.Set(0x9ABCDEF0, shader_target, defines_hash, 222, folder.StampB()); // Has spaces in its path
+         graph.Save(graph_path);
+      }
+      DependencyGraph graph;
+      graph.Load(graph_path);
+      CHECK(IsUpToDate(graph, 0x12345678, folder.shader_a, defines_hash, 111));
+      CHECK(IsUpToDate(graph, 0x9ABCDEF0, folder.shader_b, defines_hash, 222));
+      CHECK((graph.GetDependentShaders(folder.tonemap) == std::vector<uint32_t>{ 0x12345678 }));
+
+      // Truncated or unknown files are ignored
+      TestShaderFolder::Write(graph_path, "Luma Shaders Dependencies v1\n");
+      DependencyGraph empty_graph;
+      empty_graph.Load(graph_path);
+      CHECK(!IsUpToDate(empty_graph, 0x12345678, folder.shader_a, defines_hash, 0));
+   }
+}
+
+int main()
+{
+   TestIncludeGraph();
+   TestModifiedWhilePreprocessing();
+   TestPermutationsPruning();
+   TestSaveLoad();
+   std::printf("All shader_dependencies tests passed\n");
+   return 0;
+}
@@ -0,0 +1,162 @@
+// Standalone tests and benchmark of "shader_hash_buckets.h" (it has no dependencies on ReShade or Windows), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc shader_hash_buckets_tests.cpp && shader_hash_buckets_tests.exe
+// g++ -std=c++20 -O2 shader_hash_buckets_tests.cpp -o shader_hash_buckets_tests && ./shader_hash_buckets_tests
+
+#include "../src/includes/shader_hash_buckets.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Like "CachedPipeline"
+   struct TestPipeline
+   {
+      std::vector<uint32_t> shader_hashes;
+   };
+
+   // Pipelines are created and destroyed in batches (like when the game streams levels), and many of them share the same shaders
+   void TestChurn()
+   {
+      constexpr size_t pipelines_num = 100000;
+      constexpr size_t live_pipelines_max = 4000;
+      constexpr uint32_t shaders_num = 3000;
+
+      shader_hash_buckets<TestPipeline> buckets;
+      std::mt19937 random(13);
+      std::vector<std::unique_ptr<TestPipeline>> live_pipelines;
+      size_t created_pipelines = 0;
+      size_t max_buckets = 0;
+      while (created_pipelines < pipelines_num)
+      {
+         // Create a batch
+         const size_t batch_size = 1 + random() % 500;
+         for (size_t i = 0; i < batch_size && created_pipelines < pipelines_num; i++, created_pipelines++)
+         {
+            auto pipeline = std::make_unique<TestPipeline>();
+            // Most pipelines have a single shader, some have two (e.g. vertex and pixel)
+            pipeline->shader_hashes.push_back(random() % shaders_num);
+            if (random() % 4 == 0)
+            {
+               const uint32_t second_shader_hash = shaders_num + random() % shaders_num;
+               pipeline->shader_hashes.push_back(second_shader_hash);
+            }
+            for (const uint32_t shader_hash : pipeline->shader_hashes)
+            {
+               buckets.insert(shader_hash, pipeline.get());
+            }
+            live_pipelines.push_back(std::move(pipeline));
+         }
+         // Destroy a random batch, once there's too many
+         while (live_pipelines.size() > live_pipelines_max)
+         {
+            const size_t index = random() % live_pipelines.size();
+            TestPipeline* pipeline = live_pipelines[index].get();
+            buckets.erase(pipeline);
+            for (const uint32_t shader_hash : pipeline->shader_hashes)
+            {
+               const auto* bucket = buckets.find(shader_hash);
+               CHECK(bucket == nullptr || !bucket->contains(pipeline));
+            }
+            live_pipelines[index] = std::move(live_pipelines.back());
+            live_pipelines.pop_back();
+         }
+         max_buckets = std::max(max_buckets, buckets.size());
+      }
+
+      // All the live pipelines are in all of their buckets, and the buckets only contain live pipelines
+      size_t live_links = 0;
+      for (const auto& pipeline : live_pipelines)
+      {
+         for (const uint32_t shader_hash : pipeline->shader_hashes)
+         {
+            const auto* bucket = buckets.find(shader_hash);
+            CHECK(bucket != nullptr && bucket->contains(pipeline.get()));
+            live_links++;
+         }
+      }
+      size_t bucket_links = 0;
+      for (uint32_t shader_hash = 0; shader_hash < shaders_num * 2; shader_hash++)
+      {
+         if (const auto* bucket = buckets.find(shader_hash))
+         {
+            CHECK(!bucket->empty());
+            bucket_links += bucket->size();
+         }
+      }
+      CHECK(live_links == bucket_links);
+
+      // Empty buckets don't pile up
+      for (auto& pipeline : live_pipelines)
+      {
+         buckets.erase(pipeline.get());
+      }
+      CHECK(buckets.size() == 0);
+      std::printf("Churned %zu pipelines, max buckets %zu\n", created_pipelines, max_buckets);
+   }
+
+   // Compares destroying a level worth of pipelines through the reverse index, against going through all the buckets for each of them (what "OnDestroyPipeline()" used to do)
+   void BenchmarkLevelUnload()
+   {
+      constexpr size_t pipelines_num = 20000;
+      constexpr size_t unloaded_pipelines_num = 2000;
+      constexpr uint32_t shaders_num = 8000;
+
+      std::mt19937 random(17);
+      std::vector<std::unique_ptr<TestPipeline>> pipelines;
+      for (size_t i = 0; i < pipelines_num; i++)
+      {
+         auto pipeline = std::make_unique<TestPipeline>();
+         pipeline->shader_hashes.push_back(random() % shaders_num);
+         pipelines.push_back(std::move(pipeline));
+      }
+
+      shader_hash_buckets<TestPipeline> buckets;
+      std::unordered_map<uint32_t, std::unordered_set<TestPipeline*>> old_buckets;
+      for (const auto& pipeline : pipelines)
+      {
+         buckets.insert(pipeline->shader_hashes[0], pipeline.get());
+         old_buckets[pipeline->shader_hashes[0]].emplace(pipeline.get());
+      }
+
+      using clock = std::chrono::steady_clock;
+      const auto old_start = clock::now();
+      for (size_t i = 0; i < unloaded_pipelines_num; i++)
+      {
+         for (auto& bucket_pair : old_buckets)
+         {
+            bucket_pair.second.erase(pipelines[i].get());
+         }
+      }
+      const auto old_end = clock::now();
+      for (size_t i = 0; i < unloaded_pipelines_num; i++)
+      {
+         buckets.erase(pipelines[i].get());
+      }
+      const auto new_end = clock::now();
+
+      for (size_t i = 0; i < unloaded_pipelines_num; i++)
+      {
+         const auto* bucket = buckets.find(pipelines[i]->shader_hashes[0]);
+         CHECK(bucket == nullptr || !bucket->contains(pipelines[i].get()));
+      }
+      const auto ms = [](clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+      std::printf("Destroying %zu of %zu pipelines (%u shaders): all buckets walk %.3f ms, reverse index %.3f ms\n",
+         unloaded_pipelines_num, pipelines_num, shaders_num, ms(old_end - old_start), ms(new_end - old_end));
+   }
+}
+
+int main()
+{
+   TestChurn();
+   BenchmarkLevelUnload();
+   std::printf("All shader_hash_buckets tests passed\n");
+   return 0;
+}
@@ -0,0 +1,227 @@
+// Standalone tests of "shader_permutations.h" (it has no dependencies on ReShade or Windows), with a mock shader compiler and cache, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc shader_permutations_tests.cpp && shader_permutations_tests.exe
+// g++ -std=c++20 -O2 shader_permutations_tests.cpp -o shader_permutations_tests && ./shader_permutations_tests
+
+#include "../src/includes/shader_permutations.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <utility>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   using defines = std::vector<std::string>;
+   using compilation_result = shader_permutations::compilation_result;
+
+   // Like "shader_defines_data": a couple of quality levels, a toggle, a define without a known range and one the user can't edit
+   const std::vector<shader_permutations::define_range> ranges = {
+      { "SSAO_TYPE", true, '0', '2' },
+      { "SSR_QUALITY", true, '0', '3' },
+      { "ENABLE_LUT", true, '0', '1' },
+      { "CUSTOM", false, '0', '0' },
+      { "DEVELOPMENT", false, '0', '1' },
+   };
+
+   defines MakeDefines(char ssao, char ssr, char lut)
+   {
+      return { "SSAO_TYPE", std::string(1, ssao), "SSR_QUALITY", std::string(1, ssr), "ENABLE_LUT", std::string(1, lut), "CUSTOM", "5", "DEVELOPMENT", "0" };
+   }
+
+   // Stands in for "RunCustomShaderCompilationJob()" and "shaders_bytecode_pack": a shader compiled with some defines is cached from then on
+   struct MockCompiler
+   {
+      std::set<std::pair<defines, size_t>> cache;
+      std::set<size_t> broken_shaders; // Always fail to compile
+      size_t compilations = 0;
+
+      compilation_result Compile(const defines& permutation, size_t shader_index)
+      {
+         if (broken_shaders.contains(shader_index)) return compilation_result::failed;
+         if (!cache.emplace(permutation, shader_index).second) return compilation_result::cached;
+         compilations++;
+         return compilation_result::compiled;
+      }
+
+      // A full compilation, as done when the user applies new defines, returns how many shaders actually had to be compiled
+      size_t CompileAll(const defines& permutation, size_t shaders_num)
+      {
+         const size_t previous_compilations = compilations;
+         for (size_t i = 0; i < shaders_num; i++)
+         {
+            Compile(permutation, i);
+         }
+         return compilations - previous_compilations;
+      }
+
+      shader_permutations::precompilation_results Precompile(const std::vector<defines>& permutations, size_t shaders_num, std::function<bool()> should_stop = []() { return false; })
+      {
+         return shader_permutations::precompile(permutations, shaders_num, [this](const defines& permutation, size_t shader_index) { return Compile(permutation, shader_index); }, should_stop);
+      }
+   };
+
+   // Recently used defines come first (most recent first), then one step up or down for each editable define, within its range
+   void TestRanking()
+   {
+      shader_permutations permutations(4, 16);
+      CHECK(permutations.get_likely_permutations(ranges).empty());
+      CHECK(!permutations.has_current_defines());
+
+      permutations.on_compiled(MakeDefines('0', '3', '1'));
+      auto likely = permutations.get_likely_permutations(ranges);
+      CHECK((likely == std::vector<defines>{ MakeDefines('1', '3', '1'), MakeDefines('0', '2', '1'), MakeDefines('0', '3', '0') }));
+
+      permutations.on_compiled(MakeDefines('1', '2', '1'));
+      permutations.on_compiled(MakeDefines('2', '2', '1'));
+      CHECK(permutations.get_current_defines() == MakeDefines('2', '2', '1'));
+      likely = permutations.get_likely_permutations(ranges);
+      CHECK((likely == std::vector<defines>{
+         MakeDefines('1', '2', '1'), // Recent
+         MakeDefines('0', '3', '1'), // Recent
+         MakeDefines('2', '1', '1'),
+         MakeDefines('2', '3', '1'),
+         MakeDefines('2', '2', '0'),
+         }));
+
+      // Going back to recent defines moves them first, without duplicates
+      permutations.on_compiled(MakeDefines('1', '2', '1'));
+      likely = permutations.get_likely_permutations(ranges);
+      CHECK(likely[0] == MakeDefines('2', '2', '1'));
+      CHECK(likely[1] == MakeDefines('0', '3', '1'));
+      CHECK(std::count(likely.begin(), likely.end(), MakeDefines('2', '2', '1')) == 1); // Also one step away
+      CHECK(std::count(likely.begin(), likely.end(), MakeDefines('1', '2', '1')) == 0); // The current ones
+
+      // Only so many recent ones are kept
+      shader_permutations few_recent_permutations(2, 16);
+      few_recent_permutations.on_compiled(MakeDefines('0', '0', '0'));
+      few_recent_permutations.on_compiled(MakeDefines('0', '1', '0'));
+      few_recent_permutations.on_compiled(MakeDefines('0', '2', '0'));
+      likely = few_recent_permutations.get_likely_permutations(ranges);
+      CHECK(likely[0] == MakeDefines('0', '1', '0'));
+      CHECK(std::count(likely.begin(), likely.end(), MakeDefines('0', '0', '0')) == 0);
+   }
+
+   // The amount of permutations is capped (keeping the most likely ones), and defines that changed in the meantime only leave the recent ones
+   void TestLimits()
+   {
+      shader_permutations permutations(4, 3);
+      permutations.on_compiled(MakeDefines('0', '0', '0'));
+      permutations.on_compiled(MakeDefines('1', '1', '1'));
+      auto likely = permutations.get_likely_permutations(ranges);
+      CHECK((likely == std::vector<defines>{ MakeDefines('0', '0', '0'), MakeDefines('0', '1', '1'), MakeDefines('2', '1', '1') }));
+
+      auto other_ranges = ranges;
+      other_ranges.pop_back();
+      CHECK((permutations.get_likely_permutations(other_ranges) == std::vector<defines>{ MakeDefines('0', '0', '0') }));
+      other_ranges = ranges;
+      other_ranges[0].name = "SSAO_QUALITY"; // Renamed define
+      likely = permutations.get_likely_permutations(other_ranges);
+      CHECK(std::count(likely.begin(), likely.end(), MakeDefines('0', '1', '1')) == 0);
+   }
+
+   // Permutations are precompiled one after the other, in order, and the cache makes precompiling them again free
+   void TestScheduling()
+   {
+      constexpr size_t shaders_num = 10;
+      MockCompiler compiler;
+      shader_permutations permutations(4, 8);
+      CHECK(compiler.CompileAll(MakeDefines('1', '1', '1'), shaders_num) == shaders_num);
+      permutations.on_compiled(MakeDefines('1', '1', '1'));
+
+      const auto likely = permutations.get_likely_permutations(ranges);
+      std::vector<defines> order;
+      const auto results = shader_permutations::precompile(likely, shaders_num,
+         [&](const defines& permutation, size_t shader_index)
+         {
+            if (order.empty() || order.back() != permutation) order.push_back(permutation);
+            CHECK(shader_index == (compiler.compilations % shaders_num));
+            return compiler.Compile(permutation, shader_index);
+         },
+         []() { return false; });
+      CHECK(order == likely); // Never interleaved
+      CHECK(!results.cancelled);
+      CHECK(results.compiled_shaders == likely.size() * shaders_num);
+      CHECK(results.cached_shaders == 0);
+      CHECK(results.precompiled_permutations == likely);
+
+      const auto second_results = compiler.Precompile(likely, shaders_num);
+      CHECK(second_results.compiled_shaders == 0);
+      CHECK(second_results.cached_shaders == likely.size() * shaders_num);
+
+      // Failures are counted, and don't stop the permutation from being done
+      compiler.broken_shaders = { 3, 7 };
+      const auto failed_results = compiler.Precompile({ MakeDefines('0', '0', '0') }, shaders_num);
+      CHECK(failed_results.failed_shaders == 2 && failed_results.compiled_shaders == shaders_num - 2);
+      CHECK(failed_results.precompiled_permutations.size() == 1);
+   }
+
+   // Precompilation stops at the next shader once cancelled (e.g. a newer full compilation started), and the partially done permutation doesn't count
+   void TestCancellation()
+   {
+      constexpr size_t shaders_num = 10;
+      MockCompiler compiler;
+      const std::vector<defines> likely = { MakeDefines('0', '0', '0'), MakeDefines('0', '0', '1'), MakeDefines('0', '1', '0') };
+      const auto results = compiler.Precompile(likely, shaders_num, [&]() { return compiler.compilations == shaders_num + 4; });
+      CHECK(results.cancelled);
+      CHECK(results.compiled_shaders == shaders_num + 4);
+      CHECK(compiler.compilations == shaders_num + 4);
+      CHECK(results.precompiled_permutations == std::vector<defines>{ likely[0] });
+
+      const auto immediate_results = compiler.Precompile(likely, shaders_num, []() { return true; });
+      CHECK(immediate_results.cancelled && immediate_results.compiled_shaders == 0 && immediate_results.precompiled_permutations.empty());
+   }
+
+   // Switching to precompiled defines counts as a hit, and needs no compilation at all, switching to anything else is a miss, re-compiling the same defines is neither
+   void TestCacheHits()
+   {
+      constexpr size_t shaders_num = 20;
+      MockCompiler compiler;
+      shader_permutations permutations(4, 8);
+
+      const auto apply_defines = [&](const defines& new_defines)
+         {
+            const size_t compilations = compiler.CompileAll(new_defines, shaders_num);
+            permutations.on_compiled(new_defines);
+            // What the addon does once the compilation is done
+            permutations.on_precompiled(compiler.Precompile(permutations.get_likely_permutations(ranges), shaders_num));
+            return compilations;
+         };
+
+      CHECK(apply_defines(MakeDefines('1', '1', '1')) == shaders_num);
+      CHECK(permutations.get_statistics().hits == 0 && permutations.get_statistics().misses == 0);
+      CHECK(apply_defines(MakeDefines('1', '1', '1')) == 0);
+      CHECK(permutations.get_statistics().hits == 0 && permutations.get_statistics().misses == 0);
+
+      // Quality up, then down again (a recent one), then a toggle
+      CHECK(apply_defines(MakeDefines('1', '2', '1')) == 0);
+      CHECK(apply_defines(MakeDefines('1', '1', '1')) == 0);
+      CHECK(apply_defines(MakeDefines('1', '1', '0')) == 0);
+      CHECK(permutations.get_statistics().hits == 3 && permutations.get_statistics().misses == 0);
+
+      // Two steps away
+      CHECK(apply_defines(MakeDefines('1', '3', '0')) == shaders_num);
+      CHECK(permutations.get_statistics().hits == 3 && permutations.get_statistics().misses == 1);
+
+      // A cancelled precompilation still remembers the permutations it finished (but not the one it was on)
+      const size_t compilations = compiler.compilations;
+      permutations.on_precompiled(compiler.Precompile({ MakeDefines('0', '0', '0'), MakeDefines('0', '0', '1') }, shaders_num, [&]() { return compiler.compilations == compilations + shaders_num + 5; }));
+      permutations.on_compiled(MakeDefines('0', '0', '0'));
+      CHECK(permutations.get_statistics().hits == 4 && permutations.get_statistics().misses == 1);
+      permutations.on_compiled(MakeDefines('0', '0', '1'));
+      CHECK(permutations.get_statistics().hits == 4 && permutations.get_statistics().misses == 2);
+   }
+}
+
+int main()
+{
+   TestRanking();
+   TestLimits();
+   TestScheduling();
+   TestCancellation();
+   TestCacheHits();
+   std::printf("All shader_permutations tests passed\n");
+   return 0;
+}
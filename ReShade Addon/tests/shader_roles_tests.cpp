@@ -0,0 +1,254 @@
+// Standalone tests and microbenchmark of "shader_roles.h" (it has no dependencies on ReShade or Windows), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc shader_roles_tests.cpp && shader_roles_tests.exe
+// g++ -std=c++20 -O2 shader_roles_tests.cpp -o shader_roles_tests && ./shader_roles_tests
+
+#include "../src/includes/shader_roles.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Same values as "reshade::api::shader_stage"
+   constexpr uint32_t stage_vertex = 0x1;
+   constexpr uint32_t stage_pixel = 0x10;
+   constexpr uint32_t stage_compute = 0x20;
+
+   // Mirrors the old "ShaderHashesList"
+   struct HashesList
+   {
+      std::unordered_set<uint32_t> pixel_shaders;
+      std::unordered_set<uint32_t> vertex_shaders;
+      std::unordered_set<uint32_t> compute_shaders;
+
+      bool Contains(uint32_t shader_hash, uint32_t shader_stage) const
+      {
+         if ((shader_stage & stage_pixel) != 0 && pixel_shaders.contains(shader_hash)) return true;
+         if ((shader_stage & stage_vertex) != 0 && vertex_shaders.contains(shader_hash)) return true;
+         if ((shader_stage & stage_compute) != 0) return compute_shaders.contains(shader_hash);
+         return false;
+      }
+   };
+
+   HashesList PixelShaders(std::initializer_list<uint32_t> hashes)
+   {
+      HashesList list;
+      list.pixel_shaders = hashes;
+      return list;
+   }
+   HashesList ComputeShaders(std::initializer_list<uint32_t> hashes)
+   {
+      HashesList list;
+      list.compute_shaders = hashes;
+      return list;
+   }
+
+   struct RoleList
+   {
+      ShaderRoleMask role;
+      HashesList hashes;
+   };
+
+   // The game shaders hashes lists from "Init()" in "main.cpp"
+   std::vector<RoleList> MakeGameRoleLists()
+   {
+      std::vector<RoleList> lists;
+      lists.push_back({ ShaderRoleMask::TiledShadingTiledDeferredShading, ComputeShaders({ 0x1E676CD5, 0x80FF9313, 0x571D5EAE, 0x6710AFD5, 0x54147C78, 0xBCD5A089, 0xC2FC1948, 0xE3EF3C20, 0xF8633A07 }) });
+      lists.push_back({ ShaderRoleMask::DeferredShadingSSRRaytrace, PixelShaders({ 0xAED014D7 }) });
+      lists.push_back({ ShaderRoleMask::SSRBlur, PixelShaders({ 0x8B135192, 0xB969DC27 }) });
+      lists.push_back({ ShaderRoleMask::DeferredShadingSSReflectionComp, PixelShaders({ 0xF355426A }) });
+      lists.push_back({ ShaderRoleMask::PostAAUpscaleImage, PixelShaders({ 0xC2F1D3F6 }) });
+      lists.push_back({ ShaderRoleMask::HDRPostProcessHDRFinalScene, PixelShaders({ 0xB5DC761A, 0x17272B5B, 0xF87B4963, 0x81CE942F, 0x83557B79, 0x37ACE8EF, 0x66FD11D0 }) });
+      lists.push_back({ ShaderRoleMask::HDRPostProcessHDRFinalScene_Sunshafts, PixelShaders({ 0x81CE942F, 0x37ACE8EF, 0x66FD11D0 }) });
+      lists.push_back({ ShaderRoleMask::MotionBlur, PixelShaders({ 0xD0C2257A, 0x76B51523, 0x6DCC9E5D }) });
+      lists.push_back({ ShaderRoleMask::DirOccPass, PixelShaders({ 0x944B65F0, 0xDB98D83F }) });
+      lists.push_back({ ShaderRoleMask::SSDO_Blur, PixelShaders({ 0x1023CD1B }) });
+      lists.push_back({ ShaderRoleMask::PostAAComposites, PixelShaders({ 0x83AE9250, 0x496492FE, 0xED6287FE, 0xFAEE5EE9 }) });
+      lists.push_back({ ShaderRoleMask::SMAA_EdgeDetection, PixelShaders({ 0x5636A813, 0x47B723BD }) });
+      lists.push_back({ ShaderRoleMask::PostAA, PixelShaders({ 0xD8072D98, 0xE9D92B11, 0xBF813081 }) });
+      lists.push_back({ ShaderRoleMask::PostAA_TAA, PixelShaders({ 0xBF813081 }) });
+      return lists;
+   }
+
+   shader_roles_table MakeTable(const std::vector<RoleList>& lists)
+   {
+      shader_roles_table table;
+      for (const auto& list : lists)
+      {
+         table.add_all(stage_pixel, list.hashes.pixel_shaders, list.role);
+         table.add_all(stage_vertex, list.hashes.vertex_shaders, list.role);
+         table.add_all(stage_compute, list.hashes.compute_shaders, list.role);
+      }
+      table.build();
+      return table;
+   }
+
+   // What draw calls used to do, on every draw
+   uint32_t GetRolesByChain(const std::vector<RoleList>& lists, uint32_t shader_hash, uint32_t shader_stage)
+   {
+      uint32_t roles = 0;
+      for (const auto& list : lists)
+      {
+         if (list.hashes.Contains(shader_hash, shader_stage)) roles |= uint32_t(list.role);
+      }
+      return roles;
+   }
+
+   struct RecordedDraw
+   {
+      uint32_t pipeline_index;
+      uint32_t shader_hash;
+      uint32_t shader_stage;
+   };
+
+   // A frame worth of draws: thousands of draws of a few hundred unknown game shaders (materials, shadows, ...), and a few draws of the known passes shaders
+   std::vector<RecordedDraw> MakeHashStream(const std::vector<RoleList>& lists, size_t draws_num, std::vector<uint32_t>& pipelines_roles, const shader_roles_table& table)
+   {
+      std::mt19937 random(3);
+      std::vector<std::pair<uint32_t, uint32_t>> shaders; // Hash and stage
+      for (size_t i = 0; i < 600; i++)
+      {
+         shaders.emplace_back(uint32_t(random()), (i % 3 == 0) ? stage_vertex : stage_pixel);
+      }
+      for (const auto& list : lists)
+      {
+         for (const uint32_t hash : list.hashes.pixel_shaders) shaders.emplace_back(hash, stage_pixel);
+         for (const uint32_t hash : list.hashes.compute_shaders) shaders.emplace_back(hash, stage_compute);
+      }
+      // Pipelines cache their roles on creation
+      for (const auto& shader : shaders)
+      {
+         pipelines_roles.push_back(table.get(shader.second, shader.first));
+      }
+
+      std::vector<RecordedDraw> stream;
+      std::geometric_distribution<uint32_t> popular_shaders(0.01);
+      for (size_t i = 0; i < draws_num; i++)
+      {
+         const uint32_t index = (i % 50 == 0) ? uint32_t(600 + random() % (shaders.size() - 600)) : (popular_shaders(random) % 600);
+         stream.push_back({ index, shaders[index].first, shaders[index].second });
+      }
+      return stream;
+   }
+
+   void TestMatchesChain()
+   {
+      const auto lists = MakeGameRoleLists();
+      const auto table = MakeTable(lists);
+      CHECK(table.is_built());
+
+      std::vector<std::pair<uint32_t, uint32_t>> queries;
+      for (const auto& list : lists)
+      {
+         for (const uint32_t hash : list.hashes.pixel_shaders)
+         {
+            queries.emplace_back(hash, stage_pixel);
+            queries.emplace_back(hash, stage_vertex); // Same hash, different stage, shouldn't match
+         }
+         for (const uint32_t hash : list.hashes.compute_shaders)
+         {
+            queries.emplace_back(hash, stage_compute);
+            queries.emplace_back(hash, stage_pixel);
+         }
+      }
+      std::mt19937 random(5);
+      for (size_t i = 0; i < 10000; i++)
+      {
+         queries.emplace_back(uint32_t(random()), (i & 1) ? stage_pixel : stage_vertex);
+      }
+      for (const auto& query : queries)
+      {
+         CHECK(table.get(query.second, query.first) == GetRolesByChain(lists, query.first, query.second));
+      }
+
+      // Hashes with multiple roles
+      CHECK(table.get(stage_pixel, 0x81CE942F) == (uint32_t(ShaderRoleMask::HDRPostProcessHDRFinalScene) | uint32_t(ShaderRoleMask::HDRPostProcessHDRFinalScene_Sunshafts)));
+      CHECK(table.get(stage_pixel, 0xBF813081) == (uint32_t(ShaderRoleMask::PostAA) | uint32_t(ShaderRoleMask::PostAA_TAA)));
+      CHECK(table.get(stage_compute, 0xC2FC1948) == uint32_t(ShaderRoleMask::TiledShadingTiledDeferredShading));
+      CHECK(table.get(stage_pixel, 0xC2FC1948) == uint32_t(ShaderRoleMask::None));
+   }
+
+   void TestDuplicates()
+   {
+      shader_roles_table table;
+      table.add(stage_pixel, 0x1234, ShaderRoleMask::PostAA);
+      table.add(stage_pixel, 0x1234, ShaderRoleMask::PostAA);
+      table.add(stage_pixel, 0x1234, ShaderRoleMask::MotionBlur);
+      table.add(stage_vertex, 0x1234, ShaderRoleMask::SSDO_Blur);
+      CHECK(!table.is_built());
+      table.build();
+      CHECK(table.size() == 2);
+      CHECK(table.get(stage_pixel, 0x1234) == (uint32_t(ShaderRoleMask::PostAA) | uint32_t(ShaderRoleMask::MotionBlur)));
+      CHECK(table.get(stage_vertex, 0x1234) == uint32_t(ShaderRoleMask::SSDO_Blur));
+      CHECK(table.get(stage_compute, 0x1234) == 0);
+
+      // Rebuilding an empty table
+      table = {};
+      CHECK(table.size() == 0 && table.get(stage_pixel, 0x1234) == 0);
+   }
+
+   // Replays a stream of draws and compares the old per draw chain of hash lists lookups against looking up the roles the pipelines cached on creation
+   void BenchmarkHashStream()
+   {
+      const auto lists = MakeGameRoleLists();
+      const auto table = MakeTable(lists);
+      std::vector<uint32_t> pipelines_roles;
+      const auto stream = MakeHashStream(lists, 200000, pipelines_roles, table);
+      constexpr size_t repetitions = 10;
+
+      using clock = std::chrono::steady_clock;
+      uint32_t chain_checksum = 0;
+      const auto chain_start = clock::now();
+      for (size_t r = 0; r < repetitions; r++)
+      {
+         for (const auto& draw : stream)
+         {
+            chain_checksum += GetRolesByChain(lists, draw.shader_hash, draw.shader_stage);
+         }
+      }
+      const auto chain_end = clock::now();
+
+      uint32_t table_checksum = 0;
+      for (size_t r = 0; r < repetitions; r++)
+      {
+         for (const auto& draw : stream)
+         {
+            table_checksum += table.get(draw.shader_stage, draw.shader_hash);
+         }
+      }
+      const auto table_end = clock::now();
+
+      uint32_t cached_checksum = 0;
+      for (size_t r = 0; r < repetitions; r++)
+      {
+         for (const auto& draw : stream)
+         {
+            cached_checksum += pipelines_roles[draw.pipeline_index];
+         }
+      }
+      const auto cached_end = clock::now();
+
+      CHECK(chain_checksum == table_checksum && table_checksum == cached_checksum);
+      const double draws = double(stream.size() * repetitions);
+      const auto ns_per_draw = [draws](clock::duration duration) { return std::chrono::duration<double, std::nano>(duration).count() / draws; };
+      std::printf("Hash stream of %zu draws: hash lists chain %.2f ns/draw, roles table %.2f ns/draw, roles cached in the pipeline %.2f ns/draw\n",
+         stream.size(), ns_per_draw(chain_end - chain_start), ns_per_draw(table_end - chain_end), ns_per_draw(cached_end - table_end));
+   }
+}
+
+int main()
+{
+   TestMatchesChain();
+   TestDuplicates();
+   BenchmarkHashStream();
+   std::printf("All shader_roles tests passed\n");
+   return 0;
+}
@@ -0,0 +1,248 @@
+// Standalone tests (and benchmark) of "sharded_handle_map.h" (it has no dependencies on ReShade or Windows), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc sharded_handle_map_tests.cpp && sharded_handle_map_tests.exe
+// g++ -std=c++20 -O2 -pthread sharded_handle_map_tests.cpp -o sharded_handle_map_tests && ./sharded_handle_map_tests
+
+#include "../src/includes/sharded_handle_map.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Handles are pointers to (D3D11) objects, so they are aligned and close to each other
+   uint64_t MakeHandle(uint64_t thread_index, uint64_t index)
+   {
+      return 0x000001F000000000ull + (thread_index << 28) + index * 0x40;
+   }
+
+   void TestBasics()
+   {
+      sharded_handle_map<> map;
+      uint64_t value = 0;
+      CHECK(!map.find(MakeHandle(0, 0), value) && !map.erase(MakeHandle(0, 0)));
+      for (uint64_t i = 0; i < 10000; i++)
+      {
+         map.insert_or_assign(MakeHandle(0, i), i);
+      }
+      for (uint64_t i = 0; i < 10000; i++)
+      {
+         CHECK(map.find(MakeHandle(0, i), value) && value == i);
+      }
+      CHECK(!map.contains(MakeHandle(1, 0)));
+
+      // Assigning doesn't insert again
+      map.insert_or_assign(MakeHandle(0, 5), 55);
+      CHECK(map.find(MakeHandle(0, 5), value) && value == 55);
+      auto stats = map.get_statistics();
+      CHECK(stats.size == 10000 && stats.insertions == 10000);
+      // Evenly spread across the shards
+      CHECK(stats.max_shard_size < 10000 / 16 * 2);
+      CHECK(stats.capacity >= stats.size * 2);
+
+      // Erasing every other handle doesn't break the probing of the others
+      for (uint64_t i = 0; i < 10000; i += 2)
+      {
+         CHECK(map.erase(MakeHandle(0, i)));
+      }
+      for (uint64_t i = 0; i < 10000; i++)
+      {
+         CHECK(map.contains(MakeHandle(0, i)) == ((i % 2) != 0));
+      }
+      stats = map.get_statistics();
+      CHECK(stats.size == 5000 && stats.erasures == 5000);
+
+      map.clear();
+      CHECK(map.get_statistics().size == 0 && !map.contains(MakeHandle(0, 1)));
+      map.insert_or_assign(MakeHandle(0, 1), 1);
+      CHECK(map.contains(MakeHandle(0, 1)));
+   }
+
+   // Streaming keeps creating and destroying resources, with about the same amount alive at once: the removed entries are reclaimed, so the tables don't grow
+   void TestChurn()
+   {
+      sharded_handle_map<> map;
+      constexpr uint64_t alive = 2000;
+      for (uint64_t i = 0; i < alive; i++)
+      {
+         map.insert_or_assign(MakeHandle(0, i));
+      }
+      const size_t capacity = map.get_statistics().capacity;
+      for (uint64_t i = alive; i < alive * 100; i++)
+      {
+         CHECK(map.erase(MakeHandle(0, i - alive)));
+         map.insert_or_assign(MakeHandle(0, i));
+      }
+      const auto stats = map.get_statistics();
+      CHECK(stats.size == alive);
+      CHECK(stats.capacity <= capacity * 2);
+      for (uint64_t i = alive * 99; i < alive * 100; i++)
+      {
+         CHECK(map.contains(MakeHandle(0, i)));
+      }
+   }
+
+   // Many streaming threads create and destroy their resources and views at once, while another thread looks them up:
+   // every thread always finds its own live handles (and never the destroyed ones), and the counters add up
+   void TestConcurrentStorm()
+   {
+      sharded_handle_map<> resources;
+      sharded_handle_map<> resource_views;
+      constexpr uint64_t threads_num = 8;
+      constexpr uint64_t iterations = 20000;
+      std::atomic<bool> stop = false;
+      std::thread reader([&]()
+         {
+            uint64_t value = 0;
+            for (uint64_t i = 0; !stop; i++)
+            {
+               // Views always map to a resource handle of the same thread
+               if (resource_views.find(MakeHandle(i % threads_num, (i * 7) % 64 * 2 + 1), value))
+               {
+                  CHECK(value == MakeHandle(i % threads_num, (i * 7) % 64 * 2));
+               }
+            }
+         });
+      std::vector<std::thread> threads;
+      for (uint64_t thread_index = 0; thread_index < threads_num; thread_index++)
+      {
+         threads.emplace_back([&, thread_index]()
+            {
+               for (uint64_t i = 0; i < iterations; i++)
+               {
+                  const uint64_t resource = MakeHandle(thread_index, (i % 64) * 2);
+                  const uint64_t view = MakeHandle(thread_index, (i % 64) * 2 + 1);
+                  if (i >= 64)
+                  {
+                     CHECK(resource_views.erase(view));
+                     CHECK(resources.erase(resource));
+                  }
+                  CHECK(!resources.contains(resource) && !resource_views.contains(view));
+                  resources.insert_or_assign(resource);
+                  resource_views.insert_or_assign(view, resource);
+                  uint64_t value = 0;
+                  CHECK(resource_views.find(view, value) && value == resource);
+               }
+            });
+      }
+      for (auto& thread : threads)
+      {
+         thread.join();
+      }
+      stop = true;
+      reader.join();
+      for (auto* map : { &resources, &resource_views })
+      {
+         const auto stats = map->get_statistics();
+         CHECK(stats.size == threads_num * 64);
+         CHECK(stats.insertions - stats.erasures == stats.size);
+         CHECK(stats.insertions == threads_num * iterations);
+      }
+   }
+
+   // The registries as they were before: an unordered set and map, both under the device mutex (also locked by the render thread)
+   struct SingleMutexRegistry
+   {
+      std::shared_mutex mutex;
+      std::unordered_set<uint64_t> resources;
+      std::unordered_map<uint64_t, uint64_t> resource_views;
+
+      void InitResource(uint64_t resource) { const std::unique_lock lock(mutex); resources.emplace(resource); }
+      void DestroyResource(uint64_t resource) { const std::unique_lock lock(mutex); resources.erase(resource); }
+      void InitResourceView(uint64_t view, uint64_t resource) { const std::unique_lock lock(mutex); resource_views[view] = resource; }
+      void DestroyResourceView(uint64_t view) { const std::unique_lock lock(mutex); resource_views.erase(view); }
+      void Render() { const std::shared_lock lock(mutex); }
+   };
+
+   struct ShardedRegistry
+   {
+      std::shared_mutex mutex;
+      sharded_handle_map<> resources;
+      sharded_handle_map<> resource_views;
+
+      void InitResource(uint64_t resource) { resources.insert_or_assign(resource); }
+      void DestroyResource(uint64_t resource) { resources.erase(resource); }
+      void InitResourceView(uint64_t view, uint64_t resource) { resource_views.insert_or_assign(view, resource); }
+      void DestroyResourceView(uint64_t view) { resource_views.erase(view); }
+      void Render() { const std::shared_lock lock(mutex); }
+   };
+
+   // A streaming storm: threads create textures with a couple of views each and destroy the oldest ones (keeping a few hundred alive each), while the render thread keeps locking the device mutex (shared) for its draws.
+   // Returns the storm duration in seconds, and the number of render thread locks that went through meanwhile.
+   template<typename T>
+   std::pair<double, uint64_t> RunStreamingStorm(size_t threads_num, uint64_t textures_per_thread)
+   {
+      T registry;
+      std::atomic<bool> stop = false;
+      uint64_t draws = 0;
+      std::thread render_thread([&]()
+         {
+            while (!stop)
+            {
+               registry.Render();
+               draws++;
+            }
+         });
+      const auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (size_t thread_index = 0; thread_index < threads_num; thread_index++)
+      {
+         threads.emplace_back([&, thread_index]()
+            {
+               constexpr uint64_t alive = 256;
+               for (uint64_t i = 0; i < textures_per_thread; i++)
+               {
+                  if (i >= alive)
+                  {
+                     const uint64_t old_texture = MakeHandle(thread_index, (i - alive) * 4);
+                     registry.DestroyResourceView(old_texture + 0x40);
+                     registry.DestroyResourceView(old_texture + 0x80);
+                     registry.DestroyResource(old_texture);
+                  }
+                  const uint64_t texture = MakeHandle(thread_index, i * 4);
+                  registry.InitResource(texture);
+                  registry.InitResourceView(texture + 0x40, texture);
+                  registry.InitResourceView(texture + 0x80, texture);
+               }
+            });
+      }
+      for (auto& thread : threads)
+      {
+         thread.join();
+      }
+      const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      stop = true;
+      render_thread.join();
+      return { seconds, draws };
+   }
+
+   void BenchmarkStreamingStorm()
+   {
+      const size_t threads_num = std::max<size_t>(8, std::thread::hardware_concurrency());
+      constexpr uint64_t textures_per_thread = 100000;
+      const auto single_mutex = RunStreamingStorm<SingleMutexRegistry>(threads_num, textures_per_thread);
+      const auto sharded = RunStreamingStorm<ShardedRegistry>(threads_num, textures_per_thread);
+      const double operations = double(threads_num * textures_per_thread * 6);
+      std::printf("Streaming storm (%zu threads, %.1fM creations and destructions): single mutex %.1f Mops/s (%.1fk render thread locks/s), sharded %.1f Mops/s (%.1fk render thread locks/s)\n",
+         threads_num, operations / 1e6, operations / single_mutex.first / 1e6, double(single_mutex.second) / single_mutex.first / 1e3, operations / sharded.first / 1e6, double(sharded.second) / sharded.first / 1e3);
+   }
+}
+
+int main()
+{
+   TestBasics();
+   TestChurn();
+   TestConcurrentStorm();
+   BenchmarkStreamingStorm();
+   std::printf("All sharded_handle_map tests passed\n");
+   return 0;
+}
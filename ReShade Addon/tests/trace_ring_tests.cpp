@@ -0,0 +1,271 @@
+// Standalone tests of "trace_ring.h" (it has no dependencies on ReShade or Windows), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc trace_ring_tests.cpp && trace_ring_tests.exe
+// g++ -std=c++20 -O2 -pthread trace_ring_tests.cpp -o trace_ring_tests && ./trace_ring_tests
+
+#include "../src/includes/trace_ring.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   struct TestRecord
+   {
+      uint32_t id;
+      uint32_t trace_index;
+   };
+
+   struct TestData
+   {
+      uint32_t id;
+   };
+
+   TestData UnpackTestRecord(const TestRecord& record)
+   {
+      return TestData{ record.id };
+   }
+
+   using test_trace = command_list_trace<TestRecord, TestData, 64>;
+
+   // Mirrors the addon events order of a D3D11 deferred context:
+   // "FinishCommandList()" merges the deferred context trace into the new command list object (on the deferred context thread),
+   // and "ExecuteCommandList()" merges that into the immediate context (on the immediate context thread).
+   void TestDeferredContextFinishAndExecute()
+   {
+      constexpr uint32_t trace_index = 1;
+      test_trace immediate_context;
+      test_trace deferred_context;
+      test_trace command_list_1;
+      test_trace command_list_2;
+
+      immediate_context.records.push({ 0, trace_index });
+
+      std::thread deferred_thread([&]()
+         {
+            deferred_context.records.push({ 10, trace_index });
+            deferred_context.records.push({ 11, trace_index });
+            // FinishCommandList()
+            command_list_1.merge(command_list_1, trace_index, &UnpackTestRecord);
+            command_list_1.merge(deferred_context, trace_index, &UnpackTestRecord);
+
+            // The deferred context is reused to record the next command list, these shouldn't end up in the first one
+            deferred_context.records.push({ 20, trace_index });
+            command_list_2.merge(command_list_2, trace_index, &UnpackTestRecord);
+            command_list_2.merge(deferred_context, trace_index, &UnpackTestRecord);
+         });
+      deferred_thread.join();
+
+      // ExecuteCommandList(), the records of command lists that finished within a previous trace are dropped
+      immediate_context.records.push({ 1, trace_index });
+      immediate_context.merge(immediate_context, trace_index, &UnpackTestRecord);
+      immediate_context.merge(command_list_1, trace_index, &UnpackTestRecord);
+      immediate_context.records.push({ 2, trace_index });
+      immediate_context.merge(immediate_context, trace_index, &UnpackTestRecord);
+      immediate_context.merge(command_list_2, trace_index, &UnpackTestRecord);
+      immediate_context.records.push({ 3, trace_index - 1 }); // Stale
+      immediate_context.merge(immediate_context, trace_index, &UnpackTestRecord);
+
+      constexpr uint32_t expected_ids[] = { 0, 1, 10, 11, 2, 20 };
+      CHECK(immediate_context.data.size() == std::size(expected_ids));
+      for (size_t i = 0; i < std::size(expected_ids); i++)
+      {
+         CHECK(immediate_context.data[i].id == expected_ids[i]);
+      }
+      // Everything was moved out of the command lists
+      CHECK(command_list_1.data.empty() && command_list_1.records.empty());
+      CHECK(command_list_2.data.empty() && command_list_2.records.empty());
+      CHECK(deferred_context.records.empty());
+   }
+
+   // A command list finished within a trace, but only executed within the next one
+   void TestStaleCommandList()
+   {
+      test_trace immediate_context;
+      test_trace deferred_context;
+      test_trace command_list;
+
+      deferred_context.records.push({ 10, 1 });
+      command_list.merge(deferred_context, 1, &UnpackTestRecord);
+
+      immediate_context.records.push({ 0, 2 });
+      immediate_context.merge(immediate_context, 2, &UnpackTestRecord);
+      immediate_context.merge(command_list, 2, &UnpackTestRecord);
+      CHECK(immediate_context.data.size() == 1 && immediate_context.data[0].id == 0);
+      CHECK(command_list.data.empty());
+   }
+
+   void TestRingOverflow()
+   {
+      trace_ring<TestRecord, 64> ring;
+      for (uint32_t i = 0; i < 100; i++)
+      {
+         CHECK(ring.push({ i, 0 }) == (i < 64));
+      }
+      CHECK(ring.get_dropped_count() == 36);
+      uint32_t next_id = 0;
+      CHECK(ring.drain([&](const TestRecord& record) { CHECK(record.id == next_id++); }) == 64);
+      CHECK(ring.empty() && ring.push({ 0, 0 }));
+   }
+
+   // Many producers (e.g. the threads recording command lists) push into their own rings while a single consumer keeps draining all of them:
+   // no record is lost or duplicated, and the records of each producer come out in the order they were pushed
+   void TestConcurrentProducers()
+   {
+      constexpr uint32_t producers_num = 8;
+      constexpr uint32_t records_per_producer = 20000;
+      trace_ring<TestRecord, 64> rings[producers_num];
+      std::atomic<uint32_t> running_producers = producers_num;
+      std::vector<std::thread> producers;
+      for (uint32_t producer = 0; producer < producers_num; producer++)
+      {
+         producers.emplace_back([&, producer]()
+            {
+               for (uint32_t i = 0; i < records_per_producer; i++)
+               {
+                  // Full rings drop records, only push the next one after the consumer made space (so we can verify nothing else gets lost)
+                  while (!rings[producer].push({ i, producer }))
+                  {
+                     std::this_thread::yield();
+                  }
+               }
+               running_producers--;
+            });
+      }
+
+      uint32_t next_ids[producers_num] = {};
+      bool done = false;
+      while (!done)
+      {
+         done = running_producers == 0; // Drain once more after all the producers finished
+         for (uint32_t producer = 0; producer < producers_num; producer++)
+         {
+            rings[producer].drain([&](const TestRecord& record)
+               {
+                  CHECK(record.trace_index == producer);
+                  CHECK(record.id == next_ids[producer]);
+                  next_ids[producer]++;
+               });
+         }
+      }
+      for (auto& producer : producers)
+      {
+         producer.join();
+      }
+      for (uint32_t producer = 0; producer < producers_num; producer++)
+      {
+         CHECK(next_ids[producer] == records_per_producer);
+         CHECK(rings[producer].empty());
+      }
+   }
+
+   // Many deferred contexts record and finish command lists concurrently, while the immediate context executes them (in the order they get submitted) and traces its own draws in between:
+   // the final trace has every record exactly once, the ones of each command list contiguous and in order, following the submission order
+   void TestDeferredContextsStress()
+   {
+      constexpr uint32_t trace_index = 7;
+      constexpr uint32_t deferred_contexts_num = 8;
+      constexpr uint32_t command_lists_per_context = 500;
+      constexpr uint32_t immediate_id = UINT32_MAX;
+      // The record ids encode who recorded them
+      const auto make_id = [](uint32_t context, uint32_t command_list, uint32_t record) { return (context << 28) | (command_list << 6) | record; };
+      const auto records_num = [](uint32_t command_list) { return 1 + (command_list % 48); };
+
+      std::mutex submission_mutex;
+      std::condition_variable submission_condition;
+      std::deque<std::unique_ptr<test_trace>> submitted_command_lists;
+      uint32_t finished_contexts = 0;
+
+      std::vector<std::thread> deferred_threads;
+      for (uint32_t context = 0; context < deferred_contexts_num; context++)
+      {
+         deferred_threads.emplace_back([&, context]()
+            {
+               test_trace deferred_context;
+               for (uint32_t command_list_index = 0; command_list_index < command_lists_per_context; command_list_index++)
+               {
+                  for (uint32_t record = 0; record < records_num(command_list_index); record++)
+                  {
+                     CHECK(deferred_context.records.push({ make_id(context, command_list_index, record), trace_index }));
+                  }
+                  // FinishCommandList()
+                  auto command_list = std::make_unique<test_trace>();
+                  command_list->merge(*command_list, trace_index, &UnpackTestRecord);
+                  command_list->merge(deferred_context, trace_index, &UnpackTestRecord);
+                  CHECK(deferred_context.records.empty());
+                  {
+                     const std::lock_guard lock(submission_mutex);
+                     submitted_command_lists.push_back(std::move(command_list));
+                  }
+                  submission_condition.notify_one();
+               }
+               {
+                  const std::lock_guard lock(submission_mutex);
+                  finished_contexts++;
+               }
+               submission_condition.notify_one();
+            });
+      }
+
+      // The immediate context thread, it executes the command lists as they get submitted
+      test_trace immediate_context;
+      std::vector<uint32_t> submission_order; // The deferred context of each executed command list
+      while (true)
+      {
+         std::unique_ptr<test_trace> command_list;
+         {
+            std::unique_lock lock(submission_mutex);
+            submission_condition.wait(lock, [&]() { return !submitted_command_lists.empty() || finished_contexts == deferred_contexts_num; });
+            if (submitted_command_lists.empty()) break;
+            command_list = std::move(submitted_command_lists.front());
+            submitted_command_lists.pop_front();
+         }
+         CHECK(!command_list->data.empty());
+         submission_order.push_back(command_list->data[0].id >> 28);
+         // A draw of its own, before the execution
+         CHECK(immediate_context.records.push({ immediate_id, trace_index }));
+         // ExecuteCommandList()
+         immediate_context.merge(immediate_context, trace_index, &UnpackTestRecord);
+         immediate_context.merge(*command_list, trace_index, &UnpackTestRecord);
+         CHECK(command_list->data.empty());
+      }
+      for (auto& thread : deferred_threads)
+      {
+         thread.join();
+      }
+      immediate_context.merge(immediate_context, trace_index, &UnpackTestRecord); // On present
+
+      CHECK(submission_order.size() == deferred_contexts_num * command_lists_per_context);
+      uint32_t next_command_lists[deferred_contexts_num] = {};
+      size_t i = 0;
+      for (const uint32_t context : submission_order)
+      {
+         CHECK(i < immediate_context.data.size() && immediate_context.data[i++].id == immediate_id);
+         const uint32_t command_list_index = next_command_lists[context]++;
+         for (uint32_t record = 0; record < records_num(command_list_index); record++)
+         {
+            CHECK(i < immediate_context.data.size() && immediate_context.data[i++].id == make_id(context, command_list_index, record));
+         }
+      }
+      CHECK(i == immediate_context.data.size());
+      for (const uint32_t command_lists : next_command_lists)
+      {
+         CHECK(command_lists == command_lists_per_context);
+      }
+   }
+}
+
+int main()
+{
+   TestDeferredContextFinishAndExecute();
+   TestStaleCommandList();
+   TestRingOverflow();
+   TestConcurrentProducers();
+   TestDeferredContextsStress();
+   std::printf("All trace_ring tests passed\n");
+   return 0;
+}
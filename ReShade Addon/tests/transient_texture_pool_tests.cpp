@@ -0,0 +1,231 @@
+// Standalone tests of "transient_texture_pool.h", against the headless D3D11 and ReShade mocks ("mock/"), build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc /Imock transient_texture_pool_tests.cpp && transient_texture_pool_tests.exe
+// g++ -std=c++20 -O2 -Imock transient_texture_pool_tests.cpp -o transient_texture_pool_tests && ./transient_texture_pool_tests
+
+#include "../src/includes/transient_texture_pool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Creates real (mock) textures, counting them, and can be made to fail
+   struct MockDevice : ID3D11Device
+   {
+      std::atomic<uint32_t> created_textures = 0;
+      bool fail = false;
+
+      HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture2D** texture) override
+      {
+         if (fail) return E_OUTOFMEMORY;
+         created_textures++;
+         *texture = new ID3D11Texture2D();
+         (*texture)->desc = *desc;
+         return S_OK;
+      }
+   };
+
+   D3D11_TEXTURE2D_DESC MakeDesc(UINT width, UINT height, DXGI_FORMAT format = DXGI_FORMAT_R16G16B16A16_FLOAT)
+   {
+      D3D11_TEXTURE2D_DESC desc = {}; // Needs to be zero initialized, it's compared by memory
+      desc.Width = width;
+      desc.Height = height;
+      desc.MipLevels = 1;
+      desc.ArraySize = 1;
+      desc.Format = format;
+      desc.SampleDesc.Count = 1;
+      desc.Usage = D3D11_USAGE_DEFAULT;
+      desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+      return desc;
+   }
+
+   // Released textures are re-used by description, and only by the exact same one
+   void TestReuse()
+   {
+      const int64_t live_objects = IUnknown::live_objects;
+      {
+         MockDevice device;
+         transient_texture_pool pool;
+         const auto desc = MakeDesc(1920, 1080);
+         auto texture = pool.acquire(&device, desc);
+         CHECK(texture.get() != nullptr);
+         ID3D11Texture2D* const texture_ptr = texture.get();
+         pool.release(texture);
+         CHECK(texture.get() == nullptr);
+         pool.release(texture); // Releasing nothing does nothing
+
+         texture = pool.acquire(&device, desc);
+         CHECK(texture.get() == texture_ptr);
+         CHECK(device.created_textures == 1);
+         pool.release(texture);
+
+         // Anything else in the description is another texture, including what isn't part of the bucket key (so it collides), like MSAA or misc flags
+         auto msaa_desc = desc;
+         msaa_desc.SampleDesc.Count = 4;
+         auto misc_desc = desc;
+         misc_desc.MiscFlags = 0x4;
+         for (const auto& other_desc : { MakeDesc(1920, 1081), MakeDesc(1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM), msaa_desc, misc_desc })
+         {
+            auto other_texture = pool.acquire(&device, other_desc);
+            CHECK(other_texture.get() != texture_ptr);
+            CHECK(std::memcmp(&other_texture->desc, &other_desc, sizeof(other_desc)) == 0);
+            pool.release(other_texture);
+         }
+         CHECK(device.created_textures == 5);
+         const auto stats = pool.get_statistics();
+         CHECK(stats.created_textures == 5 && stats.reused_textures == 1 && stats.destroyed_textures == 0);
+
+         // Failed creations return nothing and don't count
+         device.fail = true;
+         CHECK(pool.acquire(&device, MakeDesc(64, 64)).get() == nullptr);
+         CHECK(pool.acquire(&device, desc).get() == texture_ptr); // Still re-used
+         device.fail = false;
+         CHECK(pool.get_statistics().created_textures == 5);
+      }
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+
+   // Free textures are destroyed only after they haven't been re-used for a few frames, and the allocated memory is tracked along
+   void TestDeferredDestruction()
+   {
+      MockDevice device;
+      transient_texture_pool pool;
+      const int64_t live_objects = IUnknown::live_objects;
+      const uint64_t texture_size = 1920 * 1080 * 8;
+      auto texture = pool.acquire(&device, MakeDesc(1920, 1080));
+      CHECK(pool.get_statistics().allocated_bytes == texture_size);
+      ID3D11Texture2D* const texture_ptr = texture.get();
+      texture_ptr->AddRef();
+      pool.release(texture);
+      for (uint32_t frame = 0; frame < transient_texture_pool::max_free_frames; frame++)
+      {
+         pool.end_frame();
+      }
+      CHECK(texture_ptr->ref_count == 2);
+      pool.end_frame();
+      CHECK(texture_ptr->ref_count == 1);
+      CHECK(texture_ptr->Release() == 0);
+      auto stats = pool.get_statistics();
+      CHECK(stats.destroyed_textures == 1 && stats.allocated_bytes == 0 && stats.peak_allocated_bytes == texture_size);
+
+      // Mips and arrays are accounted for (roughly)
+      auto mips_desc = MakeDesc(1024, 1024, DXGI_FORMAT_R8G8B8A8_UNORM);
+      mips_desc.MipLevels = 0;
+      mips_desc.ArraySize = 2;
+      texture = pool.acquire(&device, mips_desc);
+      CHECK(pool.get_statistics().allocated_bytes == uint64_t(1024 * 1024 * 4) * 2 * 4 / 3);
+      pool.release(texture);
+      pool.clear();
+      stats = pool.get_statistics();
+      CHECK(stats.destroyed_textures == 2 && stats.allocated_bytes == 0);
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+
+   // What the addon passes do: every frame each pass releases its texture and acquires one for the current resolution (if it changed).
+   // Toggling between two resolutions (e.g. DLSS on and off, or dynamic resolution scaling) only ever creates the textures for each resolution once,
+   // and memory peaks at both sets of textures, never more.
+   void TestResolutionToggling()
+   {
+      MockDevice device;
+      transient_texture_pool pool;
+      const int64_t live_objects = IUnknown::live_objects;
+      constexpr size_t passes_num = 3;
+      com_ptr<ID3D11Texture2D> pass_textures[passes_num];
+      const auto pass_desc = [](size_t pass, UINT width, UINT height) { return MakeDesc(width / UINT(pass + 1), height / UINT(pass + 1), pass == 0 ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R16G16B16A16_FLOAT); };
+      const auto set_size = [&](UINT width, UINT height)
+         {
+            uint64_t size = 0;
+            for (size_t pass = 0; pass < passes_num; pass++)
+            {
+               const auto desc = pass_desc(pass, width, height);
+               size += uint64_t(desc.Width) * desc.Height * (desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM ? 4 : 8);
+            }
+            return size;
+         };
+      UINT current_resolution[2] = {};
+      for (uint32_t frame = 0; frame < 120; frame++)
+      {
+         // Toggles every couple of frames, well within "max_free_frames"
+         const bool high_resolution = ((frame / 2) % 2) == 0;
+         const UINT width = high_resolution ? 3840 : 1920;
+         const UINT height = high_resolution ? 2160 : 1080;
+         if (width != current_resolution[0] || height != current_resolution[1])
+         {
+            current_resolution[0] = width;
+            current_resolution[1] = height;
+            for (size_t pass = 0; pass < passes_num; pass++)
+            {
+               pool.release(pass_textures[pass]);
+               pass_textures[pass] = pool.acquire(&device, pass_desc(pass, width, height));
+               CHECK(pass_textures[pass].get() != nullptr);
+            }
+         }
+         pool.end_frame();
+      }
+      auto stats = pool.get_statistics();
+      CHECK(device.created_textures == passes_num * 2);
+      CHECK(stats.peak_allocated_bytes == set_size(3840, 2160) + set_size(1920, 1080));
+
+      // Once it settles, the unused set is freed
+      for (uint32_t frame = 0; frame <= transient_texture_pool::max_free_frames; frame++)
+      {
+         pool.end_frame();
+      }
+      stats = pool.get_statistics();
+      CHECK(stats.destroyed_textures == passes_num);
+      CHECK(stats.allocated_bytes == set_size(current_resolution[0], current_resolution[1]));
+      for (auto& texture : pass_textures)
+      {
+         pool.release(texture);
+      }
+      pool.clear();
+      CHECK(pool.get_statistics().allocated_bytes == 0);
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+
+   // Passes can acquire and release from multiple threads (e.g. deferred contexts), textures are never handed out twice
+   void TestThreads()
+   {
+      MockDevice device;
+      transient_texture_pool pool;
+      const int64_t live_objects = IUnknown::live_objects;
+      std::vector<std::thread> threads;
+      for (UINT thread_index = 0; thread_index < 4; thread_index++)
+      {
+         threads.emplace_back([&, thread_index]()
+            {
+               for (UINT iteration = 0; iteration < 5000; iteration++)
+               {
+                  auto texture = pool.acquire(&device, MakeDesc(64 + (iteration % 3), 64));
+                  CHECK(texture.get() != nullptr);
+                  // We'd be the only user of the texture (other than the pool itself)
+                  CHECK(texture->ref_count == 1);
+                  if ((iteration % 100) == thread_index) pool.end_frame();
+                  pool.release(texture);
+               }
+            });
+      }
+      for (auto& thread : threads)
+      {
+         thread.join();
+      }
+      const auto stats = pool.get_statistics();
+      CHECK(stats.created_textures + stats.reused_textures == 4 * 5000);
+      CHECK(stats.created_textures <= 4 * 3 + stats.destroyed_textures);
+      pool.clear();
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+}
+
+int main()
+{
+   TestReuse();
+   TestDeferredDestruction();
+   TestResolutionToggling();
+   TestThreads();
+   std::printf("All transient_texture_pool tests passed\n");
+   return 0;
+}
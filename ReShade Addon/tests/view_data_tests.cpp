@@ -0,0 +1,377 @@
+// Standalone tests of "view_data.h" and "sampler_upgrade.h" (the addon code that reads the game global cbuffer, creates the upgraded samplers and pushes our cbuffers),
+// running as on a present, through the headless ReShade effect runtime, device and command list of "mock/mock_runtime.h", build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc /Imock view_data_tests.cpp && view_data_tests.exe
+// g++ -std=c++20 -O2 -Imock view_data_tests.cpp -o view_data_tests && ./view_data_tests
+
+#define DEVELOPMENT 0
+#define TEST 0
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+// Any addon assertion failing fails the tests
+#define ASSERT_ONCE(condition) CHECK(condition)
+
+#include "../src/includes/draw_state_stack.h"
+#include "../src/includes/view_data.h"
+#include "mock/mock_runtime.h"
+
+namespace
+{
+   constexpr UINT output_width = 1920;
+   constexpr UINT output_height = 1080;
+
+   // The device data as in "OnInitDevice()" (and "OnInitSwapchain()" for the output resolution), with our cbuffers created on the native device
+   DeviceViewData& CreateDeviceData(reshade::api::device* device)
+   {
+      auto& device_data = device->create_private_data<DeviceViewData>();
+      device_data.output_resolution = { float(output_width), float(output_height) };
+
+      ID3D11Device* native_device = reinterpret_cast<ID3D11Device*>(device->get_native());
+      D3D11_BUFFER_DESC buffer_desc = {};
+      buffer_desc.ByteWidth = sizeof(LumaFrameSettings);
+      buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+      buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+      buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+      D3D11_SUBRESOURCE_DATA data = {};
+      data.pSysMem = &cb_luma_frame_settings;
+      CHECK(SUCCEEDED(native_device->CreateBuffer(&buffer_desc, &data, &device_data.luma_frame_settings)));
+      device_data.cb_luma_frame_settings_dirty = false;
+      buffer_desc.ByteWidth = sizeof(LumaFrameData);
+      data.pSysMem = &device_data.cb_luma_frame_data;
+      CHECK(SUCCEEDED(native_device->CreateBuffer(&buffer_desc, &data, &device_data.luma_frame_data)));
+      return device_data;
+   }
+
+   // Same as the end of "OnPresent()" (the view data part of it)
+   void EndFrame(DeviceViewData& device_data)
+   {
+      if (device_data.frame_passes.has_drawn(FramePass::MainPostProcessing))
+      {
+         device_data.previous_prey_taa_active[1] = device_data.previous_prey_taa_active[0];
+         device_data.previous_prey_taa_active[0] = device_data.prey_taa_active;
+      }
+      device_data.frame_passes.end_frame();
+      device_data.prey_drs_active = false;
+      device_data.found_per_view_globals = false;
+      device_data.previous_render_resolution = device_data.render_resolution;
+      previous_projection_matrix = projection_matrix;
+      previous_nearest_projection_matrix = nearest_projection_matrix;
+      previous_projection_jitters = projection_jitters;
+      cb_per_view_global_previous = cb_per_view_global;
+      reprojection_matrix.SetIdentity();
+      frame_index++;
+   }
+
+   // The memory the game maps the global cbuffer (13) with, it's bigger than "CBPerViewGlobal" (see "CBPerViewGlobal_buffer_size")
+   struct GlobalCBufferData
+   {
+      alignas(16) uint8_t data[CBPerViewGlobal_buffer_size] = {};
+
+      CBPerViewGlobal& get() { return *reinterpret_cast<CBPerViewGlobal*>(&data[0]); }
+   };
+
+   // The (transposed, as in the cbuffer) jittered projection matrix of the main view
+   Matrix44A MakeProjectionMatrix(float2 jitters)
+   {
+      Matrix44A projection_matrix = Matrix44A(
+         1.f, 0.f, 0.f, 0.f,
+         0.f, 1.7778f, 0.f, 0.f,
+         jitters.x, jitters.y, 0.0001f, 1.f,
+         0.f, 0.f, 0.25f, 0.f);
+      return projection_matrix.GetTransposed();
+   }
+
+   // The global cbuffer as the game sets it for the main view (the scene), rendering at "render_width" x "render_height"
+   void MakeMainViewGlobalCBuffer(GlobalCBufferData& cbuffer, float render_width, float render_height, float2 jitters)
+   {
+      cbuffer = {};
+      CBPerViewGlobal& global_cbuffer = cbuffer.get();
+      global_cbuffer.CV_ViewProjZeroMatr.SetIdentity();
+      global_cbuffer.CV_ViewProjMatr.SetIdentity();
+      global_cbuffer.CV_ViewProjNearestMatr.SetIdentity();
+      global_cbuffer.CV_InvViewProj.SetIdentity();
+      global_cbuffer.CV_PrevViewProjMatr = MakeProjectionMatrix(jitters);
+      global_cbuffer.CV_PrevViewProjNearestMatr = MakeProjectionMatrix(jitters);
+      global_cbuffer.CV_FrustumPlaneEquation.SetIdentity();
+      global_cbuffer.CV_ViewMatr.SetIdentity();
+      global_cbuffer.CV_InvViewMatr.SetIdentity();
+      global_cbuffer.CV_ScreenSize = { render_width, render_height, 0.5f / output_width, 0.5f / output_height };
+      global_cbuffer.CV_HPosScale = { render_width / output_width, render_height / output_height, render_width / output_width, render_height / output_height };
+      global_cbuffer.CV_HPosClamp = { global_cbuffer.CV_HPosScale.x - global_cbuffer.CV_ScreenSize.z, global_cbuffer.CV_HPosScale.y - global_cbuffer.CV_ScreenSize.w, global_cbuffer.CV_HPosScale.x - global_cbuffer.CV_ScreenSize.z, global_cbuffer.CV_HPosScale.y - global_cbuffer.CV_ScreenSize.w };
+      global_cbuffer.CV_SunLightDir = { 0.f, 0.f, 1.f, 1.f };
+      global_cbuffer.CV_SkyColor = { 0.5f, 0.5f, 1.f, 1.f };
+      global_cbuffer.CV_DecalZFightingRemedy = { 0.95f, 0.f, 0.f, 0.f };
+   }
+
+   // Only anisotropic samplers are upgraded (to the maximum anisotropy), and their LOD bias is replaced by the (clamped) offset
+   void TestCreateCustomSampler()
+   {
+      mock_device device;
+      D3D11_SAMPLER_DESC desc = {};
+      desc.Filter = D3D11_FILTER_ANISOTROPIC;
+      desc.MaxAnisotropy = 4;
+      desc.MipLODBias = 0.5f;
+      desc.MaxLOD = 1000.f;
+      com_ptr<ID3D11SamplerState> sampler = CreateCustomSampler(&device, desc, -1.5f);
+      CHECK(sampler != nullptr && device.created_samplers == 1);
+      CHECK(sampler->desc.Filter == D3D11_FILTER_ANISOTROPIC && sampler->desc.MaxAnisotropy == D3D11_REQ_MAXANISOTROPY);
+      CHECK(sampler->desc.MipLODBias == -1.5f && sampler->desc.MaxLOD == 1000.f);
+      CHECK(CreateCustomSampler(&device, desc, -100.f)->desc.MipLODBias == D3D11_MIP_LOD_BIAS_MIN);
+      CHECK(CreateCustomSampler(&device, desc, 100.f)->desc.MipLODBias == D3D11_MIP_LOD_BIAS_MAX);
+
+      desc.Filter = D3D11_FILTER_COMPARISON_ANISOTROPIC;
+      desc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+      sampler = CreateCustomSampler(&device, desc, -1.f);
+      CHECK(sampler != nullptr && sampler->desc.Filter == D3D11_FILTER_COMPARISON_ANISOTROPIC && sampler->desc.ComparisonFunc == D3D11_COMPARISON_LESS_EQUAL);
+
+      // Changing the bias of the other filters changes the look of reflections
+      const uint32_t created_samplers = device.created_samplers;
+      desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+      CHECK(CreateCustomSampler(&device, desc, -1.f) == nullptr);
+      desc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+      CHECK(CreateCustomSampler(&device, desc, -1.f) == nullptr);
+      CHECK(device.created_samplers == created_samplers);
+
+      // The custom version of a game sampler is created on the same device
+      desc.Filter = D3D11_FILTER_ANISOTROPIC;
+      desc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+      com_ptr<ID3D11SamplerState> original_sampler;
+      CHECK(SUCCEEDED(device.CreateSamplerState(&desc, &original_sampler)));
+      sampler = CreateCustomSamplerFromOriginal(original_sampler.get(), -2.f);
+      CHECK(sampler != nullptr && sampler->device == &device);
+      CHECK(sampler->desc.AddressU == D3D11_TEXTURE_ADDRESS_CLAMP && sampler->desc.MipLODBias == -2.f);
+   }
+
+   // Only the global cbuffers of the main view are accepted, the view data (resolutions, DRS, TAA, jitters) is read from the first ones of each frame,
+   // the previous projection matrices are fixed up, and the samplers are re-created for the new LOD bias
+   void TestUpdateGlobalCBuffer()
+   {
+      const int64_t live_objects = IUnknown::live_objects;
+      {
+         mock_reshade_device device;
+         auto& device_data = CreateDeviceData(&device);
+         device_data.cloned_pipeline_count = 1;
+
+         D3D11_SAMPLER_DESC sampler_desc = {};
+         sampler_desc.Filter = D3D11_FILTER_ANISOTROPIC;
+         sampler_desc.MaxAnisotropy = 8;
+         com_ptr<ID3D11SamplerState> game_sampler;
+         CHECK(SUCCEEDED(device.native_device.CreateSamplerState(&sampler_desc, &game_sampler)));
+         device_data.custom_samplers.add(reinterpret_cast<uint64_t>(game_sampler.get()), &CreateCustomSamplerFromOriginal);
+         const auto get_custom_sampler_lod_bias = [&]()
+            {
+               const rcu_domain::read_scope read_scope(device_data.rcu);
+               uint64_t custom_sampler = 0;
+               CHECK(device_data.custom_samplers.find(reinterpret_cast<uint64_t>(game_sampler.get()), custom_sampler) && custom_sampler != 0);
+               return reinterpret_cast<ID3D11SamplerState*>(custom_sampler)->desc.MipLODBias;
+            };
+         CHECK(get_custom_sampler_lod_bias() == 0.f);
+
+         // Shadow maps have an actual view projection matrix in there, menus have all identity matrices
+         GlobalCBufferData cbuffer;
+         MakeMainViewGlobalCBuffer(cbuffer, output_width, output_height, { 0.f, 0.f });
+         cbuffer.get().CV_PrevViewProjMatr.m01 = 0.5f;
+         CHECK(!UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         CHECK(!UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         MakeMainViewGlobalCBuffer(cbuffer, output_width, output_height, { 0.f, 0.f });
+         cbuffer.get().CV_PrevViewProjMatr.SetIdentity();
+         cbuffer.get().CV_PrevViewProjNearestMatr.SetIdentity();
+         CHECK(!UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         MakeMainViewGlobalCBuffer(cbuffer, output_width, output_height, { 0.f, 0.f });
+         cbuffer.get().CV_SkyColor.w = 0.f;
+         CHECK(!UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         CHECK(!device_data.found_per_view_globals);
+
+         // First frame, at native resolution with TAA
+         const float2 jitters = { 0.0004f, -0.0003f };
+         MakeMainViewGlobalCBuffer(cbuffer, output_width, output_height, jitters);
+         CHECK(UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         CHECK(device_data.found_per_view_globals && !device_data.prey_drs_active && !device_data.prey_drs_detected);
+         CHECK(device_data.render_resolution == device_data.output_resolution);
+         CHECK(projection_jitters == jitters && previous_projection_jitters == jitters);
+         CHECK(device_data.prey_taa_active && device_data.prey_taa_detected && cb_luma_frame_settings.DLSS == 1 && device_data.cb_luma_frame_settings_dirty);
+         CHECK(device_data.force_reset_dlss_sr && device_data.dlss_render_resolution_scale == 1.f);
+         // DLAA runs at native resolution, where textures are biased by -1 (as with TAA)
+         CHECK(device_data.texture_mip_lod_bias_offset == -1.f && get_custom_sampler_lod_bias() == -1.f);
+
+         // After tonemapping, the jitters are removed from the matrices, which shouldn't be cached
+         device_data.frame_passes.mark_drawn(FramePass::ComposedGBuffers);
+         device_data.frame_passes.mark_drawn(FramePass::Tonemapping);
+         MakeMainViewGlobalCBuffer(cbuffer, output_width, output_height, { 0.f, 0.f });
+         CHECK(UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         CHECK(projection_jitters == jitters && device_data.prey_taa_active);
+         device_data.frame_passes.mark_drawn(FramePass::DLSS_SR);
+         device_data.frame_passes.mark_drawn(FramePass::MainPostProcessing);
+         EndFrame(device_data);
+
+         // Second frame, the game dynamic resolution scaling dropped to 2/3
+         const float2 new_jitters = { -0.0002f, 0.0005f };
+         MakeMainViewGlobalCBuffer(cbuffer, output_width * 2.f / 3.f, output_height * 2.f / 3.f, new_jitters);
+         CHECK(UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         CHECK(device_data.prey_drs_active && device_data.prey_drs_detected && device_data.dlss_render_resolution_scale == 1.f / 1.5f);
+         CHECK(device_data.render_resolution.x == output_width * 2.f / 3.f && device_data.previous_render_resolution == device_data.output_resolution);
+         CHECK(projection_jitters == new_jitters && previous_projection_jitters == jitters);
+         // The motion vectors are generated with the actual previous (jittered) projection matrix
+         CHECK(std::memcmp(&cb_per_view_global.CV_PrevViewProjMatr, &previous_projection_matrix, sizeof(Matrix44A)) == 0 && cb_per_view_global.CV_PrevViewProjMatr.m02 == jitters.x);
+         const float lod_bias = custom_sampler_cache::quantize_lod_bias(std::log2(2.f / 3.f) - 1.f);
+         CHECK(device_data.texture_mip_lod_bias_offset == lod_bias && get_custom_sampler_lod_bias() == lod_bias);
+
+         // After DLSS upscaled, the passes that follow are told they are at the output resolution
+         device_data.frame_passes.mark_drawn(FramePass::ComposedGBuffers);
+         device_data.frame_passes.mark_drawn(FramePass::Tonemapping);
+         device_data.frame_passes.mark_drawn(FramePass::DLSS_SR);
+         CHECK(UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         CHECK(cb_per_view_global.CV_ScreenSize.x == output_width && cb_per_view_global.CV_ScreenSize.y == output_height);
+         CHECK(cb_per_view_global.CV_HPosScale.x == 1.f && cb_per_view_global.CV_HPosScale.w == 1.f);
+         CHECK(device_data.render_resolution.x == output_width * 2.f / 3.f);
+         device_data.frame_passes.mark_drawn(FramePass::MainPostProcessing);
+         EndFrame(device_data);
+
+         // Without DLSS, the previous projection matrices are left as they were (unless forced)
+         device_data.dlss_sr = false;
+         MakeMainViewGlobalCBuffer(cbuffer, output_width * 2.f / 3.f, output_height * 2.f / 3.f, jitters);
+         CHECK(UpdateGlobalCBuffer(&cbuffer.data[0], device_data, false));
+         CHECK(std::memcmp(&cb_per_view_global.CV_PrevViewProjMatr, &cbuffer.get().CV_PrevViewProjMatr, sizeof(Matrix44A)) == 0);
+         CHECK(cb_luma_frame_settings.DLSS == 0 && device_data.texture_mip_lod_bias_offset == -1.f);
+         CHECK(UpdateGlobalCBuffer(&cbuffer.data[0], device_data, true));
+         CHECK(std::memcmp(&cb_per_view_global.CV_PrevViewProjMatr, &previous_projection_matrix, sizeof(Matrix44A)) == 0);
+
+         device.destroy_private_data<DeviceViewData>();
+      }
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+
+   // Our cbuffers are only uploaded when they changed, and are bound to the requested shader stages
+   void TestSetLumaConstantBuffers()
+   {
+      const int64_t live_objects = IUnknown::live_objects;
+      {
+         mock_reshade_device device;
+         mock_reshade_command_list cmd_list(device);
+         mock_device_context& native_device_context = cmd_list.native_device_context;
+         auto& device_data = CreateDeviceData(&device);
+
+         SetLumaConstantBuffers(&native_device_context, device_data, reshade::api::shader_stage::pixel, LumaConstantBufferType::LumaSettings);
+         CHECK(native_device_context.maps == 0);
+         CHECK(native_device_context.current.constant_buffers[luma_settings_cbuffer_index] == device_data.luma_frame_settings);
+         CHECK(native_device_context.current.vs_constant_buffers[luma_settings_cbuffer_index] == nullptr);
+
+         cb_luma_frame_settings.ScenePeakWhite = 1000.f;
+         device_data.cb_luma_frame_settings_dirty = true;
+         SetLumaConstantBuffers(&native_device_context, device_data, reshade::api::shader_stage::pixel | reshade::api::shader_stage::compute, LumaConstantBufferType::LumaSettings);
+         CHECK(native_device_context.maps == 1 && !device_data.cb_luma_frame_settings_dirty);
+         CHECK(std::memcmp(static_cast<mock_buffer*>(device_data.luma_frame_settings.get())->data.data(), &cb_luma_frame_settings, sizeof(cb_luma_frame_settings)) == 0);
+         CHECK(native_device_context.current.cs_constant_buffers[luma_settings_cbuffer_index] == device_data.luma_frame_settings);
+
+         device_data.render_resolution = { output_width / 2.f, output_height / 2.f };
+         device_data.previous_render_resolution = device_data.output_resolution;
+         SetLumaConstantBuffers(&native_device_context, device_data, reshade::api::shader_stage::vertex | reshade::api::shader_stage::pixel, LumaConstantBufferType::LumaData, 3);
+         CHECK(native_device_context.maps == 2);
+         const LumaFrameData& cb_luma_frame_data = *reinterpret_cast<const LumaFrameData*>(static_cast<mock_buffer*>(device_data.luma_frame_data.get())->data.data());
+         CHECK(cb_luma_frame_data.CustomData == 3 && cb_luma_frame_data.FrameIndex == frame_index);
+         CHECK(cb_luma_frame_data.RenderResolutionScale == float2(0.5f, 0.5f) && cb_luma_frame_data.PreviousRenderResolutionScale == float2(1.f, 1.f));
+         CHECK(native_device_context.current.vs_constant_buffers[luma_data_cbuffer_index] == device_data.luma_frame_data);
+         CHECK(native_device_context.current.constant_buffers[luma_data_cbuffer_index] == device_data.luma_frame_data);
+         CHECK(native_device_context.current.gs_constant_buffers[luma_data_cbuffer_index] == nullptr && native_device_context.current.cs_constant_buffers[luma_data_cbuffer_index] == nullptr);
+
+         // Nothing changed
+         SetLumaConstantBuffers(&native_device_context, device_data, reshade::api::shader_stage::all_graphics, LumaConstantBufferType::LumaData, 3);
+         CHECK(native_device_context.maps == 2);
+         CHECK(native_device_context.current.gs_constant_buffers[luma_data_cbuffer_index] == device_data.luma_frame_data);
+         SetLumaConstantBuffers(&native_device_context, device_data, reshade::api::shader_stage::pixel, LumaConstantBufferType::LumaData, 4);
+         CHECK(native_device_context.maps == 3 && cb_luma_frame_data.CustomData == 4);
+
+         device.destroy_private_data<DeviceViewData>();
+      }
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+
+   // Our final pass on present (as in "OnPresent()"), through the effect runtime immediate command list: our cbuffers are pushed and the pass drawn,
+   // and then all the game states are restored, including the constant buffers in the slots we used
+   void TestPresent()
+   {
+      const int64_t live_objects = IUnknown::live_objects;
+      {
+         mock_reshade_device device;
+         D3D11_TEXTURE2D_DESC back_buffer_desc = {};
+         back_buffer_desc.Width = output_width;
+         back_buffer_desc.Height = output_height;
+         back_buffer_desc.Format = DXGI_FORMAT_R10G10B10A2_UNORM;
+         back_buffer_desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+         mock_reshade_effect_runtime runtime(device, back_buffer_desc, 2);
+         CreateDeviceData(&device);
+
+         reshade::api::command_queue* const queue = runtime.get_command_queue();
+         ID3D11DeviceContext* const native_device_context = reinterpret_cast<ID3D11DeviceContext*>(queue->get_immediate_command_list()->get_native());
+         mock_device_context& mock_native_device_context = static_cast<mock_device_context&>(*native_device_context);
+         auto& device_data = queue->get_device()->get_private_data<DeviceViewData>();
+
+         const com_ptr<ID3D11BlendState> blend_state = com_ptr<ID3D11BlendState>(new ID3D11BlendState(), true);
+         const com_ptr<ID3D11VertexShader> vs = com_ptr<ID3D11VertexShader>(new ID3D11VertexShader(), true);
+         const com_ptr<ID3D11PixelShader> ps = com_ptr<ID3D11PixelShader>(new ID3D11PixelShader(), true);
+         const com_ptr<ID3D11Texture2D> source_texture = com_ptr<ID3D11Texture2D>(new ID3D11Texture2D(), true);
+         const com_ptr<ID3D11ShaderResourceView> source_texture_view = com_ptr<ID3D11ShaderResourceView>(new ID3D11ShaderResourceView(source_texture.get(), {}), true);
+         const com_ptr<ID3D11Buffer> game_cbuffer = com_ptr<ID3D11Buffer>(new ID3D11Buffer(), true);
+
+         for (uint32_t i = 0; i < 3; i++)
+         {
+            // The game UI pass left the back buffer bound
+            ID3D11Texture2D* const back_buffer = reinterpret_cast<ID3D11Texture2D*>(runtime.get_back_buffer(runtime.get_current_back_buffer_index()).handle);
+            const com_ptr<ID3D11RenderTargetView> back_buffer_view = com_ptr<ID3D11RenderTargetView>(new ID3D11RenderTargetView(back_buffer, {}), true);
+            mock_native_device_context.current.render_targets[0] = back_buffer_view;
+            mock_native_device_context.current.constant_buffers[luma_data_cbuffer_index] = game_cbuffer;
+            const mock_device_context::states game_states = mock_native_device_context.current;
+            mock_native_device_context.ResetCounters();
+
+            draw_state_stack state_stack(luma_settings_cbuffer_index, luma_data_cbuffer_index);
+            CHECK(state_stack.get_render_target_view(native_device_context, 0) == back_buffer_view.get());
+            state_stack.cache(native_device_context, draw_state_stack::state_constant_buffers);
+            SetLumaConstantBuffers(native_device_context, device_data, reshade::api::shader_stage::pixel, LumaConstantBufferType::LumaSettings);
+            SetLumaConstantBuffers(native_device_context, device_data, reshade::api::shader_stage::pixel, LumaConstantBufferType::LumaData);
+            state_stack.mark_dirty(draw_state_stack::state_constant_buffers);
+            CHECK(mock_native_device_context.current.constant_buffers[luma_data_cbuffer_index] == device_data.luma_frame_data);
+
+            constexpr FLOAT blend_factor[4] = { 1.f, 1.f, 1.f, 0.f };
+            state_stack.set_blend_state(native_device_context, blend_state.get(), blend_factor, 0xFFFFFFFF);
+            state_stack.set_primitive_topology(native_device_context, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+            state_stack.clear_scissor_rects(native_device_context);
+            D3D11_VIEWPORT viewport = {};
+            viewport.Width = output_width;
+            viewport.Height = output_height;
+            viewport.MaxDepth = 1;
+            state_stack.set_viewport(native_device_context, viewport);
+            state_stack.set_ps_shader_resource(native_device_context, source_texture_view.get());
+            state_stack.set_render_target(native_device_context, back_buffer_view.get());
+            state_stack.set_shaders(native_device_context, vs.get(), ps.get());
+            native_device_context->Draw(4, 0);
+            state_stack.restore(native_device_context);
+
+            CHECK(mock_native_device_context.draws == 1);
+            CHECK(mock_native_device_context.current == game_states);
+            // Our data cbuffer is only uploaded again when the frame data changed
+            CHECK(mock_native_device_context.maps == (i == 0 ? 1 : 0));
+
+            runtime.present();
+         }
+         CHECK(runtime.get_current_back_buffer_index() == 1);
+
+         mock_native_device_context.current = {};
+         queue->get_device()->destroy_private_data<DeviceViewData>();
+      }
+      CHECK(IUnknown::live_objects == live_objects);
+   }
+}
+
+int main()
+{
+   TestCreateCustomSampler();
+   TestUpdateGlobalCBuffer();
+   TestSetLumaConstantBuffers();
+   TestPresent();
+   std::printf("All view_data tests passed\n");
+   return 0;
+}
@@ -0,0 +1,222 @@
+// Standalone tests and benchmark of "work_stealing.h" (it has no dependencies on ReShade or Windows), with a stand-in shader compiler, build and run with any C++20 compiler, e.g.:
+// cl /std:c++20 /O2 /EHsc work_stealing_tests.cpp && work_stealing_tests.exe
+// g++ -std=c++20 -O2 -pthread work_stealing_tests.cpp -o work_stealing_tests && ./work_stealing_tests
+
+#include "../src/includes/work_stealing.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); std::exit(1); } } while (false)
+
+namespace
+{
+   // Starts each helper on its own thread (stand-in for the addon job system), they are joined on destruction
+   struct ThreadHelpers
+   {
+      std::vector<std::thread> threads;
+
+      ~ThreadHelpers()
+      {
+         for (auto& thread : threads)
+         {
+            thread.join();
+         }
+      }
+
+      auto spawner()
+      {
+         return [this](std::function<void()> helper) { threads.emplace_back(std::move(helper)); };
+      }
+   };
+
+   // Like "CustomShaderCompilationJob", each job only writes to its own data
+   struct StandInCompilationJob
+   {
+      std::string source;
+      std::chrono::microseconds latency;
+      uint64_t bytecode_hash = 0;
+      std::atomic<uint32_t> compilations = 0;
+   };
+
+   // Simulates the compiler: it takes a while, and the output only depends on the input
+   void CompileStandIn(StandInCompilationJob& job)
+   {
+      std::this_thread::sleep_for(job.latency);
+      uint64_t hash = 14695981039346656037ull;
+      for (const char c : job.source)
+      {
+         hash = (hash ^ uint8_t(c)) * 1099511628211ull;
+      }
+      job.bytecode_hash = hash;
+      job.compilations++;
+   }
+
+   // A shaders folder worth of jobs: most shaders are quick (they didn't change), a few take long to compile
+   std::vector<StandInCompilationJob> MakeJobs(size_t jobs_num, uint32_t seed, std::chrono::microseconds quick_latency, std::chrono::microseconds slow_latency)
+   {
+      std::mt19937 random(seed);
+      std::vector<StandInCompilationJob> jobs(jobs_num);
+      for (size_t i = 0; i < jobs_num; i++)
+      {
+         jobs[i].source = "Shader_0x" + std::to_string(random()) + ".hlsl";
+         jobs[i].latency = (random() % 10 == 0) ? slow_latency : quick_latency;
+      }
+      return jobs;
+   }
+
+   // Every job runs exactly once, with any amount of workers, and the results are the same as a serial compilation
+   void TestAllJobsRunOnce()
+   {
+      for (const size_t jobs_num : { 0, 1, 2, 7, 64, 301 })
+      {
+         for (const size_t helpers_num : { 0, 1, 3, 7, 16 })
+         {
+            auto jobs = MakeJobs(jobs_num, uint32_t(jobs_num), std::chrono::microseconds(0), std::chrono::microseconds(200));
+            work_stealing_jobs::results results;
+            {
+               ThreadHelpers helpers;
+               results = work_stealing_jobs::run(jobs.size(), helpers_num, [&](size_t job_index) { CompileStandIn(jobs[job_index]); }, []() { return false; }, helpers.spawner());
+            }
+            CHECK(results.run_jobs == jobs_num);
+            auto serial_jobs = MakeJobs(jobs_num, uint32_t(jobs_num), std::chrono::microseconds(0), std::chrono::microseconds(0));
+            for (size_t i = 0; i < jobs_num; i++)
+            {
+               CHECK(jobs[i].compilations == 1);
+               CompileStandIn(serial_jobs[i]);
+               CHECK(jobs[i].bytecode_hash == serial_jobs[i].bytecode_hash);
+            }
+         }
+      }
+   }
+
+   // Helpers that never get to start before the calling thread finished everything (e.g. the job system is busy) don't block it, and don't run anything when they finally start
+   void TestLateHelpers()
+   {
+      auto jobs = MakeJobs(50, 3, std::chrono::microseconds(0), std::chrono::microseconds(0));
+      std::vector<std::function<void()>> pending_helpers;
+      const auto results = work_stealing_jobs::run(jobs.size(), 4, [&](size_t job_index) { CompileStandIn(jobs[job_index]); }, []() { return false; },
+         [&](std::function<void()> helper) { pending_helpers.push_back(std::move(helper)); });
+      CHECK(results.run_jobs == jobs.size());
+      CHECK(results.stolen_jobs > 0); // The calling thread had to take the jobs of the helpers
+      CHECK(pending_helpers.size() == 4);
+      jobs.clear(); // The helpers must not touch the jobs anymore
+      for (auto& helper : pending_helpers)
+      {
+         helper();
+      }
+   }
+
+   // A workers stuck on a long job gets the rest of its range stolen
+   void TestStealing()
+   {
+      auto jobs = MakeJobs(40, 5, std::chrono::microseconds(100), std::chrono::microseconds(100));
+      jobs[0].latency = std::chrono::milliseconds(100); // The first job of the calling thread range
+      ThreadHelpers helpers;
+      const auto results = work_stealing_jobs::run(jobs.size(), 3, [&](size_t job_index) { CompileStandIn(jobs[job_index]); }, []() { return false; }, helpers.spawner());
+      CHECK(results.run_jobs == jobs.size());
+      CHECK(results.stolen_jobs >= 5);
+      std::printf("Stealing: %zu of %zu jobs were stolen\n", results.stolen_jobs, jobs.size());
+   }
+
+   // A newer compilation supersedes the one in progress, the remaining jobs are skipped
+   void TestCancellation()
+   {
+      auto jobs = MakeJobs(200, 9, std::chrono::microseconds(200), std::chrono::microseconds(200));
+      std::atomic<uint32_t> compilation_generation = 0;
+      std::atomic<size_t> compiled_jobs = 0;
+      ThreadHelpers helpers;
+      const auto results = work_stealing_jobs::run(jobs.size(), 3,
+         [&](size_t job_index)
+         {
+            CompileStandIn(jobs[job_index]);
+            if (++compiled_jobs == 20) compilation_generation++;
+         },
+         [&]() { return compilation_generation != 0; }, helpers.spawner());
+      CHECK(results.run_jobs >= 20 && results.run_jobs < jobs.size());
+      size_t compilations = 0;
+      for (const auto& job : jobs)
+      {
+         CHECK(job.compilations <= 1);
+         compilations += job.compilations;
+      }
+      CHECK(compilations == results.run_jobs);
+   }
+
+   // Compares the wall clock time of compiling a shaders folder serially (what used to happen), with a shared atomic index (the previous thread pool), and with work stealing
+   void BenchmarkCompilation()
+   {
+      constexpr size_t jobs_num = 240;
+      constexpr size_t helpers_num = 7;
+      const auto quick_latency = std::chrono::microseconds(500);
+      const auto slow_latency = std::chrono::milliseconds(15);
+
+      using clock = std::chrono::steady_clock;
+      const auto ms = [](clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+
+      auto serial_jobs = MakeJobs(jobs_num, 21, quick_latency, slow_latency);
+      const auto serial_start = clock::now();
+      for (auto& job : serial_jobs)
+      {
+         CompileStandIn(job);
+      }
+      const auto serial_time = clock::now() - serial_start;
+
+      auto atomic_index_jobs = MakeJobs(jobs_num, 21, quick_latency, slow_latency);
+      const auto atomic_index_start = clock::now();
+      {
+         std::atomic<size_t> next_job_index = 0;
+         const auto run_jobs = [&]()
+            {
+               for (size_t job_index = next_job_index++; job_index < jobs_num; job_index = next_job_index++)
+               {
+                  CompileStandIn(atomic_index_jobs[job_index]);
+               }
+            };
+         std::vector<std::thread> threads;
+         for (size_t i = 0; i < helpers_num; i++)
+         {
+            threads.emplace_back(run_jobs);
+         }
+         run_jobs();
+         for (auto& thread : threads)
+         {
+            thread.join();
+         }
+      }
+      const auto atomic_index_time = clock::now() - atomic_index_start;
+
+      auto stealing_jobs = MakeJobs(jobs_num, 21, quick_latency, slow_latency);
+      const auto stealing_start = clock::now();
+      work_stealing_jobs::results results;
+      {
+         ThreadHelpers helpers;
+         results = work_stealing_jobs::run(jobs_num, helpers_num, [&](size_t job_index) { CompileStandIn(stealing_jobs[job_index]); }, []() { return false; }, helpers.spawner());
+      }
+      const auto stealing_time = clock::now() - stealing_start;
+
+      for (size_t i = 0; i < jobs_num; i++)
+      {
+         CHECK(serial_jobs[i].bytecode_hash == stealing_jobs[i].bytecode_hash && serial_jobs[i].bytecode_hash == atomic_index_jobs[i].bytecode_hash);
+      }
+      std::printf("Compiling %zu stand-in shaders on %zu threads: serial %.1f ms, atomic index %.1f ms (%.1fx), work stealing %.1f ms (%.1fx, %zu stolen)\n",
+         jobs_num, helpers_num + 1, ms(serial_time), ms(atomic_index_time), ms(serial_time) / ms(atomic_index_time), ms(stealing_time), ms(serial_time) / ms(stealing_time), results.stolen_jobs);
+   }
+}
+
+int main()
+{
+   TestAllJobsRunOnce();
+   TestLateHelpers();
+   TestStealing();
+   TestCancellation();
+   BenchmarkCompilation();
+   std::printf("All work_stealing tests passed\n");
+   return 0;
+}